@@ -30,6 +30,8 @@
               vulkan-headers
               vulkan-validation-layers
               vulkan-utility-libraries
+              # For glslc, to compile shaders.
+              shaderc
               # For clang-tidy
               llvmPackages_19.clang-tools
               # For conan */system packages. Hint: nix-locate --whole-name dependency_name.pc | grep -v "^("
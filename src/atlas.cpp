@@ -0,0 +1,1054 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "atlas.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner)
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `VK_CHECK`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "barrier.hpp"
+#include "bench.hpp"
+#include "draw.hpp"
+#include "macros.hpp"
+#include "render_graph.hpp"
+#include "setup.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::atlas
+{
+namespace
+{
+/// Offset alignment of images in staging buffers, satisfying any texel size.
+constexpr VkDeviceSize kStagingAlignment = 16;
+
+constexpr VkImageUsageFlags kImageUsage = VK_IMAGE_USAGE_SAMPLED_BIT |
+	VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+bool intersects(Rect const & lhs, Rect const & rhs)
+{
+	return lhs.x < rhs.x + rhs.width && rhs.x < lhs.x + lhs.width && lhs.y < rhs.y + rhs.height &&
+		rhs.y < lhs.y + lhs.height;
+}
+
+bool contains(Rect const & outer, Rect const & inner)
+{
+	return inner.x >= outer.x && inner.y >= outer.y &&
+		inner.x + inner.width <= outer.x + outer.width &&
+		inner.y + inner.height <= outer.y + outer.height;
+}
+
+uint64_t area(Rect const & rect)
+{
+	return uint64_t{rect.width} * rect.height;
+}
+
+/**
+ * Add free rects, keeping only those not contained in another.
+ */
+void add_free_rects(std::vector<Rect> & free_rects, std::span<Rect const> const new_rects)
+{
+	if (new_rects.empty())
+		return;
+
+	// Only free rects overlapping the new rects' bounds can contain, or be contained by, them.
+	uint32_t left = UINT32_MAX;
+	uint32_t top = UINT32_MAX;
+	uint32_t right = 0;
+	uint32_t bottom = 0;
+	for (Rect const & new_rect : new_rects)
+	{
+		left = std::min(left, new_rect.x);
+		top = std::min(top, new_rect.y);
+		right = std::max(right, new_rect.x + new_rect.width);
+		bottom = std::max(bottom, new_rect.y + new_rect.height);
+	}
+	Rect const bounds{left, top, right - left, bottom - top};
+	std::vector<Rect> nearby;
+	for (Rect const & free_rect : free_rects)
+		if (intersects(free_rect, bounds))
+			nearby.push_back(free_rect);
+
+	std::vector<Rect> kept;
+	for (std::size_t new_idx = 0; new_idx < new_rects.size(); ++new_idx)
+	{
+		Rect const & new_rect = new_rects[new_idx];
+		auto const contains_new = [&](Rect const & other) { return contains(other, new_rect); };
+		bool const redundant = std::ranges::any_of(nearby, contains_new) ||
+			std::ranges::any_of(
+				std::views::iota(0UZ, new_rects.size()),
+				[&](std::size_t const other_idx)
+				{
+					// Of duplicates, keep only the first.
+					Rect const & other = new_rects[other_idx];
+					return other_idx != new_idx && contains(other, new_rect) &&
+						(other != new_rect || other_idx < new_idx);
+				});
+		if (!redundant)
+			kept.push_back(new_rect);
+	}
+
+	std::erase_if(
+		free_rects,
+		[&](Rect const & free_rect)
+		{
+			return intersects(free_rect, bounds) &&
+				std::ranges::any_of(
+					kept, [&](Rect const & kept_rect) { return contains(kept_rect, free_rect); });
+		});
+	free_rects.insert(free_rects.end(), kept.begin(), kept.end());
+}
+
+/**
+ * Replace the free rects overlapping a newly used rect with the maximal free rects around it.
+ */
+void split_free_rects(std::vector<Rect> & free_rects, Rect const & used)
+{
+	std::vector<Rect> new_rects;
+	std::erase_if(
+		free_rects,
+		[&](Rect const & free_rect)
+		{
+			if (!intersects(free_rect, used))
+				return false;
+
+			uint32_t const free_right = free_rect.x + free_rect.width;
+			uint32_t const free_bottom = free_rect.y + free_rect.height;
+			uint32_t const used_right = used.x + used.width;
+			uint32_t const used_bottom = used.y + used.height;
+			if (used.x > free_rect.x)
+				new_rects.push_back(
+					{free_rect.x, free_rect.y, used.x - free_rect.x, free_rect.height});
+			if (used_right < free_right)
+				new_rects.push_back(
+					{used_right, free_rect.y, free_right - used_right, free_rect.height});
+			if (used.y > free_rect.y)
+				new_rects.push_back(
+					{free_rect.x, free_rect.y, free_rect.width, used.y - free_rect.y});
+			if (used_bottom < free_bottom)
+				new_rects.push_back(
+					{free_rect.x, used_bottom, free_rect.width, free_bottom - used_bottom});
+			return true;
+		});
+	add_free_rects(free_rects, new_rects);
+}
+
+VkExtent2D max_free_extent(std::span<Rect const> const free_rects)
+{
+	VkExtent2D extent{0, 0};
+	for (Rect const & free_rect : free_rects)
+	{
+		extent.width = std::max(extent.width, free_rect.width);
+		extent.height = std::max(extent.height, free_rect.height);
+	}
+	return extent;
+}
+
+/// All layers of an atlas image.
+constexpr VkImageSubresourceRange kAllLayers{
+	VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+
+/// State of an atlas image between updates, ready to be sampled by fragment or compute shaders.
+constexpr render_graph::ResourceState kSampleable{
+	.stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+	.access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+	.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+AtlasConfig validate_config(AtlasConfig config, VkPhysicalDevice physical_device)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	if (config.layer_extent.width == 0 || config.layer_extent.height == 0 ||
+		config.max_layers == 0)
+		throw std::invalid_argument{"Atlas is empty"};
+	if (config.layer_extent.width > properties.limits.maxImageDimension2D ||
+		config.layer_extent.height > properties.limits.maxImageDimension2D ||
+		config.max_layers > properties.limits.maxImageArrayLayers)
+		throw std::invalid_argument{"Atlas exceeds device image limits"};
+	return config;
+}
+}  // namespace
+
+std::size_t texel_size(VkFormat const format)
+{
+	switch (format)
+	{
+		case VK_FORMAT_R8_UNORM:
+			return 1;
+		case VK_FORMAT_R8G8_UNORM:
+			return 2;
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			return 4;
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+			return 8;
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			return 16;
+		default:
+			throw std::invalid_argument{"Unsupported atlas format"};
+	}
+}
+
+std::vector<std::byte> pad_image(
+	VkExtent2D const extent,
+	std::span<std::byte const> const texels,
+	std::size_t const texel_size,
+	uint32_t const padding)
+{
+	if (extent.width == 0 || extent.height == 0)
+		throw std::invalid_argument{"Atlas image is empty"};
+	if (texels.size() != std::size_t{extent.width} * extent.height * texel_size)
+		throw std::invalid_argument{"Atlas image texels do not match its extent"};
+
+	uint32_t const padded_width = extent.width + 2 * padding;
+	uint32_t const padded_height = extent.height + 2 * padding;
+	std::vector<std::byte> padded(std::size_t{padded_width} * padded_height * texel_size);
+	for (uint32_t y = 0; y < padded_height; ++y)
+	{
+		uint32_t const src_y = std::clamp(y, padding, padding + extent.height - 1) - padding;
+		for (uint32_t x = 0; x < padded_width; ++x)
+		{
+			uint32_t const src_x = std::clamp(x, padding, padding + extent.width - 1) - padding;
+			std::size_t const src_offset = (std::size_t{src_y} * extent.width + src_x) * texel_size;
+			std::ranges::copy(
+				texels.subspan(src_offset, texel_size),
+				padded.begin() +
+					static_cast<std::ptrdiff_t>((std::size_t{y} * padded_width + x) * texel_size));
+		}
+	}
+	return padded;
+}
+
+AtlasPacker::AtlasPacker(
+	VkExtent2D const layer_extent, uint32_t const max_layers, uint32_t const padding)
+	: layer_extent_{layer_extent}, max_layers_{max_layers}, padding_{padding}
+{
+}
+
+std::optional<ImageId> AtlasPacker::insert(VkExtent2D const extent)
+{
+	if (extent.width == 0 || extent.height == 0)
+		throw std::invalid_argument{"Atlas rect is empty"};
+
+	VkExtent2D const padded_extent{extent.width + 2 * padding_, extent.height + 2 * padding_};
+	if (padded_extent.width > layer_extent_.width || padded_extent.height > layer_extent_.height)
+		return std::nullopt;
+
+	std::optional<Placement> placement;
+	for (uint32_t layer_idx = 0; layer_idx < layers_.size() && !placement; ++layer_idx)
+		if (std::optional<Rect> const rect = find_free_rect(layers_[layer_idx], padded_extent))
+			placement = Placement{.layer = layer_idx, .rect = *rect};
+
+	// Reclaim unmerged free space before resorting to another layer.
+	for (uint32_t layer_idx = 0; layer_idx < layers_.size() && !placement; ++layer_idx)
+	{
+		Layer & layer = layers_[layer_idx];
+		if (!layer.fragmented)
+			continue;
+		rebuild_free_rects(layer);
+		if (std::optional<Rect> const rect = find_free_rect(layer, padded_extent))
+			placement = Placement{.layer = layer_idx, .rect = *rect};
+	}
+
+	if (!placement)
+	{
+		if (layers_.size() >= max_layers_)
+			return std::nullopt;
+		layers_.push_back(Layer{
+			.free_rects = {Rect{0, 0, layer_extent_.width, layer_extent_.height}},
+			.max_free_extent = layer_extent_,
+			.image_ids = {},
+			.fragmented = false});
+		placement = Placement{
+			.layer = static_cast<uint32_t>(layers_.size() - 1),
+			.rect = Rect{0, 0, padded_extent.width, padded_extent.height}};
+	}
+
+	Layer & layer = layers_[placement->layer];
+	split_free_rects(layer.free_rects, placement->rect);
+	layer.max_free_extent = max_free_extent(layer.free_rects);
+	used_area_ += area(placement->rect);
+
+	ImageId image_id{static_cast<uint32_t>(placements_.size())};
+	if (free_ids_.empty())
+	{
+		placements_.push_back(placement);
+	}
+	else
+	{
+		image_id = free_ids_.back();
+		free_ids_.pop_back();
+		placements_[image_id] = placement;
+	}
+	layer.image_ids.push_back(image_id);
+	return image_id;
+}
+
+void AtlasPacker::remove(ImageId const image_id)
+{
+	auto const [layer_idx, rect] = padded_placement(image_id);
+	Layer & layer = layers_[layer_idx];
+	placements_[image_id].reset();
+	free_ids_.push_back(image_id);
+	std::erase(layer.image_ids, image_id);
+	used_area_ -= area(rect);
+
+	// Merge with neighbouring free space by extending the freed rect across the layer in each
+	// axis, up to the nearest remaining rects. Both extensions contain the freed rect itself.
+	uint32_t left = 0;
+	uint32_t right = layer_extent_.width;
+	uint32_t top = 0;
+	uint32_t bottom = layer_extent_.height;
+	for (ImageId const other_id : layer.image_ids)
+	{
+		Rect const & other = placements_[other_id]->rect;
+		if (other.y < rect.y + rect.height && rect.y < other.y + other.height)
+		{
+			if (other.x < rect.x)
+				left = std::max(left, other.x + other.width);
+			else
+				right = std::min(right, other.x);
+		}
+		if (other.x < rect.x + rect.width && rect.x < other.x + other.width)
+		{
+			if (other.y < rect.y)
+				top = std::max(top, other.y + other.height);
+			else
+				bottom = std::min(bottom, other.y);
+		}
+	}
+	std::array const extended{
+		Rect{left, rect.y, right - left, rect.height}, Rect{rect.x, top, rect.width, bottom - top}};
+	add_free_rects(layer.free_rects, extended);
+	layer.max_free_extent = max_free_extent(layer.free_rects);
+	layer.fragmented = true;
+}
+
+Placement AtlasPacker::placement(ImageId const image_id) const
+{
+	Placement const & padded = padded_placement(image_id);
+	return Placement{
+		.layer = padded.layer,
+		.rect = Rect{
+			padded.rect.x + padding_,
+			padded.rect.y + padding_,
+			padded.rect.width - 2 * padding_,
+			padded.rect.height - 2 * padding_}};
+}
+
+uint32_t AtlasPacker::layer_count() const
+{
+	return static_cast<uint32_t>(layers_.size());
+}
+
+double AtlasPacker::occupancy() const
+{
+	if (layers_.empty())
+		return 0;
+	return static_cast<double>(used_area_) /
+		(static_cast<double>(area(Rect{0, 0, layer_extent_.width, layer_extent_.height})) *
+		 static_cast<double>(layers_.size()));
+}
+
+Placement const & AtlasPacker::padded_placement(ImageId const image_id) const
+{
+	if (static_cast<std::size_t>(image_id) >= placements_.size() || !placements_[image_id])
+		throw std::invalid_argument{"Unknown atlas image"};
+	return *placements_[image_id];
+}
+
+std::optional<Rect> AtlasPacker::find_free_rect(Layer const & layer, VkExtent2D const extent) const
+{
+	if (extent.width > layer.max_free_extent.width || extent.height > layer.max_free_extent.height)
+		return std::nullopt;
+
+	std::optional<Rect> best;
+	std::pair<uint32_t, uint32_t> best_score;
+	for (Rect const & free_rect : layer.free_rects)
+	{
+		if (free_rect.width < extent.width || free_rect.height < extent.height)
+			continue;
+
+		// Best short side fit, breaking ties by best long side fit.
+		uint32_t const leftover_width = free_rect.width - extent.width;
+		uint32_t const leftover_height = free_rect.height - extent.height;
+		std::pair const score{
+			std::min(leftover_width, leftover_height), std::max(leftover_width, leftover_height)};
+		if (!best || score < best_score)
+		{
+			best = Rect{free_rect.x, free_rect.y, extent.width, extent.height};
+			best_score = score;
+		}
+	}
+	return best;
+}
+
+void AtlasPacker::rebuild_free_rects(Layer & layer) const
+{
+	layer.free_rects = {Rect{0, 0, layer_extent_.width, layer_extent_.height}};
+	for (ImageId const image_id : layer.image_ids)
+		split_free_rects(layer.free_rects, placements_[image_id]->rect);
+	layer.max_free_extent = max_free_extent(layer.free_rects);
+	layer.fragmented = false;
+}
+
+TextureAtlas::TextureAtlas(
+	types::VulkanDevicePtr device,
+	VkPhysicalDevice physical_device,
+	types::VulkanMemoryTypeIdx const staging_memory_type_idx,
+	AtlasConfig const config)
+	: device_{std::move(device)},
+	  physical_device_{physical_device},
+	  staging_memory_type_idx_{staging_memory_type_idx},
+	  config_{validate_config(config, physical_device)},
+	  texel_size_{texel_size(config.format)},
+	  packer_{config.layer_extent, config.max_layers, config.padding},
+	  image_{create_image(1)}
+{
+}
+
+std::optional<ImageId> TextureAtlas::add_image(
+	VkExtent2D const extent, std::span<std::byte const> const texels)
+{
+	// Validates the texels before reserving space for them.
+	std::vector<std::byte> padded = pad_image(extent, texels, texel_size_, config_.padding);
+	std::optional<ImageId> const image_id = packer_.insert(extent);
+	if (image_id)
+		pending_.push_back(Pending{.image_id = *image_id, .texels = std::move(padded)});
+	return image_id;
+}
+
+void TextureAtlas::remove_image(ImageId const image_id)
+{
+	packer_.remove(image_id);
+	std::erase_if(pending_, [&](Pending const & pending) { return pending.image_id == image_id; });
+}
+
+AtlasEntry TextureAtlas::entry(ImageId const image_id) const
+{
+	auto const to_unorm16 = [](uint32_t const texel, uint32_t const size)
+	{
+		return static_cast<uint16_t>(std::lround(
+			static_cast<double>(texel) / static_cast<double>(size) * UINT16_MAX));
+	};
+	auto const [layer, rect] = packer_.placement(image_id);
+	VkExtent2D const & extent = config_.layer_extent;
+	return AtlasEntry{
+		.layer = layer,
+		.atlas_rect = {
+			to_unorm16(rect.x, extent.width),
+			to_unorm16(rect.y, extent.height),
+			to_unorm16(rect.x + rect.width, extent.width),
+			to_unorm16(rect.y + rect.height, extent.height)}};
+}
+
+Placement TextureAtlas::placement(ImageId const image_id) const
+{
+	return packer_.placement(image_id);
+}
+
+void TextureAtlas::populate_cmd_update(VkCommandBuffer command_buffer)
+{
+	std::erase_if(
+		retired_,
+		[&](Retired const & retired)
+		{ return frame_ >= retired.frame + config_.frames_in_flight; });
+
+	using render_graph::Access;
+	using render_graph::state_of;
+
+	if (packer_.layer_count() > image_.layer_count)
+	{
+		Image image = create_image(packer_.layer_count());
+		// Nothing to copy if never updated.
+		bool const copy_layers = state_.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+
+		std::vector<VkImageMemoryBarrier2> barriers{barrier::image_barrier(
+			image.image.get(), kAllLayers, {}, state_of(Access::kTransferWrite))};
+		if (copy_layers)
+			barriers.push_back(barrier::image_barrier(
+				image_.image.get(), kAllLayers, state_, state_of(Access::kTransferRead)));
+		barrier::populate_cmd_barriers(command_buffer, std::nullopt, barriers);
+
+		if (copy_layers)
+		{
+			VkImageCopy const region{
+				.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, image_.layer_count},
+				.srcOffset = {0, 0, 0},
+				.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, image_.layer_count},
+				.dstOffset = {0, 0, 0},
+				.extent = {config_.layer_extent.width, config_.layer_extent.height, 1}};
+			vkCmdCopyImage(
+				command_buffer,
+				image_.image.get(),
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				image.image.get(),
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				1,
+				&region);
+		}
+
+		// Submission order guarantees the copy completes before later frames sample the new image.
+		retired_.push_back(
+			Retired{.frame = frame_, .image = std::move(image_), .staging = std::nullopt});
+		image_ = std::move(image);
+		state_ = state_of(Access::kTransferWrite);
+		++generation_;
+	}
+
+	if (!pending_.empty())
+	{
+		std::vector<VkDeviceSize> offsets;
+		VkDeviceSize size = 0;
+		for (Pending const & pending : pending_)
+		{
+			offsets.push_back(size);
+			size += pending.texels.size();
+			size = (size + kStagingAlignment - 1) / kStagingAlignment * kStagingAlignment;
+		}
+
+		auto [buffer, memory, mapped] = draw::create_exclusive_mapped_buffer_and_memory(
+			device_, staging_memory_type_idx_, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+		std::vector<VkBufferImageCopy> regions;
+		for (std::size_t pending_idx = 0; pending_idx < pending_.size(); ++pending_idx)
+		{
+			Pending const & pending = pending_[pending_idx];
+			std::ranges::copy(
+				pending.texels,
+				mapped.begin() + static_cast<std::ptrdiff_t>(offsets[pending_idx]));
+
+			auto const [layer, rect] = packer_.placement(pending.image_id);
+			regions.push_back(VkBufferImageCopy{
+				.bufferOffset = offsets[pending_idx],
+				.bufferRowLength = 0,
+				.bufferImageHeight = 0,
+				.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, layer, 1},
+				.imageOffset =
+					{static_cast<int32_t>(rect.x - config_.padding),
+					 static_cast<int32_t>(rect.y - config_.padding),
+					 0},
+				.imageExtent = {
+					rect.width + 2 * config_.padding, rect.height + 2 * config_.padding, 1}});
+		}
+		pending_.clear();
+
+		// Also orders after sampling by earlier frames, and after any growth copy above.
+		barrier::populate_cmd_barriers(
+			command_buffer,
+			std::nullopt,
+			std::array{barrier::image_barrier(
+				image_.image.get(), kAllLayers, state_, state_of(Access::kTransferWrite))});
+		vkCmdCopyBufferToImage(
+			command_buffer,
+			buffer.get(),
+			image_.image.get(),
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(regions.size()),
+			regions.data());
+		state_ = state_of(Access::kTransferWrite);
+
+		retired_.push_back(Retired{
+			.frame = frame_,
+			.image = std::nullopt,
+			.staging = Staging{.buffer = std::move(buffer), .memory = std::move(memory)}});
+	}
+
+	if (state_.layout != kSampleable.layout)
+	{
+		barrier::populate_cmd_barriers(
+			command_buffer,
+			std::nullopt,
+			std::array{
+				barrier::image_barrier(image_.image.get(), kAllLayers, state_, kSampleable)});
+		state_ = kSampleable;
+	}
+
+	++frame_;
+}
+
+VkImage TextureAtlas::image() const
+{
+	return image_.image.get();
+}
+
+VkImageView TextureAtlas::image_view() const
+{
+	return image_.view.get();
+}
+
+uint64_t TextureAtlas::generation() const
+{
+	return generation_;
+}
+
+uint32_t TextureAtlas::layer_count() const
+{
+	return image_.layer_count;
+}
+
+double TextureAtlas::occupancy() const
+{
+	return packer_.occupancy();
+}
+
+TextureAtlas::Image TextureAtlas::create_image(uint32_t const layer_count) const
+{
+	auto [image, memory] = setup::create_image_and_memory(
+		device_,
+		physical_device_,
+		config_.format,
+		config_.layer_extent,
+		kImageUsage,
+		1,
+		layer_count);
+	types::VulkanImageViewPtr view = setup::create_image_view(
+		device_, image.get(), config_.format, VK_IMAGE_VIEW_TYPE_2D_ARRAY);
+	return Image{
+		.image = std::move(image),
+		.memory = std::move(memory),
+		.view = std::move(view),
+		.layer_count = layer_count};
+}
+
+namespace
+{
+/**
+ * Check that padded rects lie within their layer and overlap no other.
+ */
+bool is_valid_packing(
+	AtlasPacker const & packer,
+	std::span<ImageId const> const image_ids,
+	VkExtent2D const layer_extent,
+	uint32_t const padding)
+{
+	std::vector<Placement> padded;
+	for (ImageId const image_id : image_ids)
+	{
+		auto const [layer, rect] = packer.placement(image_id);
+		if (rect.x < padding || rect.y < padding ||
+			rect.x + rect.width + padding > layer_extent.width ||
+			rect.y + rect.height + padding > layer_extent.height || layer >= packer.layer_count())
+			return false;
+		padded.push_back(Placement{
+			.layer = layer,
+			.rect = Rect{
+				rect.x - padding,
+				rect.y - padding,
+				rect.width + 2 * padding,
+				rect.height + 2 * padding}});
+	}
+	for (std::size_t lhs_idx = 0; lhs_idx < padded.size(); ++lhs_idx)
+		for (std::size_t rhs_idx = lhs_idx + 1; rhs_idx < padded.size(); ++rhs_idx)
+			if (padded[lhs_idx].layer == padded[rhs_idx].layer &&
+				intersects(padded[lhs_idx].rect, padded[rhs_idx].rect))
+				return false;
+	return true;
+}
+}  // namespace
+
+TEST_CASE("Pad atlas images")
+{
+	// 2x2 single byte texels.
+	std::vector<std::byte> const texels{
+		std::byte{1}, std::byte{2}, std::byte{3}, std::byte{4}};
+
+	std::vector<std::byte> const padded = pad_image({2, 2}, texels, 1, 1);
+
+	// Border texels repeat the nearest edge texel.
+	std::vector<std::byte> const expected{
+		std::byte{1}, std::byte{1}, std::byte{2}, std::byte{2},
+		std::byte{1}, std::byte{1}, std::byte{2}, std::byte{2},
+		std::byte{3}, std::byte{3}, std::byte{4}, std::byte{4},
+		std::byte{3}, std::byte{3}, std::byte{4}, std::byte{4}};
+	CHECK(padded == expected);
+	CHECK(pad_image({2, 2}, texels, 1, 0) == texels);
+
+	CHECK_THROWS_AS(std::ignore = pad_image({2, 3}, texels, 1, 1), std::invalid_argument);
+	CHECK_THROWS_AS(std::ignore = pad_image({0, 2}, {}, 1, 1), std::invalid_argument);
+	CHECK(texel_size(VK_FORMAT_R8G8B8A8_UNORM) == 4);
+	CHECK_THROWS_AS(std::ignore = texel_size(VK_FORMAT_BC7_UNORM_BLOCK), std::invalid_argument);
+}
+
+TEST_CASE("Pack rectangles into atlas layers")
+{
+	SUBCASE("random sizes")
+	{
+		constexpr VkExtent2D layer_extent{256, 256};
+		constexpr uint32_t padding = 1;
+		AtlasPacker packer{layer_extent, 4, padding};
+		CHECK(packer.layer_count() == 0);
+		CHECK(packer.occupancy() == 0);
+
+		// NOLINTNEXTLINE(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+		std::mt19937 rng{42};
+		std::uniform_int_distribution<uint32_t> size_distribution{4, 48};
+		auto const random_extent = [&]
+		{ return VkExtent2D{size_distribution(rng), size_distribution(rng)}; };
+
+		std::vector<ImageId> image_ids;
+		for (int attempt = 0; attempt < 1000; ++attempt)
+			if (std::optional<ImageId> const image_id = packer.insert(random_extent()))
+				image_ids.push_back(*image_id);
+
+		CHECK(packer.layer_count() == 4);
+		CHECK(packer.occupancy() > 0.8);
+		CHECK(is_valid_packing(packer, image_ids, layer_extent, padding));
+
+		// Churn, reusing freed space.
+		for (int round = 0; round < 10; ++round)
+		{
+			std::ranges::shuffle(image_ids, rng);
+			for (ImageId const image_id : image_ids | std::views::drop(image_ids.size() / 2))
+				packer.remove(image_id);
+			image_ids.resize(image_ids.size() / 2);
+			CHECK(packer.occupancy() < 0.6);
+
+			for (int attempt = 0; attempt < 1000; ++attempt)
+				if (std::optional<ImageId> const image_id = packer.insert(random_extent()))
+					image_ids.push_back(*image_id);
+			CHECK(packer.occupancy() > 0.8);
+		}
+		CHECK(packer.layer_count() == 4);
+		CHECK(is_valid_packing(packer, image_ids, layer_extent, padding));
+	}
+
+	SUBCASE("full")
+	{
+		AtlasPacker packer{{64, 64}, 1, 0};
+
+		std::vector<ImageId> image_ids;
+		for (int image_idx = 0; image_idx < 16; ++image_idx)
+		{
+			std::optional<ImageId> const image_id = packer.insert({16, 16});
+			REQUIRE(image_id);
+			image_ids.push_back(*image_id);
+		}
+		CHECK(packer.occupancy() == 1);
+		CHECK(!packer.insert({1, 1}));
+		CHECK(is_valid_packing(packer, image_ids, {64, 64}, 0));
+
+		Placement const freed = packer.placement(image_ids[5]);
+		packer.remove(image_ids[5]);
+		CHECK(packer.occupancy() == doctest::Approx(15.0 / 16));
+
+		std::optional<ImageId> const image_id = packer.insert({16, 16});
+		REQUIRE(image_id);
+		CHECK(*image_id == image_ids[5]);
+		CHECK(packer.placement(*image_id).rect == freed.rect);
+		CHECK(packer.occupancy() == 1);
+	}
+
+	SUBCASE("merge freed space")
+	{
+		AtlasPacker packer{{64, 64}, 1, 0};
+		std::vector<ImageId> image_ids;
+		for (int image_idx = 0; image_idx < 4; ++image_idx)
+			image_ids.push_back(packer.insert({32, 32}).value());
+		CHECK(!packer.insert({64, 32}));
+
+		// Freed neighbours only fit a larger rect once merged.
+		packer.remove(image_ids[0]);
+		packer.remove(image_ids[1]);
+		CHECK(packer.insert({64, 32}) || packer.insert({32, 64}));
+	}
+
+	SUBCASE("too large")
+	{
+		AtlasPacker packer{{64, 64}, 4, 1};
+		CHECK(!packer.insert({63, 62}));
+		CHECK(packer.layer_count() == 0);
+		CHECK(packer.insert({62, 62}));
+		CHECK(packer.layer_count() == 1);
+		CHECK_THROWS_AS(std::ignore = packer.insert({0, 1}), std::invalid_argument);
+	}
+
+	SUBCASE("unknown image")
+	{
+		AtlasPacker packer{{64, 64}, 1, 0};
+		CHECK_THROWS_AS(packer.remove(ImageId{0}), std::invalid_argument);
+
+		ImageId const image_id = packer.insert({8, 8}).value();
+		packer.remove(image_id);
+		CHECK_THROWS_AS(packer.remove(image_id), std::invalid_argument);
+		CHECK_THROWS_AS(std::ignore = packer.placement(image_id), std::invalid_argument);
+	}
+}
+
+TEST_CASE("Upload images to a texture atlas")
+{
+	vulkandemo::LoggerPtr const logger =
+		vulkandemo::create_logger("Upload images to a texture atlas");
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		nullptr,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+
+	constexpr VkMemoryPropertyFlags memory_flags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT,
+		memory_flags);
+
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan13_features};
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{},
+		&features);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkCommandBuffer command_buffer = command_buffers->front();
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	types::VulkanMemoryTypeIdx const memory_type_idx =
+		setup::filter_available_memory_types(logger, physical_device, memory_flags).at(0);
+
+	// Room for a single padded 40x40 image per layer.
+	constexpr VkExtent2D layer_extent{64, 64};
+	constexpr uint32_t max_layers = 3;
+	constexpr VkExtent2D image_extent{40, 40};
+	TextureAtlas atlas{
+		device,
+		physical_device,
+		memory_type_idx,
+		{.layer_extent = layer_extent,
+		 .format = VK_FORMAT_R8G8B8A8_UNORM,
+		 .max_layers = max_layers,
+		 .padding = 1,
+		 .frames_in_flight = 2}};
+	CHECK(atlas.layer_count() == 1);
+	CHECK(atlas.image_view() != nullptr);
+
+	// Texels encode their own coordinates and the image they belong to.
+	auto const make_texels = [&](uint8_t const image_idx)
+	{
+		std::vector<std::byte> texels;
+		for (uint32_t y = 0; y < image_extent.height; ++y)
+		{
+			for (uint32_t x = 0; x < image_extent.width; ++x)
+			{
+				texels.push_back(static_cast<std::byte>(x));
+				texels.push_back(static_cast<std::byte>(y));
+				texels.push_back(static_cast<std::byte>(image_idx));
+				texels.push_back(std::byte{255});
+			}
+		}
+		return texels;
+	};
+
+	constexpr VkDeviceSize layer_size = VkDeviceSize{layer_extent.width} * layer_extent.height * 4;
+	auto [readback_buffer, readback_memory, readback] =
+		draw::create_exclusive_mapped_buffer_and_memory(
+			device, memory_type_idx, layer_size * max_layers, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+	constexpr VkCommandBufferBeginInfo begin_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+
+	using render_graph::Access;
+	using render_graph::state_of;
+
+	// Update the atlas, then copy all of its layers into the readback buffer.
+	auto const update = [&]
+	{
+		VK_CHECK(
+			vkBeginCommandBuffer(command_buffer, &begin_info), "Failed to begin command buffer");
+		atlas.populate_cmd_update(command_buffer);
+
+		barrier::populate_cmd_barriers(
+			command_buffer,
+			std::nullopt,
+			std::array{barrier::image_barrier(
+				atlas.image(), kAllLayers, kSampleable, state_of(Access::kTransferRead))});
+		VkBufferImageCopy const region{
+			.bufferOffset = 0,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, atlas.layer_count()},
+			.imageOffset = {0, 0, 0},
+			.imageExtent = {layer_extent.width, layer_extent.height, 1}};
+		vkCmdCopyImageToBuffer(
+			command_buffer,
+			atlas.image(),
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			readback_buffer.get(),
+			1,
+			&region);
+		barrier::populate_cmd_barriers(
+			command_buffer,
+			std::nullopt,
+			std::array{barrier::image_barrier(
+				atlas.image(), kAllLayers, state_of(Access::kTransferRead), kSampleable)});
+
+		VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
+		draw::submit_command_buffer(queue, command_buffer, nullptr, nullptr);
+		VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+	};
+
+	// Count texels, including padding, that differ from those of the source image.
+	auto const count_mismatches = [&](ImageId const image_id, uint8_t const image_idx)
+	{
+		auto const [layer, rect] = atlas.placement(image_id);
+		std::size_t mismatches = 0;
+		for (uint32_t y = 0; y < rect.height + 2; ++y)
+		{
+			for (uint32_t x = 0; x < rect.width + 2; ++x)
+			{
+				std::size_t const offset = layer * layer_size +
+					(std::size_t{rect.y - 1 + y} * layer_extent.width + rect.x - 1 + x) * 4;
+				uint32_t const src_x = std::clamp(x, 1U, image_extent.width) - 1;
+				uint32_t const src_y = std::clamp(y, 1U, image_extent.height) - 1;
+				if (readback[offset] != static_cast<std::byte>(src_x) ||
+					readback[offset + 1] != static_cast<std::byte>(src_y) ||
+					readback[offset + 2] != static_cast<std::byte>(image_idx))
+					++mismatches;
+			}
+		}
+		return mismatches;
+	};
+
+	ImageId const first = atlas.add_image(image_extent, make_texels(1)).value();
+	ImageId const second = atlas.add_image(image_extent, make_texels(2)).value();
+	CHECK(atlas.placement(first).layer == 0);
+	CHECK(atlas.placement(second).layer == 1);
+	CHECK(atlas.layer_count() == 1);
+
+	update();
+
+	CHECK(atlas.layer_count() == 2);
+	CHECK(atlas.generation() == 1);
+	CHECK(count_mismatches(first, 1) == 0);
+	CHECK(count_mismatches(second, 2) == 0);
+
+	// Growth preserves previously uploaded layers.
+	ImageId const third = atlas.add_image(image_extent, make_texels(3)).value();
+	update();
+
+	CHECK(atlas.layer_count() == 3);
+	CHECK(atlas.generation() == 2);
+	CHECK(count_mismatches(first, 1) == 0);
+	CHECK(count_mismatches(second, 2) == 0);
+	CHECK(count_mismatches(third, 3) == 0);
+
+	CHECK(!atlas.add_image(image_extent, make_texels(4)));
+
+	// Freed space is reused in place, without growth.
+	atlas.remove_image(first);
+	ImageId const fourth = atlas.add_image(image_extent, make_texels(4)).value();
+	update();
+
+	CHECK(atlas.layer_count() == 3);
+	CHECK(atlas.generation() == 2);
+	CHECK(atlas.entry(fourth).layer == 0);
+	CHECK(count_mismatches(fourth, 4) == 0);
+	CHECK(count_mismatches(second, 2) == 0);
+
+	// Pending uploads of removed images are discarded.
+	atlas.remove_image(fourth);
+	ImageId const fifth = atlas.add_image(image_extent, make_texels(5)).value();
+	atlas.remove_image(fifth);
+	update();
+	CHECK(count_mismatches(fourth, 4) == 0);
+}
+
+TEST_CASE("Benchmark atlas packing" * doctest::test_suite("benchmark") * doctest::skip())
+{
+	LoggerPtr const logger = create_logger("Benchmark atlas packing");
+
+	constexpr VkExtent2D layer_extent{2048, 2048};
+	constexpr uint32_t max_layers = 256;
+	constexpr uint32_t padding = 1;
+
+	for (std::size_t const image_count : {1000UZ, 4000UZ, 16000UZ})
+	{
+		constexpr std::size_t kIterations = 5;
+		// NOLINTNEXTLINE(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+		std::mt19937 rng{42};
+		std::uniform_int_distribution<uint32_t> size_distribution{8, 64};
+		auto const random_extent = [&]
+		{ return VkExtent2D{size_distribution(rng), size_distribution(rng)}; };
+
+		std::vector<VkExtent2D> extents(image_count);
+		std::ranges::generate(extents, random_extent);
+
+		std::optional<AtlasPacker> packer;
+		std::vector<ImageId> image_ids;
+		double const insert_ms = bench::mean_ms(
+			kIterations,
+			[&]
+			{
+				packer.emplace(layer_extent, max_layers, padding);
+				image_ids.clear();
+				for (VkExtent2D const & extent : extents)
+					image_ids.push_back(packer->insert(extent).value());
+			});
+		double const packed_occupancy = packer->occupancy();
+		uint32_t const packed_layers = packer->layer_count();
+
+		// Replace a tenth of the images with new ones of random sizes.
+		double const churn_ms = bench::mean_ms(
+			kIterations,
+			[&]
+			{
+				std::ranges::shuffle(image_ids, rng);
+				std::size_t const churn_count = image_ids.size() / 10;
+				for (ImageId const image_id : image_ids | std::views::take(churn_count))
+					packer->remove(image_id);
+				for (std::size_t churn_idx = 0; churn_idx < churn_count; ++churn_idx)
+					image_ids[churn_idx] = packer->insert(random_extent()).value();
+			});
+
+		logger->info(
+			"{} images: insert all {:.2f} ms ({:.2f} us each) into {} layers at {:.1f}% "
+			"occupancy, churn 10% {:.2f} ms, then {} layers at {:.1f}% occupancy",
+			image_count,
+			insert_ms,
+			insert_ms * 1000 / static_cast<double>(image_count),
+			packed_layers,
+			packed_occupancy * 100,
+			churn_ms,
+			packer->layer_count(),
+			packer->occupancy() * 100);
+	}
+}
+}  // namespace vulkandemo::atlas
@@ -0,0 +1,336 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include <strong_type/equality.hpp>
+#include <strong_type/implicitly_convertible_to.hpp>
+#include <strong_type/ordered.hpp>
+#include <strong_type/regular.hpp>
+#include <strong_type/type.hpp>
+
+#include "render_graph.hpp"
+#include "types.hpp"
+
+/**
+ * Texture atlas of many small images packed into the layers of a single 2D array image.
+ *
+ * Images are placed by a MaxRects packer, which tracks the maximal free rectangles of each layer,
+ * so images may be added and removed at any time without repacking those already placed. When no
+ * layer has room, a layer is added and the image is recreated with the extra layer, copying the
+ * existing layers across on the GPU.
+ *
+ * Each image is surrounded by a border of its own edge texels, so that bilinear filtering at its
+ * edges does not bleed in neighbouring images.
+ *
+ * Consumers draw images via their layer and normalised sub-rect, see batch::Instance, such that
+ * sprites spread across all layers share a single descriptor set and so a single draw.
+ */
+namespace vulkandemo::atlas
+{
+using ImageId = strong::type<
+	uint32_t,
+	struct TagForAtlasImageId,
+	strong::regular,
+	strong::implicitly_convertible_to<uint32_t, std::size_t>,
+	strong::equality,
+	strong::strongly_ordered>;
+
+/**
+ * Axis-aligned rectangle of texels.
+ */
+struct Rect
+{
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+
+	bool operator==(Rect const &) const = default;
+};
+
+/**
+ * Location of an image within the atlas.
+ */
+struct Placement
+{
+	uint32_t layer;
+	/// Texels of the image itself, excluding padding.
+	Rect rect;
+};
+
+/**
+ * Location of an image as used for drawing, see batch::make_rect_instance.
+ */
+struct AtlasEntry
+{
+	uint32_t layer;
+	/// Sub-rect (u0, v0, u1, v1) as 16-bit normalised texture coordinates.
+	std::array<uint16_t, 4> atlas_rect;
+};
+
+/**
+ * Incremental MaxRects packing of rectangles into equally sized layers.
+ *
+ * Each rectangle is placed in the first layer with room for it, at the free rectangle that leaves
+ * the shortest leftover side ("best short side fit"). Removed rectangles are immediately reusable,
+ * merged with neighbouring free space by extending them horizontally and vertically until they meet
+ * a remaining rectangle. This is cheap but leaves some free space unmerged, so before adding a
+ * layer, the free rectangles of layers with removals are recomputed from scratch.
+ */
+class AtlasPacker
+{
+public:
+	/**
+	 * @param layer_extent
+	 * @param max_layers Maximum number of layers to add before insertions fail.
+	 * @param padding Texels reserved around every rectangle.
+	 */
+	AtlasPacker(VkExtent2D layer_extent, uint32_t max_layers, uint32_t padding);
+
+	/**
+	 * Place a rectangle, adding a layer if no existing layer has room.
+	 *
+	 * @param extent Must be non-empty.
+	 * @return Identifier of the placement, or nullopt if the rectangle, plus padding, is larger
+	 * than a layer or all layers are full.
+	 */
+	std::optional<ImageId> insert(VkExtent2D extent);
+
+	/**
+	 * Free the space of a previously inserted rectangle.
+	 *
+	 * The identifier may be reused by subsequent insertions.
+	 *
+	 * @param image_id
+	 */
+	void remove(ImageId image_id);
+
+	/**
+	 * @param image_id
+	 * @return
+	 */
+	[[nodiscard]] Placement placement(ImageId image_id) const;
+
+	/**
+	 * Layers are only ever added, so that placements in existing layers stay valid.
+	 *
+	 * @return
+	 */
+	[[nodiscard]] uint32_t layer_count() const;
+
+	/**
+	 * @return Fraction of the area of all layers covered by rectangles, including padding.
+	 */
+	[[nodiscard]] double occupancy() const;
+
+private:
+	struct Layer
+	{
+		/// Free areas, possibly overlapping, none contained in another.
+		std::vector<Rect> free_rects;
+		/// Bounds of the widest and of the tallest free rect, to skip full layers quickly.
+		VkExtent2D max_free_extent;
+		/// Placed in this layer.
+		std::vector<ImageId> image_ids;
+		/// Whether rectangles have been removed since free_rects were last recomputed.
+		bool fragmented;
+	};
+
+	/// Including padding.
+	Placement const & padded_placement(ImageId image_id) const;
+	std::optional<Rect> find_free_rect(Layer const & layer, VkExtent2D extent) const;
+	void rebuild_free_rects(Layer & layer) const;
+
+
+	VkExtent2D layer_extent_;
+	uint32_t max_layers_;
+	uint32_t padding_;
+	std::vector<Layer> layers_;
+	/// Indexed by ImageId.
+	std::vector<std::optional<Placement>> placements_;
+	std::vector<ImageId> free_ids_;
+	uint64_t used_area_ = 0;
+};
+
+struct AtlasConfig
+{
+	VkExtent2D layer_extent = {1024, 1024};
+	/// An uncompressed colour format, e.g. R8G8B8A8_UNORM.
+	VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+	uint32_t max_layers = 16;
+	/// Border of extruded edge texels around every image.
+	uint32_t padding = 1;
+	/// Frames that may be in flight, after which replaced images and staging buffers are no longer
+	/// in use.
+	std::size_t frames_in_flight = 2;
+};
+
+/**
+ * Atlas of images in a device local 2D array image, uploaded via staging buffers.
+ *
+ * All member functions must be called from a single (render) thread.
+ */
+class TextureAtlas
+{
+public:
+	/**
+	 * Create the atlas with a single, empty layer.
+	 *
+	 * @param device Must have the synchronization2 feature enabled.
+	 * @param physical_device
+	 * @param staging_memory_type_idx Host visible and host coherent memory type.
+	 * @param config
+	 */
+	TextureAtlas(
+		types::VulkanDevicePtr device,
+		VkPhysicalDevice physical_device,
+		types::VulkanMemoryTypeIdx staging_memory_type_idx,
+		AtlasConfig config);
+
+	TextureAtlas(TextureAtlas const &) = delete;
+	TextureAtlas(TextureAtlas &&) = delete;
+	TextureAtlas & operator=(TextureAtlas const &) = delete;
+	TextureAtlas & operator=(TextureAtlas &&) = delete;
+
+	/**
+	 * Place an image and copy its texels, plus padding, ready for the next update.
+	 *
+	 * The image must not be sampled before the next update is submitted.
+	 *
+	 * @param extent
+	 * @param texels Tightly packed rows of texels in the atlas' format.
+	 * @return Identifier of the image, or nullopt if there is no room for it.
+	 */
+	std::optional<ImageId> add_image(VkExtent2D extent, std::span<std::byte const> texels);
+
+	/**
+	 * Free the space of an image, discarding its upload if still pending.
+	 *
+	 * The image must no longer be drawn, though frames already submitted may still sample it.
+	 *
+	 * @param image_id
+	 */
+	void remove_image(ImageId image_id);
+
+	/**
+	 * @param image_id
+	 * @return
+	 */
+	[[nodiscard]] AtlasEntry entry(ImageId image_id) const;
+
+	/**
+	 * @param image_id
+	 * @return Location of the image in texels.
+	 */
+	[[nodiscard]] Placement placement(ImageId image_id) const;
+
+	/**
+	 * Record growth of the image, if layers were added, and uploads of pending images, leaving the
+	 * image ready to sample from fragment and compute shaders.
+	 *
+	 * Call once per frame, before work that samples the atlas, outside of any render pass.
+	 *
+	 * @param command_buffer
+	 */
+	void populate_cmd_update(VkCommandBuffer command_buffer);
+
+	/**
+	 * @return Image of all layers, in shader read only layout between updates.
+	 */
+	[[nodiscard]] VkImage image() const;
+
+	/**
+	 * @return View of all layers, for a sampler2DArray.
+	 */
+	[[nodiscard]] VkImageView image_view() const;
+
+	/**
+	 * @return Incremented whenever the image view changes, i.e. descriptors must be rewritten.
+	 */
+	[[nodiscard]] uint64_t generation() const;
+
+	/**
+	 * @return Layers of the image, as of the last update.
+	 */
+	[[nodiscard]] uint32_t layer_count() const;
+
+	/**
+	 * @return See AtlasPacker::occupancy.
+	 */
+	[[nodiscard]] double occupancy() const;
+
+private:
+	struct Image
+	{
+		types::VulkanImagePtr image;
+		types::VulkanDeviceMemoryPtr memory;
+		types::VulkanImageViewPtr view;
+		uint32_t layer_count;
+	};
+
+	struct Staging
+	{
+		types::VulkanBufferPtr buffer;
+		types::VulkanDeviceMemoryPtr memory;
+	};
+
+	/// Padded texels of an added image, awaiting upload.
+	struct Pending
+	{
+		ImageId image_id;
+		std::vector<std::byte> texels;
+	};
+
+	struct Retired
+	{
+		uint64_t frame;
+		std::optional<Image> image;
+		std::optional<Staging> staging;
+	};
+
+	Image create_image(uint32_t layer_count) const;
+
+	types::VulkanDevicePtr device_;
+	VkPhysicalDevice physical_device_;
+	types::VulkanMemoryTypeIdx staging_memory_type_idx_;
+	AtlasConfig config_;
+	std::size_t texel_size_;
+	AtlasPacker packer_;
+	Image image_;
+	/// State of all layers of image_ since the last barrier recorded on it.
+	render_graph::ResourceState state_{};
+	std::vector<Pending> pending_;
+	std::vector<Retired> retired_;
+	uint64_t frame_ = 0;
+	uint64_t generation_ = 0;
+};
+
+/**
+ * Size of a texel of an atlas format.
+ *
+ * @param format
+ * @return
+ * @throws std::invalid_argument if the format is not supported by TextureAtlas.
+ */
+std::size_t texel_size(VkFormat format);
+
+/**
+ * Copy an image into the centre of a larger buffer, filling the border by clamping to its edges.
+ *
+ * @param extent
+ * @param texels Tightly packed rows of texels.
+ * @param texel_size
+ * @param padding Width of the border.
+ * @return Tightly packed rows of (width + 2 * padding) by (height + 2 * padding) texels.
+ */
+std::vector<std::byte> pad_image(
+	VkExtent2D extent, std::span<std::byte const> texels, std::size_t texel_size, uint32_t padding);
+}  // namespace vulkandemo::atlas
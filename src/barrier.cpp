@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "barrier.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vulkan_core.h>
+
+#include "render_graph.hpp"
+
+namespace vulkandemo::barrier
+{
+VkMemoryBarrier2 memory_barrier(
+	render_graph::ResourceState const & src, render_graph::ResourceState const & dst)
+{
+	return VkMemoryBarrier2{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+		.pNext = nullptr,
+		.srcStageMask = src.stages,
+		.srcAccessMask = src.access & kWriteAccess,
+		.dstStageMask = dst.stages,
+		.dstAccessMask = dst.access};
+}
+
+void merge_memory_barrier(
+	std::optional<VkMemoryBarrier2> & memory,
+	render_graph::ResourceState const & src,
+	render_graph::ResourceState const & dst)
+{
+	if (!memory)
+	{
+		memory = memory_barrier(src, dst);
+		return;
+	}
+	memory->srcStageMask |= src.stages;
+	memory->srcAccessMask |= src.access & kWriteAccess;
+	memory->dstStageMask |= dst.stages;
+	memory->dstAccessMask |= dst.access;
+}
+
+VkImageMemoryBarrier2 image_barrier(
+	VkImage image,
+	VkImageSubresourceRange const & range,
+	render_graph::ResourceState const & src,
+	render_graph::ResourceState const & dst)
+{
+	return VkImageMemoryBarrier2{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+		.pNext = nullptr,
+		.srcStageMask = src.stages,
+		.srcAccessMask = src.access & kWriteAccess,
+		.dstStageMask = dst.stages,
+		.dstAccessMask = dst.access,
+		.oldLayout = src.layout,
+		.newLayout = dst.layout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = range};
+}
+
+void populate_cmd_barriers(
+	VkCommandBuffer command_buffer,
+	std::optional<VkMemoryBarrier2> const & memory,
+	std::span<VkImageMemoryBarrier2 const> const images)
+{
+	if (!memory && images.empty())
+		return;
+
+	VkDependencyInfo const dependency_info{
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.pNext = nullptr,
+		.dependencyFlags = 0,
+		.memoryBarrierCount = memory ? 1U : 0U,
+		.pMemoryBarriers = memory ? &*memory : nullptr,
+		.bufferMemoryBarrierCount = 0,
+		.pBufferMemoryBarriers = nullptr,
+		.imageMemoryBarrierCount = static_cast<uint32_t>(images.size()),
+		.pImageMemoryBarriers = images.data()};
+	vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+}
+
+void populate_cmd_memory_barrier(
+	VkCommandBuffer command_buffer,
+	render_graph::ResourceState const & src,
+	render_graph::ResourceState const & dst)
+{
+	populate_cmd_barriers(command_buffer, memory_barrier(src, dst), {});
+}
+
+TEST_CASE("Build barriers between resource states")
+{
+	using render_graph::Access;
+	using render_graph::state_of;
+
+	SUBCASE("source access is reduced to writes")
+	{
+		VkMemoryBarrier2 const barrier = memory_barrier(
+			state_of(Access::kComputeShaderStorageReadWrite),
+			state_of(Access::kIndirectCommandRead));
+		CHECK(barrier.srcStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+		CHECK(barrier.srcAccessMask == VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+		CHECK(barrier.dstStageMask == VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT);
+		CHECK(barrier.dstAccessMask == VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+
+		// Write after read needs only an execution dependency.
+		CHECK(
+			memory_barrier(state_of(Access::kIndirectCommandRead), state_of(Access::kTransferWrite))
+				.srcAccessMask == VK_ACCESS_2_NONE);
+	}
+
+	SUBCASE("memory barriers merge")
+	{
+		std::optional<VkMemoryBarrier2> memory;
+		merge_memory_barrier(
+			memory, state_of(Access::kTransferWrite), state_of(Access::kComputeShaderStorageRead));
+		merge_memory_barrier(
+			memory, state_of(Access::kComputeShaderStorageWrite), state_of(Access::kHostRead));
+		REQUIRE(memory.has_value());
+		CHECK(
+			memory->srcStageMask ==
+			(VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT));
+		CHECK(
+			memory->srcAccessMask ==
+			(VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT));
+		CHECK(
+			memory->dstStageMask ==
+			(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_HOST_BIT));
+		CHECK(
+			memory->dstAccessMask ==
+			(VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_HOST_READ_BIT));
+	}
+
+	SUBCASE("image barriers transition layouts")
+	{
+		constexpr VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+		VkImageMemoryBarrier2 const barrier = image_barrier(
+			nullptr,
+			range,
+			state_of(Access::kColourAttachmentWrite),
+			state_of(Access::kTransferRead));
+		CHECK(barrier.oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		CHECK(barrier.newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		CHECK(barrier.srcAccessMask == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+		CHECK(barrier.dstAccessMask == VK_ACCESS_2_TRANSFER_READ_BIT);
+		CHECK(barrier.subresourceRange.levelCount == 1);
+	}
+}
+}  // namespace vulkandemo::barrier
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <optional>
+#include <span>
+
+#include <vulkan/vulkan_core.h>
+
+#include "render_graph.hpp"
+
+/**
+ * Construction of synchronization2 barriers between resource states, shared by modules that
+ * synchronise their own resources, e.g. render_graph, compute and cmd_list.
+ *
+ * The source access of every barrier is reduced to its writes, since only writes need making
+ * available; earlier reads need only the execution dependency given by the source stages.
+ */
+namespace vulkandemo::barrier
+{
+/// All access types that write, i.e. whose results must be made available before later access.
+inline constexpr VkAccessFlags2 kWriteAccess = VK_ACCESS_2_SHADER_WRITE_BIT |
+	VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT |
+	VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+/**
+ * Global memory barrier from one state to another.
+ *
+ * @param src
+ * @param dst
+ * @return
+ */
+VkMemoryBarrier2 memory_barrier(
+	render_graph::ResourceState const & src, render_graph::ResourceState const & dst);
+
+/**
+ * Merge a dependency into a global memory barrier, creating it if need be, so that several
+ * buffers are synchronised by a single barrier.
+ *
+ * @param memory
+ * @param src
+ * @param dst
+ */
+void merge_memory_barrier(
+	std::optional<VkMemoryBarrier2> & memory,
+	render_graph::ResourceState const & src,
+	render_graph::ResourceState const & dst);
+
+/**
+ * Image memory barrier from one state to another, transitioning from the source state's layout to
+ * the destination's.
+ *
+ * @param image
+ * @param range
+ * @param src
+ * @param dst
+ * @return
+ */
+VkImageMemoryBarrier2 image_barrier(
+	VkImage image,
+	VkImageSubresourceRange const & range,
+	render_graph::ResourceState const & src,
+	render_graph::ResourceState const & dst);
+
+/**
+ * Record barriers as a single dependency, or nothing if there are none.
+ *
+ * @param command_buffer
+ * @param memory
+ * @param images
+ */
+void populate_cmd_barriers(
+	VkCommandBuffer command_buffer,
+	std::optional<VkMemoryBarrier2> const & memory,
+	std::span<VkImageMemoryBarrier2 const> images);
+
+/**
+ * Record a global memory barrier from one state to another.
+ *
+ * @param command_buffer
+ * @param src
+ * @param dst
+ */
+void populate_cmd_memory_barrier(
+	VkCommandBuffer command_buffer,
+	render_graph::ResourceState const & src,
+	render_graph::ResourceState const & dst);
+}  // namespace vulkandemo::barrier
@@ -0,0 +1,694 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "batch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <range/v3/range/conversion.hpp>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner)
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `VK_CHECK`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "bench.hpp"
+#include "draw.hpp"
+#include "macros.hpp"
+#include "setup.hpp"
+#include "shaders.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::batch
+{
+namespace
+{
+/**
+ * Create the sprite pipelines for either subpass 0 of a render pass, or dynamic rendering as
+ * described by a VkPipelineRenderingCreateInfo passed as @p next.
+ */
+SpritePipelines create_sprite_pipelines_impl(
+	types::VulkanDevicePtr const & device, VkRenderPass render_pass, void const * next)
+{
+	types::VulkanDescriptorSetLayoutPtr texture_set_layout = [&]
+	{
+		constexpr VkDescriptorSetLayoutBinding binding{
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.pImmutableSamplers = nullptr};
+
+		VkDescriptorSetLayoutCreateInfo const create_info{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.bindingCount = 1,
+			.pBindings = &binding};
+
+		VkDescriptorSetLayout out = nullptr;
+		VK_CHECK(
+			vkCreateDescriptorSetLayout(device.get(), &create_info, nullptr, &out),
+			"Failed to create descriptor set layout");
+		return types::make_descriptor_set_layout_ptr(device, out);
+	}();
+
+	// Framebuffer extent as 2/width, 2/height, see sprite.vert.
+	constexpr VkPushConstantRange push_constant_range{
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .offset = 0, .size = 2 * sizeof(float)};
+
+	types::VulkanPipelineLayoutPtr layout = setup::create_pipeline_layout(
+		device, {{texture_set_layout.get()}}, {{push_constant_range}});
+
+	types::VulkanShaderModulePtr const vert_module =
+		setup::create_shader_module(device, shaders::kSpriteVert);
+	types::VulkanShaderModulePtr const solid_frag_module =
+		setup::create_shader_module(device, shaders::kSpriteSolidFrag);
+	types::VulkanShaderModulePtr const textured_frag_module =
+		setup::create_shader_module(device, shaders::kSpriteTexturedFrag);
+	types::VulkanShaderModulePtr const textured_array_frag_module =
+		setup::create_shader_module(device, shaders::kSpriteTexturedArrayFrag);
+
+	auto const make_stages = [&](types::VulkanShaderModulePtr const & frag_module)
+	{
+		return std::array{
+			VkPipelineShaderStageCreateInfo{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_VERTEX_BIT,
+				.module = vert_module.get(),
+				.pName = "main"},
+			VkPipelineShaderStageCreateInfo{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+				.module = frag_module.get(),
+				.pName = "main"}};
+	};
+	std::array const solid_stages = make_stages(solid_frag_module);
+	std::array const textured_stages = make_stages(textured_frag_module);
+	std::array const textured_array_stages = make_stages(textured_array_frag_module);
+
+	// Single binding stepped per instance, see Instance.
+	constexpr VkVertexInputBindingDescription instance_binding{
+		.binding = 0, .stride = sizeof(Instance), .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE};
+
+	constexpr std::array instance_attributes{
+		VkVertexInputAttributeDescription{
+			.location = 0,
+			.binding = 0,
+			.format = VK_FORMAT_R32G32_SFLOAT,
+			.offset = offsetof(Instance, basis_x)},
+		VkVertexInputAttributeDescription{
+			.location = 1,
+			.binding = 0,
+			.format = VK_FORMAT_R32G32_SFLOAT,
+			.offset = offsetof(Instance, basis_y)},
+		VkVertexInputAttributeDescription{
+			.location = 2,
+			.binding = 0,
+			.format = VK_FORMAT_R32G32_SFLOAT,
+			.offset = offsetof(Instance, translation)},
+		VkVertexInputAttributeDescription{
+			.location = 3,
+			.binding = 0,
+			.format = VK_FORMAT_R16G16B16A16_UNORM,
+			.offset = offsetof(Instance, atlas_rect)},
+		VkVertexInputAttributeDescription{
+			.location = 4,
+			.binding = 0,
+			.format = VK_FORMAT_R8G8B8A8_UNORM,
+			.offset = offsetof(Instance, colour)},
+		VkVertexInputAttributeDescription{
+			.location = 5,
+			.binding = 0,
+			.format = VK_FORMAT_R32_UINT,
+			.offset = offsetof(Instance, layer)}};
+
+	VkPipelineVertexInputStateCreateInfo const vertex_input_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+		.vertexBindingDescriptionCount = 1,
+		.pVertexBindingDescriptions = &instance_binding,
+		.vertexAttributeDescriptionCount = static_cast<uint32_t>(instance_attributes.size()),
+		.pVertexAttributeDescriptions = instance_attributes.data()};
+
+	constexpr VkPipelineInputAssemblyStateCreateInfo input_assembly_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+		.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+		.primitiveRestartEnable = VK_FALSE};
+
+	// Viewport and scissor are dynamic, see populate_cmd_render_pass.
+	constexpr VkPipelineViewportStateCreateInfo viewport_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+		.viewportCount = 1,
+		.scissorCount = 1};
+
+	constexpr VkPipelineRasterizationStateCreateInfo rasterization_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+		.polygonMode = VK_POLYGON_MODE_FILL,
+		// Quads may be mirrored by their transform.
+		.cullMode = VK_CULL_MODE_NONE,
+		.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+		.lineWidth = 1.0F};
+
+	constexpr VkPipelineMultisampleStateCreateInfo multisample_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT};
+
+	// Conventional (non-premultiplied) alpha blending.
+	constexpr VkPipelineColorBlendAttachmentState colour_blend_attachment{
+		.blendEnable = VK_TRUE,
+		.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+		.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+		.colorBlendOp = VK_BLEND_OP_ADD,
+		.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+		.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+		.alphaBlendOp = VK_BLEND_OP_ADD,
+		// NOLINTNEXTLINE(*-signed-bitwise)
+		.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+			VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT};
+
+	VkPipelineColorBlendStateCreateInfo const colour_blend_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+		.attachmentCount = 1,
+		.pAttachments = &colour_blend_attachment};
+
+	constexpr std::array dynamic_states{VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+	VkPipelineDynamicStateCreateInfo const dynamic_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+		.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size()),
+		.pDynamicStates = dynamic_states.data()};
+
+	VkGraphicsPipelineCreateInfo pipeline_create_info{
+		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.pNext = next,
+		.stageCount = static_cast<uint32_t>(solid_stages.size()),
+		.pStages = nullptr,	 // Will be updated per-pipeline, see below.
+		.pVertexInputState = &vertex_input_state,
+		.pInputAssemblyState = &input_assembly_state,
+		.pViewportState = &viewport_state,
+		.pRasterizationState = &rasterization_state,
+		.pMultisampleState = &multisample_state,
+		.pColorBlendState = &colour_blend_state,
+		.pDynamicState = &dynamic_state,
+		.layout = layout.get(),
+		.renderPass = render_pass,
+		.subpass = 0};
+
+	std::array<VkGraphicsPipelineCreateInfo, 3> pipeline_create_infos{
+		pipeline_create_info, pipeline_create_info, pipeline_create_info};
+	pipeline_create_infos[0].pStages = solid_stages.data();
+	pipeline_create_infos[1].pStages = textured_stages.data();
+	pipeline_create_infos[2].pStages = textured_array_stages.data();
+
+	std::array<VkPipeline, 3> pipelines{};
+	VK_CHECK(
+		vkCreateGraphicsPipelines(
+			device.get(),
+			nullptr,
+			static_cast<uint32_t>(pipeline_create_infos.size()),
+			pipeline_create_infos.data(),
+			nullptr,
+			pipelines.data()),
+		"Failed to create sprite pipelines");
+
+	return SpritePipelines{
+		.texture_set_layout = std::move(texture_set_layout),
+		.layout = std::move(layout),
+		.solid = types::make_pipeline_ptr(device, pipelines[0]),
+		.textured = types::make_pipeline_ptr(device, pipelines[1]),
+		.textured_array = types::make_pipeline_ptr(device, pipelines[2])};
+}
+}  // namespace
+
+SpritePipelines create_sprite_pipelines(
+	types::VulkanDevicePtr const & device, types::VulkanRenderPassPtr const & render_pass)
+{
+	return create_sprite_pipelines_impl(device, render_pass.get(), nullptr);
+}
+
+SpritePipelines create_sprite_pipelines(
+	types::VulkanDevicePtr const & device, VkFormat const colour_format)
+{
+	VkPipelineRenderingCreateInfo const rendering_create_info{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+		.pNext = nullptr,
+		.viewMask = 0,
+		.colorAttachmentCount = 1,
+		.pColorAttachmentFormats = &colour_format,
+		.depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+		.stencilAttachmentFormat = VK_FORMAT_UNDEFINED};
+	return create_sprite_pipelines_impl(device, nullptr, &rendering_create_info);
+}
+
+SpriteBatch create_sprite_batch(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx const memory_type_idx,
+	InstanceCount const capacity)
+{
+	auto [buffer, memory, mapped] = draw::create_exclusive_mapped_buffer_and_memory(
+		device,
+		memory_type_idx,
+		static_cast<std::size_t>(capacity) * sizeof(Instance),
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+
+	SpriteBatch batch{
+		.instance_buffer = std::move(buffer),
+		.instance_memory = std::move(memory),
+		.mapped_instances = std::span{
+			// NOLINTNEXTLINE(*-reinterpret-cast)
+			reinterpret_cast<Instance *>(mapped.data()),
+			static_cast<std::size_t>(capacity)},
+		.pending_instances = {},
+		.pending_runs = {},
+		.runs = {}};
+	batch.pending_instances.reserve(capacity);
+	return batch;
+}
+
+void clear_sprite_batch(SpriteBatch & batch)
+{
+	batch.pending_instances.clear();
+	batch.pending_runs.clear();
+	batch.runs.clear();
+}
+
+void push_sprite_instances(
+	SpriteBatch & batch, DrawState const & state, std::span<Instance const> const instances)
+{
+	if (instances.empty())
+		return;
+
+	if (batch.pending_instances.size() + instances.size() > batch.mapped_instances.size())
+		throw std::runtime_error{std::format(
+			"Sprite batch capacity of {} instances exceeded", batch.mapped_instances.size())};
+
+	auto const first_instance = static_cast<uint32_t>(batch.pending_instances.size());
+	batch.pending_instances.insert(
+		batch.pending_instances.end(), instances.begin(), instances.end());
+
+	if (!batch.pending_runs.empty() && batch.pending_runs.back().state == state)
+		batch.pending_runs.back().instance_count += static_cast<uint32_t>(instances.size());
+	else
+		batch.pending_runs.push_back(DrawRun{
+			.state = state,
+			.first_instance = first_instance,
+			.instance_count = static_cast<uint32_t>(instances.size())});
+}
+
+std::span<DrawRun const> finalise_sprite_batch(SpriteBatch & batch)
+{
+	// Stable, so that instances with equal state retain submission (i.e. painter's) order.
+	std::ranges::stable_sort(batch.pending_runs, {}, &DrawRun::state);
+
+	batch.runs.clear();
+	uint32_t mapped_idx = 0;
+	for (DrawRun const & pending_run : batch.pending_runs)
+	{
+		// Single sequential write into (possibly write-combined) mapped memory.
+		std::ranges::copy(
+			std::span{batch.pending_instances}.subspan(
+				pending_run.first_instance, pending_run.instance_count),
+			std::next(batch.mapped_instances.begin(), mapped_idx));
+
+		if (!batch.runs.empty() && batch.runs.back().state == pending_run.state)
+			batch.runs.back().instance_count += pending_run.instance_count;
+		else
+			batch.runs.push_back(DrawRun{
+				.state = pending_run.state,
+				.first_instance = mapped_idx,
+				.instance_count = pending_run.instance_count});
+
+		mapped_idx += pending_run.instance_count;
+	}
+
+	return batch.runs;
+}
+
+void populate_cmd_sprite_batch(
+	VkCommandBuffer command_buffer,
+	SpriteBatch const & batch,
+	types::VulkanPipelineLayoutPtr const & pipeline_layout,
+	VkExtent2D const extent)
+{
+	if (batch.runs.empty())
+		return;
+
+	VkBuffer instance_buffer = batch.instance_buffer.get();
+	constexpr VkDeviceSize instance_buffer_offset = 0;
+	vkCmdBindVertexBuffers(command_buffer, 0, 1, &instance_buffer, &instance_buffer_offset);
+
+	// Push constants remain valid across binds of pipelines with the same layout.
+	std::array const inv_half_extent{
+		2.0F / static_cast<float>(extent.width), 2.0F / static_cast<float>(extent.height)};
+	vkCmdPushConstants(
+		command_buffer,
+		pipeline_layout.get(),
+		VK_SHADER_STAGE_VERTEX_BIT,
+		0,
+		sizeof(inv_half_extent),
+		inv_half_extent.data());
+
+	VkPipeline bound_pipeline = nullptr;
+	VkDescriptorSet bound_texture = nullptr;
+	for (DrawRun const & run : batch.runs)
+	{
+		if (run.state.pipeline != bound_pipeline)
+		{
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, run.state.pipeline);
+			bound_pipeline = run.state.pipeline;
+		}
+		if (run.state.texture != nullptr && run.state.texture != bound_texture)
+		{
+			vkCmdBindDescriptorSets(
+				command_buffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipeline_layout.get(),
+				0,
+				1,
+				&run.state.texture,
+				0,
+				nullptr);
+			bound_texture = run.state.texture;
+		}
+		// Unit quad as a triangle strip, see sprite.vert.
+		vkCmdDraw(command_buffer, 4, run.instance_count, 0, run.first_instance);
+	}
+}
+
+TEST_CASE("Sort and merge sprite batch runs")
+{
+	// Host memory stands in for the mapped instance buffer.
+	std::vector<Instance> host_instances(8);
+	SpriteBatch batch{.mapped_instances = host_instances};
+
+	// Fake handles, only compared, never dereferenced.
+	// NOLINTBEGIN(*-reinterpret-cast, performance-no-int-to-ptr)
+	DrawState const state_a{.pipeline = reinterpret_cast<VkPipeline>(0x1), .texture = nullptr};
+	DrawState const state_b{.pipeline = reinterpret_cast<VkPipeline>(0x2), .texture = nullptr};
+	// NOLINTEND(*-reinterpret-cast, performance-no-int-to-ptr)
+
+	auto const instance_with_colour = [](uint32_t const colour)
+	{ return make_rect_instance(0, 0, 1, 1, colour); };
+
+	push_sprite_instances(batch, state_b, {{instance_with_colour(0), instance_with_colour(1)}});
+	push_sprite_instances(batch, state_a, {{instance_with_colour(2)}});
+	// Extends previous run.
+	push_sprite_instances(batch, state_a, {{instance_with_colour(3)}});
+	push_sprite_instances(batch, state_b, {{instance_with_colour(4)}});
+
+	CHECK(batch.pending_runs.size() == 3);
+
+	std::span<DrawRun const> const runs = finalise_sprite_batch(batch);
+
+	REQUIRE(runs.size() == 2);
+	CHECK(runs[0].state == state_a);
+	CHECK(runs[0].first_instance == 0);
+	CHECK(runs[0].instance_count == 2);
+	CHECK(runs[1].state == state_b);
+	CHECK(runs[1].first_instance == 2);
+	CHECK(runs[1].instance_count == 3);
+
+	// Submission order retained within a state.
+	std::array<uint32_t, 5> colours{};
+	std::ranges::copy(
+		host_instances | std::views::take(colours.size()) |
+			std::views::transform(&Instance::colour),
+		colours.begin());
+	CHECK(colours == std::array<uint32_t, 5>{2, 3, 0, 1, 4});
+
+	SUBCASE("capacity exceeded")
+	{
+		std::vector const too_many(host_instances.size(), instance_with_colour(0));
+		CHECK_THROWS_AS(push_sprite_instances(batch, state_a, too_many), std::runtime_error);
+	}
+
+	SUBCASE("clear")
+	{
+		clear_sprite_batch(batch);
+		CHECK(batch.pending_runs.empty());
+		CHECK(finalise_sprite_batch(batch).empty());
+	}
+}
+
+TEST_CASE("Populate render pass with sprite batch")
+{
+	vulkandemo::LoggerPtr const logger =
+		vulkandemo::create_logger("Populate render pass with sprite batch");
+	types::SDLWindowPtr const window = setup::create_window("", 64, 64);
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		window,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+	types::VulkanSurfacePtr const surface = setup::create_surface(window, instance);
+
+	constexpr VkMemoryPropertyFlags memory_flags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{types::DesiredDeviceExtensionNameView{VK_KHR_SWAPCHAIN_EXTENSION_NAME}},
+		VK_QUEUE_GRAPHICS_BIT,
+		memory_flags,
+		surface);
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{{types::AvailableDeviceExtensionNameView{VK_KHR_SWAPCHAIN_EXTENSION_NAME}}});
+
+	std::vector<VkSurfaceFormatKHR> const available_formats =
+		setup::filter_available_surface_formats(
+			logger,
+			physical_device,
+			surface,
+			{{VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_B8G8R8A8_UNORM}});
+
+	auto [swapchain, image_views] = setup::create_exclusive_double_buffer_swapchain_and_image_views(
+		logger, physical_device, device, surface, available_formats.at(0));
+
+	auto const render_pass = setup::create_single_presentation_subpass_render_pass(
+		available_formats.at(0).format, device);
+
+	VkExtent2D const drawable_size = setup::window_drawable_size(window);
+
+	std::vector<types::VulkanFramebufferPtr> const frame_buffers =
+		setup::create_per_image_frame_buffers(device, render_pass, image_views, drawable_size);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	SpritePipelines const pipelines = create_sprite_pipelines(device, render_pass);
+
+	CHECK(pipelines.texture_set_layout);
+	CHECK(pipelines.layout);
+	CHECK(pipelines.solid);
+	CHECK(pipelines.textured);
+	CHECK(pipelines.textured_array);
+
+	SpriteBatch batch = create_sprite_batch(
+		device,
+		setup::filter_available_memory_types(logger, physical_device, memory_flags).at(0),
+		InstanceCount{16});
+
+	std::vector<Instance> const instances{
+		make_rect_instance(0, 0, 32, 32, pack_colour(1, 0, 0, 1)),
+		make_rect_instance(32, 32, 32, 32, pack_colour(0, 1, 0, 0.5F))};
+	push_sprite_instances(
+		batch, {.pipeline = pipelines.solid.get(), .texture = nullptr}, instances);
+
+	CHECK(finalise_sprite_batch(batch).size() == 1);
+
+	std::array const recorders{draw::SubpassRecorder{
+		[&](VkCommandBuffer command_buffer, VkExtent2D const extent)
+		{ populate_cmd_sprite_batch(command_buffer, batch, pipelines.layout, extent); }}};
+
+	auto const image_available_semaphore = setup::create_semaphore(device);
+	auto const maybe_image_idx =
+		draw::acquire_next_swapchain_image(device, swapchain, image_available_semaphore);
+	REQUIRE(maybe_image_idx);
+	auto const image_idx = maybe_image_idx.value();	 // NOLINT(bugprone-unchecked-optional-access)
+
+	VkCommandBuffer command_buffer = command_buffers->front();
+	draw::populate_cmd_render_pass(
+		command_buffer,
+		render_pass,
+		frame_buffers.at(image_idx),
+		drawable_size,
+		types::VulkanClearColour{std::array{.0F, .0F, .0F, 1.0F}},
+		recorders);
+
+	draw::submit_command_buffer(queue, command_buffer, image_available_semaphore, nullptr);
+	VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+}
+
+TEST_CASE("Benchmark sprite batch" * doctest::test_suite("benchmark") * doctest::skip())
+{
+	vulkandemo::LoggerPtr const logger = vulkandemo::create_logger("Benchmark sprite batch");
+	types::SDLWindowPtr const window = setup::create_window("", 1024, 1024);
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(logger, window, {}, {});
+	types::VulkanSurfacePtr const surface = setup::create_surface(window, instance);
+
+	constexpr VkMemoryPropertyFlags memory_flags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{types::DesiredDeviceExtensionNameView{VK_KHR_SWAPCHAIN_EXTENSION_NAME}},
+		VK_QUEUE_GRAPHICS_BIT,
+		memory_flags,
+		surface);
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{{types::AvailableDeviceExtensionNameView{VK_KHR_SWAPCHAIN_EXTENSION_NAME}}});
+
+	std::vector<VkSurfaceFormatKHR> const available_formats =
+		setup::filter_available_surface_formats(
+			logger,
+			physical_device,
+			surface,
+			{{VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_B8G8R8A8_UNORM}});
+
+	auto [swapchain, image_views] = setup::create_exclusive_double_buffer_swapchain_and_image_views(
+		logger, physical_device, device, surface, available_formats.at(0));
+
+	auto const render_pass = setup::create_single_presentation_subpass_render_pass(
+		available_formats.at(0).format, device);
+
+	VkExtent2D const drawable_size = setup::window_drawable_size(window);
+
+	std::vector<types::VulkanFramebufferPtr> const frame_buffers =
+		setup::create_per_image_frame_buffers(device, render_pass, image_views, drawable_size);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	SpritePipelines const pipelines = create_sprite_pipelines(device, render_pass);
+
+	// Acquire a single image and re-render into it for every timed run. An acquired image remains
+	// owned by the application until presented, so only the first submission need wait.
+	auto const image_available_semaphore = setup::create_semaphore(device);
+	auto const maybe_image_idx =
+		draw::acquire_next_swapchain_image(device, swapchain, image_available_semaphore);
+	REQUIRE(maybe_image_idx);
+	types::VulkanFramebufferPtr const & frame_buffer =
+		frame_buffers.at(maybe_image_idx.value());	// NOLINT(bugprone-unchecked-optional-access)
+	{
+		VkCommandBuffer command_buffer = command_buffers->front();
+		draw::populate_cmd_render_pass(
+			command_buffer,
+			render_pass,
+			frame_buffer,
+			drawable_size,
+			types::VulkanClearColour{std::array{.0F, .0F, .0F, 1.0F}});
+		draw::submit_command_buffer(queue, command_buffer, image_available_semaphore, nullptr);
+		VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+	}
+
+	constexpr std::size_t kIterations = 20;
+	constexpr std::size_t kInstancesPerRun = 64;
+
+	for (std::size_t const instance_count : {10'000UZ, 100'000UZ, 1'000'000UZ})
+	{
+		SpriteBatch batch = create_sprite_batch(
+			device,
+			setup::filter_available_memory_types(logger, physical_device, memory_flags).at(0),
+			InstanceCount{static_cast<uint32_t>(instance_count)});
+
+		std::vector<Instance> const instances = std::views::iota(0UZ, instance_count) |
+			std::views::transform(
+				[&](std::size_t const idx)
+				{
+					return make_rect_instance(
+						static_cast<float>(idx % drawable_size.width),
+						static_cast<float>((idx / drawable_size.width) % drawable_size.height),
+						4,
+						4,
+						pack_colour(1, 1, 1, 0.1F));
+				}) |
+			ranges::to<std::vector>();
+
+		// Interleave states so that finalise has to sort. Only the solid pipeline can be drawn
+		// without a texture bound, so the textured state is used for the host-side timing only.
+		std::array const states{
+			DrawState{.pipeline = pipelines.textured.get(), .texture = nullptr},
+			DrawState{.pipeline = pipelines.solid.get(), .texture = nullptr}};
+
+		double const pack_ms = bench::mean_ms(
+			kIterations,
+			[&]
+			{
+				clear_sprite_batch(batch);
+				for (std::size_t offset = 0; offset < instance_count; offset += kInstancesPerRun)
+					push_sprite_instances(
+						batch,
+						states[(offset / kInstancesPerRun) % states.size()],
+						std::span{instances}.subspan(
+							offset, std::min(kInstancesPerRun, instance_count - offset)));
+				finalise_sprite_batch(batch);
+			});
+
+		clear_sprite_batch(batch);
+		push_sprite_instances(batch, states[1], instances);
+		finalise_sprite_batch(batch);
+
+		std::array const recorders{draw::SubpassRecorder{
+			[&](VkCommandBuffer command_buffer, VkExtent2D const extent)
+			{ populate_cmd_sprite_batch(command_buffer, batch, pipelines.layout, extent); }}};
+
+		double const draw_ms = bench::mean_ms(
+			kIterations,
+			[&]
+			{
+				VkCommandBuffer command_buffer = command_buffers->front();
+				draw::populate_cmd_render_pass(
+					command_buffer,
+					render_pass,
+					frame_buffer,
+					drawable_size,
+					types::VulkanClearColour{std::array{.0F, .0F, .0F, 1.0F}},
+					recorders);
+				draw::submit_command_buffer(queue, command_buffer, nullptr, nullptr);
+				VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+			});
+
+		logger->info(
+			"{} instances: pack {:.3f} ms ({:.0f} instances/ms), record+draw {:.3f} ms ({:.0f} "
+			"instances/ms)",
+			instance_count,
+			pack_ms,
+			static_cast<double>(instance_count) / pack_ms,
+			draw_ms,
+			static_cast<double>(instance_count) / draw_ms);
+	}
+}
+}  // namespace vulkandemo::batch
@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <algorithm>
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include <strong_type/equality.hpp>
+#include <strong_type/equality_with.hpp>
+#include <strong_type/implicitly_convertible_to.hpp>
+#include <strong_type/ordered.hpp>
+#include <strong_type/regular.hpp>
+#include <strong_type/type.hpp>
+
+#include "types.hpp"
+
+/**
+ * Instanced quad (sprite) batching.
+ *
+ * Instances are accumulated on the host tagged with the pipeline and texture to draw them with,
+ * then sorted by that state and written in one sequential pass into a persistently mapped instance
+ * buffer. Recording then issues one instanced draw per distinct state.
+ */
+namespace vulkandemo::batch
+{
+using InstanceCount = strong::type<
+	uint32_t,
+	struct TagForSpriteInstanceCount,
+	strong::regular,
+	strong::implicitly_convertible_to<uint32_t, std::size_t>,
+	strong::equality,
+	strong::equality_with<uint32_t, std::size_t>,
+	strong::strongly_ordered>;
+
+/**
+ * Per-instance data of a single quad, laid out to match the vertex input of `sprite.vert`.
+ *
+ * The unit quad is transformed by the 2x3 affine matrix (basis_x, basis_y, translation) into
+ * framebuffer pixels.
+ */
+struct Instance
+{
+	std::array<float, 2> basis_x;
+	std::array<float, 2> basis_y;
+	std::array<float, 2> translation;
+	/// Atlas sub-rect (u0, v0, u1, v1) as 16-bit normalised texture coordinates.
+	std::array<uint16_t, 4> atlas_rect;
+	/// RGBA8 colour, see pack_colour.
+	uint32_t colour;
+	/// Array layer sampled by the textured array pipeline, see atlas::TextureAtlas.
+	uint32_t layer;
+};
+static_assert(sizeof(Instance) == 40);
+
+/// Atlas rect covering the whole texture.
+inline constexpr std::array<uint16_t, 4> kFullAtlasRect{0, 0, UINT16_MAX, UINT16_MAX};
+
+/**
+ * Pack a colour of [0, 1] components into the R8G8B8A8_UNORM layout used by Instance::colour.
+ */
+constexpr uint32_t pack_colour(
+	float const red, float const green, float const blue, float const alpha)
+{
+	auto const to_byte = [](float const fraction)
+	{ return static_cast<uint32_t>(std::clamp(fraction, 0.0F, 1.0F) * 255.0F + 0.5F); };
+	return to_byte(red) | (to_byte(green) << 8U) | (to_byte(blue) << 16U) |
+		(to_byte(alpha) << 24U);
+}
+
+/**
+ * Construct an axis-aligned rectangle instance.
+ *
+ * @param x Left edge, in pixels.
+ * @param y Top edge, in pixels.
+ * @param width
+ * @param height
+ * @param colour See pack_colour.
+ * @param atlas_rect See Instance::atlas_rect.
+ * @param layer See Instance::layer.
+ * @return
+ */
+constexpr Instance make_rect_instance(
+	float const x,
+	float const y,
+	float const width,
+	float const height,
+	uint32_t const colour,
+	std::array<uint16_t, 4> const & atlas_rect = kFullAtlasRect,
+	uint32_t const layer = 0)
+{
+	return Instance{
+		.basis_x = {width, 0},
+		.basis_y = {0, height},
+		.translation = {x, y},
+		.atlas_rect = atlas_rect,
+		.colour = colour,
+		.layer = layer};
+}
+
+/**
+ * Pipeline and texture that instances are drawn with.
+ *
+ * Ordering defines the order in which batched draws are recorded.
+ */
+struct DrawState
+{
+	VkPipeline pipeline;
+	/// Descriptor set for set 0 of a textured pipeline, or nullptr for untextured pipelines.
+	VkDescriptorSet texture;
+
+	auto operator<=>(DrawState const &) const = default;
+};
+
+/**
+ * A contiguous range of instances that share a DrawState.
+ */
+struct DrawRun
+{
+	DrawState state;
+	uint32_t first_instance;
+	uint32_t instance_count;
+};
+
+/**
+ * Pipelines compatible with the sprite instance layout, sharing a single pipeline layout.
+ */
+struct SpritePipelines
+{
+	/// Layout of set 0 of the textured pipelines: a single combined image sampler.
+	types::VulkanDescriptorSetLayoutPtr texture_set_layout;
+	/// Shared layout, with vertex stage push constants for the framebuffer extent.
+	types::VulkanPipelineLayoutPtr layout;
+	/// Draws instances with their colour only.
+	types::VulkanPipelinePtr solid;
+	/// Modulates instance colour by a sample of the bound texture.
+	types::VulkanPipelinePtr textured;
+	/// Modulates instance colour by a sample of the instance's layer of the bound array texture,
+	/// so that images spread across the layers of an atlas are drawn by a single draw.
+	types::VulkanPipelinePtr textured_array;
+};
+
+/**
+ * Host-side accumulation of instances plus the mapped device buffer they are packed into.
+ *
+ * The instance buffer is single-buffered, so the caller must not finalise whilst a previous
+ * frame's draws may still be in flight.
+ */
+struct SpriteBatch
+{
+	types::VulkanBufferPtr instance_buffer;
+	types::VulkanDeviceMemoryPtr instance_memory;
+	/// Persistently mapped view of instance_memory. Write only - may be write-combined memory.
+	std::span<Instance> mapped_instances;
+	/// Instances in submission order.
+	std::vector<Instance> pending_instances;
+	/// Runs of pending_instances, in submission order.
+	std::vector<DrawRun> pending_runs;
+	/// Sorted and merged runs into mapped_instances, as of the last finalise.
+	std::vector<DrawRun> runs;
+};
+
+/**
+ * Create the sprite pipelines for subpass 0 of a render pass.
+ *
+ * Viewport and scissor are dynamic state.
+ *
+ * @param device
+ * @param render_pass
+ * @return
+ */
+SpritePipelines create_sprite_pipelines(
+	types::VulkanDevicePtr const & device, types::VulkanRenderPassPtr const & render_pass);
+
+/**
+ * Create the sprite pipelines for dynamic rendering to a single colour attachment, e.g. within a
+ * render_graph pass.
+ *
+ * Viewport and scissor are dynamic state.
+ *
+ * @param device
+ * @param colour_format
+ * @return
+ */
+SpritePipelines create_sprite_pipelines(
+	types::VulkanDevicePtr const & device, VkFormat colour_format);
+
+/**
+ * Create a sprite batch with a persistently mapped instance buffer.
+ *
+ * @param device
+ * @param memory_type_idx Host visible and host coherent memory type.
+ * @param capacity Maximum number of instances per frame.
+ * @return
+ */
+SpriteBatch create_sprite_batch(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx memory_type_idx,
+	InstanceCount capacity);
+
+/**
+ * Discard all pending instances and runs, ready for a new frame.
+ *
+ * @param batch
+ */
+void clear_sprite_batch(SpriteBatch & batch);
+
+/**
+ * Append instances to be drawn with the given state.
+ *
+ * Consecutive pushes with the same state extend the same run, so pushing in state order is
+ * cheapest.
+ *
+ * @param batch
+ * @param state
+ * @param instances
+ */
+void push_sprite_instances(
+	SpriteBatch & batch, DrawState const & state, std::span<Instance const> instances);
+
+/**
+ * Sort pending runs by state and pack them into the mapped instance buffer.
+ *
+ * @param batch
+ * @return The merged draw runs, one per distinct state.
+ */
+std::span<DrawRun const> finalise_sprite_batch(SpriteBatch & batch);
+
+/**
+ * Record the finalised draw runs of a batch, one instanced draw per run.
+ *
+ * Must be recorded within subpass 0 of the render pass the pipelines were created for.
+ *
+ * @param command_buffer
+ * @param batch
+ * @param pipeline_layout Layout shared by all pipelines referenced by the batch.
+ * @param extent Framebuffer extent, to map pixels to normalised device coordinates.
+ */
+void populate_cmd_sprite_batch(
+	VkCommandBuffer command_buffer,
+	SpriteBatch const & batch,
+	types::VulkanPipelineLayoutPtr const & pipeline_layout,
+	VkExtent2D extent);
+}  // namespace vulkandemo::batch
@@ -0,0 +1,1365 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "bc.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner)
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `string_VkFormat`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "bench.hpp"
+#include "parallel.hpp"
+#include "setup.hpp"
+#include "simd.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::bc
+{
+namespace
+{
+constexpr std::size_t kBlockTexels = std::size_t{kBlockSize} * kBlockSize;
+constexpr std::size_t kChannelCount = 4;
+
+using Colour = std::array<float, kChannelCount>;
+using Indices = std::array<uint8_t, kBlockTexels>;
+using Errors = std::array<float, kBlockTexels>;
+
+constexpr Colour kRgbWeights{1.0F, 1.0F, 1.0F, 0.0F};
+constexpr Colour kRgbaWeights{1.0F, 1.0F, 1.0F, 1.0F};
+
+/**
+ * Texels of a block as structure-of-arrays, one row per channel, with values in [0, 255].
+ */
+struct alignas(32) Block
+{
+	std::array<std::array<float, kBlockTexels>, kChannelCount> channels;
+};
+
+/**
+ * Evenly spaced points on a line segment through colour space, as interpolated by a decoder.
+ */
+struct Ramp
+{
+	Colour start;
+	/// End minus start.
+	Colour delta;
+	/// Direction scaled such that projecting a texel's offset from `start` gives its (fractional)
+	/// point index.
+	Colour axis;
+	/// Per channel weights of squared errors, zero for ignored channels.
+	Colour weights;
+	/// Number of points less one.
+	float max_index;
+	/// Reciprocal of max_index.
+	float step;
+};
+
+/**
+ * Assign each texel of a block to the nearest point of a ramp, by projection onto its axis.
+ *
+ * Errors are returned per texel and summed by the caller, so that totals, and therefore encoding
+ * decisions, are identical across kernels.
+ */
+using FitKernel =
+	void (*)(Block const & block, Ramp const & ramp, Indices & indices, Errors & errors);
+
+/**
+ * Encode a block to its span of the output.
+ */
+using BlockEncoder = void (*)(Block const & block, FitKernel fit, std::span<std::byte> out);
+
+// All kernels project and accumulate errors with the same sequence of (unfused) multiplies and
+// adds, and round by truncating after clamping to be non-negative, so results are identical across
+// kernels.
+
+void fit_ramp_scalar(Block const & block, Ramp const & ramp, Indices & indices, Errors & errors)
+{
+	for (std::size_t texel = 0; texel < kBlockTexels; ++texel)
+	{
+		float projection = 0.0F;
+		for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+			projection +=
+				(block.channels[channel][texel] - ramp.start[channel]) * ramp.axis[channel];
+		projection = std::min(std::max(projection, 0.0F), ramp.max_index);
+		auto const index = static_cast<int32_t>(projection + 0.5F);
+		float const fraction = static_cast<float>(index) * ramp.step;
+
+		float error = 0.0F;
+		for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+		{
+			float const diff = (ramp.start[channel] + ramp.delta[channel] * fraction) -
+				block.channels[channel][texel];
+			error += ramp.weights[channel] * (diff * diff);
+		}
+		errors[texel] = error;
+		indices[texel] = static_cast<uint8_t>(index);
+	}
+}
+
+/**
+ * Narrow point indices from SIMD lanes.
+ */
+inline void narrow_indices(std::array<int32_t, kBlockTexels> const & lanes, Indices & indices)
+{
+	for (std::size_t texel = 0; texel < kBlockTexels; ++texel)
+		indices[texel] = static_cast<uint8_t>(lanes[texel]);
+}
+
+#if defined(__x86_64__)
+// Ramp coefficients of a channel broadcast across all lanes. Wrapped in a struct since vector types
+// lose their alignment attributes as template arguments.
+struct ChannelSse
+{
+	__m128 start;
+	__m128 delta;
+	__m128 axis;
+	__m128 weight;
+};
+
+struct ChannelAvx
+{
+	__m256 start;
+	__m256 delta;
+	__m256 axis;
+	__m256 weight;
+};
+
+// SSE2 is part of the x86-64 baseline, so needs no runtime check.
+void fit_ramp_sse2(Block const & block, Ramp const & ramp, Indices & indices, Errors & errors)
+{
+	constexpr std::size_t lane_count = 4;
+
+	std::array<ChannelSse, kChannelCount> channels{};
+	for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+		channels[channel] = {
+			_mm_set1_ps(ramp.start[channel]),
+			_mm_set1_ps(ramp.delta[channel]),
+			_mm_set1_ps(ramp.axis[channel]),
+			_mm_set1_ps(ramp.weights[channel])};
+	__m128 const max_index = _mm_set1_ps(ramp.max_index);
+	__m128 const step = _mm_set1_ps(ramp.step);
+	__m128 const half = _mm_set1_ps(0.5F);
+
+	std::array<int32_t, kBlockTexels> lanes{};
+	for (std::size_t first = 0; first < kBlockTexels; first += lane_count)
+	{
+		__m128 projection = _mm_setzero_ps();
+		for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+		{
+			__m128 const texel = _mm_loadu_ps(&block.channels[channel][first]);
+			projection = _mm_add_ps(
+				projection,
+				_mm_mul_ps(_mm_sub_ps(texel, channels[channel].start), channels[channel].axis));
+		}
+		projection = _mm_min_ps(_mm_max_ps(projection, _mm_setzero_ps()), max_index);
+		__m128i const index = _mm_cvttps_epi32(_mm_add_ps(projection, half));
+		__m128 const fraction = _mm_mul_ps(_mm_cvtepi32_ps(index), step);
+
+		__m128 error = _mm_setzero_ps();
+		for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+		{
+			__m128 const texel = _mm_loadu_ps(&block.channels[channel][first]);
+			__m128 const diff = _mm_sub_ps(
+				_mm_add_ps(
+					channels[channel].start, _mm_mul_ps(channels[channel].delta, fraction)),
+				texel);
+			error =
+				_mm_add_ps(error, _mm_mul_ps(channels[channel].weight, _mm_mul_ps(diff, diff)));
+		}
+		_mm_storeu_ps(&errors[first], error);
+		// NOLINTNEXTLINE(*-reinterpret-cast)
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(&lanes[first]), index);
+	}
+	narrow_indices(lanes, indices);
+}
+
+__attribute__((target("avx2"))) void fit_ramp_avx2(
+	Block const & block, Ramp const & ramp, Indices & indices, Errors & errors)
+{
+	constexpr std::size_t lane_count = 8;
+
+	std::array<ChannelAvx, kChannelCount> channels{};
+	for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+		channels[channel] = {
+			_mm256_set1_ps(ramp.start[channel]),
+			_mm256_set1_ps(ramp.delta[channel]),
+			_mm256_set1_ps(ramp.axis[channel]),
+			_mm256_set1_ps(ramp.weights[channel])};
+	__m256 const max_index = _mm256_set1_ps(ramp.max_index);
+	__m256 const step = _mm256_set1_ps(ramp.step);
+	__m256 const half = _mm256_set1_ps(0.5F);
+
+	std::array<int32_t, kBlockTexels> lanes{};
+	for (std::size_t first = 0; first < kBlockTexels; first += lane_count)
+	{
+		__m256 projection = _mm256_setzero_ps();
+		for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+		{
+			__m256 const texel = _mm256_loadu_ps(&block.channels[channel][first]);
+			projection = _mm256_add_ps(
+				projection,
+				_mm256_mul_ps(
+					_mm256_sub_ps(texel, channels[channel].start), channels[channel].axis));
+		}
+		projection = _mm256_min_ps(_mm256_max_ps(projection, _mm256_setzero_ps()), max_index);
+		__m256i const index = _mm256_cvttps_epi32(_mm256_add_ps(projection, half));
+		__m256 const fraction = _mm256_mul_ps(_mm256_cvtepi32_ps(index), step);
+
+		__m256 error = _mm256_setzero_ps();
+		for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+		{
+			__m256 const texel = _mm256_loadu_ps(&block.channels[channel][first]);
+			__m256 const diff = _mm256_sub_ps(
+				_mm256_add_ps(
+					channels[channel].start, _mm256_mul_ps(channels[channel].delta, fraction)),
+				texel);
+			error = _mm256_add_ps(
+				error, _mm256_mul_ps(channels[channel].weight, _mm256_mul_ps(diff, diff)));
+		}
+		_mm256_storeu_ps(&errors[first], error);
+		// NOLINTNEXTLINE(*-reinterpret-cast)
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(&lanes[first]), index);
+	}
+	narrow_indices(lanes, indices);
+}
+#endif
+
+#if defined(__aarch64__)
+struct ChannelNeon
+{
+	float32x4_t start;
+	float32x4_t delta;
+	float32x4_t axis;
+	float32x4_t weight;
+};
+
+// NEON is mandatory on AArch64, so needs no runtime check.
+void fit_ramp_neon(Block const & block, Ramp const & ramp, Indices & indices, Errors & errors)
+{
+	constexpr std::size_t lane_count = 4;
+
+	std::array<ChannelNeon, kChannelCount> channels{};
+	for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+		channels[channel] = {
+			vdupq_n_f32(ramp.start[channel]),
+			vdupq_n_f32(ramp.delta[channel]),
+			vdupq_n_f32(ramp.axis[channel]),
+			vdupq_n_f32(ramp.weights[channel])};
+	float32x4_t const max_index = vdupq_n_f32(ramp.max_index);
+	float32x4_t const step = vdupq_n_f32(ramp.step);
+	float32x4_t const half = vdupq_n_f32(0.5F);
+
+	std::array<int32_t, kBlockTexels> lanes{};
+	for (std::size_t first = 0; first < kBlockTexels; first += lane_count)
+	{
+		float32x4_t projection = vdupq_n_f32(0.0F);
+		for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+		{
+			float32x4_t const texel = vld1q_f32(&block.channels[channel][first]);
+			projection = vaddq_f32(
+				projection,
+				vmulq_f32(vsubq_f32(texel, channels[channel].start), channels[channel].axis));
+		}
+		projection = vminq_f32(vmaxq_f32(projection, vdupq_n_f32(0.0F)), max_index);
+		int32x4_t const index = vcvtq_s32_f32(vaddq_f32(projection, half));
+		float32x4_t const fraction = vmulq_f32(vcvtq_f32_s32(index), step);
+
+		float32x4_t error = vdupq_n_f32(0.0F);
+		for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+		{
+			float32x4_t const texel = vld1q_f32(&block.channels[channel][first]);
+			float32x4_t const diff = vsubq_f32(
+				vaddq_f32(channels[channel].start, vmulq_f32(channels[channel].delta, fraction)),
+				texel);
+			error = vaddq_f32(error, vmulq_f32(channels[channel].weight, vmulq_f32(diff, diff)));
+		}
+		vst1q_f32(&errors[first], error);
+		vst1q_s32(&lanes[first], index);
+	}
+	narrow_indices(lanes, indices);
+}
+#endif
+
+FitKernel fit_kernel(simd::Kernel const kernel)
+{
+	if (!simd::is_kernel_supported(kernel))
+		throw std::runtime_error{
+			std::string{"Block compression kernel not supported: "} +
+			std::string{simd::kernel_name(kernel)}};
+
+	switch (kernel)
+	{
+#if defined(__x86_64__)
+		case simd::Kernel::kSse2:
+			return &fit_ramp_sse2;
+		case simd::Kernel::kAvx2:
+			return &fit_ramp_avx2;
+#endif
+#if defined(__aarch64__)
+		case simd::Kernel::kNeon:
+			return &fit_ramp_neon;
+#endif
+		default:
+			return &fit_ramp_scalar;
+	}
+}
+
+/**
+ * Point indices of a block's texels along a ramp, and their total squared error.
+ */
+struct RampFit
+{
+	Indices indices;
+	float error;
+};
+
+Ramp make_ramp(
+	Colour const & start, Colour const & end, Colour const & weights, uint32_t const point_count)
+{
+	auto const max_index = static_cast<float>(point_count - 1);
+	Ramp ramp{
+		.start = start,
+		.delta = {},
+		.axis = {},
+		.weights = weights,
+		.max_index = max_index,
+		.step = 1.0F / max_index};
+
+	float length_sq = 0.0F;
+	for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+	{
+		ramp.delta[channel] = end[channel] - start[channel];
+		length_sq += weights[channel] * ramp.delta[channel] * ramp.delta[channel];
+	}
+	// Coincident endpoints assign every texel to the start.
+	float const scale = length_sq > 0.0F ? max_index / length_sq : 0.0F;
+	for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+		ramp.axis[channel] = weights[channel] * ramp.delta[channel] * scale;
+	return ramp;
+}
+
+RampFit fit_ramp(Block const & block, Ramp const & ramp, FitKernel const fit)
+{
+	RampFit ramp_fit{.indices = {}, .error = 0.0F};
+	Errors errors{};
+	fit(block, ramp, ramp_fit.indices, errors);
+	for (float const error : errors)
+		ramp_fit.error += error;
+	return ramp_fit;
+}
+
+Colour clamp_unorm8(Colour colour)
+{
+	for (float & value : colour)
+		value = std::clamp(value, 0.0F, 255.0F);
+	return colour;
+}
+
+/**
+ * Endpoints of the segment of the principal axis of a block's weighted texels that spans their
+ * projections, found by power iteration on their covariance.
+ *
+ * Sums run over texels in the innermost loops, so that they auto-vectorise.
+ */
+std::pair<Colour, Colour> fit_principal_axis(Block const & block, Colour const & weights)
+{
+	Colour mean{};
+	for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+	{
+		for (float const value : block.channels[channel])
+			mean[channel] += value;
+		mean[channel] /= static_cast<float>(kBlockTexels);
+	}
+
+	Block offsets{};
+	for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+		for (std::size_t texel = 0; texel < kBlockTexels; ++texel)
+			offsets.channels[channel][texel] =
+				weights[channel] * (block.channels[channel][texel] - mean[channel]);
+
+	std::array<Colour, kChannelCount> covariance{};
+	for (std::size_t row = 0; row < kChannelCount; ++row)
+	{
+		for (std::size_t col = row; col < kChannelCount; ++col)
+		{
+			float sum = 0.0F;
+			for (std::size_t texel = 0; texel < kBlockTexels; ++texel)
+				sum += offsets.channels[row][texel] * offsets.channels[col][texel];
+			covariance[row][col] = sum;
+			covariance[col][row] = sum;
+		}
+	}
+
+	// Seed with the column of the channel of largest variance, which is never orthogonal to the
+	// principal axis.
+	std::size_t seed_channel = 0;
+	for (std::size_t channel = 1; channel < kChannelCount; ++channel)
+		if (covariance[channel][channel] > covariance[seed_channel][seed_channel])
+			seed_channel = channel;
+	if (covariance[seed_channel][seed_channel] <= 0.0F)
+		return {mean, mean};
+
+	Colour axis = covariance[seed_channel];
+	constexpr int iteration_count = 8;
+	for (int iteration = 0; iteration < iteration_count; ++iteration)
+	{
+		Colour next{};
+		for (std::size_t row = 0; row < kChannelCount; ++row)
+			for (std::size_t col = 0; col < kChannelCount; ++col)
+				next[row] += covariance[row][col] * axis[col];
+		float norm = 0.0F;
+		for (float const value : next)
+			norm = std::max(norm, std::abs(value));
+		if (norm <= 0.0F)
+			break;
+		for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+			axis[channel] = next[channel] / norm;
+	}
+
+	Errors projections{};
+	for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+		for (std::size_t texel = 0; texel < kBlockTexels; ++texel)
+			projections[texel] += offsets.channels[channel][texel] * axis[channel];
+	auto const [min_projection, max_projection] = std::ranges::minmax(projections);
+
+	float length_sq = 0.0F;
+	for (float const value : axis)
+		length_sq += value * value;
+	Colour start{};
+	Colour end{};
+	for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+	{
+		start[channel] = mean[channel] + axis[channel] * min_projection / length_sq;
+		end[channel] = mean[channel] + axis[channel] * max_projection / length_sq;
+	}
+	return {clamp_unorm8(start), clamp_unorm8(end)};
+}
+
+/**
+ * Endpoints minimising the squared error of a block's texels from their assigned ramp points.
+ *
+ * Channels of zero weight are left as zero.
+ *
+ * @return nullopt if all texels share a point, leaving the endpoints underdetermined.
+ */
+std::optional<std::pair<Colour, Colour>> refit_endpoints(
+	Block const & block, Indices const & indices, Colour const & weights, float const max_index)
+{
+	Errors end_weights{};
+	for (std::size_t texel = 0; texel < kBlockTexels; ++texel)
+		end_weights[texel] = static_cast<float>(indices[texel]) / max_index;
+
+	float start_sq = 0.0F;
+	float start_end = 0.0F;
+	float end_sq = 0.0F;
+	for (float const end_weight : end_weights)
+	{
+		float const start_weight = 1.0F - end_weight;
+		start_sq += start_weight * start_weight;
+		start_end += start_weight * end_weight;
+		end_sq += end_weight * end_weight;
+	}
+
+	float const determinant = start_sq * end_sq - start_end * start_end;
+	if (determinant < 1e-3F)
+		return std::nullopt;
+
+	Colour start{};
+	Colour end{};
+	for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+	{
+		if (weights[channel] == 0.0F)
+			continue;
+		float start_texel = 0.0F;
+		float end_texel = 0.0F;
+		for (std::size_t texel = 0; texel < kBlockTexels; ++texel)
+		{
+			float const value = block.channels[channel][texel];
+			start_texel += (1.0F - end_weights[texel]) * value;
+			end_texel += end_weights[texel] * value;
+		}
+		start[channel] = (end_sq * start_texel - start_end * end_texel) / determinant;
+		end[channel] = (start_sq * end_texel - start_end * start_texel) / determinant;
+	}
+	return std::pair{clamp_unorm8(start), clamp_unorm8(end)};
+}
+
+/**
+ * Append bits to a zero initialised block, least significant first.
+ */
+void put_bits(
+	std::span<std::byte> const out, uint32_t & offset, uint64_t value, uint32_t bit_count)
+{
+	while (bit_count > 0)
+	{
+		uint32_t const shift = offset % 8;
+		uint32_t const written = std::min(8 - shift, bit_count);
+		uint64_t const mask = (1U << written) - 1U;
+		out[offset / 8] |= std::byte{static_cast<uint8_t>((value & mask) << shift)};
+		value >>= written;
+		offset += written;
+		bit_count -= written;
+	}
+}
+
+uint32_t quantise(float const value, uint32_t const max_value)
+{
+	return static_cast<uint32_t>(std::lround(value * static_cast<float>(max_value) / 255.0F));
+}
+
+uint16_t pack_565(Colour const & colour)
+{
+	return static_cast<uint16_t>(
+		(quantise(colour[0], 31) << 11U) | (quantise(colour[1], 63) << 5U) |
+		quantise(colour[2], 31));
+}
+
+Colour unpack_565(uint16_t const packed)
+{
+	uint32_t const red = (packed >> 11U) & 0x1FU;
+	uint32_t const green = (packed >> 5U) & 0x3FU;
+	uint32_t const blue = packed & 0x1FU;
+	return {
+		static_cast<float>((red << 3U) | (red >> 2U)),
+		static_cast<float>((green << 2U) | (green >> 4U)),
+		static_cast<float>((blue << 3U) | (blue >> 2U)),
+		0.0F};
+}
+
+/// BC1 index of each point of a 4 point ramp from colour0 to colour1.
+constexpr std::array<uint8_t, 4> kBc1Indices{0, 2, 3, 1};
+
+struct Bc1Fit
+{
+	uint16_t colour0;
+	uint16_t colour1;
+	RampFit ramp_fit;
+};
+
+Bc1Fit fit_bc1(Block const & block, Colour const & start, Colour const & end, FitKernel const fit)
+{
+	uint16_t colour0 = pack_565(start);
+	uint16_t colour1 = pack_565(end);
+	// Four colour mode requires colour0 > colour1. If equal, all texels use colour0 regardless.
+	if (colour0 < colour1)
+		std::swap(colour0, colour1);
+	return {
+		.colour0 = colour0,
+		.colour1 = colour1,
+		.ramp_fit = fit_ramp(
+			block, make_ramp(unpack_565(colour0), unpack_565(colour1), kRgbWeights, 4), fit)};
+}
+
+/**
+ * BC1 colour block, always in four colour mode, so also the colour half of BC3.
+ */
+void encode_bc1(Block const & block, FitKernel const fit, std::span<std::byte> const out)
+{
+	auto const [start, end] = fit_principal_axis(block, kRgbWeights);
+	Bc1Fit best = fit_bc1(block, start, end, fit);
+	if (auto const refit = refit_endpoints(block, best.ramp_fit.indices, kRgbWeights, 3.0F))
+	{
+		Bc1Fit const candidate = fit_bc1(block, refit->first, refit->second, fit);
+		if (candidate.ramp_fit.error < best.ramp_fit.error)
+			best = candidate;
+	}
+
+	uint32_t offset = 0;
+	put_bits(out, offset, best.colour0, 16);
+	put_bits(out, offset, best.colour1, 16);
+	for (uint8_t const index : best.ramp_fit.indices)
+		put_bits(out, offset, kBc1Indices[index], 2);
+}
+
+/// BC4 index of each point of an 8 point ramp from endpoint0 to endpoint1.
+constexpr std::array<uint8_t, 8> kBc4Indices{0, 2, 3, 4, 5, 6, 7, 1};
+
+Colour single_channel(std::size_t const channel)
+{
+	Colour weights{};
+	weights[channel] = 1.0F;
+	return weights;
+}
+
+struct Bc4Fit
+{
+	uint8_t endpoint0;
+	uint8_t endpoint1;
+	RampFit ramp_fit;
+};
+
+Bc4Fit fit_bc4(
+	Block const & block,
+	std::size_t const channel,
+	float const start,
+	float const end,
+	FitKernel const fit)
+{
+	auto endpoint0 = static_cast<uint8_t>(quantise(start, 255));
+	auto endpoint1 = static_cast<uint8_t>(quantise(end, 255));
+	// Eight value mode requires endpoint0 > endpoint1. If equal, all texels use endpoint0
+	// regardless.
+	if (endpoint0 < endpoint1)
+		std::swap(endpoint0, endpoint1);
+
+	Colour ramp_start{};
+	Colour ramp_end{};
+	ramp_start[channel] = endpoint0;
+	ramp_end[channel] = endpoint1;
+	return {
+		.endpoint0 = endpoint0,
+		.endpoint1 = endpoint1,
+		.ramp_fit =
+			fit_ramp(block, make_ramp(ramp_start, ramp_end, single_channel(channel), 8), fit)};
+}
+
+/**
+ * BC4 block of a single channel, always in eight value mode, so also each half of BC5 and the
+ * alpha half of BC3.
+ */
+void encode_bc4(
+	Block const & block,
+	std::size_t const channel,
+	FitKernel const fit,
+	std::span<std::byte> const out)
+{
+	auto const [min_value, max_value] = std::ranges::minmax(block.channels[channel]);
+	Bc4Fit best = fit_bc4(block, channel, max_value, min_value, fit);
+	if (auto const refit =
+			refit_endpoints(block, best.ramp_fit.indices, single_channel(channel), 7.0F))
+	{
+		Bc4Fit const candidate =
+			fit_bc4(block, channel, refit->first[channel], refit->second[channel], fit);
+		if (candidate.ramp_fit.error < best.ramp_fit.error)
+			best = candidate;
+	}
+
+	uint32_t offset = 0;
+	put_bits(out, offset, best.endpoint0, 8);
+	put_bits(out, offset, best.endpoint1, 8);
+	for (uint8_t const index : best.ramp_fit.indices)
+		put_bits(out, offset, kBc4Indices[index], 3);
+}
+
+/**
+ * BC7 mode 6 endpoint: 7 bits per channel plus a shared least significant "p-bit".
+ */
+struct Bc7Endpoint
+{
+	std::array<uint8_t, kChannelCount> quantised;
+	uint8_t p_bit;
+};
+
+Bc7Endpoint quantise_bc7(Colour const & colour)
+{
+	Bc7Endpoint best{};
+	float best_error = std::numeric_limits<float>::max();
+	for (uint8_t const p_bit : {0, 1})
+	{
+		Bc7Endpoint candidate{.quantised = {}, .p_bit = p_bit};
+		float error = 0.0F;
+		for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+		{
+			long const quantised = std::clamp(
+				std::lround((colour[channel] - static_cast<float>(p_bit)) / 2.0F), 0L, 127L);
+			candidate.quantised[channel] = static_cast<uint8_t>(quantised);
+			float const diff = static_cast<float>((quantised << 1) | p_bit) - colour[channel];
+			error += diff * diff;
+		}
+		if (error < best_error)
+		{
+			best = candidate;
+			best_error = error;
+		}
+	}
+	return best;
+}
+
+Colour dequantise_bc7(Bc7Endpoint const & endpoint)
+{
+	Colour colour{};
+	for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+		colour[channel] =
+			static_cast<float>((uint32_t{endpoint.quantised[channel]} << 1U) | endpoint.p_bit);
+	return colour;
+}
+
+struct Bc7Fit
+{
+	Bc7Endpoint endpoint0;
+	Bc7Endpoint endpoint1;
+	RampFit ramp_fit;
+};
+
+Bc7Fit fit_bc7(Block const & block, Colour const & start, Colour const & end, FitKernel const fit)
+{
+	Bc7Endpoint const endpoint0 = quantise_bc7(start);
+	Bc7Endpoint const endpoint1 = quantise_bc7(end);
+	// Mode 6 interpolation weights are within 1/128 of an even 16 point ramp.
+	return {
+		.endpoint0 = endpoint0,
+		.endpoint1 = endpoint1,
+		.ramp_fit = fit_ramp(
+			block,
+			make_ramp(dequantise_bc7(endpoint0), dequantise_bc7(endpoint1), kRgbaWeights, 16),
+			fit)};
+}
+
+/**
+ * BC7 block in mode 6.
+ */
+void encode_bc7(Block const & block, FitKernel const fit, std::span<std::byte> const out)
+{
+	constexpr uint32_t max_index = 15;
+
+	auto const [start, end] = fit_principal_axis(block, kRgbaWeights);
+	Bc7Fit best = fit_bc7(block, start, end, fit);
+	if (auto const refit = refit_endpoints(
+			block, best.ramp_fit.indices, kRgbaWeights, static_cast<float>(max_index)))
+	{
+		Bc7Fit const candidate = fit_bc7(block, refit->first, refit->second, fit);
+		if (candidate.ramp_fit.error < best.ramp_fit.error)
+			best = candidate;
+	}
+
+	// The most significant index bit of the first texel is implicitly zero, so reverse the ramp if
+	// needed.
+	if (best.ramp_fit.indices[0] > max_index / 2)
+	{
+		std::swap(best.endpoint0, best.endpoint1);
+		for (uint8_t & index : best.ramp_fit.indices)
+			index = static_cast<uint8_t>(max_index - index);
+	}
+
+	uint32_t offset = 0;
+	constexpr uint32_t mode = 6;
+	put_bits(out, offset, 1U << mode, mode + 1);
+	for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+	{
+		put_bits(out, offset, best.endpoint0.quantised[channel], 7);
+		put_bits(out, offset, best.endpoint1.quantised[channel], 7);
+	}
+	put_bits(out, offset, best.endpoint0.p_bit, 1);
+	put_bits(out, offset, best.endpoint1.p_bit, 1);
+	put_bits(out, offset, best.ramp_fit.indices[0], 3);
+	for (std::size_t texel = 1; texel < kBlockTexels; ++texel)
+		put_bits(out, offset, best.ramp_fit.indices[texel], 4);
+}
+
+void encode_bc3(Block const & block, FitKernel const fit, std::span<std::byte> const out)
+{
+	encode_bc4(block, 3, fit, out.first(8));
+	encode_bc1(block, fit, out.subspan(8));
+}
+
+void encode_bc4_red(Block const & block, FitKernel const fit, std::span<std::byte> const out)
+{
+	encode_bc4(block, 0, fit, out);
+}
+
+void encode_bc5(Block const & block, FitKernel const fit, std::span<std::byte> const out)
+{
+	encode_bc4(block, 0, fit, out.first(8));
+	encode_bc4(block, 1, fit, out.subspan(8));
+}
+
+/**
+ * @return Encoder of blocks of a BC format, or nullptr if not a supported BC format.
+ */
+BlockEncoder block_encoder(VkFormat const format)
+{
+	switch (format)
+	{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+			return &encode_bc1;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			return &encode_bc3;
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+			return &encode_bc4_red;
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			return &encode_bc5;
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return &encode_bc7;
+		default:
+			return nullptr;
+	}
+}
+
+/**
+ * @return Bytes per block of a supported BC format.
+ */
+std::size_t block_bytes(VkFormat const format)
+{
+	switch (format)
+	{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+			return 8;
+		default:
+			return 16;
+	}
+}
+
+bool is_rgba8(VkFormat const format)
+{
+	return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+constexpr std::size_t kRgbaSize = 4;
+
+/**
+ * Load a block of texels, clamping to the edges of the image.
+ */
+Block load_block(
+	std::span<std::byte const> const texels,
+	VkExtent2D const extent,
+	uint32_t const block_x,
+	uint32_t const block_y)
+{
+	Block block{};
+	for (uint32_t y = 0; y < kBlockSize; ++y)
+	{
+		uint32_t const src_y = std::min(block_y * kBlockSize + y, extent.height - 1);
+		for (uint32_t x = 0; x < kBlockSize; ++x)
+		{
+			uint32_t const src_x = std::min(block_x * kBlockSize + x, extent.width - 1);
+			std::size_t const src_offset =
+				(std::size_t{src_y} * extent.width + src_x) * kRgbaSize;
+			for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+				block.channels[channel][y * kBlockSize + x] =
+					std::to_integer<uint8_t>(texels[src_offset + channel]);
+		}
+	}
+	return block;
+}
+
+VkExtent2D block_extent(VkExtent2D const extent)
+{
+	return {
+		(extent.width + kBlockSize - 1) / kBlockSize,
+		(extent.height + kBlockSize - 1) / kBlockSize};
+}
+}  // namespace
+
+VkFormat choose_format(VkPhysicalDevice physical_device, Channels const channels, bool const srgb)
+{
+	std::vector<VkFormat> candidates;
+	bool is_colour = true;
+	switch (channels)
+	{
+		case Channels::kRgb:
+			candidates = srgb
+				? std::vector{VK_FORMAT_BC7_SRGB_BLOCK, VK_FORMAT_BC1_RGB_SRGB_BLOCK}
+				: std::vector{VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC1_RGB_UNORM_BLOCK};
+			break;
+		case Channels::kRgba:
+			candidates = srgb ? std::vector{VK_FORMAT_BC7_SRGB_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK}
+							  : std::vector{VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC3_UNORM_BLOCK};
+			break;
+		case Channels::kR:
+			candidates = {VK_FORMAT_BC4_UNORM_BLOCK};
+			is_colour = false;
+			break;
+		case Channels::kRg:
+			candidates = {VK_FORMAT_BC5_UNORM_BLOCK};
+			is_colour = false;
+			break;
+	}
+
+	VkPhysicalDeviceFeatures features{};
+	vkGetPhysicalDeviceFeatures(physical_device, &features);
+	if (features.textureCompressionBC == VK_TRUE)
+	{
+		for (VkFormat const format : candidates)
+		{
+			VkFormatProperties properties{};
+			vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+			if ((properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0)
+				return format;
+		}
+	}
+	return srgb && is_colour ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+bool is_block_compressed(VkFormat const format)
+{
+	return block_encoder(format) != nullptr;
+}
+
+std::size_t encoded_size(VkFormat const format, VkExtent2D const extent)
+{
+	if (is_rgba8(format))
+		return std::size_t{extent.width} * extent.height * kRgbaSize;
+	if (!is_block_compressed(format))
+		throw std::invalid_argument{"Unsupported block compressed format"};
+	VkExtent2D const blocks = block_extent(extent);
+	return std::size_t{blocks.width} * blocks.height * block_bytes(format);
+}
+
+std::vector<std::byte> encode(
+	VkFormat const format,
+	VkExtent2D const extent,
+	std::span<std::byte const> const texels,
+	parallel::ThreadPool & pool,
+	simd::Kernel const kernel)
+{
+	FitKernel const fit = fit_kernel(kernel);
+	std::vector<std::byte> encoded(encoded_size(format, extent));
+	if (texels.size() != std::size_t{extent.width} * extent.height * kRgbaSize)
+		throw std::invalid_argument{"Texels do not match image extent"};
+
+	if (is_rgba8(format))
+	{
+		std::ranges::copy(texels, encoded.begin());
+		return encoded;
+	}
+
+	BlockEncoder const encode_block = block_encoder(format);
+	std::size_t const bytes = block_bytes(format);
+	VkExtent2D const blocks = block_extent(extent);
+	std::span<std::byte> const out{encoded};
+
+	parallel::for_each_chunk(
+		pool,
+		std::size_t{blocks.width} * blocks.height,
+		kChunkBlocks,
+		[&](std::size_t, std::size_t const begin, std::size_t const end)
+		{
+			for (std::size_t block_idx = begin; block_idx < end; ++block_idx)
+			{
+				auto const block_x = static_cast<uint32_t>(block_idx % blocks.width);
+				auto const block_y = static_cast<uint32_t>(block_idx / blocks.width);
+				encode_block(
+					load_block(texels, extent, block_x, block_y),
+					fit,
+					out.subspan(block_idx * bytes, bytes));
+			}
+		});
+	return encoded;
+}
+
+namespace
+{
+using Rgba = std::array<uint8_t, kRgbaSize>;
+using DecodedBlock = std::array<Rgba, kBlockTexels>;
+
+uint32_t get_bits(std::span<std::byte const> const in, uint32_t & offset, uint32_t const bit_count)
+{
+	uint32_t value = 0;
+	for (uint32_t bit = 0; bit < bit_count; ++bit, ++offset)
+		value |= ((std::to_integer<uint32_t>(in[offset / 8]) >> (offset % 8)) & 1U) << bit;
+	return value;
+}
+
+void decode_bc1(std::span<std::byte const> const in, DecodedBlock & out)
+{
+	uint32_t offset = 0;
+	uint32_t const colour0 = get_bits(in, offset, 16);
+	uint32_t const colour1 = get_bits(in, offset, 16);
+	std::array<Rgba, 4> palette{};
+	for (std::size_t channel = 0; channel < 3; ++channel)
+	{
+		auto const value0 = static_cast<uint32_t>(unpack_565(colour0)[channel]);
+		auto const value1 = static_cast<uint32_t>(unpack_565(colour1)[channel]);
+		palette[0][channel] = static_cast<uint8_t>(value0);
+		palette[1][channel] = static_cast<uint8_t>(value1);
+		palette[2][channel] = static_cast<uint8_t>(
+			colour0 > colour1 ? (2 * value0 + value1) / 3 : (value0 + value1) / 2);
+		palette[3][channel] =
+			static_cast<uint8_t>(colour0 > colour1 ? (value0 + 2 * value1) / 3 : 0);
+	}
+	for (std::size_t idx = 0; idx < palette.size(); ++idx)
+		palette[idx][3] = colour0 <= colour1 && idx == 3 ? 0 : 255;
+
+	for (Rgba & texel : out)
+	{
+		Rgba const & colour = palette[get_bits(in, offset, 2)];
+		std::copy_n(colour.begin(), 3, texel.begin());
+		texel[3] = colour[3];
+	}
+}
+
+void decode_bc4(std::span<std::byte const> const in, std::size_t const channel, DecodedBlock & out)
+{
+	uint32_t offset = 0;
+	uint32_t const endpoint0 = get_bits(in, offset, 8);
+	uint32_t const endpoint1 = get_bits(in, offset, 8);
+	std::array<uint32_t, 8> palette{endpoint0, endpoint1};
+	if (endpoint0 > endpoint1)
+	{
+		for (uint32_t idx = 2; idx < 8; ++idx)
+			palette[idx] = ((8 - idx) * endpoint0 + (idx - 1) * endpoint1) / 7;
+	}
+	else
+	{
+		for (uint32_t idx = 2; idx < 6; ++idx)
+			palette[idx] = ((6 - idx) * endpoint0 + (idx - 1) * endpoint1) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+	for (Rgba & texel : out)
+		texel[channel] = static_cast<uint8_t>(palette[get_bits(in, offset, 3)]);
+}
+
+void decode_bc7_mode6(std::span<std::byte const> const in, DecodedBlock & out)
+{
+	constexpr std::array<uint32_t, 16> weights{
+		0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+	uint32_t offset = 0;
+	REQUIRE(get_bits(in, offset, 7) == 1U << 6U);
+	std::array<std::array<uint32_t, 2>, kChannelCount> endpoints{};
+	for (auto & channel_endpoints : endpoints)
+		for (uint32_t & endpoint : channel_endpoints)
+			endpoint = get_bits(in, offset, 7) << 1U;
+	for (std::size_t endpoint_idx = 0; endpoint_idx < 2; ++endpoint_idx)
+	{
+		uint32_t const p_bit = get_bits(in, offset, 1);
+		for (auto & channel_endpoints : endpoints)
+			channel_endpoints[endpoint_idx] |= p_bit;
+	}
+	for (std::size_t texel = 0; texel < kBlockTexels; ++texel)
+	{
+		uint32_t const weight = weights[get_bits(in, offset, texel == 0 ? 3 : 4)];
+		for (std::size_t channel = 0; channel < kChannelCount; ++channel)
+			out[texel][channel] = static_cast<uint8_t>(
+				((64 - weight) * endpoints[channel][0] + weight * endpoints[channel][1] + 32) >>
+				6U);
+	}
+}
+
+/**
+ * Decode an image encoded by `encode` back to RGBA8, with unencoded channels as (0, 0, 0, 255).
+ */
+std::vector<std::byte> decode(
+	VkFormat const format, VkExtent2D const extent, std::span<std::byte const> const encoded)
+{
+	std::size_t const bytes = block_bytes(format);
+	VkExtent2D const blocks = block_extent(extent);
+	std::vector<std::byte> texels(std::size_t{extent.width} * extent.height * kRgbaSize);
+
+	for (uint32_t block_y = 0; block_y < blocks.height; ++block_y)
+	{
+		for (uint32_t block_x = 0; block_x < blocks.width; ++block_x)
+		{
+			std::span<std::byte const> const in =
+				encoded.subspan((std::size_t{block_y} * blocks.width + block_x) * bytes, bytes);
+			DecodedBlock block{};
+			for (Rgba & texel : block)
+				texel = {0, 0, 0, 255};
+
+			if (format == VK_FORMAT_BC1_RGB_UNORM_BLOCK)
+				decode_bc1(in, block);
+			else if (format == VK_FORMAT_BC3_UNORM_BLOCK)
+			{
+				decode_bc1(in.subspan(8), block);
+				decode_bc4(in.first(8), 3, block);
+			}
+			else if (format == VK_FORMAT_BC4_UNORM_BLOCK)
+				decode_bc4(in, 0, block);
+			else if (format == VK_FORMAT_BC5_UNORM_BLOCK)
+			{
+				decode_bc4(in.first(8), 0, block);
+				decode_bc4(in.subspan(8), 1, block);
+			}
+			else if (format == VK_FORMAT_BC7_UNORM_BLOCK)
+				decode_bc7_mode6(in, block);
+			else
+				FAIL("Unexpected format");
+
+			for (uint32_t y = 0; y < kBlockSize; ++y)
+			{
+				for (uint32_t x = 0; x < kBlockSize; ++x)
+				{
+					uint32_t const dst_x = block_x * kBlockSize + x;
+					uint32_t const dst_y = block_y * kBlockSize + y;
+					if (dst_x >= extent.width || dst_y >= extent.height)
+						continue;
+					Rgba const & texel = block[y * kBlockSize + x];
+					for (std::size_t channel = 0; channel < kRgbaSize; ++channel)
+						texels[(std::size_t{dst_y} * extent.width + dst_x) * kRgbaSize + channel] =
+							std::byte{texel[channel]};
+				}
+			}
+		}
+	}
+	return texels;
+}
+
+/**
+ * Peak signal to noise ratio, in dB, over the first `channel_count` channels of RGBA8 images.
+ */
+double psnr(
+	std::span<std::byte const> const expected,
+	std::span<std::byte const> const actual,
+	std::size_t const channel_count)
+{
+	double error_sq = 0.0;
+	for (std::size_t offset = 0; offset < expected.size(); offset += kRgbaSize)
+	{
+		for (std::size_t channel = 0; channel < channel_count; ++channel)
+		{
+			double const diff = std::to_integer<int>(expected[offset + channel]) -
+				std::to_integer<int>(actual[offset + channel]);
+			error_sq += diff * diff;
+		}
+	}
+	double const mean_error_sq =
+		error_sq / static_cast<double>(expected.size() / kRgbaSize * channel_count);
+	if (mean_error_sq == 0.0)
+		return std::numeric_limits<double>::infinity();
+	return 10.0 * std::log10(255.0 * 255.0 / mean_error_sq);
+}
+
+/**
+ * Smooth gradients overlaid with sharp edged shapes and noise, similar to typical textures.
+ */
+std::vector<std::byte> make_test_image(VkExtent2D const extent)
+{
+	// NOLINTNEXTLINE(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+	std::mt19937 rng{42};
+	std::uniform_int_distribution<int> noise{-8, 8};
+	std::vector<std::byte> texels(std::size_t{extent.width} * extent.height * kRgbaSize);
+
+	for (uint32_t y = 0; y < extent.height; ++y)
+	{
+		for (uint32_t x = 0; x < extent.width; ++x)
+		{
+			float const u = static_cast<float>(x) / static_cast<float>(extent.width);
+			float const v = static_cast<float>(y) / static_cast<float>(extent.height);
+			bool const in_disc = (u - 0.5F) * (u - 0.5F) + (v - 0.5F) * (v - 0.5F) < 0.1F;
+			std::array<float, kRgbaSize> const colour{
+				in_disc ? 230.0F : 255.0F * u,
+				in_disc ? 40.0F : 255.0F * v,
+				in_disc ? 60.0F : 128.0F + 100.0F * std::sin(8.0F * u),
+				255.0F * (1.0F - v * u)};
+			std::size_t const offset = (std::size_t{y} * extent.width + x) * kRgbaSize;
+			for (std::size_t channel = 0; channel < kRgbaSize; ++channel)
+				texels[offset + channel] = std::byte{static_cast<uint8_t>(
+					std::clamp(colour[channel] + static_cast<float>(noise(rng)), 0.0F, 255.0F))};
+		}
+	}
+	return texels;
+}
+
+/**
+ * Format encoded by tests, the number of channels it encodes, and the minimum PSNR expected of
+ * make_test_image.
+ */
+struct TestFormat
+{
+	VkFormat format;
+	std::size_t channel_count;
+	double min_psnr;
+};
+
+constexpr std::array kTestFormats{
+	TestFormat{VK_FORMAT_BC1_RGB_UNORM_BLOCK, 3, 30.0},
+	TestFormat{VK_FORMAT_BC3_UNORM_BLOCK, 4, 30.0},
+	TestFormat{VK_FORMAT_BC4_UNORM_BLOCK, 1, 36.0},
+	TestFormat{VK_FORMAT_BC5_UNORM_BLOCK, 2, 36.0},
+	TestFormat{VK_FORMAT_BC7_UNORM_BLOCK, 4, 34.0}};
+}  // namespace
+
+TEST_CASE("Encode images to block compressed formats")
+{
+	parallel::ThreadPool pool{3};
+
+	// Not a multiple of the block size, nor of the chunk size in blocks, to exercise remainders.
+	VkExtent2D const extent{.width = 130, .height = 70};
+	std::vector<std::byte> const texels = make_test_image(extent);
+
+	for (auto const & [format, channel_count, min_psnr] : kTestFormats)
+	{
+		CAPTURE(string_VkFormat(format));
+		std::vector<std::byte> const expected =
+			encode(format, extent, texels, pool, simd::Kernel::kScalar);
+		CHECK(is_block_compressed(format));
+		CHECK(expected.size() == encoded_size(format, extent));
+		CHECK(expected.size() == 33UZ * 18 * block_bytes(format));
+		CHECK(psnr(texels, decode(format, extent, expected), channel_count) > min_psnr);
+
+		for (simd::Kernel const kernel :
+			 {simd::Kernel::kSse2, simd::Kernel::kAvx2, simd::Kernel::kNeon})
+		{
+			CAPTURE(simd::kernel_name(kernel));
+			if (!simd::is_kernel_supported(kernel))
+			{
+				CHECK_THROWS_AS(encode(format, extent, texels, pool, kernel), std::runtime_error);
+				continue;
+			}
+			CHECK(encode(format, extent, texels, pool, kernel) == expected);
+		}
+	}
+
+	SUBCASE("solid colour")
+	{
+		VkExtent2D const solid_extent{.width = 4, .height = 4};
+		std::vector<std::byte> solid(std::size_t{solid_extent.width} * solid_extent.height * 4);
+		for (std::size_t offset = 0; offset < solid.size(); offset += 4)
+		{
+			solid[offset + 0] = std::byte{200};
+			solid[offset + 1] = std::byte{100};
+			solid[offset + 2] = std::byte{50};
+			solid[offset + 3] = std::byte{255};
+		}
+
+		for (auto const & [format, channel_count, min_psnr] : kTestFormats)
+		{
+			CAPTURE(string_VkFormat(format));
+			std::vector<std::byte> const decoded =
+				decode(format, solid_extent, encode(format, solid_extent, solid, pool));
+			// Within the precision of the endpoints, i.e. 5 bits for BC1 red and blue.
+			for (std::size_t channel = 0; channel < channel_count; ++channel)
+				CHECK(
+					std::abs(
+						std::to_integer<int>(decoded[channel]) -
+						std::to_integer<int>(solid[channel])) <= 4);
+		}
+	}
+
+	SUBCASE("uncompressed")
+	{
+		CHECK(!is_block_compressed(VK_FORMAT_R8G8B8A8_SRGB));
+		CHECK(encoded_size(VK_FORMAT_R8G8B8A8_SRGB, extent) == texels.size());
+		CHECK(encode(VK_FORMAT_R8G8B8A8_SRGB, extent, texels, pool) == texels);
+	}
+
+	SUBCASE("invalid")
+	{
+		CHECK(!is_block_compressed(VK_FORMAT_BC6H_UFLOAT_BLOCK));
+		CHECK_THROWS_AS(
+			encode(VK_FORMAT_BC6H_UFLOAT_BLOCK, extent, texels, pool), std::invalid_argument);
+		CHECK_THROWS_AS(
+			encode(
+				VK_FORMAT_BC7_UNORM_BLOCK,
+				extent,
+				std::span{texels}.first(texels.size() - 4),
+				pool),
+			std::invalid_argument);
+	}
+}
+
+TEST_CASE("Choose a block compressed format")
+{
+	vulkandemo::LoggerPtr const logger =
+		vulkandemo::create_logger("Choose a block compressed format");
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		nullptr,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+	for (Channels const channels :
+		 {Channels::kRgb, Channels::kRgba, Channels::kR, Channels::kRg})
+	{
+		for (bool const srgb : {false, true})
+		{
+			VkFormat const format = choose_format(physical_device, channels, srgb);
+			CAPTURE(string_VkFormat(format));
+			// Either a BC format supported for sampling, or the uncompressed fallback.
+			if (is_block_compressed(format))
+			{
+				VkFormatProperties properties{};
+				vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+				CHECK(
+					(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0);
+			}
+			else
+			{
+				bool const is_colour = channels == Channels::kRgb || channels == Channels::kRgba;
+				CHECK(
+					format ==
+					(srgb && is_colour ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM));
+			}
+		}
+	}
+}
+
+TEST_CASE("Benchmark block compression" * doctest::test_suite("benchmark") * doctest::skip())
+{
+	LoggerPtr const logger = create_logger("Benchmark block compression");
+	parallel::ThreadPool pool;
+	parallel::ThreadPool single{0};
+	logger->info(
+		"Best kernel {} with {} threads",
+		simd::kernel_name(simd::best_kernel()),
+		pool.thread_count());
+
+	for (uint32_t const size : {512U, 2048U})
+	{
+		VkExtent2D const extent{.width = size, .height = size};
+		std::vector<std::byte> const texels = make_test_image(extent);
+		double const megapixels = static_cast<double>(size) * size / 1e6;
+		constexpr std::size_t iterations = 5;
+
+		for (auto const & [format, channel_count, min_psnr] : kTestFormats)
+		{
+			std::vector<std::byte> encoded;
+			double const scalar_ms = bench::mean_ms(
+				iterations,
+				[&] { encoded = encode(format, extent, texels, single, simd::Kernel::kScalar); });
+			double const simd_ms = bench::mean_ms(
+				iterations, [&] { encoded = encode(format, extent, texels, single); });
+			double const parallel_ms =
+				bench::mean_ms(iterations, [&] { encoded = encode(format, extent, texels, pool); });
+			logger->info(
+				"{}x{} {} ({:.1f} dB): scalar {:.1f} Mpix/s, {} {:.1f} Mpix/s ({:.1f}x), "
+				"parallel {:.1f} Mpix/s ({:.1f}x)",
+				size,
+				size,
+				string_VkFormat(format),
+				psnr(texels, decode(format, extent, encoded), channel_count),
+				megapixels * 1e3 / scalar_ms,
+				simd::kernel_name(simd::best_kernel()),
+				megapixels * 1e3 / simd_ms,
+				scalar_ms / simd_ms,
+				megapixels * 1e3 / parallel_ms,
+				scalar_ms / parallel_ms);
+		}
+	}
+}
+}  // namespace vulkandemo::bc
@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "parallel.hpp"
+#include "simd.hpp"
+
+/**
+ * CPU encoding of RGBA8 images to block compressed (BC) texture formats, for upload as-is, e.g. via
+ * ktx2::encode_ktx2 and streaming::TextureStreamer.
+ *
+ * Each 4x4 block of texels is encoded independently, so blocks are split across a thread pool.
+ * Within a block, endpoints are fitted along the principal axis of the texels, then refined by a
+ * least squares fit to the chosen indices. Assigning each texel to its nearest interpolated colour
+ * is the hot loop, so uses SIMD kernels chosen at runtime, see simd::Kernel.
+ *
+ * Encoding favours speed over quality: BC7 uses only mode 6, a single RGBA endpoint pair with
+ * 4-bit indices, rather than searching all partitionings and modes.
+ */
+namespace vulkandemo::bc
+{
+/// Width and height of a block, in texels.
+inline constexpr uint32_t kBlockSize = 4;
+
+/// Number of blocks encoded per parallel task.
+inline constexpr std::size_t kChunkBlocks = 256;
+
+/**
+ * Channels of an image that are meaningful, used to choose a suitable format.
+ */
+enum class Channels : uint8_t
+{
+	/// Colour, with alpha ignored.
+	kRgb,
+	kRgba,
+	/// Single channel, e.g. roughness or height.
+	kR,
+	/// Two channels, e.g. tangent space normal XY.
+	kRg
+};
+
+/**
+ * Choose the best format for the channels that the device can sample with optimal tiling.
+ *
+ * In order of preference: BC7 or BC1 for RGB; BC7 or BC3 for RGBA; BC4 for R; BC5 for RG. Falls
+ * back to uncompressed R8G8B8A8 if none are supported.
+ *
+ * If a BC format is returned, the device must be created with the textureCompressionBC feature.
+ *
+ * @param physical_device
+ * @param channels
+ * @param srgb Whether colour channels are sRGB encoded. Ignored for R and RG, since BC4 and BC5
+ * have no sRGB variants.
+ * @return
+ */
+VkFormat choose_format(VkPhysicalDevice physical_device, Channels channels, bool srgb);
+
+/**
+ * @param format
+ * @return Whether `format` is a BC format supported by encode.
+ */
+bool is_block_compressed(VkFormat format);
+
+/**
+ * Size of the encoded image.
+ *
+ * @param format BC format supported by encode, or R8G8B8A8.
+ * @param extent
+ * @return
+ * @throws std::invalid_argument if the format is not supported.
+ */
+std::size_t encoded_size(VkFormat format, VkExtent2D extent);
+
+/**
+ * Encode an image.
+ *
+ * Blocks overhanging the right or bottom edge are padded by clamping to the edge texels. R8G8B8A8
+ * formats are returned unchanged.
+ *
+ * @param format BC1 RGB/RGBA, BC3, BC4 or BC5 UNORM, BC7, or R8G8B8A8, any sRGB variant. BC4 and
+ * BC5 encode the red, and red and green, channels respectively.
+ * @param extent
+ * @param texels Tightly packed rows of RGBA8 texels.
+ * @param pool Threads to encode blocks across.
+ * @param kernel Must be supported, see simd::is_kernel_supported.
+ * @return Blocks in row-major order, see encoded_size.
+ * @throws std::invalid_argument if the format is not supported or `texels` does not match
+ * `extent`.
+ * @throws std::runtime_error if the kernel is not supported.
+ */
+std::vector<std::byte> encode(
+	VkFormat format,
+	VkExtent2D extent,
+	std::span<std::byte const> texels,
+	parallel::ThreadPool & pool,
+	simd::Kernel kernel = simd::best_kernel());
+}  // namespace vulkandemo::bc
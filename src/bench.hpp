@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+
+/**
+ * Small helpers for the benchmark test suite.
+ *
+ * Benchmarks are doctest test cases in the "benchmark" suite that are skipped by default. Run them
+ * with `vulkandemo --test-suite=benchmark --no-skip=true --exit=true`.
+ */
+namespace vulkandemo::bench
+{
+/**
+ * Run a callable a number of times and return the mean wall-clock time per run, in milliseconds.
+ *
+ * @param iterations Number of timed runs.
+ * @param fn Callable to time.
+ * @return Mean milliseconds per run.
+ */
+double mean_ms(std::size_t const iterations, std::invocable auto && fn)
+{
+	using Clock = std::chrono::steady_clock;
+	// Warm-up run, excluded from timings.
+	fn();
+	Clock::time_point const start = Clock::now();
+	for (std::size_t iteration = 0; iteration < iterations; ++iteration)
+		fn();
+	std::chrono::duration<double, std::milli> const elapsed = Clock::now() - start;
+	return elapsed.count() / static_cast<double>(iterations);
+}
+}  // namespace vulkandemo::bench
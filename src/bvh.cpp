@@ -0,0 +1,1099 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner) for `logger`
+
+#include <doctest/doctest.h>
+
+#include "Logger.hpp"
+#include "bench.hpp"
+#include "frustum.hpp"
+#include "maths.hpp"
+#include "parallel.hpp"
+
+namespace vulkandemo::bvh
+{
+namespace
+{
+/// Cost of visiting a node relative to testing a primitive.
+constexpr float kTraversalCost = 1.0F;
+
+/// Primitives above which a split's binning is spread across the thread pool.
+constexpr std::size_t kParallelBinThreshold = 65536;
+
+/// Primitives per parallel binning task.
+constexpr std::size_t kBinChunkSize = 16384;
+
+/// Primitives below which a subtree is built by a single task.
+constexpr std::size_t kMinSubtreeSize = 1024;
+
+using Vec3 = std::array<float, 3>;
+
+constexpr Aabb kEmptyAabb{
+	.min =
+		{std::numeric_limits<float>::infinity(),
+		 std::numeric_limits<float>::infinity(),
+		 std::numeric_limits<float>::infinity()},
+	.max = {
+		-std::numeric_limits<float>::infinity(),
+		-std::numeric_limits<float>::infinity(),
+		-std::numeric_limits<float>::infinity()}};
+
+void grow(Aabb & box, Aabb const & other)
+{
+	for (std::size_t axis = 0; axis < 3; ++axis)
+	{
+		box.min[axis] = std::min(box.min[axis], other.min[axis]);
+		box.max[axis] = std::max(box.max[axis], other.max[axis]);
+	}
+}
+
+void grow(Aabb & box, Vec3 const & point)
+{
+	for (std::size_t axis = 0; axis < 3; ++axis)
+	{
+		box.min[axis] = std::min(box.min[axis], point[axis]);
+		box.max[axis] = std::max(box.max[axis], point[axis]);
+	}
+}
+
+float surface_area(Aabb const & box)
+{
+	float const dx = box.max[0] - box.min[0];
+	float const dy = box.max[1] - box.min[1];
+	float const dz = box.max[2] - box.min[2];
+	if (dx < 0)
+		return 0;
+	return 2 * (dx * dy + dy * dz + dz * dx);
+}
+
+bool overlaps(Aabb const & lhs, Aabb const & rhs)
+{
+	for (std::size_t axis = 0; axis < 3; ++axis)
+		if (lhs.max[axis] < rhs.min[axis] || rhs.max[axis] < lhs.min[axis])
+			return false;
+	return true;
+}
+
+/**
+ * Whether a box is entirely on the outer side of a plane, by testing the corner furthest along
+ * the plane's normal.
+ */
+bool outside_plane(frustum::Plane const & plane, Aabb const & box)
+{
+	float const x = plane[0] >= 0 ? box.max[0] : box.min[0];
+	float const y = plane[1] >= 0 ? box.max[1] : box.min[1];
+	float const z = plane[2] >= 0 ? box.max[2] : box.min[2];
+	return plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0;
+}
+
+/**
+ * Whether a box is entirely on the inner side of a plane, by testing the corner furthest against
+ * the plane's normal.
+ */
+bool inside_plane(frustum::Plane const & plane, Aabb const & box)
+{
+	float const x = plane[0] >= 0 ? box.min[0] : box.max[0];
+	float const y = plane[1] >= 0 ? box.min[1] : box.max[1];
+	float const z = plane[2] >= 0 ? box.min[2] : box.max[2];
+	return plane[0] * x + plane[1] * y + plane[2] * z + plane[3] >= 0;
+}
+
+/**
+ * Whether a box is outside any of the frustum planes in a mask.
+ */
+bool outside_frustum(frustum::Frustum const & frustum, unsigned const plane_mask, Aabb const & box)
+{
+	for (std::size_t plane_idx = 0; plane_idx < frustum.size(); ++plane_idx)
+		if ((plane_mask >> plane_idx) & 1U && outside_plane(frustum[plane_idx], box))
+			return true;
+	return false;
+}
+
+/**
+ * Ray with reciprocal direction precomputed for slab tests.
+ */
+struct PreparedRay
+{
+	Vec3 origin;
+	Vec3 inv_direction;
+};
+
+/**
+ * Distance to where a ray enters a box, zero if starting inside, if entered before a limit.
+ */
+std::optional<float> intersect(PreparedRay const & ray, Aabb const & box, float const limit)
+{
+	float near = 0;
+	float far = limit;
+	for (std::size_t axis = 0; axis < 3; ++axis)
+	{
+		float const t_min = (box.min[axis] - ray.origin[axis]) * ray.inv_direction[axis];
+		float const t_max = (box.max[axis] - ray.origin[axis]) * ray.inv_direction[axis];
+		near = std::max(near, std::min(t_min, t_max));
+		far = std::min(far, std::max(t_min, t_max));
+	}
+	if (near > far)
+		return std::nullopt;
+	return near;
+}
+
+Vec3 centroid(Aabb const & box)
+{
+	return {
+		(box.min[0] + box.max[0]) * 0.5F,
+		(box.min[1] + box.max[1]) * 0.5F,
+		(box.min[2] + box.max[2]) * 0.5F};
+}
+
+struct Bin
+{
+	Aabb bounds = kEmptyAabb;
+	uint32_t count = 0;
+};
+
+using Bins = std::array<Bin, kBinCount>;
+
+/**
+ * Bounds of a range of primitives, and of their centroids.
+ */
+struct RangeBounds
+{
+	Aabb bounds = kEmptyAabb;
+	Aabb centroid_bounds = kEmptyAabb;
+};
+
+/**
+ * Primitive as partitioned during a build, holding everything a split reads so that each range
+ * is scanned sequentially rather than gathered through an index.
+ */
+struct BuildPrimitive
+{
+	Aabb bounds;
+	Vec3 centroid;
+	uint32_t index;
+};
+
+struct BuildContext
+{
+	/// Partitioned in place as nodes are split, ending in leaf order.
+	std::vector<BuildPrimitive> primitives;
+};
+
+/**
+ * Outcome of attempting to split a range of primitives.
+ */
+struct Split
+{
+	Aabb bounds;
+	/// End of the left child's primitives, or nothing if the range should be a leaf.
+	std::optional<std::size_t> mid;
+};
+
+RangeBounds bound_range(BuildContext const & ctx, std::size_t const begin, std::size_t const end)
+{
+	RangeBounds range;
+	for (std::size_t idx = begin; idx < end; ++idx)
+	{
+		BuildPrimitive const & primitive = ctx.primitives[idx];
+		grow(range.bounds, primitive.bounds);
+		grow(range.centroid_bounds, primitive.centroid);
+	}
+	return range;
+}
+
+std::size_t bin_of(float const centroid, float const centroid_min, float const scale)
+{
+	return std::min(kBinCount - 1, static_cast<std::size_t>((centroid - centroid_min) * scale));
+}
+
+Bins bin_range(
+	BuildContext const & ctx,
+	std::size_t const begin,
+	std::size_t const end,
+	std::size_t const axis,
+	float const centroid_min,
+	float const scale)
+{
+	Bins bins{};
+	for (std::size_t idx = begin; idx < end; ++idx)
+	{
+		BuildPrimitive const & primitive = ctx.primitives[idx];
+		Bin & bin = bins[bin_of(primitive.centroid[axis], centroid_min, scale)];
+		grow(bin.bounds, primitive.bounds);
+		++bin.count;
+	}
+	return bins;
+}
+
+/**
+ * Choose a split of primitives `[begin, end)` by binned SAH, and partition them accordingly.
+ *
+ * Binning is spread across the pool, if given and the range is large. Bounds are combined with
+ * min and max only, so are identical however the work is divided.
+ */
+Split split_range(
+	BuildContext & ctx,
+	std::size_t const begin,
+	std::size_t const end,
+	std::size_t const depth,
+	parallel::ThreadPool * const pool)
+{
+	std::size_t const count = end - begin;
+	bool const spread = pool != nullptr && count > kParallelBinThreshold;
+
+	RangeBounds range;
+	if (spread)
+	{
+		std::vector<RangeBounds> chunk_ranges((count + kBinChunkSize - 1) / kBinChunkSize);
+		parallel::for_each_chunk(
+			*pool,
+			count,
+			kBinChunkSize,
+			[&](std::size_t const chunk_idx, std::size_t const from, std::size_t const to)
+			{
+				chunk_ranges[chunk_idx] = bound_range(ctx, begin + from, begin + to);
+			});
+		for (RangeBounds const & chunk_range : chunk_ranges)
+		{
+			grow(range.bounds, chunk_range.bounds);
+			grow(range.centroid_bounds, chunk_range.centroid_bounds);
+		}
+	}
+	else
+	{
+		range = bound_range(ctx, begin, end);
+	}
+
+	Split split{.bounds = range.bounds, .mid = std::nullopt};
+	if (count <= 1 || depth + 1 >= kMaxDepth)
+		return split;
+
+	std::size_t axis = 0;
+	for (std::size_t candidate = 1; candidate < 3; ++candidate)
+		if (range.centroid_bounds.max[candidate] - range.centroid_bounds.min[candidate] >
+			range.centroid_bounds.max[axis] - range.centroid_bounds.min[axis])
+			axis = candidate;
+	float const centroid_min = range.centroid_bounds.min[axis];
+	float const extent = range.centroid_bounds.max[axis] - centroid_min;
+
+	if (extent <= 0)
+	{
+		// Coincident centroids, so no plane separates them. Split arbitrarily if too many.
+		if (count > kMaxLeafSize)
+			split.mid = begin + count / 2;
+		return split;
+	}
+
+	float const scale = static_cast<float>(kBinCount) / extent;
+	Bins bins{};
+	if (spread)
+	{
+		std::vector<Bins> chunk_bins((count + kBinChunkSize - 1) / kBinChunkSize);
+		parallel::for_each_chunk(
+			*pool,
+			count,
+			kBinChunkSize,
+			[&](std::size_t const chunk_idx, std::size_t const from, std::size_t const to)
+			{
+				chunk_bins[chunk_idx] =
+					bin_range(ctx, begin + from, begin + to, axis, centroid_min, scale);
+			});
+		for (Bins const & chunk : chunk_bins)
+			for (std::size_t bin_idx = 0; bin_idx < kBinCount; ++bin_idx)
+			{
+				grow(bins[bin_idx].bounds, chunk[bin_idx].bounds);
+				bins[bin_idx].count += chunk[bin_idx].count;
+			}
+	}
+	else
+	{
+		bins = bin_range(ctx, begin, end, axis, centroid_min, scale);
+	}
+
+	// Sweep from the right accumulating the cost of everything right of each plane, then from
+	// the left to find the cheapest plane. Plane `p` splits bins `[0, p)` from `[p, kBinCount)`.
+	std::array<float, kBinCount> right_costs{};
+	Aabb right_bounds = kEmptyAabb;
+	uint32_t right_count = 0;
+	for (std::size_t bin_idx = kBinCount - 1; bin_idx > 0; --bin_idx)
+	{
+		grow(right_bounds, bins[bin_idx].bounds);
+		right_count += bins[bin_idx].count;
+		right_costs[bin_idx] = surface_area(right_bounds) * static_cast<float>(right_count);
+	}
+
+	std::size_t best_plane = 0;
+	float best_cost = std::numeric_limits<float>::infinity();
+	Aabb left_bounds = kEmptyAabb;
+	uint32_t left_count = 0;
+	for (std::size_t plane = 1; plane < kBinCount; ++plane)
+	{
+		grow(left_bounds, bins[plane - 1].bounds);
+		left_count += bins[plane - 1].count;
+		if (left_count == 0 || left_count == count)
+			continue;
+		float const cost = surface_area(left_bounds) * static_cast<float>(left_count) +
+			right_costs[plane];
+		if (cost < best_cost)
+		{
+			best_cost = cost;
+			best_plane = plane;
+		}
+	}
+
+	// Costs are left unnormalised by the range's surface area, to avoid dividing by zero for
+	// degenerate bounds.
+	float const area = surface_area(range.bounds);
+	float const leaf_cost = area * static_cast<float>(count);
+	float const split_cost = area * kTraversalCost + best_cost;
+	if (count <= kMaxLeafSize && leaf_cost <= split_cost)
+		return split;
+
+	auto const first = ctx.primitives.begin();
+	auto const mid = std::partition(
+		first + static_cast<std::ptrdiff_t>(begin),
+		first + static_cast<std::ptrdiff_t>(end),
+		[&](BuildPrimitive const & primitive)
+		{ return bin_of(primitive.centroid[axis], centroid_min, scale) < best_plane; });
+	split.mid = static_cast<std::size_t>(mid - first);
+	return split;
+}
+
+/**
+ * Recursively build the hierarchy over primitives `[begin, end)`, appending nodes depth first
+ * with indices relative to the start of @p nodes.
+ */
+void build_subtree(
+	BuildContext & ctx,
+	std::size_t const begin,
+	std::size_t const end,
+	std::size_t const depth,
+	std::vector<Node> & nodes)
+{
+	std::size_t const node_idx = nodes.size();
+	nodes.emplace_back();
+	Split const split = split_range(ctx, begin, end, depth, nullptr);
+	nodes[node_idx].bounds = split.bounds;
+
+	if (!split.mid)
+	{
+		nodes[node_idx].first = static_cast<uint32_t>(begin);
+		nodes[node_idx].primitive_count = static_cast<uint32_t>(end - begin);
+		return;
+	}
+
+	build_subtree(ctx, begin, *split.mid, depth + 1, nodes);
+	nodes[node_idx].first = static_cast<uint32_t>(nodes.size());
+	build_subtree(ctx, *split.mid, end, depth + 1, nodes);
+}
+
+/**
+ * Range of primitives built independently of the rest of the hierarchy.
+ */
+struct Subtree
+{
+	std::size_t begin;
+	std::size_t end;
+	std::size_t depth;
+	std::vector<Node> nodes;
+};
+
+/**
+ * Upper node of a hierarchy, either split further or deferred to a Subtree.
+ */
+struct TopNode
+{
+	Aabb bounds;
+	std::size_t left;
+	std::size_t right;
+	std::optional<std::size_t> subtree_idx;
+};
+
+std::size_t build_top(
+	BuildContext & ctx,
+	std::size_t const begin,
+	std::size_t const end,
+	std::size_t const depth,
+	std::size_t const subtree_size,
+	parallel::ThreadPool & pool,
+	std::vector<TopNode> & top_nodes,
+	std::vector<Subtree> & subtrees)
+{
+	std::size_t const top_idx = top_nodes.size();
+	top_nodes.emplace_back();
+
+	std::optional<Split> split;
+	if (end - begin > subtree_size)
+		split = split_range(ctx, begin, end, depth, &pool);
+
+	if (!split || !split->mid)
+	{
+		// Leaves are also deferred, so that their bounds are found the same way as any other.
+		top_nodes[top_idx].subtree_idx = subtrees.size();
+		subtrees.push_back(Subtree{.begin = begin, .end = end, .depth = depth, .nodes = {}});
+		return top_idx;
+	}
+
+	top_nodes[top_idx].bounds = split->bounds;
+	std::size_t const left =
+		build_top(ctx, begin, *split->mid, depth + 1, subtree_size, pool, top_nodes, subtrees);
+	std::size_t const right =
+		build_top(ctx, *split->mid, end, depth + 1, subtree_size, pool, top_nodes, subtrees);
+	top_nodes[top_idx].left = left;
+	top_nodes[top_idx].right = right;
+	return top_idx;
+}
+
+/**
+ * Flatten upper nodes and the subtrees below them depth first, rebasing subtree child indices.
+ */
+void flatten_top(
+	std::vector<TopNode> const & top_nodes,
+	std::vector<Subtree> const & subtrees,
+	std::size_t const top_idx,
+	std::vector<Node> & nodes)
+{
+	TopNode const & top = top_nodes[top_idx];
+	if (top.subtree_idx)
+	{
+		auto const offset = static_cast<uint32_t>(nodes.size());
+		for (Node node : subtrees[*top.subtree_idx].nodes)
+		{
+			if (node.primitive_count == 0)
+				node.first += offset;
+			nodes.push_back(node);
+		}
+		return;
+	}
+
+	std::size_t const node_idx = nodes.size();
+	nodes.push_back(Node{.bounds = top.bounds, .first = 0, .primitive_count = 0});
+	flatten_top(top_nodes, subtrees, top.left, nodes);
+	nodes[node_idx].first = static_cast<uint32_t>(nodes.size());
+	flatten_top(top_nodes, subtrees, top.right, nodes);
+}
+
+BuildContext create_build_context(std::span<Aabb const> const bounds)
+{
+	BuildContext ctx{.primitives = std::vector<BuildPrimitive>(bounds.size())};
+	for (std::size_t idx = 0; idx < bounds.size(); ++idx)
+		ctx.primitives[idx] = BuildPrimitive{
+			.bounds = bounds[idx],
+			.centroid = centroid(bounds[idx]),
+			.index = static_cast<uint32_t>(idx)};
+	return ctx;
+}
+
+Bvh finish_bvh(BuildContext const & ctx, std::vector<Node> && nodes)
+{
+	Bvh bvh{
+		.nodes = std::move(nodes),
+		.primitive_indices = std::vector<uint32_t>(ctx.primitives.size()),
+		.primitive_bounds = std::vector<Aabb>(ctx.primitives.size()),
+		.build_cost = 0};
+	for (std::size_t idx = 0; idx < ctx.primitives.size(); ++idx)
+	{
+		bvh.primitive_indices[idx] = ctx.primitives[idx].index;
+		bvh.primitive_bounds[idx] = ctx.primitives[idx].bounds;
+	}
+	bvh.build_cost = sah_cost(bvh);
+	return bvh;
+}
+
+bool is_leaf(Node const & node)
+{
+	return node.primitive_count != 0;
+}
+
+void append_leaf(Bvh const & bvh, Node const & node, std::vector<uint32_t> & primitives)
+{
+	auto const first = bvh.primitive_indices.begin() + node.first;
+	primitives.insert(primitives.end(), first, first + node.primitive_count);
+}
+}  // namespace
+
+Bvh build_bvh(std::span<Aabb const> const bounds)
+{
+	BuildContext ctx = create_build_context(bounds);
+	std::vector<Node> nodes;
+	if (!bounds.empty())
+		build_subtree(ctx, 0, bounds.size(), 0, nodes);
+	return finish_bvh(ctx, std::move(nodes));
+}
+
+Bvh build_bvh(std::span<Aabb const> const bounds, parallel::ThreadPool & pool)
+{
+	BuildContext ctx = create_build_context(bounds);
+	std::vector<Node> nodes;
+	if (bounds.empty())
+		return finish_bvh(ctx, std::move(nodes));
+
+	// Several subtrees per thread, so that uneven subtrees are balanced across threads.
+	std::size_t const subtree_size =
+		std::max(kMinSubtreeSize, bounds.size() / (pool.thread_count() * 8));
+
+	std::vector<TopNode> top_nodes;
+	std::vector<Subtree> subtrees;
+	build_top(ctx, 0, bounds.size(), 0, subtree_size, pool, top_nodes, subtrees);
+
+	// Each subtree partitions only its own range of primitives.
+	pool.run(
+		subtrees.size(),
+		[&](std::size_t const subtree_idx)
+		{
+			Subtree & subtree = subtrees[subtree_idx];
+			build_subtree(ctx, subtree.begin, subtree.end, subtree.depth, subtree.nodes);
+		});
+
+	std::size_t node_count = top_nodes.size();
+	for (Subtree const & subtree : subtrees)
+		node_count += subtree.nodes.size();
+	nodes.reserve(node_count);
+	flatten_top(top_nodes, subtrees, 0, nodes);
+	return finish_bvh(ctx, std::move(nodes));
+}
+
+void refit_bvh(Bvh & bvh, std::span<Aabb const> const bounds)
+{
+	if (bounds.size() != bvh.primitive_indices.size())
+		throw std::invalid_argument{"BVH refit with a different number of primitives"};
+
+	for (std::size_t idx = 0; idx < bvh.primitive_indices.size(); ++idx)
+		bvh.primitive_bounds[idx] = bounds[bvh.primitive_indices[idx]];
+
+	// Children always follow their parent, so a reverse pass visits children first.
+	for (std::size_t node_idx = bvh.nodes.size(); node_idx-- > 0;)
+	{
+		Node & node = bvh.nodes[node_idx];
+		node.bounds = kEmptyAabb;
+		if (is_leaf(node))
+		{
+			for (uint32_t idx = node.first; idx < node.first + node.primitive_count; ++idx)
+				grow(node.bounds, bvh.primitive_bounds[idx]);
+		}
+		else
+		{
+			grow(node.bounds, bvh.nodes[node_idx + 1].bounds);
+			grow(node.bounds, bvh.nodes[node.first].bounds);
+		}
+	}
+}
+
+float sah_cost(Bvh const & bvh)
+{
+	if (bvh.nodes.empty())
+		return 0;
+	float const root_area = surface_area(bvh.nodes.front().bounds);
+	if (root_area <= 0)
+		return static_cast<float>(bvh.primitive_indices.size());
+
+	float cost = 0;
+	for (Node const & node : bvh.nodes)
+		cost += surface_area(node.bounds) *
+			(is_leaf(node) ? static_cast<float>(node.primitive_count) : kTraversalCost);
+	return cost / root_area;
+}
+
+bool needs_rebuild(Bvh const & bvh, float const threshold)
+{
+	return sah_cost(bvh) > bvh.build_cost * threshold;
+}
+
+void query_frustum(
+	Bvh const & bvh, frustum::Frustum const & frustum, std::vector<uint32_t> & primitives)
+{
+	primitives.clear();
+	if (bvh.nodes.empty())
+		return;
+
+	constexpr unsigned all_planes = (1U << std::tuple_size_v<frustum::Frustum>) - 1;
+
+	struct Entry
+	{
+		uint32_t node_idx;
+		/// Planes that the node has not been found entirely inside.
+		unsigned plane_mask;
+	};
+	std::array<Entry, kMaxDepth> stack;	 // NOLINT(*-member-init) written before read
+	std::size_t stack_size = 0;
+	stack[stack_size++] = {.node_idx = 0, .plane_mask = all_planes};
+
+	while (stack_size > 0)
+	{
+		Entry const entry = stack[--stack_size];
+		Node const & node = bvh.nodes[entry.node_idx];
+
+		unsigned plane_mask = entry.plane_mask;
+		if (outside_frustum(frustum, plane_mask, node.bounds))
+			continue;
+		for (std::size_t plane_idx = 0; plane_idx < frustum.size(); ++plane_idx)
+			if (inside_plane(frustum[plane_idx], node.bounds))
+				plane_mask &= ~(1U << plane_idx);
+
+		if (!is_leaf(node))
+		{
+			stack[stack_size++] = {.node_idx = node.first, .plane_mask = plane_mask};
+			stack[stack_size++] = {.node_idx = entry.node_idx + 1, .plane_mask = plane_mask};
+		}
+		else if (plane_mask == 0)
+		{
+			append_leaf(bvh, node, primitives);
+		}
+		else
+		{
+			for (uint32_t idx = node.first; idx < node.first + node.primitive_count; ++idx)
+				if (!outside_frustum(frustum, plane_mask, bvh.primitive_bounds[idx]))
+					primitives.push_back(bvh.primitive_indices[idx]);
+		}
+	}
+}
+
+void query_aabb(Bvh const & bvh, Aabb const & box, std::vector<uint32_t> & primitives)
+{
+	primitives.clear();
+	if (bvh.nodes.empty())
+		return;
+
+	std::array<uint32_t, kMaxDepth> stack;  // NOLINT(*-member-init) written before read
+	std::size_t stack_size = 0;
+	stack[stack_size++] = 0;
+
+	while (stack_size > 0)
+	{
+		uint32_t const node_idx = stack[--stack_size];
+		Node const & node = bvh.nodes[node_idx];
+		if (!overlaps(node.bounds, box))
+			continue;
+
+		if (!is_leaf(node))
+		{
+			stack[stack_size++] = node.first;
+			stack[stack_size++] = node_idx + 1;
+			continue;
+		}
+		for (uint32_t idx = node.first; idx < node.first + node.primitive_count; ++idx)
+			if (overlaps(bvh.primitive_bounds[idx], box))
+				primitives.push_back(bvh.primitive_indices[idx]);
+	}
+}
+
+std::optional<RayHit> query_ray(Bvh const & bvh, Ray const & ray)
+{
+	if (bvh.nodes.empty())
+		return std::nullopt;
+
+	// Division by zero gives infinity, which the slab test handles as a parallel ray.
+	PreparedRay const prepared{
+		.origin = ray.origin,
+		.inv_direction = {
+			1.0F / ray.direction[0], 1.0F / ray.direction[1], 1.0F / ray.direction[2]}};
+
+	std::optional<RayHit> hit;
+	float limit = ray.max_distance;
+
+	if (!intersect(prepared, bvh.nodes.front().bounds, limit))
+		return std::nullopt;
+
+	std::array<uint32_t, kMaxDepth> stack;  // NOLINT(*-member-init) written before read
+	std::size_t stack_size = 0;
+	stack[stack_size++] = 0;
+
+	while (stack_size > 0)
+	{
+		Node const & node = bvh.nodes[stack[--stack_size]];
+		// Bounds were tested when pushed, but a nearer hit may have been found since.
+		if (!intersect(prepared, node.bounds, limit))
+			continue;
+
+		if (is_leaf(node))
+		{
+			for (uint32_t idx = node.first; idx < node.first + node.primitive_count; ++idx)
+			{
+				std::optional<float> const distance =
+					intersect(prepared, bvh.primitive_bounds[idx], limit);
+				if (!distance || (hit && *distance >= hit->distance))
+					continue;
+				hit = RayHit{.primitive = bvh.primitive_indices[idx], .distance = *distance};
+				limit = *distance;
+			}
+			continue;
+		}
+
+		// Push the further child first, so the nearer is visited next.
+		auto const node_idx = static_cast<uint32_t>(&node - bvh.nodes.data());
+		std::array<uint32_t, 2> children{node_idx + 1, node.first};
+		std::array<std::optional<float>, 2> distances{
+			intersect(prepared, bvh.nodes[children[0]].bounds, limit),
+			intersect(prepared, bvh.nodes[children[1]].bounds, limit)};
+		if (distances[0] && distances[1] && *distances[1] < *distances[0])
+		{
+			std::swap(children[0], children[1]);
+			std::swap(distances[0], distances[1]);
+		}
+		for (std::size_t child = 2; child-- > 0;)
+			if (distances[child])
+				stack[stack_size++] = children[child];
+	}
+	return hit;
+}
+
+bool Rebuilder::start(std::span<Aabb const> const bounds)
+{
+	if (pending())
+		return false;
+
+	done_.store(false, std::memory_order_relaxed);
+	worker_ = std::jthread{
+		[this, snapshot = std::vector<Aabb>{bounds.begin(), bounds.end()}]
+		{
+			result_ = build_bvh(snapshot);
+			done_.store(true, std::memory_order_release);
+		}};
+	return true;
+}
+
+bool Rebuilder::pending() const
+{
+	return worker_.joinable();
+}
+
+std::optional<Bvh> Rebuilder::take(std::span<Aabb const> const bounds)
+{
+	if (!pending() || !done_.load(std::memory_order_acquire))
+		return std::nullopt;
+
+	worker_.join();
+	std::optional<Bvh> bvh = std::move(result_);
+	result_.reset();
+	refit_bvh(*bvh, bounds);
+	return bvh;
+}
+
+namespace
+{
+std::vector<Aabb> make_random_boxes(std::size_t const count, uint32_t const seed)
+{
+	std::mt19937 rng{seed};
+	std::uniform_real_distribution<float> position{-100.0F, 100.0F};
+	std::uniform_real_distribution<float> half_size{0.1F, 2.0F};
+	std::vector<Aabb> boxes(count);
+	for (Aabb & box : boxes)
+	{
+		for (std::size_t axis = 0; axis < 3; ++axis)
+		{
+			float const centre = position(rng);
+			float const half = half_size(rng);
+			box.min[axis] = centre - half;
+			box.max[axis] = centre + half;
+		}
+	}
+	return boxes;
+}
+
+/**
+ * Move every box by a random offset.
+ */
+void jitter_boxes(std::vector<Aabb> & boxes, float const distance, uint32_t const seed)
+{
+	std::mt19937 rng{seed};
+	std::uniform_real_distribution<float> offset{-distance, distance};
+	for (Aabb & box : boxes)
+	{
+		for (std::size_t axis = 0; axis < 3; ++axis)
+		{
+			float const delta = offset(rng);
+			box.min[axis] += delta;
+			box.max[axis] += delta;
+		}
+	}
+}
+
+std::vector<Ray> make_random_rays(std::size_t const count, uint32_t const seed)
+{
+	std::mt19937 rng{seed};
+	std::uniform_real_distribution<float> position{-120.0F, 120.0F};
+	std::vector<Ray> rays(count);
+	for (Ray & ray : rays)
+	{
+		ray.origin = {position(rng), position(rng), position(rng)};
+		Vec3 const target{position(rng), position(rng), position(rng)};
+		for (std::size_t axis = 0; axis < 3; ++axis)
+			ray.direction[axis] = target[axis] - ray.origin[axis];
+		ray.max_distance = 1.0F;
+	}
+	return rays;
+}
+
+/**
+ * Box x, y in [-50, 50] and z in [0, 100], i.e. a portion of the scene.
+ */
+frustum::Frustum make_test_frustum()
+{
+	return frustum::extract_planes(maths::scaling({1.0F / 50, 1.0F / 50, 1.0F / 100}));
+}
+
+std::vector<uint32_t> brute_force_frustum(
+	std::span<Aabb const> const boxes, frustum::Frustum const & frustum)
+{
+	constexpr unsigned all_planes = (1U << std::tuple_size_v<frustum::Frustum>) - 1;
+	std::vector<uint32_t> primitives;
+	for (std::size_t idx = 0; idx < boxes.size(); ++idx)
+		if (!outside_frustum(frustum, all_planes, boxes[idx]))
+			primitives.push_back(static_cast<uint32_t>(idx));
+	return primitives;
+}
+
+std::vector<uint32_t> brute_force_aabb(std::span<Aabb const> const boxes, Aabb const & box)
+{
+	std::vector<uint32_t> primitives;
+	for (std::size_t idx = 0; idx < boxes.size(); ++idx)
+		if (overlaps(boxes[idx], box))
+			primitives.push_back(static_cast<uint32_t>(idx));
+	return primitives;
+}
+
+std::optional<float> brute_force_ray(std::span<Aabb const> const boxes, Ray const & ray)
+{
+	PreparedRay const prepared{
+		.origin = ray.origin,
+		.inv_direction = {
+			1.0F / ray.direction[0], 1.0F / ray.direction[1], 1.0F / ray.direction[2]}};
+	std::optional<float> nearest;
+	for (Aabb const & box : boxes)
+		if (std::optional<float> const distance = intersect(prepared, box, ray.max_distance))
+			nearest = std::min(nearest.value_or(*distance), *distance);
+	return nearest;
+}
+
+std::vector<uint32_t> sorted(std::vector<uint32_t> primitives)
+{
+	std::ranges::sort(primitives);
+	return primitives;
+}
+
+void check_queries(Bvh const & bvh, std::span<Aabb const> const boxes)
+{
+	std::vector<uint32_t> primitives;
+
+	frustum::Frustum const frustum = make_test_frustum();
+	query_frustum(bvh, frustum, primitives);
+	std::vector<uint32_t> const expected_frustum = brute_force_frustum(boxes, frustum);
+	// Sanity check the scene is partially visible.
+	CHECK(!expected_frustum.empty());
+	CHECK(expected_frustum.size() < boxes.size());
+	CHECK(sorted(primitives) == expected_frustum);
+
+	Aabb const box{.min = {-20, -10, -30}, .max = {10, 20, 0}};
+	query_aabb(bvh, box, primitives);
+	std::vector<uint32_t> const expected_aabb = brute_force_aabb(boxes, box);
+	CHECK(!expected_aabb.empty());
+	CHECK(sorted(primitives) == expected_aabb);
+
+	std::size_t hit_count = 0;
+	for (Ray const & ray : make_random_rays(200, 3))
+	{
+		std::optional<RayHit> const hit = query_ray(bvh, ray);
+		std::optional<float> const expected = brute_force_ray(boxes, ray);
+		REQUIRE(hit.has_value() == expected.has_value());
+		if (!hit)
+			continue;
+		++hit_count;
+		CHECK(hit->distance == expected);
+		PreparedRay const prepared{
+			.origin = ray.origin,
+			.inv_direction = {
+				1.0F / ray.direction[0], 1.0F / ray.direction[1], 1.0F / ray.direction[2]}};
+		CHECK(intersect(prepared, boxes[hit->primitive], ray.max_distance) == hit->distance);
+	}
+	CHECK(hit_count > 0);
+}
+}  // namespace
+
+TEST_CASE("Query a bounding volume hierarchy")
+{
+	// Not a multiple of anything in particular, to exercise remainders.
+	std::vector<Aabb> boxes = make_random_boxes(20'003, 42);
+	Bvh bvh = build_bvh(boxes);
+
+	// Every primitive appears in exactly one leaf.
+	std::vector<uint32_t> all_primitives(boxes.size());
+	std::iota(all_primitives.begin(), all_primitives.end(), 0U);
+	CHECK(sorted(bvh.primitive_indices) == all_primitives);
+	CHECK(bvh.build_cost > 0);
+	CHECK(!needs_rebuild(bvh));
+
+	check_queries(bvh, boxes);
+
+	SUBCASE("parallel build is identical")
+	{
+		parallel::ThreadPool pool{3};
+		Bvh const parallel_bvh = build_bvh(boxes, pool);
+		CHECK(parallel_bvh.nodes == bvh.nodes);
+		CHECK(parallel_bvh.primitive_indices == bvh.primitive_indices);
+		CHECK(parallel_bvh.build_cost == bvh.build_cost);
+	}
+
+	SUBCASE("refit after moving")
+	{
+		jitter_boxes(boxes, 20.0F, 7);
+		refit_bvh(bvh, boxes);
+		check_queries(bvh, boxes);
+		CHECK(needs_rebuild(bvh));
+		CHECK(!needs_rebuild(build_bvh(boxes)));
+		CHECK_THROWS_AS(
+			refit_bvh(bvh, std::span{boxes}.first(boxes.size() - 1)), std::invalid_argument);
+	}
+
+	SUBCASE("empty")
+	{
+		Bvh const empty = build_bvh({});
+		std::vector<uint32_t> primitives{1, 2, 3};
+		query_frustum(empty, make_test_frustum(), primitives);
+		CHECK(primitives.empty());
+		query_aabb(empty, Aabb{.min = {-1, -1, -1}, .max = {1, 1, 1}}, primitives);
+		CHECK(primitives.empty());
+		CHECK(!query_ray(empty, Ray{.origin = {}, .direction = {1, 0, 0}, .max_distance = 1}));
+	}
+
+	SUBCASE("coincident primitives")
+	{
+		std::vector<Aabb> const stacked(100, Aabb{.min = {0, 0, 0}, .max = {1, 1, 1}});
+		Bvh const stacked_bvh = build_bvh(stacked);
+		std::vector<uint32_t> primitives;
+		query_aabb(stacked_bvh, Aabb{.min = {0.5F, 0.5F, 0.5F}, .max = {2, 2, 2}}, primitives);
+		CHECK(primitives.size() == stacked.size());
+	}
+}
+
+TEST_CASE("Rebuild a bounding volume hierarchy in the background")
+{
+	std::vector<Aabb> boxes = make_random_boxes(10'000, 42);
+	Bvh bvh = build_bvh(boxes);
+	Rebuilder rebuilder;
+
+	jitter_boxes(boxes, 20.0F, 7);
+	refit_bvh(bvh, boxes);
+	REQUIRE(needs_rebuild(bvh));
+
+	CHECK(rebuilder.start(boxes));
+	CHECK(rebuilder.pending());
+	CHECK(!rebuilder.start(boxes));
+
+	// Primitives continue to move whilst rebuilding.
+	jitter_boxes(boxes, 1.0F, 8);
+	refit_bvh(bvh, boxes);
+
+	std::optional<Bvh> rebuilt;
+	while (!(rebuilt = rebuilder.take(boxes)))
+		std::this_thread::sleep_for(std::chrono::milliseconds{1});
+
+	CHECK(!rebuilder.pending());
+	CHECK(!rebuilder.take(boxes));
+	CHECK(sah_cost(*rebuilt) < sah_cost(bvh));
+	check_queries(*rebuilt, boxes);
+}
+
+TEST_CASE("Benchmark BVH build and queries" * doctest::test_suite("benchmark") * doctest::skip())
+{
+	LoggerPtr const logger = create_logger("Benchmark BVH build and queries");
+	parallel::ThreadPool pool;
+	logger->info("{} threads", pool.thread_count());
+
+	for (std::size_t const primitive_count : {10'000UZ, 100'000UZ, 1'000'000UZ})
+	{
+		std::vector<Aabb> boxes = make_random_boxes(primitive_count, 42);
+		constexpr std::size_t iterations = 10;
+
+		double const build_ms = bench::mean_ms(iterations, [&] { build_bvh(boxes); });
+		double const parallel_build_ms =
+			bench::mean_ms(iterations, [&] { build_bvh(boxes, pool); });
+		Bvh bvh = build_bvh(boxes, pool);
+		double const refit_ms = bench::mean_ms(iterations, [&] { refit_bvh(bvh, boxes); });
+		logger->info(
+			"{} primitives: build {:.3f} ms, parallel {:.3f} ms ({:.1f}x), refit {:.3f} ms, "
+			"{} nodes, SAH cost {:.1f}",
+			primitive_count,
+			build_ms,
+			parallel_build_ms,
+			build_ms / parallel_build_ms,
+			refit_ms,
+			bvh.nodes.size(),
+			bvh.build_cost);
+
+		frustum::Frustum const frustum = make_test_frustum();
+		std::vector<uint32_t> primitives;
+		double const frustum_ms =
+			bench::mean_ms(iterations, [&] { query_frustum(bvh, frustum, primitives); });
+		double const frustum_scan_ms =
+			bench::mean_ms(iterations, [&] { primitives = brute_force_frustum(boxes, frustum); });
+		logger->info(
+			"{} primitives: frustum query {:.3f} ms, linear scan {:.3f} ms ({:.1f}x), {} visible",
+			primitive_count,
+			frustum_ms,
+			frustum_scan_ms,
+			frustum_scan_ms / frustum_ms,
+			primitives.size());
+
+		std::vector<Aabb> const query_boxes = make_random_boxes(1'000, 5);
+		double const aabb_ms = bench::mean_ms(
+			iterations,
+			[&]
+			{
+				for (Aabb const & box : query_boxes)
+					query_aabb(bvh, box, primitives);
+			});
+		logger->info(
+			"{} primitives: {:.0f} AABB queries per second",
+			primitive_count,
+			static_cast<double>(query_boxes.size()) * 1000.0 / aabb_ms);
+
+		// Linear scans are timed over fewer rays, since each is a full pass over every primitive.
+		std::vector<Ray> const rays = make_random_rays(10'000, 3);
+		std::span<Ray const> const scan_rays = std::span{rays}.first(100);
+		// Hits are counted so that queries are not optimised away.
+		std::size_t hit_count = 0;
+		double const ray_ms = bench::mean_ms(
+			iterations,
+			[&]
+			{
+				for (Ray const & ray : rays)
+					hit_count += static_cast<std::size_t>(query_ray(bvh, ray).has_value());
+			});
+		double const ray_scan_ms = bench::mean_ms(
+			iterations,
+			[&]
+			{
+				for (Ray const & ray : scan_rays)
+					hit_count += static_cast<std::size_t>(brute_force_ray(boxes, ray).has_value());
+			});
+		double const rays_per_second = static_cast<double>(rays.size()) * 1000.0 / ray_ms;
+		double const scan_rays_per_second =
+			static_cast<double>(scan_rays.size()) * 1000.0 / ray_scan_ms;
+		logger->info(
+			"{} primitives: {:.0f} rays per second, linear scan {:.0f} ({:.1f}x), {} hits",
+			primitive_count,
+			rays_per_second,
+			scan_rays_per_second,
+			rays_per_second / scan_rays_per_second,
+			hit_count);
+	}
+}
+}  // namespace vulkandemo::bvh
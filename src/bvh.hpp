@@ -0,0 +1,228 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "frustum.hpp"
+#include "parallel.hpp"
+
+/**
+ * Bounding volume hierarchy over axis aligned bounding boxes, for culling and picking without a
+ * linear scan over every object.
+ *
+ * Built top down using the surface area heuristic (SAH) evaluated over a fixed number of bins per
+ * split. Given a thread pool, the upper levels are split on the calling thread, with binning
+ * spread across the pool, then the remaining subtrees are built concurrently.
+ *
+ * Nodes are flattened depth first into a single array, so a node's left child immediately follows
+ * it and only the right child needs an index. Primitive bounds are stored in leaf order, so
+ * leaves read contiguous memory.
+ *
+ * Moving primitives are handled by refitting node bounds bottom up, which keeps the topology but
+ * degrades its quality. Once the SAH cost has grown sufficiently relative to that at build time,
+ * the hierarchy should be rebuilt, e.g. in the background using a Rebuilder.
+ */
+namespace vulkandemo::bvh
+{
+/// Number of candidate split planes per axis is one fewer than this.
+inline constexpr std::size_t kBinCount = 16;
+
+/// Primitives above which a node is always split.
+inline constexpr uint32_t kMaxLeafSize = 4;
+
+/// Maximum depth of a hierarchy, bounding the traversal stack.
+inline constexpr std::size_t kMaxDepth = 64;
+
+/// Ratio of SAH cost after refitting to that at build time beyond which to rebuild.
+inline constexpr float kDefaultRebuildThreshold = 1.5F;
+
+/**
+ * Axis aligned bounding box.
+ */
+struct Aabb
+{
+	std::array<float, 3> min;
+	std::array<float, 3> max;
+
+	bool operator==(Aabb const &) const = default;
+};
+
+/**
+ * Node of a flattened hierarchy, sized so that two share a cache line.
+ */
+struct alignas(32) Node
+{
+	Aabb bounds;
+	/// Index of the right child if an internal node, else the first of the leaf's primitives.
+	uint32_t first;
+	/// Number of primitives if a leaf, or zero if an internal node.
+	uint32_t primitive_count;
+
+	bool operator==(Node const &) const = default;
+};
+static_assert(sizeof(Node) == 32);
+
+/**
+ * Flattened hierarchy over a set of primitives.
+ */
+struct Bvh
+{
+	/// Depth first, root first. Empty if there are no primitives.
+	std::vector<Node> nodes;
+	/// Index of each primitive, as given at build time, in leaf order.
+	std::vector<uint32_t> primitive_indices;
+	/// Bounds of each primitive, in leaf order.
+	std::vector<Aabb> primitive_bounds;
+	/// SAH cost as of the last build, see sah_cost.
+	float build_cost;
+};
+
+/**
+ * Ray segment.
+ */
+struct Ray
+{
+	std::array<float, 3> origin;
+	/// Need not be normalised. Distances are in multiples of its length.
+	std::array<float, 3> direction;
+	float max_distance;
+};
+
+/**
+ * Nearest primitive whose bounds are intersected by a ray.
+ */
+struct RayHit
+{
+	uint32_t primitive;
+	/// Distance along the ray to the entry point of the primitive's bounds, zero if inside.
+	float distance;
+};
+
+/**
+ * Build a hierarchy on the calling thread.
+ *
+ * @param bounds Bounds of each primitive.
+ * @return
+ */
+Bvh build_bvh(std::span<Aabb const> bounds);
+
+/**
+ * Build a hierarchy, splitting upper levels with binning across a thread pool, then building the
+ * subtrees below them concurrently.
+ *
+ * @param bounds Bounds of each primitive.
+ * @param pool
+ * @return Identical to that built by the single-threaded build_bvh.
+ */
+Bvh build_bvh(std::span<Aabb const> bounds, parallel::ThreadPool & pool);
+
+/**
+ * Update node bounds to enclose moved primitives, without changing the hierarchy's topology.
+ *
+ * @param bvh
+ * @param bounds Bounds of each primitive, indexed as at build time.
+ */
+void refit_bvh(Bvh & bvh, std::span<Aabb const> bounds);
+
+/**
+ * Expected cost of a random query, per the surface area heuristic, relative to a single
+ * intersection test against the root bounds.
+ *
+ * @param bvh
+ * @return
+ */
+float sah_cost(Bvh const & bvh);
+
+/**
+ * Whether refitting has degraded a hierarchy enough to warrant a rebuild.
+ *
+ * @param bvh
+ * @param threshold Ratio of current SAH cost to that at build time.
+ * @return
+ */
+bool needs_rebuild(Bvh const & bvh, float threshold = kDefaultRebuildThreshold);
+
+/**
+ * Find primitives whose bounds are at least partially on the inner side of all frustum planes.
+ *
+ * Planes that a node is entirely inside are not tested again for its descendants.
+ *
+ * @param bvh
+ * @param frustum
+ * @param primitives Cleared then filled with indices of primitives, in leaf order.
+ */
+void query_frustum(
+	Bvh const & bvh, frustum::Frustum const & frustum, std::vector<uint32_t> & primitives);
+
+/**
+ * Find primitives whose bounds overlap a box.
+ *
+ * @param bvh
+ * @param box
+ * @param primitives Cleared then filled with indices of primitives, in leaf order.
+ */
+void query_aabb(Bvh const & bvh, Aabb const & box, std::vector<uint32_t> & primitives);
+
+/**
+ * Find the nearest primitive whose bounds are intersected by a ray.
+ *
+ * Children are visited nearest first, and nodes further than the nearest hit so far are skipped.
+ *
+ * @param bvh
+ * @param ray
+ * @return Nothing if no bounds are intersected within the ray's maximum distance.
+ */
+std::optional<RayHit> query_ray(Bvh const & bvh, Ray const & ray);
+
+/**
+ * Rebuilds a hierarchy on a background thread, so that the current hierarchy can continue to be
+ * refitted and queried until the new one is ready.
+ */
+class Rebuilder
+{
+public:
+	Rebuilder() = default;
+	~Rebuilder() = default;
+
+	Rebuilder(Rebuilder const &) = delete;
+	Rebuilder(Rebuilder &&) = delete;
+	Rebuilder & operator=(Rebuilder const &) = delete;
+	Rebuilder & operator=(Rebuilder &&) = delete;
+
+	/**
+	 * Start building from a snapshot of primitive bounds, unless a build is already in progress
+	 * or awaiting collection.
+	 *
+	 * @param bounds Bounds of each primitive, copied.
+	 * @return Whether a build was started.
+	 */
+	bool start(std::span<Aabb const> bounds);
+
+	/**
+	 * @return Whether a build has been started and not yet collected by take.
+	 */
+	[[nodiscard]] bool pending() const;
+
+	/**
+	 * Collect a completed build, refitted to the current bounds of its primitives.
+	 *
+	 * @param bounds Current bounds, since primitives may have moved whilst building. Must be the
+	 * same number of primitives as the snapshot.
+	 * @return Nothing if no build has completed.
+	 */
+	std::optional<Bvh> take(std::span<Aabb const> bounds);
+
+private:
+	std::optional<Bvh> result_;
+	std::atomic<bool> done_ = false;
+	/// Declared last so that it is joined before the result it writes is destroyed.
+	std::jthread worker_;
+};
+}  // namespace vulkandemo::bvh
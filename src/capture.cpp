@@ -0,0 +1,739 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "capture.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner)
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `VK_CHECK`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "barrier.hpp"
+#include "draw.hpp"
+#include "headless.hpp"
+#include "macros.hpp"
+#include "render_graph.hpp"
+#include "setup.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::capture
+{
+namespace
+{
+constexpr std::size_t kBytesPerPixel = 4;
+
+/**
+ * Whether red and blue must be swapped to get RGBA, throwing for unsupported formats.
+ */
+bool is_bgra(VkFormat const format)
+{
+	switch (format)
+	{
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			return false;
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			return true;
+		default:
+			throw std::invalid_argument{
+				std::format("Unsupported capture format {}", string_VkFormat(format))};
+	}
+}
+
+/**
+ * Check a configuration before any resources are allocated for it.
+ */
+CaptureConfig validate_config(CaptureConfig config, VkFormat const format)
+{
+	static_cast<void>(is_bgra(format));	 // Throws if unsupported.
+	if (config.queue_depth == 0)
+		throw std::invalid_argument{"Capture queue depth must be at least one"};
+	return config;
+}
+
+void check_pixels(std::span<std::byte const> const pixels, VkExtent2D const extent)
+{
+	if (pixels.size() != std::size_t{extent.width} * extent.height * kBytesPerPixel)
+		throw std::invalid_argument{"Capture pixel data does not match extent"};
+}
+
+void append(std::vector<std::byte> & out, std::string_view const str)
+{
+	std::ranges::transform(
+		str, std::back_inserter(out), [](char const chr) { return static_cast<std::byte>(chr); });
+}
+
+void append_u32_be(std::vector<std::byte> & out, uint32_t const value)
+{
+	for (int shift = 24; shift >= 0; shift -= 8)
+		out.push_back(static_cast<std::byte>(value >> shift));
+}
+
+constexpr std::array<uint32_t, 256> kCrc32Table = []
+{
+	std::array<uint32_t, 256> table{};
+	for (uint32_t idx = 0; idx < table.size(); ++idx)
+	{
+		uint32_t crc = idx;
+		for (int bit = 0; bit < 8; ++bit)
+			crc = (crc & 1U) != 0 ? 0xEDB88320U ^ (crc >> 1U) : crc >> 1U;
+		table[idx] = crc;
+	}
+	return table;
+}();
+
+uint32_t crc32(std::span<std::byte const> const bytes)
+{
+	uint32_t crc = 0xFFFFFFFFU;
+	for (std::byte const byte : bytes)
+		crc = kCrc32Table[(crc ^ std::to_integer<uint32_t>(byte)) & 0xFFU] ^ (crc >> 8U);
+	return crc ^ 0xFFFFFFFFU;
+}
+
+uint32_t adler32(std::span<std::byte const> const bytes)
+{
+	constexpr uint32_t modulus = 65521;
+	// Largest number of bytes that can be summed before the 32-bit sums may overflow.
+	constexpr std::size_t max_run = 5552;
+
+	uint32_t lo = 1;
+	uint32_t hi = 0;
+	for (std::size_t offset = 0; offset < bytes.size(); offset += max_run)
+	{
+		for (std::byte const byte : bytes.subspan(offset, std::min(max_run, bytes.size() - offset)))
+		{
+			lo += std::to_integer<uint32_t>(byte);
+			hi += lo;
+		}
+		lo %= modulus;
+		hi %= modulus;
+	}
+	return (hi << 16U) | lo;
+}
+
+/**
+ * Append a PNG chunk: length, type, data and CRC of type plus data.
+ */
+void append_png_chunk(
+	std::vector<std::byte> & out,
+	std::string_view const type,
+	std::span<std::byte const> const data)
+{
+	append_u32_be(out, static_cast<uint32_t>(data.size()));
+	std::size_t const crc_begin = out.size();
+	append(out, type);
+	out.insert(out.end(), data.begin(), data.end());
+	append_u32_be(out, crc32(std::span{out}.subspan(crc_begin)));
+}
+}  // namespace
+
+std::vector<std::byte> encode_ppm(
+	std::span<std::byte const> const pixels, VkExtent2D const extent, VkFormat const format)
+{
+	bool const bgra = is_bgra(format);
+	check_pixels(pixels, extent);
+
+	std::vector<std::byte> out;
+	append(out, std::format("P6\n{} {}\n255\n", extent.width, extent.height));
+	out.reserve(out.size() + std::size_t{extent.width} * extent.height * 3);
+
+	for (std::size_t offset = 0; offset < pixels.size(); offset += kBytesPerPixel)
+	{
+		out.push_back(pixels[offset + (bgra ? 2 : 0)]);
+		out.push_back(pixels[offset + 1]);
+		out.push_back(pixels[offset + (bgra ? 0 : 2)]);
+	}
+	return out;
+}
+
+std::vector<std::byte> encode_png(
+	std::span<std::byte const> const pixels, VkExtent2D const extent, VkFormat const format)
+{
+	bool const bgra = is_bgra(format);
+	check_pixels(pixels, extent);
+
+	// Filter type 0 (none) byte, then RGBA pixels, per row.
+	std::size_t const row_size = std::size_t{extent.width} * kBytesPerPixel;
+	std::vector<std::byte> raw;
+	raw.reserve((row_size + 1) * extent.height);
+	for (std::size_t row = 0; row < extent.height; ++row)
+	{
+		raw.push_back(std::byte{0});
+		std::span<std::byte const> const row_pixels = pixels.subspan(row * row_size, row_size);
+		raw.insert(raw.end(), row_pixels.begin(), row_pixels.end());
+		if (bgra)
+			for (std::size_t offset = raw.size() - row_size; offset < raw.size();
+				 offset += kBytesPerPixel)
+				std::swap(raw[offset], raw[offset + 2]);
+	}
+
+	// Zlib stream of stored deflate blocks.
+	constexpr std::size_t max_block_size = std::numeric_limits<uint16_t>::max();
+	std::vector<std::byte> zlib{std::byte{0x78}, std::byte{0x01}};
+	zlib.reserve(raw.size() + (raw.size() / max_block_size + 1) * 5 + 6);
+	for (std::size_t offset = 0; offset == 0 || offset < raw.size(); offset += max_block_size)
+	{
+		std::size_t const block_size = std::min(max_block_size, raw.size() - offset);
+		bool const final = offset + block_size == raw.size();
+		auto const len = static_cast<uint16_t>(block_size);
+		auto const nlen = static_cast<uint16_t>(~len);
+		zlib.insert(
+			zlib.end(),
+			{std::byte{final ? uint8_t{1} : uint8_t{0}},
+			 static_cast<std::byte>(len & 0xFFU),
+			 static_cast<std::byte>(len >> 8U),
+			 static_cast<std::byte>(nlen & 0xFFU),
+			 static_cast<std::byte>(nlen >> 8U)});
+		zlib.insert(
+			zlib.end(),
+			raw.begin() + static_cast<std::ptrdiff_t>(offset),
+			raw.begin() + static_cast<std::ptrdiff_t>(offset + block_size));
+	}
+	append_u32_be(zlib, adler32(raw));
+
+	std::vector<std::byte> header;
+	append_u32_be(header, extent.width);
+	append_u32_be(header, extent.height);
+	// Bit depth 8, colour type 6 (RGBA), default compression, filter and interlace methods.
+	header.insert(
+		header.end(), {std::byte{8}, std::byte{6}, std::byte{0}, std::byte{0}, std::byte{0}});
+
+	std::vector<std::byte> out{
+		std::byte{0x89},
+		std::byte{'P'},
+		std::byte{'N'},
+		std::byte{'G'},
+		std::byte{'\r'},
+		std::byte{'\n'},
+		std::byte{0x1A},
+		std::byte{'\n'}};
+	append_png_chunk(out, "IHDR", header);
+	append_png_chunk(out, "IDAT", zlib);
+	append_png_chunk(out, "IEND", {});
+	return out;
+}
+
+FrameCapture::FrameCapture(
+	LoggerPtr logger,
+	types::VulkanDevicePtr device,
+	VkPhysicalDevice physical_device,
+	types::VulkanQueueFamilyIdx const queue_family_idx,
+	VkFormat const format,
+	VkExtent2D const extent,
+	CaptureConfig config)
+	: logger_{std::move(logger)},
+	  device_{std::move(device)},
+	  format_{format},
+	  extent_{extent},
+	  config_{validate_config(std::move(config), format)},
+	  command_pool_{setup::create_command_pool(device_, queue_family_idx)},
+	  command_buffers_{setup::create_primary_command_buffers(
+		  device_,
+		  command_pool_,
+		  types::VulkanCommandBufferCount{static_cast<uint32_t>(config_.queue_depth)})}
+{
+	// Cached memory is much faster for the encoder to read, if available.
+	types::VulkanMemoryTypeIdx const memory_type_idx = [&]
+	{
+		constexpr VkMemoryPropertyFlags required_flags =
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		std::vector<types::VulkanMemoryTypeIdx> const cached = setup::filter_available_memory_types(
+			logger_, physical_device, required_flags | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+		if (!cached.empty())
+			return cached.front();
+		return setup::filter_available_memory_types(logger_, physical_device, required_flags)
+			.at(0);
+	}();
+
+	VkDeviceSize const size = VkDeviceSize{extent.width} * extent.height * kBytesPerPixel;
+	for (std::size_t slot_idx = 0; slot_idx < config_.queue_depth; ++slot_idx)
+	{
+		auto [buffer, memory, mapped] = draw::create_exclusive_mapped_buffer_and_memory(
+			device_, memory_type_idx, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+		slots_.push_back(Slot{
+			.buffer = std::move(buffer),
+			.memory = std::move(memory),
+			.pixels = mapped,
+			.fence = setup::create_fence(device_, false),
+			.command_buffer = command_buffers_->at(slot_idx),
+			.frame_idx = 0});
+		free_slots_.push_back(slot_idx);
+	}
+
+	encoder_ = std::jthread{[this] { encode(); }};
+}
+
+FrameCapture::~FrameCapture()
+{
+	{
+		std::lock_guard const lock{mutex_};
+		stopping_ = true;
+	}
+	queued_.notify_one();
+	// Encoder drains pending captures, then is joined on destruction of `encoder_`.
+}
+
+bool FrameCapture::capture(
+	VkQueue queue,
+	VkImage image,
+	VkImageLayout const layout,
+	std::size_t const frame_idx,
+	types::VulkanSemaphorePtr const & wait_semaphore,
+	types::VulkanSemaphorePtr const & signal_semaphore)
+{
+	std::size_t slot_idx = 0;
+	{
+		std::unique_lock lock{mutex_};
+		if (free_slots_.empty())
+		{
+			if (config_.overflow == Overflow::kDrop)
+			{
+				++dropped_count_;
+				return false;
+			}
+			freed_.wait(lock, [this] { return !free_slots_.empty(); });
+		}
+		slot_idx = free_slots_.back();
+		free_slots_.pop_back();
+	}
+
+	// Slot is exclusively owned by this thread until queued below.
+	Slot & slot = slots_[slot_idx];
+	slot.frame_idx = frame_idx;
+
+	VkFence fence = slot.fence.get();
+	VK_CHECK(vkResetFences(device_.get(), 1, &fence), "Failed to reset capture fence");
+
+	constexpr VkCommandBufferBeginInfo command_buffer_begin_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = nullptr};
+	VK_CHECK(
+		vkBeginCommandBuffer(slot.command_buffer, &command_buffer_begin_info),
+		"Failed to begin capture command buffer");
+
+	constexpr VkImageSubresourceRange subresource_range{
+		.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+		.baseMipLevel = 0,
+		.levelCount = 1,
+		.baseArrayLayer = 0,
+		.layerCount = 1};
+
+	using render_graph::Access;
+	using render_graph::state_of;
+	// Any prior or later work on the queue, e.g. rendering into the image, in the caller's layout.
+	render_graph::ResourceState const queue_work{
+		.stages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+		.access = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+		.layout = layout};
+
+	barrier::populate_cmd_barriers(
+		slot.command_buffer,
+		std::nullopt,
+		std::array{barrier::image_barrier(
+			image, subresource_range, queue_work, state_of(Access::kTransferRead))});
+
+	VkBufferImageCopy const region{
+		.bufferOffset = 0,
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+		.imageOffset = {0, 0, 0},
+		.imageExtent = {extent_.width, extent_.height, 1}};
+	vkCmdCopyImageToBuffer(
+		slot.command_buffer,
+		image,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		slot.buffer.get(),
+		1,
+		&region);
+
+	// Restore layout before any later work on the queue touches the image, and make the copy
+	// visible to the host.
+	barrier::populate_cmd_barriers(
+		slot.command_buffer,
+		barrier::memory_barrier(state_of(Access::kTransferWrite), state_of(Access::kHostRead)),
+		std::array{barrier::image_barrier(
+			image, subresource_range, state_of(Access::kTransferRead), queue_work)});
+
+	VK_CHECK(vkEndCommandBuffer(slot.command_buffer), "Failed to end capture command buffer");
+
+	draw::submit_command_buffer(
+		queue, slot.command_buffer, wait_semaphore, signal_semaphore, slot.fence);
+
+	{
+		std::lock_guard const lock{mutex_};
+		pending_slots_.push_back(slot_idx);
+	}
+	queued_.notify_one();
+	return true;
+}
+
+void FrameCapture::flush()
+{
+	std::unique_lock lock{mutex_};
+	freed_.wait(lock, [this] { return free_slots_.size() == slots_.size(); });
+}
+
+std::size_t FrameCapture::written_count() const
+{
+	std::lock_guard const lock{mutex_};
+	return written_count_;
+}
+
+std::size_t FrameCapture::failed_count() const
+{
+	std::lock_guard const lock{mutex_};
+	return failed_count_;
+}
+
+std::size_t FrameCapture::dropped_count() const
+{
+	std::lock_guard const lock{mutex_};
+	return dropped_count_;
+}
+
+void FrameCapture::encode()
+{
+	while (true)
+	{
+		std::size_t slot_idx = 0;
+		{
+			std::unique_lock lock{mutex_};
+			queued_.wait(lock, [this] { return stopping_ || !pending_slots_.empty(); });
+			// Drain pending captures before stopping.
+			if (pending_slots_.empty())
+				return;
+			slot_idx = pending_slots_.front();
+			pending_slots_.pop_front();
+		}
+
+		Slot const & slot = slots_[slot_idx];
+		bool written = false;
+		try
+		{
+			VkFence fence = slot.fence.get();
+			VK_CHECK(
+				vkWaitForFences(
+					device_.get(), 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max()),
+				"Failed to wait for capture fence");
+			write(slot);
+			written = true;
+		}
+		catch (std::exception const & exc)
+		{
+			logger_->error("Failed to capture frame {}: {}", slot.frame_idx, exc.what());
+		}
+
+		{
+			std::lock_guard const lock{mutex_};
+			free_slots_.push_back(slot_idx);
+			++(written ? written_count_ : failed_count_);
+		}
+		freed_.notify_all();
+	}
+}
+
+void FrameCapture::write(Slot const & slot)
+{
+	bool const png = config_.file_format == FileFormat::kPng;
+	std::vector<std::byte> const encoded = png ? encode_png(slot.pixels, extent_, format_)
+											   : encode_ppm(slot.pixels, extent_, format_);
+
+	std::filesystem::path const path =
+		config_.directory / std::format("frame_{:06}.{}", slot.frame_idx, png ? "png" : "ppm");
+	std::ofstream file{path, std::ios::binary};
+	file.write(
+		reinterpret_cast<char const *>(encoded.data()),	 // NOLINT(*-reinterpret-cast)
+		static_cast<std::streamsize>(encoded.size()));
+	if (!file)
+		throw std::runtime_error{std::format("Failed to write {}", path.string())};
+}
+
+TEST_CASE("Encode captured frames")
+{
+	// 2x2 BGRA: red, green / blue, white.
+	std::array const bgra{
+		std::byte{0},	std::byte{0},	std::byte{255}, std::byte{255},
+		std::byte{0},	std::byte{255}, std::byte{0},	std::byte{255},
+		std::byte{255}, std::byte{0},	std::byte{0},	std::byte{255},
+		std::byte{255}, std::byte{255}, std::byte{255}, std::byte{128}};
+	constexpr VkExtent2D extent{2, 2};
+
+	SUBCASE("PPM")
+	{
+		std::vector<std::byte> const ppm = encode_ppm(bgra, extent, VK_FORMAT_B8G8R8A8_UNORM);
+
+		std::vector<std::byte> expected;
+		append(expected, "P6\n2 2\n255\n");
+		for (uint8_t const value : {255, 0, 0, 0, 255, 0, 0, 0, 255, 255, 255, 255})
+			expected.push_back(std::byte{value});
+		CHECK(ppm == expected);
+	}
+
+	SUBCASE("PNG")
+	{
+		std::vector<std::byte> const png = encode_png(bgra, extent, VK_FORMAT_B8G8R8A8_UNORM);
+
+		auto const as_bytes = [](std::initializer_list<uint8_t> const values)
+		{
+			std::vector<std::byte> out;
+			for (uint8_t const value : values)
+				out.push_back(std::byte{value});
+			return out;
+		};
+
+		// Signature.
+		CHECK(std::ranges::equal(
+			std::span{png}.first(8), as_bytes({0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'})));
+		// IHDR: length 13, type, 2x2, 8-bit RGBA.
+		CHECK(std::ranges::equal(
+			std::span{png}.subspan(8, 8 + 13),
+			as_bytes({0, 0, 0, 13, 'I', 'H', 'D', 'R', 0, 0, 0, 2, 0, 0, 0, 2, 8, 6, 0, 0, 0})));
+		// Well-known IEND chunk, including CRC.
+		CHECK(std::ranges::equal(
+			std::span{png}.last(12),
+			as_bytes({0, 0, 0, 0, 'I', 'E', 'N', 'D', 0xAE, 0x42, 0x60, 0x82})));
+
+		// IDAT holds a single stored block of filtered RGBA rows.
+		std::vector<std::byte> const raw = as_bytes(
+			{0, 255, 0, 0, 255, 0, 255, 0, 255, 0, 0, 0, 255, 255, 255, 255, 255, 128});
+		std::size_t const idat_offset = 8 + 12 + 13;
+		std::span<std::byte const> const idat = std::span{png}.subspan(idat_offset + 8);
+		CHECK(std::ranges::equal(idat.first(7), as_bytes({0x78, 0x01, 1, 18, 0, 0xED, 0xFF})));
+		CHECK(std::ranges::equal(idat.subspan(7, raw.size()), raw));
+		// Adler-32 of the raw data, big endian.
+		CHECK(std::ranges::equal(
+			idat.subspan(7 + raw.size(), 4), as_bytes({0x49, 0x49, 0x09, 0x78})));
+	}
+
+	SUBCASE("large PNG uses multiple stored blocks")
+	{
+		constexpr VkExtent2D large_extent{200, 100};
+		std::vector<std::byte> const pixels(
+			std::size_t{large_extent.width} * large_extent.height * kBytesPerPixel,
+			std::byte{7});
+		std::vector<std::byte> const png =
+			encode_png(pixels, large_extent, VK_FORMAT_R8G8B8A8_UNORM);
+
+		// Signature, IHDR, IDAT header, zlib header, 2 block headers, data, adler, IDAT CRC, IEND.
+		std::size_t const raw_size =
+			(std::size_t{large_extent.width} * kBytesPerPixel + 1) * large_extent.height;
+		CHECK(png.size() == 8 + 25 + 8 + 2 + 2 * 5 + raw_size + 4 + 4 + 12);
+	}
+
+	CHECK_THROWS_AS(encode_ppm(bgra, extent, VK_FORMAT_R16G16B16A16_SFLOAT), std::invalid_argument);
+	CHECK_THROWS_AS(encode_png(bgra, {3, 3}, VK_FORMAT_R8G8B8A8_UNORM), std::invalid_argument);
+}
+
+TEST_CASE("Capture offscreen frames asynchronously")
+{
+	vulkandemo::LoggerPtr const logger =
+		vulkandemo::create_logger("Capture offscreen frames asynchronously");
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		nullptr,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE,
+		.dynamicRendering = VK_TRUE};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan13_features};
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{},
+		&features);
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	constexpr std::size_t ring_size = 2;
+	constexpr VkExtent2D extent{64, 32};
+	headless::OffscreenRing ring = headless::create_offscreen_ring(
+		device,
+		physical_device,
+		VK_FORMAT_B8G8R8A8_UNORM,
+		extent,
+		ring_size,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{ring_size});
+
+	render_graph::RenderGraph graph;
+	render_graph::ResourceId const target = render_graph::import_image(
+		graph,
+		"offscreen",
+		{.format = ring.format, .extent = ring.extent},
+		headless::kOffscreenAcquired);
+	render_graph::add_pass(
+		graph,
+		{.name = "clear",
+		 .colour_attachments = {{.image = target, .clear_value = {.float32 = {1, 0.5F, 0, 1}}}}});
+	render_graph::CompiledRenderGraph compiled =
+		render_graph::compile_render_graph(device, physical_device, std::move(graph));
+
+	std::filesystem::path const directory =
+		std::filesystem::temp_directory_path() / "vulkandemo_capture_test";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+
+	constexpr std::size_t frame_count = 8;
+
+	for (Overflow const overflow : {Overflow::kDrop, Overflow::kBlock})
+	{
+		CAPTURE(static_cast<int>(overflow));
+		FrameCapture frame_capture{
+			logger,
+			device,
+			physical_device,
+			queue_family_idx,
+			ring.format,
+			ring.extent,
+			{.directory = directory,
+			 .file_format = FileFormat::kPpm,
+			 .queue_depth = 1,
+			 .overflow = overflow}};
+
+		for (std::size_t frame = 0; frame < frame_count; ++frame)
+		{
+			types::VulkanImageIdx const image_idx = headless::acquire_offscreen_image(device, ring);
+			render_graph::bind_imported_image(
+				compiled,
+				target,
+				ring.images.at(image_idx).get(),
+				ring.image_views.at(image_idx).get());
+			VkCommandBuffer command_buffer = command_buffers->at(image_idx);
+			render_graph::populate_cmd_render_graph(command_buffer, compiled);
+			draw::submit_command_buffer(
+				queue, command_buffer, nullptr, nullptr, ring.fences.at(image_idx));
+
+			frame_capture.capture(
+				queue,
+				ring.images.at(image_idx).get(),
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				frame);
+		}
+		frame_capture.flush();
+
+		CHECK(frame_capture.written_count() + frame_capture.dropped_count() == frame_count);
+		CHECK(frame_capture.failed_count() == 0);
+		if (overflow == Overflow::kBlock)
+			CHECK(frame_capture.dropped_count() == 0);
+	}
+
+	{
+		// Writing to a directory that doesn't exist fails, which is counted separately.
+		FrameCapture frame_capture{
+			logger,
+			device,
+			physical_device,
+			queue_family_idx,
+			ring.format,
+			ring.extent,
+			{.directory = directory / "missing",
+			 .file_format = FileFormat::kPpm,
+			 .queue_depth = 1}};
+
+		types::VulkanImageIdx const image_idx = headless::acquire_offscreen_image(device, ring);
+		render_graph::bind_imported_image(
+			compiled,
+			target,
+			ring.images.at(image_idx).get(),
+			ring.image_views.at(image_idx).get());
+		VkCommandBuffer command_buffer = command_buffers->at(image_idx);
+		render_graph::populate_cmd_render_graph(command_buffer, compiled);
+		draw::submit_command_buffer(
+			queue, command_buffer, nullptr, nullptr, ring.fences.at(image_idx));
+		frame_capture.capture(
+			queue,
+			ring.images.at(image_idx).get(),
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			0);
+		frame_capture.flush();
+
+		CHECK(frame_capture.written_count() == 0);
+		CHECK(frame_capture.failed_count() == 1);
+	}
+
+	CHECK_THROWS_AS(
+		(FrameCapture{
+			logger,
+			device,
+			physical_device,
+			queue_family_idx,
+			ring.format,
+			ring.extent,
+			{.directory = directory, .queue_depth = 0}}),
+		std::invalid_argument);
+
+	VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+
+	// Every frame was captured in blocking mode, so all files exist.
+	for (std::size_t frame = 0; frame < frame_count; ++frame)
+	{
+		std::filesystem::path const path = directory / std::format("frame_{:06}.ppm", frame);
+		REQUIRE(std::filesystem::exists(path));
+
+		std::ifstream file{path, std::ios::binary};
+		std::string header;
+		std::getline(file, header);
+		CHECK(header == "P6");
+		std::getline(file, header);
+		CHECK(header == "64 32");
+		std::getline(file, header);
+		CHECK(header == "255");
+
+		std::array<char, 3> first_pixel{};
+		file.read(first_pixel.data(), first_pixel.size());
+		CHECK(static_cast<uint8_t>(first_pixel[0]) == 255);
+		CHECK(static_cast<uint8_t>(first_pixel[1]) == 128);
+		CHECK(static_cast<uint8_t>(first_pixel[2]) == 0);
+	}
+
+	std::filesystem::remove_all(directory);
+}
+}  // namespace vulkandemo::capture
@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "types.hpp"
+
+/**
+ * Asynchronous capture of rendered frames to image files.
+ *
+ * Captured images are copied into a ring of host visible staging buffers by a separate submission
+ * on the render queue. A background encoder thread waits for each copy's fence, then encodes and
+ * writes the file, so the render thread never waits on readback or disk.
+ */
+namespace vulkandemo::capture
+{
+enum class FileFormat : uint8_t
+{
+	/// Binary portable pixmap. Fastest to write.
+	kPpm,
+	/// Uncompressed (stored deflate) PNG.
+	kPng
+};
+
+/**
+ * What to do when a capture is requested but all staging buffers are in use.
+ */
+enum class Overflow : uint8_t
+{
+	/// Skip the capture. The render thread never waits.
+	kDrop,
+	/// Wait for the encoder to free a staging buffer, throttling rendering to encoding speed.
+	kBlock
+};
+
+struct CaptureConfig
+{
+	/// Existing directory to write files to, named by frame index.
+	std::filesystem::path directory;
+	FileFormat file_format = FileFormat::kPng;
+	/// Maximum captures being copied or awaiting encoding. Each holds one staging buffer.
+	std::size_t queue_depth = 3;
+	Overflow overflow = Overflow::kDrop;
+};
+
+/**
+ * Encode tightly packed 8-bit RGBA or BGRA pixels as a binary PPM, discarding alpha.
+ *
+ * @param pixels Rows top to bottom.
+ * @param extent
+ * @param format One of the 8-bit four channel RGBA or BGRA formats.
+ * @return
+ */
+std::vector<std::byte> encode_ppm(
+	std::span<std::byte const> pixels, VkExtent2D extent, VkFormat format);
+
+/**
+ * Encode tightly packed 8-bit RGBA or BGRA pixels as an RGBA PNG.
+ *
+ * Deflate blocks are stored uncompressed, trading file size for encoding speed and avoiding a
+ * compression dependency.
+ *
+ * @param pixels Rows top to bottom.
+ * @param extent
+ * @param format One of the 8-bit four channel RGBA or BGRA formats.
+ * @return
+ */
+std::vector<std::byte> encode_png(
+	std::span<std::byte const> pixels, VkExtent2D extent, VkFormat format);
+
+/**
+ * Staging ring and encoder thread for capturing images of a fixed format and size.
+ *
+ * Captures must be requested from a single (render) thread. The destructor waits for all
+ * requested captures to be written.
+ */
+class FrameCapture
+{
+public:
+	/**
+	 * Allocate staging buffers and start the encoder thread.
+	 *
+	 * @param logger For reporting encoding failures.
+	 * @param device Must have the synchronization2 feature enabled.
+	 * @param physical_device
+	 * @param queue_family_idx Family of the queue that captures will be submitted to.
+	 * @param format One of the 8-bit four channel RGBA or BGRA formats.
+	 * @param extent
+	 * @param config
+	 * @throws std::invalid_argument if the format is not supported or the queue depth is zero.
+	 */
+	FrameCapture(
+		LoggerPtr logger,
+		types::VulkanDevicePtr device,
+		VkPhysicalDevice physical_device,
+		types::VulkanQueueFamilyIdx queue_family_idx,
+		VkFormat format,
+		VkExtent2D extent,
+		CaptureConfig config);
+	~FrameCapture();
+
+	FrameCapture(FrameCapture const &) = delete;
+	FrameCapture(FrameCapture &&) = delete;
+	FrameCapture & operator=(FrameCapture const &) = delete;
+	FrameCapture & operator=(FrameCapture &&) = delete;
+
+	/**
+	 * Submit a copy of an image to a staging buffer, to be encoded once complete.
+	 *
+	 * The copy is submitted after previously submitted work on the queue, and waits for all of it
+	 * to complete before reading. The image is returned to its original layout afterwards.
+	 *
+	 * To capture a swapchain image before presentation, chain the semaphores, i.e. wait on the
+	 * render submission's signal semaphore, and have presentation wait on @p signal_semaphore -
+	 * but only if the capture was not dropped.
+	 *
+	 * @param queue
+	 * @param image Image of the configured format and extent, with transfer source usage.
+	 * @param layout Current layout of the image, and the layout it is left in.
+	 * @param frame_idx Used to name the file.
+	 * @param wait_semaphore Optional semaphore to wait on before copying.
+	 * @param signal_semaphore Optional semaphore to signal once the copy completes.
+	 * @return Whether the capture was submitted, i.e. false if dropped, see Overflow.
+	 */
+	bool capture(
+		VkQueue queue,
+		VkImage image,
+		VkImageLayout layout,
+		std::size_t frame_idx,
+		types::VulkanSemaphorePtr const & wait_semaphore = nullptr,
+		types::VulkanSemaphorePtr const & signal_semaphore = nullptr);
+
+	/**
+	 * Block until all submitted captures have been written.
+	 */
+	void flush();
+
+	/**
+	 * @return Number of files written.
+	 */
+	[[nodiscard]] std::size_t written_count() const;
+
+	/**
+	 * @return Number of submitted captures that failed to be written, as reported to the logger.
+	 */
+	[[nodiscard]] std::size_t failed_count() const;
+
+	/**
+	 * @return Number of captures dropped due to a full queue.
+	 */
+	[[nodiscard]] std::size_t dropped_count() const;
+
+private:
+	struct Slot
+	{
+		types::VulkanBufferPtr buffer;
+		types::VulkanDeviceMemoryPtr memory;
+		std::span<std::byte const> pixels;
+		types::VulkanFencePtr fence;
+		VkCommandBuffer command_buffer;
+		std::size_t frame_idx;
+	};
+
+	void encode();
+	void write(Slot const & slot);
+
+	LoggerPtr logger_;
+	types::VulkanDevicePtr device_;
+	VkFormat format_;
+	VkExtent2D extent_;
+	CaptureConfig config_;
+	types::VulkanCommandPoolPtr command_pool_;
+	types::VulkanCommandBuffersPtr command_buffers_;
+	std::vector<Slot> slots_;
+
+	mutable std::mutex mutex_;
+	/// Notified when a capture is queued for encoding, or on shutdown.
+	std::condition_variable queued_;
+	/// Notified when the encoder returns a slot to the free list.
+	std::condition_variable freed_;
+	std::vector<std::size_t> free_slots_;
+	/// Slots submitted for copy, in submission order.
+	std::deque<std::size_t> pending_slots_;
+	std::size_t written_count_ = 0;
+	std::size_t failed_count_ = 0;
+	std::size_t dropped_count_ = 0;
+	bool stopping_ = false;
+
+	/// Last member, so it is joined before anything it uses is destroyed.
+	std::jthread encoder_;
+};
+}  // namespace vulkandemo::capture
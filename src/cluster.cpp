@@ -0,0 +1,764 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "cluster.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <range/v3/range/conversion.hpp>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner)
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `VK_CHECK`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "barrier.hpp"
+#include "bench.hpp"
+#include "compute.hpp"
+#include "draw.hpp"
+#include "macros.hpp"
+#include "maths.hpp"
+#include "render_graph.hpp"
+#include "setup.hpp"
+#include "shaders.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::cluster
+{
+namespace
+{
+/// Push constants of `cluster_lights.comp`.
+struct PushConstants
+{
+	maths::Mat4 view;
+	uint32_t light_count;
+	uint32_t index_capacity;
+};
+static_assert(sizeof(PushConstants) == 80);
+
+/// Limit on dispatched work groups in one dimension guaranteed by the Vulkan spec.
+constexpr uint32_t kMaxClusterCount = 65535;
+
+/// Bounds, lights, ranges, indices and count, see cluster_lights.comp.
+constexpr std::array<compute::BindingType, 5> kBindings{
+	compute::BindingType::kStorageBuffer,
+	compute::BindingType::kStorageBuffer,
+	compute::BindingType::kStorageBuffer,
+	compute::BindingType::kStorageBuffer,
+	compute::BindingType::kStorageBuffer};
+
+/// State of the light lists once ready for shading and host readback.
+constexpr render_graph::ResourceState kShadableAndHostReadable{
+	.stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_HOST_BIT,
+	.access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_HOST_READ_BIT,
+	.layout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+/**
+ * Buffers in binding order.
+ */
+std::array<compute::Binding, kBindings.size()> buffer_bindings(ClusterBuffers const & buffers)
+{
+	return {
+		compute::Binding{compute::StorageBuffer{.buffer = buffers.bounds_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = buffers.lights_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = buffers.ranges_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = buffers.indices_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = buffers.count_buffer.get()}}};
+}
+
+/**
+ * Scale and bias mapping log2 of view depth to a fractional slice, see depth_slice.
+ */
+std::pair<float, float> slice_scale_bias(ClusterGrid const & grid)
+{
+	float const scale = static_cast<float>(grid.slices) / std::log2(grid.far / grid.near);
+	return {scale, -std::log2(grid.near) * scale};
+}
+
+/**
+ * View depth of the near side of a slice.
+ */
+float slice_depth(ClusterGrid const & grid, uint32_t const slice)
+{
+	return grid.near *
+		std::pow(grid.far / grid.near,
+				 static_cast<float>(slice) / static_cast<float>(grid.slices));
+}
+
+/**
+ * Check whether a sphere overlaps a box, by the distance from its centre to the closest point of
+ * the box, matching `cluster_lights.comp`.
+ */
+bool intersects(ClusterBounds const & bounds, maths::Vec3 const & centre, float const radius)
+{
+	std::array const point{centre.x, centre.y, centre.z};
+	float distance_sq = 0.0F;
+	for (std::size_t axis = 0; axis < point.size(); ++axis)
+	{
+		float const offset =
+			point[axis] - std::clamp(point[axis], bounds.min[axis], bounds.max[axis]);
+		distance_sq += offset * offset;
+	}
+	return distance_sq <= radius * radius;
+}
+}  // namespace
+
+uint32_t ClusterGrid::cluster_count() const
+{
+	return tiles_x * tiles_y * slices;
+}
+
+std::vector<ClusterBounds> compute_cluster_bounds(
+	ClusterGrid const & grid, maths::Mat4 const & projection)
+{
+	// A symmetric perspective projection maps view (x, y) at depth d to NDC (x, y) * scale / d.
+	float const inv_scale_x = 1.0F / projection.columns[0].x;
+	float const inv_scale_y = 1.0F / projection.columns[1].y;
+
+	// Extent along an axis of the part of a tile, spanning NDC [ndc0, ndc1], between two depths.
+	auto const extent = [](float const ndc0, float const ndc1, float const inv_scale,
+						   float const depth0, float const depth1)
+	{
+		std::array const corners{
+			ndc0 * inv_scale * depth0,
+			ndc1 * inv_scale * depth0,
+			ndc0 * inv_scale * depth1,
+			ndc1 * inv_scale * depth1};
+		return std::ranges::minmax(corners);
+	};
+	auto const tile_ndc = [](uint32_t const tile, uint32_t const tile_count)
+	{ return -1.0F + 2.0F * static_cast<float>(tile) / static_cast<float>(tile_count); };
+
+	std::vector<ClusterBounds> bounds;
+	bounds.reserve(grid.cluster_count());
+	for (uint32_t slice = 0; slice < grid.slices; ++slice)
+	{
+		float const depth0 = slice_depth(grid, slice);
+		// Exactly the far plane for the last slice, rather than subject to rounding.
+		float const depth1 = slice + 1 == grid.slices ? grid.far : slice_depth(grid, slice + 1);
+		for (uint32_t tile_y = 0; tile_y < grid.tiles_y; ++tile_y)
+		{
+			auto const [min_y, max_y] = extent(
+				tile_ndc(tile_y, grid.tiles_y),
+				tile_ndc(tile_y + 1, grid.tiles_y),
+				inv_scale_y,
+				depth0,
+				depth1);
+			for (uint32_t tile_x = 0; tile_x < grid.tiles_x; ++tile_x)
+			{
+				auto const [min_x, max_x] = extent(
+					tile_ndc(tile_x, grid.tiles_x),
+					tile_ndc(tile_x + 1, grid.tiles_x),
+					inv_scale_x,
+					depth0,
+					depth1);
+				bounds.push_back(
+					{.min = {min_x, min_y, -depth1, 0}, .max = {max_x, max_y, -depth0, 0}});
+			}
+		}
+	}
+	return bounds;
+}
+
+uint32_t depth_slice(ClusterGrid const & grid, float const depth)
+{
+	auto const [scale, bias] = slice_scale_bias(grid);
+	float const slice = std::floor(std::log2(depth) * scale + bias);
+	return static_cast<uint32_t>(std::clamp(slice, 0.0F, static_cast<float>(grid.slices - 1)));
+}
+
+LightLists bin_lights(
+	std::span<ClusterBounds const> const bounds,
+	std::span<PointLight const> const lights,
+	maths::Mat4 const & view)
+{
+	std::vector<maths::Vec3> const centres = lights |
+		std::views::transform(
+			[&](PointLight const & light)
+			{
+				auto const & [x, y, z] = light.position;
+				return maths::transform_point(view, {x, y, z});
+			}) |
+		ranges::to<std::vector>();
+
+	LightLists lists;
+	lists.ranges.reserve(bounds.size());
+	for (ClusterBounds const & cluster_bounds : bounds)
+	{
+		auto const offset = static_cast<uint32_t>(lists.indices.size());
+		for (std::size_t light_idx = 0; light_idx < lights.size(); ++light_idx)
+			if (intersects(cluster_bounds, centres[light_idx], lights[light_idx].radius))
+				lists.indices.push_back(static_cast<uint32_t>(light_idx));
+		lists.ranges.push_back(
+			{.offset = offset, .count = static_cast<uint32_t>(lists.indices.size()) - offset});
+	}
+	return lists;
+}
+
+ShadingPushConstants make_shading_push_constants(
+	ClusterGrid const & grid, maths::Mat4 const & view, VkExtent2D const viewport)
+{
+	auto const [scale, bias] = slice_scale_bias(grid);
+	return {
+		.view = view,
+		.grid = {grid.tiles_x, grid.tiles_y, grid.slices, 0},
+		.params = {
+			scale,
+			bias,
+			static_cast<float>(viewport.width),
+			static_cast<float>(viewport.height)}};
+}
+
+compute::ComputeKernel create_cluster_kernel(types::VulkanDevicePtr const & device)
+{
+	return compute::create_compute_kernel(
+		device,
+		shaders::kClusterLightsComp,
+		kBindings,
+		sizeof(PushConstants),
+		{kWorkGroupSize, 1, 1});
+}
+
+types::VulkanDescriptorSetLayoutPtr create_shading_set_layout(
+	types::VulkanDevicePtr const & device)
+{
+	std::vector<VkDescriptorSetLayoutBinding> const layout_bindings =
+		std::views::iota(0U, static_cast<uint32_t>(kBindings.size())) |
+		std::views::transform(
+			[](uint32_t const binding)
+			{
+				return VkDescriptorSetLayoutBinding{
+					.binding = binding,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+					.pImmutableSamplers = nullptr};
+			}) |
+		ranges::to<std::vector>();
+
+	return setup::create_descriptor_set_layout(device, layout_bindings);
+}
+
+ClusterBuffers create_cluster_buffers(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx const memory_type_idx,
+	compute::ComputeKernel const & kernel,
+	ClusterGrid const & grid,
+	LightCount const light_capacity,
+	uint32_t const index_capacity)
+{
+	uint32_t const cluster_count = grid.cluster_count();
+	if (cluster_count == 0 || cluster_count > kMaxClusterCount)
+		throw std::invalid_argument{"Cluster count must be in [1, 65535]"};
+	if (light_capacity == 0U || index_capacity == 0)
+		throw std::invalid_argument{"Light and index capacities must be non-zero"};
+
+	auto [bounds_buffer, bounds_memory, bounds] =
+		compute::create_mapped_storage_buffer<ClusterBounds>(
+			device, memory_type_idx, cluster_count, 0);
+	auto [lights_buffer, lights_memory, lights] =
+		compute::create_mapped_storage_buffer<PointLight>(
+			device, memory_type_idx, light_capacity, 0);
+	auto [ranges_buffer, ranges_memory, ranges] =
+		compute::create_mapped_storage_buffer<LightRange>(
+			device, memory_type_idx, cluster_count, 0);
+	auto [indices_buffer, indices_memory, indices] =
+		compute::create_mapped_storage_buffer<uint32_t>(
+			device, memory_type_idx, index_capacity, 0);
+	auto [count_buffer, count_memory, count] = compute::create_mapped_storage_buffer<uint32_t>(
+		device, memory_type_idx, 1, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+	ClusterBuffers buffers{
+		.bounds_buffer = std::move(bounds_buffer),
+		.bounds_memory = std::move(bounds_memory),
+		.bounds = bounds,
+		.lights_buffer = std::move(lights_buffer),
+		.lights_memory = std::move(lights_memory),
+		.lights = lights,
+		.ranges_buffer = std::move(ranges_buffer),
+		.ranges_memory = std::move(ranges_memory),
+		.ranges = ranges,
+		.indices_buffer = std::move(indices_buffer),
+		.indices_memory = std::move(indices_memory),
+		.indices = indices,
+		.count_buffer = std::move(count_buffer),
+		.count_memory = std::move(count_memory),
+		.count = count,
+		.bindings = {}};
+	buffers.bindings = compute::create_compute_bindings(device, kernel, buffer_bindings(buffers));
+	return buffers;
+}
+
+compute::ComputeBindings create_shading_bindings(
+	types::VulkanDevicePtr const & device,
+	types::VulkanDescriptorSetLayoutPtr const & shading_set_layout,
+	ClusterBuffers const & buffers)
+{
+	return compute::create_compute_bindings(
+		device, shading_set_layout, kBindings, buffer_bindings(buffers));
+}
+
+void populate_cmd_cluster_lights(
+	VkCommandBuffer command_buffer,
+	compute::ComputeKernel const & kernel,
+	ClusterBuffers const & buffers,
+	ClusterGrid const & grid,
+	maths::Mat4 const & view,
+	LightCount const light_count)
+{
+	using render_graph::Access;
+	using render_graph::state_of;
+
+	// Previous binning must be done with the index count before it is reset.
+	barrier::populate_cmd_memory_barrier(
+		command_buffer,
+		state_of(Access::kComputeShaderStorageReadWrite),
+		state_of(Access::kTransferWrite));
+	vkCmdFillBuffer(command_buffer, buffers.count_buffer.get(), 0, sizeof(uint32_t), 0);
+
+	// Host writes to bounds and lights are made visible by queue submission. Count reset must
+	// complete before the shader increments it, any previous frame's shading must complete before
+	// the shader overwrites the light lists, and the light lists must be written before they are
+	// read by fragment shaders, or read back by the host once the submission's fence/queue signals.
+	std::array const buffer_uses{
+		compute::BufferUse{
+			.buffer = buffers.count_buffer.get(),
+			.access = Access::kComputeShaderStorageReadWrite,
+			.before = state_of(Access::kTransferWrite),
+			.after = state_of(Access::kHostRead)},
+		compute::BufferUse{
+			.buffer = buffers.ranges_buffer.get(),
+			.access = Access::kComputeShaderStorageWrite,
+			.before = kShadableAndHostReadable,
+			.after = kShadableAndHostReadable},
+		compute::BufferUse{
+			.buffer = buffers.indices_buffer.get(),
+			.access = Access::kComputeShaderStorageWrite,
+			.before = kShadableAndHostReadable,
+			.after = kShadableAndHostReadable}};
+
+	PushConstants const push_constants{
+		.view = view,
+		.light_count = light_count,
+		.index_capacity = static_cast<uint32_t>(buffers.indices.size())};
+
+	// One work group per cluster.
+	compute::populate_cmd_dispatch(
+		command_buffer,
+		kernel,
+		buffers.bindings,
+		std::as_bytes(std::span{&push_constants, 1}),
+		buffer_uses,
+		{},
+		{grid.cluster_count(), 1, 1});
+}
+
+namespace
+{
+/**
+ * Lights scattered through a box around the origin.
+ */
+std::vector<PointLight> make_random_lights(std::size_t const count, float const extent)
+{
+	// NOLINTNEXTLINE(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+	std::mt19937 rng{42};
+	std::uniform_real_distribution<float> position{-extent, extent};
+	std::uniform_real_distribution<float> radius{0.5F, 3.0F};
+	std::vector<PointLight> lights(count);
+	for (PointLight & light : lights)
+		light = {
+			.position = {position(rng), position(rng), position(rng)},
+			.radius = radius(rng),
+			.colour = {1, 1, 1},
+			.intensity = 1};
+	return lights;
+}
+
+std::vector<PointLight> scale_radii(std::span<PointLight const> const lights, float const factor)
+{
+	std::vector<PointLight> scaled{lights.begin(), lights.end()};
+	for (PointLight & light : scaled)
+		light.radius *= factor;
+	return scaled;
+}
+
+/**
+ * Sorted lights of a cluster.
+ */
+std::vector<uint32_t> cluster_light_indices(
+	std::span<LightRange const> const ranges,
+	std::span<uint32_t const> const indices,
+	std::size_t const cluster_idx)
+{
+	LightRange const range = ranges[cluster_idx];
+	std::vector<uint32_t> light_indices{
+		indices.subspan(range.offset, range.count).begin(),
+		indices.subspan(range.offset, range.count).end()};
+	std::ranges::sort(light_indices);
+	return light_indices;
+}
+
+bool contains(ClusterBounds const & bounds, maths::Vec3 const & point, float const tolerance)
+{
+	std::array const coords{point.x, point.y, point.z};
+	for (std::size_t axis = 0; axis < coords.size(); ++axis)
+		if (coords[axis] < bounds.min[axis] - tolerance ||
+			coords[axis] > bounds.max[axis] + tolerance)
+			return false;
+	return true;
+}
+}  // namespace
+
+TEST_CASE("Compute cluster bounds")
+{
+	ClusterGrid const grid{.tiles_x = 4, .tiles_y = 3, .slices = 5, .near = 0.5F, .far = 50.0F};
+	maths::Mat4 const projection = maths::perspective(1.0F, 4.0F / 3.0F, grid.near, grid.far);
+	std::vector<ClusterBounds> const bounds = compute_cluster_bounds(grid, projection);
+
+	REQUIRE(bounds.size() == 60);
+	CHECK(bounds.front().max[2] == doctest::Approx(-grid.near));
+	CHECK(bounds.back().min[2] == doctest::Approx(-grid.far));
+	// Slices are contiguous.
+	for (uint32_t slice = 1; slice < grid.slices; ++slice)
+		CHECK(
+			bounds[slice * grid.tiles_x * grid.tiles_y].max[2] ==
+			bounds[(slice - 1) * grid.tiles_x * grid.tiles_y].min[2]);
+
+	CHECK(depth_slice(grid, grid.near) == 0);
+	CHECK(depth_slice(grid, grid.near * 0.5F) == 0);
+	CHECK(depth_slice(grid, grid.far * 0.999F) == grid.slices - 1);
+	CHECK(depth_slice(grid, grid.far * 2.0F) == grid.slices - 1);
+
+	SUBCASE("points are within the bounds of their cluster")
+	{
+		// NOLINTNEXTLINE(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+	std::mt19937 rng{42};
+		std::uniform_real_distribution<float> ndc{-0.999F, 0.999F};
+		std::uniform_real_distribution<float> log_depth{
+			std::log2(grid.near) + 1e-3F, std::log2(grid.far) - 1e-3F};
+
+		for (int point_idx = 0; point_idx < 1000; ++point_idx)
+		{
+			float const ndc_x = ndc(rng);
+			float const ndc_y = ndc(rng);
+			float const depth = std::exp2(log_depth(rng));
+			maths::Vec3 const point{
+				ndc_x * depth / projection.columns[0].x,
+				ndc_y * depth / projection.columns[1].y,
+				-depth};
+
+			// Sanity check against the projection.
+			maths::Vec4 const clip = projection * maths::to_vec4(point, 1);
+			CHECK(clip.x / clip.w == doctest::Approx(ndc_x).epsilon(1e-4));
+			CHECK(clip.y / clip.w == doctest::Approx(ndc_y).epsilon(1e-4));
+
+			auto const tile = [](float const coord, uint32_t const tile_count)
+			{
+				return static_cast<uint32_t>(
+					(coord + 1.0F) / 2.0F * static_cast<float>(tile_count));
+			};
+			uint32_t const tile_x = tile(ndc_x, grid.tiles_x);
+			uint32_t const tile_y = tile(ndc_y, grid.tiles_y);
+			uint32_t const cluster_idx =
+				tile_x + grid.tiles_x * (tile_y + grid.tiles_y * depth_slice(grid, depth));
+			CHECK(contains(bounds[cluster_idx], point, depth * 1e-4F));
+		}
+	}
+}
+
+TEST_CASE("Bin lights into clusters")
+{
+	ClusterGrid const grid{.tiles_x = 4, .tiles_y = 3, .slices = 5, .near = 0.5F, .far = 50.0F};
+	std::vector<ClusterBounds> const bounds =
+		compute_cluster_bounds(grid, maths::perspective(1.0F, 4.0F / 3.0F, grid.near, grid.far));
+	// World space shifted relative to view space.
+	maths::Mat4 const view = maths::translation({0, 0, -10});
+
+	// Bounds of neighbouring clusters overlap, since an axis-aligned box around a frustum-shaped
+	// cluster is larger than the cluster, so a small light may be binned to several.
+	auto const centre = [&](std::size_t const cluster_idx)
+	{
+		ClusterBounds const & cluster = bounds[cluster_idx];
+		return maths::Vec3{
+			(cluster.min[0] + cluster.max[0]) / 2,
+			(cluster.min[1] + cluster.max[1]) / 2,
+			(cluster.min[2] + cluster.max[2]) / 2};
+	};
+	maths::Vec3 const small_centre = centre(29);
+
+	std::vector<PointLight> const lights{
+		// Small, within a single cluster.
+		{.position = {small_centre.x, small_centre.y, small_centre.z + 10},
+		 .radius = 0.01F,
+		 .colour = {1, 1, 1},
+		 .intensity = 1},
+		// Behind the camera.
+		{.position = {0, 0, 11}, .radius = 0.1F, .colour = {1, 1, 1}, .intensity = 1},
+		// Covering everything.
+		{.position = {0, 0, 0}, .radius = 1000.0F, .colour = {1, 1, 1}, .intensity = 1}};
+
+	LightLists const lists = bin_lights(bounds, lights, view);
+
+	REQUIRE(lists.ranges.size() == bounds.size());
+	std::size_t small_count = 0;
+	for (std::size_t cluster_idx = 0; cluster_idx < bounds.size(); ++cluster_idx)
+	{
+		CAPTURE(cluster_idx);
+		bool const near_small = contains(bounds[cluster_idx], small_centre, 0.01F);
+		std::vector<uint32_t> const expected =
+			near_small ? std::vector<uint32_t>{0, 2} : std::vector<uint32_t>{2};
+		CHECK(cluster_light_indices(lists.ranges, lists.indices, cluster_idx) == expected);
+		small_count += static_cast<std::size_t>(near_small);
+	}
+	CHECK(cluster_light_indices(lists.ranges, lists.indices, 29) == std::vector<uint32_t>{0, 2});
+	// Only immediate neighbours overlap.
+	CHECK(small_count < 27);
+}
+
+TEST_CASE("Bin lights into clusters on the GPU")
+{
+	vulkandemo::LoggerPtr const logger =
+		vulkandemo::create_logger("Bin lights into clusters on the GPU");
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		nullptr,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+
+	constexpr VkMemoryPropertyFlags memory_flags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	// Same queue family as shading, whose stages the light list barriers include.
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT,
+		memory_flags);
+
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan13_features};
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{},
+		&features);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkCommandBuffer command_buffer = command_buffers->front();
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	compute::ComputeKernel const kernel = create_cluster_kernel(device);
+	CHECK(kernel.descriptor_set_layout);
+	CHECK(kernel.layout);
+	CHECK(kernel.pipeline);
+	types::VulkanDescriptorSetLayoutPtr const shading_set_layout =
+		create_shading_set_layout(device);
+	CHECK(shading_set_layout);
+	CHECK(setup::create_shader_module(device, shaders::kClusteredForwardFrag));
+
+	types::VulkanMemoryTypeIdx const memory_type_idx =
+		setup::filter_available_memory_types(logger, physical_device, memory_flags).at(0);
+
+	ClusterGrid const grid{.tiles_x = 8, .tiles_y = 6, .slices = 12, .near = 0.1F, .far = 100.0F};
+	maths::Mat4 const projection = maths::perspective(1.0F, 4.0F / 3.0F, grid.near, grid.far);
+	maths::Mat4 const view = maths::look_at({3, 2, 25}, {0, 0, 0}, {0, 1, 0});
+	std::vector<PointLight> const lights = make_random_lights(500, 20.0F);
+
+	auto const bin = [&](uint32_t const index_capacity)
+	{
+		ClusterBuffers buffers = create_cluster_buffers(
+			device, memory_type_idx, kernel, grid, LightCount{500}, index_capacity);
+		std::ranges::copy(compute_cluster_bounds(grid, projection), buffers.bounds.begin());
+		std::ranges::copy(lights, buffers.lights.begin());
+
+		constexpr VkCommandBufferBeginInfo begin_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+		VK_CHECK(
+			vkBeginCommandBuffer(command_buffer, &begin_info), "Failed to begin command buffer");
+		populate_cmd_cluster_lights(command_buffer, kernel, buffers, grid, view, LightCount{500});
+		VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
+
+		draw::submit_command_buffer(queue, command_buffer, nullptr, nullptr);
+		VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+		return buffers;
+	};
+
+	std::vector<ClusterBounds> const bounds = compute_cluster_bounds(grid, projection);
+
+	SUBCASE("matches CPU binning")
+	{
+		ClusterBuffers const buffers = bin(grid.cluster_count() * kMaxLightsPerCluster);
+		CHECK(
+			create_shading_bindings(device, shading_set_layout, buffers).descriptor_set != nullptr);
+
+		// Allow for lights touching a cluster to within rounding.
+		LightLists const inner = bin_lights(bounds, scale_radii(lights, 0.999F), view);
+		LightLists const outer = bin_lights(bounds, scale_radii(lights, 1.001F), view);
+		REQUIRE(!inner.indices.empty());
+
+		uint32_t total = 0;
+		for (std::size_t cluster_idx = 0; cluster_idx < bounds.size(); ++cluster_idx)
+		{
+			CAPTURE(cluster_idx);
+			std::vector<uint32_t> const actual =
+				cluster_light_indices(buffers.ranges, buffers.indices, cluster_idx);
+			CHECK(std::ranges::includes(
+				actual, cluster_light_indices(inner.ranges, inner.indices, cluster_idx)));
+			CHECK(std::ranges::includes(
+				cluster_light_indices(outer.ranges, outer.indices, cluster_idx), actual));
+			total += buffers.ranges[cluster_idx].count;
+		}
+		// Lists are compact.
+		CHECK(buffers.count.front() == total);
+	}
+
+	SUBCASE("truncated")
+	{
+		constexpr uint32_t index_capacity = 64;
+		ClusterBuffers const buffers = bin(index_capacity);
+
+		CHECK(buffers.count.front() > index_capacity);
+		uint32_t total = 0;
+		for (LightRange const & range : buffers.ranges)
+		{
+			CHECK(range.offset + range.count <= std::max(range.offset, index_capacity));
+			total += range.count;
+		}
+		CHECK(total == index_capacity);
+	}
+}
+
+TEST_CASE("Benchmark clustered light culling" * doctest::test_suite("benchmark") * doctest::skip())
+{
+	vulkandemo::LoggerPtr const logger =
+		vulkandemo::create_logger("Benchmark clustered light culling");
+	types::VulkanInstancePtr const instance =
+		setup::create_vulkan_instance(logger, nullptr, {}, {});
+
+	constexpr VkMemoryPropertyFlags memory_flags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	// Same queue family as shading, whose stages the light list barriers include.
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT,
+		memory_flags);
+
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan13_features};
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{},
+		&features);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkCommandBuffer command_buffer = command_buffers->front();
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	compute::ComputeKernel const kernel = create_cluster_kernel(device);
+	types::VulkanMemoryTypeIdx const memory_type_idx =
+		setup::filter_available_memory_types(logger, physical_device, memory_flags).at(0);
+
+	ClusterGrid const grid{};
+	maths::Mat4 const projection = maths::perspective(1.0F, 16.0F / 9.0F, grid.near, grid.far);
+	maths::Mat4 const view = maths::look_at({0, 0, 60}, {0, 0, 0}, {0, 1, 0});
+	std::vector<ClusterBounds> const bounds = compute_cluster_bounds(grid, projection);
+	logger->info("{} clusters", grid.cluster_count());
+
+	constexpr std::size_t kIterations = 20;
+
+	for (uint32_t const light_count : {16U, 256U, 4'096U, 65'536U})
+	{
+		std::vector<PointLight> const lights = make_random_lights(light_count, 50.0F);
+		ClusterBuffers buffers = create_cluster_buffers(
+			device,
+			memory_type_idx,
+			kernel,
+			grid,
+			LightCount{light_count},
+			grid.cluster_count() * kMaxLightsPerCluster);
+		std::ranges::copy(bounds, buffers.bounds.begin());
+		std::ranges::copy(lights, buffers.lights.begin());
+
+		// Resubmitted for each timed run, so not one-time-submit.
+		constexpr VkCommandBufferBeginInfo begin_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, .flags = 0};
+
+		double const record_ms = bench::mean_ms(
+			kIterations,
+			[&]
+			{
+				VK_CHECK(
+					vkBeginCommandBuffer(command_buffer, &begin_info),
+					"Failed to begin command buffer");
+				populate_cmd_cluster_lights(
+					command_buffer, kernel, buffers, grid, view, LightCount{light_count});
+				VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
+			});
+
+		double const gpu_ms = bench::mean_ms(
+			kIterations,
+			[&]
+			{
+				draw::submit_command_buffer(queue, command_buffer, nullptr, nullptr);
+				VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+			});
+
+		// The CPU reference is quadratic, so time fewer runs.
+		LightLists lists;
+		double const cpu_ms =
+			bench::mean_ms(2, [&] { lists = bin_lights(bounds, lights, view); });
+
+		uint32_t const max_count = std::ranges::max(
+			buffers.ranges | std::views::transform(&LightRange::count));
+		logger->info(
+			"{} lights: record {:.3f} ms, GPU bin+wait {:.3f} ms, CPU reference {:.3f} ms; {:.1f} "
+			"lights per cluster (max {}), {} indices",
+			light_count,
+			record_ms,
+			gpu_ms,
+			cpu_ms,
+			static_cast<double>(lists.indices.size()) / grid.cluster_count(),
+			max_count,
+			buffers.count.front());
+	}
+}
+}  // namespace vulkandemo::cluster
@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include <strong_type/equality.hpp>
+#include <strong_type/equality_with.hpp>
+#include <strong_type/implicitly_convertible_to.hpp>
+#include <strong_type/ordered.hpp>
+#include <strong_type/regular.hpp>
+#include <strong_type/type.hpp>
+
+#include "compute.hpp"
+#include "maths.hpp"
+#include "types.hpp"
+
+/**
+ * Clustered forward lighting: the view frustum is divided into a 3D grid of clusters, screen space
+ * tiles by exponentially spaced depth slices, and a compute pass bins point lights into compact
+ * per-cluster lists of light indices.
+ *
+ * Fragment shaders then find their cluster from their screen position and view depth, and shade
+ * with only the lights of that cluster, see `clustered_forward.frag`.
+ */
+namespace vulkandemo::cluster
+{
+using LightCount = strong::type<
+	uint32_t,
+	struct TagForClusterLightCount,
+	strong::regular,
+	strong::implicitly_convertible_to<uint32_t, std::size_t>,
+	strong::equality,
+	strong::equality_with<uint32_t, std::size_t>,
+	strong::strongly_ordered>;
+
+/// Work group size of `cluster_lights.comp`, which dispatches one work group per cluster.
+inline constexpr uint32_t kWorkGroupSize = 64;
+
+/// Lights binned to a single cluster beyond this many are dropped. Sizes the shared memory list of
+/// `cluster_lights.comp`.
+inline constexpr uint32_t kMaxLightsPerCluster = 256;
+
+/**
+ * Point light with a finite range.
+ */
+struct PointLight
+{
+	/// World space.
+	std::array<float, 3> position;
+	/// Distance at which the light's contribution falls to zero.
+	float radius;
+	std::array<float, 3> colour;
+	float intensity;
+};
+static_assert(sizeof(PointLight) == 32);
+
+/**
+ * View space axis-aligned bounds of a cluster, as vec4s to match std430 layout.
+ */
+struct ClusterBounds
+{
+	std::array<float, 4> min;
+	std::array<float, 4> max;
+};
+static_assert(sizeof(ClusterBounds) == 32);
+
+/**
+ * Lights of a cluster, as a range of the light index list.
+ */
+struct LightRange
+{
+	uint32_t offset;
+	uint32_t count;
+
+	bool operator==(LightRange const &) const = default;
+};
+static_assert(sizeof(LightRange) == 8);
+
+/**
+ * Division of the view frustum into clusters.
+ *
+ * Clusters are ordered by tile x fastest, then tile y, then depth slice.
+ */
+struct ClusterGrid
+{
+	uint32_t tiles_x = 16;
+	uint32_t tiles_y = 9;
+	uint32_t slices = 24;
+	/// View depth of the near and far planes, as passed to maths::perspective.
+	float near = 0.1F;
+	float far = 1000.0F;
+
+	[[nodiscard]] uint32_t cluster_count() const;
+};
+
+/**
+ * Per-cluster light lists, as output by the compute pass.
+ */
+struct LightLists
+{
+	/// Indexed by cluster.
+	std::vector<LightRange> ranges;
+	/// Indices into the lights, referenced by `ranges`.
+	std::vector<uint32_t> indices;
+};
+
+/**
+ * Push constants of `clustered_forward.frag`, as produced by make_shading_push_constants.
+ */
+struct ShadingPushConstants
+{
+	maths::Mat4 view;
+	std::array<uint32_t, 4> grid;
+	/// Slice scale and bias, see depth_slice, then viewport width and height.
+	std::array<float, 4> params;
+};
+static_assert(sizeof(ShadingPushConstants) == 96);
+
+/**
+ * Storage buffers of the clusters and lights, with the descriptor set binding them to the light
+ * binning kernel.
+ *
+ * All buffers are persistently mapped: bounds and lights are written in place by the host, and
+ * light lists may be read back by the host after the frame's work completes.
+ */
+struct ClusterBuffers
+{
+	types::VulkanBufferPtr bounds_buffer;
+	types::VulkanDeviceMemoryPtr bounds_memory;
+	std::span<ClusterBounds> bounds;
+
+	types::VulkanBufferPtr lights_buffer;
+	types::VulkanDeviceMemoryPtr lights_memory;
+	std::span<PointLight> lights;
+
+	types::VulkanBufferPtr ranges_buffer;
+	types::VulkanDeviceMemoryPtr ranges_memory;
+	std::span<LightRange const> ranges;
+
+	types::VulkanBufferPtr indices_buffer;
+	types::VulkanDeviceMemoryPtr indices_memory;
+	std::span<uint32_t const> indices;
+
+	/// Total light indices written, which may exceed the capacity of `indices` if lists were
+	/// truncated.
+	types::VulkanBufferPtr count_buffer;
+	types::VulkanDeviceMemoryPtr count_memory;
+	std::span<uint32_t const> count;
+
+	compute::ComputeBindings bindings;
+};
+
+/**
+ * Compute the view space bounds of every cluster.
+ *
+ * Must be recomputed, and copied to ClusterBuffers::bounds, whenever the projection changes.
+ *
+ * @param grid
+ * @param projection Symmetric perspective projection, e.g. maths::perspective, with the same near
+ * and far planes as the grid.
+ * @return Indexed by cluster.
+ */
+std::vector<ClusterBounds> compute_cluster_bounds(
+	ClusterGrid const & grid, maths::Mat4 const & projection);
+
+/**
+ * Depth slice containing a view space depth, i.e. distance along -z.
+ *
+ * Slice `k` covers depths `near * (far / near)^(k / slices)` to `near * (far / near)^((k + 1) /
+ * slices)`, so `k = floor(log2(depth) * scale + bias)`.
+ *
+ * @param grid
+ * @param depth
+ * @return Slice, clamped to the grid.
+ */
+uint32_t depth_slice(ClusterGrid const & grid, float depth);
+
+/**
+ * Bin lights into clusters on the CPU, as a reference for the compute pass.
+ *
+ * Light lists are in ascending light index order and are not truncated.
+ *
+ * @param bounds As per compute_cluster_bounds.
+ * @param lights
+ * @param view Maps world space to view space.
+ * @return
+ */
+LightLists bin_lights(
+	std::span<ClusterBounds const> bounds,
+	std::span<PointLight const> lights,
+	maths::Mat4 const & view);
+
+/**
+ * Push constants for shading with `clustered_forward.frag`.
+ *
+ * @param grid
+ * @param view Maps world space to view space.
+ * @param viewport
+ * @return
+ */
+ShadingPushConstants make_shading_push_constants(
+	ClusterGrid const & grid, maths::Mat4 const & view, VkExtent2D viewport);
+
+/**
+ * Create the light binning compute kernel.
+ *
+ * Bindings are bounds, lights, ranges, indices then count, as per ClusterBuffers.
+ *
+ * @param device
+ * @return
+ */
+compute::ComputeKernel create_cluster_kernel(types::VulkanDevicePtr const & device);
+
+/**
+ * Create the layout of descriptor set 0 of `clustered_forward.frag`, whose bindings match the
+ * kernel's but are visible to fragment shaders, which read lights, ranges and indices.
+ *
+ * @param device
+ * @return
+ */
+types::VulkanDescriptorSetLayoutPtr create_shading_set_layout(
+	types::VulkanDevicePtr const & device);
+
+/**
+ * Create storage buffers for a grid and a maximum number of lights, and a descriptor set binding
+ * them to the kernel.
+ *
+ * @param device
+ * @param memory_type_idx Host visible and host coherent memory type.
+ * @param kernel
+ * @param grid At most 65535 clusters, the minimum work group count limit.
+ * @param light_capacity Maximum number of lights.
+ * @param index_capacity Maximum light indices across all clusters, beyond which light lists are
+ * truncated.
+ * @return
+ * @throws std::invalid_argument if the grid has too many clusters.
+ */
+ClusterBuffers create_cluster_buffers(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx memory_type_idx,
+	compute::ComputeKernel const & kernel,
+	ClusterGrid const & grid,
+	LightCount light_capacity,
+	uint32_t index_capacity);
+
+/**
+ * Create a descriptor set binding the buffers to fragment shaders, for shading with the light
+ * lists output by the kernel.
+ *
+ * @param device
+ * @param shading_set_layout As per create_shading_set_layout.
+ * @param buffers
+ * @return
+ */
+compute::ComputeBindings create_shading_bindings(
+	types::VulkanDevicePtr const & device,
+	types::VulkanDescriptorSetLayoutPtr const & shading_set_layout,
+	ClusterBuffers const & buffers);
+
+/**
+ * Record the binning dispatch, including barriers so that the resulting light lists are visible to
+ * subsequent fragment shaders and to the host.
+ *
+ * Must be recorded outside of a render pass. Barriers are synchronization2, see compute.
+ *
+ * @param command_buffer
+ * @param kernel
+ * @param buffers
+ * @param grid As passed to create_cluster_buffers.
+ * @param view Maps world space to view space.
+ * @param light_count Number of lights to bin, from the start of the lights buffer.
+ */
+void populate_cmd_cluster_lights(
+	VkCommandBuffer command_buffer,
+	compute::ComputeKernel const & kernel,
+	ClusterBuffers const & buffers,
+	ClusterGrid const & grid,
+	maths::Mat4 const & view,
+	LightCount light_count);
+}  // namespace vulkandemo::cluster
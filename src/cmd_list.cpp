@@ -0,0 +1,841 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "cmd_list.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner) for `logger`
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `VK_CHECK`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "barrier.hpp"
+#include "bench.hpp"
+#include "cmd_state.hpp"
+#include "compute.hpp"
+#include "draw.hpp"
+#include "macros.hpp"
+#include "parallel.hpp"
+#include "render_graph.hpp"
+#include "setup.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::cmd_list
+{
+namespace
+{
+/**
+ * Precedes each packet in the arena.
+ */
+struct PacketHeader
+{
+	/// Index of the packet's alternative in Packet.
+	uint32_t type;
+	/// Bytes from the start of this header to the next, including padding.
+	uint32_t size;
+};
+
+// Packets holding arrays are stored as a record of counts, followed by the arrays in order.
+
+struct BindDescriptorSetsRecord
+{
+	VkPipelineBindPoint bind_point;
+	VkPipelineLayout layout;
+	uint32_t first_set;
+	uint32_t set_count;
+};
+
+struct BindVertexBuffersRecord
+{
+	uint32_t first_binding;
+	uint32_t buffer_count;
+};
+
+struct PushConstantsRecord
+{
+	VkPipelineLayout layout;
+	VkShaderStageFlags stages;
+	uint32_t offset;
+	uint32_t size;
+};
+
+struct BarrierRecord
+{
+	render_graph::ResourceState before;
+	render_graph::ResourceState after;
+	uint32_t image_count;
+};
+
+struct CopyBufferRecord
+{
+	VkBuffer src;
+	VkBuffer dst;
+	uint32_t region_count;
+};
+
+/**
+ * Index of a kind of packet within Packet, as stored in PacketHeader::type.
+ */
+template <class T, std::size_t Idx = 0>
+consteval std::size_t variant_index()
+{
+	if constexpr (std::is_same_v<std::variant_alternative_t<Idx, Packet>, T>)
+		return Idx;
+	else
+		return variant_index<T, Idx + 1>();
+}
+
+constexpr std::size_t align_up(std::size_t const size)
+{
+	return (size + kPacketAlignment - 1) & ~(kPacketAlignment - 1);
+}
+
+/**
+ * Append values to the arena at the next aligned offset.
+ */
+template <class T>
+void append(std::vector<std::byte> & arena, std::span<T const> const values)
+{
+	static_assert(alignof(T) <= kPacketAlignment);
+	std::size_t const offset = align_up(arena.size());
+	arena.resize(offset + values.size_bytes());
+	if (!values.empty())
+		std::memcpy(arena.data() + offset, values.data(), values.size_bytes());
+}
+
+template <class T>
+void append(std::vector<std::byte> & arena, T const & value)
+{
+	append(arena, std::span{&value, 1});
+}
+
+/**
+ * Serialises each kind of packet after its header.
+ */
+struct Encoder
+{
+	std::vector<std::byte> & arena;
+
+	template <class T>
+	void operator()(T const & packet)
+	{
+		// Packets without arrays are stored as is.
+		append(arena, packet);
+	}
+
+	void operator()(BindDescriptorSets const & packet)
+	{
+		append(
+			arena,
+			BindDescriptorSetsRecord{
+				.bind_point = packet.bind_point,
+				.layout = packet.layout,
+				.first_set = packet.first_set,
+				.set_count = static_cast<uint32_t>(packet.descriptor_sets.size())});
+		append(arena, packet.descriptor_sets);
+	}
+
+	void operator()(BindVertexBuffers const & packet)
+	{
+		if (packet.buffers.size() != packet.offsets.size())
+			throw std::invalid_argument{"Vertex buffer and offset counts differ"};
+		append(
+			arena,
+			BindVertexBuffersRecord{
+				.first_binding = packet.first_binding,
+				.buffer_count = static_cast<uint32_t>(packet.buffers.size())});
+		append(arena, packet.buffers);
+		append(arena, packet.offsets);
+	}
+
+	void operator()(PushConstants const & packet)
+	{
+		append(
+			arena,
+			PushConstantsRecord{
+				.layout = packet.layout,
+				.stages = packet.stages,
+				.offset = packet.offset,
+				.size = static_cast<uint32_t>(packet.bytes.size())});
+		append(arena, packet.bytes);
+	}
+
+	void operator()(Barrier const & packet)
+	{
+		append(
+			arena,
+			BarrierRecord{
+				.before = packet.before,
+				.after = packet.after,
+				.image_count = static_cast<uint32_t>(packet.images.size())});
+		append(arena, packet.images);
+	}
+
+	void operator()(CopyBuffer const & packet)
+	{
+		append(
+			arena,
+			CopyBufferRecord{
+				.src = packet.src,
+				.dst = packet.dst,
+				.region_count = static_cast<uint32_t>(packet.regions.size())});
+		append(arena, packet.regions);
+	}
+};
+
+/**
+ * Reads values back from the arena in the order they were appended.
+ */
+struct ArenaReader
+{
+	std::span<std::byte const> arena;
+	std::size_t offset;
+};
+
+template <class T>
+std::span<T const> read_array(ArenaReader & reader, std::size_t const count)
+{
+	reader.offset = align_up(reader.offset);
+	// Values were copied into suitably aligned storage, so implicitly exist there.
+	// NOLINTNEXTLINE(*-reinterpret-cast)
+	std::span const values{reinterpret_cast<T const *>(reader.arena.data() + reader.offset), count};
+	reader.offset += values.size_bytes();
+	return values;
+}
+
+template <class T>
+T const & read(ArenaReader & reader)
+{
+	return read_array<T>(reader, 1).front();
+}
+
+Packet decode(ArenaReader & reader, std::size_t const type)
+{
+	switch (type)
+	{
+		case variant_index<BindPipeline>():
+			return read<BindPipeline>(reader);
+		case variant_index<BindDescriptorSets>():
+		{
+			auto const & record = read<BindDescriptorSetsRecord>(reader);
+			return BindDescriptorSets{
+				.bind_point = record.bind_point,
+				.layout = record.layout,
+				.first_set = record.first_set,
+				.descriptor_sets = read_array<VkDescriptorSet>(reader, record.set_count)};
+		}
+		case variant_index<BindVertexBuffers>():
+		{
+			auto const & record = read<BindVertexBuffersRecord>(reader);
+			std::span const buffers = read_array<VkBuffer>(reader, record.buffer_count);
+			return BindVertexBuffers{
+				.first_binding = record.first_binding,
+				.buffers = buffers,
+				.offsets = read_array<VkDeviceSize>(reader, record.buffer_count)};
+		}
+		case variant_index<BindIndexBuffer>():
+			return read<BindIndexBuffer>(reader);
+		case variant_index<SetViewport>():
+			return read<SetViewport>(reader);
+		case variant_index<SetScissor>():
+			return read<SetScissor>(reader);
+		case variant_index<PushConstants>():
+		{
+			auto const & record = read<PushConstantsRecord>(reader);
+			return PushConstants{
+				.layout = record.layout,
+				.stages = record.stages,
+				.offset = record.offset,
+				.bytes = read_array<std::byte>(reader, record.size)};
+		}
+		case variant_index<Draw>():
+			return read<Draw>(reader);
+		case variant_index<DrawIndexed>():
+			return read<DrawIndexed>(reader);
+		case variant_index<Dispatch>():
+			return read<Dispatch>(reader);
+		case variant_index<Barrier>():
+		{
+			auto const & record = read<BarrierRecord>(reader);
+			return Barrier{
+				.before = record.before,
+				.after = record.after,
+				.images = read_array<ImageTransition>(reader, record.image_count)};
+		}
+		case variant_index<CopyBuffer>():
+		{
+			auto const & record = read<CopyBufferRecord>(reader);
+			return CopyBuffer{
+				.src = record.src,
+				.dst = record.dst,
+				.regions = read_array<VkBufferCopy>(reader, record.region_count)};
+		}
+		default:
+			throw std::invalid_argument{"Unknown command list packet"};
+	}
+}
+
+/**
+ * Records each kind of packet into a command buffer.
+ */
+struct Replayer
+{
+	cmd_state::TrackedCommandBuffer & tracked;
+	std::vector<VkImageMemoryBarrier2> & image_barriers;
+
+	void operator()(BindPipeline const & packet) const
+	{
+		cmd_state::bind_pipeline(tracked, packet.bind_point, packet.pipeline);
+	}
+
+	void operator()(BindDescriptorSets const & packet) const
+	{
+		cmd_state::bind_descriptor_sets(
+			tracked, packet.bind_point, packet.layout, packet.first_set, packet.descriptor_sets);
+	}
+
+	void operator()(BindVertexBuffers const & packet) const
+	{
+		cmd_state::bind_vertex_buffers(
+			tracked, packet.first_binding, packet.buffers, packet.offsets);
+	}
+
+	void operator()(BindIndexBuffer const & packet) const
+	{
+		cmd_state::bind_index_buffer(tracked, packet.buffer, packet.offset, packet.index_type);
+	}
+
+	void operator()(SetViewport const & packet) const
+	{
+		cmd_state::set_viewport(tracked, 0, std::span{&packet.viewport, 1});
+	}
+
+	void operator()(SetScissor const & packet) const
+	{
+		cmd_state::set_scissor(tracked, 0, std::span{&packet.scissor, 1});
+	}
+
+	void operator()(PushConstants const & packet) const
+	{
+		vkCmdPushConstants(
+			tracked.command_buffer,
+			packet.layout,
+			packet.stages,
+			packet.offset,
+			static_cast<uint32_t>(packet.bytes.size()),
+			packet.bytes.data());
+	}
+
+	void operator()(Draw const & packet) const
+	{
+		vkCmdDraw(
+			tracked.command_buffer,
+			packet.vertex_count,
+			packet.instance_count,
+			packet.first_vertex,
+			packet.first_instance);
+	}
+
+	void operator()(DrawIndexed const & packet) const
+	{
+		vkCmdDrawIndexed(
+			tracked.command_buffer,
+			packet.index_count,
+			packet.instance_count,
+			packet.first_index,
+			packet.vertex_offset,
+			packet.first_instance);
+	}
+
+	void operator()(Dispatch const & packet) const
+	{
+		vkCmdDispatch(
+			tracked.command_buffer,
+			packet.group_count[0],
+			packet.group_count[1],
+			packet.group_count[2]);
+	}
+
+	void operator()(Barrier const & packet) const
+	{
+		image_barriers.clear();
+		for (ImageTransition const & transition : packet.images)
+			image_barriers.push_back(barrier::image_barrier(
+				transition.image,
+				{.aspectMask = transition.aspect,
+				 .baseMipLevel = 0,
+				 .levelCount = VK_REMAINING_MIP_LEVELS,
+				 .baseArrayLayer = 0,
+				 .layerCount = VK_REMAINING_ARRAY_LAYERS},
+				transition.before,
+				transition.after));
+
+		barrier::populate_cmd_barriers(
+			tracked.command_buffer,
+			packet.before.stages != VK_PIPELINE_STAGE_2_NONE
+				? std::optional{barrier::memory_barrier(packet.before, packet.after)}
+				: std::nullopt,
+			image_barriers);
+	}
+
+	void operator()(CopyBuffer const & packet) const
+	{
+		vkCmdCopyBuffer(
+			tracked.command_buffer,
+			packet.src,
+			packet.dst,
+			static_cast<uint32_t>(packet.regions.size()),
+			packet.regions.data());
+	}
+};
+
+/**
+ * Fill a list with a random mix of binds and draws, as a scene split across lists might.
+ */
+void record_random_draws(CommandList & list, std::size_t const draw_count, uint32_t const seed)
+{
+	std::mt19937 rng{seed};
+	std::uniform_int_distribution<uintptr_t> handle_dist{1, 16};
+	std::uniform_int_distribution<uint32_t> count_dist{3, 3000};
+	// NOLINTBEGIN(*-reinterpret-cast, performance-no-int-to-ptr)
+	VkPipelineLayout layout = reinterpret_cast<VkPipelineLayout>(0x1);
+	for (std::size_t idx = 0; idx < draw_count; ++idx)
+	{
+		if (idx % 64 == 0)
+		{
+			record(
+				list,
+				BindPipeline{
+					.bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS,
+					.pipeline = reinterpret_cast<VkPipeline>(handle_dist(rng))});
+		}
+		if (idx % 8 == 0)
+		{
+			std::array const descriptor_sets{reinterpret_cast<VkDescriptorSet>(handle_dist(rng))};
+			record(
+				list,
+				BindDescriptorSets{
+					.bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS,
+					.layout = layout,
+					.first_set = 0,
+					.descriptor_sets = descriptor_sets});
+		}
+		record(
+			list,
+			DrawIndexed{
+				.index_count = count_dist(rng),
+				.instance_count = 1,
+				.first_index = 0,
+				.vertex_offset = 0,
+				.first_instance = static_cast<uint32_t>(idx)});
+	}
+	// NOLINTEND(*-reinterpret-cast, performance-no-int-to-ptr)
+}
+}  // namespace
+
+void clear_command_list(CommandList & list)
+{
+	list.arena.clear();
+	list.packet_count = 0;
+}
+
+void record(CommandList & list, Packet const & packet)
+{
+	std::size_t const header_offset = align_up(list.arena.size());
+	append(list.arena, PacketHeader{.type = static_cast<uint32_t>(packet.index()), .size = 0});
+	std::visit(Encoder{list.arena}, packet);
+
+	// Pad to the next packet, so that the header's size skips straight to it.
+	list.arena.resize(align_up(list.arena.size()));
+	auto const size = static_cast<uint32_t>(list.arena.size() - header_offset);
+	std::memcpy(
+		list.arena.data() + header_offset + offsetof(PacketHeader, size), &size, sizeof(size));
+	++list.packet_count;
+}
+
+void for_each_packet(CommandList const & list, std::function<void(Packet const &)> const & visitor)
+{
+	std::size_t offset = 0;
+	for (std::size_t packet_idx = 0; packet_idx < list.packet_count; ++packet_idx)
+	{
+		ArenaReader reader{.arena = list.arena, .offset = offset};
+		PacketHeader const & header = read<PacketHeader>(reader);
+		visitor(decode(reader, header.type));
+		offset += header.size;
+	}
+}
+
+void record_command_lists(
+	parallel::ThreadPool & pool, std::span<CommandList> const lists, ListRecorder const & recorder)
+{
+	pool.run(
+		lists.size(),
+		[&](std::size_t const list_idx)
+		{
+			clear_command_list(lists[list_idx]);
+			recorder(list_idx, lists[list_idx]);
+		});
+}
+
+std::size_t record_command_lists(
+	parallel::ThreadPool & pool,
+	std::span<CachedCommandList> const lists,
+	std::span<uint64_t const> const versions,
+	ListRecorder const & recorder)
+{
+	if (lists.size() != versions.size())
+		throw std::invalid_argument{"Command list and version counts differ"};
+
+	std::vector<std::size_t> stale;
+	for (std::size_t list_idx = 0; list_idx < lists.size(); ++list_idx)
+		if (lists[list_idx].version != versions[list_idx])
+			stale.push_back(list_idx);
+
+	pool.run(
+		stale.size(),
+		[&](std::size_t const stale_idx)
+		{
+			std::size_t const list_idx = stale[stale_idx];
+			CachedCommandList & cached = lists[list_idx];
+			clear_command_list(cached.list);
+			recorder(list_idx, cached.list);
+			cached.version = versions[list_idx];
+		});
+	return stale.size();
+}
+
+void populate_cmd_command_list(cmd_state::TrackedCommandBuffer & tracked, CommandList const & list)
+{
+	std::vector<VkImageMemoryBarrier2> image_barriers;
+	Replayer const replayer{.tracked = tracked, .image_barriers = image_barriers};
+	for_each_packet(list, [&](Packet const & packet) { std::visit(replayer, packet); });
+}
+
+cmd_state::CallCounts populate_cmd_command_lists(
+	VkCommandBuffer command_buffer, std::span<CommandList const> const lists)
+{
+	cmd_state::TrackedCommandBuffer tracked = cmd_state::track_command_buffer(command_buffer);
+	for (CommandList const & list : lists)
+		populate_cmd_command_list(tracked, list);
+	return cmd_state::total_counts(tracked);
+}
+
+TEST_CASE("Record and decode command list packets")
+{
+	// NOLINTBEGIN(*-reinterpret-cast, performance-no-int-to-ptr)
+	VkPipeline pipeline = reinterpret_cast<VkPipeline>(0x1);
+	VkPipelineLayout layout = reinterpret_cast<VkPipelineLayout>(0x2);
+	VkBuffer buffer_a = reinterpret_cast<VkBuffer>(0x3);
+	VkBuffer buffer_b = reinterpret_cast<VkBuffer>(0x4);
+	std::array const descriptor_sets{
+		reinterpret_cast<VkDescriptorSet>(0x5), reinterpret_cast<VkDescriptorSet>(0x6)};
+	// NOLINTEND(*-reinterpret-cast, performance-no-int-to-ptr)
+	std::array const vertex_buffers{buffer_a, buffer_b};
+	std::array<VkDeviceSize, 2> const vertex_offsets{16, 32};
+	std::array const push_bytes{std::byte{1}, std::byte{2}, std::byte{3}};
+	std::array const regions{VkBufferCopy{.srcOffset = 0, .dstOffset = 8, .size = 24}};
+
+	CommandList list{};
+	record(list, BindPipeline{.bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS, .pipeline = pipeline});
+	record(
+		list,
+		BindDescriptorSets{
+			.bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS,
+			.layout = layout,
+			.first_set = 1,
+			.descriptor_sets = descriptor_sets});
+	record(
+		list,
+		BindVertexBuffers{
+			.first_binding = 0, .buffers = vertex_buffers, .offsets = vertex_offsets});
+	record(
+		list,
+		PushConstants{
+			.layout = layout,
+			.stages = VK_SHADER_STAGE_VERTEX_BIT,
+			.offset = 4,
+			.bytes = push_bytes});
+	record(
+		list,
+		DrawIndexed{
+			.index_count = 36,
+			.instance_count = 2,
+			.first_index = 3,
+			.vertex_offset = -1,
+			.first_instance = 5});
+	record(list, CopyBuffer{.src = buffer_a, .dst = buffer_b, .regions = regions});
+	record(list, Dispatch{.group_count = {4, 5, 6}});
+
+	CHECK(list.packet_count == 7);
+	CHECK(list.arena.size() % kPacketAlignment == 0);
+
+	std::vector<Packet> decoded;
+	for_each_packet(list, [&](Packet const & packet) { decoded.push_back(packet); });
+	REQUIRE(decoded.size() == 7);
+
+	auto const & bind_pipeline = std::get<BindPipeline>(decoded[0]);
+	CHECK(bind_pipeline.pipeline == pipeline);
+
+	auto const & bind_sets = std::get<BindDescriptorSets>(decoded[1]);
+	CHECK(bind_sets.layout == layout);
+	CHECK(bind_sets.first_set == 1);
+	CHECK(std::ranges::equal(bind_sets.descriptor_sets, descriptor_sets));
+	// Arrays are copied into the arena rather than referenced.
+	CHECK(bind_sets.descriptor_sets.data() != descriptor_sets.data());
+
+	auto const & bind_vertex = std::get<BindVertexBuffers>(decoded[2]);
+	CHECK(std::ranges::equal(bind_vertex.buffers, vertex_buffers));
+	CHECK(std::ranges::equal(bind_vertex.offsets, vertex_offsets));
+
+	auto const & push = std::get<PushConstants>(decoded[3]);
+	CHECK(push.offset == 4);
+	CHECK(std::ranges::equal(push.bytes, push_bytes));
+
+	auto const & draw = std::get<DrawIndexed>(decoded[4]);
+	CHECK(draw.index_count == 36);
+	CHECK(draw.vertex_offset == -1);
+	CHECK(draw.first_instance == 5);
+
+	auto const & copy = std::get<CopyBuffer>(decoded[5]);
+	CHECK(copy.dst == buffer_b);
+	REQUIRE(copy.regions.size() == 1);
+	CHECK(copy.regions[0].dstOffset == 8);
+	CHECK(copy.regions[0].size == 24);
+
+	CHECK(std::get<Dispatch>(decoded[6]).group_count == std::array<uint32_t, 3>{4, 5, 6});
+
+	CHECK_THROWS_AS(
+		record(
+			list,
+			BindVertexBuffers{
+				.first_binding = 0,
+				.buffers = vertex_buffers,
+				.offsets = std::span{vertex_offsets}.first(1)}),
+		std::invalid_argument);
+
+	std::size_t const capacity = list.arena.capacity();
+	clear_command_list(list);
+	CHECK(list.packet_count == 0);
+	CHECK(list.arena.empty());
+	CHECK(list.arena.capacity() == capacity);
+}
+
+TEST_CASE("Re-record only changed command lists")
+{
+	parallel::ThreadPool pool{2};
+	std::vector<CachedCommandList> lists(4);
+	std::vector<std::size_t> record_counts(lists.size(), 0);
+	ListRecorder const recorder = [&](std::size_t const list_idx, CommandList & list)
+	{
+		++record_counts[list_idx];
+		for (std::size_t draw_idx = 0; draw_idx <= list_idx; ++draw_idx)
+		{
+			record(
+				list,
+				Draw{
+					.vertex_count = 3,
+					.instance_count = 1,
+					.first_vertex = 0,
+					.first_instance = static_cast<uint32_t>(draw_idx)});
+		}
+	};
+
+	std::vector<uint64_t> versions{1, 1, 1, 1};
+	CHECK(record_command_lists(pool, lists, versions, recorder) == 4);
+	CHECK(record_command_lists(pool, lists, versions, recorder) == 0);
+
+	versions[2] = 2;
+	CHECK(record_command_lists(pool, lists, versions, recorder) == 1);
+	CHECK(record_counts == std::vector<std::size_t>{1, 1, 2, 1});
+
+	// Re-recording replaces, rather than appends to, the list.
+	for (std::size_t list_idx = 0; list_idx < lists.size(); ++list_idx)
+	{
+		CHECK(lists[list_idx].list.packet_count == list_idx + 1);
+		CHECK(lists[list_idx].version == versions[list_idx]);
+	}
+
+	CHECK_THROWS_AS(
+		record_command_lists(pool, lists, std::span{versions}.first(2), recorder),
+		std::invalid_argument);
+}
+
+TEST_CASE("Replay command lists into a command buffer")
+{
+	LoggerPtr const logger = create_logger("Replay command lists into a command buffer");
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		nullptr,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+
+	constexpr VkMemoryPropertyFlags memory_flags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT,
+		memory_flags);
+
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan13_features};
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{},
+		&features);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkCommandBuffer command_buffer = command_buffers->front();
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	types::VulkanMemoryTypeIdx const memory_type_idx =
+		setup::filter_available_memory_types(logger, physical_device, memory_flags).at(0);
+
+	constexpr std::size_t buffer_size = 256;
+	auto [src_buffer, src_memory, src_bytes] = draw::create_exclusive_mapped_buffer_and_memory(
+		device, memory_type_idx, buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+	auto [dst_buffer, dst_memory, dst_bytes] = draw::create_exclusive_mapped_buffer_and_memory(
+		device, memory_type_idx, buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	for (std::size_t idx = 0; idx < buffer_size; ++idx)
+		src_bytes[idx] = static_cast<std::byte>(idx);
+	std::ranges::fill(dst_bytes, std::byte{0});
+
+	// Each list copies a quarter of the buffer and binds the same pipeline, so that all but the
+	// first bind is elided across lists.
+	compute::ComputeKernel const kernel = compute::create_luminance_kernel(device);
+	std::vector<CommandList> lists(4);
+	parallel::ThreadPool pool{2};
+	record_command_lists(
+		pool,
+		lists,
+		[&](std::size_t const list_idx, CommandList & list)
+		{
+			record(
+				list,
+				BindPipeline{
+					.bind_point = VK_PIPELINE_BIND_POINT_COMPUTE,
+					.pipeline = kernel.pipeline.get()});
+			VkDeviceSize const offset = list_idx * buffer_size / lists.size();
+			std::array const regions{VkBufferCopy{
+				.srcOffset = offset, .dstOffset = offset, .size = buffer_size / lists.size()}};
+			record(
+				list,
+				CopyBuffer{.src = src_buffer.get(), .dst = dst_buffer.get(), .regions = regions});
+		});
+	// Make the copies visible to the host.
+	record(
+		lists.back(),
+		Barrier{
+			.before = render_graph::state_of(render_graph::Access::kTransferWrite),
+			.after = render_graph::state_of(render_graph::Access::kHostRead),
+			.images = {}});
+
+	constexpr VkCommandBufferBeginInfo begin_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+	VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info), "Failed to begin command buffer");
+	cmd_state::CallCounts const counts = populate_cmd_command_lists(command_buffer, lists);
+	VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
+
+	draw::submit_command_buffer(queue, command_buffer, nullptr, nullptr);
+	VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue");
+
+	CHECK(counts.emitted == 1);
+	CHECK(counts.elided == 3);
+	CHECK(std::ranges::equal(dst_bytes, src_bytes));
+}
+
+TEST_CASE("Benchmark command list recording and replay" * doctest::test_suite("benchmark") *
+		  doctest::skip())
+{
+	LoggerPtr const logger = create_logger("Benchmark command list recording and replay");
+	parallel::ThreadPool pool;
+	parallel::ThreadPool serial{0};
+	logger->info("Recording with {} threads", pool.thread_count());
+
+	constexpr std::size_t list_count = 64;
+	for (std::size_t const draw_count : {10'000UZ, 100'000UZ, 1'000'000UZ})
+	{
+		std::size_t const draws_per_list = draw_count / list_count;
+		ListRecorder const recorder = [&](std::size_t const list_idx, CommandList & list)
+		{ record_random_draws(list, draws_per_list, static_cast<uint32_t>(list_idx)); };
+
+		std::vector<CommandList> lists(list_count);
+		constexpr std::size_t iterations = 20;
+		double const serial_ms =
+			bench::mean_ms(iterations, [&] { record_command_lists(serial, lists, recorder); });
+		double const parallel_ms =
+			bench::mean_ms(iterations, [&] { record_command_lists(pool, lists, recorder); });
+
+		std::vector<CachedCommandList> cached(list_count);
+		std::vector<uint64_t> const versions(list_count, 1);
+		record_command_lists(pool, cached, versions, recorder);
+		double const cached_ms = bench::mean_ms(
+			iterations, [&] { record_command_lists(pool, cached, versions, recorder); });
+
+		// Offline replay, decoding every packet without a device.
+		std::size_t draws = 0;
+		double const decode_ms = bench::mean_ms(
+			iterations,
+			[&]
+			{
+				draws = 0;
+				for (CommandList const & list : lists)
+				{
+					for_each_packet(
+						list,
+						[&](Packet const & packet)
+						{ draws += std::holds_alternative<DrawIndexed>(packet) ? 1 : 0; });
+				}
+			});
+
+		std::size_t arena_bytes = 0;
+		for (CommandList const & list : lists)
+			arena_bytes += list.arena.size();
+
+		logger->info(
+			"{} draws: record {:.3f} ms, parallel record {:.3f} ms ({:.1f}x), cached {:.3f} ms, "
+			"decode {:.3f} ms, {:.1f} bytes per draw",
+			draws,
+			serial_ms,
+			parallel_ms,
+			serial_ms / parallel_ms,
+			cached_ms,
+			decode_ms,
+			static_cast<double>(arena_bytes) / static_cast<double>(draws));
+	}
+}
+}  // namespace vulkandemo::cmd_list
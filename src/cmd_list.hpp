@@ -0,0 +1,255 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <variant>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "cmd_state.hpp"
+#include "parallel.hpp"
+#include "render_graph.hpp"
+
+/**
+ * CPU side command lists, recorded without Vulkan and replayed into command buffers.
+ *
+ * A CommandList is a compact byte arena of packets: binds, dynamic state, push constants, draws,
+ * dispatches, barriers and buffer copies. Recording a list only appends to its arena, so needs no
+ * command pool, device or recording state, and lists can be filled on any thread. A single thread
+ * then replays the lists in order into a command buffer, through a cmd_state::TrackedCommandBuffer
+ * so that binds repeated across lists are elided.
+ *
+ * Clearing a list keeps its arena's capacity, so steady state recording does not allocate. A list
+ * whose inputs have not changed need not be re-recorded at all, see CachedCommandList.
+ *
+ * Packets hold handles by value and do not own them, so handles must outlive replay. Barriers and
+ * push constants are recorded as per the compute module, so replay requires the device to have
+ * been created with the `synchronization2` feature enabled.
+ */
+namespace vulkandemo::cmd_list
+{
+/// Alignment of each packet, and of each array within a packet, in the arena.
+inline constexpr std::size_t kPacketAlignment = 8;
+
+struct BindPipeline
+{
+	VkPipelineBindPoint bind_point;
+	VkPipeline pipeline;
+};
+
+struct BindDescriptorSets
+{
+	VkPipelineBindPoint bind_point;
+	VkPipelineLayout layout;
+	uint32_t first_set;
+	std::span<VkDescriptorSet const> descriptor_sets;
+};
+
+struct BindVertexBuffers
+{
+	uint32_t first_binding;
+	std::span<VkBuffer const> buffers;
+	std::span<VkDeviceSize const> offsets;
+};
+
+struct BindIndexBuffer
+{
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	VkIndexType index_type;
+};
+
+/// Sets viewport 0.
+struct SetViewport
+{
+	VkViewport viewport;
+};
+
+/// Sets scissor 0.
+struct SetScissor
+{
+	VkRect2D scissor;
+};
+
+struct PushConstants
+{
+	VkPipelineLayout layout;
+	VkShaderStageFlags stages;
+	uint32_t offset;
+	std::span<std::byte const> bytes;
+};
+
+struct Draw
+{
+	uint32_t vertex_count;
+	uint32_t instance_count;
+	uint32_t first_vertex;
+	uint32_t first_instance;
+};
+
+struct DrawIndexed
+{
+	uint32_t index_count;
+	uint32_t instance_count;
+	uint32_t first_index;
+	int32_t vertex_offset;
+	uint32_t first_instance;
+};
+
+struct Dispatch
+{
+	std::array<uint32_t, 3> group_count;
+};
+
+/**
+ * Layout transition of an image, as part of a Barrier.
+ */
+struct ImageTransition
+{
+	VkImage image;
+	VkImageAspectFlags aspect;
+	render_graph::ResourceState before;
+	render_graph::ResourceState after;
+};
+
+/**
+ * Global memory dependency plus any image layout transitions, recorded as one
+ * `vkCmdPipelineBarrier2`.
+ */
+struct Barrier
+{
+	/// No memory dependency if no stages.
+	render_graph::ResourceState before;
+	render_graph::ResourceState after;
+	std::span<ImageTransition const> images;
+};
+
+struct CopyBuffer
+{
+	VkBuffer src;
+	VkBuffer dst;
+	std::span<VkBufferCopy const> regions;
+};
+
+/**
+ * View of a packet, referencing arrays within the list it was decoded from.
+ */
+using Packet = std::variant<
+	BindPipeline,
+	BindDescriptorSets,
+	BindVertexBuffers,
+	BindIndexBuffer,
+	SetViewport,
+	SetScissor,
+	PushConstants,
+	Draw,
+	DrawIndexed,
+	Dispatch,
+	Barrier,
+	CopyBuffer>;
+
+/**
+ * Packets in recording order, serialised into a reusable arena.
+ */
+struct CommandList
+{
+	/// Packets, each a header followed by the packet and its arrays, aligned to kPacketAlignment.
+	std::vector<std::byte> arena;
+	std::size_t packet_count;
+};
+
+/**
+ * Command list reused across frames until the inputs it was recorded from change.
+ */
+struct CachedCommandList
+{
+	CommandList list;
+	/// Caller defined version of the inputs the list was recorded from, or nothing if never
+	/// recorded.
+	std::optional<uint64_t> version;
+};
+
+/**
+ * Fills a list, given its index.
+ */
+using ListRecorder = std::function<void(std::size_t, CommandList &)>;
+
+/**
+ * Discard all packets, keeping the arena's capacity.
+ *
+ * @param list
+ */
+void clear_command_list(CommandList & list);
+
+/**
+ * Append a packet, copying any arrays it references into the arena.
+ *
+ * @param list
+ * @param packet
+ */
+void record(CommandList & list, Packet const & packet);
+
+/**
+ * Decode each packet of a list in recording order.
+ *
+ * @param list
+ * @param visitor Called with each packet. Arrays referenced by the packet are valid until the
+ * list is next modified.
+ */
+void for_each_packet(CommandList const & list, std::function<void(Packet const &)> const & visitor);
+
+/**
+ * Clear and fill lists in parallel.
+ *
+ * @param pool
+ * @param lists
+ * @param recorder Called once per list, concurrently, so must only touch the list it is given,
+ * and must not throw.
+ */
+void record_command_lists(
+	parallel::ThreadPool & pool, std::span<CommandList> lists, ListRecorder const & recorder);
+
+/**
+ * Re-record, in parallel, those lists whose version has changed.
+ *
+ * @param pool
+ * @param lists
+ * @param versions Current version of each list's inputs.
+ * @param recorder Called once per changed list, concurrently, so must only touch the list it is
+ * given, and must not throw.
+ * @return Number of lists re-recorded.
+ */
+std::size_t record_command_lists(
+	parallel::ThreadPool & pool,
+	std::span<CachedCommandList> lists,
+	std::span<uint64_t const> versions,
+	ListRecorder const & recorder);
+
+/**
+ * Replay a list into a command buffer.
+ *
+ * Binds and dynamic state go through @p tracked, so are elided if already bound, e.g. by a
+ * previously replayed list. Must be recorded in a render pass or rendering scope if the list
+ * contains draws, and outside of one if it contains dispatches, barriers or copies.
+ *
+ * @param tracked
+ * @param list
+ */
+void populate_cmd_command_list(cmd_state::TrackedCommandBuffer & tracked, CommandList const & list);
+
+/**
+ * Replay lists in order into a command buffer, eliding binds repeated across lists.
+ *
+ * @param command_buffer
+ * @param lists
+ * @return Counts of binds and dynamic state emitted and elided.
+ */
+cmd_state::CallCounts populate_cmd_command_lists(
+	VkCommandBuffer command_buffer, std::span<CommandList const> lists);
+}  // namespace vulkandemo::cmd_list
@@ -0,0 +1,462 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "cmd_state.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner) for `logger`
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `VK_CHECK`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "compute.hpp"
+#include "draw.hpp"
+#include "macros.hpp"
+#include "setup.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::cmd_state
+{
+namespace
+{
+/**
+ * Shadowed state of a bind point, or nothing if the bind point is not tracked.
+ */
+BindPointState * state_of(TrackedCommandBuffer & tracked, VkPipelineBindPoint const bind_point)
+{
+	switch (bind_point)
+	{
+		case VK_PIPELINE_BIND_POINT_GRAPHICS:
+			return &tracked.graphics;
+		case VK_PIPELINE_BIND_POINT_COMPUTE:
+			return &tracked.compute;
+		default:
+			return nullptr;
+	}
+}
+
+void count(TrackedCommandBuffer & tracked, Call const call, bool const elided)
+{
+	CallCounts & counts = tracked.counts[static_cast<std::size_t>(call)];
+	if (elided)
+		++counts.elided;
+	else
+		++counts.emitted;
+}
+
+bool operator==(VkViewport const & lhs, VkViewport const & rhs)
+{
+	return lhs.x == rhs.x && lhs.y == rhs.y && lhs.width == rhs.width &&
+		lhs.height == rhs.height && lhs.minDepth == rhs.minDepth && lhs.maxDepth == rhs.maxDepth;
+}
+
+bool operator==(VkRect2D const & lhs, VkRect2D const & rhs)
+{
+	return lhs.offset.x == rhs.offset.x && lhs.offset.y == rhs.offset.y &&
+		lhs.extent.width == rhs.extent.width && lhs.extent.height == rhs.extent.height;
+}
+
+bool operator==(BoundDescriptorSet const & lhs, BoundDescriptorSet const & rhs)
+{
+	return lhs.layout == rhs.layout && lhs.descriptor_set == rhs.descriptor_set;
+}
+
+bool operator==(BoundVertexBuffer const & lhs, BoundVertexBuffer const & rhs)
+{
+	return lhs.buffer == rhs.buffer && lhs.offset == rhs.offset;
+}
+
+bool operator==(BoundIndexBuffer const & lhs, BoundIndexBuffer const & rhs)
+{
+	return lhs.buffer == rhs.buffer && lhs.offset == rhs.offset &&
+		lhs.index_type == rhs.index_type;
+}
+
+/**
+ * Whether every value is already shadowed in consecutive slots from @p first.
+ *
+ * Values beyond the shadowed slots are never considered bound.
+ */
+template <class T, std::size_t N, class Values>
+bool all_bound(
+	std::array<std::optional<T>, N> const & slots, uint32_t const first, Values const & values)
+{
+	if (first + std::size(values) > N)
+		return false;
+	for (std::size_t idx = 0; idx < std::size(values); ++idx)
+	{
+		std::optional<T> const & slot = slots[first + idx];
+		if (!slot || !(*slot == values[idx]))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Shadow values in consecutive slots from @p first, ignoring those beyond the shadowed slots.
+ */
+template <class T, std::size_t N, class Values>
+void store_bound(
+	std::array<std::optional<T>, N> & slots, uint32_t const first, Values const & values)
+{
+	for (std::size_t idx = 0; idx < std::size(values) && first + idx < N; ++idx)
+		slots[first + idx] = values[idx];
+}
+}  // namespace
+
+TrackedCommandBuffer track_command_buffer(VkCommandBuffer command_buffer)
+{
+	return TrackedCommandBuffer{
+		.command_buffer = command_buffer,
+		.graphics = {},
+		.compute = {},
+		.vertex_buffers = {},
+		.index_buffer = std::nullopt,
+		.viewports = {},
+		.scissors = {},
+		.counts = {}};
+}
+
+void invalidate_state(TrackedCommandBuffer & tracked)
+{
+	tracked = TrackedCommandBuffer{
+		.command_buffer = tracked.command_buffer,
+		.graphics = {},
+		.compute = {},
+		.vertex_buffers = {},
+		.index_buffer = std::nullopt,
+		.viewports = {},
+		.scissors = {},
+		.counts = tracked.counts};
+}
+
+CallCounts counts_of(TrackedCommandBuffer const & tracked, Call const call)
+{
+	return tracked.counts[static_cast<std::size_t>(call)];
+}
+
+CallCounts total_counts(TrackedCommandBuffer const & tracked)
+{
+	CallCounts total{.emitted = 0, .elided = 0};
+	for (CallCounts const & counts : tracked.counts)
+	{
+		total.emitted += counts.emitted;
+		total.elided += counts.elided;
+	}
+	return total;
+}
+
+void bind_pipeline(
+	TrackedCommandBuffer & tracked, VkPipelineBindPoint const bind_point, VkPipeline pipeline)
+{
+	BindPointState * const state = state_of(tracked, bind_point);
+	bool const elided = state != nullptr && state->pipeline == pipeline;
+	count(tracked, Call::kBindPipeline, elided);
+	if (elided)
+		return;
+
+	vkCmdBindPipeline(tracked.command_buffer, bind_point, pipeline);
+	if (state != nullptr)
+		state->pipeline = pipeline;
+}
+
+void bind_descriptor_sets(
+	TrackedCommandBuffer & tracked,
+	VkPipelineBindPoint const bind_point,
+	VkPipelineLayout layout,
+	uint32_t const first_set,
+	std::span<VkDescriptorSet const> const descriptor_sets,
+	std::span<uint32_t const> const dynamic_offsets)
+{
+	BindPointState * const state = state_of(tracked, bind_point);
+
+	std::array<BoundDescriptorSet, kMaxDescriptorSets> requested{};
+	std::size_t const tracked_count =
+		first_set < kMaxDescriptorSets
+		? std::min(descriptor_sets.size(), kMaxDescriptorSets - first_set)
+		: 0;
+	for (std::size_t idx = 0; idx < tracked_count; ++idx)
+		requested[idx] = {.layout = layout, .descriptor_set = descriptor_sets[idx]};
+
+	// Dynamic offsets may differ between calls binding the same sets, so are never elided.
+	bool const elided = state != nullptr && dynamic_offsets.empty() &&
+		tracked_count == descriptor_sets.size() &&
+		all_bound(state->descriptor_sets, first_set, std::span{requested}.first(tracked_count));
+	count(tracked, Call::kBindDescriptorSets, elided);
+	if (elided)
+		return;
+
+	vkCmdBindDescriptorSets(
+		tracked.command_buffer,
+		bind_point,
+		layout,
+		first_set,
+		static_cast<uint32_t>(descriptor_sets.size()),
+		descriptor_sets.data(),
+		static_cast<uint32_t>(dynamic_offsets.size()),
+		dynamic_offsets.data());
+
+	if (state == nullptr)
+		return;
+
+	// A layout that differs may not be compatible, disturbing other bound sets. Compatibility is
+	// not known here, so conservatively forget them.
+	for (std::optional<BoundDescriptorSet> & bound : state->descriptor_sets)
+		if (bound && bound->layout != layout)
+			bound.reset();
+
+	if (dynamic_offsets.empty())
+	{
+		store_bound(state->descriptor_sets, first_set, std::span{requested}.first(tracked_count));
+	}
+	else
+	{
+		for (std::size_t idx = 0; idx < tracked_count; ++idx)
+			state->descriptor_sets[first_set + idx].reset();
+	}
+}
+
+void bind_vertex_buffers(
+	TrackedCommandBuffer & tracked,
+	uint32_t const first_binding,
+	std::span<VkBuffer const> const buffers,
+	std::span<VkDeviceSize const> const offsets)
+{
+	if (buffers.size() != offsets.size())
+		throw std::invalid_argument{"Vertex buffer and offset counts differ"};
+
+	std::array<BoundVertexBuffer, kMaxVertexBindings> requested{};
+	std::size_t const tracked_count =
+		first_binding < kMaxVertexBindings
+		? std::min(buffers.size(), kMaxVertexBindings - first_binding)
+		: 0;
+	for (std::size_t idx = 0; idx < tracked_count; ++idx)
+		requested[idx] = {.buffer = buffers[idx], .offset = offsets[idx]};
+
+	bool const elided = tracked_count == buffers.size() &&
+		all_bound(tracked.vertex_buffers, first_binding, std::span{requested}.first(tracked_count));
+	count(tracked, Call::kBindVertexBuffers, elided);
+	if (elided)
+		return;
+
+	vkCmdBindVertexBuffers(
+		tracked.command_buffer,
+		first_binding,
+		static_cast<uint32_t>(buffers.size()),
+		buffers.data(),
+		offsets.data());
+	store_bound(tracked.vertex_buffers, first_binding, std::span{requested}.first(tracked_count));
+}
+
+void bind_index_buffer(
+	TrackedCommandBuffer & tracked,
+	VkBuffer buffer,
+	VkDeviceSize const offset,
+	VkIndexType const index_type)
+{
+	BoundIndexBuffer const requested{.buffer = buffer, .offset = offset, .index_type = index_type};
+	bool const elided = tracked.index_buffer && *tracked.index_buffer == requested;
+	count(tracked, Call::kBindIndexBuffer, elided);
+	if (elided)
+		return;
+
+	vkCmdBindIndexBuffer(tracked.command_buffer, buffer, offset, index_type);
+	tracked.index_buffer = requested;
+}
+
+void set_viewport(
+	TrackedCommandBuffer & tracked,
+	uint32_t const first_viewport,
+	std::span<VkViewport const> const viewports)
+{
+	bool const elided = all_bound(tracked.viewports, first_viewport, viewports);
+	count(tracked, Call::kSetViewport, elided);
+	if (elided)
+		return;
+
+	vkCmdSetViewport(
+		tracked.command_buffer,
+		first_viewport,
+		static_cast<uint32_t>(viewports.size()),
+		viewports.data());
+	store_bound(tracked.viewports, first_viewport, viewports);
+}
+
+void set_scissor(
+	TrackedCommandBuffer & tracked,
+	uint32_t const first_scissor,
+	std::span<VkRect2D const> const scissors)
+{
+	bool const elided = all_bound(tracked.scissors, first_scissor, scissors);
+	count(tracked, Call::kSetScissor, elided);
+	if (elided)
+		return;
+
+	vkCmdSetScissor(
+		tracked.command_buffer,
+		first_scissor,
+		static_cast<uint32_t>(scissors.size()),
+		scissors.data());
+	store_bound(tracked.scissors, first_scissor, scissors);
+}
+
+TEST_CASE("Elide redundant command buffer state changes")
+{
+	vulkandemo::LoggerPtr const logger =
+		vulkandemo::create_logger("Elide redundant command buffer state changes");
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		nullptr,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+
+	constexpr VkMemoryPropertyFlags memory_flags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT,
+		memory_flags);
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device, {{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}}, {}, nullptr);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkCommandBuffer command_buffer = command_buffers->front();
+
+	types::VulkanMemoryTypeIdx const memory_type_idx =
+		setup::filter_available_memory_types(logger, physical_device, memory_flags).at(0);
+
+	// A real pipeline and layout, plus two distinct descriptor sets compatible with the layout.
+	compute::ComputeKernel const kernel = compute::create_luminance_kernel(device);
+	std::array const pool_sizes{
+		VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 2},
+		VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 2}};
+	types::VulkanDescriptorPoolPtr const pool =
+		setup::create_descriptor_pool(device, 2, pool_sizes);
+	std::array const descriptor_sets{
+		setup::allocate_descriptor_set(device, pool, kernel.descriptor_set_layout),
+		setup::allocate_descriptor_set(device, pool, kernel.descriptor_set_layout)};
+
+	auto [buffer, buffer_memory, buffer_bytes] = draw::create_exclusive_mapped_buffer_and_memory(
+		device,
+		memory_type_idx,
+		1024,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+	constexpr VkCommandBufferBeginInfo begin_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+	VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info), "Failed to begin command buffer");
+
+	TrackedCommandBuffer tracked = track_command_buffer(command_buffer);
+
+	SUBCASE("pipelines")
+	{
+		bind_pipeline(tracked, VK_PIPELINE_BIND_POINT_COMPUTE, kernel.pipeline.get());
+		bind_pipeline(tracked, VK_PIPELINE_BIND_POINT_COMPUTE, kernel.pipeline.get());
+		CHECK(counts_of(tracked, Call::kBindPipeline).emitted == 1);
+		CHECK(counts_of(tracked, Call::kBindPipeline).elided == 1);
+
+		invalidate_state(tracked);
+		bind_pipeline(tracked, VK_PIPELINE_BIND_POINT_COMPUTE, kernel.pipeline.get());
+		CHECK(counts_of(tracked, Call::kBindPipeline).emitted == 2);
+		CHECK(counts_of(tracked, Call::kBindPipeline).elided == 1);
+	}
+
+	SUBCASE("descriptor sets")
+	{
+		VkPipelineLayout layout = kernel.layout.get();
+		auto const bind = [&](std::size_t const set_idx)
+		{
+			bind_descriptor_sets(
+				tracked,
+				VK_PIPELINE_BIND_POINT_COMPUTE,
+				layout,
+				0,
+				std::span{descriptor_sets}.subspan(set_idx, 1));
+		};
+		bind(0);
+		bind(0);
+		bind(1);
+		bind(1);
+		bind(0);
+		CHECK(counts_of(tracked, Call::kBindDescriptorSets).emitted == 3);
+		CHECK(counts_of(tracked, Call::kBindDescriptorSets).elided == 2);
+
+		// Graphics bind point is shadowed separately.
+		bind_descriptor_sets(
+			tracked,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			layout,
+			0,
+			std::span{descriptor_sets}.first(1));
+		CHECK(counts_of(tracked, Call::kBindDescriptorSets).emitted == 4);
+	}
+
+	SUBCASE("vertex and index buffers")
+	{
+		std::array const buffers{buffer.get()};
+		std::array<VkDeviceSize, 1> const offsets_a{0};
+		std::array<VkDeviceSize, 1> const offsets_b{256};
+		bind_vertex_buffers(tracked, 0, buffers, offsets_a);
+		bind_vertex_buffers(tracked, 0, buffers, offsets_a);
+		bind_vertex_buffers(tracked, 0, buffers, offsets_b);
+		CHECK(counts_of(tracked, Call::kBindVertexBuffers).emitted == 2);
+		CHECK(counts_of(tracked, Call::kBindVertexBuffers).elided == 1);
+		CHECK_THROWS_AS(
+			bind_vertex_buffers(tracked, 0, buffers, std::span<VkDeviceSize const>{}),
+			std::invalid_argument);
+
+		bind_index_buffer(tracked, buffer.get(), 0, VK_INDEX_TYPE_UINT16);
+		bind_index_buffer(tracked, buffer.get(), 0, VK_INDEX_TYPE_UINT16);
+		bind_index_buffer(tracked, buffer.get(), 0, VK_INDEX_TYPE_UINT32);
+		CHECK(counts_of(tracked, Call::kBindIndexBuffer).emitted == 2);
+		CHECK(counts_of(tracked, Call::kBindIndexBuffer).elided == 1);
+	}
+
+	SUBCASE("viewport and scissor")
+	{
+		std::array const viewports{
+			VkViewport{.x = 0, .y = 0, .width = 64, .height = 64, .minDepth = 0, .maxDepth = 1}};
+		std::array const scissors{VkRect2D{.offset = {0, 0}, .extent = {64, 64}}};
+		for (int frame = 0; frame < 3; ++frame)
+		{
+			set_viewport(tracked, 0, viewports);
+			set_scissor(tracked, 0, scissors);
+		}
+		CHECK(counts_of(tracked, Call::kSetViewport).emitted == 1);
+		CHECK(counts_of(tracked, Call::kSetViewport).elided == 2);
+		CHECK(counts_of(tracked, Call::kSetScissor).emitted == 1);
+		CHECK(counts_of(tracked, Call::kSetScissor).elided == 2);
+
+		CallCounts const total = total_counts(tracked);
+		CHECK(total.emitted == 2);
+		CHECK(total.elided == 4);
+	}
+
+	VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
+}
+}  // namespace vulkandemo::cmd_state
@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include <vulkan/vulkan_core.h>
+
+/**
+ * Command buffer recording that shadows bound state and drops redundant binds.
+ *
+ * Pipelines, descriptor sets, vertex and index buffers, viewports and scissors are recorded through
+ * a TrackedCommandBuffer, which remembers what is bound and skips calls that would rebind the same
+ * state. Every call is counted as emitted or elided, so savings can be measured.
+ *
+ * Shadowed state starts unknown, so the first call of each kind is always emitted. State must be
+ * invalidated whenever it changes behind the tracker's back, e.g. after recording commands directly
+ * into the underlying command buffer or executing secondary command buffers. Bound graphics
+ * pipelines must have viewport and scissor as dynamic state, otherwise binding them overwrites the
+ * shadowed viewport and scissor.
+ */
+namespace vulkandemo::cmd_state
+{
+/// Descriptor sets tracked per bind point. Calls touching sets beyond these are always emitted.
+inline constexpr std::size_t kMaxDescriptorSets = 8;
+/// Vertex input bindings tracked. Calls touching bindings beyond these are always emitted.
+inline constexpr std::size_t kMaxVertexBindings = 16;
+/// Viewports and scissors tracked. Calls touching indices beyond these are always emitted.
+inline constexpr std::size_t kMaxViewports = 4;
+
+enum class Call : uint8_t
+{
+	kBindPipeline,
+	kBindDescriptorSets,
+	kBindVertexBuffers,
+	kBindIndexBuffer,
+	kSetViewport,
+	kSetScissor
+};
+inline constexpr std::size_t kCallCount = 6;
+
+struct CallCounts
+{
+	/// Calls recorded into the command buffer.
+	std::size_t emitted;
+	/// Calls dropped as redundant.
+	std::size_t elided;
+};
+
+struct BoundDescriptorSet
+{
+	VkPipelineLayout layout;
+	VkDescriptorSet descriptor_set;
+};
+
+struct BoundVertexBuffer
+{
+	VkBuffer buffer;
+	VkDeviceSize offset;
+};
+
+struct BoundIndexBuffer
+{
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	VkIndexType index_type;
+};
+
+/**
+ * Shadowed state of the graphics or compute bind point. Empty where unknown.
+ */
+struct BindPointState
+{
+	std::optional<VkPipeline> pipeline;
+	std::array<std::optional<BoundDescriptorSet>, kMaxDescriptorSets> descriptor_sets;
+};
+
+/**
+ * Command buffer plus its shadowed state and call counts.
+ */
+struct TrackedCommandBuffer
+{
+	VkCommandBuffer command_buffer;
+	BindPointState graphics;
+	BindPointState compute;
+	std::array<std::optional<BoundVertexBuffer>, kMaxVertexBindings> vertex_buffers;
+	std::optional<BoundIndexBuffer> index_buffer;
+	std::array<std::optional<VkViewport>, kMaxViewports> viewports;
+	std::array<std::optional<VkRect2D>, kMaxViewports> scissors;
+	/// Indexed by Call.
+	std::array<CallCounts, kCallCount> counts;
+};
+
+/**
+ * Start tracking a command buffer, with all state unknown and zero counts.
+ *
+ * @param command_buffer A command buffer in the recording state.
+ * @return
+ */
+TrackedCommandBuffer track_command_buffer(VkCommandBuffer command_buffer);
+
+/**
+ * Forget all shadowed state, so the next call of each kind is emitted. Counts are kept.
+ *
+ * @param tracked
+ */
+void invalidate_state(TrackedCommandBuffer & tracked);
+
+/**
+ * @param tracked
+ * @param call
+ * @return Counts of a kind of call.
+ */
+CallCounts counts_of(TrackedCommandBuffer const & tracked, Call call);
+
+/**
+ * @param tracked
+ * @return Counts summed over all kinds of call.
+ */
+CallCounts total_counts(TrackedCommandBuffer const & tracked);
+
+/**
+ * `vkCmdBindPipeline`, unless the pipeline is already bound.
+ *
+ * @param tracked
+ * @param bind_point
+ * @param pipeline
+ */
+void bind_pipeline(
+	TrackedCommandBuffer & tracked, VkPipelineBindPoint bind_point, VkPipeline pipeline);
+
+/**
+ * `vkCmdBindDescriptorSets`, unless every set is already bound with the same layout.
+ *
+ * Binding with a different layout forgets the other sets of the bind point, since an incompatible
+ * layout disturbs them. Calls with dynamic offsets are always emitted.
+ *
+ * @param tracked
+ * @param bind_point
+ * @param layout
+ * @param first_set
+ * @param descriptor_sets
+ * @param dynamic_offsets
+ */
+void bind_descriptor_sets(
+	TrackedCommandBuffer & tracked,
+	VkPipelineBindPoint bind_point,
+	VkPipelineLayout layout,
+	uint32_t first_set,
+	std::span<VkDescriptorSet const> descriptor_sets,
+	std::span<uint32_t const> dynamic_offsets = {});
+
+/**
+ * `vkCmdBindVertexBuffers`, unless every buffer is already bound at the same offset.
+ *
+ * @param tracked
+ * @param first_binding
+ * @param buffers
+ * @param offsets Same length as @p buffers.
+ */
+void bind_vertex_buffers(
+	TrackedCommandBuffer & tracked,
+	uint32_t first_binding,
+	std::span<VkBuffer const> buffers,
+	std::span<VkDeviceSize const> offsets);
+
+/**
+ * `vkCmdBindIndexBuffer`, unless the buffer is already bound at the same offset and type.
+ *
+ * @param tracked
+ * @param buffer
+ * @param offset
+ * @param index_type
+ */
+void bind_index_buffer(
+	TrackedCommandBuffer & tracked, VkBuffer buffer, VkDeviceSize offset, VkIndexType index_type);
+
+/**
+ * `vkCmdSetViewport`, unless every viewport is already set.
+ *
+ * @param tracked
+ * @param first_viewport
+ * @param viewports
+ */
+void set_viewport(
+	TrackedCommandBuffer & tracked, uint32_t first_viewport, std::span<VkViewport const> viewports);
+
+/**
+ * `vkCmdSetScissor`, unless every scissor is already set.
+ *
+ * @param tracked
+ * @param first_scissor
+ * @param scissors
+ */
+void set_scissor(
+	TrackedCommandBuffer & tracked, uint32_t first_scissor, std::span<VkRect2D const> scissors);
+}  // namespace vulkandemo::cmd_state
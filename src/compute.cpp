@@ -0,0 +1,600 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "compute.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <optional>
+#include <random>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <range/v3/range/conversion.hpp>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner)
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `VK_CHECK`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "barrier.hpp"
+#include "draw.hpp"
+#include "macros.hpp"
+#include "render_graph.hpp"
+#include "setup.hpp"
+#include "shaders.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::compute
+{
+namespace
+{
+/// Push constants of `luminance.comp`.
+struct LuminancePushConstants
+{
+	VkExtent2D extent;
+};
+
+VkDescriptorType descriptor_type_of(BindingType const type)
+{
+	switch (type)
+	{
+		case BindingType::kStorageBuffer:
+			return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		case BindingType::kStorageImage:
+			return VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	}
+	throw std::invalid_argument{"Unknown compute binding type"};
+}
+
+/**
+ * Write resources to a descriptor set of storage bindings, numbered from zero.
+ */
+void write_bindings(
+	types::VulkanDevicePtr const & device,
+	std::span<BindingType const> const binding_types,
+	VkDescriptorSet descriptor_set,
+	std::span<Binding const> const bindings)
+{
+	if (bindings.size() != binding_types.size())
+		throw std::invalid_argument{"Number of bindings does not match descriptor set layout"};
+
+	// Infos are referenced by the writes, so must not reallocate.
+	std::vector<VkDescriptorBufferInfo> buffer_infos;
+	buffer_infos.reserve(bindings.size());
+	std::vector<VkDescriptorImageInfo> image_infos;
+	image_infos.reserve(bindings.size());
+	std::vector<VkWriteDescriptorSet> writes;
+	writes.reserve(bindings.size());
+
+	for (auto && [binding_idx, binding] : std::views::enumerate(bindings))
+	{
+		auto const binding_num = static_cast<uint32_t>(binding_idx);
+		BindingType const type = binding_types[binding_num];
+		VkWriteDescriptorSet & write = writes.emplace_back(VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = nullptr,
+			.dstSet = descriptor_set,
+			.dstBinding = binding_num,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = descriptor_type_of(type),
+			.pImageInfo = nullptr,
+			.pBufferInfo = nullptr,
+			.pTexelBufferView = nullptr});
+
+		if (auto const * buffer = std::get_if<StorageBuffer>(&binding);
+			buffer != nullptr && type == BindingType::kStorageBuffer)
+		{
+			write.pBufferInfo = &buffer_infos.emplace_back(VkDescriptorBufferInfo{
+				.buffer = buffer->buffer, .offset = buffer->offset, .range = buffer->range});
+		}
+		else if (auto const * image = std::get_if<StorageImage>(&binding);
+				 image != nullptr && type == BindingType::kStorageImage)
+		{
+			write.pImageInfo = &image_infos.emplace_back(VkDescriptorImageInfo{
+				.sampler = nullptr,
+				.imageView = image->image_view,
+				.imageLayout = VK_IMAGE_LAYOUT_GENERAL});
+		}
+		else
+		{
+			throw std::invalid_argument{
+				std::format("Binding {} does not match descriptor set layout", binding_num)};
+		}
+	}
+
+	vkUpdateDescriptorSets(
+		device.get(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+/**
+ * Barriers to record together. Buffers are synchronised by a single global memory barrier.
+ */
+struct DispatchBarriers
+{
+	std::optional<VkMemoryBarrier2> memory;
+	std::vector<VkImageMemoryBarrier2> images;
+};
+
+void add_image_barrier(
+	DispatchBarriers & barriers,
+	VkImage image,
+	render_graph::ResourceState const & src,
+	render_graph::ResourceState const & dst)
+{
+	barriers.images.push_back(
+		barrier::image_barrier(image, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}, src, dst));
+}
+
+/**
+ * Barriers from each resource's prior state to the state required by the dispatch.
+ *
+ * Buffers whose prior state has no stages need no barrier. Images always need one if their
+ * layout changes.
+ */
+DispatchBarriers barriers_before(
+	std::span<BufferUse const> const buffers, std::span<ImageUse const> const images)
+{
+	DispatchBarriers barriers;
+	for (BufferUse const & use : buffers)
+		if (use.before.stages != VK_PIPELINE_STAGE_2_NONE)
+			barrier::merge_memory_barrier(
+				barriers.memory, use.before, render_graph::state_of(use.access));
+
+	for (ImageUse const & use : images)
+	{
+		render_graph::ResourceState const required = render_graph::state_of(use.access);
+		if (use.before.stages != VK_PIPELINE_STAGE_2_NONE || use.before.layout != required.layout)
+			add_image_barrier(barriers, use.image, use.before, required);
+	}
+	return barriers;
+}
+
+/**
+ * Barriers from the state of the dispatch to each resource's next state, where given.
+ */
+DispatchBarriers barriers_after(
+	std::span<BufferUse const> const buffers, std::span<ImageUse const> const images)
+{
+	DispatchBarriers barriers;
+	for (BufferUse const & use : buffers)
+		if (use.after)
+			barrier::merge_memory_barrier(
+				barriers.memory, render_graph::state_of(use.access), *use.after);
+
+	for (ImageUse const & use : images)
+		if (use.after)
+			add_image_barrier(barriers, use.image, render_graph::state_of(use.access), *use.after);
+	return barriers;
+}
+
+void populate_cmd_barriers(VkCommandBuffer command_buffer, DispatchBarriers const & barriers)
+{
+	barrier::populate_cmd_barriers(command_buffer, barriers.memory, barriers.images);
+}
+
+/**
+ * Record barriers into the dispatch, then bind the kernel, its descriptor set and push constants.
+ */
+void populate_cmd_prepare_dispatch(
+	VkCommandBuffer command_buffer,
+	ComputeKernel const & kernel,
+	ComputeBindings const & bindings,
+	std::span<std::byte const> const push_constants,
+	std::span<BufferUse const> const buffers,
+	std::span<ImageUse const> const images)
+{
+	if (push_constants.size() != kernel.push_constant_size)
+		throw std::invalid_argument{"Push constants do not match compute kernel"};
+
+	populate_cmd_barriers(command_buffer, barriers_before(buffers, images));
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernel.pipeline.get());
+	vkCmdBindDescriptorSets(
+		command_buffer,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		kernel.layout.get(),
+		0,
+		1,
+		&bindings.descriptor_set,
+		0,
+		nullptr);
+
+	if (!push_constants.empty())
+		vkCmdPushConstants(
+			command_buffer,
+			kernel.layout.get(),
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			0,
+			kernel.push_constant_size,
+			push_constants.data());
+}
+}  // namespace
+
+ComputeKernel create_compute_kernel(
+	types::VulkanDevicePtr const & device,
+	std::span<uint32_t const> const spirv,
+	std::span<BindingType const> const bindings,
+	uint32_t const push_constant_size,
+	std::array<uint32_t, 3> const work_group_size)
+{
+	std::vector<VkDescriptorSetLayoutBinding> const layout_bindings =
+		std::views::iota(0U, static_cast<uint32_t>(bindings.size())) |
+		std::views::transform(
+			[&](uint32_t const binding)
+			{
+				return VkDescriptorSetLayoutBinding{
+					.binding = binding,
+					.descriptorType = descriptor_type_of(bindings[binding]),
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+					.pImmutableSamplers = nullptr};
+			}) |
+		ranges::to<std::vector>();
+
+	types::VulkanDescriptorSetLayoutPtr descriptor_set_layout =
+		setup::create_descriptor_set_layout(device, layout_bindings);
+
+	VkPushConstantRange const push_constant_range{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = push_constant_size};
+
+	types::VulkanPipelineLayoutPtr layout = setup::create_pipeline_layout(
+		device,
+		{{descriptor_set_layout.get()}},
+		push_constant_size == 0 ? std::span<VkPushConstantRange const>{}
+								: std::span{&push_constant_range, 1});
+
+	types::VulkanPipelinePtr pipeline = setup::create_compute_pipeline(device, layout, spirv);
+
+	return ComputeKernel{
+		.descriptor_set_layout = std::move(descriptor_set_layout),
+		.layout = std::move(layout),
+		.pipeline = std::move(pipeline),
+		.bindings = {bindings.begin(), bindings.end()},
+		.push_constant_size = push_constant_size,
+		.work_group_size = work_group_size};
+}
+
+ComputeKernel create_luminance_kernel(types::VulkanDevicePtr const & device)
+{
+	constexpr std::array bindings{BindingType::kStorageImage, BindingType::kStorageBuffer};
+	return create_compute_kernel(
+		device,
+		shaders::kLuminanceComp,
+		bindings,
+		sizeof(LuminancePushConstants),
+		kLuminanceWorkGroupSize);
+}
+
+ComputeBindings create_compute_bindings(
+	types::VulkanDevicePtr const & device,
+	ComputeKernel const & kernel,
+	std::span<Binding const> const bindings)
+{
+	return create_compute_bindings(device, kernel.descriptor_set_layout, kernel.bindings, bindings);
+}
+
+ComputeBindings create_compute_bindings(
+	types::VulkanDevicePtr const & device,
+	types::VulkanDescriptorSetLayoutPtr const & descriptor_set_layout,
+	std::span<BindingType const> const binding_types,
+	std::span<Binding const> const bindings)
+{
+	std::vector<VkDescriptorPoolSize> pool_sizes;
+	for (BindingType const type : {BindingType::kStorageBuffer, BindingType::kStorageImage})
+	{
+		auto const count = static_cast<uint32_t>(std::ranges::count(binding_types, type));
+		if (count > 0)
+			pool_sizes.push_back({.type = descriptor_type_of(type), .descriptorCount = count});
+	}
+
+	types::VulkanDescriptorPoolPtr descriptor_pool =
+		setup::create_descriptor_pool(device, 1, pool_sizes);
+
+	ComputeBindings compute_bindings{
+		.descriptor_pool = descriptor_pool,
+		.descriptor_set =
+			setup::allocate_descriptor_set(device, descriptor_pool, descriptor_set_layout)};
+
+	write_bindings(device, binding_types, compute_bindings.descriptor_set, bindings);
+	return compute_bindings;
+}
+
+void update_compute_bindings(
+	types::VulkanDevicePtr const & device,
+	ComputeKernel const & kernel,
+	ComputeBindings const & compute_bindings,
+	std::span<Binding const> const bindings)
+{
+	write_bindings(device, kernel.bindings, compute_bindings.descriptor_set, bindings);
+}
+
+std::array<uint32_t, 3> group_count_for(
+	ComputeKernel const & kernel, std::array<uint32_t, 3> const invocation_count)
+{
+	std::array<uint32_t, 3> group_count{};
+	for (std::size_t dim = 0; dim < group_count.size(); ++dim)
+		group_count[dim] = (invocation_count[dim] + kernel.work_group_size[dim] - 1) /
+			kernel.work_group_size[dim];
+	return group_count;
+}
+
+void populate_cmd_dispatch(
+	VkCommandBuffer command_buffer,
+	ComputeKernel const & kernel,
+	ComputeBindings const & bindings,
+	std::span<std::byte const> const push_constants,
+	std::span<BufferUse const> const buffers,
+	std::span<ImageUse const> const images,
+	std::array<uint32_t, 3> const group_count)
+{
+	populate_cmd_prepare_dispatch(
+		command_buffer, kernel, bindings, push_constants, buffers, images);
+	vkCmdDispatch(command_buffer, group_count[0], group_count[1], group_count[2]);
+	populate_cmd_barriers(command_buffer, barriers_after(buffers, images));
+}
+
+void populate_cmd_dispatch_indirect(
+	VkCommandBuffer command_buffer,
+	ComputeKernel const & kernel,
+	ComputeBindings const & bindings,
+	std::span<std::byte const> const push_constants,
+	std::span<BufferUse const> const buffers,
+	std::span<ImageUse const> const images,
+	VkBuffer indirect_buffer,
+	VkDeviceSize const offset)
+{
+	populate_cmd_prepare_dispatch(
+		command_buffer, kernel, bindings, push_constants, buffers, images);
+	vkCmdDispatchIndirect(command_buffer, indirect_buffer, offset);
+	populate_cmd_barriers(command_buffer, barriers_after(buffers, images));
+}
+
+TEST_CASE("Count compute work groups")
+{
+	ComputeKernel const kernel{
+		.descriptor_set_layout = nullptr,
+		.layout = nullptr,
+		.pipeline = nullptr,
+		.bindings = {},
+		.push_constant_size = 0,
+		.work_group_size = kLuminanceWorkGroupSize};
+
+	CHECK(group_count_for(kernel, {1, 1, 1}) == std::array<uint32_t, 3>{1, 1, 1});
+	CHECK(group_count_for(kernel, {8, 16, 1}) == std::array<uint32_t, 3>{1, 2, 1});
+	CHECK(group_count_for(kernel, {9, 17, 3}) == std::array<uint32_t, 3>{2, 3, 3});
+	CHECK(group_count_for(kernel, {0, 0, 0}) == std::array<uint32_t, 3>{0, 0, 0});
+}
+
+TEST_CASE("Dispatch a compute kernel")
+{
+	vulkandemo::LoggerPtr const logger = vulkandemo::create_logger("Dispatch a compute kernel");
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		nullptr,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+
+	constexpr VkMemoryPropertyFlags memory_flags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	// Same queue family as rendering would use.
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT,
+		memory_flags);
+
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan13_features};
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{},
+		&features);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkCommandBuffer command_buffer = command_buffers->front();
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	types::VulkanMemoryTypeIdx const memory_type_idx =
+		setup::filter_available_memory_types(logger, physical_device, memory_flags).at(0);
+
+	// Not a multiple of the work group size, so that out of bounds invocations are exercised.
+	constexpr VkExtent2D extent{37, 23};
+	constexpr std::size_t pixel_count = std::size_t{extent.width} * extent.height;
+
+	auto [image, image_memory] = setup::create_image_and_memory(
+		device,
+		physical_device,
+		VK_FORMAT_R8G8B8A8_UNORM,
+		extent,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+	types::VulkanImageViewPtr const image_view =
+		setup::create_image_view(device, image.get(), VK_FORMAT_R8G8B8A8_UNORM);
+
+	auto [staging_buffer, staging_memory, staging] =
+		draw::create_exclusive_mapped_buffer_and_memory(
+			device, memory_type_idx, pixel_count * 4, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+	std::mt19937 rng{42};  // NOLINT(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+	std::uniform_int_distribution<unsigned> byte_dist{0, 255};
+	for (std::byte & byte : staging)
+		byte = static_cast<std::byte>(byte_dist(rng));
+
+	auto [output_buffer, output_memory, output_bytes] =
+		draw::create_exclusive_mapped_buffer_and_memory(
+			device,
+			memory_type_idx,
+			pixel_count * sizeof(float),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	// NOLINTNEXTLINE(*-reinterpret-cast)
+	std::span const output{reinterpret_cast<float const *>(output_bytes.data()), pixel_count};
+
+	ComputeKernel const kernel = create_luminance_kernel(device);
+	CHECK(kernel.pipeline);
+
+	std::array const bindings{
+		Binding{StorageImage{.image_view = image_view.get()}},
+		Binding{StorageBuffer{.buffer = output_buffer.get()}}};
+	ComputeBindings const compute_bindings = create_compute_bindings(device, kernel, bindings);
+
+	LuminancePushConstants const push_constants{.extent = extent};
+
+	// Image is uploaded by a transfer, then read by the kernel. Output is read back by the host.
+	std::array const buffer_uses{BufferUse{
+		.buffer = output_buffer.get(),
+		.access = render_graph::Access::kComputeShaderStorageWrite,
+		.before = {},
+		.after = render_graph::state_of(render_graph::Access::kHostRead)}};
+	std::array const image_uses{ImageUse{
+		.image = image.get(),
+		.access = render_graph::Access::kComputeShaderStorageRead,
+		.before = render_graph::state_of(render_graph::Access::kTransferWrite),
+		.after = std::nullopt}};
+
+	auto const run = [&](auto const & populate_cmd_kernel)
+	{
+		std::ranges::fill(output_bytes, std::byte{0});
+
+		constexpr VkCommandBufferBeginInfo begin_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+		VK_CHECK(
+			vkBeginCommandBuffer(command_buffer, &begin_info), "Failed to begin command buffer");
+
+		barrier::populate_cmd_barriers(
+			command_buffer,
+			std::nullopt,
+			std::array{barrier::image_barrier(
+				image.get(),
+				{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+				{},
+				render_graph::state_of(render_graph::Access::kTransferWrite))});
+
+		VkBufferImageCopy const region{
+			.bufferOffset = 0,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+			.imageOffset = {0, 0, 0},
+			.imageExtent = {extent.width, extent.height, 1}};
+		vkCmdCopyBufferToImage(
+			command_buffer,
+			staging_buffer.get(),
+			image.get(),
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1,
+			&region);
+
+		populate_cmd_kernel();
+
+		VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
+		draw::submit_command_buffer(queue, command_buffer, nullptr, nullptr);
+		VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+
+		// CPU reference.
+		for (std::size_t pixel_idx = 0; pixel_idx < pixel_count; ++pixel_idx)
+		{
+			auto const channel = [&](std::size_t const channel_idx)
+			{
+				return static_cast<float>(std::to_integer<unsigned>(
+						   staging[pixel_idx * 4 + channel_idx])) /
+					255.0F;
+			};
+			float const expected =
+				0.2126F * channel(0) + 0.7152F * channel(1) + 0.0722F * channel(2);
+			CAPTURE(pixel_idx);
+			CHECK(output[pixel_idx] == doctest::Approx(expected).epsilon(1e-4));
+		}
+	};
+
+	SUBCASE("direct")
+	{
+		run(
+			[&]
+			{
+				populate_cmd_dispatch(
+					command_buffer,
+					kernel,
+					compute_bindings,
+					std::as_bytes(std::span{&push_constants, 1}),
+					buffer_uses,
+					image_uses,
+					group_count_for(kernel, {extent.width, extent.height, 1}));
+			});
+	}
+
+	SUBCASE("indirect")
+	{
+		auto [indirect_buffer, indirect_memory, indirect_bytes] =
+			draw::create_exclusive_mapped_buffer_and_memory(
+				device,
+				memory_type_idx,
+				sizeof(VkDispatchIndirectCommand),
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+		std::array<uint32_t, 3> const group_count =
+			group_count_for(kernel, {extent.width, extent.height, 1});
+		VkDispatchIndirectCommand const command{group_count[0], group_count[1], group_count[2]};
+		std::ranges::copy(std::as_bytes(std::span{&command, 1}), indirect_bytes.begin());
+
+		// Host write to the indirect buffer is made visible by submission, so needs no barrier.
+		std::array const indirect_buffer_uses{
+			buffer_uses.front(),
+			BufferUse{
+				.buffer = indirect_buffer.get(),
+				.access = render_graph::Access::kIndirectCommandRead}};
+
+		run(
+			[&]
+			{
+				populate_cmd_dispatch_indirect(
+					command_buffer,
+					kernel,
+					compute_bindings,
+					std::as_bytes(std::span{&push_constants, 1}),
+					indirect_buffer_uses,
+					image_uses,
+					indirect_buffer.get(),
+					0);
+			});
+	}
+
+	SUBCASE("mismatched bindings")
+	{
+		std::array const wrong_bindings{
+			Binding{StorageBuffer{.buffer = output_buffer.get()}},
+			Binding{StorageBuffer{.buffer = output_buffer.get()}}};
+		CHECK_THROWS_AS(
+			update_compute_bindings(device, kernel, compute_bindings, wrong_bindings),
+			std::invalid_argument);
+		CHECK_THROWS_AS(
+			update_compute_bindings(device, kernel, compute_bindings, std::span{bindings}.first(1)),
+			std::invalid_argument);
+	}
+}
+}  // namespace vulkandemo::compute
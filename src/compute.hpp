@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "draw.hpp"
+#include "render_graph.hpp"
+#include "types.hpp"
+
+/**
+ * General purpose compute kernels: pipelines over storage buffer and storage image bindings, and
+ * dispatch recording with the barriers that order each dispatch against its neighbours.
+ *
+ * Kernels run on the rendering device, so a graphics queue family can be used for both, see
+ * setup::select_physical_device. Barriers are synchronization2, so the device must be created
+ * with the `synchronization2` feature of VkPhysicalDeviceVulkan13Features enabled.
+ */
+namespace vulkandemo::compute
+{
+/// Work group size of `luminance.comp`.
+inline constexpr std::array<uint32_t, 3> kLuminanceWorkGroupSize{8, 8, 1};
+
+enum class BindingType : uint8_t
+{
+	kStorageBuffer,
+	kStorageImage
+};
+
+/**
+ * Compute pipeline with a single descriptor set of storage bindings, numbered from zero.
+ */
+struct ComputeKernel
+{
+	types::VulkanDescriptorSetLayoutPtr descriptor_set_layout;
+	types::VulkanPipelineLayoutPtr layout;
+	types::VulkanPipelinePtr pipeline;
+	std::vector<BindingType> bindings;
+	/// Size in bytes of the push constant block, if any.
+	uint32_t push_constant_size;
+	/// As declared by the shader's `local_size_x/y/z`.
+	std::array<uint32_t, 3> work_group_size;
+};
+
+struct StorageBuffer
+{
+	VkBuffer buffer;
+	VkDeviceSize offset = 0;
+	VkDeviceSize range = VK_WHOLE_SIZE;
+};
+
+/**
+ * Storage image view, accessed by kernels in the general layout.
+ */
+struct StorageImage
+{
+	VkImageView image_view;
+};
+
+using Binding = std::variant<StorageBuffer, StorageImage>;
+
+/**
+ * Descriptor set binding resources to a kernel.
+ */
+struct ComputeBindings
+{
+	types::VulkanDescriptorPoolPtr descriptor_pool;
+	/// Owned by descriptor_pool.
+	VkDescriptorSet descriptor_set;
+};
+
+/**
+ * Buffer accessed by a dispatch, with the states it must be synchronised with.
+ */
+struct BufferUse
+{
+	VkBuffer buffer;
+	/// A compute shader storage access, or indirect command read for the dispatch parameters.
+	render_graph::Access access;
+	/// State left by the previous user of the buffer. No barrier if no stages, e.g. for host
+	/// writes made visible by queue submission.
+	render_graph::ResourceState before{};
+	/// State required by the next user of the buffer, if a barrier is wanted immediately.
+	std::optional<render_graph::ResourceState> after = std::nullopt;
+};
+
+/**
+ * Single mip, single layer colour image accessed by a dispatch, with the states it must be
+ * synchronised with, including layout transitions into and out of the general layout.
+ */
+struct ImageUse
+{
+	VkImage image;
+	/// A compute shader storage access.
+	render_graph::Access access;
+	/// State left by the previous user of the image. Undefined layout discards contents.
+	render_graph::ResourceState before{};
+	/// State required by the next user of the image, if a barrier is wanted immediately.
+	std::optional<render_graph::ResourceState> after = std::nullopt;
+};
+
+/**
+ * Create a persistently mapped storage buffer, returning a typed view of the mapped memory.
+ *
+ * @tparam T Element type, laid out as declared by the shaders accessing the buffer.
+ * @param device
+ * @param memory_type_idx Host visible and host coherent memory type.
+ * @param count Number of elements.
+ * @param extra_usage Usage in addition to storage, e.g. indirect or transfer destination.
+ * @return Buffer handle, memory handle and the host view of the mapped memory.
+ */
+template <typename T>
+std::tuple<types::VulkanBufferPtr, types::VulkanDeviceMemoryPtr, std::span<T>>
+create_mapped_storage_buffer(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx const memory_type_idx,
+	std::size_t const count,
+	VkBufferUsageFlags const extra_usage)
+{
+	auto [buffer, memory, mapped] = draw::create_exclusive_mapped_buffer_and_memory(
+		device,
+		memory_type_idx,
+		count * sizeof(T),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | extra_usage);
+	return {
+		std::move(buffer),
+		std::move(memory),
+		// NOLINTNEXTLINE(*-reinterpret-cast)
+		std::span{reinterpret_cast<T *>(mapped.data()), count}};
+}
+
+/**
+ * Create a compute kernel from SPIR-V with a `main` entry point.
+ *
+ * @param device
+ * @param spirv
+ * @param bindings Type of each binding of descriptor set 0, in binding order.
+ * @param push_constant_size Size in bytes of the push constant block, or zero if none.
+ * @param work_group_size Declared work group size of the shader.
+ * @return
+ */
+ComputeKernel create_compute_kernel(
+	types::VulkanDevicePtr const & device,
+	std::span<uint32_t const> spirv,
+	std::span<BindingType const> bindings,
+	uint32_t push_constant_size,
+	std::array<uint32_t, 3> work_group_size);
+
+/**
+ * Create the luminance sample kernel, converting an RGBA8 storage image to a tightly packed
+ * buffer of floats.
+ *
+ * Bindings are the image then the buffer. Push constants are the image extent.
+ *
+ * @param device
+ * @return
+ */
+ComputeKernel create_luminance_kernel(types::VulkanDevicePtr const & device);
+
+/**
+ * Allocate a descriptor set for a kernel and bind resources to it.
+ *
+ * @param device
+ * @param kernel
+ * @param bindings Resource for each of the kernel's bindings, in binding order.
+ * @return
+ */
+ComputeBindings create_compute_bindings(
+	types::VulkanDevicePtr const & device,
+	ComputeKernel const & kernel,
+	std::span<Binding const> bindings);
+
+/**
+ * Allocate a descriptor set of storage bindings for a pipeline other than a kernel, e.g. task and
+ * mesh shaders reading the same buffers as a kernel, and bind resources to it.
+ *
+ * @param device
+ * @param descriptor_set_layout Of bindings numbered from zero, of the types in @p binding_types.
+ * @param binding_types Type of each binding, in binding order.
+ * @param bindings Resource for each binding, in binding order.
+ * @return
+ */
+ComputeBindings create_compute_bindings(
+	types::VulkanDevicePtr const & device,
+	types::VulkanDescriptorSetLayoutPtr const & descriptor_set_layout,
+	std::span<BindingType const> binding_types,
+	std::span<Binding const> bindings);
+
+/**
+ * Rebind resources of a descriptor set, e.g. to reuse it for a different frame's resources.
+ *
+ * Must not be called while the set is in use by a pending command buffer.
+ *
+ * @param device
+ * @param kernel
+ * @param compute_bindings
+ * @param bindings Resource for each of the kernel's bindings, in binding order.
+ */
+void update_compute_bindings(
+	types::VulkanDevicePtr const & device,
+	ComputeKernel const & kernel,
+	ComputeBindings const & compute_bindings,
+	std::span<Binding const> bindings);
+
+/**
+ * Number of work groups covering a number of invocations in each dimension.
+ *
+ * @param kernel
+ * @param invocation_count
+ * @return
+ */
+std::array<uint32_t, 3> group_count_for(
+	ComputeKernel const & kernel, std::array<uint32_t, 3> invocation_count);
+
+/**
+ * Record a dispatch with barriers from each resource's prior state, and to its next state if
+ * given.
+ *
+ * Must be recorded outside of a render pass.
+ *
+ * @param command_buffer
+ * @param kernel
+ * @param bindings
+ * @param push_constants Bytes of size ComputeKernel::push_constant_size.
+ * @param buffers
+ * @param images
+ * @param group_count
+ */
+void populate_cmd_dispatch(
+	VkCommandBuffer command_buffer,
+	ComputeKernel const & kernel,
+	ComputeBindings const & bindings,
+	std::span<std::byte const> push_constants,
+	std::span<BufferUse const> buffers,
+	std::span<ImageUse const> images,
+	std::array<uint32_t, 3> group_count);
+
+/**
+ * Record an indirect dispatch, whose group count is read from a VkDispatchIndirectCommand in a
+ * buffer, with barriers as per populate_cmd_dispatch.
+ *
+ * The indirect buffer should be included in @p buffers with indirect command read access if it is
+ * written by the device, so that the write is made visible to the dispatch.
+ *
+ * @param command_buffer
+ * @param kernel
+ * @param bindings
+ * @param push_constants Bytes of size ComputeKernel::push_constant_size.
+ * @param buffers
+ * @param images
+ * @param indirect_buffer Buffer with indirect usage.
+ * @param offset Offset in bytes of the command, a multiple of 4.
+ */
+void populate_cmd_dispatch_indirect(
+	VkCommandBuffer command_buffer,
+	ComputeKernel const & kernel,
+	ComputeBindings const & bindings,
+	std::span<std::byte const> push_constants,
+	std::span<BufferUse const> buffers,
+	std::span<ImageUse const> images,
+	VkBuffer indirect_buffer,
+	VkDeviceSize offset);
+}  // namespace vulkandemo::compute
@@ -0,0 +1,497 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#include "cull.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner) for `logger`
+
+#include <doctest/doctest.h>
+
+#include "Logger.hpp"
+#include "bench.hpp"
+#include "frustum.hpp"
+#include "maths.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+namespace vulkandemo::cull
+{
+namespace
+{
+/**
+ * Cull spheres `[begin, end)` writing visible indices from `out`.
+ *
+ * `out` must have space for `end - begin` indices. Every kernel writes a candidate index for every
+ * sphere, but only advances past it if visible, so writes never exceed the range culled.
+ *
+ * @return Number of visible indices written.
+ */
+using RangeKernel = std::size_t (*)(
+	frustum::Frustum const & frustum,
+	SphereBounds const & bounds,
+	std::size_t begin,
+	std::size_t end,
+	uint32_t * out);
+
+/**
+ * Branchless append of the lanes set in a SIMD comparison mask.
+ */
+inline std::size_t append_lanes(
+	uint32_t * out,
+	std::size_t count,
+	std::size_t const first_idx,
+	unsigned const mask,
+	std::size_t const lane_count)
+{
+	for (std::size_t lane = 0; lane < lane_count; ++lane)
+	{
+		out[count] = static_cast<uint32_t>(first_idx + lane);  // NOLINT(*-pointer-arithmetic)
+		count += (mask >> lane) & 1U;
+	}
+	return count;
+}
+
+// All kernels evaluate plane distances with the same sequence of (unfused) multiplies and adds, so
+// results are identical across kernels.
+
+std::size_t cull_range_scalar(
+	frustum::Frustum const & frustum,
+	SphereBounds const & bounds,
+	std::size_t const begin,
+	std::size_t const end,
+	uint32_t * out)
+{
+	std::size_t count = 0;
+	for (std::size_t idx = begin; idx < end; ++idx)
+	{
+		bool inside = true;
+		for (frustum::Plane const & plane : frustum)
+		{
+			float const distance = plane[0] * bounds.centre_x[idx] +
+				plane[1] * bounds.centre_y[idx] + plane[2] * bounds.centre_z[idx] + plane[3];
+			inside &= distance >= -bounds.radius[idx];
+		}
+		out[count] = static_cast<uint32_t>(idx);  // NOLINT(*-pointer-arithmetic)
+		count += static_cast<std::size_t>(inside);
+	}
+	return count;
+}
+
+#if defined(__x86_64__)
+// Plane coefficients broadcast across all lanes. Wrapped in a struct since vector types lose their
+// alignment attributes as template arguments.
+struct PlaneSse
+{
+	__m128 a;
+	__m128 b;
+	__m128 c;
+	__m128 d;
+};
+
+struct PlaneAvx
+{
+	__m256 a;
+	__m256 b;
+	__m256 c;
+	__m256 d;
+};
+
+// SSE2 is part of the x86-64 baseline, so needs no runtime check.
+std::size_t cull_range_sse2(
+	frustum::Frustum const & frustum,
+	SphereBounds const & bounds,
+	std::size_t const begin,
+	std::size_t const end,
+	uint32_t * out)
+{
+	constexpr std::size_t lane_count = 4;
+
+	std::array<PlaneSse, 6> planes{};
+	for (std::size_t plane_idx = 0; plane_idx < planes.size(); ++plane_idx)
+	{
+		frustum::Plane const & plane = frustum[plane_idx];
+		planes[plane_idx] = {
+			_mm_set1_ps(plane[0]),
+			_mm_set1_ps(plane[1]),
+			_mm_set1_ps(plane[2]),
+			_mm_set1_ps(plane[3])};
+	}
+
+	std::size_t count = 0;
+	std::size_t idx = begin;
+	for (; idx + lane_count <= end; idx += lane_count)
+	{
+		__m128 const centre_x = _mm_loadu_ps(&bounds.centre_x[idx]);
+		__m128 const centre_y = _mm_loadu_ps(&bounds.centre_y[idx]);
+		__m128 const centre_z = _mm_loadu_ps(&bounds.centre_z[idx]);
+		__m128 const neg_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&bounds.radius[idx]));
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (auto const & plane : planes)
+		{
+			__m128 const distance = _mm_add_ps(
+				_mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(plane.a, centre_x), _mm_mul_ps(plane.b, centre_y)),
+					_mm_mul_ps(plane.c, centre_z)),
+				plane.d);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, neg_radius));
+		}
+
+		count = append_lanes(
+			out, count, idx, static_cast<unsigned>(_mm_movemask_ps(inside)), lane_count);
+	}
+	// NOLINTNEXTLINE(*-pointer-arithmetic)
+	return count + cull_range_scalar(frustum, bounds, idx, end, out + count);
+}
+
+__attribute__((target("avx2"))) std::size_t cull_range_avx2(
+	frustum::Frustum const & frustum,
+	SphereBounds const & bounds,
+	std::size_t const begin,
+	std::size_t const end,
+	uint32_t * out)
+{
+	constexpr std::size_t lane_count = 8;
+
+	std::array<PlaneAvx, 6> planes{};
+	for (std::size_t plane_idx = 0; plane_idx < planes.size(); ++plane_idx)
+	{
+		frustum::Plane const & plane = frustum[plane_idx];
+		planes[plane_idx] = {
+			_mm256_set1_ps(plane[0]),
+			_mm256_set1_ps(plane[1]),
+			_mm256_set1_ps(plane[2]),
+			_mm256_set1_ps(plane[3])};
+	}
+
+	std::size_t count = 0;
+	std::size_t idx = begin;
+	for (; idx + lane_count <= end; idx += lane_count)
+	{
+		__m256 const centre_x = _mm256_loadu_ps(&bounds.centre_x[idx]);
+		__m256 const centre_y = _mm256_loadu_ps(&bounds.centre_y[idx]);
+		__m256 const centre_z = _mm256_loadu_ps(&bounds.centre_z[idx]);
+		__m256 const neg_radius =
+			_mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&bounds.radius[idx]));
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (auto const & plane : planes)
+		{
+			__m256 const distance = _mm256_add_ps(
+				_mm256_add_ps(
+					_mm256_add_ps(
+						_mm256_mul_ps(plane.a, centre_x), _mm256_mul_ps(plane.b, centre_y)),
+					_mm256_mul_ps(plane.c, centre_z)),
+				plane.d);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, neg_radius, _CMP_GE_OQ));
+		}
+
+		count = append_lanes(
+			out, count, idx, static_cast<unsigned>(_mm256_movemask_ps(inside)), lane_count);
+	}
+	// NOLINTNEXTLINE(*-pointer-arithmetic)
+	return count + cull_range_scalar(frustum, bounds, idx, end, out + count);
+}
+#endif
+
+#if defined(__aarch64__)
+struct PlaneNeon
+{
+	float32x4_t a;
+	float32x4_t b;
+	float32x4_t c;
+	float32x4_t d;
+};
+
+// NEON is mandatory on AArch64, so needs no runtime check.
+std::size_t cull_range_neon(
+	frustum::Frustum const & frustum,
+	SphereBounds const & bounds,
+	std::size_t const begin,
+	std::size_t const end,
+	uint32_t * out)
+{
+	constexpr std::size_t lane_count = 4;
+	constexpr std::array<uint32_t, lane_count> lane_bits{1, 2, 4, 8};
+	uint32x4_t const lane_bits_vec = vld1q_u32(lane_bits.data());
+
+	std::array<PlaneNeon, 6> planes{};
+	for (std::size_t plane_idx = 0; plane_idx < planes.size(); ++plane_idx)
+	{
+		frustum::Plane const & plane = frustum[plane_idx];
+		planes[plane_idx] = {
+			vdupq_n_f32(plane[0]),
+			vdupq_n_f32(plane[1]),
+			vdupq_n_f32(plane[2]),
+			vdupq_n_f32(plane[3])};
+	}
+
+	std::size_t count = 0;
+	std::size_t idx = begin;
+	for (; idx + lane_count <= end; idx += lane_count)
+	{
+		float32x4_t const centre_x = vld1q_f32(&bounds.centre_x[idx]);
+		float32x4_t const centre_y = vld1q_f32(&bounds.centre_y[idx]);
+		float32x4_t const centre_z = vld1q_f32(&bounds.centre_z[idx]);
+		float32x4_t const neg_radius = vnegq_f32(vld1q_f32(&bounds.radius[idx]));
+
+		uint32x4_t inside = vdupq_n_u32(~0U);
+		for (auto const & plane : planes)
+		{
+			float32x4_t const distance = vaddq_f32(
+				vaddq_f32(
+					vaddq_f32(vmulq_f32(plane.a, centre_x), vmulq_f32(plane.b, centre_y)),
+					vmulq_f32(plane.c, centre_z)),
+				plane.d);
+			inside = vandq_u32(inside, vcgeq_f32(distance, neg_radius));
+		}
+
+		count = append_lanes(
+			out, count, idx, vaddvq_u32(vandq_u32(inside, lane_bits_vec)), lane_count);
+	}
+	// NOLINTNEXTLINE(*-pointer-arithmetic)
+	return count + cull_range_scalar(frustum, bounds, idx, end, out + count);
+}
+#endif
+
+RangeKernel range_kernel(simd::Kernel const kernel)
+{
+	if (!simd::is_kernel_supported(kernel))
+		throw std::runtime_error{
+			std::string{"Culling kernel not supported: "} +
+			std::string{simd::kernel_name(kernel)}};
+
+	switch (kernel)
+	{
+#if defined(__x86_64__)
+		case simd::Kernel::kSse2:
+			return &cull_range_sse2;
+		case simd::Kernel::kAvx2:
+			return &cull_range_avx2;
+#endif
+#if defined(__aarch64__)
+		case simd::Kernel::kNeon:
+			return &cull_range_neon;
+#endif
+		default:
+			return &cull_range_scalar;
+	}
+}
+}  // namespace
+
+void push_sphere(SphereBounds & bounds, Sphere const & sphere)
+{
+	bounds.centre_x.push_back(sphere.centre[0]);
+	bounds.centre_y.push_back(sphere.centre[1]);
+	bounds.centre_z.push_back(sphere.centre[2]);
+	bounds.radius.push_back(sphere.radius);
+}
+
+std::span<uint32_t const> cull_spheres(
+	frustum::Frustum const & frustum,
+	SphereBounds const & bounds,
+	std::vector<uint32_t> & visible_indices,
+	simd::Kernel const kernel)
+{
+	RangeKernel const cull_range = range_kernel(kernel);
+	std::size_t const sphere_count = bounds.radius.size();
+	visible_indices.resize(std::max(visible_indices.size(), sphere_count));
+
+	std::size_t const visible_count =
+		cull_range(frustum, bounds, 0, sphere_count, visible_indices.data());
+
+	return std::span{visible_indices}.first(visible_count);
+}
+
+std::span<uint32_t const> cull_spheres(
+	frustum::Frustum const & frustum,
+	SphereBounds const & bounds,
+	std::vector<uint32_t> & visible_indices,
+	parallel::ThreadPool & pool,
+	simd::Kernel const kernel)
+{
+	RangeKernel const cull_range = range_kernel(kernel);
+	std::size_t const sphere_count = bounds.radius.size();
+	visible_indices.resize(std::max(visible_indices.size(), sphere_count));
+
+	std::vector<std::size_t> chunk_visible_counts((sphere_count + kChunkSize - 1) / kChunkSize);
+
+	parallel::for_each_chunk(
+		pool,
+		sphere_count,
+		kChunkSize,
+		[&](std::size_t const chunk_idx, std::size_t const begin, std::size_t const end)
+		{
+			chunk_visible_counts[chunk_idx] =
+				cull_range(frustum, bounds, begin, end, &visible_indices[begin]);
+		});
+
+	// Shift each chunk's results down to follow the previous chunk's. Destination always precedes
+	// source, so a forward copy is safe.
+	std::size_t visible_count = 0;
+	for (std::size_t chunk_idx = 0; chunk_idx < chunk_visible_counts.size(); ++chunk_idx)
+	{
+		auto const chunk_begin =
+			visible_indices.begin() + static_cast<std::ptrdiff_t>(chunk_idx * kChunkSize);
+		std::copy(
+			chunk_begin,
+			chunk_begin + static_cast<std::ptrdiff_t>(chunk_visible_counts[chunk_idx]),
+			visible_indices.begin() + static_cast<std::ptrdiff_t>(visible_count));
+		visible_count += chunk_visible_counts[chunk_idx];
+	}
+
+	return std::span{visible_indices}.first(visible_count);
+}
+
+void cull_spheres_baseline(
+	frustum::Frustum const & frustum,
+	std::span<Sphere const> const spheres,
+	std::vector<uint32_t> & visible_indices)
+{
+	visible_indices.clear();
+	for (std::size_t idx = 0; idx < spheres.size(); ++idx)
+		if (frustum::intersects_sphere(frustum, spheres[idx].centre, spheres[idx].radius))
+			visible_indices.push_back(static_cast<uint32_t>(idx));
+}
+
+namespace
+{
+/**
+ * Perspective camera at the origin looking down -z, with Vulkan clip space conventions.
+ */
+frustum::Frustum make_test_frustum()
+{
+	constexpr float fov_y = std::numbers::pi_v<float> / 3;
+	constexpr float near = 0.1F;
+	constexpr float far = 100.0F;
+	return frustum::extract_planes(maths::perspective(fov_y, 1.0F, near, far));
+}
+
+std::vector<Sphere> make_random_spheres(std::size_t const count)
+{
+	std::mt19937 rng{42};  // NOLINT(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+	std::uniform_real_distribution<float> position{-100.0F, 100.0F};
+	std::uniform_real_distribution<float> radius{0.1F, 5.0F};
+	std::vector<Sphere> spheres(count);
+	for (Sphere & sphere : spheres)
+		sphere = {.centre = {position(rng), position(rng), position(rng)}, .radius = radius(rng)};
+	return spheres;
+}
+
+SphereBounds to_sphere_bounds(std::span<Sphere const> const spheres)
+{
+	SphereBounds bounds;
+	for (Sphere const & sphere : spheres)
+		push_sphere(bounds, sphere);
+	return bounds;
+}
+}  // namespace
+
+TEST_CASE("Cull spheres over a structure-of-arrays store")
+{
+	frustum::Frustum const frustum = make_test_frustum();
+	// Not a multiple of kernel width nor chunk size, to exercise remainders.
+	std::vector<Sphere> const spheres = make_random_spheres(3 * kChunkSize + 5);
+	SphereBounds const bounds = to_sphere_bounds(spheres);
+
+	std::vector<uint32_t> expected;
+	cull_spheres_baseline(frustum, spheres, expected);
+	// Sanity check the scene is partially visible.
+	CHECK(!expected.empty());
+	CHECK(expected.size() < spheres.size());
+
+	parallel::ThreadPool pool{3};
+
+	for (simd::Kernel const kernel :
+		 {simd::Kernel::kScalar, simd::Kernel::kSse2, simd::Kernel::kAvx2, simd::Kernel::kNeon})
+	{
+		CAPTURE(simd::kernel_name(kernel));
+		std::vector<uint32_t> visible_indices;
+
+		if (!simd::is_kernel_supported(kernel))
+		{
+			CHECK_THROWS_AS(
+				cull_spheres(frustum, bounds, visible_indices, kernel), std::runtime_error);
+			continue;
+		}
+
+		std::span<uint32_t const> visible = cull_spheres(frustum, bounds, visible_indices, kernel);
+		CHECK(std::ranges::equal(visible, expected));
+
+		// Reuse of storage from a previous, larger, result.
+		visible = cull_spheres(frustum, bounds, visible_indices, pool, kernel);
+		CHECK(std::ranges::equal(visible, expected));
+	}
+
+	SUBCASE("empty")
+	{
+		std::vector<uint32_t> visible_indices;
+		CHECK(cull_spheres(frustum, SphereBounds{}, visible_indices).empty());
+		CHECK(cull_spheres(frustum, SphereBounds{}, visible_indices, pool).empty());
+	}
+}
+
+TEST_CASE("Benchmark SIMD frustum culling" * doctest::test_suite("benchmark") * doctest::skip())
+{
+	LoggerPtr const logger = create_logger("Benchmark SIMD frustum culling");
+	frustum::Frustum const frustum = make_test_frustum();
+	parallel::ThreadPool pool;
+	logger->info(
+		"Best kernel {} with {} threads",
+		simd::kernel_name(simd::best_kernel()),
+		pool.thread_count());
+
+	for (std::size_t const sphere_count : {10'000UZ, 100'000UZ, 1'000'000UZ})
+	{
+		std::vector<Sphere> const spheres = make_random_spheres(sphere_count);
+		SphereBounds const bounds = to_sphere_bounds(spheres);
+		std::vector<uint32_t> visible_indices;
+		constexpr std::size_t iterations = 50;
+
+		double const baseline_ms = bench::mean_ms(
+			iterations, [&] { cull_spheres_baseline(frustum, spheres, visible_indices); });
+		logger->info(
+			"{} spheres: AoS scalar baseline {:.3f} ms ({} visible)",
+			sphere_count,
+			baseline_ms,
+			visible_indices.size());
+
+		for (simd::Kernel const kernel :
+			 {simd::Kernel::kScalar, simd::Kernel::kSse2, simd::Kernel::kAvx2, simd::Kernel::kNeon})
+		{
+			if (!simd::is_kernel_supported(kernel))
+				continue;
+			double const single_ms = bench::mean_ms(
+				iterations, [&] { cull_spheres(frustum, bounds, visible_indices, kernel); });
+			double const parallel_ms = bench::mean_ms(
+				iterations, [&] { cull_spheres(frustum, bounds, visible_indices, pool, kernel); });
+			logger->info(
+				"{} spheres: SoA {} {:.3f} ms ({:.1f}x), parallel {:.3f} ms ({:.1f}x)",
+				sphere_count,
+				simd::kernel_name(kernel),
+				single_ms,
+				baseline_ms / single_ms,
+				parallel_ms,
+				baseline_ms / parallel_ms);
+		}
+	}
+}
+}  // namespace vulkandemo::cull
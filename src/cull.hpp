@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "frustum.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+/**
+ * CPU frustum culling of bounding spheres stored as structure-of-arrays, using SIMD kernels chosen
+ * at runtime, see simd::Kernel.
+ *
+ * Each kernel tests 4 or 8 spheres against all six planes at once, then appends the indices of
+ * visible spheres to a compact list without branching on visibility.
+ */
+namespace vulkandemo::cull
+{
+/// Number of spheres culled per parallel task. A multiple of the widest kernel.
+inline constexpr std::size_t kChunkSize = 16384;
+
+/**
+ * World space bounding sphere, as an array-of-structs element.
+ */
+struct Sphere
+{
+	std::array<float, 3> centre;
+	float radius;
+};
+
+/**
+ * Bounding spheres as structure-of-arrays, so that a SIMD register can be loaded with one
+ * component of several consecutive spheres. All vectors are the same length.
+ */
+struct SphereBounds
+{
+	std::vector<float> centre_x;
+	std::vector<float> centre_y;
+	std::vector<float> centre_z;
+	std::vector<float> radius;
+};
+
+/**
+ * Append a sphere to a structure-of-arrays store.
+ *
+ * @param bounds
+ * @param sphere
+ */
+void push_sphere(SphereBounds & bounds, Sphere const & sphere);
+
+/**
+ * Cull spheres on the calling thread.
+ *
+ * @param frustum
+ * @param bounds
+ * @param visible_indices Storage for the result, reused across calls to avoid reallocation. Grown
+ * to at least the number of spheres.
+ * @param kernel Must be supported, see simd::is_kernel_supported.
+ * @return Ascending indices of spheres that intersect the frustum, as a prefix of visible_indices.
+ */
+std::span<uint32_t const> cull_spheres(
+	frustum::Frustum const & frustum,
+	SphereBounds const & bounds,
+	std::vector<uint32_t> & visible_indices,
+	simd::Kernel kernel = simd::best_kernel());
+
+/**
+ * Cull spheres in chunks of kChunkSize across a thread pool.
+ *
+ * Each chunk writes its visible indices in place within its own range of visible_indices, then
+ * the per-chunk results are compacted on the calling thread.
+ *
+ * @param frustum
+ * @param bounds
+ * @param visible_indices See single-threaded cull_spheres.
+ * @param pool
+ * @param kernel Must be supported, see simd::is_kernel_supported.
+ * @return Ascending indices of spheres that intersect the frustum, as a prefix of visible_indices.
+ */
+std::span<uint32_t const> cull_spheres(
+	frustum::Frustum const & frustum,
+	SphereBounds const & bounds,
+	std::vector<uint32_t> & visible_indices,
+	parallel::ThreadPool & pool,
+	simd::Kernel kernel = simd::best_kernel());
+
+/**
+ * Scalar array-of-structs culling using frustum::intersects_sphere, as a baseline for comparison.
+ *
+ * @param frustum
+ * @param spheres
+ * @param visible_indices Cleared then filled with ascending indices of visible spheres.
+ */
+void cull_spheres_baseline(
+	frustum::Frustum const & frustum,
+	std::span<Sphere const> spheres,
+	std::vector<uint32_t> & visible_indices);
+}  // namespace vulkandemo::cull
@@ -10,16 +10,21 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <format>
 #include <iterator>
 #include <limits>
 #include <optional>
+#include <ranges>
 #include <span>
 #include <stdexcept>
+#include <tuple>
 #include <utility>
 #include <vector>
 
+#include <range/v3/range/conversion.hpp>
+
 #include <spdlog/logger.h>	// NOLINT(misc-include-cleaner)
 
 #include <doctest/doctest.h>
@@ -30,7 +35,9 @@
 #include <strong_type/type.hpp>
 
 #include "Logger.hpp"
+#include "gpu_profiler.hpp"
 #include "macros.hpp"
+#include "profiler.hpp"
 #include "setup.hpp"
 #include "types.hpp"
 
@@ -45,6 +52,7 @@ bool submit_present_image_cmd(
 	types::VulkanImageIdx const image_idx,
 	types::VulkanSemaphorePtr const & wait_semaphore)
 {
+	PROFILE_FUNCTION();
 	VkSwapchainKHR swapchain_handle = swapchain.get();
 	VkSemaphore wait_semaphore_handle = wait_semaphore.get();
 
@@ -68,12 +76,97 @@ bool submit_present_image_cmd(
 	return true;
 }
 
+std::vector<bool> submit_present_images_cmd(
+	VkQueue queue,
+	std::span<types::VulkanSwapchainPtr const> const swapchains,
+	std::span<types::VulkanImageIdx const> const image_idxs,
+	types::VulkanSemaphorePtr const & wait_semaphore)
+{
+	PROFILE_FUNCTION();
+	if (swapchains.size() != image_idxs.size())
+		throw std::invalid_argument{"Swapchain and image index counts differ"};
+
+	std::vector<VkSwapchainKHR> const swapchain_handles =
+		swapchains |
+		std::views::transform([](auto const & swapchain) { return swapchain.get(); }) |
+		ranges::to<std::vector>();
+	std::vector<uint32_t> const image_idx_values =
+		image_idxs |
+		std::views::transform([](auto const & image_idx) { return image_idx.value_of(); }) |
+		ranges::to<std::vector>();
+	std::vector<VkResult> results(swapchains.size(), VK_SUCCESS);
+	VkSemaphore wait_semaphore_handle = wait_semaphore.get();
+
+	VkPresentInfoKHR const present_info{
+		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+		.pNext = nullptr,
+		.waitSemaphoreCount = static_cast<uint32_t>(wait_semaphore_handle != nullptr),
+		.pWaitSemaphores = &wait_semaphore_handle,
+		.swapchainCount = static_cast<uint32_t>(swapchain_handles.size()),
+		.pSwapchains = swapchain_handles.data(),
+		.pImageIndices = image_idx_values.data(),
+		.pResults = results.data()};
+
+	// Overall result is that of the worst swapchain, so check each swapchain's instead.
+	VkResult const result = vkQueuePresentKHR(queue, &present_info);
+	if (result != VK_SUCCESS && result != VK_ERROR_OUT_OF_DATE_KHR && result != VK_SUBOPTIMAL_KHR)
+		throw std::runtime_error{
+			std::format("Failed to present images: {}", string_VkResult(result))};
+
+	std::vector<bool> presented;
+	presented.reserve(results.size());
+	for (VkResult const swapchain_result : results)
+	{
+		if (swapchain_result != VK_SUCCESS && swapchain_result != VK_ERROR_OUT_OF_DATE_KHR &&
+			swapchain_result != VK_SUBOPTIMAL_KHR)
+			throw std::runtime_error{
+				std::format("Failed to present image: {}", string_VkResult(swapchain_result))};
+		presented.push_back(swapchain_result == VK_SUCCESS);
+	}
+	return presented;
+}
+
+void submit_command_buffers(
+	VkQueue queue,
+	std::span<VkCommandBuffer const> const command_buffers,
+	std::span<types::VulkanSemaphorePtr const> const wait_semaphores,
+	types::VulkanSemaphorePtr const & signal_semaphore,
+	types::VulkanFencePtr const & fence)
+{
+	PROFILE_FUNCTION();
+	std::vector<VkSemaphore> const wait_semaphore_handles =
+		wait_semaphores |
+		std::views::transform([](auto const & semaphore) { return semaphore.get(); }) |
+		ranges::to<std::vector>();
+	// Every acquired image is first written as a colour attachment.
+	std::vector<VkPipelineStageFlags> const wait_dst_stages(
+		wait_semaphore_handles.size(), VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+	VkSemaphore signal_semaphore_handle = signal_semaphore.get();
+
+	VkSubmitInfo const submit_info{
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = nullptr,
+		.waitSemaphoreCount = static_cast<uint32_t>(wait_semaphore_handles.size()),
+		.pWaitSemaphores = wait_semaphore_handles.data(),
+		.pWaitDstStageMask = wait_dst_stages.data(),
+		.commandBufferCount = static_cast<uint32_t>(command_buffers.size()),
+		.pCommandBuffers = command_buffers.data(),
+		.signalSemaphoreCount = static_cast<uint32_t>(signal_semaphore_handle != nullptr),
+		.pSignalSemaphores = &signal_semaphore_handle};
+
+	VK_CHECK(
+		vkQueueSubmit(queue, 1, &submit_info, fence.get()),
+		"Failed to submit command buffers to queue");
+}
+
 void submit_command_buffer(
 	VkQueue queue,
 	VkCommandBuffer command_buffer,
 	types::VulkanSemaphorePtr const & wait_semaphore,
-	types::VulkanSemaphorePtr const & signal_semaphore)
+	types::VulkanSemaphorePtr const & signal_semaphore,
+	types::VulkanFencePtr const & fence)
 {
+	PROFILE_FUNCTION();
 	// Pipeline stage(s) to associate with wait_semaphore. Ensure dependent operations do not
 	// start at this stage of the pipeline until the semaphore is signaled.
 	constexpr VkPipelineStageFlags wait_dst_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
@@ -94,7 +187,69 @@ void submit_command_buffer(
 		.pSignalSemaphores = &signal_semaphore_handle};
 
 	VK_CHECK(
-		vkQueueSubmit(queue, 1, &submit_info, nullptr), "Failed to submit command buffer to queue");
+		vkQueueSubmit(queue, 1, &submit_info, fence.get()),
+		"Failed to submit command buffer to queue");
+}
+
+std::tuple<types::VulkanBufferPtr, types::VulkanDeviceMemoryPtr, std::span<std::byte>>
+create_exclusive_mapped_buffer_and_memory(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx const memory_type_idx,
+	VkDeviceSize const size,
+	VkBufferUsageFlags const usage)
+{
+	PROFILE_FUNCTION();
+	types::VulkanBufferPtr buffer = [&]
+	{
+		VkBufferCreateInfo const buffer_create_info{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.flags = 0,
+			.size = size,
+			.usage = usage,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		};
+
+		VkBuffer out = nullptr;
+		VK_CHECK(
+			vkCreateBuffer(device.get(), &buffer_create_info, nullptr, &out),
+			"Failed to create buffer");
+
+		return types::make_buffer_ptr(device, out);
+	}();
+
+	VkMemoryRequirements memory_requirements;
+	vkGetBufferMemoryRequirements(device.get(), buffer.get(), &memory_requirements);
+
+	types::VulkanDeviceMemoryPtr memory = [&]
+	{
+		VkMemoryAllocateInfo const memory_allocate_info{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.allocationSize = memory_requirements.size,
+			.memoryTypeIndex = memory_type_idx,
+		};
+
+		VkDeviceMemory out = nullptr;
+		VK_CHECK(
+			vkAllocateMemory(device.get(), &memory_allocate_info, nullptr, &out),
+			"Failed to allocate memory");
+
+		return types::make_device_memory_ptr(device, out);
+	}();
+
+	VK_CHECK(
+		vkBindBufferMemory(device.get(), buffer.get(), memory.get(), 0),
+		"Failed to bind buffer memory");
+
+	// Memory is implicitly unmapped when freed, so the mapping lives as long as `memory`.
+	void * mapped = nullptr;
+	VK_CHECK(
+		vkMapMemory(device.get(), memory.get(), 0, VK_WHOLE_SIZE, 0, &mapped),
+		"Failed to map memory");
+
+	return {
+		std::move(buffer),
+		std::move(memory),
+		std::span{static_cast<std::byte *>(mapped), static_cast<std::size_t>(size)}};
 }
 
 void populate_cmd_render_pass(
@@ -102,8 +257,11 @@ void populate_cmd_render_pass(
 	types::VulkanRenderPassPtr const & render_pass,
 	types::VulkanFramebufferPtr const & frame_buffer,
 	VkExtent2D const extent,
-	types::VulkanClearColour const & clear_colour)
+	types::VulkanClearColour const & clear_colour,
+	std::span<SubpassRecorder const> const recorders,
+	gpu_profiler::GpuProfiler * profiler)
 {
+	PROFILE_FUNCTION();
 	VkClearValue clear_value{};
 	std::ranges::copy(clear_colour.value_of(), begin(std::span(clear_value.color.float32)));
 
@@ -116,6 +274,10 @@ void populate_cmd_render_pass(
 		vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info),
 		"Failed to begin command buffer");
 
+	uint32_t const scope = profiler != nullptr
+		? profiler->begin_scope(command_buffer, "render pass")
+		: gpu_profiler::GpuProfiler::kUntimedScope;
+
 	VkRenderPassBeginInfo const render_pass_begin_info{
 		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
 		.pNext = nullptr,
@@ -136,10 +298,16 @@ void populate_cmd_render_pass(
 	VkRect2D const scissor{.offset = {0, 0}, .extent = extent};
 	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
 
+	for (SubpassRecorder const & recorder : recorders)
+		recorder(command_buffer, extent);
+
 	// End render pass e.g. transition colour attachment to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
 	// ready for presentation.
 	vkCmdEndRenderPass(command_buffer);
 
+	if (profiler != nullptr)
+		profiler->end_scope(command_buffer, scope);
+
 	VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
 }
 
@@ -148,6 +316,7 @@ std::optional<types::VulkanImageIdx> acquire_next_swapchain_image(
 	types::VulkanSwapchainPtr const & swapchain,
 	types::VulkanSemaphorePtr const & semaphore)
 {
+	PROFILE_FUNCTION();
 	types::VulkanImageIdx out{strong::uninitialized};
 	VkResult const result = vkAcquireNextImageKHR(
 		device.get(),
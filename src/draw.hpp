@@ -1,17 +1,48 @@
 // SPDX-License-Identifier: MIT
 // Copyright 2024 David Feltell
 #pragma once
+#include <cstddef>
+#include <functional>
 #include <optional>
+#include <span>
+#include <tuple>
+#include <vector>
 
 #include <vulkan/vulkan_core.h>
 
 #include "draw/detail.hpp"
+#include "gpu_profiler.hpp"
 #include "types.hpp"
 
 namespace vulkandemo::draw
 {
 using detail::create_exclusive_vertex_buffer_and_memory;
 
+/**
+ * Callback to record additional commands into the subpass of a render pass, after viewport and
+ * scissor have been set.
+ */
+using SubpassRecorder = std::function<void(VkCommandBuffer command_buffer, VkExtent2D extent)>;
+
+/**
+ * Create an exclusive buffer and memory that is left persistently mapped for the lifetime of the
+ * memory.
+ *
+ * Memory type should be host visible and, unless explicitly flushed, host coherent.
+ *
+ * @param device
+ * @param memory_type_idx
+ * @param size
+ * @param usage
+ * @return Buffer handle, memory handle and the host view of the mapped memory.
+ */
+std::tuple<types::VulkanBufferPtr, types::VulkanDeviceMemoryPtr, std::span<std::byte>>
+create_exclusive_mapped_buffer_and_memory(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx memory_type_idx,
+	VkDeviceSize size,
+	VkBufferUsageFlags usage);
+
 /**
  * Enqueue image presentation.
  *
@@ -29,6 +60,41 @@ bool submit_present_image_cmd(
 	types::VulkanImageIdx image_idx,
 	types::VulkanSemaphorePtr const & wait_semaphore);
 
+/**
+ * Enqueue presentation of an image from each of several swapchains, as a single
+ * `vkQueuePresentKHR`.
+ *
+ * Queue must support presentation to every swapchain's surface.
+ *
+ * @param queue
+ * @param swapchains
+ * @param image_idxs Image to present from each swapchain.
+ * @param wait_semaphore Waited on once before presenting any image.
+ * @return Whether each swapchain presented successfully, false if out of date or suboptimal.
+ */
+std::vector<bool> submit_present_images_cmd(
+	VkQueue queue,
+	std::span<types::VulkanSwapchainPtr const> swapchains,
+	std::span<types::VulkanImageIdx const> image_idxs,
+	types::VulkanSemaphorePtr const & wait_semaphore);
+
+/**
+ * Submit command buffers to a queue as a single batch, waiting on any number of semaphores, e.g.
+ * one per acquired swapchain image.
+ *
+ * @param queue
+ * @param command_buffers Executed in order.
+ * @param wait_semaphores Waited on at the colour attachment output stage.
+ * @param signal_semaphore
+ * @param fence Optional fence to signal once the command buffers complete.
+ */
+void submit_command_buffers(
+	VkQueue queue,
+	std::span<VkCommandBuffer const> command_buffers,
+	std::span<types::VulkanSemaphorePtr const> wait_semaphores,
+	types::VulkanSemaphorePtr const & signal_semaphore,
+	types::VulkanFencePtr const & fence = nullptr);
+
 /**
  * Submit a single command buffer to a queue, with a single wait/signal semaphore pair.
  *
@@ -36,28 +102,35 @@ bool submit_present_image_cmd(
  * @param command_buffer
  * @param wait_semaphore
  * @param signal_semaphore
+ * @param fence Optional fence to signal once the command buffer completes.
  */
 void submit_command_buffer(
 	VkQueue queue,
 	VkCommandBuffer command_buffer,
 	types::VulkanSemaphorePtr const & wait_semaphore,
-	types::VulkanSemaphorePtr const & signal_semaphore);
+	types::VulkanSemaphorePtr const & signal_semaphore,
+	types::VulkanFencePtr const & fence = nullptr);
 
 /**
- * Populate a command buffer with a render pass that simply clears the frame buffer.
+ * Populate a command buffer with a render pass that clears the frame buffer, then hands the
+ * subpass to each recorder in turn.
  *
  * @param command_buffer
  * @param render_pass
  * @param frame_buffer
  * @param extent
  * @param clear_colour
+ * @param recorders Callbacks recording draws into the subpass, in order.
+ * @param profiler Optional profiler to time the render pass with, as a scope named "render pass".
  */
 void populate_cmd_render_pass(
 	VkCommandBuffer command_buffer,
 	types::VulkanRenderPassPtr const & render_pass,
 	types::VulkanFramebufferPtr const & frame_buffer,
 	VkExtent2D extent,
-	types::VulkanClearColour const & clear_colour);
+	types::VulkanClearColour const & clear_colour,
+	std::span<SubpassRecorder const> recorders = {},
+	gpu_profiler::GpuProfiler * profiler = nullptr);
 
 /**
  * Acquire next swapchain image, returning empty optional if the swapchain is out of date and
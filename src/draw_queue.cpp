@@ -0,0 +1,577 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "draw_queue.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <range/v3/range/conversion.hpp>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner) for `logger`
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "bench.hpp"
+#include "cmd_state.hpp"
+#include "parallel.hpp"
+
+namespace vulkandemo::draw_queue
+{
+namespace
+{
+constexpr std::size_t kRadixBits = 8;
+constexpr std::size_t kRadix = std::size_t{1} << kRadixBits;
+constexpr std::size_t kPassCount = sizeof(SortKey) * 8 / kRadixBits;
+
+using Histogram = std::array<uint32_t, kRadix>;
+
+constexpr std::size_t digit_of(SortKey const key, std::size_t const pass)
+{
+	return (key >> (pass * kRadixBits)) & (kRadix - 1);
+}
+
+/**
+ * Whether a pass would reorder anything, i.e. its digit is not the same for every key.
+ *
+ * Which digits vary does not depend on order, so this is decided once up front rather than per
+ * pass.
+ */
+std::array<bool, kPassCount> passes_needed(std::span<SortItem const> const items)
+{
+	SortKey differing = 0;
+	for (SortItem const & item : items)
+		differing |= item.key ^ items.front().key;
+
+	std::array<bool, kPassCount> needed{};
+	for (std::size_t pass = 0; pass < kPassCount; ++pass)
+		needed[pass] = digit_of(differing, pass) != 0;
+	return needed;
+}
+
+/**
+ * Shared implementation of single and multi-threaded sorts.
+ *
+ * Keys are split into chunks. For each pass, every chunk's digits are counted, then prefix summed
+ * in digit-major, chunk-minor order, so each chunk scatters into its own disjoint slots of each
+ * bucket and the sort is stable regardless of which thread processes which chunk.
+ *
+ * @param for_each_chunk Callable taking `(chunk_count, fn)` invoking `fn(chunk_idx)` for every
+ * chunk.
+ */
+void radix_sort_chunked(
+	std::span<SortItem> const items,
+	std::vector<SortItem> & scratch,
+	std::size_t const chunk_size,
+	auto const & for_each_chunk)
+{
+	if (items.size() > std::numeric_limits<uint32_t>::max())
+		throw std::invalid_argument{"Too many items to radix sort"};
+
+	scratch.resize(items.size());
+	if (items.size() < 2)
+		return;
+
+	std::size_t const chunk_count = (items.size() + chunk_size - 1) / chunk_size;
+	std::vector<Histogram> offsets(chunk_count);
+	std::array<bool, kPassCount> const needed = passes_needed(items);
+
+	std::span<SortItem> src = items;
+	std::span<SortItem> dst = scratch;
+
+	for (std::size_t pass = 0; pass < kPassCount; ++pass)
+	{
+		if (!needed[pass])
+			continue;
+
+		auto const chunk_of = [&](std::size_t const chunk_idx)
+		{
+			std::size_t const begin = chunk_idx * chunk_size;
+			return src.subspan(begin, std::min(chunk_size, src.size() - begin));
+		};
+
+		for_each_chunk(
+			chunk_count,
+			[&](std::size_t const chunk_idx)
+			{
+				Histogram & counts = offsets[chunk_idx];
+				counts.fill(0);
+				for (SortItem const & item : chunk_of(chunk_idx))
+					++counts[digit_of(item.key, pass)];
+			});
+
+		// Exclusive prefix sum, turning counts into each chunk's first slot per digit.
+		uint32_t next_slot = 0;
+		for (std::size_t digit = 0; digit < kRadix; ++digit)
+			for (Histogram & chunk_offsets : offsets)
+				next_slot += std::exchange(chunk_offsets[digit], next_slot);
+
+		for_each_chunk(
+			chunk_count,
+			[&](std::size_t const chunk_idx)
+			{
+				Histogram & slots = offsets[chunk_idx];
+				for (SortItem const & item : chunk_of(chunk_idx))
+					dst[slots[digit_of(item.key, pass)]++] = item;
+			});
+
+		std::swap(src, dst);
+	}
+
+	if (src.data() != items.data())
+		std::ranges::copy(src, items.begin());
+}
+
+StateChanges count_state_changes_in(DrawQueue const & queue, auto const & packet_indices)
+{
+	StateChanges changes{.pipeline_binds = 0, .descriptor_binds = 0, .draws = 0};
+	VkPipeline bound_pipeline = nullptr;
+	VkDescriptorSet bound_material = nullptr;
+	for (uint32_t const packet_idx : packet_indices)
+	{
+		KeyFields const fields = unpack_sort_key(queue.packets[packet_idx].key);
+		VkPipeline pipeline = queue.pipelines[fields.pipeline];
+		VkDescriptorSet material = queue.materials[fields.material];
+		if (pipeline != bound_pipeline)
+		{
+			++changes.pipeline_binds;
+			bound_pipeline = pipeline;
+		}
+		if (material != nullptr && material != bound_material)
+		{
+			++changes.descriptor_binds;
+			bound_material = material;
+		}
+		++changes.draws;
+	}
+	return changes;
+}
+
+void fill_order(DrawQueue & queue)
+{
+	queue.order.resize(queue.packets.size());
+	for (std::size_t packet_idx = 0; packet_idx < queue.packets.size(); ++packet_idx)
+		queue.order[packet_idx] = SortItem{
+			.key = queue.packets[packet_idx].key, .packet_idx = static_cast<uint32_t>(packet_idx)};
+}
+}  // namespace
+
+uint32_t quantise_depth(float const depth, DepthOrder const order)
+{
+	constexpr auto kMaxDepth = static_cast<uint32_t>((uint64_t{1} << kDepthBits) - 1);
+	auto const quantised = static_cast<uint32_t>(
+		std::lround(std::clamp(depth, 0.0F, 1.0F) * static_cast<float>(kMaxDepth)));
+	return order == DepthOrder::kFrontToBack ? quantised : kMaxDepth - quantised;
+}
+
+uint16_t add_pipeline(DrawQueue & queue, VkPipeline pipeline)
+{
+	if (queue.pipelines.size() > std::numeric_limits<uint16_t>::max())
+		throw std::out_of_range{"Too many pipelines in draw queue"};
+	queue.pipelines.push_back(pipeline);
+	return static_cast<uint16_t>(queue.pipelines.size() - 1);
+}
+
+uint16_t add_material(DrawQueue & queue, VkDescriptorSet descriptor_set)
+{
+	if (queue.materials.size() > std::numeric_limits<uint16_t>::max())
+		throw std::out_of_range{"Too many materials in draw queue"};
+	queue.materials.push_back(descriptor_set);
+	return static_cast<uint16_t>(queue.materials.size() - 1);
+}
+
+void clear_draw_queue(DrawQueue & queue)
+{
+	queue.packets.clear();
+	queue.order.clear();
+}
+
+void push_draw(DrawQueue & queue, DrawPacket const & packet)
+{
+	queue.packets.push_back(packet);
+}
+
+void radix_sort(std::span<SortItem> const items, std::vector<SortItem> & scratch)
+{
+	radix_sort_chunked(
+		items,
+		scratch,
+		std::max(items.size(), std::size_t{1}),
+		[](std::size_t const chunk_count, auto const & fn)
+		{
+			for (std::size_t chunk_idx = 0; chunk_idx < chunk_count; ++chunk_idx)
+				fn(chunk_idx);
+		});
+}
+
+void radix_sort(
+	std::span<SortItem> const items, std::vector<SortItem> & scratch, parallel::ThreadPool & pool)
+{
+	radix_sort_chunked(
+		items,
+		scratch,
+		kChunkSize,
+		[&pool](std::size_t const chunk_count, auto const & fn) { pool.run(chunk_count, fn); });
+}
+
+std::span<SortItem const> sort_draw_queue(DrawQueue & queue)
+{
+	fill_order(queue);
+	radix_sort(queue.order, queue.scratch);
+	return queue.order;
+}
+
+std::span<SortItem const> sort_draw_queue(DrawQueue & queue, parallel::ThreadPool & pool)
+{
+	fill_order(queue);
+	radix_sort(queue.order, queue.scratch, pool);
+	return queue.order;
+}
+
+StateChanges count_state_changes(DrawQueue const & queue)
+{
+	return count_state_changes_in(
+		queue, std::views::iota(0U, static_cast<uint32_t>(queue.packets.size())));
+}
+
+StateChanges count_state_changes(DrawQueue const & queue, std::span<SortItem const> const order)
+{
+	return count_state_changes_in(queue, order | std::views::transform(&SortItem::packet_idx));
+}
+
+StateChanges populate_cmd_draw_queue(
+	VkCommandBuffer command_buffer, DrawQueue const & queue, VkPipelineLayout pipeline_layout)
+{
+	cmd_state::TrackedCommandBuffer tracked = cmd_state::track_command_buffer(command_buffer);
+	return populate_cmd_draw_queue(tracked, queue, pipeline_layout);
+}
+
+StateChanges populate_cmd_draw_queue(
+	cmd_state::TrackedCommandBuffer & tracked,
+	DrawQueue const & queue,
+	VkPipelineLayout pipeline_layout)
+{
+	using cmd_state::Call;
+	std::size_t const pipeline_binds_before =
+		cmd_state::counts_of(tracked, Call::kBindPipeline).emitted;
+	std::size_t const descriptor_binds_before =
+		cmd_state::counts_of(tracked, Call::kBindDescriptorSets).emitted;
+
+	for (SortItem const & item : queue.order)
+	{
+		DrawPacket const & packet = queue.packets[item.packet_idx];
+		KeyFields const fields = unpack_sort_key(packet.key);
+		cmd_state::bind_pipeline(
+			tracked, VK_PIPELINE_BIND_POINT_GRAPHICS, queue.pipelines[fields.pipeline]);
+		VkDescriptorSet material = queue.materials[fields.material];
+		if (material != nullptr)
+		{
+			cmd_state::bind_descriptor_sets(
+				tracked,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipeline_layout,
+				0,
+				std::span{&material, 1});
+		}
+		vkCmdDraw(
+			tracked.command_buffer,
+			packet.vertex_count,
+			packet.instance_count,
+			packet.first_vertex,
+			packet.first_instance);
+	}
+
+	return StateChanges{
+		.pipeline_binds =
+			cmd_state::counts_of(tracked, Call::kBindPipeline).emitted - pipeline_binds_before,
+		.descriptor_binds = cmd_state::counts_of(tracked, Call::kBindDescriptorSets).emitted -
+			descriptor_binds_before,
+		.draws = queue.order.size()};
+}
+
+namespace
+{
+/**
+ * Queue of random packets over a fixed set of fake pipelines and materials.
+ */
+DrawQueue make_random_queue(std::size_t const packet_count)
+{
+	constexpr std::size_t kPipelineCount = 32;
+	constexpr std::size_t kMaterialCount = 512;
+
+	DrawQueue queue;
+	// Fake handles, only compared, never dereferenced.
+	// NOLINTBEGIN(*-reinterpret-cast, performance-no-int-to-ptr)
+	for (std::size_t pipeline_idx = 0; pipeline_idx < kPipelineCount; ++pipeline_idx)
+		add_pipeline(queue, reinterpret_cast<VkPipeline>(pipeline_idx + 1));
+	for (std::size_t material_idx = 0; material_idx < kMaterialCount; ++material_idx)
+		add_material(queue, reinterpret_cast<VkDescriptorSet>(material_idx + 1));
+	// NOLINTEND(*-reinterpret-cast, performance-no-int-to-ptr)
+
+	std::mt19937 rng{42};  // NOLINT(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+	std::uniform_int_distribution<uint32_t> layer_dist{0, 2};
+	std::uniform_int_distribution<uint32_t> pipeline_dist{0, kPipelineCount - 1};
+	std::uniform_int_distribution<uint32_t> material_dist{0, kMaterialCount - 1};
+	std::uniform_real_distribution<float> depth_dist{0.0F, 1.0F};
+
+	queue.packets.reserve(packet_count);
+	for (std::size_t packet_idx = 0; packet_idx < packet_count; ++packet_idx)
+	{
+		auto const layer = static_cast<uint8_t>(layer_dist(rng));
+		push_draw(
+			queue,
+			DrawPacket{
+				.key = make_sort_key(
+					{.layer = layer,
+					 .pipeline = static_cast<uint16_t>(pipeline_dist(rng)),
+					 .material = static_cast<uint16_t>(material_dist(rng)),
+					 .depth = quantise_depth(
+						 depth_dist(rng),
+						 layer == 1 ? DepthOrder::kBackToFront : DepthOrder::kFrontToBack)}),
+				.vertex_count = 4,
+				.instance_count = 1,
+				.first_vertex = 0,
+				.first_instance = static_cast<uint32_t>(packet_idx)});
+	}
+	return queue;
+}
+}  // namespace
+
+TEST_CASE("Pack draw sort keys")
+{
+	KeyFields const fields{
+		.layer = 0xAB, .pipeline = 0x1234, .material = 0x5678, .depth = 0x9ABCDE};
+	SortKey const key = make_sort_key(fields);
+
+	CHECK(key == 0xAB12'3456'789A'BCDEULL);
+	KeyFields const unpacked = unpack_sort_key(key);
+	CHECK(unpacked.layer == fields.layer);
+	CHECK(unpacked.pipeline == fields.pipeline);
+	CHECK(unpacked.material == fields.material);
+	CHECK(unpacked.depth == fields.depth);
+
+	// Depth beyond its field does not leak into the material.
+	CHECK(unpack_sort_key(make_sort_key({.layer = 0, .pipeline = 0, .material = 1, .depth = ~0U}))
+			  .material == 1);
+
+	// Fields are ordered by significance.
+	CHECK(
+		make_sort_key({.layer = 1, .pipeline = 0, .material = 0, .depth = 0}) >
+		make_sort_key({.layer = 0, .pipeline = 0xFFFF, .material = 0xFFFF, .depth = 0xFFFFFF}));
+	CHECK(
+		make_sort_key({.layer = 0, .pipeline = 1, .material = 0, .depth = 0}) >
+		make_sort_key({.layer = 0, .pipeline = 0, .material = 0xFFFF, .depth = 0xFFFFFF}));
+
+	CHECK(quantise_depth(0.0F, DepthOrder::kFrontToBack) == 0);
+	CHECK(quantise_depth(1.0F, DepthOrder::kFrontToBack) == 0xFFFFFF);
+	CHECK(quantise_depth(2.0F, DepthOrder::kFrontToBack) == 0xFFFFFF);
+	CHECK(quantise_depth(-1.0F, DepthOrder::kFrontToBack) == 0);
+	CHECK(quantise_depth(0.0F, DepthOrder::kBackToFront) == 0xFFFFFF);
+	CHECK(
+		quantise_depth(0.25F, DepthOrder::kFrontToBack) <
+		quantise_depth(0.5F, DepthOrder::kFrontToBack));
+	CHECK(
+		quantise_depth(0.25F, DepthOrder::kBackToFront) >
+		quantise_depth(0.5F, DepthOrder::kBackToFront));
+}
+
+TEST_CASE("Radix sort draw packets")
+{
+	std::mt19937 rng{42};  // NOLINT(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+
+	// Few distinct keys, so stability is exercised, spread over every byte.
+	auto const make_items = [&](std::size_t const count)
+	{
+		std::uniform_int_distribution<uint64_t> key_dist{0, 63};
+		std::vector<SortItem> items(count);
+		for (std::size_t item_idx = 0; item_idx < count; ++item_idx)
+		{
+			uint64_t const digits = key_dist(rng);
+			items[item_idx] = SortItem{
+				.key = digits * 0x0101'0101'0101'0101ULL ^ (digits << 60U),
+				.packet_idx = static_cast<uint32_t>(item_idx)};
+		}
+		return items;
+	};
+
+	auto const expected_order = [](std::vector<SortItem> items)
+	{
+		std::ranges::stable_sort(items, {}, &SortItem::key);
+		return items;
+	};
+
+	auto const check_sorted = [](std::span<SortItem const> const actual,
+								 std::span<SortItem const> const expected)
+	{
+		REQUIRE(actual.size() == expected.size());
+		for (std::size_t item_idx = 0; item_idx < actual.size(); ++item_idx)
+		{
+			CAPTURE(item_idx);
+			CHECK(actual[item_idx].key == expected[item_idx].key);
+			CHECK(actual[item_idx].packet_idx == expected[item_idx].packet_idx);
+		}
+	};
+
+	std::vector<SortItem> scratch;
+
+	SUBCASE("single threaded")
+	{
+		for (std::size_t const count : {0UZ, 1UZ, 2UZ, 1000UZ})
+		{
+			CAPTURE(count);
+			std::vector<SortItem> items = make_items(count);
+			std::vector<SortItem> const expected = expected_order(items);
+			radix_sort(items, scratch);
+			check_sorted(items, expected);
+		}
+	}
+
+	SUBCASE("multi-threaded")
+	{
+		parallel::ThreadPool pool{3};
+		// Not a multiple of the chunk size, so the final chunk is partial.
+		for (std::size_t const count : {1000UZ, kChunkSize * 5 + 17})
+		{
+			CAPTURE(count);
+			std::vector<SortItem> items = make_items(count);
+			std::vector<SortItem> const expected = expected_order(items);
+			radix_sort(items, scratch, pool);
+			check_sorted(items, expected);
+		}
+	}
+
+	SUBCASE("identical keys")
+	{
+		std::vector<SortItem> items(100, SortItem{.key = 42, .packet_idx = 0});
+		for (std::size_t item_idx = 0; item_idx < items.size(); ++item_idx)
+			items[item_idx].packet_idx = static_cast<uint32_t>(item_idx);
+		std::vector<SortItem> const expected = items;
+		radix_sort(items, scratch);
+		check_sorted(items, expected);
+	}
+}
+
+TEST_CASE("Sort a draw queue to minimise state changes")
+{
+	DrawQueue queue;
+	// Fake handles, only compared, never dereferenced.
+	// NOLINTBEGIN(*-reinterpret-cast, performance-no-int-to-ptr)
+	uint16_t const pipeline_a = add_pipeline(queue, reinterpret_cast<VkPipeline>(0x1));
+	uint16_t const pipeline_b = add_pipeline(queue, reinterpret_cast<VkPipeline>(0x2));
+	uint16_t const untextured = add_material(queue, nullptr);
+	uint16_t const texture_a = add_material(queue, reinterpret_cast<VkDescriptorSet>(0x10));
+	uint16_t const texture_b = add_material(queue, reinterpret_cast<VkDescriptorSet>(0x20));
+	// NOLINTEND(*-reinterpret-cast, performance-no-int-to-ptr)
+
+	auto const push = [&](uint8_t const layer,
+						  uint16_t const pipeline,
+						  uint16_t const material,
+						  float const depth,
+						  uint32_t const id)
+	{
+		push_draw(
+			queue,
+			DrawPacket{
+				.key = make_sort_key(
+					{.layer = layer,
+					 .pipeline = pipeline,
+					 .material = material,
+					 .depth = quantise_depth(depth, DepthOrder::kFrontToBack)}),
+				.vertex_count = 4,
+				.instance_count = 1,
+				.first_vertex = 0,
+				.first_instance = id});
+	};
+
+	push(0, pipeline_a, texture_a, 0.5F, 0);
+	push(0, pipeline_b, untextured, 0.5F, 1);
+	push(0, pipeline_a, texture_a, 0.25F, 2);
+	push(1, pipeline_a, untextured, 0.1F, 3);
+	push(0, pipeline_b, untextured, 0.75F, 4);
+	push(0, pipeline_a, texture_b, 0.0F, 5);
+
+	StateChanges const unsorted = count_state_changes(queue);
+	CHECK(unsorted.pipeline_binds == 5);
+	CHECK(unsorted.descriptor_binds == 2);
+	CHECK(unsorted.draws == 6);
+
+	std::span<SortItem const> const order = sort_draw_queue(queue);
+
+	std::vector<uint32_t> const ids = order |
+		std::views::transform([&](SortItem const & item)
+							  { return queue.packets[item.packet_idx].first_instance; }) |
+		ranges::to<std::vector>();
+	CHECK(ids == std::vector<uint32_t>{2, 0, 5, 1, 4, 3});
+
+	StateChanges const sorted = count_state_changes(queue, order);
+	CHECK(sorted.pipeline_binds == 3);
+	CHECK(sorted.descriptor_binds == 2);
+	CHECK(sorted.draws == 6);
+
+	clear_draw_queue(queue);
+	CHECK(queue.packets.empty());
+	CHECK(queue.pipelines.size() == 2);
+	CHECK(sort_draw_queue(queue).empty());
+}
+
+TEST_CASE("Benchmark draw sorting" * doctest::test_suite("benchmark") * doctest::skip())
+{
+	LoggerPtr const logger = create_logger("Benchmark draw sorting");
+	parallel::ThreadPool pool;
+	logger->info("Sorting with {} threads", pool.thread_count());
+
+	for (std::size_t const packet_count : {10'000UZ, 100'000UZ, 1'000'000UZ})
+	{
+		DrawQueue queue = make_random_queue(packet_count);
+		constexpr std::size_t iterations = 20;
+
+		double const std_sort_ms = bench::mean_ms(
+			iterations,
+			[&]
+			{
+				fill_order(queue);
+				std::ranges::sort(queue.order, {}, &SortItem::key);
+			});
+		double const single_ms = bench::mean_ms(iterations, [&] { sort_draw_queue(queue); });
+		double const parallel_ms =
+			bench::mean_ms(iterations, [&] { sort_draw_queue(queue, pool); });
+
+		StateChanges const unsorted = count_state_changes(queue);
+		StateChanges const sorted = count_state_changes(queue, queue.order);
+
+		logger->info(
+			"{} draws: std::sort {:.3f} ms, radix {:.3f} ms ({:.1f}x), parallel radix {:.3f} ms "
+			"({:.1f}x)",
+			packet_count,
+			std_sort_ms,
+			single_ms,
+			std_sort_ms / single_ms,
+			parallel_ms,
+			std_sort_ms / parallel_ms);
+		logger->info(
+			"{} draws: unsorted {} pipeline + {} descriptor binds, sorted {} + {}",
+			packet_count,
+			unsorted.pipeline_binds,
+			unsorted.descriptor_binds,
+			sorted.pipeline_binds,
+			sorted.descriptor_binds);
+	}
+}
+}  // namespace vulkandemo::draw_queue
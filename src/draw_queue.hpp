@@ -0,0 +1,261 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "cmd_state.hpp"
+#include "parallel.hpp"
+
+/**
+ * Draw packets sorted by packed 64-bit keys before recording.
+ *
+ * Each draw carries a key packing, from most to least significant, its layer, pipeline, material
+ * and quantised depth. Sorting by key groups draws by pipeline then material within each layer, so
+ * recording binds each only once per run, and orders draws sharing both by depth.
+ *
+ * Keys are sorted with a least significant digit radix sort, one pass per byte, skipping bytes that
+ * are equal across all keys. Each pass histograms then scatters contiguous chunks of keys, so both
+ * halves parallelise across a thread pool whilst keeping the sort stable.
+ */
+namespace vulkandemo::draw_queue
+{
+/// Number of keys histogrammed or scattered per parallel task.
+inline constexpr std::size_t kChunkSize = 16384;
+
+/// Width of each key field, most significant first.
+inline constexpr uint32_t kLayerBits = 8;
+inline constexpr uint32_t kPipelineBits = 16;
+inline constexpr uint32_t kMaterialBits = 16;
+inline constexpr uint32_t kDepthBits = 24;
+static_assert(kLayerBits + kPipelineBits + kMaterialBits + kDepthBits == 64);
+
+using SortKey = uint64_t;
+
+enum class DepthOrder : uint8_t
+{
+	/// Nearest first, e.g. for opaque draws to maximise early depth rejection.
+	kFrontToBack,
+	/// Farthest first, e.g. for blended draws.
+	kBackToFront
+};
+
+struct KeyFields
+{
+	/// Coarse ordering, e.g. opaque, transparent, overlay.
+	uint8_t layer;
+	/// Index into DrawQueue::pipelines.
+	uint16_t pipeline;
+	/// Index into DrawQueue::materials.
+	uint16_t material;
+	/// Quantised depth, see quantise_depth. Only the low kDepthBits are used.
+	uint32_t depth;
+};
+
+/**
+ * Non-indexed draw, recorded as `vkCmdDraw` with the pipeline and material of its key.
+ */
+struct DrawPacket
+{
+	SortKey key;
+	uint32_t vertex_count;
+	uint32_t instance_count;
+	uint32_t first_vertex;
+	uint32_t first_instance;
+};
+static_assert(sizeof(DrawPacket) == 24);
+
+/**
+ * Element of a sorted order: a key plus the index of the packet it came from.
+ */
+struct SortItem
+{
+	SortKey key;
+	uint32_t packet_idx;
+};
+
+/**
+ * Binds and draws needed to record packets in a given order.
+ */
+struct StateChanges
+{
+	std::size_t pipeline_binds;
+	std::size_t descriptor_binds;
+	std::size_t draws;
+};
+
+/**
+ * Packets of a frame in submission order, plus the state tables their keys index into.
+ */
+struct DrawQueue
+{
+	/// Indexed by KeyFields::pipeline. Persists across frames.
+	std::vector<VkPipeline> pipelines;
+	/// Descriptor set bound to set 0, or nullptr for none, indexed by KeyFields::material.
+	/// Persists across frames.
+	std::vector<VkDescriptorSet> materials;
+	/// Packets in submission order.
+	std::vector<DrawPacket> packets;
+	/// Sorted order of packets, as of the last sort_draw_queue.
+	std::vector<SortItem> order;
+	/// Scratch space for sorting, reused across frames.
+	std::vector<SortItem> scratch;
+};
+
+/**
+ * Pack key fields so that keys order by layer, then pipeline, then material, then depth.
+ *
+ * @param fields
+ * @return
+ */
+constexpr SortKey make_sort_key(KeyFields const & fields)
+{
+	constexpr uint64_t kDepthMask = (uint64_t{1} << kDepthBits) - 1;
+	return (uint64_t{fields.layer} << (kPipelineBits + kMaterialBits + kDepthBits)) |
+		(uint64_t{fields.pipeline} << (kMaterialBits + kDepthBits)) |
+		(uint64_t{fields.material} << kDepthBits) | (fields.depth & kDepthMask);
+}
+
+/**
+ * Unpack the fields of a key.
+ *
+ * @param key
+ * @return
+ */
+constexpr KeyFields unpack_sort_key(SortKey const key)
+{
+	return KeyFields{
+		.layer = static_cast<uint8_t>(key >> (kPipelineBits + kMaterialBits + kDepthBits)),
+		.pipeline = static_cast<uint16_t>(key >> (kMaterialBits + kDepthBits)),
+		.material = static_cast<uint16_t>(key >> kDepthBits),
+		.depth = static_cast<uint32_t>(key & ((uint64_t{1} << kDepthBits) - 1))};
+}
+
+/**
+ * Quantise a normalised depth to the depth field of a key.
+ *
+ * @param depth In [0, 1], nearest at 0. Clamped.
+ * @param order
+ * @return
+ */
+uint32_t quantise_depth(float depth, DepthOrder order);
+
+/**
+ * Register a pipeline for use by keys.
+ *
+ * @param queue
+ * @param pipeline
+ * @return Index for KeyFields::pipeline.
+ */
+uint16_t add_pipeline(DrawQueue & queue, VkPipeline pipeline);
+
+/**
+ * Register a descriptor set for use by keys.
+ *
+ * @param queue
+ * @param descriptor_set Bound to set 0, or nullptr to bind nothing.
+ * @return Index for KeyFields::material.
+ */
+uint16_t add_material(DrawQueue & queue, VkDescriptorSet descriptor_set);
+
+/**
+ * Discard all packets, ready for a new frame. Registered pipelines and materials are kept.
+ *
+ * @param queue
+ */
+void clear_draw_queue(DrawQueue & queue);
+
+/**
+ * Append a packet.
+ *
+ * @param queue
+ * @param packet Its key's pipeline and material must have been registered.
+ */
+void push_draw(DrawQueue & queue, DrawPacket const & packet);
+
+/**
+ * Stable sort of items by key on the calling thread.
+ *
+ * @param items Sorted in place.
+ * @param scratch Resized to the size of @p items.
+ */
+void radix_sort(std::span<SortItem> items, std::vector<SortItem> & scratch);
+
+/**
+ * Stable sort of items by key, in chunks of kChunkSize across a thread pool.
+ *
+ * @param items Sorted in place.
+ * @param scratch Resized to the size of @p items.
+ * @param pool
+ */
+void radix_sort(
+	std::span<SortItem> items, std::vector<SortItem> & scratch, parallel::ThreadPool & pool);
+
+/**
+ * Sort the queue's packets by key on the calling thread.
+ *
+ * @param queue
+ * @return The sorted order, also stored in DrawQueue::order.
+ */
+std::span<SortItem const> sort_draw_queue(DrawQueue & queue);
+
+/**
+ * Sort the queue's packets by key across a thread pool.
+ *
+ * @param queue
+ * @param pool
+ * @return The sorted order, also stored in DrawQueue::order.
+ */
+std::span<SortItem const> sort_draw_queue(DrawQueue & queue, parallel::ThreadPool & pool);
+
+/**
+ * Count the binds and draws that recording packets in submission order would need.
+ *
+ * @param queue
+ * @return
+ */
+StateChanges count_state_changes(DrawQueue const & queue);
+
+/**
+ * Count the binds and draws that recording packets in a given order would need.
+ *
+ * @param queue
+ * @param order E.g. the result of sort_draw_queue.
+ * @return
+ */
+StateChanges count_state_changes(DrawQueue const & queue, std::span<SortItem const> order);
+
+/**
+ * Record the queue's packets in sorted order, binding pipelines and materials only on change.
+ *
+ * Must be recorded within a render pass or rendering scope compatible with the pipelines, e.g. by
+ * a draw::SubpassRecorder. Any push constants and vertex buffers must already be bound.
+ *
+ * @param command_buffer
+ * @param queue Sorted by sort_draw_queue.
+ * @param pipeline_layout Layout compatible with all registered pipelines.
+ * @return Binds and draws recorded.
+ */
+StateChanges populate_cmd_draw_queue(
+	VkCommandBuffer command_buffer, DrawQueue const & queue, VkPipelineLayout pipeline_layout);
+
+/**
+ * Record the queue's packets in sorted order through a state tracker.
+ *
+ * As above, but binds are also elided against state already bound through @p tracked, e.g. by a
+ * previous queue recorded into the same command buffer.
+ *
+ * @param tracked
+ * @param queue Sorted by sort_draw_queue.
+ * @param pipeline_layout Layout compatible with all registered pipelines.
+ * @return Binds and draws recorded.
+ */
+StateChanges populate_cmd_draw_queue(
+	cmd_state::TrackedCommandBuffer & tracked,
+	DrawQueue const & queue,
+	VkPipelineLayout pipeline_layout);
+}  // namespace vulkandemo::draw_queue
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#include "frustum.hpp"
+
+#include <array>
+
+#include <doctest/doctest.h>
+
+#include "maths.hpp"
+
+namespace vulkandemo::frustum
+{
+Frustum extract_planes(maths::Mat4 const & view_projection)
+{
+	// Gribb-Hartmann: combinations of matrix rows give the clip planes.
+	auto const & [row_x, row_y, row_z, row_w] = maths::transpose(view_projection).columns;
+	auto const normalise = [](maths::Vec4 const & plane)
+	{
+		float const length = maths::length(maths::to_vec3(plane));
+		return Plane{plane.x / length, plane.y / length, plane.z / length, plane.w / length};
+	};
+
+	return Frustum{
+		normalise(row_w + row_x),
+		normalise(row_w - row_x),
+		normalise(row_w + row_y),
+		normalise(row_w - row_y),
+		// Vulkan clip space near plane is z = 0, rather than z = -w.
+		normalise(row_z),
+		normalise(row_w - row_z)};
+}
+
+bool intersects_sphere(
+	Frustum const & frustum, std::array<float, 3> const & centre, float const radius)
+{
+	for (Plane const & plane : frustum)
+	{
+		float const distance =
+			plane[0] * centre[0] + plane[1] * centre[1] + plane[2] * centre[2] + plane[3];
+		if (distance < -radius)
+			return false;
+	}
+	return true;
+}
+
+TEST_CASE("Extract frustum planes")
+{
+	// Orthographic projection of the box x,y in [-1, 1], z in [0, 1], i.e. identity.
+	Frustum const frustum = extract_planes(maths::kIdentity);
+
+	CHECK(frustum[0] == Plane{1, 0, 0, 1});
+	CHECK(frustum[1] == Plane{-1, 0, 0, 1});
+	CHECK(frustum[4] == Plane{0, 0, 1, 0});
+	CHECK(frustum[5] == Plane{0, 0, -1, 1});
+
+	CHECK(intersects_sphere(frustum, {0, 0, 0.5F}, 0.1F));
+	// Straddling the right plane.
+	CHECK(intersects_sphere(frustum, {1.05F, 0, 0.5F}, 0.1F));
+	CHECK(!intersects_sphere(frustum, {1.2F, 0, 0.5F}, 0.1F));
+	// Behind the near plane.
+	CHECK(!intersects_sphere(frustum, {0, 0, -0.2F}, 0.1F));
+	// Beyond the far plane.
+	CHECK(!intersects_sphere(frustum, {0, 0, 1.2F}, 0.1F));
+
+	SUBCASE("translated")
+	{
+		// Translate world by -10 in x, so the visible box is x in [9, 11].
+		Frustum const translated_frustum = extract_planes(maths::translation({-10, 0, 0}));
+		CHECK(intersects_sphere(translated_frustum, {10, 0, 0.5F}, 0.1F));
+		CHECK(!intersects_sphere(translated_frustum, {0, 0, 0.5F}, 0.1F));
+	}
+}
+}  // namespace vulkandemo::frustum
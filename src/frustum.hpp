@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+
+#include "maths.hpp"
+
+/**
+ * View frustum representation shared by CPU and GPU culling.
+ */
+namespace vulkandemo::frustum
+{
+/// Plane (a, b, c, d) such that a*x + b*y + c*z + d >= 0 for points on the inner side.
+using Plane = std::array<float, 4>;
+
+/// Planes in order left, right, bottom, top, near, far, each facing inwards.
+using Frustum = std::array<Plane, 6>;
+
+/**
+ * Extract normalised frustum planes from a view-projection matrix.
+ *
+ * Assumes Vulkan clip space conventions, i.e. 0 <= z <= w.
+ *
+ * @param view_projection Column-major matrix mapping world space to clip space.
+ * @return
+ */
+Frustum extract_planes(maths::Mat4 const & view_projection);
+
+/**
+ * Check whether a sphere is at least partially on the inner side of all planes.
+ *
+ * @param frustum
+ * @param centre
+ * @param radius
+ * @return
+ */
+bool intersects_sphere(Frustum const & frustum, std::array<float, 3> const & centre, float radius);
+}  // namespace vulkandemo::frustum
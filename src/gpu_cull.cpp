@@ -0,0 +1,662 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "gpu_cull.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <range/v3/range/conversion.hpp>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner)
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `VK_CHECK`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "barrier.hpp"
+#include "batch.hpp"
+#include "bench.hpp"
+#include "compute.hpp"
+#include "draw.hpp"
+#include "frustum.hpp"
+#include "macros.hpp"
+#include "maths.hpp"
+#include "render_graph.hpp"
+#include "setup.hpp"
+#include "shaders.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::gpu_cull
+{
+namespace
+{
+/// Push constants of `gpu_cull.comp`.
+struct PushConstants
+{
+	frustum::Frustum planes;
+	uint32_t object_count;
+	uint32_t compact;
+};
+static_assert(sizeof(PushConstants) == 104);
+}  // namespace
+
+bool supports_draw_indirect_count(VkPhysicalDevice physical_device)
+{
+	return setup::query_vulkan12_features(physical_device).drawIndirectCount == VK_TRUE;
+}
+
+compute::ComputeKernel create_gpu_cull_kernel(types::VulkanDevicePtr const & device)
+{
+	// Bounds, draw records, commands and count, see gpu_cull.comp.
+	constexpr std::array<compute::BindingType, 4> bindings{
+		compute::BindingType::kStorageBuffer,
+		compute::BindingType::kStorageBuffer,
+		compute::BindingType::kStorageBuffer,
+		compute::BindingType::kStorageBuffer};
+
+	return compute::create_compute_kernel(
+		device, shaders::kGpuCullComp, bindings, sizeof(PushConstants), {kWorkGroupSize, 1, 1});
+}
+
+GpuCullBuffers create_gpu_cull_buffers(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx const memory_type_idx,
+	compute::ComputeKernel const & kernel,
+	ObjectCount const capacity,
+	bool const compact)
+{
+	auto [bounds_buffer, bounds_memory, bounds] =
+		compute::create_mapped_storage_buffer<ObjectBounds>(device, memory_type_idx, capacity, 0);
+	auto [draws_buffer, draws_memory, draws] =
+		compute::create_mapped_storage_buffer<DrawRecord>(device, memory_type_idx, capacity, 0);
+	auto [commands_buffer, commands_memory, commands] =
+		compute::create_mapped_storage_buffer<VkDrawIndexedIndirectCommand>(
+			device, memory_type_idx, capacity, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+	auto [count_buffer, count_memory, count] = compute::create_mapped_storage_buffer<uint32_t>(
+		device,
+		memory_type_idx,
+		1,
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+	std::array const bindings{
+		compute::Binding{compute::StorageBuffer{.buffer = bounds_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = draws_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = commands_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = count_buffer.get()}}};
+	compute::ComputeBindings compute_bindings =
+		compute::create_compute_bindings(device, kernel, bindings);
+
+	return GpuCullBuffers{
+		.bounds_buffer = std::move(bounds_buffer),
+		.bounds_memory = std::move(bounds_memory),
+		.bounds = bounds,
+		.draws_buffer = std::move(draws_buffer),
+		.draws_memory = std::move(draws_memory),
+		.draws = draws,
+		.commands_buffer = std::move(commands_buffer),
+		.commands_memory = std::move(commands_memory),
+		.commands = commands,
+		.count_buffer = std::move(count_buffer),
+		.count_memory = std::move(count_memory),
+		.count = count,
+		.bindings = std::move(compute_bindings),
+		.compact = compact};
+}
+
+void populate_cmd_gpu_cull(
+	VkCommandBuffer command_buffer,
+	compute::ComputeKernel const & kernel,
+	GpuCullBuffers const & buffers,
+	frustum::Frustum const & frustum,
+	ObjectCount const object_count)
+{
+	using render_graph::Access;
+	using render_graph::state_of;
+
+	if (buffers.compact)
+	{
+		// Previous frame's indirect draws must be done with the count before it is reset.
+		barrier::populate_cmd_memory_barrier(
+			command_buffer,
+			{.stages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+			 .access = VK_ACCESS_2_NONE,
+			 .layout = VK_IMAGE_LAYOUT_UNDEFINED},
+			state_of(Access::kTransferWrite));
+		vkCmdFillBuffer(command_buffer, buffers.count_buffer.get(), 0, sizeof(uint32_t), 0);
+	}
+
+	// Bounds and draw records are host writes made visible by submission. Commands must not be
+	// overwritten until previous indirect draws are done with them, and the outputs must be
+	// written before they are consumed by indirect draws or read back by the host.
+	std::array const buffer_uses{
+		compute::BufferUse{
+			.buffer = buffers.commands_buffer.get(),
+			.access = Access::kComputeShaderStorageWrite,
+			.before = state_of(Access::kIndirectCommandRead),
+			.after = kDrawableAndHostReadable},
+		compute::BufferUse{
+			.buffer = buffers.count_buffer.get(),
+			.access = Access::kComputeShaderStorageReadWrite,
+			.before = state_of(Access::kTransferWrite),
+			.after = kDrawableAndHostReadable}};
+
+	PushConstants const push_constants{
+		.planes = frustum,
+		.object_count = object_count,
+		.compact = static_cast<uint32_t>(buffers.compact)};
+
+	compute::populate_cmd_dispatch(
+		command_buffer,
+		kernel,
+		buffers.bindings,
+		std::as_bytes(std::span{&push_constants, 1}),
+		// The count is only written if compacting.
+		std::span{buffer_uses}.first(buffers.compact ? 2 : 1),
+		{},
+		compute::group_count_for(kernel, {object_count, 1, 1}));
+}
+
+void populate_cmd_draw_culled(
+	VkCommandBuffer command_buffer, GpuCullBuffers const & buffers, ObjectCount const object_count)
+{
+	if (buffers.compact)
+		vkCmdDrawIndexedIndirectCount(
+			command_buffer,
+			buffers.commands_buffer.get(),
+			0,
+			buffers.count_buffer.get(),
+			0,
+			object_count,
+			sizeof(VkDrawIndexedIndirectCommand));
+	else
+		vkCmdDrawIndexedIndirect(
+			command_buffer,
+			buffers.commands_buffer.get(),
+			0,
+			object_count,
+			sizeof(VkDrawIndexedIndirectCommand));
+}
+
+TEST_CASE("Cull objects on the GPU")
+{
+	vulkandemo::LoggerPtr const logger = vulkandemo::create_logger("Cull objects on the GPU");
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		nullptr,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+
+	constexpr VkMemoryPropertyFlags memory_flags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_COMPUTE_BIT,
+		memory_flags);
+
+	bool const compact = supports_draw_indirect_count(physical_device);
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE};
+	VkPhysicalDeviceVulkan12Features vulkan12_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = &vulkan13_features,
+		.drawIndirectCount = static_cast<VkBool32>(compact)};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan12_features};
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{},
+		&features);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkCommandBuffer command_buffer = command_buffers->front();
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	compute::ComputeKernel const kernel = create_gpu_cull_kernel(device);
+
+	CHECK(kernel.descriptor_set_layout);
+	CHECK(kernel.layout);
+	CHECK(kernel.pipeline);
+
+	types::VulkanMemoryTypeIdx const memory_type_idx =
+		setup::filter_available_memory_types(logger, physical_device, memory_flags).at(0);
+
+	// Identity view-projection, i.e. visible box x,y in [-1, 1], z in [0, 1].
+	frustum::Frustum const frustum = frustum::extract_planes(maths::kIdentity);
+
+	auto const cull = [&](bool const should_compact)
+	{
+		GpuCullBuffers buffers = create_gpu_cull_buffers(
+			device, memory_type_idx, kernel, ObjectCount{4}, should_compact);
+
+		std::ranges::copy(
+			std::array{
+				ObjectBounds{.centre = {0, 0, 0.5F}, .radius = 0.1F},
+				ObjectBounds{.centre = {5, 0, 0.5F}, .radius = 0.1F},
+				ObjectBounds{.centre = {1.05F, 0, 0.5F}, .radius = 0.1F},
+				ObjectBounds{.centre = {0, 0, -1}, .radius = 0.1F}},
+			buffers.bounds.begin());
+
+		for (auto && [object_id, draw] : std::views::enumerate(buffers.draws))
+			draw = DrawRecord{
+				.index_count = 3,
+				.first_index = static_cast<uint32_t>(object_id) * 3,
+				.vertex_offset = 0,
+				.object_id = static_cast<uint32_t>(object_id)};
+
+		constexpr VkCommandBufferBeginInfo begin_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+		VK_CHECK(
+			vkBeginCommandBuffer(command_buffer, &begin_info), "Failed to begin command buffer");
+		populate_cmd_gpu_cull(command_buffer, kernel, buffers, frustum, ObjectCount{4});
+		VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
+
+		draw::submit_command_buffer(queue, command_buffer, nullptr, nullptr);
+		VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+
+		return buffers;
+	};
+
+	SUBCASE("compacted")
+	{
+		if (!compact)
+		{
+			MESSAGE("Skipping compacted culling, since drawIndirectCount is not supported");
+			return;
+		}
+
+		GpuCullBuffers const buffers = cull(true);
+
+		REQUIRE(buffers.count.front() == 2);
+		std::array<uint32_t, 2> visible_ids{
+			buffers.commands[0].firstInstance, buffers.commands[1].firstInstance};
+		std::ranges::sort(visible_ids);
+		CHECK(visible_ids == std::array<uint32_t, 2>{0, 2});
+		CHECK(buffers.commands[0].instanceCount == 1);
+		CHECK(buffers.commands[0].firstIndex == buffers.commands[0].firstInstance * 3);
+	}
+
+	SUBCASE("in place")
+	{
+		GpuCullBuffers const buffers = cull(false);
+
+		std::vector<uint32_t> const instance_counts = buffers.commands |
+			std::views::transform(&VkDrawIndexedIndirectCommand::instanceCount) |
+			ranges::to<std::vector>();
+		CHECK(instance_counts == std::vector<uint32_t>{1, 0, 1, 0});
+	}
+}
+
+TEST_CASE("Draw objects culled on the GPU")
+{
+	vulkandemo::LoggerPtr const logger =
+		vulkandemo::create_logger("Draw objects culled on the GPU");
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		nullptr,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+
+	constexpr VkMemoryPropertyFlags memory_flags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT,
+		memory_flags);
+
+	bool const compact = supports_draw_indirect_count(physical_device);
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE,
+		.dynamicRendering = VK_TRUE};
+	VkPhysicalDeviceVulkan12Features vulkan12_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = &vulkan13_features,
+		.drawIndirectCount = static_cast<VkBool32>(compact)};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan12_features};
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{},
+		&features);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkCommandBuffer command_buffer = command_buffers->front();
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	types::VulkanMemoryTypeIdx const memory_type_idx =
+		setup::filter_available_memory_types(logger, physical_device, memory_flags).at(0);
+
+	constexpr VkFormat kFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	constexpr uint32_t kObjectCount = 4;
+	constexpr uint32_t kSpriteSize = 16;
+	constexpr VkExtent2D kExtent{kSpriteSize * kObjectCount, kSpriteSize};
+	constexpr VkImageSubresourceRange kColourRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+	compute::ComputeKernel const kernel = create_gpu_cull_kernel(device);
+	batch::SpritePipelines const pipelines = batch::create_sprite_pipelines(device, kFormat);
+
+	auto [target, target_memory] = setup::create_image_and_memory(
+		device,
+		physical_device,
+		kFormat,
+		kExtent,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+	types::VulkanImageViewPtr const target_view =
+		setup::create_image_view(device, target.get(), kFormat);
+
+	// One white sprite per object, each filling a column of the target.
+	std::array<batch::Instance, kObjectCount> sprites{};
+	for (auto && [object_id, sprite] : std::views::enumerate(sprites))
+		sprite = batch::make_rect_instance(
+			static_cast<float>(static_cast<uint32_t>(object_id) * kSpriteSize),
+			0,
+			static_cast<float>(kSpriteSize),
+			static_cast<float>(kSpriteSize),
+			batch::pack_colour(1, 1, 1, 1));
+	auto [sprite_buffer, sprite_memory, sprite_bytes] =
+		draw::create_exclusive_mapped_buffer_and_memory(
+			device, memory_type_idx, sizeof(sprites), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	std::ranges::copy(std::as_bytes(std::span{sprites}), sprite_bytes.begin());
+
+	// Unit quad as a triangle strip, see sprite.vert, indexed so that it can be drawn indirectly.
+	constexpr std::array<uint16_t, 4> kIndices{0, 1, 2, 3};
+	auto [index_buffer, index_memory, index_bytes] =
+		draw::create_exclusive_mapped_buffer_and_memory(
+			device, memory_type_idx, sizeof(kIndices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+	std::ranges::copy(std::as_bytes(std::span{kIndices}), index_bytes.begin());
+
+	auto [readback_buffer, readback_memory, readback_bytes] =
+		draw::create_exclusive_mapped_buffer_and_memory(
+			device,
+			memory_type_idx,
+			VkDeviceSize{kExtent.width} * kExtent.height * 4,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+	// Identity view-projection, i.e. visible box x,y in [-1, 1], z in [0, 1].
+	frustum::Frustum const frustum = frustum::extract_planes(maths::kIdentity);
+
+	auto const draw_culled = [&](bool const should_compact)
+	{
+		using render_graph::Access;
+		using render_graph::state_of;
+
+		GpuCullBuffers buffers = create_gpu_cull_buffers(
+			device, memory_type_idx, kernel, ObjectCount{kObjectCount}, should_compact);
+
+		std::ranges::copy(
+			std::array{
+				ObjectBounds{.centre = {0, 0, 0.5F}, .radius = 0.1F},
+				ObjectBounds{.centre = {5, 0, 0.5F}, .radius = 0.1F},
+				ObjectBounds{.centre = {1.05F, 0, 0.5F}, .radius = 0.1F},
+				ObjectBounds{.centre = {0, 0, -1}, .radius = 0.1F}},
+			buffers.bounds.begin());
+
+		for (auto && [object_id, draw] : std::views::enumerate(buffers.draws))
+			draw = DrawRecord{
+				.index_count = static_cast<uint32_t>(kIndices.size()),
+				.first_index = 0,
+				.vertex_offset = 0,
+				.object_id = static_cast<uint32_t>(object_id)};
+
+		constexpr VkCommandBufferBeginInfo begin_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+		VK_CHECK(
+			vkBeginCommandBuffer(command_buffer, &begin_info), "Failed to begin command buffer");
+
+		populate_cmd_gpu_cull(command_buffer, kernel, buffers, frustum, ObjectCount{kObjectCount});
+
+		barrier::populate_cmd_barriers(
+			command_buffer,
+			std::nullopt,
+			std::array{barrier::image_barrier(
+				target.get(), kColourRange, {}, state_of(Access::kColourAttachmentWrite))});
+
+		VkRenderingAttachmentInfo const colour_attachment{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+			.pNext = nullptr,
+			.imageView = target_view.get(),
+			.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.resolveMode = VK_RESOLVE_MODE_NONE,
+			.resolveImageView = nullptr,
+			.resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.clearValue = {.color = {.float32 = {0, 0, 0, 1}}}};
+		VkRenderingInfo const rendering_info{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.renderArea = {.offset = {.x = 0, .y = 0}, .extent = kExtent},
+			.layerCount = 1,
+			.viewMask = 0,
+			.colorAttachmentCount = 1,
+			.pColorAttachments = &colour_attachment,
+			.pDepthAttachment = nullptr,
+			.pStencilAttachment = nullptr};
+		vkCmdBeginRendering(command_buffer, &rendering_info);
+
+		VkViewport const viewport{
+			.x = 0,
+			.y = 0,
+			.width = static_cast<float>(kExtent.width),
+			.height = static_cast<float>(kExtent.height),
+			.minDepth = 0,
+			.maxDepth = 1};
+		vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+		VkRect2D const scissor{.offset = {0, 0}, .extent = kExtent};
+		vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.solid.get());
+		std::array const inv_half_extent{
+			2.0F / static_cast<float>(kExtent.width), 2.0F / static_cast<float>(kExtent.height)};
+		vkCmdPushConstants(
+			command_buffer,
+			pipelines.layout.get(),
+			VK_SHADER_STAGE_VERTEX_BIT,
+			0,
+			sizeof(inv_half_extent),
+			inv_half_extent.data());
+
+		// Each draw's first instance is its object ID, so selects the object's sprite.
+		VkBuffer vertex_buffer = sprite_buffer.get();
+		constexpr VkDeviceSize vertex_buffer_offset = 0;
+		vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer, &vertex_buffer_offset);
+		vkCmdBindIndexBuffer(command_buffer, index_buffer.get(), 0, VK_INDEX_TYPE_UINT16);
+
+		populate_cmd_draw_culled(command_buffer, buffers, ObjectCount{kObjectCount});
+
+		vkCmdEndRendering(command_buffer);
+
+		barrier::populate_cmd_barriers(
+			command_buffer,
+			std::nullopt,
+			std::array{barrier::image_barrier(
+				target.get(),
+				kColourRange,
+				state_of(Access::kColourAttachmentWrite),
+				state_of(Access::kTransferRead))});
+
+		VkBufferImageCopy const region{
+			.bufferOffset = 0,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+			.imageOffset = {0, 0, 0},
+			.imageExtent = {kExtent.width, kExtent.height, 1}};
+		vkCmdCopyImageToBuffer(
+			command_buffer,
+			target.get(),
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			readback_buffer.get(),
+			1,
+			&region);
+		barrier::populate_cmd_memory_barrier(
+			command_buffer, state_of(Access::kTransferWrite), state_of(Access::kHostRead));
+
+		VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
+		draw::submit_command_buffer(queue, command_buffer, nullptr, nullptr);
+		VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+
+		// Whether the centre of each object's column was drawn, judging by its red channel.
+		std::vector<bool> drawn;
+		for (uint32_t object_id = 0; object_id < kObjectCount; ++object_id)
+		{
+			std::size_t const x = object_id * kSpriteSize + kSpriteSize / 2;
+			std::size_t const y = kSpriteSize / 2;
+			drawn.push_back(readback_bytes[(y * kExtent.width + x) * 4] == std::byte{255});
+		}
+		return drawn;
+	};
+
+	SUBCASE("compacted")
+	{
+		if (!compact)
+		{
+			MESSAGE("Skipping compacted draws, since drawIndirectCount is not supported");
+			return;
+		}
+
+		CHECK(draw_culled(true) == std::vector<bool>{true, false, true, false});
+	}
+
+	SUBCASE("in place")
+	{
+		CHECK(draw_culled(false) == std::vector<bool>{true, false, true, false});
+	}
+}
+
+TEST_CASE("Benchmark GPU culling" * doctest::test_suite("benchmark") * doctest::skip())
+{
+	vulkandemo::LoggerPtr const logger = vulkandemo::create_logger("Benchmark GPU culling");
+	types::VulkanInstancePtr const instance =
+		setup::create_vulkan_instance(logger, nullptr, {}, {});
+
+	constexpr VkMemoryPropertyFlags memory_flags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_COMPUTE_BIT,
+		memory_flags);
+
+	bool const compact = supports_draw_indirect_count(physical_device);
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE};
+	VkPhysicalDeviceVulkan12Features vulkan12_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = &vulkan13_features,
+		.drawIndirectCount = static_cast<VkBool32>(compact)};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan12_features};
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{},
+		&features);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkCommandBuffer command_buffer = command_buffers->front();
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	compute::ComputeKernel const kernel = create_gpu_cull_kernel(device);
+	types::VulkanMemoryTypeIdx const memory_type_idx =
+		setup::filter_available_memory_types(logger, physical_device, memory_flags).at(0);
+
+	// Visible box x,y in [-1, 1], z in [0, 1], with objects spread over x in [-2, 2].
+	frustum::Frustum const frustum = frustum::extract_planes(maths::kIdentity);
+
+	constexpr std::size_t kIterations = 20;
+
+	for (uint32_t const object_count : {1'000U, 100'000U, 1'000'000U})
+	{
+		GpuCullBuffers buffers = create_gpu_cull_buffers(
+			device, memory_type_idx, kernel, ObjectCount{object_count}, compact);
+
+		for (uint32_t object_id = 0; object_id < object_count; ++object_id)
+		{
+			float const x = -2.0F + 4.0F * static_cast<float>(object_id) / object_count;
+			buffers.bounds[object_id] = ObjectBounds{.centre = {x, 0, 0.5F}, .radius = 0.01F};
+			buffers.draws[object_id] = DrawRecord{
+				.index_count = 3, .first_index = 0, .vertex_offset = 0, .object_id = object_id};
+		}
+
+		// Resubmitted for each timed run, so not one-time-submit.
+		constexpr VkCommandBufferBeginInfo begin_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, .flags = 0};
+
+		double const record_ms = bench::mean_ms(
+			kIterations,
+			[&]
+			{
+				VK_CHECK(
+					vkBeginCommandBuffer(command_buffer, &begin_info),
+					"Failed to begin command buffer");
+				populate_cmd_gpu_cull(
+					command_buffer, kernel, buffers, frustum, ObjectCount{object_count});
+				VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
+			});
+
+		double const cull_ms = bench::mean_ms(
+			kIterations,
+			[&]
+			{
+				draw::submit_command_buffer(queue, command_buffer, nullptr, nullptr);
+				VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+			});
+
+		logger->info(
+			"{} objects: CPU record {:.4f} ms, GPU cull+wait {:.3f} ms, {} visible",
+			object_count,
+			record_ms,
+			cull_ms,
+			compact ? buffers.count.front()
+					: static_cast<uint32_t>(std::ranges::count_if(
+						  buffers.commands,
+						  [](auto const & command) { return command.instanceCount != 0; })));
+	}
+}
+}  // namespace vulkandemo::gpu_cull
@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <vulkan/vulkan_core.h>
+
+#include <strong_type/equality.hpp>
+#include <strong_type/equality_with.hpp>
+#include <strong_type/implicitly_convertible_to.hpp>
+#include <strong_type/ordered.hpp>
+#include <strong_type/regular.hpp>
+#include <strong_type/type.hpp>
+
+#include "compute.hpp"
+#include "frustum.hpp"
+#include "render_graph.hpp"
+#include "types.hpp"
+
+/**
+ * GPU-driven rendering: a compute pass frustum culls objects whose bounds and draw parameters live
+ * in storage buffers, writing indexed indirect draw commands plus a draw count.
+ *
+ * The CPU records a constant number of commands per frame regardless of object count.
+ */
+namespace vulkandemo::gpu_cull
+{
+using ObjectCount = strong::type<
+	uint32_t,
+	struct TagForGpuCullObjectCount,
+	strong::regular,
+	strong::implicitly_convertible_to<uint32_t, std::size_t>,
+	strong::equality,
+	strong::equality_with<uint32_t, std::size_t>,
+	strong::strongly_ordered>;
+
+/// Work group size of `gpu_cull.comp`.
+inline constexpr uint32_t kWorkGroupSize = 64;
+
+/// State of culling outputs once ready for indirect draws and host readback.
+inline constexpr render_graph::ResourceState kDrawableAndHostReadable{
+	.stages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_HOST_BIT,
+	.access = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_HOST_READ_BIT,
+	.layout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+/**
+ * World space bounding sphere of an object.
+ */
+struct ObjectBounds
+{
+	std::array<float, 3> centre;
+	float radius;
+};
+static_assert(sizeof(ObjectBounds) == 16);
+
+/**
+ * Indexed draw parameters of an object, expanded to a VkDrawIndexedIndirectCommand if visible.
+ */
+struct DrawRecord
+{
+	uint32_t index_count;
+	uint32_t first_index;
+	int32_t vertex_offset;
+	/// Passed as `firstInstance`, i.e. available to shaders as `gl_InstanceIndex`.
+	uint32_t object_id;
+};
+static_assert(sizeof(DrawRecord) == 16);
+
+/**
+ * Storage buffers of a GPU culled scene, with the descriptor set binding them.
+ *
+ * All buffers are persistently mapped: bounds and draw records are written in place by the host,
+ * and commands and count may be read back by the host after the frame's work completes.
+ */
+struct GpuCullBuffers
+{
+	types::VulkanBufferPtr bounds_buffer;
+	types::VulkanDeviceMemoryPtr bounds_memory;
+	std::span<ObjectBounds> bounds;
+
+	types::VulkanBufferPtr draws_buffer;
+	types::VulkanDeviceMemoryPtr draws_memory;
+	std::span<DrawRecord> draws;
+
+	types::VulkanBufferPtr commands_buffer;
+	types::VulkanDeviceMemoryPtr commands_memory;
+	std::span<VkDrawIndexedIndirectCommand const> commands;
+
+	types::VulkanBufferPtr count_buffer;
+	types::VulkanDeviceMemoryPtr count_memory;
+	std::span<uint32_t const> count;
+
+	compute::ComputeBindings bindings;
+
+	/// Whether visible draws are compacted and counted for vkCmdDrawIndexedIndirectCount, or
+	/// written in place with zero instances if culled, for vkCmdDrawIndexedIndirect.
+	bool compact;
+};
+
+/**
+ * Check whether a device supports vkCmdDrawIndexedIndirectCount.
+ *
+ * If so, the `drawIndirectCount` feature of VkPhysicalDeviceVulkan12Features must be enabled on
+ * device creation to use compacted draws.
+ *
+ * @param physical_device
+ * @return
+ */
+bool supports_draw_indirect_count(VkPhysicalDevice physical_device);
+
+/**
+ * Create the culling compute kernel.
+ *
+ * Bindings are bounds, draw records, commands then count.
+ *
+ * @param device
+ * @return
+ */
+compute::ComputeKernel create_gpu_cull_kernel(types::VulkanDevicePtr const & device);
+
+/**
+ * Create storage buffers for a given number of objects, and a descriptor set binding them.
+ *
+ * @param device
+ * @param memory_type_idx Host visible and host coherent memory type.
+ * @param kernel
+ * @param capacity Maximum number of objects.
+ * @param compact See GpuCullBuffers::compact.
+ * @return
+ */
+GpuCullBuffers create_gpu_cull_buffers(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx memory_type_idx,
+	compute::ComputeKernel const & kernel,
+	ObjectCount capacity,
+	bool compact);
+
+/**
+ * Record the culling dispatch, including barriers so that the resulting commands are visible to
+ * subsequent indirect draws and to the host.
+ *
+ * Must be recorded outside of a render pass, on a device with `synchronization2` enabled.
+ *
+ * @param command_buffer
+ * @param kernel
+ * @param buffers
+ * @param frustum
+ * @param object_count Number of objects to cull, from the start of the bounds/draws buffers.
+ */
+void populate_cmd_gpu_cull(
+	VkCommandBuffer command_buffer,
+	compute::ComputeKernel const & kernel,
+	GpuCullBuffers const & buffers,
+	frustum::Frustum const & frustum,
+	ObjectCount object_count);
+
+/**
+ * Record the indirect draws of a previously culled set of objects.
+ *
+ * Must be recorded within a render pass, after binding a graphics pipeline and vertex/index
+ * buffers.
+ *
+ * @param command_buffer
+ * @param buffers
+ * @param object_count As passed to populate_cmd_gpu_cull.
+ */
+void populate_cmd_draw_culled(
+	VkCommandBuffer command_buffer, GpuCullBuffers const & buffers, ObjectCount object_count);
+}  // namespace vulkandemo::gpu_cull
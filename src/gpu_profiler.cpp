@@ -0,0 +1,434 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "gpu_profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner)
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `VK_CHECK`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "draw.hpp"
+#include "macros.hpp"
+#include "setup.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::gpu_profiler
+{
+namespace
+{
+VkQueueFamilyProperties queue_family_properties(
+	VkPhysicalDevice physical_device, types::VulkanQueueFamilyIdx const queue_family_idx)
+{
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> properties(queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(
+		physical_device, &queue_family_count, properties.data());
+	return properties.at(queue_family_idx);
+}
+}  // namespace
+
+void push_sample(RollingWindow & window, double const sample_ms)
+{
+	window.samples_ms[window.next] = sample_ms;
+	window.next = (window.next + 1) % kWindowLength;
+	window.count = std::min(window.count + 1, kWindowLength);
+}
+
+ScopeStats summarise(RollingWindow const & window, std::string name)
+{
+	if (window.count == 0)
+		throw std::invalid_argument{"Cannot summarise an empty window"};
+
+	// Oldest samples are overwritten first, so the valid samples are always a prefix until full.
+	std::array<double, kWindowLength> sorted = window.samples_ms;
+	std::span<double> const samples{sorted.data(), window.count};
+	std::ranges::sort(samples);
+
+	double sum = 0.0;
+	for (double const sample : samples)
+		sum += sample;
+
+	std::size_t const p99_rank = static_cast<std::size_t>(
+		std::ceil(0.99 * static_cast<double>(samples.size())));
+
+	return ScopeStats{
+		.name = std::move(name),
+		.min_ms = samples.front(),
+		.avg_ms = sum / static_cast<double>(samples.size()),
+		.p99_ms = samples[p99_rank - 1],
+		.sample_count = samples.size()};
+}
+
+double ticks_to_ms(
+	uint64_t const begin,
+	uint64_t const end,
+	float const timestamp_period,
+	uint32_t const valid_bits)
+{
+	uint64_t const mask = valid_bits >= 64 ? std::numeric_limits<uint64_t>::max()
+										   : (uint64_t{1} << valid_bits) - 1;
+	uint64_t const ticks = (end - begin) & mask;
+	return static_cast<double>(ticks) * static_cast<double>(timestamp_period) / 1e6;
+}
+
+bool supports_gpu_profiling(
+	VkPhysicalDevice physical_device, types::VulkanQueueFamilyIdx const queue_family_idx)
+{
+	return queue_family_properties(physical_device, queue_family_idx).timestampValidBits > 0 &&
+		setup::query_vulkan12_features(physical_device).hostQueryReset == VK_TRUE;
+}
+
+GpuProfiler::GpuProfiler(
+	types::VulkanDevicePtr device,
+	VkPhysicalDevice physical_device,
+	types::VulkanQueueFamilyIdx const queue_family_idx,
+	std::size_t const frame_count,
+	uint32_t const max_scopes)
+	: device_{std::move(device)},
+	  timestamp_period_{[&]
+						{
+							VkPhysicalDeviceProperties properties;
+							vkGetPhysicalDeviceProperties(physical_device, &properties);
+							return properties.limits.timestampPeriod;
+						}()},
+	  valid_bits_{queue_family_properties(physical_device, queue_family_idx).timestampValidBits},
+	  max_scopes_{max_scopes}
+{
+	if (valid_bits_ == 0)
+		throw std::invalid_argument{"Queue family does not support timestamps"};
+	if (frame_count == 0 || max_scopes == 0)
+		throw std::invalid_argument{"GPU profiler must have at least one frame and scope"};
+
+	VkQueryPoolCreateInfo const query_pool_create_info{
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.flags = 0,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = max_scopes * 2,
+		.pipelineStatistics = 0};
+
+	for (std::size_t frame_idx = 0; frame_idx < frame_count; ++frame_idx)
+	{
+		VkQueryPool query_pool = nullptr;
+		VK_CHECK(
+			vkCreateQueryPool(device_.get(), &query_pool_create_info, nullptr, &query_pool),
+			"Failed to create query pool");
+		// Queries must be reset before first use.
+		vkResetQueryPool(device_.get(), query_pool, 0, query_pool_create_info.queryCount);
+		frames_.push_back(Frame{
+			.query_pool = types::make_query_pool_ptr(device_, query_pool), .scope_names = {}});
+	}
+
+	results_.resize(std::size_t{max_scopes} * 2 * 2);
+}
+
+void GpuProfiler::begin_frame(std::size_t const frame_idx)
+{
+	current_frame_ = frame_idx % frames_.size();
+	Frame & frame = frames_[current_frame_];
+	if (frame.scope_names.empty())
+		return;
+
+	collect(frame);
+	vkResetQueryPool(
+		device_.get(),
+		frame.query_pool.get(),
+		0,
+		static_cast<uint32_t>(frame.scope_names.size() * 2));
+	frame.scope_names.clear();
+}
+
+uint32_t GpuProfiler::begin_scope(VkCommandBuffer command_buffer, std::string_view const name)
+{
+	Frame & frame = frames_[current_frame_];
+	if (frame.scope_names.size() == max_scopes_)
+		return kUntimedScope;
+
+	auto const scope = static_cast<uint32_t>(frame.scope_names.size());
+	frame.scope_names.emplace_back(name);
+	vkCmdWriteTimestamp2(
+		command_buffer, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, frame.query_pool.get(), scope * 2);
+	return scope;
+}
+
+void GpuProfiler::end_scope(VkCommandBuffer command_buffer, uint32_t const scope)
+{
+	if (scope == kUntimedScope)
+		return;
+	vkCmdWriteTimestamp2(
+		command_buffer,
+		VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+		frames_[current_frame_].query_pool.get(),
+		scope * 2 + 1);
+}
+
+std::vector<ScopeStats> GpuProfiler::stats() const
+{
+	std::vector<ScopeStats> out;
+	for (std::size_t name_idx = 0; name_idx < names_.size(); ++name_idx)
+		if (windows_[name_idx].count > 0)
+			out.push_back(summarise(windows_[name_idx], names_[name_idx]));
+	return out;
+}
+
+std::optional<double> GpuProfiler::last_frame_ms() const
+{
+	return last_frame_ms_;
+}
+
+void GpuProfiler::collect(Frame & frame)
+{
+	auto const query_count = static_cast<uint32_t>(frame.scope_names.size() * 2);
+
+	// Each result is followed by its availability, so unfinished queries are skipped rather than
+	// waited for. VK_NOT_READY just means some are unavailable.
+	VkResult const query_result = vkGetQueryPoolResults(
+		device_.get(),
+		frame.query_pool.get(),
+		0,
+		query_count,
+		query_count * 2 * sizeof(uint64_t),
+		results_.data(),
+		2 * sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (query_result != VK_NOT_READY)
+		VK_CHECK(query_result, "Failed to get query pool results");
+
+	// Per name totals of this frame, indexed as names_.
+	std::vector<std::optional<double>> frame_totals(names_.size());
+	// Span of the frame, relative to the first timed scope, which is the first to start since
+	// scopes are begun in submission order.
+	std::optional<uint64_t> first_tick;
+	double frame_end_ms = 0.0;
+
+	for (std::size_t scope = 0; scope < frame.scope_names.size(); ++scope)
+	{
+		uint64_t const begin = results_[scope * 4];
+		uint64_t const end = results_[scope * 4 + 2];
+		if (results_[scope * 4 + 1] == 0 || results_[scope * 4 + 3] == 0)
+			continue;
+
+		std::string const & name = frame.scope_names[scope];
+		auto const name_idx =
+			static_cast<std::size_t>(std::ranges::find(names_, name) - names_.begin());
+		if (name_idx == names_.size())
+		{
+			names_.push_back(name);
+			windows_.emplace_back();
+			frame_totals.emplace_back();
+		}
+		frame_totals[name_idx] = frame_totals[name_idx].value_or(0.0) +
+			ticks_to_ms(begin, end, timestamp_period_, valid_bits_);
+
+		if (!first_tick)
+			first_tick = begin;
+		frame_end_ms = std::max(
+			frame_end_ms, ticks_to_ms(*first_tick, end, timestamp_period_, valid_bits_));
+	}
+
+	for (std::size_t name_idx = 0; name_idx < frame_totals.size(); ++name_idx)
+		if (frame_totals[name_idx])
+			push_sample(windows_[name_idx], *frame_totals[name_idx]);
+
+	last_frame_ms_ = first_tick ? std::optional{frame_end_ms} : std::nullopt;
+}
+
+TEST_CASE("Summarise rolling GPU timings")
+{
+	RollingWindow window;
+	CHECK_THROWS_AS(static_cast<void>(summarise(window, "empty")), std::invalid_argument);
+
+	SUBCASE("partial window")
+	{
+		for (int sample = 100; sample >= 1; --sample)
+			push_sample(window, sample);
+
+		ScopeStats const stats = summarise(window, "partial");
+		CHECK(stats.name == "partial");
+		CHECK(stats.sample_count == 100);
+		CHECK(stats.min_ms == 1);
+		CHECK(stats.avg_ms == doctest::Approx(50.5));
+		CHECK(stats.p99_ms == 99);
+		// Unchanged by summarising.
+		CHECK(window.samples_ms.front() == 100);
+	}
+
+	SUBCASE("oldest samples are replaced")
+	{
+		for (std::size_t sample = 0; sample < kWindowLength; ++sample)
+			push_sample(window, 1000);
+		for (std::size_t sample = 0; sample < kWindowLength; ++sample)
+			push_sample(window, 1);
+		push_sample(window, 2);
+
+		ScopeStats const stats = summarise(window, "full");
+		CHECK(stats.sample_count == kWindowLength);
+		CHECK(stats.min_ms == 1);
+		// The single slowest of 128 samples is beyond the 99th percentile.
+		CHECK(stats.p99_ms == 1);
+		CHECK(
+			stats.avg_ms ==
+			doctest::Approx(static_cast<double>(kWindowLength + 1) / kWindowLength));
+	}
+
+	SUBCASE("single outlier sets the 99th percentile of a small window")
+	{
+		for (int sample = 0; sample < 50; ++sample)
+			push_sample(window, 1);
+		push_sample(window, 10);
+		CHECK(summarise(window, "outlier").p99_ms == 10);
+	}
+}
+
+TEST_CASE("Convert GPU timestamps to milliseconds")
+{
+	CHECK(ticks_to_ms(1'000, 3'000'000, 1.0F, 64) == doctest::Approx(2.999));
+	CHECK(ticks_to_ms(0, 1'000'000, 2.5F, 64) == doctest::Approx(2.5));
+	// Counter wrapped around its valid bits.
+	CHECK(ticks_to_ms(0xFFFF'FF00, 0x100, 1'000.0F, 32) == doctest::Approx(0.512));
+	// Bits above the valid bits are ignored.
+	CHECK(ticks_to_ms(0xAB00'0000'0000, 0xCD00'0000'0010, 1'000'000.0F, 36) == 16);
+}
+
+TEST_CASE("Time scopes on the GPU")
+{
+	vulkandemo::LoggerPtr const logger = vulkandemo::create_logger("Time scopes on the GPU");
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		nullptr,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+
+	constexpr VkMemoryPropertyFlags memory_flags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT,
+		memory_flags);
+
+	if (!supports_gpu_profiling(physical_device, queue_family_idx))
+	{
+		logger->warn("Skipping GPU profiling test, since timestamps are not supported");
+		return;
+	}
+
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE};
+	VkPhysicalDeviceVulkan12Features vulkan12_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = &vulkan13_features,
+		.hostQueryReset = VK_TRUE};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan12_features};
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{},
+		&features);
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkCommandBuffer command_buffer = command_buffers->front();
+
+	// Some work to time.
+	constexpr VkDeviceSize buffer_size = 16 * 1024 * 1024;
+	auto [buffer, memory, mapped] = draw::create_exclusive_mapped_buffer_and_memory(
+		device,
+		setup::filter_available_memory_types(logger, physical_device, memory_flags).at(0),
+		buffer_size,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+	constexpr uint32_t max_scopes = 3;
+	GpuProfiler profiler{device, physical_device, queue_family_idx, 2, max_scopes};
+	CHECK(profiler.stats().empty());
+	CHECK(!profiler.last_frame_ms());
+
+	auto const record_frame = [&](std::size_t const frame_idx, uint32_t const scope_count)
+	{
+		profiler.begin_frame(frame_idx);
+
+		constexpr VkCommandBufferBeginInfo begin_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+		VK_CHECK(
+			vkBeginCommandBuffer(command_buffer, &begin_info), "Failed to begin command buffer");
+
+		uint32_t const frame_scope = profiler.begin_scope(command_buffer, "frame");
+		for (uint32_t scope_idx = 1; scope_idx < scope_count; ++scope_idx)
+		{
+			uint32_t const fill_scope = profiler.begin_scope(command_buffer, "fill");
+			vkCmdFillBuffer(command_buffer, buffer.get(), 0, buffer_size, scope_idx);
+			profiler.end_scope(command_buffer, fill_scope);
+		}
+		profiler.end_scope(command_buffer, frame_scope);
+
+		VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
+		draw::submit_command_buffer(queue, command_buffer, nullptr, nullptr);
+		VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+	};
+
+	// Beyond capacity, so the last fill is untimed.
+	record_frame(0, max_scopes + 1);
+	// Frame 0 is not collected until its slot is reused.
+	record_frame(1, 1);
+	CHECK(profiler.stats().empty());
+
+	record_frame(2, 1);
+
+	std::vector<ScopeStats> stats = profiler.stats();
+	REQUIRE(stats.size() == 2);
+	CHECK(stats[0].name == "frame");
+	CHECK(stats[0].sample_count == 1);
+	CHECK(stats[1].name == "fill");
+	CHECK(stats[1].sample_count == 1);
+	// Nested fills are summed, and are within the frame.
+	CHECK(stats[1].min_ms > 0);
+	CHECK(stats[1].min_ms <= stats[0].min_ms);
+	REQUIRE(profiler.last_frame_ms());
+	CHECK(*profiler.last_frame_ms() == doctest::Approx(stats[0].min_ms));
+
+	// Frame 1 has no fills.
+	record_frame(3, 1);
+
+	stats = profiler.stats();
+	REQUIRE(stats.size() == 2);
+	CHECK(stats[0].sample_count == 2);
+	CHECK(stats[1].sample_count == 1);
+	CHECK(stats[0].min_ms <= stats[0].avg_ms);
+	CHECK(stats[0].avg_ms <= stats[0].p99_ms);
+}
+}  // namespace vulkandemo::gpu_profiler
@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "types.hpp"
+
+/**
+ * GPU timing of named scopes of command buffers, from timestamp queries.
+ *
+ * Each frame in flight has its own query pool, written by timestamps at the start and end of each
+ * scope. A frame's timestamps are only read back once the frame has been waited on, e.g. by its
+ * fence, when the slot is next begun, so reading never stalls. Durations are aggregated per scope
+ * name into rolling statistics over recent frames.
+ */
+namespace vulkandemo::gpu_profiler
+{
+/// Default maximum number of scopes per frame, beyond which scopes are not timed.
+inline constexpr uint32_t kMaxScopesPerFrame = 64;
+/// Frames over which statistics are aggregated.
+inline constexpr std::size_t kWindowLength = 128;
+
+/**
+ * Durations of a scope over recent frames.
+ */
+struct RollingWindow
+{
+	std::array<double, kWindowLength> samples_ms{};
+	/// Slot of the next sample, i.e. one past the newest.
+	std::size_t next = 0;
+	/// Number of valid samples, up to kWindowLength.
+	std::size_t count = 0;
+};
+
+/**
+ * Summary of a scope's rolling window.
+ */
+struct ScopeStats
+{
+	std::string name;
+	double min_ms;
+	double avg_ms;
+	/// 99th percentile, by nearest rank.
+	double p99_ms;
+	std::size_t sample_count;
+};
+
+/**
+ * Append a sample, replacing the oldest if the window is full.
+ *
+ * @param window
+ * @param sample_ms
+ */
+void push_sample(RollingWindow & window, double sample_ms);
+
+/**
+ * @param window Must have at least one sample.
+ * @param name
+ * @return
+ */
+ScopeStats summarise(RollingWindow const & window, std::string name);
+
+/**
+ * Convert the difference between two timestamps to milliseconds.
+ *
+ * @param begin
+ * @param end Wrapped around relative to `begin` if less, within the valid bits.
+ * @param timestamp_period Nanoseconds per tick, see VkPhysicalDeviceLimits.
+ * @param valid_bits See VkQueueFamilyProperties::timestampValidBits.
+ * @return
+ */
+double ticks_to_ms(uint64_t begin, uint64_t end, float timestamp_period, uint32_t valid_bits);
+
+/**
+ * Check whether a queue family supports timestamps and the device supports resetting queries from
+ * the host, as required by GpuProfiler.
+ *
+ * @param physical_device
+ * @param queue_family_idx
+ * @return
+ */
+bool supports_gpu_profiling(
+	VkPhysicalDevice physical_device, types::VulkanQueueFamilyIdx queue_family_idx);
+
+/**
+ * Query pools and rolling statistics of timed scopes.
+ *
+ * All calls must be made from a single (render) thread.
+ */
+class GpuProfiler
+{
+public:
+	/// Returned by begin_scope if the frame has no queries left.
+	static constexpr uint32_t kUntimedScope = std::numeric_limits<uint32_t>::max();
+
+	/**
+	 * Create a query pool per frame in flight.
+	 *
+	 * @param device Must have the synchronization2 and hostQueryReset features enabled.
+	 * @param physical_device
+	 * @param queue_family_idx Family of the queue that timed command buffers are submitted to,
+	 * which must support timestamps, see supports_gpu_profiling.
+	 * @param frame_count Number of frames in flight.
+	 * @param max_scopes Maximum scopes per frame.
+	 * @throws std::invalid_argument if the queue family does not support timestamps.
+	 */
+	GpuProfiler(
+		types::VulkanDevicePtr device,
+		VkPhysicalDevice physical_device,
+		types::VulkanQueueFamilyIdx queue_family_idx,
+		std::size_t frame_count,
+		uint32_t max_scopes = kMaxScopesPerFrame);
+
+	GpuProfiler(GpuProfiler const &) = delete;
+	GpuProfiler(GpuProfiler &&) = delete;
+	GpuProfiler & operator=(GpuProfiler const &) = delete;
+	GpuProfiler & operator=(GpuProfiler &&) = delete;
+
+	/**
+	 * Start recording a frame, first collecting the timings of the frame last recorded in the same
+	 * slot.
+	 *
+	 * Timings of scopes that had not completed are discarded rather than waited for.
+	 *
+	 * @param frame_idx Slot of the frame in flight. Work previously submitted for this slot must
+	 * have completed, e.g. its fence waited on.
+	 */
+	void begin_frame(std::size_t frame_idx);
+
+	/**
+	 * Record a timestamp at the start of a scope.
+	 *
+	 * Scopes may be nested, and may span command buffers of the same queue. Scopes of the same name
+	 * within a frame are summed.
+	 *
+	 * @param command_buffer
+	 * @param name
+	 * @return Scope to pass to end_scope.
+	 */
+	uint32_t begin_scope(VkCommandBuffer command_buffer, std::string_view name);
+
+	/**
+	 * Record a timestamp once all prior commands have completed.
+	 *
+	 * @param command_buffer
+	 * @param scope As returned by begin_scope in the current frame.
+	 */
+	void end_scope(VkCommandBuffer command_buffer, uint32_t scope);
+
+	/**
+	 * @return Statistics of every scope timed so far, in order of first appearance.
+	 */
+	[[nodiscard]] std::vector<ScopeStats> stats() const;
+
+	/**
+	 * @return Time from the first to the last timestamp of the most recently collected frame, if
+	 * any of its scopes were timed.
+	 */
+	[[nodiscard]] std::optional<double> last_frame_ms() const;
+
+private:
+	struct Frame
+	{
+		types::VulkanQueryPoolPtr query_pool;
+		/// Name of each scope begun, two queries per scope.
+		std::vector<std::string> scope_names;
+	};
+
+	void collect(Frame & frame);
+
+	types::VulkanDevicePtr device_;
+	float timestamp_period_;
+	uint32_t valid_bits_;
+	uint32_t max_scopes_;
+	std::vector<Frame> frames_;
+	std::size_t current_frame_ = 0;
+
+	/// Indexed in order of first appearance.
+	std::vector<std::string> names_;
+	std::vector<RollingWindow> windows_;
+	std::optional<double> last_frame_ms_;
+
+	/// Scratch space for query results, as value and availability pairs.
+	std::vector<uint64_t> results_;
+};
+}  // namespace vulkandemo::gpu_profiler
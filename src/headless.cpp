@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "headless.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `VK_CHECK`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "draw.hpp"
+#include "macros.hpp"
+#include "render_graph.hpp"
+#include "setup.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::headless
+{
+OffscreenRing create_offscreen_ring(
+	types::VulkanDevicePtr const & device,
+	VkPhysicalDevice physical_device,
+	VkFormat const format,
+	VkExtent2D const extent,
+	std::size_t const image_count,
+	VkImageUsageFlags const usage)
+{
+	if (image_count == 0)
+		throw std::invalid_argument{"Offscreen ring must have at least one image"};
+
+	OffscreenRing ring{
+		.format = format,
+		.extent = extent,
+		.memory = {},
+		.images = {},
+		.image_views = {},
+		.fences = {},
+		.next_image_idx = 0};
+
+	for (std::size_t image_idx = 0; image_idx < image_count; ++image_idx)
+	{
+		auto [image, memory] = setup::create_image_and_memory(
+			device, physical_device, format, extent, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | usage);
+		ring.image_views.push_back(setup::create_image_view(device, image.get(), format));
+		ring.images.push_back(std::move(image));
+		ring.memory.push_back(std::move(memory));
+
+		// Signalled, so that first acquire of each image does not wait.
+		ring.fences.push_back(setup::create_fence(device, true));
+	}
+
+	return ring;
+}
+
+types::VulkanImageIdx acquire_offscreen_image(
+	types::VulkanDevicePtr const & device, OffscreenRing & ring)
+{
+	std::size_t const image_idx = ring.next_image_idx;
+	ring.next_image_idx = (image_idx + 1) % ring.images.size();
+
+	VkFence fence = ring.fences[image_idx].get();
+	VK_CHECK(
+		vkWaitForFences(device.get(), 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max()),
+		"Failed to wait for offscreen image fence");
+	VK_CHECK(vkResetFences(device.get(), 1, &fence), "Failed to reset offscreen image fence");
+
+	return types::VulkanImageIdx{static_cast<uint32_t>(image_idx)};
+}
+
+TEST_CASE("Render offscreen without a window")
+{
+	vulkandemo::LoggerPtr const logger =
+		vulkandemo::create_logger("Render offscreen without a window");
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		nullptr,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+
+	constexpr VkMemoryPropertyFlags memory_flags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT,
+		memory_flags);
+
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE,
+		.dynamicRendering = VK_TRUE};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan13_features};
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{},
+		&features);
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	constexpr std::size_t ring_size = 2;
+	constexpr VkExtent2D extent{64, 64};
+	OffscreenRing ring = create_offscreen_ring(
+		device,
+		physical_device,
+		VK_FORMAT_R8G8B8A8_UNORM,
+		extent,
+		ring_size,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+	CHECK(ring.images.size() == ring_size);
+	CHECK(ring.image_views.size() == ring_size);
+	CHECK(ring.fences.size() == ring_size);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{ring_size});
+
+	auto [readback_buffer, readback_memory, readback_bytes] =
+		draw::create_exclusive_mapped_buffer_and_memory(
+			device,
+			setup::filter_available_memory_types(logger, physical_device, memory_flags).at(0),
+			VkDeviceSize{extent.width} * extent.height * 4,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+	// Clear then copy to a host visible buffer. Each frame's copy must wait for the previous
+	// frame's copy to the same buffer, hence the initial state.
+	render_graph::RenderGraph graph;
+	render_graph::ResourceId const target = render_graph::import_image(
+		graph, "offscreen", {.format = ring.format, .extent = ring.extent}, kOffscreenAcquired);
+	render_graph::ResourceId const readback = render_graph::import_buffer(
+		graph,
+		"readback",
+		render_graph::state_of(render_graph::Access::kTransferWrite),
+		render_graph::state_of(render_graph::Access::kHostRead));
+	render_graph::add_pass(
+		graph,
+		{.name = "clear",
+		 .colour_attachments = {{.image = target, .clear_value = {.float32 = {1, 0, 0, 1}}}}});
+	render_graph::add_pass(
+		graph,
+		{.name = "readback",
+		 .uses =
+			 {{.resource = target, .access = render_graph::Access::kTransferRead},
+			  {.resource = readback, .access = render_graph::Access::kTransferWrite}},
+		 .record =
+			 [&](VkCommandBuffer cmd, render_graph::CompiledRenderGraph const & compiled)
+		 {
+			 VkBufferImageCopy const region{
+				 .bufferOffset = 0,
+				 .bufferRowLength = 0,
+				 .bufferImageHeight = 0,
+				 .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+				 .imageOffset = {0, 0, 0},
+				 .imageExtent = {extent.width, extent.height, 1}};
+			 vkCmdCopyImageToBuffer(
+				 cmd,
+				 compiled.images[target.value_of()],
+				 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				 render_graph::buffer(compiled, readback),
+				 1,
+				 &region);
+		 }});
+
+	render_graph::CompiledRenderGraph compiled =
+		render_graph::compile_render_graph(device, physical_device, std::move(graph));
+	render_graph::bind_imported_buffer(compiled, readback, readback_buffer.get());
+
+	// More frames than images, so that the ring wraps and fences are waited on.
+	std::vector<uint32_t> acquired;
+	for (std::size_t frame = 0; frame < ring_size * 2 + 1; ++frame)
+	{
+		types::VulkanImageIdx const image_idx = acquire_offscreen_image(device, ring);
+		acquired.push_back(image_idx);
+
+		render_graph::bind_imported_image(
+			compiled,
+			target,
+			ring.images.at(image_idx).get(),
+			ring.image_views.at(image_idx).get());
+
+		VkCommandBuffer command_buffer = command_buffers->at(image_idx);
+		render_graph::populate_cmd_render_graph(command_buffer, compiled);
+		draw::submit_command_buffer(
+			queue, command_buffer, nullptr, nullptr, ring.fences.at(image_idx));
+	}
+	VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+
+	CHECK(acquired == std::vector<uint32_t>{0, 1, 0, 1, 0});
+
+	std::span<std::byte const> const first_pixel = readback_bytes.first(4);
+	CHECK(std::ranges::equal(
+		first_pixel,
+		std::array{std::byte{255}, std::byte{0}, std::byte{0}, std::byte{255}}));
+}
+}  // namespace vulkandemo::headless
@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "render_graph.hpp"
+#include "types.hpp"
+
+/**
+ * Offscreen render targets standing in for a swapchain, for running without a window, surface or
+ * display server, e.g. on render nodes or under a software rasteriser such as lavapipe in CI.
+ *
+ * A ring of colour images is cycled through, each guarded by a fence signalled by the last
+ * submission that rendered into it, so several frames can be in flight as with a swapchain.
+ */
+namespace vulkandemo::headless
+{
+/// State of a ring image when acquired. Previous contents are discarded.
+inline constexpr render_graph::ResourceState kOffscreenAcquired{
+	.stages = VK_PIPELINE_STAGE_2_NONE,
+	.access = VK_ACCESS_2_NONE,
+	.layout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+struct OffscreenRing
+{
+	VkFormat format;
+	VkExtent2D extent;
+	std::vector<types::VulkanDeviceMemoryPtr> memory;
+	std::vector<types::VulkanImagePtr> images;
+	std::vector<types::VulkanImageViewPtr> image_views;
+	/// Per image, signalled once the last submission rendering into the image has completed.
+	std::vector<types::VulkanFencePtr> fences;
+	/// Image to hand out on next acquire.
+	std::size_t next_image_idx;
+};
+
+/**
+ * Create a ring of single mip, single layer colour images in device local memory.
+ *
+ * @param device
+ * @param physical_device
+ * @param format
+ * @param extent
+ * @param image_count Maximum frames in flight.
+ * @param usage Image usage in addition to colour attachment, e.g. transfer source for readback.
+ * @return
+ */
+OffscreenRing create_offscreen_ring(
+	types::VulkanDevicePtr const & device,
+	VkPhysicalDevice physical_device,
+	VkFormat format,
+	VkExtent2D extent,
+	std::size_t image_count,
+	VkImageUsageFlags usage = 0);
+
+/**
+ * Acquire the next image of the ring, waiting for any previous rendering into it to complete.
+ *
+ * The image's fence is reset, so must be signalled by the submission that renders into the image,
+ * see draw::submit_command_buffer.
+ *
+ * @param device
+ * @param ring
+ * @return
+ */
+types::VulkanImageIdx acquire_offscreen_image(
+	types::VulkanDevicePtr const & device, OffscreenRing & ring);
+}  // namespace vulkandemo::headless
@@ -0,0 +1,879 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "hiz.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <range/v3/range/conversion.hpp>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner)
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `VK_CHECK`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "barrier.hpp"
+#include "compute.hpp"
+#include "draw.hpp"
+#include "gpu_cull.hpp"
+#include "macros.hpp"
+#include "maths.hpp"
+#include "render_graph.hpp"
+#include "setup.hpp"
+#include "shaders.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::hiz
+{
+namespace
+{
+/// Push constants of `hiz_downsample.comp`.
+struct DownsamplePushConstants
+{
+	VkExtent2D src_extent;
+	VkExtent2D dst_extent;
+	uint32_t src_offset;
+	uint32_t dst_offset;
+};
+static_assert(sizeof(DownsamplePushConstants) == 24);
+
+/// Push constants of `hiz_cull.comp`.
+struct CullPushConstants
+{
+	maths::Mat4 view_projection;
+	VkExtent2D depth_extent;
+	uint32_t level_count;
+	uint32_t object_count;
+	uint32_t phase;
+	uint32_t compact;
+};
+static_assert(sizeof(CullPushConstants) == 96);
+
+/// State of the pyramid once ready for culling and host readback.
+constexpr render_graph::ResourceState kCullableAndHostReadable{
+	.stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_HOST_BIT,
+	.access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_HOST_READ_BIT,
+	.layout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+/**
+ * Corners of an object's bounds in clip space, reduced as per `hiz_cull.comp`.
+ */
+struct ProjectedCorners
+{
+	/// Frustum planes every corner is outside of, as bits -x, +x, -y, +y, near, far.
+	uint32_t outside_all;
+	/// Screen rect, unless a corner is in front of the near plane.
+	std::optional<ScreenRect> rect;
+};
+
+ProjectedCorners project_corners(
+	maths::Mat4 const & view_projection,
+	gpu_cull::ObjectBounds const & bounds,
+	VkExtent2D const extent)
+{
+	uint32_t outside_all = 0x3F;
+	bool crosses_near = false;
+	std::array<float, 2> ndc_min{1.0F, 1.0F};
+	std::array<float, 2> ndc_max{-1.0F, -1.0F};
+	float nearest_depth = 1.0F;
+
+	for (uint32_t corner_idx = 0; corner_idx < 8; ++corner_idx)
+	{
+		std::array<float, 3> corner{};
+		for (std::size_t axis = 0; axis < 3; ++axis)
+			corner[axis] = bounds.centre[axis] +
+				(((corner_idx >> axis) & 1U) != 0 ? bounds.radius : -bounds.radius);
+
+		auto const [x, y, z, w] = view_projection * maths::Vec4{corner[0], corner[1], corner[2], 1};
+
+		uint32_t const outside = (x < -w ? 0x01U : 0U) | (x > w ? 0x02U : 0U) |
+			(y < -w ? 0x04U : 0U) | (y > w ? 0x08U : 0U) | (z < 0 ? 0x10U : 0U) |
+			(z > w ? 0x20U : 0U);
+		outside_all &= outside;
+
+		if (w <= 0 || z < 0)
+		{
+			crosses_near = true;
+			continue;
+		}
+		ndc_min = {std::min(ndc_min[0], x / w), std::min(ndc_min[1], y / w)};
+		ndc_max = {std::max(ndc_max[0], x / w), std::max(ndc_max[1], y / w)};
+		nearest_depth = std::min(nearest_depth, z / w);
+	}
+
+	if (crosses_near)
+		return {.outside_all = outside_all, .rect = std::nullopt};
+
+	std::array const size{static_cast<float>(extent.width), static_cast<float>(extent.height)};
+	auto const to_pixels = [&](std::array<float, 2> const & ndc)
+	{
+		return std::array{
+			std::clamp((ndc[0] * 0.5F + 0.5F) * size[0], 0.0F, size[0]),
+			std::clamp((ndc[1] * 0.5F + 0.5F) * size[1], 0.0F, size[1])};
+	};
+	return {
+		.outside_all = outside_all,
+		.rect = ScreenRect{
+			.min = to_pixels(ndc_min), .max = to_pixels(ndc_max), .nearest_depth = nearest_depth}};
+}
+}  // namespace
+
+std::vector<PyramidLevel> pyramid_levels(VkExtent2D const extent)
+{
+	if (extent.width == 0 || extent.height == 0)
+		throw std::invalid_argument{"Depth pyramid extent must be non-zero"};
+
+	std::vector<PyramidLevel> levels{{.extent = extent, .offset = 0}};
+	while (levels.back().extent.width > 1 || levels.back().extent.height > 1)
+	{
+		PyramidLevel const & last = levels.back();
+		levels.push_back(
+			{.extent = {(last.extent.width + 1) / 2, (last.extent.height + 1) / 2},
+			 .offset = last.offset + last.extent.width * last.extent.height});
+	}
+	return levels;
+}
+
+std::vector<float> build_depth_pyramid(
+	std::span<float const> const depth, std::span<PyramidLevel const> const levels)
+{
+	if (levels.empty() || depth.size() != std::size_t{levels[0].extent.width} *
+			levels[0].extent.height)
+		throw std::invalid_argument{"Depth does not match depth pyramid"};
+
+	PyramidLevel const & top = levels.back();
+	std::vector<float> texels(std::size_t{top.offset} + 1);
+	std::ranges::copy(depth, texels.begin());
+
+	for (std::size_t level_idx = 1; level_idx < levels.size(); ++level_idx)
+	{
+		PyramidLevel const & src = levels[level_idx - 1];
+		PyramidLevel const & dst = levels[level_idx];
+		auto const load = [&](uint32_t const x, uint32_t const y)
+		{
+			return texels[src.offset + std::min(y, src.extent.height - 1) * src.extent.width +
+						  std::min(x, src.extent.width - 1)];
+		};
+		for (uint32_t y = 0; y < dst.extent.height; ++y)
+			for (uint32_t x = 0; x < dst.extent.width; ++x)
+				texels[dst.offset + y * dst.extent.width + x] = std::max(
+					std::max(load(x * 2, y * 2), load(x * 2 + 1, y * 2)),
+					std::max(load(x * 2, y * 2 + 1), load(x * 2 + 1, y * 2 + 1)));
+	}
+	return texels;
+}
+
+std::optional<ScreenRect> project_bounds(
+	maths::Mat4 const & view_projection,
+	gpu_cull::ObjectBounds const & bounds,
+	VkExtent2D const extent)
+{
+	return project_corners(view_projection, bounds, extent).rect;
+}
+
+uint32_t pyramid_level_for(ScreenRect const & rect, uint32_t const level_count)
+{
+	float const size = std::max(rect.max[0] - rect.min[0], rect.max[1] - rect.min[1]);
+	auto const level = static_cast<uint32_t>(std::ceil(std::log2(std::max(size, 1.0F))));
+	return std::min(level, level_count - 1);
+}
+
+Visibility test_visibility(
+	maths::Mat4 const & view_projection,
+	gpu_cull::ObjectBounds const & bounds,
+	std::span<float const> const texels,
+	std::span<PyramidLevel const> const levels)
+{
+	ProjectedCorners const projected =
+		project_corners(view_projection, bounds, levels.front().extent);
+	if (projected.outside_all != 0)
+		return Visibility::kOutsideFrustum;
+	if (!projected.rect)
+		return Visibility::kVisible;
+
+	ScreenRect const & rect = *projected.rect;
+	uint32_t const level_idx = pyramid_level_for(rect, static_cast<uint32_t>(levels.size()));
+	PyramidLevel const & level = levels[level_idx];
+
+	auto const texel_of = [&](float const pixel, uint32_t const level_size)
+	{ return std::min(static_cast<uint32_t>(pixel) >> level_idx, level_size - 1); };
+
+	float farthest_depth = 0.0F;
+	for (uint32_t y = texel_of(rect.min[1], level.extent.height);
+		 y <= texel_of(rect.max[1], level.extent.height);
+		 ++y)
+		for (uint32_t x = texel_of(rect.min[0], level.extent.width);
+			 x <= texel_of(rect.max[0], level.extent.width);
+			 ++x)
+			farthest_depth =
+				std::max(farthest_depth, texels[level.offset + y * level.extent.width + x]);
+
+	return rect.nearest_depth > farthest_depth ? Visibility::kOccluded : Visibility::kVisible;
+}
+
+HizPipelines create_hiz_pipelines(types::VulkanDevicePtr const & device)
+{
+	constexpr std::array downsample_bindings{compute::BindingType::kStorageBuffer};
+	// Bounds, draw records, early and late commands, counters, states and pyramid, see
+	// hiz_cull.comp.
+	constexpr std::array<compute::BindingType, 7> cull_bindings{
+		compute::BindingType::kStorageBuffer,
+		compute::BindingType::kStorageBuffer,
+		compute::BindingType::kStorageBuffer,
+		compute::BindingType::kStorageBuffer,
+		compute::BindingType::kStorageBuffer,
+		compute::BindingType::kStorageBuffer,
+		compute::BindingType::kStorageBuffer};
+
+	return HizPipelines{
+		.downsample = compute::create_compute_kernel(
+			device,
+			shaders::kHizDownsampleComp,
+			downsample_bindings,
+			sizeof(DownsamplePushConstants),
+			kDownsampleWorkGroupSize),
+		.cull = compute::create_compute_kernel(
+			device,
+			shaders::kHizCullComp,
+			cull_bindings,
+			sizeof(CullPushConstants),
+			{kCullWorkGroupSize, 1, 1})};
+}
+
+DepthPyramid create_depth_pyramid(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx const memory_type_idx,
+	HizPipelines const & pipelines,
+	VkExtent2D const extent)
+{
+	std::vector<PyramidLevel> levels = pyramid_levels(extent);
+
+	auto [buffer, memory, texels] = compute::create_mapped_storage_buffer<float>(
+		device, memory_type_idx, levels.back().offset + 1, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+	std::array const bindings{compute::Binding{compute::StorageBuffer{.buffer = buffer.get()}}};
+	compute::ComputeBindings compute_bindings =
+		compute::create_compute_bindings(device, pipelines.downsample, bindings);
+
+	return DepthPyramid{
+		.extent = extent,
+		.levels = std::move(levels),
+		.buffer = std::move(buffer),
+		.memory = std::move(memory),
+		.texels = texels,
+		.bindings = std::move(compute_bindings)};
+}
+
+HizCullBuffers create_hiz_cull_buffers(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx const memory_type_idx,
+	HizPipelines const & pipelines,
+	DepthPyramid const & pyramid,
+	gpu_cull::ObjectCount const capacity,
+	bool const compact)
+{
+	auto [bounds_buffer, bounds_memory, bounds] =
+		compute::create_mapped_storage_buffer<gpu_cull::ObjectBounds>(
+			device, memory_type_idx, capacity, 0);
+	auto [draws_buffer, draws_memory, draws] =
+		compute::create_mapped_storage_buffer<gpu_cull::DrawRecord>(
+			device, memory_type_idx, capacity, 0);
+	auto [early_commands_buffer, early_commands_memory, early_commands] =
+		compute::create_mapped_storage_buffer<VkDrawIndexedIndirectCommand>(
+			device, memory_type_idx, capacity, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+	auto [late_commands_buffer, late_commands_memory, late_commands] =
+		compute::create_mapped_storage_buffer<VkDrawIndexedIndirectCommand>(
+			device, memory_type_idx, capacity, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+	auto [counters_buffer, counters_memory, counters] =
+		compute::create_mapped_storage_buffer<HizCounters>(
+			device,
+			memory_type_idx,
+			1,
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	auto [states_buffer, states_memory, states] =
+		compute::create_mapped_storage_buffer<ObjectState>(device, memory_type_idx, capacity, 0);
+
+	std::array const bindings{
+		compute::Binding{compute::StorageBuffer{.buffer = bounds_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = draws_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = early_commands_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = late_commands_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = counters_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = states_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = pyramid.buffer.get()}}};
+	compute::ComputeBindings compute_bindings =
+		compute::create_compute_bindings(device, pipelines.cull, bindings);
+
+	return HizCullBuffers{
+		.bounds_buffer = std::move(bounds_buffer),
+		.bounds_memory = std::move(bounds_memory),
+		.bounds = bounds,
+		.draws_buffer = std::move(draws_buffer),
+		.draws_memory = std::move(draws_memory),
+		.draws = draws,
+		.early_commands_buffer = std::move(early_commands_buffer),
+		.early_commands_memory = std::move(early_commands_memory),
+		.early_commands = early_commands,
+		.late_commands_buffer = std::move(late_commands_buffer),
+		.late_commands_memory = std::move(late_commands_memory),
+		.late_commands = late_commands,
+		.counters_buffer = std::move(counters_buffer),
+		.counters_memory = std::move(counters_memory),
+		.counters = counters,
+		.states_buffer = std::move(states_buffer),
+		.states_memory = std::move(states_memory),
+		.states = states,
+		.bindings = std::move(compute_bindings),
+		.compact = compact};
+}
+
+void populate_cmd_build_depth_pyramid(
+	VkCommandBuffer command_buffer,
+	HizPipelines const & pipelines,
+	DepthPyramid const & pyramid,
+	VkImage depth_image)
+{
+	// Previous culling must finish reading the pyramid before it is overwritten.
+	barrier::populate_cmd_memory_barrier(
+		command_buffer,
+		{.stages = kCullableAndHostReadable.stages,
+		 .access = VK_ACCESS_2_NONE,
+		 .layout = VK_IMAGE_LAYOUT_UNDEFINED},
+		render_graph::state_of(render_graph::Access::kTransferWrite));
+
+	VkBufferImageCopy const region{
+		.bufferOffset = 0,
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1},
+		.imageOffset = {0, 0, 0},
+		.imageExtent = {pyramid.extent.width, pyramid.extent.height, 1}};
+	vkCmdCopyImageToBuffer(
+		command_buffer,
+		depth_image,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		pyramid.buffer.get(),
+		1,
+		&region);
+
+	if (pyramid.levels.size() == 1)
+	{
+		barrier::populate_cmd_memory_barrier(
+			command_buffer,
+			render_graph::state_of(render_graph::Access::kTransferWrite),
+			kCullableAndHostReadable);
+		return;
+	}
+
+	for (std::size_t level_idx = 1; level_idx < pyramid.levels.size(); ++level_idx)
+	{
+		PyramidLevel const & src = pyramid.levels[level_idx - 1];
+		PyramidLevel const & dst = pyramid.levels[level_idx];
+		bool const is_first = level_idx == 1;
+		bool const is_last = level_idx == pyramid.levels.size() - 1;
+
+		DownsamplePushConstants const push_constants{
+			.src_extent = src.extent,
+			.dst_extent = dst.extent,
+			.src_offset = src.offset,
+			.dst_offset = dst.offset};
+
+		// Each level depends on the last, so every dispatch waits on the previous write.
+		std::array const buffer_uses{compute::BufferUse{
+			.buffer = pyramid.buffer.get(),
+			.access = render_graph::Access::kComputeShaderStorageReadWrite,
+			.before = render_graph::state_of(
+				is_first ? render_graph::Access::kTransferWrite
+						 : render_graph::Access::kComputeShaderStorageReadWrite),
+			.after = is_last ? std::optional{kCullableAndHostReadable} : std::nullopt}};
+
+		compute::populate_cmd_dispatch(
+			command_buffer,
+			pipelines.downsample,
+			pyramid.bindings,
+			std::as_bytes(std::span{&push_constants, 1}),
+			buffer_uses,
+			{},
+			compute::group_count_for(
+				pipelines.downsample, {dst.extent.width, dst.extent.height, 1}));
+	}
+}
+
+void populate_cmd_hiz_cull(
+	VkCommandBuffer command_buffer,
+	HizPipelines const & pipelines,
+	HizCullBuffers const & buffers,
+	DepthPyramid const & pyramid,
+	maths::Mat4 const & view_projection,
+	gpu_cull::ObjectCount const object_count,
+	Phase const phase)
+{
+	using render_graph::Access;
+	using render_graph::state_of;
+
+	bool const is_early = phase == Phase::kEarly;
+
+	if (is_early)
+	{
+		// Previous frame's late phase and indirect draws must be done with the counters before
+		// they are reset.
+		barrier::populate_cmd_memory_barrier(
+			command_buffer,
+			{.stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+				 VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+			 .access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			 .layout = VK_IMAGE_LAYOUT_UNDEFINED},
+			state_of(Access::kTransferWrite));
+		vkCmdFillBuffer(command_buffer, buffers.counters_buffer.get(), 0, VK_WHOLE_SIZE, 0);
+	}
+
+	// Bounds and draw records are host writes made visible by submission, and the pyramid was
+	// left readable by populate_cmd_build_depth_pyramid.
+	std::array const buffer_uses{
+		compute::BufferUse{
+			.buffer = is_early ? buffers.early_commands_buffer.get()
+							   : buffers.late_commands_buffer.get(),
+			.access = Access::kComputeShaderStorageWrite,
+			.before = state_of(Access::kIndirectCommandRead),
+			.after = gpu_cull::kDrawableAndHostReadable},
+		compute::BufferUse{
+			.buffer = buffers.counters_buffer.get(),
+			.access = Access::kComputeShaderStorageReadWrite,
+			.before = state_of(
+				is_early ? Access::kTransferWrite : Access::kComputeShaderStorageReadWrite),
+			.after = gpu_cull::kDrawableAndHostReadable},
+		compute::BufferUse{
+			.buffer = buffers.states_buffer.get(),
+			.access = Access::kComputeShaderStorageReadWrite,
+			.before = state_of(Access::kComputeShaderStorageReadWrite),
+			.after = is_early ? std::nullopt : std::optional{state_of(Access::kHostRead)}}};
+
+	CullPushConstants const push_constants{
+		.view_projection = view_projection,
+		.depth_extent = pyramid.extent,
+		.level_count = static_cast<uint32_t>(pyramid.levels.size()),
+		.object_count = object_count,
+		.phase = static_cast<uint32_t>(phase),
+		.compact = static_cast<uint32_t>(buffers.compact)};
+
+	compute::populate_cmd_dispatch(
+		command_buffer,
+		pipelines.cull,
+		buffers.bindings,
+		std::as_bytes(std::span{&push_constants, 1}),
+		buffer_uses,
+		{},
+		compute::group_count_for(pipelines.cull, {object_count, 1, 1}));
+}
+
+void populate_cmd_draw_hiz_culled(
+	VkCommandBuffer command_buffer,
+	HizCullBuffers const & buffers,
+	gpu_cull::ObjectCount const object_count,
+	Phase const phase)
+{
+	bool const is_early = phase == Phase::kEarly;
+	VkBuffer commands_buffer =
+		is_early ? buffers.early_commands_buffer.get() : buffers.late_commands_buffer.get();
+
+	if (buffers.compact)
+		vkCmdDrawIndexedIndirectCount(
+			command_buffer,
+			commands_buffer,
+			0,
+			buffers.counters_buffer.get(),
+			is_early ? offsetof(HizCounters, early_draw_count)
+					 : offsetof(HizCounters, late_draw_count),
+			object_count,
+			sizeof(VkDrawIndexedIndirectCommand));
+	else
+		vkCmdDrawIndexedIndirect(
+			command_buffer, commands_buffer, 0, object_count, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+TEST_CASE("Build a depth pyramid")
+{
+	std::vector<PyramidLevel> const levels = pyramid_levels({5, 3});
+
+	REQUIRE(levels.size() == 4);
+	CHECK(levels[0].extent.width == 5);
+	CHECK(levels[0].extent.height == 3);
+	CHECK(levels[1].extent.width == 3);
+	CHECK(levels[1].extent.height == 2);
+	CHECK(levels[1].offset == 15);
+	CHECK(levels[2].extent.width == 2);
+	CHECK(levels[2].extent.height == 1);
+	CHECK(levels[2].offset == 21);
+	CHECK(levels[3].extent.width == 1);
+	CHECK(levels[3].extent.height == 1);
+	CHECK(levels[3].offset == 23);
+
+	CHECK(pyramid_levels({1, 1}).size() == 1);
+	CHECK(pyramid_levels({1024, 1}).size() == 11);
+	CHECK_THROWS_AS(std::ignore = pyramid_levels({0, 4}), std::invalid_argument);
+
+	std::mt19937 rng{42};  // NOLINT(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+	std::uniform_real_distribution<float> depth_dist{0.0F, 1.0F};
+	std::vector<float> depth(15);
+	std::ranges::generate(depth, [&] { return depth_dist(rng); });
+
+	std::vector<float> const texels = build_depth_pyramid(depth, levels);
+	REQUIRE(texels.size() == 24);
+
+	// Every texel is the farthest depth of the level 0 texels it covers, including those folded in
+	// from odd extents.
+	for (std::size_t level_idx = 1; level_idx < levels.size(); ++level_idx)
+	{
+		PyramidLevel const & level = levels[level_idx];
+		uint32_t const span = 1U << level_idx;
+		for (uint32_t y = 0; y < level.extent.height; ++y)
+			for (uint32_t x = 0; x < level.extent.width; ++x)
+			{
+				float expected = 0.0F;
+				for (uint32_t src_y = y * span; src_y < std::min((y + 1) * span, 3U); ++src_y)
+					for (uint32_t src_x = x * span; src_x < std::min((x + 1) * span, 5U); ++src_x)
+						expected = std::max(expected, depth[src_y * 5 + src_x]);
+				CAPTURE(level_idx);
+				CAPTURE(x);
+				CAPTURE(y);
+				CHECK(texels[level.offset + y * level.extent.width + x] == expected);
+			}
+	}
+	CHECK(texels.back() == std::ranges::max(depth));
+
+	CHECK_THROWS_AS(
+		std::ignore = build_depth_pyramid(std::span{depth}.first(14), levels),
+		std::invalid_argument);
+}
+
+TEST_CASE("Test bounds against a depth pyramid")
+{
+	// Identity view-projection, i.e. visible box x,y in [-1, 1], z in [0, 1].
+	constexpr maths::Mat4 kViewProjection = maths::kIdentity;
+	constexpr VkExtent2D kExtent{16, 16};
+
+	// Wall at depth 0.25 across the left half of the screen, nothing on the right.
+	std::vector<PyramidLevel> const levels = pyramid_levels(kExtent);
+	std::vector<float> depth(std::size_t{kExtent.width} * kExtent.height);
+	for (std::size_t texel_idx = 0; texel_idx < depth.size(); ++texel_idx)
+		depth[texel_idx] = texel_idx % kExtent.width < kExtent.width / 2 ? 0.25F : 1.0F;
+	std::vector<float> const texels = build_depth_pyramid(depth, levels);
+
+	auto const test = [&](gpu_cull::ObjectBounds const & bounds)
+	{ return test_visibility(kViewProjection, bounds, texels, levels); };
+
+	SUBCASE("screen rect")
+	{
+		std::optional<ScreenRect> const rect =
+			project_bounds(kViewProjection, {.centre = {-0.5F, 0, 0.5F}, .radius = 0.1F}, kExtent);
+
+		REQUIRE(rect.has_value());
+		CHECK(rect->min[0] == doctest::Approx(3.2F));
+		CHECK(rect->max[0] == doctest::Approx(4.8F));
+		CHECK(rect->min[1] == doctest::Approx(7.2F));
+		CHECK(rect->max[1] == doctest::Approx(8.8F));
+		CHECK(rect->nearest_depth == doctest::Approx(0.4F));
+		// 1.6 pixels across fits within 2x2 texels of level 1.
+		CHECK(pyramid_level_for(*rect, static_cast<uint32_t>(levels.size())) == 1);
+
+		// Clamped to the screen, and to the coarsest level.
+		ScreenRect const huge{.min = {0, 0}, .max = {16, 16}, .nearest_depth = 0};
+		CHECK(pyramid_level_for(huge, static_cast<uint32_t>(levels.size())) == 4);
+		CHECK(pyramid_level_for(huge, 2) == 1);
+
+		CHECK_FALSE(
+			project_bounds(kViewProjection, {.centre = {0, 0, 0.05F}, .radius = 0.1F}, kExtent));
+	}
+
+	SUBCASE("behind the wall")
+	{
+		CHECK(test({.centre = {-0.5F, 0, 0.5F}, .radius = 0.1F}) == Visibility::kOccluded);
+	}
+
+	SUBCASE("in front of the wall")
+	{
+		CHECK(test({.centre = {-0.5F, 0, 0.1F}, .radius = 0.05F}) == Visibility::kVisible);
+	}
+
+	SUBCASE("beside the wall")
+	{
+		CHECK(test({.centre = {0.5F, 0, 0.5F}, .radius = 0.1F}) == Visibility::kVisible);
+	}
+
+	SUBCASE("straddling the edge of the wall")
+	{
+		CHECK(test({.centre = {0, 0, 0.5F}, .radius = 0.1F}) == Visibility::kVisible);
+	}
+
+	SUBCASE("crossing the near plane")
+	{
+		CHECK(test({.centre = {-0.5F, 0, 0.05F}, .radius = 0.1F}) == Visibility::kVisible);
+	}
+
+	SUBCASE("outside the frustum")
+	{
+		CHECK(test({.centre = {5, 0, 0.5F}, .radius = 0.1F}) == Visibility::kOutsideFrustum);
+		CHECK(test({.centre = {0, 0, -1}, .radius = 0.1F}) == Visibility::kOutsideFrustum);
+		CHECK(test({.centre = {0, 0, 2}, .radius = 0.1F}) == Visibility::kOutsideFrustum);
+	}
+}
+
+TEST_CASE("Cull occluded objects on the GPU")
+{
+	vulkandemo::LoggerPtr const logger =
+		vulkandemo::create_logger("Cull occluded objects on the GPU");
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		nullptr,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+
+	constexpr VkMemoryPropertyFlags memory_flags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT,
+		memory_flags);
+
+	bool const compact = gpu_cull::supports_draw_indirect_count(physical_device);
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE};
+	VkPhysicalDeviceVulkan12Features vulkan12_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = &vulkan13_features,
+		.drawIndirectCount = static_cast<VkBool32>(compact)};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan12_features};
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{},
+		&features);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkCommandBuffer command_buffer = command_buffers->front();
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	types::VulkanMemoryTypeIdx const memory_type_idx =
+		setup::filter_available_memory_types(logger, physical_device, memory_flags).at(0);
+
+	// Odd extent, so that folding of the last row and column is exercised.
+	constexpr VkExtent2D kExtent{37, 23};
+	constexpr std::size_t kTexelCount = std::size_t{kExtent.width} * kExtent.height;
+
+	auto [depth_image, depth_memory] = setup::create_image_and_memory(
+		device,
+		physical_device,
+		kDepthFormat,
+		kExtent,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+	// Wall at depth 0.25 across the left half of the screen, random depth beyond it elsewhere.
+	auto [staging_buffer, staging_memory, staging_bytes] =
+		draw::create_exclusive_mapped_buffer_and_memory(
+			device, memory_type_idx, kTexelCount * sizeof(float), VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+	// NOLINTNEXTLINE(*-reinterpret-cast)
+	std::span const depth{reinterpret_cast<float *>(staging_bytes.data()), kTexelCount};
+	std::mt19937 rng{42};  // NOLINT(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+	std::uniform_real_distribution<float> depth_dist{0.9F, 1.0F};
+	for (std::size_t texel_idx = 0; texel_idx < kTexelCount; ++texel_idx)
+		depth[texel_idx] = texel_idx % kExtent.width < kExtent.width / 2 ? 0.25F : depth_dist(rng);
+
+	HizPipelines const pipelines = create_hiz_pipelines(device);
+	DepthPyramid const pyramid = create_depth_pyramid(device, memory_type_idx, pipelines, kExtent);
+
+	CHECK(pipelines.downsample.pipeline);
+	CHECK(pipelines.cull.pipeline);
+	CHECK(pyramid.levels.size() == 7);
+
+	// Identity view-projection, i.e. visible box x,y in [-1, 1], z in [0, 1].
+	constexpr maths::Mat4 kViewProjection = maths::kIdentity;
+
+	constexpr std::array kBounds{
+		// Behind the wall.
+		gpu_cull::ObjectBounds{.centre = {-0.5F, 0, 0.5F}, .radius = 0.1F},
+		// In front of the wall.
+		gpu_cull::ObjectBounds{.centre = {-0.5F, 0, 0.1F}, .radius = 0.05F},
+		// Beside the wall.
+		gpu_cull::ObjectBounds{.centre = {0.5F, 0, 0.5F}, .radius = 0.1F},
+		// Outside the frustum.
+		gpu_cull::ObjectBounds{.centre = {5, 0, 0.5F}, .radius = 0.1F},
+		// Behind the wall.
+		gpu_cull::ObjectBounds{.centre = {-0.7F, 0.5F, 0.9F}, .radius = 0.05F}};
+	constexpr gpu_cull::ObjectCount kObjectCount{static_cast<uint32_t>(kBounds.size())};
+
+	auto const cull = [&](bool const should_compact)
+	{
+		HizCullBuffers buffers = create_hiz_cull_buffers(
+			device, memory_type_idx, pipelines, pyramid, kObjectCount, should_compact);
+		std::ranges::copy(kBounds, buffers.bounds.begin());
+		for (uint32_t object_id = 0; object_id < kObjectCount; ++object_id)
+			buffers.draws[object_id] = gpu_cull::DrawRecord{
+				.index_count = 3,
+				.first_index = object_id * 3,
+				.vertex_offset = 0,
+				.object_id = object_id};
+
+		constexpr VkCommandBufferBeginInfo begin_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+		VK_CHECK(
+			vkBeginCommandBuffer(command_buffer, &begin_info), "Failed to begin command buffer");
+
+		auto const transition =
+			[&](render_graph::ResourceState const & src, render_graph::ResourceState const & dst)
+		{
+			barrier::populate_cmd_barriers(
+				command_buffer,
+				std::nullopt,
+				std::array{barrier::image_barrier(
+					depth_image.get(), {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1}, src, dst)});
+		};
+
+		using render_graph::Access;
+		using render_graph::state_of;
+
+		// Upload depth, as if rendered by the previous frame.
+		transition({}, state_of(Access::kTransferWrite));
+		VkBufferImageCopy const region{
+			.bufferOffset = 0,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1},
+			.imageOffset = {0, 0, 0},
+			.imageExtent = {kExtent.width, kExtent.height, 1}};
+		vkCmdCopyBufferToImage(
+			command_buffer,
+			staging_buffer.get(),
+			depth_image.get(),
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1,
+			&region);
+		transition(state_of(Access::kTransferWrite), state_of(Access::kTransferRead));
+
+		// Both phases against the same depth, i.e. nothing drawn in the early phase occludes.
+		populate_cmd_build_depth_pyramid(command_buffer, pipelines, pyramid, depth_image.get());
+		populate_cmd_hiz_cull(
+			command_buffer,
+			pipelines,
+			buffers,
+			pyramid,
+			kViewProjection,
+			kObjectCount,
+			Phase::kEarly);
+		populate_cmd_build_depth_pyramid(command_buffer, pipelines, pyramid, depth_image.get());
+		populate_cmd_hiz_cull(
+			command_buffer,
+			pipelines,
+			buffers,
+			pyramid,
+			kViewProjection,
+			kObjectCount,
+			Phase::kLate);
+
+		VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
+		draw::submit_command_buffer(queue, command_buffer, nullptr, nullptr);
+		VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+
+		return buffers;
+	};
+
+	auto const check_culled = [&](HizCullBuffers const & buffers)
+	{
+		std::vector<float> const expected_texels = build_depth_pyramid(depth, pyramid.levels);
+		CHECK(std::ranges::equal(pyramid.texels, expected_texels));
+
+		for (std::size_t object_idx = 0; object_idx < kBounds.size(); ++object_idx)
+		{
+			CAPTURE(object_idx);
+			CHECK(
+				test_visibility(
+					kViewProjection, kBounds[object_idx], expected_texels, pyramid.levels) ==
+				std::array{
+					Visibility::kOccluded,
+					Visibility::kVisible,
+					Visibility::kVisible,
+					Visibility::kOutsideFrustum,
+					Visibility::kOccluded}[object_idx]);
+		}
+
+		CHECK(std::ranges::equal(
+			buffers.states,
+			std::array{
+				ObjectState::kOccluded,
+				ObjectState::kDrawnEarly,
+				ObjectState::kDrawnEarly,
+				ObjectState::kOutsideFrustum,
+				ObjectState::kOccluded}));
+
+		HizCounters const & counters = buffers.counters.front();
+		CHECK(counters.early_draw_count == 2);
+		CHECK(counters.late_draw_count == 0);
+		CHECK(counters.occluded_count == 2);
+		CHECK(counters.outside_frustum_count == 1);
+		logger->info(
+			"Occlusion culling removed {} of {} draws", counters.occluded_count, kObjectCount);
+	};
+
+	SUBCASE("compacted")
+	{
+		if (!compact)
+		{
+			MESSAGE("Skipping compacted culling, since drawIndirectCount is not supported");
+			return;
+		}
+
+		HizCullBuffers const buffers = cull(true);
+		check_culled(buffers);
+
+		std::array<uint32_t, 2> visible_ids{
+			buffers.early_commands[0].firstInstance, buffers.early_commands[1].firstInstance};
+		std::ranges::sort(visible_ids);
+		CHECK(visible_ids == std::array<uint32_t, 2>{1, 2});
+	}
+
+	SUBCASE("in place")
+	{
+		HizCullBuffers const buffers = cull(false);
+		check_culled(buffers);
+
+		std::vector<uint32_t> const early_instance_counts = buffers.early_commands |
+			std::views::transform(&VkDrawIndexedIndirectCommand::instanceCount) |
+			ranges::to<std::vector>();
+		CHECK(early_instance_counts == std::vector<uint32_t>{0, 1, 1, 0, 0});
+		std::vector<uint32_t> const late_instance_counts = buffers.late_commands |
+			std::views::transform(&VkDrawIndexedIndirectCommand::instanceCount) |
+			ranges::to<std::vector>();
+		CHECK(late_instance_counts == std::vector<uint32_t>{0, 0, 0, 0, 0});
+	}
+}
+}  // namespace vulkandemo::hiz
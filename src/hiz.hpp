@@ -0,0 +1,335 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "compute.hpp"
+#include "gpu_cull.hpp"
+#include "maths.hpp"
+#include "types.hpp"
+
+/**
+ * Hierarchical-Z occlusion culling.
+ *
+ * A depth pyramid is built by compute from a depth buffer, each level holding the farthest depth of
+ * the 2x2 texels beneath it. An object is occluded if the nearest depth of its bounds is farther
+ * than the pyramid at the level where its screen rect covers at most 2x2 texels.
+ *
+ * Culling is two-phase, so that objects revealed by camera or scene motion do not pop in a frame
+ * late:
+ *
+ *  1. Build the pyramid from the previous frame's depth, then cull with Phase::kEarly and draw the
+ *     survivors, clearing depth.
+ *  2. Rebuild the pyramid from the depth of those draws, then cull with Phase::kLate, which only
+ *     re-tests objects the early phase found occluded, and draw the newly visible, loading depth.
+ *
+ * Depth must be VK_FORMAT_D32_SFLOAT with nearer surfaces having smaller depth, rendered with a
+ * viewport covering the whole image. Pyramid and culling dispatches are recorded with the compute
+ * module, so the device must be created with the `synchronization2` feature enabled.
+ */
+namespace vulkandemo::hiz
+{
+/// Depth format the pyramid can be built from.
+inline constexpr VkFormat kDepthFormat = VK_FORMAT_D32_SFLOAT;
+/// Work group size of `hiz_downsample.comp`.
+inline constexpr std::array<uint32_t, 3> kDownsampleWorkGroupSize{8, 8, 1};
+/// Work group size of `hiz_cull.comp`.
+inline constexpr uint32_t kCullWorkGroupSize = 64;
+
+enum class Phase : uint8_t
+{
+	/// Test every object against the previous frame's depth.
+	kEarly,
+	/// Re-test objects occluded in the early phase against the early phase's depth.
+	kLate
+};
+
+/**
+ * Outcome of culling an object, per phase. Values match `hiz_cull.comp`.
+ */
+enum class ObjectState : uint32_t
+{
+	kOutsideFrustum,
+	kDrawnEarly,
+	/// Occluded in the early phase, to be re-tested in the late phase.
+	kRetest,
+	kDrawnLate,
+	/// Occluded in both phases, i.e. removed by occlusion culling.
+	kOccluded
+};
+
+/**
+ * Per-frame counts written by the culling dispatches, reset by the early phase.
+ */
+struct HizCounters
+{
+	/// Draw count of the early phase's commands.
+	uint32_t early_draw_count;
+	/// Draw count of the late phase's commands.
+	uint32_t late_draw_count;
+	/// Draws removed by occlusion culling, i.e. inside the frustum but occluded in both phases.
+	uint32_t occluded_count;
+	/// Draws removed by frustum culling.
+	uint32_t outside_frustum_count;
+};
+static_assert(sizeof(HizCounters) == 16);
+
+/**
+ * Level of a depth pyramid, stored tightly packed in row-major order.
+ */
+struct PyramidLevel
+{
+	VkExtent2D extent;
+	/// Offset in texels from the start of the pyramid.
+	uint32_t offset;
+};
+
+/**
+ * Screen space bounds of an object, in pixels of the depth buffer from the top left.
+ */
+struct ScreenRect
+{
+	std::array<float, 2> min;
+	std::array<float, 2> max;
+	/// Nearest depth of the bounds.
+	float nearest_depth;
+};
+
+enum class Visibility : uint8_t
+{
+	kOutsideFrustum,
+	kOccluded,
+	kVisible
+};
+
+/**
+ * Kernels building the pyramid and culling against it.
+ */
+struct HizPipelines
+{
+	compute::ComputeKernel downsample;
+	compute::ComputeKernel cull;
+};
+
+/**
+ * Depth pyramid as a persistently mapped storage buffer of floats, levels finest first.
+ */
+struct DepthPyramid
+{
+	/// Extent of the depth buffer, i.e. of level 0.
+	VkExtent2D extent;
+	std::vector<PyramidLevel> levels;
+	types::VulkanBufferPtr buffer;
+	types::VulkanDeviceMemoryPtr memory;
+	std::span<float> texels;
+	/// Binds buffer to the downsample kernel.
+	compute::ComputeBindings bindings;
+};
+
+/**
+ * Storage buffers of a scene culled against a depth pyramid, with the descriptor set binding them.
+ *
+ * As per gpu_cull::GpuCullBuffers, bounds and draw records are written in place by the host, and
+ * commands, counters and states may be read back by the host after the frame's work completes.
+ */
+struct HizCullBuffers
+{
+	types::VulkanBufferPtr bounds_buffer;
+	types::VulkanDeviceMemoryPtr bounds_memory;
+	std::span<gpu_cull::ObjectBounds> bounds;
+
+	types::VulkanBufferPtr draws_buffer;
+	types::VulkanDeviceMemoryPtr draws_memory;
+	std::span<gpu_cull::DrawRecord> draws;
+
+	types::VulkanBufferPtr early_commands_buffer;
+	types::VulkanDeviceMemoryPtr early_commands_memory;
+	std::span<VkDrawIndexedIndirectCommand> early_commands;
+
+	types::VulkanBufferPtr late_commands_buffer;
+	types::VulkanDeviceMemoryPtr late_commands_memory;
+	std::span<VkDrawIndexedIndirectCommand> late_commands;
+
+	/// Also the draw count buffer of both phases, see populate_cmd_draw_hiz_culled.
+	types::VulkanBufferPtr counters_buffer;
+	types::VulkanDeviceMemoryPtr counters_memory;
+	std::span<HizCounters> counters;
+
+	types::VulkanBufferPtr states_buffer;
+	types::VulkanDeviceMemoryPtr states_memory;
+	std::span<ObjectState> states;
+
+	/// Binds the above plus the pyramid to the cull kernel.
+	compute::ComputeBindings bindings;
+
+	/// Whether visible draws are compacted, see gpu_cull::GpuCullBuffers::compact.
+	bool compact;
+};
+
+/**
+ * Levels of a pyramid over a depth buffer, each half the extent of the last rounding up, down to
+ * 1x1.
+ *
+ * @param extent Extent of the depth buffer.
+ * @return
+ */
+std::vector<PyramidLevel> pyramid_levels(VkExtent2D extent);
+
+/**
+ * Reduce a depth buffer to a pyramid on the host, as a reference for the downsample kernel.
+ *
+ * @param depth Row-major depth, i.e. level 0.
+ * @param levels See pyramid_levels.
+ * @return Texels of all levels.
+ */
+std::vector<float> build_depth_pyramid(
+	std::span<float const> depth, std::span<PyramidLevel const> levels);
+
+/**
+ * Project an object's bounds to the screen.
+ *
+ * The bounds' axis aligned box is projected, so the rect is conservative.
+ *
+ * @param view_projection
+ * @param bounds World space bounding sphere.
+ * @param extent Extent of the depth buffer.
+ * @return Nothing if the bounds cross the near plane, and so cannot be tested for occlusion.
+ */
+std::optional<ScreenRect> project_bounds(
+	maths::Mat4 const & view_projection,
+	gpu_cull::ObjectBounds const & bounds,
+	VkExtent2D extent);
+
+/**
+ * Level at which a rect covers at most 2x2 texels.
+ *
+ * @param rect
+ * @param level_count
+ * @return
+ */
+uint32_t pyramid_level_for(ScreenRect const & rect, uint32_t level_count);
+
+/**
+ * Test an object against the frustum and a depth pyramid on the host, as per `hiz_cull.comp`.
+ *
+ * @param view_projection
+ * @param bounds World space bounding sphere.
+ * @param texels Texels of all levels, see build_depth_pyramid.
+ * @param levels See pyramid_levels.
+ * @return
+ */
+Visibility test_visibility(
+	maths::Mat4 const & view_projection,
+	gpu_cull::ObjectBounds const & bounds,
+	std::span<float const> texels,
+	std::span<PyramidLevel const> levels);
+
+/**
+ * Create the downsample and cull kernels.
+ *
+ * @param device
+ * @return
+ */
+HizPipelines create_hiz_pipelines(types::VulkanDevicePtr const & device);
+
+/**
+ * Create a depth pyramid for a depth buffer of a given extent.
+ *
+ * @param device
+ * @param memory_type_idx Host visible and host coherent memory type.
+ * @param pipelines
+ * @param extent Extent of the depth buffer.
+ * @return
+ */
+DepthPyramid create_depth_pyramid(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx memory_type_idx,
+	HizPipelines const & pipelines,
+	VkExtent2D extent);
+
+/**
+ * Create the buffers of a culled scene.
+ *
+ * @param device
+ * @param memory_type_idx Host visible and host coherent memory type.
+ * @param pipelines
+ * @param pyramid Pyramid to cull against. Must outlive use of the buffers' descriptor set.
+ * @param capacity Maximum number of objects.
+ * @param compact Whether to compact draws, requiring the `drawIndirectCount` feature, see
+ * gpu_cull::supports_draw_indirect_count.
+ * @return
+ */
+HizCullBuffers create_hiz_cull_buffers(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx memory_type_idx,
+	HizPipelines const & pipelines,
+	DepthPyramid const & pyramid,
+	gpu_cull::ObjectCount capacity,
+	bool compact);
+
+/**
+ * Record a rebuild of the pyramid from a depth buffer.
+ *
+ * Level 0 is copied from the depth image, then each subsequent level is reduced from the last,
+ * with barriers between levels. The pyramid is left readable by culling and by the host.
+ *
+ * Must be recorded outside of a render pass.
+ *
+ * @param command_buffer
+ * @param pipelines
+ * @param pyramid
+ * @param depth_image Image of kDepthFormat, in the transfer source layout with its depth writes
+ * made visible to transfers, e.g. by a render graph pass with render_graph::Access::kTransferRead.
+ */
+void populate_cmd_build_depth_pyramid(
+	VkCommandBuffer command_buffer,
+	HizPipelines const & pipelines,
+	DepthPyramid const & pyramid,
+	VkImage depth_image);
+
+/**
+ * Record a culling phase against the pyramid's current contents.
+ *
+ * The early phase resets the counters. Commands and counters are left readable by indirect draws
+ * and by the host.
+ *
+ * Must be recorded outside of a render pass.
+ *
+ * @param command_buffer
+ * @param pipelines
+ * @param buffers
+ * @param pyramid Pyramid bound to @p buffers.
+ * @param view_projection Of the frame being drawn, in both phases.
+ * @param object_count
+ * @param phase
+ */
+void populate_cmd_hiz_cull(
+	VkCommandBuffer command_buffer,
+	HizPipelines const & pipelines,
+	HizCullBuffers const & buffers,
+	DepthPyramid const & pyramid,
+	maths::Mat4 const & view_projection,
+	gpu_cull::ObjectCount object_count,
+	Phase phase);
+
+/**
+ * Record the indirect draws of a culling phase, within a rendering scope.
+ *
+ * @param command_buffer
+ * @param buffers
+ * @param object_count As given to populate_cmd_hiz_cull.
+ * @param phase
+ */
+void populate_cmd_draw_hiz_culled(
+	VkCommandBuffer command_buffer,
+	HizCullBuffers const & buffers,
+	gpu_cull::ObjectCount object_count,
+	Phase phase);
+}  // namespace vulkandemo::hiz
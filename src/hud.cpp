@@ -0,0 +1,836 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "hud.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner)
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `VK_CHECK`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "barrier.hpp"
+#include "batch.hpp"
+#include "bench.hpp"
+#include "draw.hpp"
+#include "macros.hpp"
+#include "render_graph.hpp"
+#include "setup.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::hud
+{
+namespace
+{
+/// First character with a glyph. Glyphs follow in ASCII order.
+constexpr char kFirstGlyph = ' ';
+
+/**
+ * 5x7 glyphs from ' ' to '_', one byte per row from the top, leftmost texel in bit 4.
+ */
+constexpr std::array<std::array<uint8_t, kGlyphHeight>, 64> kGlyphs{{
+	{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},	 // ' '
+	{0x04, 0x04, 0x04, 0x04, 0x00, 0x00, 0x04},	 // '!'
+	{0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00},	 // '"'
+	{0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A},	 // '#'
+	{0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04},	 // '$'
+	{0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03},	 // '%'
+	{0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D},	 // '&'
+	{0x0C, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00},	 // '''
+	{0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02},	 // '('
+	{0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08},	 // ')'
+	{0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00},	 // '*'
+	{0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00},	 // '+'
+	{0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08},	 // ','
+	{0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00},	 // '-'
+	{0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C},	 // '.'
+	{0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00},	 // '/'
+	{0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E},	 // '0'
+	{0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E},	 // '1'
+	{0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F},	 // '2'
+	{0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E},	 // '3'
+	{0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02},	 // '4'
+	{0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E},	 // '5'
+	{0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E},	 // '6'
+	{0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08},	 // '7'
+	{0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E},	 // '8'
+	{0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C},	 // '9'
+	{0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00},	 // ':'
+	{0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08},	 // ';'
+	{0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02},	 // '<'
+	{0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00},	 // '='
+	{0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08},	 // '>'
+	{0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04},	 // '?'
+	{0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E},	 // '@'
+	{0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11},	 // 'A'
+	{0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E},	 // 'B'
+	{0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E},	 // 'C'
+	{0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C},	 // 'D'
+	{0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F},	 // 'E'
+	{0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10},	 // 'F'
+	{0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F},	 // 'G'
+	{0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11},	 // 'H'
+	{0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E},	 // 'I'
+	{0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C},	 // 'J'
+	{0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11},	 // 'K'
+	{0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F},	 // 'L'
+	{0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11},	 // 'M'
+	{0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11},	 // 'N'
+	{0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},	 // 'O'
+	{0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10},	 // 'P'
+	{0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D},	 // 'Q'
+	{0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11},	 // 'R'
+	{0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E},	 // 'S'
+	{0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04},	 // 'T'
+	{0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E},	 // 'U'
+	{0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04},	 // 'V'
+	{0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A},	 // 'W'
+	{0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11},	 // 'X'
+	{0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04},	 // 'Y'
+	{0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F},	 // 'Z'
+	{0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E},	 // '['
+	{0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00},	 // '\'
+	{0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E},	 // ']'
+	{0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00},	 // '^'
+	{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F},	 // '_'
+}};
+
+/// Atlas cells, including a one texel gap right of and below each glyph.
+constexpr uint32_t kCellWidth = kGlyphWidth + 1;
+constexpr uint32_t kCellHeight = kGlyphHeight + 1;
+constexpr uint32_t kAtlasColumns = 16;
+/// Fully opaque cell after the glyphs, for untextured rectangles such as graph bars.
+constexpr std::size_t kSolidCell = kGlyphs.size();
+constexpr VkExtent2D kAtlasExtent{
+	kAtlasColumns * kCellWidth, (kSolidCell / kAtlasColumns + 1) * kCellHeight};
+
+/// Framebuffer pixels per font texel.
+constexpr float kTextScale = 2.0F;
+constexpr float kLineHeight = (kCellHeight + 1) * kTextScale;
+constexpr float kMargin = 8.0F;
+constexpr float kPadding = 6.0F;
+constexpr float kBarWidth = 2.0F;
+constexpr float kGraphWidth = kBarWidth * kHistoryLength;
+constexpr float kGraphHeight = 40.0F;
+/// Frame time of the reference line drawn across each graph, i.e. 60 Hz.
+constexpr float kTargetFrameMs = 1000.0F / 60.0F;
+/// Minimum frame time at the top of a graph, so that the reference line is always visible.
+constexpr float kMinGraphRangeMs = 2.0F * kTargetFrameMs;
+/// Longest line of text, in characters.
+constexpr std::size_t kMaxLineLength = 32;
+
+constexpr uint32_t kPanelColour = batch::pack_colour(0.0F, 0.0F, 0.0F, 0.6F);
+constexpr uint32_t kTextColour = batch::pack_colour(1.0F, 1.0F, 1.0F, 1.0F);
+constexpr uint32_t kReferenceColour = batch::pack_colour(1.0F, 1.0F, 1.0F, 0.4F);
+constexpr uint32_t kCpuBarColour = batch::pack_colour(0.3F, 0.9F, 0.3F, 0.9F);
+constexpr uint32_t kGpuBarColour = batch::pack_colour(1.0F, 0.6F, 0.1F, 0.9F);
+constexpr uint32_t kSlowBarColour = batch::pack_colour(1.0F, 0.2F, 0.2F, 0.9F);
+
+constexpr std::size_t glyph_cell(char const character)
+{
+	char const upper = character >= 'a' && character <= 'z'
+		? static_cast<char>(character - 'a' + 'A')
+		: character;
+	if (upper < kFirstGlyph || static_cast<std::size_t>(upper - kFirstGlyph) >= kGlyphs.size())
+		return static_cast<std::size_t>('?' - kFirstGlyph);
+	return static_cast<std::size_t>(upper - kFirstGlyph);
+}
+
+std::array<uint16_t, 4> cell_atlas_rect(std::size_t const cell)
+{
+	auto const to_unorm16 = [](uint32_t const texel, uint32_t const size)
+	{
+		return static_cast<uint16_t>(std::lround(
+			static_cast<double>(texel) / static_cast<double>(size) * UINT16_MAX));
+	};
+	auto const column = static_cast<uint32_t>(cell % kAtlasColumns);
+	auto const row = static_cast<uint32_t>(cell / kAtlasColumns);
+	return {
+		to_unorm16(column * kCellWidth, kAtlasExtent.width),
+		to_unorm16(row * kCellHeight, kAtlasExtent.height),
+		to_unorm16(column * kCellWidth + kGlyphWidth, kAtlasExtent.width),
+		to_unorm16(row * kCellHeight + kGlyphHeight, kAtlasExtent.height)};
+}
+
+/**
+ * Solid rectangle, sampling the solid atlas cell so it can share the text's draw.
+ */
+batch::Instance make_solid_instance(
+	float const x, float const y, float const width, float const height, uint32_t const colour)
+{
+	static std::array<uint16_t, 4> const solid_rect = cell_atlas_rect(kSolidCell);
+	return batch::make_rect_instance(x, y, width, height, colour, solid_rect);
+}
+
+/**
+ * Append a line of text, skipping blank glyphs.
+ *
+ * @return Width of the line in pixels.
+ */
+float push_text(
+	std::vector<batch::Instance> & instances,
+	float const x,
+	float const y,
+	std::string_view const text)
+{
+	constexpr std::size_t blank_cell = glyph_cell(' ');
+	float pen_x = x;
+	for (char const character : text)
+	{
+		std::size_t const cell = glyph_cell(character);
+		if (cell != blank_cell)
+			instances.push_back(batch::make_rect_instance(
+				pen_x,
+				y,
+				kGlyphWidth * kTextScale,
+				kGlyphHeight * kTextScale,
+				kTextColour,
+				cell_atlas_rect(cell)));
+		pen_x += kCellWidth * kTextScale;
+	}
+	return pen_x - x;
+}
+
+/**
+ * Append a bar graph of a ring of frame times, oldest on the left, skipping unmeasured frames.
+ */
+void push_graph(
+	std::vector<batch::Instance> & instances,
+	float const x,
+	float const y,
+	std::array<float, kHistoryLength> const & frame_ms,
+	std::size_t const next,
+	uint32_t const colour)
+{
+	float const range_ms = std::max(std::ranges::max(frame_ms), kMinGraphRangeMs);
+	float const pixels_per_ms = kGraphHeight / range_ms;
+	float const bottom = y + kGraphHeight;
+
+	for (std::size_t idx = 0; idx < kHistoryLength; ++idx)
+	{
+		float const ms = frame_ms[(next + idx) % kHistoryLength];
+		if (ms <= 0.0F)
+			continue;
+		float const height = std::max(ms * pixels_per_ms, 1.0F);
+		instances.push_back(make_solid_instance(
+			x + static_cast<float>(idx) * kBarWidth,
+			bottom - height,
+			kBarWidth,
+			height,
+			ms > kTargetFrameMs ? kSlowBarColour : colour));
+	}
+
+	instances.push_back(make_solid_instance(
+		x, bottom - kTargetFrameMs * pixels_per_ms, kGraphWidth, 1.0F, kReferenceColour));
+}
+
+/**
+ * Record a copy of the atlas from a staging buffer, leaving it ready to be sampled.
+ */
+void populate_cmd_upload_atlas(
+	VkCommandBuffer command_buffer, VkImage image, VkBuffer staging_buffer)
+{
+	using render_graph::Access;
+	using render_graph::state_of;
+	constexpr VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+	barrier::populate_cmd_barriers(
+		command_buffer,
+		std::nullopt,
+		std::array{barrier::image_barrier(image, range, {}, state_of(Access::kTransferWrite))});
+
+	VkBufferImageCopy const region{
+		.bufferOffset = 0,
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+		.imageOffset = {0, 0, 0},
+		.imageExtent = {kAtlasExtent.width, kAtlasExtent.height, 1}};
+	vkCmdCopyBufferToImage(
+		command_buffer, staging_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	barrier::populate_cmd_barriers(
+		command_buffer,
+		std::nullopt,
+		std::array{barrier::image_barrier(
+			image,
+			range,
+			state_of(Access::kTransferWrite),
+			state_of(Access::kFragmentShaderSampled))});
+}
+}  // namespace
+
+FontAtlas create_font_atlas()
+{
+	constexpr std::size_t texel_size = 4;
+	FontAtlas atlas{
+		.extent = kAtlasExtent,
+		.texels = std::vector<std::byte>(
+			std::size_t{kAtlasExtent.width} * kAtlasExtent.height * texel_size)};
+
+	auto const set_texel = [&](std::size_t const cell, uint32_t const x, uint32_t const y)
+	{
+		std::size_t const atlas_x = (cell % kAtlasColumns) * kCellWidth + x;
+		std::size_t const atlas_y = (cell / kAtlasColumns) * kCellHeight + y;
+		std::ranges::fill(
+			std::span{atlas.texels}.subspan(
+				(atlas_y * kAtlasExtent.width + atlas_x) * texel_size, texel_size),
+			std::byte{0xFF});
+	};
+
+	// Texels that are not set are transparent black, i.e. zero.
+	for (std::size_t cell = 0; cell < kGlyphs.size(); ++cell)
+		for (uint32_t y = 0; y < kGlyphHeight; ++y)
+			for (uint32_t x = 0; x < kGlyphWidth; ++x)
+				if (((kGlyphs[cell][y] >> (kGlyphWidth - 1 - x)) & 1U) != 0)
+					set_texel(cell, x, y);
+
+	for (uint32_t y = 0; y < kCellHeight; ++y)
+		for (uint32_t x = 0; x < kCellWidth; ++x)
+			set_texel(kSolidCell, x, y);
+
+	return atlas;
+}
+
+std::array<uint16_t, 4> glyph_atlas_rect(char const character)
+{
+	return cell_atlas_rect(glyph_cell(character));
+}
+
+void record_frame(FrameHistory & history, FrameStats const & stats)
+{
+	history.cpu_frame_ms[history.next] = static_cast<float>(stats.cpu_frame_ms);
+	history.gpu_frame_ms[history.next] = static_cast<float>(stats.gpu_frame_ms.value_or(0.0));
+	history.next = (history.next + 1) % kHistoryLength;
+}
+
+void layout_hud(
+	std::vector<batch::Instance> & instances,
+	FrameStats const & stats,
+	FrameHistory const & history)
+{
+	instances.clear();
+	// Panel is sized once the content is known.
+	instances.push_back({});
+
+	float const left = kMargin + kPadding;
+	float y = kMargin + kPadding;
+	float width = kGraphWidth;
+
+	// Formatted in place, so that steady state layout never allocates.
+	std::array<char, kMaxLineLength> line{};
+	auto const format = [&line]<typename... Args>(
+							std::format_string<Args...> const fmt, Args &&... args)
+	{
+		auto const result =
+			std::format_to_n(line.data(), line.size(), fmt, std::forward<Args>(args)...);
+		return std::string_view{line.data(), result.out};
+	};
+	auto const print = [&](std::string_view const text)
+	{
+		width = std::max(width, push_text(instances, left, y, text));
+		y += kLineHeight;
+	};
+
+	print(format("CPU     {:6.2f} MS", stats.cpu_frame_ms));
+	print(
+		stats.gpu_frame_ms ? format("GPU     {:6.2f} MS", *stats.gpu_frame_ms)
+						   : "GPU        N/A");
+	print(
+		stats.present_to_idle_ms ? format("TO IDLE {:6.2f} MS", *stats.present_to_idle_ms)
+								 : "TO IDLE    N/A");
+	print(format("DRAWS   {}", stats.draw_count));
+	print(format("INST    {}", stats.instance_count));
+	constexpr VkDeviceSize mebibyte = VkDeviceSize{1} << 20U;
+	print(
+		stats.memory ? format(
+						   "MEM     {}/{} MIB",
+						   stats.memory->used / mebibyte,
+						   stats.memory->budget / mebibyte)
+					 : "MEM        N/A");
+
+	y += kPadding;
+	push_graph(instances, left, y, history.cpu_frame_ms, history.next, kCpuBarColour);
+	y += kGraphHeight + kPadding;
+	if (stats.gpu_frame_ms)
+	{
+		push_graph(instances, left, y, history.gpu_frame_ms, history.next, kGpuBarColour);
+		y += kGraphHeight + kPadding;
+	}
+
+	// Each section is followed by padding, so y is now the bottom of the panel.
+	instances.front() =
+		make_solid_instance(kMargin, kMargin, width + 2 * kPadding, y - kMargin, kPanelColour);
+}
+
+MemoryUsage query_memory_usage(VkPhysicalDevice physical_device)
+{
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+		.pNext = nullptr,
+		.heapBudget = {},
+		.heapUsage = {}};
+	VkPhysicalDeviceMemoryProperties2 properties{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+		.pNext = &budget_properties,
+		.memoryProperties = {}};
+	vkGetPhysicalDeviceMemoryProperties2(physical_device, &properties);
+
+	MemoryUsage usage{.used = 0, .budget = 0};
+	for (uint32_t heap_idx = 0; heap_idx < properties.memoryProperties.memoryHeapCount; ++heap_idx)
+	{
+		if ((properties.memoryProperties.memoryHeaps[heap_idx].flags &
+			 VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0)
+			continue;
+		usage.used += budget_properties.heapUsage[heap_idx];
+		usage.budget += budget_properties.heapBudget[heap_idx];
+	}
+	return usage;
+}
+
+Hud create_hud(
+	types::VulkanDevicePtr const & device,
+	VkPhysicalDevice physical_device,
+	types::VulkanQueueFamilyIdx const queue_family_idx,
+	VkQueue queue,
+	types::VulkanMemoryTypeIdx const memory_type_idx,
+	batch::SpritePipelines const & pipelines)
+{
+	constexpr VkFormat atlas_format = VK_FORMAT_R8G8B8A8_UNORM;
+	FontAtlas const atlas = create_font_atlas();
+
+	auto [atlas_image, atlas_memory] = setup::create_image_and_memory(
+		device,
+		physical_device,
+		atlas_format,
+		atlas.extent,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+	types::VulkanImageViewPtr atlas_view =
+		setup::create_image_view(device, atlas_image.get(), atlas_format);
+
+	// Nearest filtering, so glyphs stay crisp at integer scales.
+	types::VulkanSamplerPtr sampler = [&]
+	{
+		VkSamplerCreateInfo const create_info{
+			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.magFilter = VK_FILTER_NEAREST,
+			.minFilter = VK_FILTER_NEAREST,
+			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+			.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.mipLodBias = 0.0F,
+			.anisotropyEnable = VK_FALSE,
+			.maxAnisotropy = 1.0F,
+			.compareEnable = VK_FALSE,
+			.compareOp = VK_COMPARE_OP_ALWAYS,
+			.minLod = 0.0F,
+			.maxLod = 0.0F,
+			.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+			.unnormalizedCoordinates = VK_FALSE};
+		VkSampler out = nullptr;
+		VK_CHECK(
+			vkCreateSampler(device.get(), &create_info, nullptr, &out), "Failed to create sampler");
+		return types::make_sampler_ptr(device, out);
+	}();
+
+	constexpr std::array pool_sizes{VkDescriptorPoolSize{
+		.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1}};
+	types::VulkanDescriptorPoolPtr descriptor_pool =
+		setup::create_descriptor_pool(device, 1, pool_sizes);
+	VkDescriptorSet descriptor_set =
+		setup::allocate_descriptor_set(device, descriptor_pool, pipelines.texture_set_layout);
+
+	VkDescriptorImageInfo const image_info{
+		.sampler = sampler.get(),
+		.imageView = atlas_view.get(),
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+	VkWriteDescriptorSet const write{
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.pNext = nullptr,
+		.dstSet = descriptor_set,
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.pImageInfo = &image_info,
+		.pBufferInfo = nullptr,
+		.pTexelBufferView = nullptr};
+	vkUpdateDescriptorSets(device.get(), 1, &write, 0, nullptr);
+
+	// One-off upload. The atlas is tiny, so waiting for it is cheaper than tracking it.
+	{
+		auto [staging_buffer, staging_memory, staging_bytes] =
+			draw::create_exclusive_mapped_buffer_and_memory(
+				device, memory_type_idx, atlas.texels.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+		std::ranges::copy(atlas.texels, staging_bytes.begin());
+
+		types::VulkanCommandPoolPtr const command_pool =
+			setup::create_command_pool(device, queue_family_idx);
+		types::VulkanCommandBuffersPtr const command_buffers =
+			setup::create_primary_command_buffers(
+				device, command_pool, types::VulkanCommandBufferCount{1});
+		VkCommandBuffer command_buffer = command_buffers->front();
+
+		VkCommandBufferBeginInfo const begin_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.pNext = nullptr,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			.pInheritanceInfo = nullptr};
+		VK_CHECK(
+			vkBeginCommandBuffer(command_buffer, &begin_info),
+			"Failed to begin font atlas upload command buffer");
+		populate_cmd_upload_atlas(command_buffer, atlas_image.get(), staging_buffer.get());
+		VK_CHECK(
+			vkEndCommandBuffer(command_buffer), "Failed to end font atlas upload command buffer");
+
+		types::VulkanFencePtr const fence = setup::create_fence(device, false);
+		draw::submit_command_buffer(queue, command_buffer, nullptr, nullptr, fence);
+		VkFence fence_handle = fence.get();
+		VK_CHECK(
+			vkWaitForFences(device.get(), 1, &fence_handle, VK_TRUE, UINT64_MAX),
+			"Failed to wait for font atlas upload");
+	}
+
+	Hud hud{
+		.atlas_image = std::move(atlas_image),
+		.atlas_memory = std::move(atlas_memory),
+		.atlas_view = std::move(atlas_view),
+		.sampler = std::move(sampler),
+		.descriptor_pool = std::move(descriptor_pool),
+		.descriptor_set = descriptor_set,
+		.batch = batch::create_sprite_batch(device, memory_type_idx, kMaxInstances),
+		.history = {},
+		.instances = {}};
+	hud.instances.reserve(kMaxInstances);
+	return hud;
+}
+
+void update_hud(Hud & hud, batch::SpritePipelines const & pipelines, FrameStats const & stats)
+{
+	record_frame(hud.history, stats);
+	layout_hud(hud.instances, stats, hud.history);
+
+	// A single state, so a single run and so a single draw.
+	batch::clear_sprite_batch(hud.batch);
+	batch::push_sprite_instances(
+		hud.batch,
+		{.pipeline = pipelines.textured.get(), .texture = hud.descriptor_set},
+		hud.instances);
+	batch::finalise_sprite_batch(hud.batch);
+}
+
+void populate_cmd_hud(
+	VkCommandBuffer command_buffer,
+	Hud const & hud,
+	batch::SpritePipelines const & pipelines,
+	VkExtent2D const extent)
+{
+	batch::populate_cmd_sprite_batch(command_buffer, hud.batch, pipelines.layout, extent);
+}
+
+TEST_CASE("Rasterise the HUD font")
+{
+	FontAtlas const atlas = create_font_atlas();
+	REQUIRE(atlas.texels.size() == std::size_t{atlas.extent.width} * atlas.extent.height * 4);
+
+	auto const alpha_at = [&](std::array<uint16_t, 4> const & rect, uint32_t x, uint32_t y)
+	{
+		auto const texel_x = static_cast<std::size_t>(std::lround(
+			static_cast<double>(rect[0]) / UINT16_MAX * atlas.extent.width));
+		auto const texel_y = static_cast<std::size_t>(std::lround(
+			static_cast<double>(rect[1]) / UINT16_MAX * atlas.extent.height));
+		return atlas.texels[((texel_y + y) * atlas.extent.width + texel_x + x) * 4 + 3];
+	};
+
+	SUBCASE("glyph texels")
+	{
+		// Top row of 'T' is solid, the rest is a centred stem.
+		std::array<uint16_t, 4> const rect = glyph_atlas_rect('T');
+		for (uint32_t x = 0; x < kGlyphWidth; ++x)
+			CHECK(alpha_at(rect, x, 0) == std::byte{0xFF});
+		CHECK(alpha_at(rect, 0, 1) == std::byte{0});
+		CHECK(alpha_at(rect, 2, kGlyphHeight - 1) == std::byte{0xFF});
+		// Gap to the next cell is transparent.
+		CHECK(alpha_at(rect, kGlyphWidth, 0) == std::byte{0});
+	}
+
+	SUBCASE("glyph rects")
+	{
+		std::array<uint16_t, 4> const rect = glyph_atlas_rect('A');
+		CHECK(rect[0] < rect[2]);
+		CHECK(rect[1] < rect[3]);
+		CHECK(glyph_atlas_rect('a') == rect);
+		CHECK(glyph_atlas_rect('~') == glyph_atlas_rect('?'));
+		CHECK(glyph_atlas_rect('\n') == glyph_atlas_rect('?'));
+		CHECK(glyph_atlas_rect('B') != rect);
+	}
+}
+
+TEST_CASE("Lay out the HUD")
+{
+	FrameHistory history;
+	FrameStats stats{
+		.cpu_frame_ms = 1.5,
+		.gpu_frame_ms = 4.0,
+		.present_to_idle_ms = 8.25,
+		.draw_count = 3,
+		.instance_count = 1234,
+		.memory = MemoryUsage{.used = VkDeviceSize{300} << 20U, .budget = VkDeviceSize{4} << 30U}};
+
+	for (std::size_t frame = 0; frame < kHistoryLength + 1; ++frame)
+		record_frame(history, stats);
+	CHECK(history.next == 1);
+
+	std::vector<batch::Instance> instances;
+	layout_hud(instances, stats, history);
+	CHECK(instances.size() <= kMaxInstances);
+
+	// Everything lies within the panel, which is drawn first.
+	batch::Instance const & panel = instances.front();
+	for (batch::Instance const & instance : instances | std::views::drop(1))
+	{
+		CHECK(instance.translation[0] >= panel.translation[0]);
+		CHECK(instance.translation[1] >= panel.translation[1]);
+		CHECK(
+			instance.translation[0] + instance.basis_x[0] <=
+			panel.translation[0] + panel.basis_x[0]);
+		CHECK(
+			instance.translation[1] + instance.basis_y[1] <=
+			panel.translation[1] + panel.basis_y[1]);
+	}
+
+	SUBCASE("without GPU timings")
+	{
+		FrameStats cpu_only = stats;
+		cpu_only.gpu_frame_ms.reset();
+		cpu_only.memory.reset();
+		std::vector<batch::Instance> cpu_only_instances;
+		layout_hud(cpu_only_instances, cpu_only, history);
+
+		// The GPU graph is omitted.
+		CHECK(cpu_only_instances.size() + kHistoryLength < instances.size());
+		CHECK(cpu_only_instances.front().basis_y[1] < panel.basis_y[1]);
+	}
+
+	SUBCASE("worst case")
+	{
+		FrameStats const large{
+			.cpu_frame_ms = 99999.99,
+			.gpu_frame_ms = 99999.99,
+			.present_to_idle_ms = 99999.99,
+			.draw_count = UINT32_MAX,
+			.instance_count = UINT32_MAX,
+			.memory = MemoryUsage{.used = UINT64_MAX, .budget = UINT64_MAX}};
+		for (std::size_t frame = 0; frame < kHistoryLength; ++frame)
+			record_frame(history, large);
+		layout_hud(instances, large, history);
+		CHECK(instances.size() <= kMaxInstances);
+	}
+}
+
+TEST_CASE("Draw the HUD over a render graph pass")
+{
+	vulkandemo::LoggerPtr const logger =
+		vulkandemo::create_logger("Draw the HUD over a render graph pass");
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		nullptr,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+
+	constexpr VkMemoryPropertyFlags memory_flags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT,
+		memory_flags);
+
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE,
+		.dynamicRendering = VK_TRUE};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan13_features};
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{},
+		&features);
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	types::VulkanMemoryTypeIdx const memory_type_idx =
+		setup::filter_available_memory_types(logger, physical_device, memory_flags).at(0);
+
+	constexpr VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+	constexpr VkExtent2D extent{512, 512};
+	auto [target_image, target_memory] = setup::create_image_and_memory(
+		device,
+		physical_device,
+		format,
+		extent,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+	types::VulkanImageViewPtr const target_view =
+		setup::create_image_view(device, target_image.get(), format);
+
+	auto [readback_buffer, readback_memory, readback_bytes] =
+		draw::create_exclusive_mapped_buffer_and_memory(
+			device,
+			memory_type_idx,
+			VkDeviceSize{extent.width} * extent.height * 4,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+	batch::SpritePipelines const pipelines = batch::create_sprite_pipelines(device, format);
+	Hud hud =
+		create_hud(device, physical_device, queue_family_idx, queue, memory_type_idx, pipelines);
+	update_hud(
+		hud,
+		pipelines,
+		{.cpu_frame_ms = 1.0,
+		 .gpu_frame_ms = std::nullopt,
+		 .present_to_idle_ms = std::nullopt,
+		 .draw_count = 1,
+		 .instance_count = 0,
+		 .memory = std::nullopt});
+
+	// Exactly one draw for the whole overlay.
+	CHECK(hud.batch.runs.size() == 1);
+
+	// Clear to white, draw the overlay over it, then read back.
+	render_graph::RenderGraph graph;
+	render_graph::ResourceId const target = render_graph::import_image(
+		graph,
+		"target",
+		{.format = format, .extent = extent},
+		{.stages = VK_PIPELINE_STAGE_2_NONE,
+		 .access = VK_ACCESS_2_NONE,
+		 .layout = VK_IMAGE_LAYOUT_UNDEFINED});
+	render_graph::ResourceId const readback = render_graph::import_buffer(
+		graph,
+		"readback",
+		render_graph::state_of(render_graph::Access::kTransferWrite),
+		render_graph::state_of(render_graph::Access::kHostRead));
+	render_graph::add_pass(
+		graph,
+		{.name = "clear",
+		 .colour_attachments = {{.image = target, .clear_value = {.float32 = {1, 1, 1, 1}}}}});
+	render_graph::add_pass(
+		graph,
+		{.name = "hud",
+		 .colour_attachments = {{.image = target, .load_op = VK_ATTACHMENT_LOAD_OP_LOAD}},
+		 .record = [&](VkCommandBuffer cmd, render_graph::CompiledRenderGraph const &)
+		 { populate_cmd_hud(cmd, hud, pipelines, extent); }});
+	render_graph::add_pass(
+		graph,
+		{.name = "readback",
+		 .uses =
+			 {{.resource = target, .access = render_graph::Access::kTransferRead},
+			  {.resource = readback, .access = render_graph::Access::kTransferWrite}},
+		 .record =
+			 [&](VkCommandBuffer cmd, render_graph::CompiledRenderGraph const & compiled)
+		 {
+			 VkBufferImageCopy const region{
+				 .bufferOffset = 0,
+				 .bufferRowLength = 0,
+				 .bufferImageHeight = 0,
+				 .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+				 .imageOffset = {0, 0, 0},
+				 .imageExtent = {extent.width, extent.height, 1}};
+			 vkCmdCopyImageToBuffer(
+				 cmd,
+				 compiled.images[target.value_of()],
+				 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				 render_graph::buffer(compiled, readback),
+				 1,
+				 &region);
+		 }});
+
+	render_graph::CompiledRenderGraph compiled =
+		render_graph::compile_render_graph(device, physical_device, std::move(graph));
+	render_graph::bind_imported_image(compiled, target, target_image.get(), target_view.get());
+	render_graph::bind_imported_buffer(compiled, readback, readback_buffer.get());
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkCommandBuffer command_buffer = command_buffers->front();
+	render_graph::populate_cmd_render_graph(command_buffer, compiled);
+	draw::submit_command_buffer(queue, command_buffer, nullptr, nullptr);
+	VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+
+	auto const red_at = [&](uint32_t const x, uint32_t const y)
+	{ return std::to_integer<uint8_t>(readback_bytes[(std::size_t{y} * extent.width + x) * 4]); };
+
+	// Inside the translucent panel, in its margin, the white clear colour is darkened.
+	CHECK(red_at(10, 10) < 255);
+	// Outside the panel it is untouched.
+	CHECK(red_at(extent.width - 1, extent.height - 1) == 255);
+}
+
+TEST_CASE("Benchmark HUD layout" * doctest::test_suite("benchmark") * doctest::skip())
+{
+	vulkandemo::LoggerPtr const logger = vulkandemo::create_logger("Benchmark HUD layout");
+
+	// Host memory stands in for the mapped instance buffer, so this is the whole per-frame host
+	// cost of the overlay bar recording a single draw.
+	std::vector<batch::Instance> host_instances(kMaxInstances);
+	batch::SpriteBatch batch{.mapped_instances = host_instances};
+	batch.pending_instances.reserve(kMaxInstances);
+
+	FrameHistory history;
+	std::vector<batch::Instance> instances;
+	instances.reserve(kMaxInstances);
+
+	constexpr std::size_t kIterations = 10'000;
+	std::size_t frame = 0;
+	double const update_ms = bench::mean_ms(
+		kIterations,
+		[&]
+		{
+			++frame;
+			FrameStats const stats{
+				.cpu_frame_ms = static_cast<double>(frame % 20),
+				.gpu_frame_ms = static_cast<double>(frame % 17),
+				.present_to_idle_ms = 1.0,
+				.draw_count = static_cast<uint32_t>(frame),
+				.instance_count = static_cast<uint32_t>(frame * 3),
+				.memory = MemoryUsage{.used = frame << 20U, .budget = VkDeviceSize{8} << 30U}};
+			record_frame(history, stats);
+			layout_hud(instances, stats, history);
+			batch::clear_sprite_batch(batch);
+			batch::push_sprite_instances(batch, {}, instances);
+			batch::finalise_sprite_batch(batch);
+		});
+
+	logger->info("{} instances: update {:.4f} ms", instances.size(), update_ms);
+	CHECK(update_ms < 0.1);
+}
+}  // namespace vulkandemo::hud
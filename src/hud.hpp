@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "batch.hpp"
+#include "types.hpp"
+
+/**
+ * On-screen performance overlay.
+ *
+ * Frame timings, draw counts and memory usage are drawn as text from a small built-in bitmap font,
+ * alongside rolling graphs of recent frame times. Glyphs, graph bars and the backing panel are all
+ * sprite instances sampling a single font atlas, whose last cell is solid, so the whole overlay is
+ * one instanced draw with the textured sprite pipeline.
+ */
+namespace vulkandemo::hud
+{
+/// Glyph size in font texels, excluding the one texel gap to the next cell.
+inline constexpr uint32_t kGlyphWidth = 5;
+inline constexpr uint32_t kGlyphHeight = 7;
+/// Frames shown in the rolling graphs.
+inline constexpr std::size_t kHistoryLength = 128;
+/// Upper bound on the instances of a single overlay.
+inline constexpr batch::InstanceCount kMaxInstances{1024};
+
+struct MemoryUsage
+{
+	/// Bytes allocated by this process from device local heaps.
+	VkDeviceSize used;
+	/// Bytes this process can allocate from device local heaps without degrading performance.
+	VkDeviceSize budget;
+};
+
+/**
+ * Measurements of the last frame to show.
+ */
+struct FrameStats
+{
+	/// Host time spent building, recording and submitting the frame.
+	double cpu_frame_ms;
+	/// Device time spent executing the frame, if measured.
+	std::optional<double> gpu_frame_ms;
+	/// Host time from queueing the frame for presentation until the queue is idle, if measured.
+	/// Includes any device execution of the frame still outstanding, so is not present latency.
+	std::optional<double> present_to_idle_ms;
+	uint32_t draw_count;
+	uint32_t instance_count;
+	std::optional<MemoryUsage> memory;
+};
+
+/**
+ * Ring of recent frame times, for the rolling graphs.
+ */
+struct FrameHistory
+{
+	std::array<float, kHistoryLength> cpu_frame_ms{};
+	/// Zero where the GPU frame time was not measured.
+	std::array<float, kHistoryLength> gpu_frame_ms{};
+	/// Slot of the next frame to record, i.e. one past the newest.
+	std::size_t next = 0;
+};
+
+/**
+ * Texels of the built-in font, one cell per glyph, as white RGBA8 with coverage in alpha.
+ */
+struct FontAtlas
+{
+	VkExtent2D extent;
+	std::vector<std::byte> texels;
+};
+
+/**
+ * Overlay resources plus the batch its instances are packed into.
+ *
+ * The instance buffer is single-buffered, see batch::SpriteBatch.
+ */
+struct Hud
+{
+	types::VulkanImagePtr atlas_image;
+	types::VulkanDeviceMemoryPtr atlas_memory;
+	types::VulkanImageViewPtr atlas_view;
+	types::VulkanSamplerPtr sampler;
+	types::VulkanDescriptorPoolPtr descriptor_pool;
+	/// Font atlas bound for the textured sprite pipeline. Owned by descriptor_pool.
+	VkDescriptorSet descriptor_set;
+	batch::SpriteBatch batch;
+	FrameHistory history;
+	/// Scratch space for laying out instances, reused across frames.
+	std::vector<batch::Instance> instances;
+};
+
+/**
+ * Rasterise the built-in font.
+ *
+ * Covers printable ASCII up to and including '_', with lowercase letters drawn as uppercase.
+ *
+ * @return
+ */
+FontAtlas create_font_atlas();
+
+/**
+ * Sub-rect of the font atlas holding a glyph, see batch::Instance::atlas_rect.
+ *
+ * @param character Characters without a glyph map to '?'.
+ * @return
+ */
+std::array<uint16_t, 4> glyph_atlas_rect(char character);
+
+/**
+ * Append the last frame's timings to the rolling history.
+ *
+ * @param history
+ * @param stats
+ */
+void record_frame(FrameHistory & history, FrameStats const & stats);
+
+/**
+ * Lay out the overlay as sprite instances, in framebuffer pixels from the top left.
+ *
+ * @param instances Cleared, then filled with at most kMaxInstances instances.
+ * @param stats
+ * @param history
+ */
+void layout_hud(
+	std::vector<batch::Instance> & instances,
+	FrameStats const & stats,
+	FrameHistory const & history);
+
+/**
+ * Query device local memory usage.
+ *
+ * @param physical_device The device must have been created with VK_EXT_memory_budget enabled.
+ * @return
+ */
+MemoryUsage query_memory_usage(VkPhysicalDevice physical_device);
+
+/**
+ * Create the overlay, uploading the font atlas and waiting for the upload to complete.
+ *
+ * @param device
+ * @param physical_device
+ * @param queue_family_idx Family of @p queue.
+ * @param queue
+ * @param memory_type_idx Host visible and host coherent memory type, for the instance buffer.
+ * @param pipelines Sprite pipelines the overlay will be drawn with.
+ * @return
+ */
+Hud create_hud(
+	types::VulkanDevicePtr const & device,
+	VkPhysicalDevice physical_device,
+	types::VulkanQueueFamilyIdx queue_family_idx,
+	VkQueue queue,
+	types::VulkanMemoryTypeIdx memory_type_idx,
+	batch::SpritePipelines const & pipelines);
+
+/**
+ * Record the frame's stats and repack the overlay's instance buffer.
+ *
+ * Must not be called whilst a previous frame's overlay draw may still be in flight.
+ *
+ * @param hud
+ * @param pipelines Sprite pipelines the overlay will be drawn with.
+ * @param stats
+ */
+void update_hud(Hud & hud, batch::SpritePipelines const & pipelines, FrameStats const & stats);
+
+/**
+ * Record the overlay as a single instanced draw, over whatever is already in the attachment.
+ *
+ * @param command_buffer
+ * @param hud
+ * @param pipelines
+ * @param extent Framebuffer extent.
+ */
+void populate_cmd_hud(
+	VkCommandBuffer command_buffer,
+	Hud const & hud,
+	batch::SpritePipelines const & pipelines,
+	VkExtent2D extent);
+}  // namespace vulkandemo::hud
@@ -0,0 +1,358 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#include "ktx2.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vulkan_core.h>
+
+namespace vulkandemo::ktx2
+{
+namespace
+{
+static_assert(std::endian::native == std::endian::little, "KTX2 fields are read in place");
+
+constexpr std::array<uint8_t, 12> kIdentifier{
+	0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+/// Identifier, then header and index fields up to the level index.
+constexpr std::size_t kLevelIndexOffset = 80;
+constexpr std::size_t kLevelIndexEntrySize = 24;
+
+/**
+ * Field offsets within the header, see the KTX2 specification, section 3.
+ */
+enum HeaderField : std::size_t
+{
+	kVkFormat = 12,
+	kPixelWidth = 20,
+	kPixelHeight = 24,
+	kPixelDepth = 28,
+	kLayerCount = 32,
+	kFaceCount = 36,
+	kLevelCount = 40,
+	kSupercompressionScheme = 44
+};
+
+template <typename T>
+T read(std::span<std::byte const> const bytes, std::size_t const offset)
+{
+	if (offset + sizeof(T) > bytes.size())
+		throw std::runtime_error{"Truncated KTX2 container"};
+	T value;
+	std::memcpy(&value, bytes.subspan(offset, sizeof(T)).data(), sizeof(T));
+	return value;
+}
+
+template <typename T>
+void write(std::span<std::byte> const bytes, std::size_t const offset, T const value)
+{
+	std::memcpy(bytes.subspan(offset, sizeof(T)).data(), &value, sizeof(T));
+}
+}  // namespace
+
+MappedFile map_file(std::filesystem::path const & path)
+{
+	std::size_t const size = std::filesystem::file_size(path);
+	if (size == 0)
+		return MappedFile{.data = nullptr, .size = 0};
+
+#ifdef _WIN32
+	HANDLE file = CreateFileW(
+		path.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error{std::format("Failed to open {}", path.string())};
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (mapping == nullptr)
+		throw std::runtime_error{std::format("Failed to map {}", path.string())};
+	void * view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (view == nullptr)
+		throw std::runtime_error{std::format("Failed to map {}", path.string())};
+
+	return MappedFile{
+		.data = {static_cast<std::byte const *>(view), [](std::byte const * ptr)
+				 { UnmapViewOfFile(ptr); }},
+		.size = size};
+#else
+	int const fd = open(path.c_str(), O_RDONLY);	// NOLINT(*-vararg)
+	if (fd < 0)
+		throw std::runtime_error{std::format("Failed to open {}", path.string())};
+	void * view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED)	 // NOLINT(*-cstyle-cast,*-int-to-ptr)
+		throw std::runtime_error{std::format("Failed to map {}", path.string())};
+
+	return MappedFile{
+		.data = {static_cast<std::byte const *>(view), [size](std::byte const * ptr)
+				 {
+					 // NOLINTNEXTLINE(*-const-cast)
+					 munmap(const_cast<std::byte *>(ptr), size);
+				 }},
+		.size = size};
+#endif
+}
+
+std::vector<std::byte> encode_ktx2(
+	VkFormat const format,
+	VkExtent2D const extent,
+	std::span<std::vector<std::byte> const> const levels)
+{
+	constexpr std::size_t alignment = 16;
+	auto const align = [](std::size_t const offset)
+	{ return (offset + alignment - 1) / alignment * alignment; };
+
+	std::size_t offset = align(kLevelIndexOffset + kLevelIndexEntrySize * levels.size());
+	// Level data is stored smallest first.
+	std::vector<std::size_t> level_offsets(levels.size());
+	for (std::size_t level = levels.size(); level-- > 0;)
+	{
+		level_offsets[level] = offset;
+		offset = align(offset + levels[level].size());
+	}
+
+	std::vector<std::byte> out(offset);
+	std::ranges::transform(
+		kIdentifier, out.begin(), [](uint8_t const byte) { return std::byte{byte}; });
+	write<uint32_t>(out, kVkFormat, format);
+	write<uint32_t>(out, kPixelWidth, extent.width);
+	write<uint32_t>(out, kPixelHeight, extent.height);
+	write<uint32_t>(out, kFaceCount, 1);
+	write<uint32_t>(out, kLevelCount, static_cast<uint32_t>(levels.size()));
+
+	for (std::size_t level = 0; level < levels.size(); ++level)
+	{
+		std::size_t const entry = kLevelIndexOffset + kLevelIndexEntrySize * level;
+		write<uint64_t>(out, entry, level_offsets[level]);
+		write<uint64_t>(out, entry + 8, levels[level].size());
+		write<uint64_t>(out, entry + 16, levels[level].size());
+		std::ranges::copy(
+			levels[level], out.begin() + static_cast<std::ptrdiff_t>(level_offsets[level]));
+	}
+	return out;
+}
+
+Ktx2Texture parse_ktx2(std::span<std::byte const> const bytes)
+{
+	if (bytes.size() < kLevelIndexOffset ||
+		!std::ranges::equal(
+			bytes.first(kIdentifier.size()),
+			kIdentifier,
+			[](std::byte const lhs, uint8_t const rhs) { return lhs == std::byte{rhs}; }))
+		throw std::runtime_error{"Not a KTX2 container"};
+
+	if (read<uint32_t>(bytes, kSupercompressionScheme) != 0)
+		throw std::runtime_error{"Supercompressed KTX2 textures are not supported"};
+	if (read<uint32_t>(bytes, kPixelDepth) > 1 || read<uint32_t>(bytes, kLayerCount) > 1 ||
+		read<uint32_t>(bytes, kFaceCount) != 1)
+		throw std::runtime_error{"Only single layer 2D KTX2 textures are supported"};
+
+	Ktx2Texture texture{
+		.format = static_cast<VkFormat>(read<uint32_t>(bytes, kVkFormat)),
+		.extent = {read<uint32_t>(bytes, kPixelWidth), read<uint32_t>(bytes, kPixelHeight)},
+		.levels = {}};
+	if (texture.extent.width == 0 || texture.extent.height == 0)
+		throw std::runtime_error{"KTX2 texture has no extent"};
+
+	// Zero levels means the consumer should generate mips, i.e. only level 0 is present.
+	uint32_t const level_count = std::max(read<uint32_t>(bytes, kLevelCount), 1U);
+	if (level_count >
+		static_cast<uint32_t>(
+			std::bit_width(std::max(texture.extent.width, texture.extent.height))))
+		throw std::runtime_error{"KTX2 texture has more levels than its extent allows"};
+
+	for (uint32_t level = 0; level < level_count; ++level)
+	{
+		std::size_t const entry = kLevelIndexOffset + kLevelIndexEntrySize * level;
+		auto const offset = read<uint64_t>(bytes, entry);
+		auto const length = read<uint64_t>(bytes, entry + 8);
+		if (offset > bytes.size() || length > bytes.size() - offset)
+			throw std::runtime_error{std::format("KTX2 level {} is out of bounds", level)};
+		// Otherwise uploading the level would copy past the end of its data.
+		if (std::size_t const expected = level_size(texture.format, texture.extent, level);
+			length != expected)
+			throw std::runtime_error{std::format(
+				"KTX2 level {} has {} bytes rather than the {} its extent requires",
+				level,
+				length,
+				expected)};
+		texture.levels.push_back(bytes.subspan(offset, length));
+	}
+	return texture;
+}
+
+VkExtent2D level_extent(VkExtent2D const extent, uint32_t const level)
+{
+	return {std::max(extent.width >> level, 1U), std::max(extent.height >> level, 1U)};
+}
+
+FormatBlock format_block(VkFormat const format)
+{
+	switch (format)
+	{
+		case VK_FORMAT_R8_UNORM:
+		case VK_FORMAT_R8_SRGB:
+			return {.extent = {1, 1}, .bytes = 1};
+		case VK_FORMAT_R8G8_UNORM:
+			return {.extent = {1, 1}, .bytes = 2};
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_R32_SFLOAT:
+			return {.extent = {1, 1}, .bytes = 4};
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+			return {.extent = {1, 1}, .bytes = 8};
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			return {.extent = {1, 1}, .bytes = 16};
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK:
+			return {.extent = {4, 4}, .bytes = 8};
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+		case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+		case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return {.extent = {4, 4}, .bytes = 16};
+		default:
+			throw std::runtime_error{
+				std::format("Unsupported KTX2 format {}", std::to_underlying(format))};
+	}
+}
+
+std::size_t level_size(VkFormat const format, VkExtent2D const extent, uint32_t const level)
+{
+	FormatBlock const block = format_block(format);
+	VkExtent2D const texels = level_extent(extent, level);
+	// Partial blocks at the edges are stored whole.
+	std::size_t const blocks_x = (texels.width + block.extent.width - 1) / block.extent.width;
+	std::size_t const blocks_y = (texels.height + block.extent.height - 1) / block.extent.height;
+	return blocks_x * blocks_y * block.bytes;
+}
+
+TEST_CASE("Parse memory-mapped KTX2 textures")
+{
+	constexpr VkExtent2D extent{8, 4};
+	std::vector<std::vector<std::byte>> levels;
+	for (uint32_t level = 0; level < 4; ++level)
+	{
+		VkExtent2D const size = level_extent(extent, level);
+		levels.emplace_back(
+			std::size_t{size.width} * size.height * 4, static_cast<std::byte>(level));
+	}
+	CHECK(level_extent(extent, 3).width == 1);
+	CHECK(level_extent(extent, 3).height == 1);
+	CHECK(level_size(VK_FORMAT_R8G8B8A8_UNORM, extent, 1) == 4UZ * 2 * 4);
+	// Partial blocks are stored whole.
+	CHECK(level_size(VK_FORMAT_BC1_RGB_UNORM_BLOCK, VkExtent2D{10, 5}, 0) == 3UZ * 2 * 8);
+	CHECK(level_size(VK_FORMAT_BC7_UNORM_BLOCK, VkExtent2D{10, 5}, 3) == 16);
+
+	std::vector<std::byte> const encoded = encode_ktx2(VK_FORMAT_R8G8B8A8_UNORM, extent, levels);
+
+	std::filesystem::path const path =
+		std::filesystem::temp_directory_path() / "vulkandemo_parse_ktx2.ktx2";
+	{
+		std::ofstream file{path, std::ios::binary};
+		file.write(
+			reinterpret_cast<char const *>(encoded.data()),	 // NOLINT(*-reinterpret-cast)
+			static_cast<std::streamsize>(encoded.size()));
+	}
+
+	SUBCASE("round trip")
+	{
+		MappedFile const mapped = map_file(path);
+		REQUIRE(mapped.size == encoded.size());
+
+		Ktx2Texture const texture = parse_ktx2(mapped.bytes());
+		CHECK(texture.format == VK_FORMAT_R8G8B8A8_UNORM);
+		CHECK(texture.extent.width == extent.width);
+		CHECK(texture.extent.height == extent.height);
+		REQUIRE(texture.levels.size() == levels.size());
+		for (std::size_t level = 0; level < levels.size(); ++level)
+		{
+			CAPTURE(level);
+			CHECK(std::ranges::equal(texture.levels[level], levels[level]));
+			// Referenced in place rather than copied.
+			CHECK(texture.levels[level].data() >= mapped.bytes().data());
+			CHECK(&texture.levels[level].back() < mapped.bytes().data() + mapped.size);
+		}
+		// Smallest level is stored first.
+		CHECK(texture.levels.back().data() < texture.levels.front().data());
+	}
+
+	SUBCASE("malformed")
+	{
+		CHECK_THROWS(parse_ktx2(std::span{encoded}.first(40)));
+
+		std::vector<std::byte> bad_identifier = encoded;
+		bad_identifier[1] = std::byte{'X'};
+		CHECK_THROWS(parse_ktx2(bad_identifier));
+
+		std::vector<std::byte> supercompressed = encoded;
+		write<uint32_t>(supercompressed, kSupercompressionScheme, 2);
+		CHECK_THROWS(parse_ktx2(supercompressed));
+
+		std::vector<std::byte> cube = encoded;
+		write<uint32_t>(cube, kFaceCount, 6);
+		CHECK_THROWS(parse_ktx2(cube));
+
+		std::vector<std::byte> truncated_level = encoded;
+		write<uint64_t>(truncated_level, kLevelIndexOffset + 8, encoded.size());
+		CHECK_THROWS(parse_ktx2(truncated_level));
+
+		// Within the container, but shorter than the level's extent requires.
+		std::vector<std::byte> short_level = encoded;
+		write<uint64_t>(short_level, kLevelIndexOffset + 8, levels[0].size() - 4);
+		CHECK_THROWS_AS(parse_ktx2(short_level), std::runtime_error);
+
+		std::vector<std::byte> unsupported_format = encoded;
+		write<uint32_t>(unsupported_format, kVkFormat, VK_FORMAT_R8G8B8_UNORM);
+		CHECK_THROWS_AS(parse_ktx2(unsupported_format), std::runtime_error);
+	}
+
+	std::filesystem::remove(path);
+}
+}  // namespace vulkandemo::ktx2
@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+/**
+ * Zero-copy access to KTX2 texture containers via memory-mapped files.
+ *
+ * Mip level data is referenced in place, so pages are only read from disk when a level is first
+ * touched, e.g. when copied to a staging buffer for upload.
+ */
+namespace vulkandemo::ktx2
+{
+/**
+ * Read-only memory mapping of a whole file, unmapped once the last copy is destroyed.
+ */
+struct MappedFile
+{
+	std::shared_ptr<std::byte const> data;
+	std::size_t size;
+
+	[[nodiscard]] std::span<std::byte const> bytes() const
+	{
+		return {data.get(), size};
+	}
+};
+
+/**
+ * 2D texture within a KTX2 container.
+ */
+struct Ktx2Texture
+{
+	VkFormat format;
+	/// Extent of mip level 0.
+	VkExtent2D extent;
+	/// Data of each mip level, largest first, referencing the container's bytes.
+	std::vector<std::span<std::byte const>> levels;
+};
+
+/**
+ * Map a file into memory.
+ *
+ * @param path
+ * @return
+ */
+MappedFile map_file(std::filesystem::path const & path);
+
+/**
+ * Parse a KTX2 container holding a single 2D texture without supercompression.
+ *
+ * Throws on malformed containers, including levels whose size does not match their extent and
+ * format, or on unsupported formats or array, cube, 3D or supercompressed textures.
+ *
+ * @param bytes Container bytes, which must outlive the result.
+ * @return
+ */
+Ktx2Texture parse_ktx2(std::span<std::byte const> bytes);
+
+/**
+ * Encode a KTX2 container of a single 2D texture, without supercompression.
+ *
+ * The data format descriptor and key/value data required by the specification are omitted, so
+ * the result is only intended for parse_ktx2, e.g. in tests.
+ *
+ * @param format
+ * @param extent Extent of level 0.
+ * @param levels Data of each mip level, largest first.
+ * @return
+ */
+std::vector<std::byte> encode_ktx2(
+	VkFormat format, VkExtent2D extent, std::span<std::vector<std::byte> const> levels);
+
+/**
+ * Texel block of a format, i.e. a single texel for uncompressed formats.
+ */
+struct FormatBlock
+{
+	/// Width and height of a block, in texels.
+	VkExtent2D extent;
+	std::size_t bytes;
+};
+
+/**
+ * Texel block of a format supported by parse_ktx2.
+ *
+ * @param format
+ * @return
+ * @throws std::runtime_error if the format is not supported.
+ */
+FormatBlock format_block(VkFormat format);
+
+/**
+ * Bytes of a tightly packed mip level, as required of each level by parse_ktx2.
+ *
+ * @param format
+ * @param extent Extent of level 0.
+ * @param level
+ * @return
+ */
+std::size_t level_size(VkFormat format, VkExtent2D extent, uint32_t level);
+
+/**
+ * Extent of a mip level.
+ *
+ * @param extent Extent of level 0.
+ * @param level
+ * @return
+ */
+VkExtent2D level_extent(VkExtent2D extent, uint32_t level);
+}  // namespace vulkandemo::ktx2
@@ -0,0 +1,555 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#include "lod.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <random>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner) for `logger`
+
+#include <doctest/doctest.h>
+
+#include "Logger.hpp"
+#include "bench.hpp"
+#include "cull.hpp"
+#include "parallel.hpp"
+
+namespace vulkandemo::lod
+{
+namespace
+{
+/// Grid cells along the longest axis of the mesh's bounds for the first simplified level.
+constexpr uint32_t kMaxGridResolution = 256;
+
+/// Closest distance used to project errors, so objects around the eye select full detail.
+constexpr float kMinDistance = 1e-3F;
+
+struct Clustering
+{
+	/// Replacement of each vertex.
+	std::vector<uint32_t> remap;
+	/// Maximum distance of any vertex from its replacement.
+	float error;
+};
+
+/**
+ * Snap vertices to a grid, replacing each with the vertex nearest its cell's centroid.
+ */
+Clustering cluster_vertices(
+	std::span<std::array<float, 3> const> const positions,
+	std::array<float, 3> const & origin,
+	float const extent,
+	uint32_t const resolution)
+{
+	struct Cell
+	{
+		std::array<double, 3> sum;
+		uint32_t count;
+		uint32_t representative;
+		float representative_distance;
+	};
+
+	float const cells_per_unit = static_cast<float>(resolution) / extent;
+	auto const cell_key = [&](std::array<float, 3> const & position)
+	{
+		uint64_t key = 0;
+		for (std::size_t axis = 3; axis-- > 0;)
+		{
+			auto const coord =
+				static_cast<uint32_t>((position[axis] - origin[axis]) * cells_per_unit);
+			key = key * resolution + std::min(coord, resolution - 1);
+		}
+		return key;
+	};
+
+	std::unordered_map<uint64_t, uint32_t> cell_idxs;
+	std::vector<Cell> cells;
+	std::vector<uint32_t> vertex_cells(positions.size());
+	for (std::size_t vertex = 0; vertex < positions.size(); ++vertex)
+	{
+		auto const [it, inserted] =
+			cell_idxs.try_emplace(cell_key(positions[vertex]), static_cast<uint32_t>(cells.size()));
+		if (inserted)
+			cells.push_back(
+				{.sum = {}, .count = 0, .representative = 0, .representative_distance = INFINITY});
+		Cell & cell = cells[it->second];
+		for (std::size_t axis = 0; axis < 3; ++axis)
+			cell.sum[axis] += positions[vertex][axis];
+		++cell.count;
+		vertex_cells[vertex] = it->second;
+	}
+
+	auto const distance = [](std::array<float, 3> const & lhs, std::array<float, 3> const & rhs)
+	{ return std::hypot(lhs[0] - rhs[0], lhs[1] - rhs[1], lhs[2] - rhs[2]); };
+
+	for (std::size_t vertex = 0; vertex < positions.size(); ++vertex)
+	{
+		Cell & cell = cells[vertex_cells[vertex]];
+		std::array<float, 3> centroid{};
+		for (std::size_t axis = 0; axis < 3; ++axis)
+			centroid[axis] = static_cast<float>(cell.sum[axis] / cell.count);
+		float const vertex_distance = distance(positions[vertex], centroid);
+		if (vertex_distance < cell.representative_distance)
+		{
+			cell.representative = static_cast<uint32_t>(vertex);
+			cell.representative_distance = vertex_distance;
+		}
+	}
+
+	Clustering clustering{.remap = std::vector<uint32_t>(positions.size()), .error = 0.0F};
+	for (std::size_t vertex = 0; vertex < positions.size(); ++vertex)
+	{
+		uint32_t const representative = cells[vertex_cells[vertex]].representative;
+		clustering.remap[vertex] = representative;
+		clustering.error = std::max(
+			clustering.error, distance(positions[vertex], positions[representative]));
+	}
+	return clustering;
+}
+
+/**
+ * Remap triangles, dropping those that collapse to a line or point, and duplicates.
+ */
+std::vector<uint32_t> collapse_triangles(
+	std::span<uint32_t const> const indices, std::span<uint32_t const> const remap)
+{
+	std::vector<std::array<uint32_t, 3>> triangles;
+	for (std::size_t idx = 0; idx < indices.size(); idx += 3)
+	{
+		std::array<uint32_t, 3> triangle{
+			remap[indices[idx]], remap[indices[idx + 1]], remap[indices[idx + 2]]};
+		if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2])
+			continue;
+		// Rotate the smallest index first, preserving winding, so duplicates compare equal.
+		std::ranges::rotate(triangle, std::ranges::min_element(triangle));
+		triangles.push_back(triangle);
+	}
+	std::ranges::sort(triangles);
+	auto const duplicates = std::ranges::unique(triangles);
+	triangles.erase(duplicates.begin(), duplicates.end());
+
+	std::vector<uint32_t> out;
+	out.reserve(triangles.size() * 3);
+	for (std::array<uint32_t, 3> const & triangle : triangles)
+		out.insert(out.end(), triangle.begin(), triangle.end());
+	return out;
+}
+
+/**
+ * Select a level for a single mesh, given the current level and the largest acceptable error in
+ * mesh units.
+ */
+uint32_t select_level(
+	std::span<float const> const errors,
+	uint32_t const current,
+	float const max_error,
+	float const hysteresis)
+{
+	auto const level_count = static_cast<uint32_t>(errors.size());
+	uint32_t level = std::min(current, level_count - 1);
+	// Coarsen only once comfortably within tolerance, but refine as soon as out of tolerance.
+	float const coarsen_error = max_error * (1.0F - hysteresis);
+	while (level + 1 < level_count && errors[level + 1] <= coarsen_error)
+		++level;
+	while (level > 0 && errors[level] > max_error)
+		--level;
+	return level;
+}
+
+/**
+ * Select levels of objects `[begin, end)`.
+ */
+LodStats select_range(
+	LodView const & view,
+	LodMeshes const & meshes,
+	LodObjects & objects,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	LodStats stats{.triangles = 0, .full_detail_triangles = 0, .level_histogram = {}};
+	cull::SphereBounds const & bounds = objects.bounds;
+	for (std::size_t object = begin; object < end; ++object)
+	{
+		float const dx = bounds.centre_x[object] - view.eye[0];
+		float const dy = bounds.centre_y[object] - view.eye[1];
+		float const dz = bounds.centre_z[object] - view.eye[2];
+		float const distance = std::max(
+			std::sqrt(dx * dx + dy * dy + dz * dz) - bounds.radius[object], kMinDistance);
+		// Error in mesh units that projects to the threshold at the nearest point of the bounds.
+		float const max_error =
+			view.threshold_px * distance / (view.projection_scale * objects.scale[object]);
+
+		uint32_t const mesh = objects.mesh[object];
+		uint32_t const first_level = meshes.first_level[mesh];
+		uint32_t const level = select_level(
+			std::span{meshes.level_error}.subspan(first_level, meshes.level_count[mesh]),
+			objects.level[object],
+			max_error,
+			view.hysteresis);
+
+		objects.level[object] = static_cast<uint8_t>(level);
+		stats.triangles += meshes.level_triangles[first_level + level];
+		stats.full_detail_triangles += meshes.level_triangles[first_level];
+		++stats.level_histogram[level];
+	}
+	return stats;
+}
+}  // namespace
+
+LodChain build_lod_chain(Mesh const & mesh, LodChainConfig const & config)
+{
+	if (mesh.indices.size() % 3 != 0)
+		throw std::invalid_argument{"Mesh indices are not a triangle list"};
+	if (std::ranges::any_of(
+			mesh.indices, [&](uint32_t const idx) { return idx >= mesh.positions.size(); }))
+		throw std::invalid_argument{"Mesh index out of range"};
+	if (config.max_levels == 0 || config.max_levels > kMaxLevels)
+		throw std::invalid_argument{"Unsupported number of LOD levels"};
+
+	LodChain chain{
+		.indices = mesh.indices,
+		.levels = {LodLevel{
+			.first_index = 0,
+			.index_count = static_cast<uint32_t>(mesh.indices.size()),
+			.error = 0.0F}}};
+	if (mesh.positions.empty())
+		return chain;
+
+	std::array<float, 3> origin = mesh.positions.front();
+	std::array<float, 3> upper = origin;
+	for (std::array<float, 3> const & position : mesh.positions)
+		for (std::size_t axis = 0; axis < 3; ++axis)
+		{
+			origin[axis] = std::min(origin[axis], position[axis]);
+			upper[axis] = std::max(upper[axis], position[axis]);
+		}
+	float const extent =
+		std::max({upper[0] - origin[0], upper[1] - origin[1], upper[2] - origin[2]});
+	if (!(extent > 0.0F))
+		return chain;
+
+	std::size_t previous_triangles = mesh.indices.size() / 3;
+	for (uint32_t resolution = kMaxGridResolution;
+		 resolution > 0 && chain.levels.size() < config.max_levels &&
+		 previous_triangles > config.min_triangles;
+		 resolution /= 2)
+	{
+		Clustering const clustering =
+			cluster_vertices(mesh.positions, origin, extent, resolution);
+		std::vector<uint32_t> const indices = collapse_triangles(mesh.indices, clustering.remap);
+		std::size_t const triangles = indices.size() / 3;
+		if (triangles == 0)
+			break;
+		if (static_cast<float>(triangles) >
+			config.min_reduction * static_cast<float>(previous_triangles))
+			continue;
+
+		chain.levels.push_back(LodLevel{
+			.first_index = static_cast<uint32_t>(chain.indices.size()),
+			.index_count = static_cast<uint32_t>(indices.size()),
+			// Selection relies on error never decreasing with level.
+			.error = std::max(clustering.error, chain.levels.back().error)});
+		chain.indices.insert(chain.indices.end(), indices.begin(), indices.end());
+		previous_triangles = triangles;
+	}
+	return chain;
+}
+
+uint32_t add_lod_mesh(LodMeshes & meshes, LodChain const & chain)
+{
+	if (chain.levels.empty() || chain.levels.size() > kMaxLevels)
+		throw std::invalid_argument{"Unsupported number of LOD levels"};
+
+	auto const mesh = static_cast<uint32_t>(meshes.first_level.size());
+	meshes.first_level.push_back(static_cast<uint32_t>(meshes.level_error.size()));
+	meshes.level_count.push_back(static_cast<uint32_t>(chain.levels.size()));
+	for (LodLevel const & level : chain.levels)
+	{
+		meshes.level_error.push_back(level.error);
+		meshes.level_triangles.push_back(level.index_count / 3);
+	}
+	return mesh;
+}
+
+void push_object(
+	LodObjects & objects, cull::Sphere const & bounds, float const scale, uint32_t const mesh)
+{
+	cull::push_sphere(objects.bounds, bounds);
+	objects.scale.push_back(scale);
+	objects.mesh.push_back(mesh);
+	objects.level.push_back(0);
+}
+
+LodView make_lod_view(
+	std::array<float, 3> const & eye,
+	float const fov_y,
+	float const viewport_height,
+	float const threshold_px,
+	float const hysteresis)
+{
+	return LodView{
+		.eye = eye,
+		.projection_scale = viewport_height / (2.0F * std::tan(fov_y / 2.0F)),
+		.threshold_px = threshold_px,
+		.hysteresis = hysteresis};
+}
+
+LodStats select_lods(LodView const & view, LodMeshes const & meshes, LodObjects & objects)
+{
+	return select_range(view, meshes, objects, 0, objects.mesh.size());
+}
+
+LodStats select_lods(
+	LodView const & view,
+	LodMeshes const & meshes,
+	LodObjects & objects,
+	parallel::ThreadPool & pool)
+{
+	std::size_t const object_count = objects.mesh.size();
+	std::vector<LodStats> chunk_stats((object_count + kChunkSize - 1) / kChunkSize);
+
+	parallel::for_each_chunk(
+		pool,
+		object_count,
+		kChunkSize,
+		[&](std::size_t const chunk_idx, std::size_t const begin, std::size_t const end)
+		{ chunk_stats[chunk_idx] = select_range(view, meshes, objects, begin, end); });
+
+	LodStats stats{.triangles = 0, .full_detail_triangles = 0, .level_histogram = {}};
+	for (LodStats const & chunk : chunk_stats)
+	{
+		stats.triangles += chunk.triangles;
+		stats.full_detail_triangles += chunk.full_detail_triangles;
+		for (std::size_t level = 0; level < kMaxLevels; ++level)
+			stats.level_histogram[level] += chunk.level_histogram[level];
+	}
+	return stats;
+}
+
+namespace
+{
+/**
+ * Height field of `size` by `size` quads over the unit square, with enough relief that clustering
+ * has something to remove.
+ */
+Mesh make_grid_mesh(uint32_t const size)
+{
+	Mesh mesh;
+	for (uint32_t y = 0; y <= size; ++y)
+		for (uint32_t x = 0; x <= size; ++x)
+		{
+			float const u = static_cast<float>(x) / static_cast<float>(size);
+			float const v = static_cast<float>(y) / static_cast<float>(size);
+			mesh.positions.push_back(
+				{u, v, 0.05F * std::sin(u * 2 * std::numbers::pi_v<float>) * std::cos(v * 3.0F)});
+		}
+	for (uint32_t y = 0; y < size; ++y)
+		for (uint32_t x = 0; x < size; ++x)
+		{
+			uint32_t const corner = y * (size + 1) + x;
+			mesh.indices.insert(
+				mesh.indices.end(),
+				{corner,
+				 corner + 1,
+				 corner + size + 1,
+				 corner + 1,
+				 corner + size + 2,
+				 corner + size + 1});
+		}
+	return mesh;
+}
+
+LodObjects make_random_objects(std::size_t const count, uint32_t const mesh)
+{
+	std::mt19937 rng{42};  // NOLINT(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+	std::uniform_real_distribution<float> position{-1000.0F, 1000.0F};
+	std::uniform_real_distribution<float> scale{0.5F, 20.0F};
+	LodObjects objects;
+	for (std::size_t object = 0; object < count; ++object)
+	{
+		float const object_scale = scale(rng);
+		push_object(
+			objects,
+			{.centre = {position(rng), position(rng), position(rng)}, .radius = object_scale},
+			object_scale,
+			mesh);
+	}
+	return objects;
+}
+}  // namespace
+
+TEST_CASE("Build LOD chains by vertex clustering")
+{
+	Mesh const mesh = make_grid_mesh(64);
+	LodChain const chain = build_lod_chain(mesh);
+
+	REQUIRE(chain.levels.size() >= 3);
+	CHECK(chain.levels.size() <= kMaxLevels);
+	CHECK(chain.levels.front().error == 0.0F);
+	CHECK(std::ranges::equal(
+		std::span{chain.indices}.first(chain.levels.front().index_count), mesh.indices));
+
+	for (std::size_t level = 1; level < chain.levels.size(); ++level)
+	{
+		CAPTURE(level);
+		LodLevel const & previous = chain.levels[level - 1];
+		LodLevel const & current = chain.levels[level];
+		CHECK(current.first_index == previous.first_index + previous.index_count);
+		CHECK(current.index_count % 3 == 0);
+		CHECK(
+			static_cast<float>(current.index_count) <=
+			0.6F * static_cast<float>(previous.index_count));
+		CHECK(current.error >= previous.error);
+		CHECK(current.error > 0.0F);
+
+		std::span<uint32_t const> const indices =
+			std::span{chain.indices}.subspan(current.first_index, current.index_count);
+		CHECK(std::ranges::all_of(
+			indices, [&](uint32_t const idx) { return idx < mesh.positions.size(); }));
+		for (std::size_t idx = 0; idx < indices.size(); idx += 3)
+		{
+			CHECK(indices[idx] != indices[idx + 1]);
+			CHECK(indices[idx + 1] != indices[idx + 2]);
+			CHECK(indices[idx] != indices[idx + 2]);
+		}
+	}
+
+	SUBCASE("limits")
+	{
+		CHECK(build_lod_chain(mesh, {.max_levels = 2}).levels.size() == 2);
+		CHECK(build_lod_chain(mesh, {.min_triangles = 1'000'000}).levels.size() == 1);
+		// A single triangle cannot be simplified.
+		Mesh const triangle{.positions = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}}, .indices = {0, 1, 2}};
+		CHECK(build_lod_chain(triangle).levels.size() == 1);
+	}
+
+	SUBCASE("invalid")
+	{
+		CHECK_THROWS_AS(
+			build_lod_chain({.positions = {{0, 0, 0}}, .indices = {0, 0}}), std::invalid_argument);
+		CHECK_THROWS_AS(
+			build_lod_chain({.positions = {{0, 0, 0}}, .indices = {0, 0, 1}}),
+			std::invalid_argument);
+		CHECK_THROWS_AS(build_lod_chain(mesh, {.max_levels = 0}), std::invalid_argument);
+	}
+}
+
+TEST_CASE("Select LODs by screen-space error")
+{
+	// Errors of 0, 1 and 2 units, so at 100 pixels per unit at unit distance and a 1 pixel
+	// threshold, level 1 is acceptable from distance 100 but only chosen from 100 / 0.75.
+	LodMeshes meshes;
+	uint32_t const mesh = add_lod_mesh(
+		meshes,
+		{.indices = {},
+		 .levels = {
+			 {.first_index = 0, .index_count = 300, .error = 0.0F},
+			 {.first_index = 300, .index_count = 150, .error = 1.0F},
+			 {.first_index = 450, .index_count = 75, .error = 2.0F}}});
+	LodView const view{
+		.eye = {0, 0, 0}, .projection_scale = 100.0F, .threshold_px = 1.0F, .hysteresis = 0.25F};
+
+	LodObjects objects;
+	push_object(objects, {.centre = {0, 0, -150}, .radius = 0}, 1.0F, mesh);
+	push_object(objects, {.centre = {0, 0, -1000}, .radius = 0}, 1.0F, mesh);
+	push_object(objects, {.centre = {0, 0, -1000}, .radius = 995}, 1.0F, mesh);
+	push_object(objects, {.centre = {0, 0, -1000}, .radius = 0}, 100.0F, mesh);
+
+	LodStats const stats = select_lods(view, meshes, objects);
+	CHECK(objects.level == std::vector<uint8_t>{1, 2, 0, 0});
+	CHECK(stats.triangles == 50 + 25 + 100 + 100);
+	CHECK(stats.full_detail_triangles == 4 * 100);
+	CHECK(stats.level_histogram[0] == 2);
+	CHECK(stats.level_histogram[1] == 1);
+	CHECK(stats.level_histogram[2] == 1);
+
+	SUBCASE("hysteresis")
+	{
+		auto const level_at = [&](float const distance)
+		{
+			objects.bounds.centre_z[0] = -distance;
+			select_lods(view, meshes, objects);
+			return objects.level[0];
+		};
+		// Within the band, the previous level is kept whichever side it was entered from.
+		CHECK(level_at(120) == 1);
+		CHECK(level_at(90) == 0);
+		CHECK(level_at(120) == 0);
+		CHECK(level_at(140) == 1);
+	}
+
+	SUBCASE("parallel")
+	{
+		LodMeshes random_meshes;
+		uint32_t const grid_mesh =
+			add_lod_mesh(random_meshes, build_lod_chain(make_grid_mesh(64)));
+		// Not a multiple of the chunk size, to exercise remainders.
+		LodObjects serial = make_random_objects(3 * kChunkSize + 5, grid_mesh);
+		LodObjects threaded = serial;
+		LodView const random_view =
+			make_lod_view({0, 0, 0}, std::numbers::pi_v<float> / 3, 1080.0F);
+
+		parallel::ThreadPool pool{3};
+		LodStats const serial_stats = select_lods(random_view, random_meshes, serial);
+		LodStats const threaded_stats = select_lods(random_view, random_meshes, threaded, pool);
+		CHECK(serial.level == threaded.level);
+		CHECK(serial_stats.triangles == threaded_stats.triangles);
+		CHECK(serial_stats.full_detail_triangles == threaded_stats.full_detail_triangles);
+		CHECK(serial_stats.level_histogram == threaded_stats.level_histogram);
+		// Sanity check the scene spans several levels.
+		CHECK(serial_stats.triangles < serial_stats.full_detail_triangles);
+		CHECK(serial_stats.level_histogram[0] > 0);
+	}
+}
+
+TEST_CASE("Benchmark LOD selection" * doctest::test_suite("benchmark") * doctest::skip())
+{
+	LoggerPtr const logger = create_logger("Benchmark LOD selection");
+	parallel::ThreadPool pool;
+
+	LodMeshes meshes;
+	LodChain const chain = build_lod_chain(make_grid_mesh(128));
+	uint32_t const mesh = add_lod_mesh(meshes, chain);
+	logger->info(
+		"{} levels, {} to {} triangles",
+		chain.levels.size(),
+		chain.levels.front().index_count / 3,
+		chain.levels.back().index_count / 3);
+
+	LodView const view = make_lod_view({0, 0, 0}, std::numbers::pi_v<float> / 3, 1080.0F);
+
+	for (std::size_t const object_count : {10'000UZ, 100'000UZ, 1'000'000UZ})
+	{
+		LodObjects objects = make_random_objects(object_count, mesh);
+		constexpr std::size_t iterations = 50;
+
+		LodStats stats{};
+		double const single_ms =
+			bench::mean_ms(iterations, [&] { stats = select_lods(view, meshes, objects); });
+		double const parallel_ms =
+			bench::mean_ms(iterations, [&] { stats = select_lods(view, meshes, objects, pool); });
+
+		logger->info(
+			"{} objects: single {:.3f} ms, {} threads {:.3f} ms; {} triangles with LOD, {} "
+			"without ({:.1f}%)",
+			object_count,
+			single_ms,
+			pool.thread_count(),
+			parallel_ms,
+			stats.triangles,
+			stats.full_detail_triangles,
+			100.0 * static_cast<double>(stats.triangles) /
+				static_cast<double>(stats.full_detail_triangles));
+	}
+}
+}  // namespace vulkandemo::lod
@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "cull.hpp"
+#include "parallel.hpp"
+
+/**
+ * Mesh level of detail, generated at load time and selected per frame by screen-space error.
+ *
+ * Each mesh is simplified into a chain of index buffers over its original vertices, so all levels
+ * share one vertex buffer. Every level records its geometric error, i.e. how far its surface may
+ * deviate from the original. Each frame, objects pick the coarsest level whose error, projected to
+ * the screen, stays below a pixel threshold. A level is only coarsened once comfortably below the
+ * threshold, so objects near a boundary do not pop back and forth between levels.
+ */
+namespace vulkandemo::lod
+{
+/// Number of objects selected per parallel task.
+inline constexpr std::size_t kChunkSize = 16384;
+
+/// Upper bound on levels per mesh, including the original.
+inline constexpr std::size_t kMaxLevels = 8;
+
+/**
+ * Indexed triangle list.
+ */
+struct Mesh
+{
+	std::vector<std::array<float, 3>> positions;
+	std::vector<uint32_t> indices;
+};
+
+struct LodLevel
+{
+	/// Range of LodChain::indices.
+	uint32_t first_index;
+	uint32_t index_count;
+	/// Maximum distance of any original vertex from its replacement, in mesh units.
+	float error;
+};
+
+/**
+ * Levels of a mesh, most detailed first, with non-decreasing error and decreasing triangle count.
+ */
+struct LodChain
+{
+	/// Indices of all levels, into the original mesh's positions.
+	std::vector<uint32_t> indices;
+	std::vector<LodLevel> levels;
+};
+
+struct LodChainConfig
+{
+	/// Maximum number of levels, including the original. At most kMaxLevels.
+	std::size_t max_levels = kMaxLevels;
+	/// A level is only kept if it has at most this fraction of the previous level's triangles.
+	float min_reduction = 0.6F;
+	/// No further levels are generated once a level has this few triangles.
+	std::size_t min_triangles = 16;
+};
+
+/**
+ * Per-level data of all meshes, flattened for cache-friendly selection.
+ */
+struct LodMeshes
+{
+	/// Per mesh.
+	std::vector<uint32_t> first_level;
+	std::vector<uint32_t> level_count;
+	/// Per level of every mesh.
+	std::vector<float> level_error;
+	std::vector<uint32_t> level_triangles;
+};
+
+/**
+ * Objects as structure-of-arrays. All vectors are the same length.
+ */
+struct LodObjects
+{
+	/// World space bounds.
+	cull::SphereBounds bounds;
+	/// Uniform scale from mesh to world units.
+	std::vector<float> scale;
+	std::vector<uint32_t> mesh;
+	/// Currently selected level, updated by select_lods.
+	std::vector<uint8_t> level;
+};
+
+/**
+ * Viewpoint and error tolerance of a selection.
+ */
+struct LodView
+{
+	std::array<float, 3> eye;
+	/// Pixels per world unit at unit distance, see make_lod_view.
+	float projection_scale;
+	/// Largest acceptable projected error, in pixels.
+	float threshold_px;
+	/// Fraction below the threshold a coarser level's error must be before switching to it.
+	float hysteresis;
+};
+
+struct LodStats
+{
+	/// Triangles of the selected levels.
+	uint64_t triangles;
+	/// Triangles had every object been drawn at full detail.
+	uint64_t full_detail_triangles;
+	/// Number of objects at each level.
+	std::array<std::size_t, kMaxLevels> level_histogram;
+};
+
+/**
+ * Simplify a mesh into a chain of levels by vertex clustering.
+ *
+ * Each level snaps vertices to a uniform grid half as fine as the last, keeping the original
+ * vertex nearest to each cell's centroid and discarding triangles that collapse.
+ *
+ * @param mesh
+ * @param config
+ * @return
+ */
+LodChain build_lod_chain(Mesh const & mesh, LodChainConfig const & config = {});
+
+/**
+ * Add a mesh's chain to the flattened selection data.
+ *
+ * @param meshes
+ * @param chain
+ * @return Index of the mesh, for LodObjects::mesh.
+ */
+uint32_t add_lod_mesh(LodMeshes & meshes, LodChain const & chain);
+
+/**
+ * Append an object at its most detailed level.
+ *
+ * @param objects
+ * @param bounds World space bounding sphere.
+ * @param scale Uniform scale from mesh to world units.
+ * @param mesh See add_lod_mesh.
+ */
+void push_object(LodObjects & objects, cull::Sphere const & bounds, float scale, uint32_t mesh);
+
+/**
+ * Construct a view for a symmetric perspective projection.
+ *
+ * @param eye
+ * @param fov_y Vertical field of view, in radians.
+ * @param viewport_height In pixels.
+ * @param threshold_px See LodView::threshold_px.
+ * @param hysteresis See LodView::hysteresis.
+ * @return
+ */
+LodView make_lod_view(
+	std::array<float, 3> const & eye,
+	float fov_y,
+	float viewport_height,
+	float threshold_px = 1.0F,
+	float hysteresis = 0.25F);
+
+/**
+ * Select each object's level on the calling thread.
+ *
+ * @param view
+ * @param meshes
+ * @param objects Selected levels are updated in place.
+ * @return
+ */
+LodStats select_lods(LodView const & view, LodMeshes const & meshes, LodObjects & objects);
+
+/**
+ * Select each object's level in chunks of kChunkSize across a thread pool.
+ *
+ * @param view
+ * @param meshes
+ * @param objects Selected levels are updated in place.
+ * @param pool
+ * @return
+ */
+LodStats select_lods(
+	LodView const & view,
+	LodMeshes const & meshes,
+	LodObjects & objects,
+	parallel::ThreadPool & pool);
+}  // namespace vulkandemo::lod
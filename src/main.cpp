@@ -1,12 +1,20 @@
 // SPDX-License-Identifier: MIT
 // Copyright 2024 David Feltell
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
 #include <exception>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
 
 #define DOCTEST_CONFIG_IMPLEMENT
 #include <doctest/doctest.h>
 #include <spdlog/logger.h> // NOLINT(*-include-cleaner)
 
 #include "Logger.hpp"
+#include "profiler.hpp"
 #include "vulkandemo.hpp"
 
 int main(int const argc, char ** argv)
@@ -19,10 +27,58 @@ int main(int const argc, char ** argv)
 	if (context.shouldExit())  // i.e. --exit
 		return res;
 
+	// Render offscreen, e.g. on machines with no display server.
+	constexpr std::size_t headless_frame_count = 1000;
+	bool const headless = std::ranges::any_of(
+		std::span{argv, static_cast<std::size_t>(argc)},
+		[](char const * arg) { return std::string_view{arg} == "--headless"; });
+
+	// Overlay frame timings, draw counts and memory usage on the window.
+	bool const show_hud = std::ranges::any_of(
+		std::span{argv, static_cast<std::size_t>(argc)},
+		[](char const * arg) { return std::string_view{arg} == "--hud"; });
+
+	// Render to several windows at once, e.g. for multiple views of a scene.
+	constexpr std::string_view windows_prefix = "--windows=";
+	std::size_t window_count = 1;
+	for (std::string_view const arg : std::span{argv, static_cast<std::size_t>(argc)})
+	{
+		if (!arg.starts_with(windows_prefix))
+			continue;
+		std::string_view const value = arg.substr(windows_prefix.size());
+		// Left as a single window if malformed.
+		std::from_chars(value.data(), value.data() + value.size(), window_count);
+	}
+
+	// Capture headless frames to files, e.g. for visual regression testing.
+	constexpr std::string_view capture_prefix = "--capture=";
+	std::optional<std::filesystem::path> capture_directory;
+	for (std::string_view const arg : std::span{argv, static_cast<std::size_t>(argc)})
+		if (arg.starts_with(capture_prefix))
+			capture_directory = arg.substr(capture_prefix.size());
+
+	// Write recent CPU profiling scopes on exit, as Chrome trace events.
+	constexpr std::string_view trace_prefix = "--trace=";
+	std::optional<std::filesystem::path> trace_path;
+	for (std::string_view const arg : std::span{argv, static_cast<std::size_t>(argc)})
+		if (arg.starts_with(trace_prefix))
+			trace_path = arg.substr(trace_prefix.size());
+
 	vulkandemo::LoggerPtr const logger = vulkandemo::create_logger();
+	if (trace_path && !vulkandemo::profiler::kEnabled)
+		logger->warn("CPU profiling scopes are compiled out, see vulkandemo_ENABLE_PROFILER");
 	try
 	{
-		vulkandemo::vulkandemo(logger);
+		if (headless)
+			vulkandemo::vulkandemo_headless(logger, headless_frame_count, capture_directory);
+		else
+			vulkandemo::vulkandemo(logger, show_hud, window_count);
+
+		if (trace_path)
+		{
+			vulkandemo::profiler::write_chrome_trace(*trace_path);
+			logger->info("Wrote trace to {}", trace_path->string());
+		}
 	}
 	catch (std::exception & exc)
 	{
@@ -0,0 +1,370 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#include "maths.hpp"
+
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner) for `logger`
+
+#include <doctest/doctest.h>
+
+#include "Logger.hpp"
+#include "bench.hpp"
+#include "simd.hpp"
+
+// The maths module is header-only, so this translation unit holds only its tests.
+
+namespace vulkandemo::maths
+{
+namespace
+{
+static_assert(kIdentity * kIdentity == kIdentity);
+static_assert(translation({1, 2, 3}) * translation({4, 5, 6}) == translation({5, 7, 9}));
+static_assert(scaling({2, 2, 2}) * Vec4{1, 2, 3, 1} == Vec4{2, 4, 6, 1});
+static_assert(transform_point(translation({1, 2, 3}), {1, 1, 1}) == Vec3{2, 3, 4});
+static_assert(transform_vector(translation({1, 2, 3}), {1, 1, 1}) == Vec3{1, 1, 1});
+static_assert(transpose(transpose(translation({1, 2, 3}))) == translation({1, 2, 3}));
+static_assert(inverse_affine(translation({1, 2, 3})) == translation({-1, -2, -3}));
+static_assert(cross(Vec3{1, 0, 0}, Vec3{0, 1, 0}) == Vec3{0, 0, 1});
+static_assert(rotation(kIdentityQuat) == kIdentity);
+static_assert(compose({1, 2, 3}, kIdentityQuat, {1, 1, 1}) == translation({1, 2, 3}));
+
+Mat4 make_random_matrix(std::mt19937 & rng)
+{
+	std::uniform_real_distribution<float> dist{-10.0F, 10.0F};
+	Mat4 mat{};
+	for (Vec4 & column : mat.columns)
+		column = {dist(rng), dist(rng), dist(rng), dist(rng)};
+	return mat;
+}
+
+struct Vec3Soa
+{
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+
+	explicit Vec3Soa(std::size_t const count) : x(count), y(count), z(count) {}
+
+	Vec3Span span()
+	{
+		return {x, y, z};
+	}
+
+	bool operator==(Vec3Soa const &) const = default;
+};
+
+Vec3Soa make_random_vectors(std::size_t const count)
+{
+	std::mt19937 rng{42};  // NOLINT(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+	std::uniform_real_distribution<float> dist{-100.0F, 100.0F};
+	Vec3Soa vectors{count};
+	for (std::size_t idx = 0; idx < count; ++idx)
+	{
+		vectors.x[idx] = dist(rng);
+		vectors.y[idx] = dist(rng);
+		vectors.z[idx] = dist(rng);
+	}
+	return vectors;
+}
+
+/**
+ * Bitwise equality, except that all NaNs are equal since their payloads are not specified.
+ */
+bool identical(Vec4 const & actual, Vec4 const & expected)
+{
+	auto const same = [](float const lhs, float const rhs)
+	{
+		if (std::isnan(lhs) || std::isnan(rhs))
+			return std::isnan(lhs) && std::isnan(rhs);
+		return std::bit_cast<uint32_t>(lhs) == std::bit_cast<uint32_t>(rhs);
+	};
+	return same(actual.x, expected.x) && same(actual.y, expected.y) &&
+		same(actual.z, expected.z) && same(actual.w, expected.w);
+}
+
+bool identical(Mat4 const & actual, Mat4 const & expected)
+{
+	for (std::size_t column = 0; column < 4; ++column)
+		if (!identical(actual.columns[column], expected.columns[column]))
+			return false;
+	return true;
+}
+
+void check_close(Vec3 const & actual, Vec3 const & expected)
+{
+	CHECK(actual.x == doctest::Approx(expected.x).epsilon(1e-5));
+	CHECK(actual.y == doctest::Approx(expected.y).epsilon(1e-5));
+	CHECK(actual.z == doctest::Approx(expected.z).epsilon(1e-5));
+}
+}  // namespace
+
+TEST_CASE("Multiply matrices with every kernel identically to scalar")
+{
+	constexpr float inf = std::numeric_limits<float>::infinity();
+	constexpr float nan = std::numeric_limits<float>::quiet_NaN();
+	constexpr float huge = std::numeric_limits<float>::max();
+	constexpr float denormal = std::numeric_limits<float>::denorm_min();
+	constexpr float tiny = std::numeric_limits<float>::min();
+
+	std::vector<Mat4> matrices{
+		kIdentity,
+		Mat4{},
+		Mat4{
+			.columns = {{{-0.0F, -0.0F, -0.0F, -0.0F},
+						 {-0.0F, -0.0F, -0.0F, -0.0F},
+						 {-0.0F, -0.0F, -0.0F, -0.0F},
+						 {-0.0F, -0.0F, -0.0F, -0.0F}}}},
+		// Overflow to infinity, and cancellation of opposite signs.
+		Mat4{
+			.columns = {{{huge, -huge, huge, 1},
+						 {huge, huge, -huge, 1},
+						 {1, 2, 3, 4},
+						 {-1, 0, 1, 0}}}},
+		// Infinity times zero and infinity minus infinity are NaN.
+		Mat4{
+			.columns = {{{inf, -inf, 0, 1},
+						 {inf, inf, nan, 1},
+						 {0, 1, -inf, 1},
+						 {nan, 0, 0, 1}}}},
+		// Denormal inputs, and products of tiny normals underflowing to denormals.
+		Mat4{
+			.columns = {{{denormal, -denormal, tiny, 1},
+						 {tiny, tiny, -denormal, 0},
+						 {-tiny, 0, denormal, 1},
+						 {1, denormal, 0, tiny}}}}};
+	std::mt19937 rng{42};  // NOLINT(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+	for (std::size_t sample = 0; sample < 100; ++sample)
+		matrices.push_back(make_random_matrix(rng));
+
+	for (simd::Kernel const kernel :
+		 {simd::Kernel::kScalar, simd::Kernel::kSse2, simd::Kernel::kAvx2, simd::Kernel::kNeon})
+	{
+		CAPTURE(simd::kernel_name(kernel));
+		if (!simd::is_kernel_supported(kernel))
+		{
+			CHECK_THROWS_AS(multiply(kIdentity, kIdentity, kernel), std::runtime_error);
+			CHECK_THROWS_AS(multiply(kIdentity, Vec4{}, kernel), std::runtime_error);
+			continue;
+		}
+
+		for (Mat4 const & lhs : matrices)
+		{
+			for (Mat4 const & rhs : matrices)
+			{
+				CHECK(identical(multiply(lhs, rhs, kernel), detail::multiply_scalar(lhs, rhs)));
+				for (Vec4 const & vec : rhs.columns)
+					CHECK(identical(multiply(lhs, vec, kernel), detail::multiply_scalar(lhs, vec)));
+			}
+		}
+	}
+
+	// The operators use the best kernel.
+	Mat4 const & rhs = matrices.back();
+	for (Mat4 const & lhs : matrices)
+	{
+		CHECK(identical(lhs * rhs, detail::multiply_scalar(lhs, rhs)));
+		CHECK(identical(lhs * rhs.columns[0], detail::multiply_scalar(lhs, rhs.columns[0])));
+	}
+}
+
+TEST_CASE("Transform with matrices and quaternions")
+{
+	constexpr float quarter_turn = std::numbers::pi_v<float> / 2;
+	Quat const about_z = from_axis_angle({0, 0, 1}, quarter_turn);
+
+	SUBCASE("rotate")
+	{
+		check_close(rotate(about_z, {1, 0, 0}), {0, 1, 0});
+		check_close(transform_vector(rotation(about_z), {1, 0, 0}), {0, 1, 0});
+		check_close(rotate(about_z * about_z, {1, 0, 0}), {-1, 0, 0});
+		check_close(rotate(conjugate(about_z), {1, 0, 0}), {0, -1, 0});
+	}
+
+	SUBCASE("nlerp")
+	{
+		Quat const halfway = nlerp(kIdentityQuat, about_z, 0.5F);
+		constexpr float diagonal = std::numbers::sqrt2_v<float> / 2;
+		check_close(rotate(halfway, {1, 0, 0}), {diagonal, diagonal, 0});
+		// Shortest arc, even though the negated quaternion is the same rotation.
+		Quat const negated{-about_z.x, -about_z.y, -about_z.z, -about_z.w};
+		check_close(
+			rotate(nlerp(kIdentityQuat, negated, 0.5F), {1, 0, 0}), {diagonal, diagonal, 0});
+	}
+
+	SUBCASE("inverse")
+	{
+		Mat4 const mat = compose({1, -2, 3}, normalise(Quat{1, 2, 3, 4}), {2, 3, 4});
+		Mat4 const round_trip = inverse_affine(mat) * mat;
+		for (std::size_t column = 0; column < 4; ++column)
+		{
+			CHECK(dot(round_trip.columns[column], kIdentity.columns[column]) ==
+				  doctest::Approx(1).epsilon(1e-5));
+		}
+		Vec3 const point = transform_point(mat, {5, 6, 7});
+		check_close(transform_point(inverse_affine(mat), point), {5, 6, 7});
+	}
+
+	SUBCASE("camera")
+	{
+		constexpr float near = 0.1F;
+		constexpr float far = 100.0F;
+		Mat4 const view = look_at({0, 0, 5}, {0, 0, 0}, {0, 1, 0});
+		check_close(transform_point(view, {0, 0, 0}), {0, 0, -5});
+		check_close(transform_point(view, {1, 0, 0}), {1, 0, -5});
+
+		Mat4 const projection = perspective(quarter_turn, 1, near, far);
+		Vec4 const near_clip = projection * Vec4{0, 0, -near, 1};
+		Vec4 const far_clip = projection * Vec4{0, 0, -far, 1};
+		CHECK(near_clip.z / near_clip.w == doctest::Approx(0));
+		CHECK(far_clip.z / far_clip.w == doctest::Approx(1));
+	}
+}
+
+TEST_CASE("Batch maths on random vectors with SIMD kernels")
+{
+	// Not a multiple of any kernel's width, to exercise the scalar remainder.
+	constexpr std::size_t count = 1003;
+	Vec3Soa const in = make_random_vectors(count);
+	Vec3Soa const other = make_random_vectors(count + 1);
+	ConstVec3Span const in_span{in.x, in.y, in.z};
+	// Offset by one so that inputs are not all equally aligned.
+	ConstVec3Span const other_span{
+		std::span{other.x}.subspan(1),
+		std::span{other.y}.subspan(1),
+		std::span{other.z}.subspan(1)};
+	std::mt19937 rng{42};  // NOLINT(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+	Mat4 const mat = make_random_matrix(rng);
+
+	Vec3Soa expected_points{count};
+	Vec3Soa expected_normals{count};
+	std::vector<float> expected_dots(count);
+	transform_points(mat, in_span, expected_points.span(), simd::Kernel::kScalar);
+	normalise(in_span, expected_normals.span(), simd::Kernel::kScalar);
+	dot(in_span, other_span, expected_dots, simd::Kernel::kScalar);
+
+	for (std::size_t idx = 0; idx < count; ++idx)
+	{
+		Vec3 const vec{in.x[idx], in.y[idx], in.z[idx]};
+		CHECK(Vec3{expected_points.x[idx], expected_points.y[idx], expected_points.z[idx]} ==
+			  transform_point(mat, vec));
+		CHECK(Vec3{expected_normals.x[idx], expected_normals.y[idx], expected_normals.z[idx]} ==
+			  normalise(vec));
+	}
+
+	for (simd::Kernel const kernel :
+		 {simd::Kernel::kScalar, simd::Kernel::kSse2, simd::Kernel::kAvx2, simd::Kernel::kNeon})
+	{
+		CAPTURE(simd::kernel_name(kernel));
+		Vec3Soa points{count};
+		Vec3Soa normals{count};
+		std::vector<float> dots(count);
+
+		if (!simd::is_kernel_supported(kernel))
+		{
+			CHECK_THROWS_AS(
+				transform_points(mat, in_span, points.span(), kernel), std::runtime_error);
+			continue;
+		}
+
+		transform_points(mat, in_span, points.span(), kernel);
+		normalise(in_span, normals.span(), kernel);
+		dot(in_span, other_span, dots, kernel);
+		CHECK(points == expected_points);
+		CHECK(normals == expected_normals);
+		CHECK(dots == expected_dots);
+	}
+
+	Vec3Soa short_out{count - 1};
+	CHECK_THROWS_AS(transform_points(mat, in_span, short_out.span()), std::invalid_argument);
+	CHECK_THROWS_AS(normalise(in_span, short_out.span()), std::invalid_argument);
+	CHECK_THROWS_AS(dot(in_span, other_span, short_out.x), std::invalid_argument);
+}
+
+TEST_CASE("Benchmark maths" * doctest::test_suite("benchmark") * doctest::skip())
+{
+	LoggerPtr const logger = create_logger("Benchmark maths");
+	logger->info("Best kernel {}", simd::kernel_name(simd::best_kernel()));
+	std::mt19937 rng{42};  // NOLINT(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+
+	{
+		constexpr std::size_t matrix_count = 1024;
+		constexpr std::size_t iterations = 1000;
+		std::vector<Mat4> matrices(matrix_count);
+		for (Mat4 & mat : matrices)
+			mat = make_random_matrix(rng);
+
+		std::vector<Mat4> simd_products(matrix_count);
+		double const simd_ms = bench::mean_ms(
+			iterations,
+			[&]
+			{
+				for (std::size_t idx = 0; idx < matrix_count; ++idx)
+					simd_products[idx] = matrices[idx] * matrices[(idx + 1) % matrix_count];
+			});
+		std::vector<Mat4> scalar_products(matrix_count);
+		double const scalar_ms = bench::mean_ms(
+			iterations,
+			[&]
+			{
+				for (std::size_t idx = 0; idx < matrix_count; ++idx)
+				{
+					scalar_products[idx] = detail::multiply_scalar(
+						matrices[idx], matrices[(idx + 1) % matrix_count]);
+				}
+			});
+		CHECK(simd_products == scalar_products);
+		logger->info(
+			"{} matrix products: scalar {:.4f} ms, SIMD {:.4f} ms ({:.1f}x)",
+			matrix_count,
+			scalar_ms,
+			simd_ms,
+			scalar_ms / simd_ms);
+	}
+
+	for (std::size_t const count : {10'000UZ, 100'000UZ, 1'000'000UZ})
+	{
+		constexpr std::size_t iterations = 20;
+		Vec3Soa const in = make_random_vectors(count);
+		ConstVec3Span const in_span{in.x, in.y, in.z};
+		Vec3Soa out{count};
+		Mat4 const mat = make_random_matrix(rng);
+
+		double scalar_transform_ms = 0;
+		double scalar_normalise_ms = 0;
+		for (simd::Kernel const kernel :
+			 {simd::Kernel::kScalar, simd::Kernel::kSse2, simd::Kernel::kAvx2, simd::Kernel::kNeon})
+		{
+			if (!simd::is_kernel_supported(kernel))
+				continue;
+
+			double const transform_ms = bench::mean_ms(
+				iterations, [&] { transform_points(mat, in_span, out.span(), kernel); });
+			double const normalise_ms =
+				bench::mean_ms(iterations, [&] { normalise(in_span, out.span(), kernel); });
+			if (kernel == simd::Kernel::kScalar)
+			{
+				scalar_transform_ms = transform_ms;
+				scalar_normalise_ms = normalise_ms;
+			}
+
+			logger->info(
+				"{} vectors: {} transform {:.3f} ms ({:.1f}x), normalise {:.3f} ms ({:.1f}x)",
+				count,
+				simd::kernel_name(kernel),
+				transform_ms,
+				scalar_transform_ms / transform_ms,
+				normalise_ms,
+				scalar_normalise_ms / normalise_ms);
+		}
+	}
+}
+}  // namespace vulkandemo::maths
@@ -0,0 +1,1076 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "simd.hpp"
+
+/**
+ * Vector, matrix and quaternion maths for transforms, projection and culling.
+ *
+ * Matrices are column-major, matching GLSL, so can be copied directly to buffers and push
+ * constants. Projections follow Vulkan clip space conventions, i.e. 0 <= z <= w, as per
+ * frustum::extract_planes.
+ *
+ * Operations on single values are `constexpr`, except those calling `<cmath>` functions, i.e.
+ * length, normalise, perspective, look_at, from_axis_angle and nlerp, which cannot be until C++26.
+ * Matrix products take a scalar path when evaluated at compile time, and at runtime the kernel of
+ * simd::best_kernel, i.e. SSE2, AVX2 (matrix-matrix only) or NEON. Other single value operations
+ * are left scalar, which compilers vectorise as well as hand written SIMD for operations this
+ * small.
+ *
+ * Batch operations over structure-of-arrays spans choose a kernel at runtime, as per
+ * simd::Kernel, processing 4 or 8 elements per instruction.
+ *
+ * All paths multiply and add in the same order without fusing, so results are identical across
+ * paths and kernels.
+ */
+namespace vulkandemo::maths
+{
+struct Vec3
+{
+	float x;
+	float y;
+	float z;
+
+	constexpr bool operator==(Vec3 const &) const = default;
+};
+
+struct alignas(16) Vec4
+{
+	float x;
+	float y;
+	float z;
+	float w;
+
+	constexpr bool operator==(Vec4 const &) const = default;
+};
+
+/**
+ * Column-major 4x4 matrix.
+ */
+struct alignas(16) Mat4
+{
+	std::array<Vec4, 4> columns;
+
+	constexpr bool operator==(Mat4 const &) const = default;
+};
+
+/**
+ * Rotation quaternion `w + xi + yj + zk`.
+ */
+struct alignas(16) Quat
+{
+	float x;
+	float y;
+	float z;
+	float w;
+
+	constexpr bool operator==(Quat const &) const = default;
+};
+
+/**
+ * Read-only structure-of-arrays view of 3D vectors. All spans are the same length.
+ */
+struct ConstVec3Span
+{
+	std::span<float const> x;
+	std::span<float const> y;
+	std::span<float const> z;
+};
+
+/**
+ * Mutable structure-of-arrays view of 3D vectors. All spans are the same length.
+ */
+struct Vec3Span
+{
+	std::span<float> x;
+	std::span<float> y;
+	std::span<float> z;
+
+	// NOLINTNEXTLINE(*-explicit-constructor,*-explicit-conversions) as for std::span
+	constexpr operator ConstVec3Span() const
+	{
+		return {x, y, z};
+	}
+};
+
+inline constexpr Mat4 kIdentity{
+	.columns = {{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}}}};
+
+inline constexpr Quat kIdentityQuat{0, 0, 0, 1};
+
+// Vec3
+
+constexpr Vec3 operator+(Vec3 const & lhs, Vec3 const & rhs)
+{
+	return {lhs.x + rhs.x, lhs.y + rhs.y, lhs.z + rhs.z};
+}
+
+constexpr Vec3 operator-(Vec3 const & lhs, Vec3 const & rhs)
+{
+	return {lhs.x - rhs.x, lhs.y - rhs.y, lhs.z - rhs.z};
+}
+
+constexpr Vec3 operator-(Vec3 const & vec)
+{
+	return {-vec.x, -vec.y, -vec.z};
+}
+
+constexpr Vec3 operator*(Vec3 const & vec, float const factor)
+{
+	return {vec.x * factor, vec.y * factor, vec.z * factor};
+}
+
+constexpr Vec3 operator*(float const factor, Vec3 const & vec)
+{
+	return vec * factor;
+}
+
+constexpr Vec3 operator/(Vec3 const & vec, float const divisor)
+{
+	return {vec.x / divisor, vec.y / divisor, vec.z / divisor};
+}
+
+constexpr float dot(Vec3 const & lhs, Vec3 const & rhs)
+{
+	return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z;
+}
+
+constexpr Vec3 cross(Vec3 const & lhs, Vec3 const & rhs)
+{
+	return {
+		lhs.y * rhs.z - lhs.z * rhs.y,
+		lhs.z * rhs.x - lhs.x * rhs.z,
+		lhs.x * rhs.y - lhs.y * rhs.x};
+}
+
+inline float length(Vec3 const & vec)
+{
+	return std::sqrt(dot(vec, vec));
+}
+
+/**
+ * @param vec Must be non-zero.
+ * @return Unit length vector in the same direction.
+ */
+inline Vec3 normalise(Vec3 const & vec)
+{
+	return vec / length(vec);
+}
+
+// Vec4
+
+constexpr Vec4 operator+(Vec4 const & lhs, Vec4 const & rhs)
+{
+	return {lhs.x + rhs.x, lhs.y + rhs.y, lhs.z + rhs.z, lhs.w + rhs.w};
+}
+
+constexpr Vec4 operator-(Vec4 const & lhs, Vec4 const & rhs)
+{
+	return {lhs.x - rhs.x, lhs.y - rhs.y, lhs.z - rhs.z, lhs.w - rhs.w};
+}
+
+constexpr Vec4 operator*(Vec4 const & vec, float const factor)
+{
+	return {vec.x * factor, vec.y * factor, vec.z * factor, vec.w * factor};
+}
+
+constexpr Vec4 operator*(float const factor, Vec4 const & vec)
+{
+	return vec * factor;
+}
+
+constexpr float dot(Vec4 const & lhs, Vec4 const & rhs)
+{
+	return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * rhs.z + lhs.w * rhs.w;
+}
+
+constexpr Vec4 to_vec4(Vec3 const & vec, float const w)
+{
+	return {vec.x, vec.y, vec.z, w};
+}
+
+constexpr Vec3 to_vec3(Vec4 const & vec)
+{
+	return {vec.x, vec.y, vec.z};
+}
+
+namespace detail
+{
+inline void check_kernel(simd::Kernel const kernel)
+{
+	if (!simd::is_kernel_supported(kernel))
+		throw std::runtime_error{
+			std::string{"Maths kernel not supported: "} + std::string{simd::kernel_name(kernel)}};
+}
+
+// Scalar reference implementations, also used at compile time.
+
+constexpr Vec4 multiply_scalar(Mat4 const & mat, Vec4 const & vec)
+{
+	return mat.columns[0] * vec.x + mat.columns[1] * vec.y + mat.columns[2] * vec.z +
+		mat.columns[3] * vec.w;
+}
+
+constexpr Mat4 multiply_scalar(Mat4 const & lhs, Mat4 const & rhs)
+{
+	return {
+		.columns = {
+			multiply_scalar(lhs, rhs.columns[0]),
+			multiply_scalar(lhs, rhs.columns[1]),
+			multiply_scalar(lhs, rhs.columns[2]),
+			multiply_scalar(lhs, rhs.columns[3])}};
+}
+
+#if defined(__x86_64__)
+// SSE2 is part of the x86-64 baseline, so needs no runtime check.
+
+inline __m128 load(Vec4 const & vec)
+{
+	return _mm_load_ps(&vec.x);
+}
+
+inline __m128 multiply_sse2(
+	__m128 const col0, __m128 const col1, __m128 const col2, __m128 const col3, Vec4 const & vec)
+{
+	return _mm_add_ps(
+		_mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(col0, _mm_set1_ps(vec.x)), _mm_mul_ps(col1, _mm_set1_ps(vec.y))),
+			_mm_mul_ps(col2, _mm_set1_ps(vec.z))),
+		_mm_mul_ps(col3, _mm_set1_ps(vec.w)));
+}
+
+inline Vec4 multiply_sse2(Mat4 const & mat, Vec4 const & vec)
+{
+	Vec4 out;
+	_mm_store_ps(
+		&out.x,
+		multiply_sse2(
+			load(mat.columns[0]),
+			load(mat.columns[1]),
+			load(mat.columns[2]),
+			load(mat.columns[3]),
+			vec));
+	return out;
+}
+
+inline Mat4 multiply_sse2(Mat4 const & lhs, Mat4 const & rhs)
+{
+	__m128 const col0 = load(lhs.columns[0]);
+	__m128 const col1 = load(lhs.columns[1]);
+	__m128 const col2 = load(lhs.columns[2]);
+	__m128 const col3 = load(lhs.columns[3]);
+	Mat4 out;
+	for (std::size_t col = 0; col < 4; ++col)
+		_mm_store_ps(
+			&out.columns[col].x, multiply_sse2(col0, col1, col2, col3, rhs.columns[col]));
+	return out;
+}
+
+// AVX2 must be checked at runtime, see simd::is_kernel_supported. Two result columns per
+// instruction, each left column duplicated into both halves and each right element broadcast
+// within its half.
+__attribute__((target("avx2"))) inline Mat4 multiply_avx2(Mat4 const & lhs, Mat4 const & rhs)
+{
+	// NOLINTBEGIN(*-reinterpret-cast)
+	__m256 const col0 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(&lhs.columns[0]));
+	__m256 const col1 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(&lhs.columns[1]));
+	__m256 const col2 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(&lhs.columns[2]));
+	__m256 const col3 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(&lhs.columns[3]));
+	// NOLINTEND(*-reinterpret-cast)
+	Mat4 out;
+	for (std::size_t col = 0; col < 4; col += 2)
+	{
+		__m256 const right = _mm256_loadu_ps(&rhs.columns[col].x);
+		_mm256_storeu_ps(
+			&out.columns[col].x,
+			_mm256_add_ps(
+				_mm256_add_ps(
+					_mm256_add_ps(
+						_mm256_mul_ps(col0, _mm256_permute_ps(right, 0x00)),
+						_mm256_mul_ps(col1, _mm256_permute_ps(right, 0x55))),
+					_mm256_mul_ps(col2, _mm256_permute_ps(right, 0xAA))),
+				_mm256_mul_ps(col3, _mm256_permute_ps(right, 0xFF))));
+	}
+	return out;
+}
+#endif
+
+#if defined(__aarch64__)
+// NEON is mandatory on AArch64, so needs no runtime check.
+
+inline float32x4_t multiply_neon(
+	float32x4_t const col0,
+	float32x4_t const col1,
+	float32x4_t const col2,
+	float32x4_t const col3,
+	Vec4 const & vec)
+{
+	return vaddq_f32(
+		vaddq_f32(
+			vaddq_f32(vmulq_n_f32(col0, vec.x), vmulq_n_f32(col1, vec.y)),
+			vmulq_n_f32(col2, vec.z)),
+		vmulq_n_f32(col3, vec.w));
+}
+
+inline Vec4 multiply_neon(Mat4 const & mat, Vec4 const & vec)
+{
+	Vec4 out;
+	vst1q_f32(
+		&out.x,
+		multiply_neon(
+			vld1q_f32(&mat.columns[0].x),
+			vld1q_f32(&mat.columns[1].x),
+			vld1q_f32(&mat.columns[2].x),
+			vld1q_f32(&mat.columns[3].x),
+			vec));
+	return out;
+}
+
+inline Mat4 multiply_neon(Mat4 const & lhs, Mat4 const & rhs)
+{
+	float32x4_t const col0 = vld1q_f32(&lhs.columns[0].x);
+	float32x4_t const col1 = vld1q_f32(&lhs.columns[1].x);
+	float32x4_t const col2 = vld1q_f32(&lhs.columns[2].x);
+	float32x4_t const col3 = vld1q_f32(&lhs.columns[3].x);
+	Mat4 out;
+	for (std::size_t col = 0; col < 4; ++col)
+		vst1q_f32(&out.columns[col].x, multiply_neon(col0, col1, col2, col3, rhs.columns[col]));
+	return out;
+}
+#endif
+
+// Kernels must be supported. AVX2 has no single vector product, since a column only fills half a
+// register, so uses SSE2.
+
+inline Vec4 multiply(Mat4 const & mat, Vec4 const & vec, simd::Kernel const kernel)
+{
+	switch (kernel)
+	{
+#if defined(__x86_64__)
+		case simd::Kernel::kSse2:
+		case simd::Kernel::kAvx2:
+			return multiply_sse2(mat, vec);
+#endif
+#if defined(__aarch64__)
+		case simd::Kernel::kNeon:
+			return multiply_neon(mat, vec);
+#endif
+		default:
+			return multiply_scalar(mat, vec);
+	}
+}
+
+inline Mat4 multiply(Mat4 const & lhs, Mat4 const & rhs, simd::Kernel const kernel)
+{
+	switch (kernel)
+	{
+#if defined(__x86_64__)
+		case simd::Kernel::kSse2:
+			return multiply_sse2(lhs, rhs);
+		case simd::Kernel::kAvx2:
+			return multiply_avx2(lhs, rhs);
+#endif
+#if defined(__aarch64__)
+		case simd::Kernel::kNeon:
+			return multiply_neon(lhs, rhs);
+#endif
+		default:
+			return multiply_scalar(lhs, rhs);
+	}
+}
+}  // namespace detail
+
+// Mat4
+
+constexpr Vec4 operator*(Mat4 const & mat, Vec4 const & vec)
+{
+	if consteval
+	{
+		return detail::multiply_scalar(mat, vec);
+	}
+	else
+	{
+		return detail::multiply(mat, vec, simd::best_kernel());
+	}
+}
+
+constexpr Mat4 operator*(Mat4 const & lhs, Mat4 const & rhs)
+{
+	if consteval
+	{
+		return detail::multiply_scalar(lhs, rhs);
+	}
+	else
+	{
+		return detail::multiply(lhs, rhs, simd::best_kernel());
+	}
+}
+
+/**
+ * Matrix-vector product with a given kernel, e.g. to compare kernels. operator* uses the best.
+ *
+ * @param mat
+ * @param vec
+ * @param kernel Must be supported, see simd::is_kernel_supported.
+ * @return
+ */
+inline Vec4 multiply(Mat4 const & mat, Vec4 const & vec, simd::Kernel const kernel)
+{
+	detail::check_kernel(kernel);
+	return detail::multiply(mat, vec, kernel);
+}
+
+/**
+ * Matrix product with a given kernel, e.g. to compare kernels. operator* uses the best.
+ *
+ * @param lhs
+ * @param rhs
+ * @param kernel Must be supported, see simd::is_kernel_supported.
+ * @return
+ */
+inline Mat4 multiply(Mat4 const & lhs, Mat4 const & rhs, simd::Kernel const kernel)
+{
+	detail::check_kernel(kernel);
+	return detail::multiply(lhs, rhs, kernel);
+}
+
+/**
+ * Transform a point, i.e. with `w = 1`, without perspective division.
+ *
+ * @param mat
+ * @param point
+ * @return
+ */
+constexpr Vec3 transform_point(Mat4 const & mat, Vec3 const & point)
+{
+	return to_vec3(mat * to_vec4(point, 1));
+}
+
+/**
+ * Transform a direction, i.e. with `w = 0`, so unaffected by translation.
+ *
+ * @param mat
+ * @param vec
+ * @return
+ */
+constexpr Vec3 transform_vector(Mat4 const & mat, Vec3 const & vec)
+{
+	return to_vec3(mat * to_vec4(vec, 0));
+}
+
+constexpr Mat4 transpose(Mat4 const & mat)
+{
+	auto const & [c0, c1, c2, c3] = mat.columns;
+	return {
+		.columns = {{
+			{c0.x, c1.x, c2.x, c3.x},
+			{c0.y, c1.y, c2.y, c3.y},
+			{c0.z, c1.z, c2.z, c3.z},
+			{c0.w, c1.w, c2.w, c3.w},
+		}}};
+}
+
+constexpr Mat4 translation(Vec3 const & offset)
+{
+	Mat4 mat = kIdentity;
+	mat.columns[3] = to_vec4(offset, 1);
+	return mat;
+}
+
+constexpr Mat4 scaling(Vec3 const & factors)
+{
+	Mat4 mat = kIdentity;
+	mat.columns[0].x = factors.x;
+	mat.columns[1].y = factors.y;
+	mat.columns[2].z = factors.z;
+	return mat;
+}
+
+/**
+ * Inverse of a matrix whose bottom row is `(0, 0, 0, 1)`, e.g. a combination of translation,
+ * rotation and scale.
+ *
+ * @param mat Must be invertible.
+ * @return
+ */
+constexpr Mat4 inverse_affine(Mat4 const & mat)
+{
+	Vec3 const col0 = to_vec3(mat.columns[0]);
+	Vec3 const col1 = to_vec3(mat.columns[1]);
+	Vec3 const col2 = to_vec3(mat.columns[2]);
+	// Rows of the inverse of the upper 3x3 are the cross products of pairs of columns, divided by
+	// the determinant.
+	Vec3 const row0 = cross(col1, col2);
+	Vec3 const row1 = cross(col2, col0);
+	Vec3 const row2 = cross(col0, col1);
+	float const inv_det = 1.0F / dot(col0, row0);
+	Mat4 const rotation_scale = transpose(Mat4{
+		.columns = {{
+			to_vec4(row0 * inv_det, 0),
+			to_vec4(row1 * inv_det, 0),
+			to_vec4(row2 * inv_det, 0),
+			{0, 0, 0, 1},
+		}}});
+	Mat4 inverse = rotation_scale;
+	inverse.columns[3] = to_vec4(-transform_vector(rotation_scale, to_vec3(mat.columns[3])), 1);
+	return inverse;
+}
+
+/**
+ * Perspective projection for a camera looking down -z, with Vulkan clip space conventions.
+ *
+ * @param fov_y Vertical field of view, in radians.
+ * @param aspect Width over height.
+ * @param near
+ * @param far
+ * @return
+ */
+inline Mat4 perspective(float const fov_y, float const aspect, float const near, float const far)
+{
+	float const focal = 1.0F / std::tan(fov_y / 2);
+	return {
+		.columns = {{
+			{focal / aspect, 0, 0, 0},
+			{0, focal, 0, 0},
+			{0, 0, far / (near - far), -1},
+			{0, 0, near * far / (near - far), 0},
+		}}};
+}
+
+/**
+ * View matrix for a camera at @p eye looking towards @p target, with -z forward.
+ *
+ * @param eye
+ * @param target Must differ from @p eye.
+ * @param up Must not be parallel to the view direction.
+ * @return
+ */
+inline Mat4 look_at(Vec3 const & eye, Vec3 const & target, Vec3 const & up)
+{
+	Vec3 const forward = normalise(target - eye);
+	Vec3 const right = normalise(cross(forward, up));
+	Vec3 const camera_up = cross(right, forward);
+	return {
+		.columns = {{
+			{right.x, camera_up.x, -forward.x, 0},
+			{right.y, camera_up.y, -forward.y, 0},
+			{right.z, camera_up.z, -forward.z, 0},
+			{-dot(right, eye), -dot(camera_up, eye), dot(forward, eye), 1},
+		}}};
+}
+
+// Quat
+
+/**
+ * Hamilton product, i.e. the rotation @p rhs followed by @p lhs.
+ */
+constexpr Quat operator*(Quat const & lhs, Quat const & rhs)
+{
+	return {
+		lhs.w * rhs.x + lhs.x * rhs.w + lhs.y * rhs.z - lhs.z * rhs.y,
+		lhs.w * rhs.y - lhs.x * rhs.z + lhs.y * rhs.w + lhs.z * rhs.x,
+		lhs.w * rhs.z + lhs.x * rhs.y - lhs.y * rhs.x + lhs.z * rhs.w,
+		lhs.w * rhs.w - lhs.x * rhs.x - lhs.y * rhs.y - lhs.z * rhs.z};
+}
+
+constexpr Quat conjugate(Quat const & quat)
+{
+	return {-quat.x, -quat.y, -quat.z, quat.w};
+}
+
+/**
+ * @param axis Must be unit length.
+ * @param angle In radians, anticlockwise looking down the axis towards the origin.
+ * @return
+ */
+inline Quat from_axis_angle(Vec3 const & axis, float const angle)
+{
+	float const half_sin = std::sin(angle / 2);
+	return {axis.x * half_sin, axis.y * half_sin, axis.z * half_sin, std::cos(angle / 2)};
+}
+
+inline Quat normalise(Quat const & quat)
+{
+	float const norm = std::sqrt(
+		quat.x * quat.x + quat.y * quat.y + quat.z * quat.z + quat.w * quat.w);
+	return {quat.x / norm, quat.y / norm, quat.z / norm, quat.w / norm};
+}
+
+/**
+ * Rotate a vector by a unit quaternion.
+ *
+ * @param quat Must be unit length.
+ * @param vec
+ * @return
+ */
+constexpr Vec3 rotate(Quat const & quat, Vec3 const & vec)
+{
+	// v + 2w(q x v) + 2q x (q x v), avoiding the two full quaternion products of q v q*.
+	Vec3 const axis{quat.x, quat.y, quat.z};
+	Vec3 const twice_cross = cross(axis, vec) * 2.0F;
+	return vec + twice_cross * quat.w + cross(axis, twice_cross);
+}
+
+/**
+ * Rotation matrix of a unit quaternion.
+ *
+ * @param quat Must be unit length.
+ * @return
+ */
+constexpr Mat4 rotation(Quat const & quat)
+{
+	float const xx = quat.x * quat.x;
+	float const yy = quat.y * quat.y;
+	float const zz = quat.z * quat.z;
+	float const xy = quat.x * quat.y;
+	float const xz = quat.x * quat.z;
+	float const yz = quat.y * quat.z;
+	float const wx = quat.w * quat.x;
+	float const wy = quat.w * quat.y;
+	float const wz = quat.w * quat.z;
+	return {
+		.columns = {{
+			{1 - 2 * (yy + zz), 2 * (xy + wz), 2 * (xz - wy), 0},
+			{2 * (xy - wz), 1 - 2 * (xx + zz), 2 * (yz + wx), 0},
+			{2 * (xz + wy), 2 * (yz - wx), 1 - 2 * (xx + yy), 0},
+			{0, 0, 0, 1},
+		}}};
+}
+
+/**
+ * Normalised linear interpolation along the shortest arc, a cheap approximation of slerp.
+ *
+ * @param from
+ * @param to
+ * @param t In [0, 1].
+ * @return
+ */
+inline Quat nlerp(Quat const & from, Quat const & to, float const t)
+{
+	float const cos_angle = from.x * to.x + from.y * to.y + from.z * to.z + from.w * to.w;
+	float const sign = cos_angle < 0 ? -1.0F : 1.0F;
+	float const from_weight = 1 - t;
+	float const to_weight = t * sign;
+	return normalise(Quat{
+		from.x * from_weight + to.x * to_weight,
+		from.y * from_weight + to.y * to_weight,
+		from.z * from_weight + to.z * to_weight,
+		from.w * from_weight + to.w * to_weight});
+}
+
+/**
+ * Transform, rotation and scale, e.g. a scene node's local transform.
+ *
+ * @param offset
+ * @param orientation Must be unit length.
+ * @param factors
+ * @return `translation * rotation * scaling`.
+ */
+constexpr Mat4 compose(Vec3 const & offset, Quat const & orientation, Vec3 const & factors)
+{
+	Mat4 mat = rotation(orientation);
+	mat.columns[0] = mat.columns[0] * factors.x;
+	mat.columns[1] = mat.columns[1] * factors.y;
+	mat.columns[2] = mat.columns[2] * factors.z;
+	mat.columns[3] = to_vec4(offset, 1);
+	return mat;
+}
+
+// Structure-of-arrays batches
+
+namespace detail
+{
+inline void check_lengths(std::size_t const expected, std::size_t const actual)
+{
+	if (actual != expected)
+		throw std::invalid_argument{"Maths batch spans differ in length"};
+}
+
+inline void check_lengths(ConstVec3Span const & in)
+{
+	check_lengths(in.x.size(), in.y.size());
+	check_lengths(in.x.size(), in.z.size());
+}
+
+inline void check_lengths(ConstVec3Span const & in, Vec3Span const & out)
+{
+	check_lengths(in);
+	check_lengths(in.x.size(), out.x.size());
+	check_lengths(in.x.size(), out.y.size());
+	check_lengths(in.x.size(), out.z.size());
+}
+
+// Each kernel processes `[begin, end)`, and SIMD kernels finish any remainder with the scalar
+// kernel.
+
+inline void transform_points_scalar(
+	Mat4 const & mat,
+	ConstVec3Span const & in,
+	Vec3Span const & out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	auto const & [c0, c1, c2, c3] = mat.columns;
+	for (std::size_t idx = begin; idx < end; ++idx)
+	{
+		float const x = in.x[idx];
+		float const y = in.y[idx];
+		float const z = in.z[idx];
+		out.x[idx] = c0.x * x + c1.x * y + c2.x * z + c3.x;
+		out.y[idx] = c0.y * x + c1.y * y + c2.y * z + c3.y;
+		out.z[idx] = c0.z * x + c1.z * y + c2.z * z + c3.z;
+	}
+}
+
+inline void dot_scalar(
+	ConstVec3Span const & lhs,
+	ConstVec3Span const & rhs,
+	std::span<float> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	for (std::size_t idx = begin; idx < end; ++idx)
+		out[idx] = lhs.x[idx] * rhs.x[idx] + lhs.y[idx] * rhs.y[idx] + lhs.z[idx] * rhs.z[idx];
+}
+
+inline void normalise_scalar(
+	ConstVec3Span const & in, Vec3Span const & out, std::size_t const begin, std::size_t const end)
+{
+	for (std::size_t idx = begin; idx < end; ++idx)
+	{
+		float const x = in.x[idx];
+		float const y = in.y[idx];
+		float const z = in.z[idx];
+		float const length = std::sqrt(x * x + y * y + z * z);
+		out.x[idx] = x / length;
+		out.y[idx] = y / length;
+		out.z[idx] = z / length;
+	}
+}
+
+#if defined(__x86_64__)
+inline void transform_points_sse2(
+	Mat4 const & mat, ConstVec3Span const & in, Vec3Span const & out, std::size_t const count)
+{
+	constexpr std::size_t lane_count = 4;
+	auto const & [c0, c1, c2, c3] = mat.columns;
+	std::size_t idx = 0;
+	for (; idx + lane_count <= count; idx += lane_count)
+	{
+		__m128 const x = _mm_loadu_ps(&in.x[idx]);
+		__m128 const y = _mm_loadu_ps(&in.y[idx]);
+		__m128 const z = _mm_loadu_ps(&in.z[idx]);
+		auto const row = [&](float const m0, float const m1, float const m2, float const m3)
+		{
+			return _mm_add_ps(
+				_mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m0), x), _mm_mul_ps(_mm_set1_ps(m1), y)),
+					_mm_mul_ps(_mm_set1_ps(m2), z)),
+				_mm_set1_ps(m3));
+		};
+		_mm_storeu_ps(&out.x[idx], row(c0.x, c1.x, c2.x, c3.x));
+		_mm_storeu_ps(&out.y[idx], row(c0.y, c1.y, c2.y, c3.y));
+		_mm_storeu_ps(&out.z[idx], row(c0.z, c1.z, c2.z, c3.z));
+	}
+	transform_points_scalar(mat, in, out, idx, count);
+}
+
+inline void dot_sse2(
+	ConstVec3Span const & lhs,
+	ConstVec3Span const & rhs,
+	std::span<float> const out,
+	std::size_t const count)
+{
+	constexpr std::size_t lane_count = 4;
+	std::size_t idx = 0;
+	for (; idx + lane_count <= count; idx += lane_count)
+		_mm_storeu_ps(
+			&out[idx],
+			_mm_add_ps(
+				_mm_add_ps(
+					_mm_mul_ps(_mm_loadu_ps(&lhs.x[idx]), _mm_loadu_ps(&rhs.x[idx])),
+					_mm_mul_ps(_mm_loadu_ps(&lhs.y[idx]), _mm_loadu_ps(&rhs.y[idx]))),
+				_mm_mul_ps(_mm_loadu_ps(&lhs.z[idx]), _mm_loadu_ps(&rhs.z[idx]))));
+	dot_scalar(lhs, rhs, out, idx, count);
+}
+
+inline void normalise_sse2(ConstVec3Span const & in, Vec3Span const & out, std::size_t const count)
+{
+	constexpr std::size_t lane_count = 4;
+	std::size_t idx = 0;
+	for (; idx + lane_count <= count; idx += lane_count)
+	{
+		__m128 const x = _mm_loadu_ps(&in.x[idx]);
+		__m128 const y = _mm_loadu_ps(&in.y[idx]);
+		__m128 const z = _mm_loadu_ps(&in.z[idx]);
+		// Square root and division are correctly rounded, so match std::sqrt and scalar division.
+		__m128 const length = _mm_sqrt_ps(
+			_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+		_mm_storeu_ps(&out.x[idx], _mm_div_ps(x, length));
+		_mm_storeu_ps(&out.y[idx], _mm_div_ps(y, length));
+		_mm_storeu_ps(&out.z[idx], _mm_div_ps(z, length));
+	}
+	normalise_scalar(in, out, idx, count);
+}
+
+// Row of a matrix broadcast across all lanes. Wrapped in a struct since vector types lose their
+// alignment attributes as template arguments.
+struct RowAvx
+{
+	__m256 m0;
+	__m256 m1;
+	__m256 m2;
+	__m256 m3;
+};
+
+__attribute__((target("avx2"))) inline void transform_points_avx2(
+	Mat4 const & mat, ConstVec3Span const & in, Vec3Span const & out, std::size_t const count)
+{
+	constexpr std::size_t lane_count = 8;
+	auto const cols = std::bit_cast<std::array<std::array<float, 4>, 4>>(mat.columns);
+	std::array<RowAvx, 3> rows{};
+	for (std::size_t row = 0; row < rows.size(); ++row)
+		rows[row] = {
+			_mm256_set1_ps(cols[0][row]),
+			_mm256_set1_ps(cols[1][row]),
+			_mm256_set1_ps(cols[2][row]),
+			_mm256_set1_ps(cols[3][row])};
+	std::size_t idx = 0;
+	for (; idx + lane_count <= count; idx += lane_count)
+	{
+		__m256 const x = _mm256_loadu_ps(&in.x[idx]);
+		__m256 const y = _mm256_loadu_ps(&in.y[idx]);
+		__m256 const z = _mm256_loadu_ps(&in.z[idx]);
+		std::array<float *, 3> const outputs{&out.x[idx], &out.y[idx], &out.z[idx]};
+		for (std::size_t row = 0; row < rows.size(); ++row)
+			_mm256_storeu_ps(
+				outputs[row],
+				_mm256_add_ps(
+					_mm256_add_ps(
+						_mm256_add_ps(
+							_mm256_mul_ps(rows[row].m0, x), _mm256_mul_ps(rows[row].m1, y)),
+						_mm256_mul_ps(rows[row].m2, z)),
+					rows[row].m3));
+	}
+	transform_points_scalar(mat, in, out, idx, count);
+}
+
+__attribute__((target("avx2"))) inline void dot_avx2(
+	ConstVec3Span const & lhs,
+	ConstVec3Span const & rhs,
+	std::span<float> const out,
+	std::size_t const count)
+{
+	constexpr std::size_t lane_count = 8;
+	std::size_t idx = 0;
+	for (; idx + lane_count <= count; idx += lane_count)
+		_mm256_storeu_ps(
+			&out[idx],
+			_mm256_add_ps(
+				_mm256_add_ps(
+					_mm256_mul_ps(_mm256_loadu_ps(&lhs.x[idx]), _mm256_loadu_ps(&rhs.x[idx])),
+					_mm256_mul_ps(_mm256_loadu_ps(&lhs.y[idx]), _mm256_loadu_ps(&rhs.y[idx]))),
+				_mm256_mul_ps(_mm256_loadu_ps(&lhs.z[idx]), _mm256_loadu_ps(&rhs.z[idx]))));
+	dot_scalar(lhs, rhs, out, idx, count);
+}
+
+__attribute__((target("avx2"))) inline void normalise_avx2(
+	ConstVec3Span const & in, Vec3Span const & out, std::size_t const count)
+{
+	constexpr std::size_t lane_count = 8;
+	std::size_t idx = 0;
+	for (; idx + lane_count <= count; idx += lane_count)
+	{
+		__m256 const x = _mm256_loadu_ps(&in.x[idx]);
+		__m256 const y = _mm256_loadu_ps(&in.y[idx]);
+		__m256 const z = _mm256_loadu_ps(&in.z[idx]);
+		__m256 const length = _mm256_sqrt_ps(_mm256_add_ps(
+			_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z)));
+		_mm256_storeu_ps(&out.x[idx], _mm256_div_ps(x, length));
+		_mm256_storeu_ps(&out.y[idx], _mm256_div_ps(y, length));
+		_mm256_storeu_ps(&out.z[idx], _mm256_div_ps(z, length));
+	}
+	normalise_scalar(in, out, idx, count);
+}
+#endif
+
+#if defined(__aarch64__)
+inline void transform_points_neon(
+	Mat4 const & mat, ConstVec3Span const & in, Vec3Span const & out, std::size_t const count)
+{
+	constexpr std::size_t lane_count = 4;
+	auto const & [c0, c1, c2, c3] = mat.columns;
+	std::size_t idx = 0;
+	for (; idx + lane_count <= count; idx += lane_count)
+	{
+		float32x4_t const x = vld1q_f32(&in.x[idx]);
+		float32x4_t const y = vld1q_f32(&in.y[idx]);
+		float32x4_t const z = vld1q_f32(&in.z[idx]);
+		auto const row = [&](float const m0, float const m1, float const m2, float const m3)
+		{
+			return vaddq_f32(
+				vaddq_f32(vaddq_f32(vmulq_n_f32(x, m0), vmulq_n_f32(y, m1)), vmulq_n_f32(z, m2)),
+				vdupq_n_f32(m3));
+		};
+		vst1q_f32(&out.x[idx], row(c0.x, c1.x, c2.x, c3.x));
+		vst1q_f32(&out.y[idx], row(c0.y, c1.y, c2.y, c3.y));
+		vst1q_f32(&out.z[idx], row(c0.z, c1.z, c2.z, c3.z));
+	}
+	transform_points_scalar(mat, in, out, idx, count);
+}
+
+inline void dot_neon(
+	ConstVec3Span const & lhs,
+	ConstVec3Span const & rhs,
+	std::span<float> const out,
+	std::size_t const count)
+{
+	constexpr std::size_t lane_count = 4;
+	std::size_t idx = 0;
+	for (; idx + lane_count <= count; idx += lane_count)
+		vst1q_f32(
+			&out[idx],
+			vaddq_f32(
+				vaddq_f32(
+					vmulq_f32(vld1q_f32(&lhs.x[idx]), vld1q_f32(&rhs.x[idx])),
+					vmulq_f32(vld1q_f32(&lhs.y[idx]), vld1q_f32(&rhs.y[idx]))),
+				vmulq_f32(vld1q_f32(&lhs.z[idx]), vld1q_f32(&rhs.z[idx]))));
+	dot_scalar(lhs, rhs, out, idx, count);
+}
+
+inline void normalise_neon(ConstVec3Span const & in, Vec3Span const & out, std::size_t const count)
+{
+	constexpr std::size_t lane_count = 4;
+	std::size_t idx = 0;
+	for (; idx + lane_count <= count; idx += lane_count)
+	{
+		float32x4_t const x = vld1q_f32(&in.x[idx]);
+		float32x4_t const y = vld1q_f32(&in.y[idx]);
+		float32x4_t const z = vld1q_f32(&in.z[idx]);
+		float32x4_t const length = vsqrtq_f32(
+			vaddq_f32(vaddq_f32(vmulq_f32(x, x), vmulq_f32(y, y)), vmulq_f32(z, z)));
+		vst1q_f32(&out.x[idx], vdivq_f32(x, length));
+		vst1q_f32(&out.y[idx], vdivq_f32(y, length));
+		vst1q_f32(&out.z[idx], vdivq_f32(z, length));
+	}
+	normalise_scalar(in, out, idx, count);
+}
+#endif
+}  // namespace detail
+
+/**
+ * Transform points, i.e. with `w = 1`, without perspective division.
+ *
+ * @param mat
+ * @param in
+ * @param out Same length as @p in. May alias @p in.
+ * @param kernel Must be supported, see simd::is_kernel_supported.
+ */
+inline void transform_points(
+	Mat4 const & mat,
+	ConstVec3Span const & in,
+	Vec3Span const & out,
+	simd::Kernel const kernel = simd::best_kernel())
+{
+	detail::check_lengths(in, out);
+	detail::check_kernel(kernel);
+	std::size_t const count = in.x.size();
+	switch (kernel)
+	{
+#if defined(__x86_64__)
+		case simd::Kernel::kSse2:
+			return detail::transform_points_sse2(mat, in, out, count);
+		case simd::Kernel::kAvx2:
+			return detail::transform_points_avx2(mat, in, out, count);
+#endif
+#if defined(__aarch64__)
+		case simd::Kernel::kNeon:
+			return detail::transform_points_neon(mat, in, out, count);
+#endif
+		default:
+			return detail::transform_points_scalar(mat, in, out, 0, count);
+	}
+}
+
+/**
+ * Dot products of corresponding vectors.
+ *
+ * @param lhs
+ * @param rhs Same length as @p lhs.
+ * @param out Same length as @p lhs.
+ * @param kernel Must be supported, see simd::is_kernel_supported.
+ */
+inline void dot(
+	ConstVec3Span const & lhs,
+	ConstVec3Span const & rhs,
+	std::span<float> const out,
+	simd::Kernel const kernel = simd::best_kernel())
+{
+	detail::check_lengths(lhs);
+	detail::check_lengths(rhs);
+	detail::check_lengths(lhs.x.size(), rhs.x.size());
+	detail::check_lengths(lhs.x.size(), out.size());
+	detail::check_kernel(kernel);
+	std::size_t const count = lhs.x.size();
+	switch (kernel)
+	{
+#if defined(__x86_64__)
+		case simd::Kernel::kSse2:
+			return detail::dot_sse2(lhs, rhs, out, count);
+		case simd::Kernel::kAvx2:
+			return detail::dot_avx2(lhs, rhs, out, count);
+#endif
+#if defined(__aarch64__)
+		case simd::Kernel::kNeon:
+			return detail::dot_neon(lhs, rhs, out, count);
+#endif
+		default:
+			return detail::dot_scalar(lhs, rhs, out, 0, count);
+	}
+}
+
+/**
+ * Scale vectors to unit length.
+ *
+ * @param in Each must be non-zero.
+ * @param out Same length as @p in. May alias @p in.
+ * @param kernel Must be supported, see simd::is_kernel_supported.
+ */
+inline void normalise(
+	ConstVec3Span const & in, Vec3Span const & out, simd::Kernel const kernel = simd::best_kernel())
+{
+	detail::check_lengths(in, out);
+	detail::check_kernel(kernel);
+	std::size_t const count = in.x.size();
+	switch (kernel)
+	{
+#if defined(__x86_64__)
+		case simd::Kernel::kSse2:
+			return detail::normalise_sse2(in, out, count);
+		case simd::Kernel::kAvx2:
+			return detail::normalise_avx2(in, out, count);
+#endif
+#if defined(__aarch64__)
+		case simd::Kernel::kNeon:
+			return detail::normalise_neon(in, out, count);
+#endif
+		default:
+			return detail::normalise_scalar(in, out, 0, count);
+	}
+}
+}  // namespace vulkandemo::maths
@@ -0,0 +1,1285 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "meshlet.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <numbers>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <ranges>
+#include <set>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <range/v3/range/conversion.hpp>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner) for `logger`
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `VK_CHECK`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "barrier.hpp"
+#include "bench.hpp"
+#include "compute.hpp"
+#include "draw.hpp"
+#include "frustum.hpp"
+#include "lod.hpp"
+#include "macros.hpp"
+#include "maths.hpp"
+#include "render_graph.hpp"
+#include "setup.hpp"
+#include "shaders.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::meshlet
+{
+namespace
+{
+/// Local index of vertices not in the meshlet under construction.
+constexpr uint8_t kNotInMeshlet = 0xFF;
+
+/// Normal cones whose triangles diverge further than this from the axis cannot usefully cull, as
+/// the cone is nearly as wide as a hemisphere.
+constexpr float kMinConeDot = 0.1F;
+
+/// Minimum guaranteed work group count per dimension, for compute and task shaders alike.
+constexpr uint32_t kMaxGroupCountX = 65535;
+
+/// Meshlets, bounds, vertices, triangles, positions, indices and command, see meshlet_cull.comp.
+constexpr std::array<compute::BindingType, 7> kBindings{
+	compute::BindingType::kStorageBuffer,
+	compute::BindingType::kStorageBuffer,
+	compute::BindingType::kStorageBuffer,
+	compute::BindingType::kStorageBuffer,
+	compute::BindingType::kStorageBuffer,
+	compute::BindingType::kStorageBuffer,
+	compute::BindingType::kStorageBuffer};
+
+/// Work group size of `meshlet_cull.comp`, i.e. invocations per meshlet.
+constexpr std::array<uint32_t, 3> kCullWorkGroupSize{64, 1, 1};
+
+/// State of the compacted indices and command once ready for the indirect draw and host readback.
+constexpr render_graph::ResourceState kDrawableAndHostReadable{
+	.stages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT |
+		VK_PIPELINE_STAGE_2_HOST_BIT,
+	.access = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT |
+		VK_ACCESS_2_HOST_READ_BIT,
+	.layout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+/// Push constants of `meshlet_cull.comp`.
+struct CullPushConstants
+{
+	frustum::Frustum planes;
+	std::array<float, 3> camera;
+	uint32_t meshlet_count;
+};
+static_assert(sizeof(CullPushConstants) == 112);
+
+/// Push constants of `meshlet.task` and `meshlet.mesh`.
+struct DrawPushConstants
+{
+	maths::Mat4 clip_from_mesh;
+	std::array<float, 3> camera;
+	uint32_t meshlet_count;
+};
+static_assert(sizeof(DrawPushConstants) == 80);
+
+/**
+ * Triangles using each vertex, as compressed sparse rows, i.e. the triangles of vertex `v` are
+ * `triangles[offsets[v]]` up to `triangles[offsets[v + 1]]`.
+ */
+struct VertexTriangles
+{
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> triangles;
+};
+
+VertexTriangles build_vertex_triangles(lod::Mesh const & mesh)
+{
+	VertexTriangles out{
+		.offsets = std::vector<uint32_t>(mesh.positions.size() + 1, 0), .triangles = {}};
+	for (uint32_t const idx : mesh.indices)
+		++out.offsets[idx + 1];
+	std::partial_sum(out.offsets.begin(), out.offsets.end(), out.offsets.begin());
+
+	out.triangles.resize(mesh.indices.size());
+	std::vector<uint32_t> cursors(out.offsets.begin(), std::prev(out.offsets.end()));
+	for (std::size_t corner = 0; corner < mesh.indices.size(); ++corner)
+		out.triangles[cursors[mesh.indices[corner]]++] = static_cast<uint32_t>(corner / 3);
+	return out;
+}
+
+maths::Vec3 to_vec3(std::array<float, 3> const & position)
+{
+	return {position[0], position[1], position[2]};
+}
+
+maths::Vec3 triangle_centroid(lod::Mesh const & mesh, uint32_t const triangle)
+{
+	return (to_vec3(mesh.positions[mesh.indices[triangle * 3 + 0]]) +
+			to_vec3(mesh.positions[mesh.indices[triangle * 3 + 1]]) +
+			to_vec3(mesh.positions[mesh.indices[triangle * 3 + 2]])) /
+		3.0F;
+}
+
+/**
+ * Unit normal of a counter-clockwise triangle, or nullopt if it has no area.
+ */
+std::optional<maths::Vec3> triangle_normal(lod::Mesh const & mesh, uint32_t const triangle)
+{
+	maths::Vec3 const a = to_vec3(mesh.positions[mesh.indices[triangle * 3 + 0]]);
+	maths::Vec3 const b = to_vec3(mesh.positions[mesh.indices[triangle * 3 + 1]]);
+	maths::Vec3 const c = to_vec3(mesh.positions[mesh.indices[triangle * 3 + 2]]);
+	maths::Vec3 const normal = maths::cross(b - a, c - a);
+	float const length = maths::length(normal);
+	if (length == 0.0F)
+		return std::nullopt;
+	return normal / length;
+}
+
+/**
+ * Bounding sphere about the centre of the meshlet's box, and normal cone about the average
+ * triangle facing.
+ */
+MeshletBounds compute_meshlet_bounds(
+	lod::Mesh const & mesh,
+	std::span<uint32_t const> const vertices,
+	std::span<uint32_t const> const triangles)
+{
+	maths::Vec3 min = to_vec3(mesh.positions[vertices.front()]);
+	maths::Vec3 max = min;
+	for (uint32_t const vertex : vertices)
+	{
+		maths::Vec3 const position = to_vec3(mesh.positions[vertex]);
+		min = {
+			std::min(min.x, position.x), std::min(min.y, position.y), std::min(min.z, position.z)};
+		max = {
+			std::max(max.x, position.x), std::max(max.y, position.y), std::max(max.z, position.z)};
+	}
+	maths::Vec3 const centre = (min + max) * 0.5F;
+	float radius = 0;
+	for (uint32_t const vertex : vertices)
+		radius = std::max(radius, maths::length(to_vec3(mesh.positions[vertex]) - centre));
+
+	MeshletBounds bounds{
+		.centre = {centre.x, centre.y, centre.z},
+		.radius = radius,
+		.cone_axis = {0, 0, 0},
+		.cone_cutoff = 1};
+
+	std::vector<maths::Vec3> normals;
+	normals.reserve(triangles.size());
+	maths::Vec3 normal_sum{0, 0, 0};
+	for (uint32_t const triangle : triangles)
+		if (std::optional<maths::Vec3> const normal = triangle_normal(mesh, triangle))
+		{
+			normals.push_back(*normal);
+			normal_sum = normal_sum + *normal;
+		}
+
+	float const sum_length = maths::length(normal_sum);
+	if (sum_length == 0.0F)
+		return bounds;
+	maths::Vec3 const axis = normal_sum / sum_length;
+
+	float min_dot = 1;
+	for (maths::Vec3 const & normal : normals)
+		min_dot = std::min(min_dot, maths::dot(normal, axis));
+	if (min_dot <= kMinConeDot)
+		return bounds;
+
+	// Every triangle faces within the half angle acos(min_dot) of the axis. Culling needs the
+	// sine of that angle, see is_meshlet_visible.
+	bounds.cone_axis = {axis.x, axis.y, axis.z};
+	bounds.cone_cutoff = std::sqrt(1 - min_dot * min_dot);
+	return bounds;
+}
+
+/**
+ * Layout of MeshletBuffers, as read by the task and mesh shaders.
+ */
+types::VulkanDescriptorSetLayoutPtr create_meshlet_draw_set_layout(
+	types::VulkanDevicePtr const & device)
+{
+	std::vector<VkDescriptorSetLayoutBinding> const layout_bindings =
+		std::views::iota(0U, static_cast<uint32_t>(kBindings.size())) |
+		std::views::transform(
+			[](uint32_t const binding)
+			{
+				return VkDescriptorSetLayoutBinding{
+					.binding = binding,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+					.descriptorCount = 1,
+					.stageFlags = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT,
+					.pImmutableSamplers = nullptr};
+			}) |
+		ranges::to<std::vector>();
+
+	return setup::create_descriptor_set_layout(device, layout_bindings);
+}
+
+/**
+ * Work groups of one or more meshlets each, split across two dimensions if over the limit of one.
+ */
+std::array<uint32_t, 2> group_counts(uint32_t const group_count)
+{
+	uint32_t const group_count_x = std::min(group_count, kMaxGroupCountX);
+	if (group_count_x == 0)
+		return {0, 0};
+	return {group_count_x, (group_count + group_count_x - 1) / group_count_x};
+}
+}  // namespace
+
+MeshletMesh build_meshlets(lod::Mesh const & mesh)
+{
+	if (mesh.indices.size() % 3 != 0)
+		throw std::invalid_argument{"Mesh indices are not a triangle list"};
+	if (std::ranges::any_of(
+			mesh.indices, [&](uint32_t const idx) { return idx >= mesh.positions.size(); }))
+		throw std::invalid_argument{"Mesh index out of range"};
+
+	auto const triangle_count = static_cast<uint32_t>(mesh.indices.size() / 3);
+	VertexTriangles const vertex_triangles = build_vertex_triangles(mesh);
+
+	MeshletMesh out;
+	std::vector<uint8_t> local_indices(mesh.positions.size(), kNotInMeshlet);
+	std::vector<bool> emitted(triangle_count, false);
+	// Of the meshlet under construction.
+	std::vector<uint32_t> vertices;
+	std::vector<uint32_t> triangles;
+	maths::Vec3 position_sum{0, 0, 0};
+	// Unemitted triangles sharing a vertex with the meshlet under construction.
+	std::vector<uint32_t> candidates;
+	std::vector<bool> is_candidate(triangle_count, false);
+	uint32_t seed = 0;
+
+	auto const new_vertex_count = [&](uint32_t const triangle)
+	{
+		return static_cast<uint32_t>(std::ranges::count_if(
+			std::span{mesh.indices}.subspan(triangle * 3UZ, 3),
+			[&](uint32_t const vertex) { return local_indices[vertex] == kNotInMeshlet; }));
+	};
+
+	auto const add_triangle = [&](uint32_t const triangle)
+	{
+		emitted[triangle] = true;
+		uint32_t packed = 0;
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			uint32_t const vertex = mesh.indices[triangle * 3 + corner];
+			if (local_indices[vertex] == kNotInMeshlet)
+			{
+				local_indices[vertex] = static_cast<uint8_t>(vertices.size());
+				vertices.push_back(vertex);
+				position_sum = position_sum + to_vec3(mesh.positions[vertex]);
+				for (uint32_t idx = vertex_triangles.offsets[vertex];
+					 idx < vertex_triangles.offsets[vertex + 1];
+					 ++idx)
+				{
+					uint32_t const neighbour = vertex_triangles.triangles[idx];
+					if (emitted[neighbour] || is_candidate[neighbour])
+						continue;
+					is_candidate[neighbour] = true;
+					candidates.push_back(neighbour);
+				}
+			}
+			packed |= uint32_t{local_indices[vertex]} << (corner * 8);
+		}
+		triangles.push_back(triangle);
+		out.triangles.push_back(packed);
+	};
+
+	auto const finish_meshlet = [&]
+	{
+		out.meshlets.push_back(Meshlet{
+			.vertex_offset = static_cast<uint32_t>(out.vertices.size()),
+			.triangle_offset = static_cast<uint32_t>(out.triangles.size() - triangles.size()),
+			.vertex_count = static_cast<uint32_t>(vertices.size()),
+			.triangle_count = static_cast<uint32_t>(triangles.size())});
+		out.bounds.push_back(compute_meshlet_bounds(mesh, vertices, triangles));
+		out.vertices.insert(out.vertices.end(), vertices.begin(), vertices.end());
+
+		for (uint32_t const vertex : vertices)
+			local_indices[vertex] = kNotInMeshlet;
+		for (uint32_t const candidate : candidates)
+			is_candidate[candidate] = false;
+		vertices.clear();
+		triangles.clear();
+		candidates.clear();
+		position_sum = {0, 0, 0};
+	};
+
+	while (true)
+	{
+		std::erase_if(
+			candidates,
+			[&](uint32_t const triangle)
+			{
+				if (!emitted[triangle])
+					return false;
+				is_candidate[triangle] = false;
+				return true;
+			});
+
+		// Neighbour adding the fewest new vertices, then closest to the meshlet's centroid, so
+		// that meshlets grow roughly round rather than in strips. Ties go to the earlier triangle,
+		// keeping the result deterministic.
+		std::optional<uint32_t> best;
+		uint32_t best_new_vertices = 4;
+		float best_distance = 0;
+		maths::Vec3 const centroid =
+			position_sum / static_cast<float>(std::max(vertices.size(), 1UZ));
+		for (uint32_t const candidate : candidates)
+		{
+			uint32_t const new_vertices = new_vertex_count(candidate);
+			if (new_vertices > best_new_vertices)
+				continue;
+			maths::Vec3 const offset = triangle_centroid(mesh, candidate) - centroid;
+			float const distance = maths::dot(offset, offset);
+			if (new_vertices < best_new_vertices || distance < best_distance ||
+				(distance == best_distance && candidate < *best))
+			{
+				best = candidate;
+				best_new_vertices = new_vertices;
+				best_distance = distance;
+			}
+		}
+
+		// No neighbours, so continue from the next triangle in index order.
+		if (!best)
+		{
+			while (seed < triangle_count && emitted[seed])
+				++seed;
+			if (seed == triangle_count)
+				break;
+			best = seed;
+			best_new_vertices = new_vertex_count(seed);
+		}
+
+		if (vertices.size() + best_new_vertices > kMaxVertices ||
+			triangles.size() == kMaxTriangles)
+			finish_meshlet();
+
+		add_triangle(*best);
+	}
+
+	if (!triangles.empty())
+		finish_meshlet();
+
+	return out;
+}
+
+bool is_meshlet_visible(
+	MeshletBounds const & bounds, frustum::Frustum const & frustum, maths::Vec3 const & camera)
+{
+	if (!frustum::intersects_sphere(frustum, bounds.centre, bounds.radius))
+		return false;
+
+	// Back facing if the camera is behind every triangle's plane, which the cone bounds
+	// conservatively. See "Optimizing the Graphics Pipeline with Compute", Wihlidal, GDC 2016.
+	maths::Vec3 const offset = to_vec3(bounds.centre) - camera;
+	return maths::dot(offset, to_vec3(bounds.cone_axis)) <
+		bounds.cone_cutoff * maths::length(offset) + bounds.radius;
+}
+
+bool supports_mesh_shaders(LoggerPtr const & logger, VkPhysicalDevice physical_device)
+{
+	if (setup::filter_available_device_extensions(
+			logger,
+			physical_device,
+			{types::DesiredDeviceExtensionNameView{VK_EXT_MESH_SHADER_EXTENSION_NAME}})
+			.empty())
+		return false;
+
+	VkPhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT, .pNext = nullptr};
+	VkPhysicalDeviceFeatures2 features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &mesh_shader_features};
+	vkGetPhysicalDeviceFeatures2(physical_device, &features);
+	return mesh_shader_features.taskShader == VK_TRUE &&
+		mesh_shader_features.meshShader == VK_TRUE;
+}
+
+compute::ComputeKernel create_meshlet_cull_kernel(types::VulkanDevicePtr const & device)
+{
+	return compute::create_compute_kernel(
+		device,
+		shaders::kMeshletCullComp,
+		kBindings,
+		sizeof(CullPushConstants),
+		kCullWorkGroupSize);
+}
+
+MeshletDrawPipeline create_meshlet_draw_pipeline(
+	types::VulkanDevicePtr const & device, VkFormat const colour_format)
+{
+	constexpr VkShaderStageFlags stages =
+		VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+
+	types::VulkanDescriptorSetLayoutPtr descriptor_set_layout =
+		create_meshlet_draw_set_layout(device);
+
+	constexpr VkPushConstantRange push_constant_range{
+		.stageFlags = stages, .offset = 0, .size = sizeof(DrawPushConstants)};
+
+	types::VulkanPipelineLayoutPtr layout = setup::create_pipeline_layout(
+		device, {{descriptor_set_layout.get()}}, {{push_constant_range}});
+
+	types::VulkanShaderModulePtr const task_module =
+		setup::create_shader_module(device, shaders::kMeshletTask);
+	types::VulkanShaderModulePtr const mesh_module =
+		setup::create_shader_module(device, shaders::kMeshletMesh);
+	types::VulkanShaderModulePtr const frag_module =
+		setup::create_shader_module(device, shaders::kSpriteSolidFrag);
+
+	std::array const shader_stages{
+		VkPipelineShaderStageCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_TASK_BIT_EXT,
+			.module = task_module.get(),
+			.pName = "main"},
+		VkPipelineShaderStageCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_MESH_BIT_EXT,
+			.module = mesh_module.get(),
+			.pName = "main"},
+		VkPipelineShaderStageCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.module = frag_module.get(),
+			.pName = "main"}};
+
+	// Viewport and scissor are dynamic.
+	constexpr VkPipelineViewportStateCreateInfo viewport_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+		.viewportCount = 1,
+		.scissorCount = 1};
+
+	constexpr VkPipelineRasterizationStateCreateInfo rasterization_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+		.polygonMode = VK_POLYGON_MODE_FILL,
+		// Whole meshlets are back face culled by the task shader. Facing of individual triangles
+		// in clip space depends on the caller's projection, so is not assumed here.
+		.cullMode = VK_CULL_MODE_NONE,
+		.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+		.lineWidth = 1.0F};
+
+	constexpr VkPipelineMultisampleStateCreateInfo multisample_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT};
+
+	constexpr VkPipelineColorBlendAttachmentState colour_blend_attachment{
+		.blendEnable = VK_FALSE,
+		// NOLINTNEXTLINE(*-signed-bitwise)
+		.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+			VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT};
+
+	VkPipelineColorBlendStateCreateInfo const colour_blend_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+		.attachmentCount = 1,
+		.pAttachments = &colour_blend_attachment};
+
+	constexpr std::array dynamic_states{VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+	VkPipelineDynamicStateCreateInfo const dynamic_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+		.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size()),
+		.pDynamicStates = dynamic_states.data()};
+
+	VkPipelineRenderingCreateInfo const rendering_create_info{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+		.pNext = nullptr,
+		.viewMask = 0,
+		.colorAttachmentCount = 1,
+		.pColorAttachmentFormats = &colour_format,
+		.depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+		.stencilAttachmentFormat = VK_FORMAT_UNDEFINED};
+
+	// Mesh pipelines have no vertex input or input assembly state.
+	VkGraphicsPipelineCreateInfo const pipeline_create_info{
+		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.pNext = &rendering_create_info,
+		.stageCount = static_cast<uint32_t>(shader_stages.size()),
+		.pStages = shader_stages.data(),
+		.pVertexInputState = nullptr,
+		.pInputAssemblyState = nullptr,
+		.pViewportState = &viewport_state,
+		.pRasterizationState = &rasterization_state,
+		.pMultisampleState = &multisample_state,
+		.pColorBlendState = &colour_blend_state,
+		.pDynamicState = &dynamic_state,
+		.layout = layout.get(),
+		.renderPass = nullptr,
+		.subpass = 0};
+
+	VkPipeline pipeline = nullptr;
+	VK_CHECK(
+		vkCreateGraphicsPipelines(
+			device.get(), nullptr, 1, &pipeline_create_info, nullptr, &pipeline),
+		"Failed to create meshlet pipeline");
+
+	auto const draw_mesh_tasks =  // NOLINTNEXTLINE(*-reinterpret-cast)
+		reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(
+			vkGetDeviceProcAddr(device.get(), "vkCmdDrawMeshTasksEXT"));
+
+	if (draw_mesh_tasks == nullptr)
+		throw std::runtime_error{"Failed to load vkCmdDrawMeshTasksEXT"};
+
+	return MeshletDrawPipeline{
+		.descriptor_set_layout = std::move(descriptor_set_layout),
+		.layout = std::move(layout),
+		.pipeline = types::make_pipeline_ptr(device, pipeline),
+		.draw_mesh_tasks = draw_mesh_tasks};
+}
+
+MeshletBuffers create_meshlet_buffers(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx const memory_type_idx,
+	types::VulkanDescriptorSetLayoutPtr const & descriptor_set_layout,
+	MeshletMesh const & meshlet_mesh,
+	std::span<std::array<float, 3> const> const positions)
+{
+	if (meshlet_mesh.meshlets.empty())
+		throw std::invalid_argument{"Meshlet mesh has no meshlets"};
+
+	auto [meshlets_buffer, meshlets_memory, meshlets] =
+		compute::create_mapped_storage_buffer<Meshlet>(
+			device, memory_type_idx, meshlet_mesh.meshlets.size(), 0);
+	std::ranges::copy(meshlet_mesh.meshlets, meshlets.begin());
+
+	auto [bounds_buffer, bounds_memory, bounds] =
+		compute::create_mapped_storage_buffer<MeshletBounds>(
+			device, memory_type_idx, meshlet_mesh.bounds.size(), 0);
+	std::ranges::copy(meshlet_mesh.bounds, bounds.begin());
+
+	auto [vertices_buffer, vertices_memory, vertices] =
+		compute::create_mapped_storage_buffer<uint32_t>(
+			device, memory_type_idx, meshlet_mesh.vertices.size(), 0);
+	std::ranges::copy(meshlet_mesh.vertices, vertices.begin());
+
+	auto [triangles_buffer, triangles_memory, triangles] =
+		compute::create_mapped_storage_buffer<uint32_t>(
+			device, memory_type_idx, meshlet_mesh.triangles.size(), 0);
+	std::ranges::copy(meshlet_mesh.triangles, triangles.begin());
+
+	auto [positions_buffer, positions_memory, mapped_positions] =
+		compute::create_mapped_storage_buffer<std::array<float, 3>>(
+			device, memory_type_idx, positions.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	std::ranges::copy(positions, mapped_positions.begin());
+
+	auto [indices_buffer, indices_memory, indices] =
+		compute::create_mapped_storage_buffer<uint32_t>(
+			device,
+			memory_type_idx,
+			meshlet_mesh.triangles.size() * 3,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+	auto [command_buffer, command_memory, command] =
+		compute::create_mapped_storage_buffer<VkDrawIndexedIndirectCommand>(
+			device,
+			memory_type_idx,
+			1,
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	// Only the index count is reset and accumulated per frame, see populate_cmd_meshlet_cull.
+	command.front() = VkDrawIndexedIndirectCommand{
+		.indexCount = 0,
+		.instanceCount = 1,
+		.firstIndex = 0,
+		.vertexOffset = 0,
+		.firstInstance = 0};
+
+	std::array const bindings{
+		compute::Binding{compute::StorageBuffer{.buffer = meshlets_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = bounds_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = vertices_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = triangles_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = positions_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = indices_buffer.get()}},
+		compute::Binding{compute::StorageBuffer{.buffer = command_buffer.get()}}};
+	compute::ComputeBindings compute_bindings =
+		compute::create_compute_bindings(device, descriptor_set_layout, kBindings, bindings);
+
+	return MeshletBuffers{
+		.meshlets_buffer = std::move(meshlets_buffer),
+		.meshlets_memory = std::move(meshlets_memory),
+		.meshlets = meshlets,
+		.bounds_buffer = std::move(bounds_buffer),
+		.bounds_memory = std::move(bounds_memory),
+		.bounds = bounds,
+		.vertices_buffer = std::move(vertices_buffer),
+		.vertices_memory = std::move(vertices_memory),
+		.vertices = vertices,
+		.triangles_buffer = std::move(triangles_buffer),
+		.triangles_memory = std::move(triangles_memory),
+		.triangles = triangles,
+		.positions_buffer = std::move(positions_buffer),
+		.positions_memory = std::move(positions_memory),
+		.positions = mapped_positions,
+		.indices_buffer = std::move(indices_buffer),
+		.indices_memory = std::move(indices_memory),
+		.indices = indices,
+		.command_buffer = std::move(command_buffer),
+		.command_memory = std::move(command_memory),
+		.command = command,
+		.bindings = std::move(compute_bindings)};
+}
+
+void populate_cmd_meshlet_cull(
+	VkCommandBuffer command_buffer,
+	compute::ComputeKernel const & kernel,
+	MeshletBuffers const & buffers,
+	frustum::Frustum const & frustum,
+	maths::Vec3 const & camera)
+{
+	using render_graph::Access;
+	using render_graph::state_of;
+
+	// Previous frame's indirect draw must be done with the command before its index count is
+	// reset, leaving the rest of the command as initialised.
+	barrier::populate_cmd_memory_barrier(
+		command_buffer,
+		{.stages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+		 .access = VK_ACCESS_2_NONE,
+		 .layout = VK_IMAGE_LAYOUT_UNDEFINED},
+		state_of(Access::kTransferWrite));
+	vkCmdFillBuffer(command_buffer, buffers.command_buffer.get(), 0, sizeof(uint32_t), 0);
+
+	// Meshlet data is host written once and made visible by submission. Indices must not be
+	// overwritten until the previous indirect draw is done with them, and the outputs must be
+	// written before they are consumed by the indirect draw or read back by the host.
+	std::array const buffer_uses{
+		compute::BufferUse{
+			.buffer = buffers.command_buffer.get(),
+			.access = Access::kComputeShaderStorageReadWrite,
+			.before = state_of(Access::kTransferWrite),
+			.after = kDrawableAndHostReadable},
+		compute::BufferUse{
+			.buffer = buffers.indices_buffer.get(),
+			.access = Access::kComputeShaderStorageWrite,
+			.before = state_of(Access::kIndexRead),
+			.after = kDrawableAndHostReadable}};
+
+	auto const meshlet_count = static_cast<uint32_t>(buffers.meshlets.size());
+	CullPushConstants const push_constants{
+		.planes = frustum,
+		.camera = {camera.x, camera.y, camera.z},
+		.meshlet_count = meshlet_count};
+
+	// One work group per meshlet.
+	auto const [group_count_x, group_count_y] = group_counts(meshlet_count);
+	compute::populate_cmd_dispatch(
+		command_buffer,
+		kernel,
+		buffers.bindings,
+		std::as_bytes(std::span{&push_constants, 1}),
+		buffer_uses,
+		{},
+		{group_count_x, group_count_y, 1});
+}
+
+void populate_cmd_draw_compacted(VkCommandBuffer command_buffer, MeshletBuffers const & buffers)
+{
+	vkCmdBindIndexBuffer(command_buffer, buffers.indices_buffer.get(), 0, VK_INDEX_TYPE_UINT32);
+	vkCmdDrawIndexedIndirect(
+		command_buffer, buffers.command_buffer.get(), 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void populate_cmd_draw_meshlets(
+	VkCommandBuffer command_buffer,
+	MeshletDrawPipeline const & pipeline,
+	MeshletBuffers const & buffers,
+	maths::Mat4 const & clip_from_mesh,
+	maths::Vec3 const & camera)
+{
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline.get());
+	vkCmdBindDescriptorSets(
+		command_buffer,
+		VK_PIPELINE_BIND_POINT_GRAPHICS,
+		pipeline.layout.get(),
+		0,
+		1,
+		&buffers.bindings.descriptor_set,
+		0,
+		nullptr);
+
+	auto const meshlet_count = static_cast<uint32_t>(buffers.meshlets.size());
+	DrawPushConstants const push_constants{
+		.clip_from_mesh = clip_from_mesh,
+		.camera = {camera.x, camera.y, camera.z},
+		.meshlet_count = meshlet_count};
+	vkCmdPushConstants(
+		command_buffer,
+		pipeline.layout.get(),
+		VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT,
+		0,
+		sizeof(push_constants),
+		&push_constants);
+
+	// Each task shader work group culls kTaskWorkGroupSize meshlets and launches mesh shader
+	// work groups for those visible.
+	auto const [group_count_x, group_count_y] =
+		group_counts((meshlet_count + kTaskWorkGroupSize - 1) / kTaskWorkGroupSize);
+	pipeline.draw_mesh_tasks(command_buffer, group_count_x, group_count_y, 1);
+}
+
+namespace
+{
+/**
+ * Unit sphere of `rings` latitude bands by `segments` longitude bands, facing outwards.
+ */
+lod::Mesh make_sphere_mesh(uint32_t const rings, uint32_t const segments)
+{
+	lod::Mesh mesh;
+	for (uint32_t ring = 0; ring <= rings; ++ring)
+		for (uint32_t segment = 0; segment <= segments; ++segment)
+		{
+			float const theta =
+				std::numbers::pi_v<float> * static_cast<float>(ring) / static_cast<float>(rings);
+			float const phi = 2 * std::numbers::pi_v<float> * static_cast<float>(segment) /
+				static_cast<float>(segments);
+			mesh.positions.push_back(
+				{std::sin(theta) * std::cos(phi),
+				 std::cos(theta),
+				 std::sin(theta) * std::sin(phi)});
+		}
+	for (uint32_t ring = 0; ring < rings; ++ring)
+		for (uint32_t segment = 0; segment < segments; ++segment)
+		{
+			uint32_t const top_left = ring * (segments + 1) + segment;
+			uint32_t const bottom_left = top_left + segments + 1;
+			// Triangles touching a pole would have no area.
+			if (ring != 0)
+				mesh.indices.insert(mesh.indices.end(), {top_left, top_left + 1, bottom_left});
+			if (ring != rings - 1)
+				mesh.indices.insert(
+					mesh.indices.end(), {top_left + 1, bottom_left + 1, bottom_left});
+		}
+	return mesh;
+}
+
+/**
+ * Height field of `size` by `size` quads over the unit square.
+ */
+lod::Mesh make_grid_mesh(uint32_t const size)
+{
+	lod::Mesh mesh;
+	for (uint32_t y = 0; y <= size; ++y)
+		for (uint32_t x = 0; x <= size; ++x)
+		{
+			float const u = static_cast<float>(x) / static_cast<float>(size);
+			float const v = static_cast<float>(y) / static_cast<float>(size);
+			mesh.positions.push_back(
+				{u, v, 0.05F * std::sin(u * 2 * std::numbers::pi_v<float>) * std::cos(v * 3.0F)});
+		}
+	for (uint32_t y = 0; y < size; ++y)
+		for (uint32_t x = 0; x < size; ++x)
+		{
+			uint32_t const corner = y * (size + 1) + x;
+			mesh.indices.insert(
+				mesh.indices.end(),
+				{corner,
+				 corner + 1,
+				 corner + size + 1,
+				 corner + 1,
+				 corner + size + 2,
+				 corner + size + 1});
+		}
+	return mesh;
+}
+
+/**
+ * Global vertex indices of a meshlet's triangle.
+ */
+std::array<uint32_t, 3> meshlet_triangle(
+	MeshletMesh const & meshlet_mesh, Meshlet const & meshlet, uint32_t const triangle_idx)
+{
+	uint32_t const packed = meshlet_mesh.triangles[meshlet.triangle_offset + triangle_idx];
+	return {
+		meshlet_mesh.vertices[meshlet.vertex_offset + (packed & 0xFFU)],
+		meshlet_mesh.vertices[meshlet.vertex_offset + ((packed >> 8) & 0xFFU)],
+		meshlet_mesh.vertices[meshlet.vertex_offset + ((packed >> 16) & 0xFFU)]};
+}
+
+/**
+ * Rotate a triangle's indices to start with the lowest, preserving winding, for comparison.
+ */
+std::array<uint32_t, 3> canonical_triangle(std::array<uint32_t, 3> triangle)
+{
+	std::ranges::rotate(triangle, std::ranges::min_element(triangle));
+	return triangle;
+}
+
+std::vector<std::array<uint32_t, 3>> sorted_triangles(std::span<uint32_t const> const indices)
+{
+	std::vector<std::array<uint32_t, 3>> out;
+	for (std::size_t idx = 0; idx < indices.size(); idx += 3)
+		out.push_back(canonical_triangle({indices[idx], indices[idx + 1], indices[idx + 2]}));
+	std::ranges::sort(out);
+	return out;
+}
+
+/**
+ * Triangles of all meshlets passing the CPU visibility test, as a flat index list.
+ */
+std::vector<uint32_t> visible_indices(
+	MeshletMesh const & meshlet_mesh, frustum::Frustum const & frustum, maths::Vec3 const & camera)
+{
+	std::vector<uint32_t> out;
+	for (std::size_t meshlet_idx = 0; meshlet_idx < meshlet_mesh.meshlets.size(); ++meshlet_idx)
+	{
+		if (!is_meshlet_visible(meshlet_mesh.bounds[meshlet_idx], frustum, camera))
+			continue;
+		Meshlet const & meshlet = meshlet_mesh.meshlets[meshlet_idx];
+		for (uint32_t triangle_idx = 0; triangle_idx < meshlet.triangle_count; ++triangle_idx)
+			std::ranges::copy(
+				meshlet_triangle(meshlet_mesh, meshlet, triangle_idx), std::back_inserter(out));
+	}
+	return out;
+}
+}  // namespace
+
+TEST_CASE("Build meshlets")
+{
+	for (lod::Mesh const & mesh : {make_grid_mesh(64), make_sphere_mesh(48, 96)})
+	{
+		MeshletMesh const meshlet_mesh = build_meshlets(mesh);
+		REQUIRE(meshlet_mesh.bounds.size() == meshlet_mesh.meshlets.size());
+
+		std::vector<uint32_t> indices;
+		for (std::size_t meshlet_idx = 0; meshlet_idx < meshlet_mesh.meshlets.size(); ++meshlet_idx)
+		{
+			Meshlet const & meshlet = meshlet_mesh.meshlets[meshlet_idx];
+			MeshletBounds const & bounds = meshlet_mesh.bounds[meshlet_idx];
+			CHECK(meshlet.vertex_count > 0);
+			CHECK(meshlet.vertex_count <= kMaxVertices);
+			CHECK(meshlet.triangle_count > 0);
+			CHECK(meshlet.triangle_count <= kMaxTriangles);
+
+			std::span const vertices = std::span{meshlet_mesh.vertices}.subspan(
+				meshlet.vertex_offset, meshlet.vertex_count);
+			std::vector<uint32_t> unique_vertices(vertices.begin(), vertices.end());
+			std::ranges::sort(unique_vertices);
+			CHECK(std::ranges::adjacent_find(unique_vertices) == unique_vertices.end());
+
+			// Sphere encloses every vertex.
+			for (uint32_t const vertex : vertices)
+			{
+				float const distance =
+					maths::length(to_vec3(mesh.positions[vertex]) - to_vec3(bounds.centre));
+				CHECK(distance <= bounds.radius * (1 + 1e-5F));
+			}
+
+			// Cone encloses every triangle normal.
+			float const min_dot = std::sqrt(1 - bounds.cone_cutoff * bounds.cone_cutoff);
+			for (uint32_t triangle_idx = 0; triangle_idx < meshlet.triangle_count; ++triangle_idx)
+			{
+				std::array<uint32_t, 3> const triangle =
+					meshlet_triangle(meshlet_mesh, meshlet, triangle_idx);
+				std::ranges::copy(triangle, std::back_inserter(indices));
+
+				maths::Vec3 const a = to_vec3(mesh.positions[triangle[0]]);
+				maths::Vec3 const normal = maths::normalise(maths::cross(
+					to_vec3(mesh.positions[triangle[1]]) - a,
+					to_vec3(mesh.positions[triangle[2]]) - a));
+				if (bounds.cone_cutoff < 1)
+					CHECK(maths::dot(normal, to_vec3(bounds.cone_axis)) >= min_dot - 1e-5F);
+			}
+		}
+
+		// Every triangle exactly once, with winding preserved.
+		CHECK(sorted_triangles(indices) == sorted_triangles(mesh.indices));
+
+		// Greedy growth should keep meshlets well filled on a regular mesh.
+		CHECK(
+			static_cast<double>(mesh.indices.size() / 3) /
+				static_cast<double>(meshlet_mesh.meshlets.size()) >
+			64.0);
+	}
+
+	CHECK(build_meshlets(lod::Mesh{}).meshlets.empty());
+	CHECK_THROWS_AS(
+		build_meshlets(lod::Mesh{.positions = {{0, 0, 0}}, .indices = {0, 0}}),
+		std::invalid_argument);
+	CHECK_THROWS_AS(
+		build_meshlets(lod::Mesh{.positions = {{0, 0, 0}}, .indices = {0, 0, 1}}),
+		std::invalid_argument);
+}
+
+TEST_CASE("Cull meshlets conservatively")
+{
+	lod::Mesh const mesh = make_sphere_mesh(48, 96);
+	MeshletMesh const meshlet_mesh = build_meshlets(mesh);
+
+	std::mt19937 rng{42};  // NOLINT(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+	std::uniform_real_distribution<float> direction_dist{-1.0F, 1.0F};
+	std::uniform_real_distribution<float> distance_dist{1.5F, 10.0F};
+
+	std::size_t culled_count = 0;
+	std::size_t tested_count = 0;
+	for (std::size_t iteration = 0; iteration < 50; ++iteration)
+	{
+		maths::Vec3 const camera =
+			maths::normalise(
+				maths::Vec3{direction_dist(rng), direction_dist(rng), direction_dist(rng)}) *
+			distance_dist(rng);
+		// Looking somewhat off centre, so that the frustum also culls.
+		maths::Vec3 const target{
+			direction_dist(rng), direction_dist(rng), direction_dist(rng)};
+		maths::Mat4 const clip_from_mesh =
+			maths::perspective(std::numbers::pi_v<float> / 3, 1, 0.1F, 100) *
+			maths::look_at(camera, target, {0, 1, 0});
+		frustum::Frustum const frustum = frustum::extract_planes(clip_from_mesh);
+
+		for (std::size_t meshlet_idx = 0; meshlet_idx < meshlet_mesh.meshlets.size(); ++meshlet_idx)
+		{
+			Meshlet const & meshlet = meshlet_mesh.meshlets[meshlet_idx];
+			++tested_count;
+			if (is_meshlet_visible(meshlet_mesh.bounds[meshlet_idx], frustum, camera))
+				continue;
+			++culled_count;
+
+			// Culled only if every triangle is back facing, or entirely outside one plane.
+			bool all_back_facing = true;
+			for (uint32_t triangle_idx = 0; triangle_idx < meshlet.triangle_count; ++triangle_idx)
+			{
+				std::array<uint32_t, 3> const triangle =
+					meshlet_triangle(meshlet_mesh, meshlet, triangle_idx);
+				maths::Vec3 const a = to_vec3(mesh.positions[triangle[0]]);
+				maths::Vec3 const normal = maths::cross(
+					to_vec3(mesh.positions[triangle[1]]) - a,
+					to_vec3(mesh.positions[triangle[2]]) - a);
+				all_back_facing = all_back_facing && maths::dot(normal, camera - a) <= 1e-6F;
+			}
+
+			bool const outside_plane = std::ranges::any_of(
+				frustum,
+				[&](frustum::Plane const & plane)
+				{
+					return std::ranges::all_of(
+						std::span{meshlet_mesh.vertices}.subspan(
+							meshlet.vertex_offset, meshlet.vertex_count),
+						[&](uint32_t const vertex)
+						{
+							std::array<float, 3> const & position = mesh.positions[vertex];
+							return plane[0] * position[0] + plane[1] * position[1] +
+								plane[2] * position[2] + plane[3] <
+								0;
+						});
+				});
+
+			CHECK((all_back_facing || outside_plane));
+		}
+	}
+
+	// Roughly half the sphere faces away from any external camera, so cone culling alone
+	// should remove a good fraction.
+	CHECK(static_cast<double>(culled_count) / static_cast<double>(tested_count) > 0.3);
+}
+
+TEST_CASE("Cull meshlets on the GPU")
+{
+	vulkandemo::LoggerPtr const logger = vulkandemo::create_logger("Cull meshlets on the GPU");
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		nullptr,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+
+	constexpr VkMemoryPropertyFlags memory_flags =
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT,
+		memory_flags);
+
+	bool const mesh_shaders = supports_mesh_shaders(logger, physical_device);
+	VkPhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT,
+		.pNext = nullptr,
+		.taskShader = VK_TRUE,
+		.meshShader = VK_TRUE};
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.pNext = mesh_shaders ? &mesh_shader_features : nullptr,
+		.synchronization2 = VK_TRUE,
+		.dynamicRendering = static_cast<VkBool32>(mesh_shaders)};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan13_features};
+
+	std::vector<types::AvailableDeviceExtensionNameView> device_extensions;
+	if (mesh_shaders)
+		device_extensions.push_back(
+			types::AvailableDeviceExtensionNameView{VK_EXT_MESH_SHADER_EXTENSION_NAME});
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		device_extensions,
+		&features);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkCommandBuffer command_buffer = command_buffers->front();
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	types::VulkanMemoryTypeIdx const memory_type_idx =
+		setup::filter_available_memory_types(logger, physical_device, memory_flags).at(0);
+
+	lod::Mesh const mesh = make_sphere_mesh(48, 96);
+	MeshletMesh const meshlet_mesh = build_meshlets(mesh);
+
+	// Outside the sphere, looking at its edge, so both frustum and cone culling apply.
+	maths::Vec3 const camera{0, 0, 3};
+	maths::Mat4 const clip_from_mesh =
+		maths::perspective(std::numbers::pi_v<float> / 4, 1, 0.1F, 100) *
+		maths::look_at(camera, {1, 0, 0}, {0, 1, 0});
+	frustum::Frustum const frustum = frustum::extract_planes(clip_from_mesh);
+
+	SUBCASE("compaction")
+	{
+		compute::ComputeKernel const kernel = create_meshlet_cull_kernel(device);
+
+		CHECK(kernel.descriptor_set_layout);
+		CHECK(kernel.layout);
+		CHECK(kernel.pipeline);
+
+		MeshletBuffers const buffers = create_meshlet_buffers(
+			device, memory_type_idx, kernel.descriptor_set_layout, meshlet_mesh, mesh.positions);
+
+		constexpr VkCommandBufferBeginInfo begin_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+		VK_CHECK(
+			vkBeginCommandBuffer(command_buffer, &begin_info), "Failed to begin command buffer");
+		populate_cmd_meshlet_cull(command_buffer, kernel, buffers, frustum, camera);
+		VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
+
+		draw::submit_command_buffer(queue, command_buffer, nullptr, nullptr);
+		VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+
+		std::vector<uint32_t> const expected = visible_indices(meshlet_mesh, frustum, camera);
+		CHECK(!expected.empty());
+		CHECK(expected.size() < mesh.indices.size() / 2);
+
+		VkDrawIndexedIndirectCommand const & command = buffers.command.front();
+		REQUIRE(command.indexCount == expected.size());
+		CHECK(command.instanceCount == 1);
+		// Meshlets are compacted in arbitrary order, but each keeps its triangles' winding.
+		CHECK(
+			sorted_triangles(buffers.indices.first(command.indexCount)) ==
+			sorted_triangles(expected));
+	}
+
+	SUBCASE("mesh shaders")
+	{
+		// Optional, with compaction as the fallback.
+		if (!mesh_shaders)
+		{
+			MESSAGE("Skipping mesh shaders, since they are not supported");
+			return;
+		}
+
+		using render_graph::Access;
+		using render_graph::state_of;
+
+		constexpr VkFormat kFormat = VK_FORMAT_R8G8B8A8_UNORM;
+		constexpr VkExtent2D kExtent{64, 64};
+		constexpr VkImageSubresourceRange kColourRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+		MeshletDrawPipeline const pipeline = create_meshlet_draw_pipeline(device, kFormat);
+
+		CHECK(pipeline.descriptor_set_layout);
+		CHECK(pipeline.layout);
+		CHECK(pipeline.pipeline);
+		CHECK(pipeline.draw_mesh_tasks != nullptr);
+
+		MeshletBuffers const buffers = create_meshlet_buffers(
+			device, memory_type_idx, pipeline.descriptor_set_layout, meshlet_mesh, mesh.positions);
+		CHECK(buffers.bindings.descriptor_set != nullptr);
+
+		auto [target, target_memory] = setup::create_image_and_memory(
+			device,
+			physical_device,
+			kFormat,
+			kExtent,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+		types::VulkanImageViewPtr const target_view =
+			setup::create_image_view(device, target.get(), kFormat);
+
+		auto [readback_buffer, readback_memory, readback_bytes] =
+			draw::create_exclusive_mapped_buffer_and_memory(
+				device,
+				memory_type_idx,
+				VkDeviceSize{kExtent.width} * kExtent.height * sizeof(uint32_t),
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+		constexpr VkCommandBufferBeginInfo begin_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+		VK_CHECK(
+			vkBeginCommandBuffer(command_buffer, &begin_info), "Failed to begin command buffer");
+
+		barrier::populate_cmd_barriers(
+			command_buffer,
+			std::nullopt,
+			std::array{barrier::image_barrier(
+				target.get(), kColourRange, {}, state_of(Access::kColourAttachmentWrite))});
+
+		// Cleared to transparent black, which no meshlet is drawn in.
+		VkRenderingAttachmentInfo const colour_attachment{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+			.pNext = nullptr,
+			.imageView = target_view.get(),
+			.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.resolveMode = VK_RESOLVE_MODE_NONE,
+			.resolveImageView = nullptr,
+			.resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.clearValue = {.color = {.float32 = {0, 0, 0, 0}}}};
+		VkRenderingInfo const rendering_info{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.renderArea = {.offset = {.x = 0, .y = 0}, .extent = kExtent},
+			.layerCount = 1,
+			.viewMask = 0,
+			.colorAttachmentCount = 1,
+			.pColorAttachments = &colour_attachment,
+			.pDepthAttachment = nullptr,
+			.pStencilAttachment = nullptr};
+		vkCmdBeginRendering(command_buffer, &rendering_info);
+
+		VkViewport const viewport{
+			.x = 0,
+			.y = 0,
+			.width = static_cast<float>(kExtent.width),
+			.height = static_cast<float>(kExtent.height),
+			.minDepth = 0,
+			.maxDepth = 1};
+		vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+		VkRect2D const scissor{.offset = {0, 0}, .extent = kExtent};
+		vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+		populate_cmd_draw_meshlets(command_buffer, pipeline, buffers, clip_from_mesh, camera);
+
+		vkCmdEndRendering(command_buffer);
+
+		barrier::populate_cmd_barriers(
+			command_buffer,
+			std::nullopt,
+			std::array{barrier::image_barrier(
+				target.get(),
+				kColourRange,
+				state_of(Access::kColourAttachmentWrite),
+				state_of(Access::kTransferRead))});
+
+		VkBufferImageCopy const region{
+			.bufferOffset = 0,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+			.imageOffset = {0, 0, 0},
+			.imageExtent = {kExtent.width, kExtent.height, 1}};
+		vkCmdCopyImageToBuffer(
+			command_buffer,
+			target.get(),
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			readback_buffer.get(),
+			1,
+			&region);
+		barrier::populate_cmd_memory_barrier(
+			command_buffer, state_of(Access::kTransferWrite), state_of(Access::kHostRead));
+
+		VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
+		draw::submit_command_buffer(queue, command_buffer, nullptr, nullptr);
+		VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+
+		// Each meshlet is drawn in its own opaque colour, as packed RGBA8, see meshlet.mesh.
+		std::set<uint32_t> visible_colours;
+		for (std::size_t meshlet_idx = 0; meshlet_idx < meshlet_mesh.meshlets.size(); ++meshlet_idx)
+			if (is_meshlet_visible(meshlet_mesh.bounds[meshlet_idx], frustum, camera))
+				visible_colours.insert(
+					((static_cast<uint32_t>(meshlet_idx) * 2654435761U) & 0xFFFFFFU) |
+					0xFF000000U);
+
+		std::span const pixels{
+			// NOLINTNEXTLINE(*-reinterpret-cast)
+			reinterpret_cast<uint32_t const *>(readback_bytes.data()),
+			std::size_t{kExtent.width} * kExtent.height};
+
+		// Every drawn pixel must be of a meshlet that the CPU also finds visible.
+		auto const drawn_count =
+			std::ranges::count_if(pixels, [](uint32_t const pixel) { return pixel != 0; });
+		auto const unexpected_count = std::ranges::count_if(
+			pixels,
+			[&](uint32_t const pixel)
+			{ return pixel != 0 && !visible_colours.contains(pixel); });
+		CHECK(drawn_count > 0);
+		CHECK(unexpected_count == 0);
+	}
+}
+
+TEST_CASE("Benchmark meshlets" * doctest::test_suite("benchmark") * doctest::skip())
+{
+	LoggerPtr const logger = create_logger("Benchmark meshlets");
+
+	// Roughly 10k, 100k and 1M triangles.
+	for (uint32_t const grid_size : {71U, 224U, 708U})
+	{
+		constexpr std::size_t kIterations = 5;
+		lod::Mesh const mesh = make_grid_mesh(grid_size);
+
+		MeshletMesh meshlet_mesh;
+		double const build_ms =
+			bench::mean_ms(kIterations, [&] { meshlet_mesh = build_meshlets(mesh); });
+
+		// Looking down onto the middle of the grid, from the front and from behind.
+		maths::Mat4 const projection =
+			maths::perspective(std::numbers::pi_v<float> / 4, 1, 0.01F, 10);
+		maths::Vec3 const front_camera{0.5F, 0.5F, 1};
+		maths::Vec3 const back_camera{0.5F, 0.5F, -1};
+		frustum::Frustum const front_frustum = frustum::extract_planes(
+			projection * maths::look_at(front_camera, {0.5F, 0.5F, 0}, {0, 1, 0}));
+		frustum::Frustum const back_frustum = frustum::extract_planes(
+			projection * maths::look_at(back_camera, {0.5F, 0.5F, 0}, {0, 1, 0}));
+
+		std::size_t const triangle_count = mesh.indices.size() / 3;
+		logger->info(
+			"{} triangles: build {:.2f} ms, {} meshlets ({:.1f} triangles, {:.1f} vertices "
+			"each), visible triangles from front {}, from behind {}",
+			triangle_count,
+			build_ms,
+			meshlet_mesh.meshlets.size(),
+			static_cast<double>(triangle_count) /
+				static_cast<double>(meshlet_mesh.meshlets.size()),
+			static_cast<double>(meshlet_mesh.vertices.size()) /
+				static_cast<double>(meshlet_mesh.meshlets.size()),
+			visible_indices(meshlet_mesh, front_frustum, front_camera).size() / 3,
+			visible_indices(meshlet_mesh, back_frustum, back_camera).size() / 3);
+	}
+}
+}  // namespace vulkandemo::meshlet
@@ -0,0 +1,264 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "compute.hpp"
+#include "frustum.hpp"
+#include "lod.hpp"
+#include "maths.hpp"
+#include "types.hpp"
+
+/**
+ * Meshlets, i.e. small clusters of a mesh's triangles, culled individually on the GPU.
+ *
+ * Each meshlet references at most kMaxVertices vertices and kMaxTriangles triangles, sized to
+ * suit mesh shader output limits. Triangles index the meshlet's own vertex list with 8-bit local
+ * indices, which in turn index the mesh's vertex buffer.
+ *
+ * Every meshlet carries a bounding sphere, for frustum culling, and a normal cone bounding the
+ * facing of its triangles, for back face culling a whole cluster at once.
+ *
+ * Two GPU paths share the same buffers:
+ *
+ * - Where `VK_EXT_mesh_shader` is available, a task shader culls meshlets and launches a mesh
+ *   shader work group per survivor, which emits its triangles directly.
+ * - Otherwise, a compute pass culls meshlets and compacts the triangles of survivors into an index
+ *   buffer, drawn by a single indexed indirect draw.
+ */
+namespace vulkandemo::meshlet
+{
+inline constexpr uint32_t kMaxVertices = 64;
+/// A multiple of 4 below 128, so that local index storage packs without padding.
+inline constexpr uint32_t kMaxTriangles = 124;
+
+/// Meshlets culled per work group of `meshlet.task`.
+inline constexpr uint32_t kTaskWorkGroupSize = 32;
+
+/**
+ * Range of a meshlet's vertices and triangles within a MeshletMesh.
+ */
+struct Meshlet
+{
+	/// Offset into MeshletMesh::vertices.
+	uint32_t vertex_offset;
+	/// Offset into MeshletMesh::triangles.
+	uint32_t triangle_offset;
+	uint32_t vertex_count;
+	uint32_t triangle_count;
+};
+static_assert(sizeof(Meshlet) == 16);
+
+/**
+ * Culling bounds of a meshlet, in mesh space.
+ */
+struct MeshletBounds
+{
+	std::array<float, 3> centre;
+	float radius;
+	/// Unit average facing of the meshlet's triangles.
+	std::array<float, 3> cone_axis;
+	/// Sine of the cone's half angle, or one if the cone is too wide to ever cull.
+	float cone_cutoff;
+};
+static_assert(sizeof(MeshletBounds) == 32);
+
+/**
+ * A mesh split into meshlets. Meshlets are in order of construction, so neighbouring meshlets
+ * tend to be spatially close.
+ */
+struct MeshletMesh
+{
+	std::vector<Meshlet> meshlets;
+	/// Parallel to meshlets.
+	std::vector<MeshletBounds> bounds;
+	/// Per meshlet, indices into the original mesh's vertices.
+	std::vector<uint32_t> vertices;
+	/// Per meshlet, three 8-bit indices into the meshlet's vertices, first in the lowest byte.
+	std::vector<uint32_t> triangles;
+};
+
+/**
+ * Task and mesh shader graphics pipeline, plus its layouts.
+ */
+struct MeshletDrawPipeline
+{
+	types::VulkanDescriptorSetLayoutPtr descriptor_set_layout;
+	types::VulkanPipelineLayoutPtr layout;
+	types::VulkanPipelinePtr pipeline;
+	/// Extension command, loaded from the device.
+	PFN_vkCmdDrawMeshTasksEXT draw_mesh_tasks;
+};
+
+/**
+ * Storage buffers of a MeshletMesh, with the descriptor set binding them.
+ *
+ * All buffers are persistently mapped. Meshlet data is written once on creation, and the compacted
+ * indices and draw command may be read back by the host after the frame's work completes.
+ */
+struct MeshletBuffers
+{
+	types::VulkanBufferPtr meshlets_buffer;
+	types::VulkanDeviceMemoryPtr meshlets_memory;
+	std::span<Meshlet> meshlets;
+
+	types::VulkanBufferPtr bounds_buffer;
+	types::VulkanDeviceMemoryPtr bounds_memory;
+	std::span<MeshletBounds> bounds;
+
+	types::VulkanBufferPtr vertices_buffer;
+	types::VulkanDeviceMemoryPtr vertices_memory;
+	std::span<uint32_t> vertices;
+
+	types::VulkanBufferPtr triangles_buffer;
+	types::VulkanDeviceMemoryPtr triangles_memory;
+	std::span<uint32_t> triangles;
+
+	/// Also usable as a vertex buffer of tightly packed 3 float positions.
+	types::VulkanBufferPtr positions_buffer;
+	types::VulkanDeviceMemoryPtr positions_memory;
+	std::span<std::array<float, 3>> positions;
+
+	/// Triangles of visible meshlets, as indices into positions, written by the compaction pass.
+	types::VulkanBufferPtr indices_buffer;
+	types::VulkanDeviceMemoryPtr indices_memory;
+	std::span<uint32_t const> indices;
+
+	/// Single draw of the compacted indices.
+	types::VulkanBufferPtr command_buffer;
+	types::VulkanDeviceMemoryPtr command_memory;
+	std::span<VkDrawIndexedIndirectCommand const> command;
+
+	compute::ComputeBindings bindings;
+};
+
+/**
+ * Split a mesh into meshlets.
+ *
+ * Meshlets are grown greedily from a seed triangle, preferring neighbouring triangles that add
+ * the fewest new vertices, until either limit is reached.
+ *
+ * @param mesh Triangle list with counter-clockwise front faces.
+ * @return
+ */
+MeshletMesh build_meshlets(lod::Mesh const & mesh);
+
+/**
+ * Check whether a meshlet may be visible, as the GPU culling passes do.
+ *
+ * @param bounds
+ * @param frustum Planes in mesh space, i.e. extracted from the clip-from-mesh matrix.
+ * @param camera Camera position in mesh space.
+ * @return False only if the meshlet is entirely outside the frustum or entirely back facing.
+ */
+bool is_meshlet_visible(
+	MeshletBounds const & bounds, frustum::Frustum const & frustum, maths::Vec3 const & camera);
+
+/**
+ * Check whether a device supports task and mesh shaders.
+ *
+ * If so, `VK_EXT_mesh_shader` must be enabled on device creation, along with the `taskShader` and
+ * `meshShader` features of VkPhysicalDeviceMeshShaderFeaturesEXT, to use MeshletDrawPipeline.
+ *
+ * @param logger
+ * @param physical_device
+ * @return
+ */
+bool supports_mesh_shaders(LoggerPtr const & logger, VkPhysicalDevice physical_device);
+
+/**
+ * Create the compaction compute kernel.
+ *
+ * Bindings are meshlets, bounds, vertices, triangles, positions, indices then command, as per
+ * MeshletBuffers.
+ *
+ * @param device
+ * @return
+ */
+compute::ComputeKernel create_meshlet_cull_kernel(types::VulkanDevicePtr const & device);
+
+/**
+ * Create the task and mesh shader pipeline, for dynamic rendering to a single colour attachment.
+ *
+ * Fragments are coloured per meshlet, to visualise clustering.
+ *
+ * @param device Must have mesh shaders enabled, see supports_mesh_shaders.
+ * @param colour_format
+ * @return
+ */
+MeshletDrawPipeline create_meshlet_draw_pipeline(
+	types::VulkanDevicePtr const & device, VkFormat colour_format);
+
+/**
+ * Upload a meshlet mesh and its vertex positions to storage buffers, and create a descriptor set
+ * binding them.
+ *
+ * @param device
+ * @param memory_type_idx Host visible and host coherent memory type.
+ * @param descriptor_set_layout Of the pipeline that the buffers will be used with, either the
+ * compaction kernel or MeshletDrawPipeline.
+ * @param meshlet_mesh
+ * @param positions Vertices of the mesh that @p meshlet_mesh was built from.
+ * @return
+ */
+MeshletBuffers create_meshlet_buffers(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx memory_type_idx,
+	types::VulkanDescriptorSetLayoutPtr const & descriptor_set_layout,
+	MeshletMesh const & meshlet_mesh,
+	std::span<std::array<float, 3> const> positions);
+
+/**
+ * Record the culling and compaction dispatch, including barriers so that the resulting indices
+ * and command are visible to a subsequent indexed indirect draw and to the host.
+ *
+ * Must be recorded outside of a render pass, on a device with `synchronization2` enabled.
+ *
+ * @param command_buffer
+ * @param kernel
+ * @param buffers
+ * @param frustum Planes in mesh space.
+ * @param camera Camera position in mesh space.
+ */
+void populate_cmd_meshlet_cull(
+	VkCommandBuffer command_buffer,
+	compute::ComputeKernel const & kernel,
+	MeshletBuffers const & buffers,
+	frustum::Frustum const & frustum,
+	maths::Vec3 const & camera);
+
+/**
+ * Record the indirect draw of previously compacted indices.
+ *
+ * Must be recorded within a render pass, after binding a graphics pipeline and vertex buffers,
+ * e.g. MeshletBuffers::positions_buffer.
+ *
+ * @param command_buffer
+ * @param buffers
+ */
+void populate_cmd_draw_compacted(VkCommandBuffer command_buffer, MeshletBuffers const & buffers);
+
+/**
+ * Record culling and drawing of all meshlets via task and mesh shaders.
+ *
+ * Must be recorded within dynamic rendering, with dynamic viewport and scissor set.
+ *
+ * @param command_buffer
+ * @param pipeline
+ * @param buffers
+ * @param clip_from_mesh Projection * view * model.
+ * @param camera Camera position in mesh space.
+ */
+void populate_cmd_draw_meshlets(
+	VkCommandBuffer command_buffer,
+	MeshletDrawPipeline const & pipeline,
+	MeshletBuffers const & buffers,
+	maths::Mat4 const & clip_from_mesh,
+	maths::Vec3 const & camera);
+}  // namespace vulkandemo::meshlet
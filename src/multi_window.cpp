@@ -0,0 +1,315 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "multi_window.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <range/v3/range/conversion.hpp>
+
+#include <SDL_video.h>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner) for `logger`
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `VK_CHECK`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "draw.hpp"
+#include "macros.hpp"
+#include "setup.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::multi_window
+{
+WindowSurface create_window_surface(
+	LoggerPtr const & logger,
+	VkPhysicalDevice physical_device,
+	types::VulkanQueueFamilyIdx const queue_family_idx,
+	types::VulkanDevicePtr const & device,
+	types::SDLWindowPtr window,
+	types::VulkanSurfacePtr surface,
+	VkSurfaceFormatKHR const surface_format)
+{
+	std::vector<types::VulkanQueueFamilyIdx> const presenting_queue_families =
+		setup::filter_available_queue_families(physical_device, VK_QUEUE_GRAPHICS_BIT, surface);
+	if (std::ranges::find(presenting_queue_families, queue_family_idx) ==
+		presenting_queue_families.end())
+		throw std::runtime_error{"Queue family cannot present to window"};
+
+	if (setup::filter_available_surface_formats(
+			logger, physical_device, surface, std::array{surface_format.format})
+			.empty())
+		throw std::runtime_error{std::format(
+			"Window surface does not support format {}", string_VkFormat(surface_format.format))};
+
+	auto [swapchain, image_views] = setup::create_exclusive_double_buffer_swapchain_and_image_views(
+		logger, physical_device, device, surface, surface_format);
+	std::vector<VkImage> images = setup::get_swapchain_images(device, swapchain);
+	VkExtent2D const drawable_size = setup::window_drawable_size(window);
+	uint32_t const window_id = SDL_GetWindowID(window.get());
+
+	return WindowSurface{
+		.window = std::move(window),
+		.window_id = window_id,
+		.surface = std::move(surface),
+		.surface_format = surface_format,
+		.swapchain = std::move(swapchain),
+		.image_views = std::move(image_views),
+		.images = std::move(images),
+		.drawable_size = drawable_size,
+		.image_available = setup::create_semaphore(device),
+		.out_of_date = false};
+}
+
+bool is_drawable(WindowSurface const & window)
+{
+	VkExtent2D const drawable_size = setup::window_drawable_size(window.window);
+	return drawable_size.width > 0 && drawable_size.height > 0;
+}
+
+void recreate_swapchain(
+	LoggerPtr const & logger,
+	VkPhysicalDevice physical_device,
+	types::VulkanDevicePtr const & device,
+	WindowSurface & window)
+{
+	window.drawable_size = setup::window_drawable_size(window.window);
+	logger->debug(
+		"New drawable size ({}, {}) for window {}",
+		window.drawable_size.width,
+		window.drawable_size.height,
+		window.window_id);
+
+	std::tie(window.swapchain, window.image_views) =
+		setup::create_exclusive_double_buffer_swapchain_and_image_views(
+			logger,
+			physical_device,
+			device,
+			window.surface,
+			window.surface_format,
+			window.swapchain);
+	window.images = setup::get_swapchain_images(device, window.swapchain);
+
+	// A failed acquire may have left the semaphore with a pending signal, so replace it.
+	window.image_available = setup::create_semaphore(device);
+	window.out_of_date = false;
+}
+
+std::size_t find_window(std::span<WindowSurface const> const windows, uint32_t const window_id)
+{
+	auto const found = std::ranges::find(windows, window_id, &WindowSurface::window_id);
+	return static_cast<std::size_t>(std::distance(windows.begin(), found));
+}
+
+std::vector<AcquiredImage> acquire_window_images(
+	types::VulkanDevicePtr const & device, std::span<WindowSurface> const windows)
+{
+	std::vector<AcquiredImage> acquired;
+	for (std::size_t window_idx = 0; window_idx < windows.size(); ++window_idx)
+	{
+		WindowSurface & window = windows[window_idx];
+		if (window.out_of_date || !is_drawable(window))
+			continue;
+
+		std::optional<types::VulkanImageIdx> const image_idx =
+			draw::acquire_next_swapchain_image(device, window.swapchain, window.image_available);
+		if (!image_idx)
+		{
+			window.out_of_date = true;
+			continue;
+		}
+		acquired.push_back({.window_idx = window_idx, .image_idx = *image_idx});
+	}
+	return acquired;
+}
+
+std::vector<types::VulkanSemaphorePtr> image_available_semaphores(
+	std::span<WindowSurface const> const windows, std::span<AcquiredImage const> const acquired)
+{
+	return acquired |
+		std::views::transform([&](AcquiredImage const & image)
+							  { return windows[image.window_idx].image_available; }) |
+		ranges::to<std::vector>();
+}
+
+void present_window_images(
+	VkQueue queue,
+	std::span<WindowSurface> const windows,
+	std::span<AcquiredImage const> const acquired,
+	types::VulkanSemaphorePtr const & wait_semaphore)
+{
+	if (acquired.empty())
+		return;
+
+	std::vector<types::VulkanSwapchainPtr> const swapchains =
+		acquired |
+		std::views::transform([&](AcquiredImage const & image)
+							  { return windows[image.window_idx].swapchain; }) |
+		ranges::to<std::vector>();
+	std::vector<types::VulkanImageIdx> const image_idxs =
+		acquired | std::views::transform(&AcquiredImage::image_idx) | ranges::to<std::vector>();
+
+	std::vector<bool> const presented =
+		draw::submit_present_images_cmd(queue, swapchains, image_idxs, wait_semaphore);
+	for (std::size_t idx = 0; idx < acquired.size(); ++idx)
+		if (!presented[idx])
+			windows[acquired[idx].window_idx].out_of_date = true;
+}
+
+TEST_CASE("Present to multiple windows")
+{
+	LoggerPtr const logger = create_logger("Present to multiple windows");
+
+	constexpr std::size_t window_count = 3;
+	std::vector<types::SDLWindowPtr> sdl_windows;
+	for (std::size_t window_idx = 0; window_idx < window_count; ++window_idx)
+		sdl_windows.push_back(setup::create_window("", 16, 16));
+
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		sdl_windows.front(),
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+
+	std::vector<types::VulkanSurfacePtr> surfaces;
+	for (types::SDLWindowPtr const & sdl_window : sdl_windows)
+		surfaces.push_back(setup::create_surface(sdl_window, instance));
+
+	// Device is selected against the first window's surface, then checked against the others.
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{types::DesiredDeviceExtensionNameView{VK_KHR_SWAPCHAIN_EXTENSION_NAME}},
+		VK_QUEUE_GRAPHICS_BIT,
+		0,
+		surfaces.front());
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{{types::AvailableDeviceExtensionNameView{VK_KHR_SWAPCHAIN_EXTENSION_NAME}}});
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	std::vector<VkSurfaceFormatKHR> const available_formats =
+		setup::filter_available_surface_formats(
+			logger,
+			physical_device,
+			surfaces.front(),
+			{{VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_B8G8R8A8_UNORM}});
+
+	std::vector<WindowSurface> windows;
+	for (std::size_t window_idx = 0; window_idx < window_count; ++window_idx)
+		windows.push_back(create_window_surface(
+			logger,
+			physical_device,
+			queue_family_idx,
+			device,
+			std::move(sdl_windows[window_idx]),
+			std::move(surfaces[window_idx]),
+			available_formats.at(0)));
+
+	CHECK(find_window(windows, windows[1].window_id) == 1);
+	CHECK(find_window(windows, 0) == window_count);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkCommandBuffer command_buffer = command_buffers->front();
+	types::VulkanSemaphorePtr const rendering_finished = setup::create_semaphore(device);
+
+	auto const present_frame = [&]
+	{
+		std::vector<AcquiredImage> const acquired = acquire_window_images(device, windows);
+
+		// Transition every acquired image straight to presentable.
+		std::vector<VkImageMemoryBarrier> barriers;
+		for (AcquiredImage const & image : acquired)
+			barriers.push_back(VkImageMemoryBarrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.pNext = nullptr,
+				.srcAccessMask = 0,
+				.dstAccessMask = 0,
+				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = windows[image.window_idx].images.at(image.image_idx.value_of()),
+				.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}});
+
+		constexpr VkCommandBufferBeginInfo begin_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
+		VK_CHECK(
+			vkBeginCommandBuffer(command_buffer, &begin_info), "Failed to begin command buffer");
+		vkCmdPipelineBarrier(
+			command_buffer,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0,
+			0,
+			nullptr,
+			0,
+			nullptr,
+			static_cast<uint32_t>(barriers.size()),
+			barriers.data());
+		VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
+
+		draw::submit_command_buffers(
+			queue,
+			std::array{command_buffer},
+			image_available_semaphores(windows, acquired),
+			rendering_finished);
+		present_window_images(queue, windows, acquired, rendering_finished);
+		VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+		return acquired;
+	};
+
+	SUBCASE("all windows present together")
+	{
+		std::vector<AcquiredImage> const acquired = present_frame();
+		REQUIRE(acquired.size() == window_count);
+		for (std::size_t window_idx = 0; window_idx < window_count; ++window_idx)
+		{
+			CHECK(acquired[window_idx].window_idx == window_idx);
+			CHECK_FALSE(windows[window_idx].out_of_date);
+		}
+	}
+
+	SUBCASE("out of date windows are skipped until recreated")
+	{
+		windows[1].out_of_date = true;
+		std::vector<AcquiredImage> acquired = present_frame();
+		REQUIRE(acquired.size() == window_count - 1);
+		CHECK(acquired[0].window_idx == 0);
+		CHECK(acquired[1].window_idx == 2);
+
+		VK_CHECK(vkDeviceWaitIdle(device.get()), "Failed to wait for device to be idle");
+		recreate_swapchain(logger, physical_device, device, windows[1]);
+		CHECK_FALSE(windows[1].out_of_date);
+		acquired = present_frame();
+		CHECK(acquired.size() == window_count);
+	}
+}
+}  // namespace vulkandemo::multi_window
@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "types.hpp"
+
+/**
+ * Several windows, each with its own surface and swapchain, presented from one device and queue.
+ *
+ * Each frame, an image is acquired from every window that can currently be drawn to, before any
+ * recording starts. The frame's command buffers are then submitted as one batch waiting on every
+ * acquire, and all acquired images are presented by a single `vkQueuePresentKHR`.
+ *
+ * Swapchains are recreated per window. A window whose swapchain is found out of date, e.g. by an
+ * acquire, a present or a resize event, is skipped until recreated, whilst other windows continue
+ * to be drawn.
+ */
+namespace vulkandemo::multi_window
+{
+/**
+ * A window and the swapchain presenting to it.
+ */
+struct WindowSurface
+{
+	types::SDLWindowPtr window;
+	/// SDL's ID of the window, as given by window events.
+	uint32_t window_id;
+	types::VulkanSurfacePtr surface;
+	VkSurfaceFormatKHR surface_format;
+	types::VulkanSwapchainPtr swapchain;
+	std::vector<types::VulkanImageViewPtr> image_views;
+	/// Indexed by VulkanImageIdx.
+	std::vector<VkImage> images;
+	/// Extent of the swapchain images.
+	VkExtent2D drawable_size;
+	/// Signalled when the acquired image is ready, see acquire_window_images.
+	types::VulkanSemaphorePtr image_available;
+	/// Whether the swapchain must be recreated before the window can be drawn to again.
+	bool out_of_date;
+};
+
+/**
+ * Image acquired from one of a set of windows.
+ */
+struct AcquiredImage
+{
+	std::size_t window_idx;
+	types::VulkanImageIdx image_idx;
+};
+
+/**
+ * Create a swapchain for a window's surface.
+ *
+ * @param logger
+ * @param physical_device
+ * @param queue_family_idx Queue family that presents, which is checked can present to the surface.
+ * @param device
+ * @param window
+ * @param surface Surface of @p window, see setup::create_surface.
+ * @param surface_format Format of the swapchain images, which is checked is supported by the
+ * surface.
+ * @return
+ */
+WindowSurface create_window_surface(
+	LoggerPtr const & logger,
+	VkPhysicalDevice physical_device,
+	types::VulkanQueueFamilyIdx queue_family_idx,
+	types::VulkanDevicePtr const & device,
+	types::SDLWindowPtr window,
+	types::VulkanSurfacePtr surface,
+	VkSurfaceFormatKHR surface_format);
+
+/**
+ * Whether a window has a non-zero drawable area, e.g. is not minimised.
+ *
+ * @param window
+ * @return
+ */
+bool is_drawable(WindowSurface const & window);
+
+/**
+ * Recreate a window's swapchain at the window's current drawable size.
+ *
+ * The device must be idle, or at least the window's swapchain images and semaphore unused.
+ *
+ * @param logger
+ * @param physical_device
+ * @param device
+ * @param window Must be drawable.
+ */
+void recreate_swapchain(
+	LoggerPtr const & logger,
+	VkPhysicalDevice physical_device,
+	types::VulkanDevicePtr const & device,
+	WindowSurface & window);
+
+/**
+ * Find a window by SDL window ID.
+ *
+ * @param windows
+ * @param window_id
+ * @return Index into @p windows, or the number of windows if not found.
+ */
+std::size_t find_window(std::span<WindowSurface const> windows, uint32_t window_id);
+
+/**
+ * Acquire the next image of every window that is drawable and not out of date.
+ *
+ * Windows whose swapchain is found out of date are marked as such and skipped.
+ *
+ * @param device
+ * @param windows
+ * @return Acquired images in window order.
+ */
+std::vector<AcquiredImage> acquire_window_images(
+	types::VulkanDevicePtr const & device, std::span<WindowSurface> windows);
+
+/**
+ * Semaphores signalled by acquire_window_images, for a submission to wait on.
+ *
+ * @param windows
+ * @param acquired
+ * @return
+ */
+std::vector<types::VulkanSemaphorePtr> image_available_semaphores(
+	std::span<WindowSurface const> windows, std::span<AcquiredImage const> acquired);
+
+/**
+ * Present every acquired image in a single `vkQueuePresentKHR`.
+ *
+ * Windows whose swapchain is found out of date or suboptimal are marked as out of date.
+ *
+ * @param queue
+ * @param windows
+ * @param acquired As returned by acquire_window_images.
+ * @param wait_semaphore Signalled once rendering to every acquired image has finished.
+ */
+void present_window_images(
+	VkQueue queue,
+	std::span<WindowSurface> windows,
+	std::span<AcquiredImage const> acquired,
+	types::VulkanSemaphorePtr const & wait_semaphore);
+}  // namespace vulkandemo::multi_window
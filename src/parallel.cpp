@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+namespace vulkandemo::parallel
+{
+ThreadPool::ThreadPool(std::size_t const worker_count)
+{
+	workers_.reserve(worker_count);
+	for (std::size_t worker_idx = 0; worker_idx < worker_count; ++worker_idx)
+		workers_.emplace_back([this] { work(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard const lock{mutex_};
+		stopping_ = true;
+	}
+	wake_.notify_all();
+	// Join before the synchronisation primitives the workers use are destroyed.
+	workers_.clear();
+}
+
+std::size_t ThreadPool::thread_count() const
+{
+	return workers_.size() + 1;
+}
+
+std::size_t ThreadPool::default_worker_count()
+{
+	return std::max(std::thread::hardware_concurrency(), 1U) - 1;
+}
+
+void ThreadPool::run(std::size_t const task_count, std::function<void(std::size_t)> const & task)
+{
+	if (workers_.empty() || task_count <= 1)
+	{
+		for (std::size_t task_idx = 0; task_idx < task_count; ++task_idx)
+			task(task_idx);
+		return;
+	}
+
+	{
+		std::lock_guard const lock{mutex_};
+		task_ = &task;
+		task_count_ = task_count;
+		next_task_idx_.store(0, std::memory_order_relaxed);
+		busy_workers_ = workers_.size();
+		++generation_;
+	}
+	wake_.notify_all();
+
+	drain();
+
+	std::unique_lock lock{mutex_};
+	done_.wait(lock, [this] { return busy_workers_ == 0; });
+	task_ = nullptr;
+}
+
+void ThreadPool::work()
+{
+	std::size_t seen_generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock lock{mutex_};
+			wake_.wait(lock, [&] { return stopping_ || generation_ != seen_generation; });
+			if (stopping_)
+				return;
+			seen_generation = generation_;
+		}
+
+		drain();
+
+		{
+			std::lock_guard const lock{mutex_};
+			--busy_workers_;
+		}
+		done_.notify_one();
+	}
+}
+
+void ThreadPool::drain()
+{
+	for (std::size_t task_idx = next_task_idx_.fetch_add(1, std::memory_order_relaxed);
+		 task_idx < task_count_;
+		 task_idx = next_task_idx_.fetch_add(1, std::memory_order_relaxed))
+	{
+		(*task_)(task_idx);
+	}
+}
+
+std::size_t for_each_chunk(
+	ThreadPool & pool,
+	std::size_t const count,
+	std::size_t const chunk_size,
+	std::function<void(std::size_t, std::size_t, std::size_t)> const & fn)
+{
+	std::size_t const chunk_count = (count + chunk_size - 1) / chunk_size;
+	pool.run(
+		chunk_count,
+		[&](std::size_t const chunk_idx)
+		{
+			std::size_t const begin = chunk_idx * chunk_size;
+			fn(chunk_idx, begin, std::min(begin + chunk_size, count));
+		});
+	return chunk_count;
+}
+
+TEST_CASE("Run tasks on a thread pool")
+{
+	constexpr std::size_t task_count = 1000;
+
+	for (std::size_t const worker_count : {0UZ, 1UZ, 4UZ})
+	{
+		CAPTURE(worker_count);
+		ThreadPool pool{worker_count};
+		CHECK(pool.thread_count() == worker_count + 1);
+
+		// Repeat to check workers are correctly parked and re-woken between batches.
+		for (std::size_t batch = 0; batch < 3; ++batch)
+		{
+			std::vector<std::atomic<int>> visits(task_count);
+			pool.run(task_count, [&](std::size_t const task_idx) { ++visits[task_idx]; });
+			CHECK(std::ranges::all_of(visits, [](auto const & visit) { return visit == 1; }));
+		}
+
+		// Chunked, with a partial final chunk.
+		std::vector<std::size_t> items(task_count + 7, 0);
+		std::size_t const chunk_count = for_each_chunk(
+			pool,
+			items.size(),
+			64,
+			[&](std::size_t const chunk_idx, std::size_t const begin, std::size_t const end)
+			{
+				for (std::size_t item_idx = begin; item_idx < end; ++item_idx)
+					items[item_idx] = chunk_idx + 1;
+			});
+
+		CHECK(chunk_count == 16);
+		CHECK(items.front() == 1);
+		CHECK(items.back() == 16);
+		CHECK(std::ranges::is_sorted(items));
+	}
+}
+}  // namespace vulkandemo::parallel
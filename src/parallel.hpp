@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Data-parallel helpers for CPU-side per-frame work, e.g. culling large object sets.
+ */
+namespace vulkandemo::parallel
+{
+/**
+ * Fixed set of persistent worker threads that cooperatively execute batches of indexed tasks.
+ *
+ * Spawning threads per frame costs tens of microseconds per thread, so workers are created once and
+ * parked on a condition variable between batches. The calling thread participates in each batch.
+ *
+ * Batches must not be submitted concurrently from multiple threads, nor from within a task.
+ */
+class ThreadPool
+{
+public:
+	/**
+	 * Start worker threads.
+	 *
+	 * @param worker_count Number of threads in addition to the calling thread. Defaults to one
+	 * fewer than the number of hardware threads.
+	 */
+	explicit ThreadPool(std::size_t worker_count = default_worker_count());
+	~ThreadPool();
+
+	ThreadPool(ThreadPool const &) = delete;
+	ThreadPool(ThreadPool &&) = delete;
+	ThreadPool & operator=(ThreadPool const &) = delete;
+	ThreadPool & operator=(ThreadPool &&) = delete;
+
+	/**
+	 * @return Number of threads that execute tasks, including the calling thread.
+	 */
+	[[nodiscard]] std::size_t thread_count() const;
+
+	/**
+	 * Execute `task(task_idx)` for every `task_idx` in `[0, task_count)`, blocking until all have
+	 * completed.
+	 *
+	 * Tasks are claimed dynamically, so uneven task durations are balanced across threads. Tasks
+	 * must not throw.
+	 *
+	 * @param task_count
+	 * @param task
+	 */
+	void run(std::size_t task_count, std::function<void(std::size_t)> const & task);
+
+	/**
+	 * @return Hardware thread count less one, or zero if unknown.
+	 */
+	static std::size_t default_worker_count();
+
+private:
+	void work();
+	void drain();
+
+	std::vector<std::jthread> workers_;
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::condition_variable done_;
+	std::function<void(std::size_t)> const * task_ = nullptr;
+	std::size_t task_count_ = 0;
+	std::atomic<std::size_t> next_task_idx_ = 0;
+	/// Incremented for every batch, so parked workers can tell a new batch from a spurious wake.
+	std::size_t generation_ = 0;
+	/// Workers still executing tasks of the current batch.
+	std::size_t busy_workers_ = 0;
+	bool stopping_ = false;
+};
+
+/**
+ * Split `[0, count)` into contiguous chunks and process them on a thread pool.
+ *
+ * @param pool
+ * @param count Total number of items.
+ * @param chunk_size Items per chunk. The final chunk may be smaller.
+ * @param fn Callable taking `(chunk_idx, begin, end)`.
+ * @return Number of chunks, i.e. one more than the largest `chunk_idx` passed to `fn`.
+ */
+std::size_t for_each_chunk(
+	ThreadPool & pool,
+	std::size_t count,
+	std::size_t chunk_size,
+	std::function<void(std::size_t, std::size_t, std::size_t)> const & fn);
+}  // namespace vulkandemo::parallel
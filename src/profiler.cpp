@@ -0,0 +1,389 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <range/v3/range/conversion.hpp>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner)
+
+#include <doctest/doctest.h>
+
+#include "Logger.hpp"
+#include "bench.hpp"
+
+namespace vulkandemo::profiler
+{
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Buffers of every thread that has recorded, kept after their thread exits so that its events can
+ * still be exported.
+ */
+struct Registry
+{
+	std::mutex mutex;
+	std::vector<std::unique_ptr<detail::ThreadBuffer>> buffers;
+	/// Origin of exported timestamps, and calibration point of ticks against the clock.
+	uint64_t epoch_ticks = detail::now_ticks();
+	Clock::time_point epoch_time = Clock::now();
+};
+
+Registry & registry()
+{
+	static Registry instance;
+	return instance;
+}
+
+/**
+ * Copy the events of a buffer that have not been overwritten.
+ */
+void copy_events(
+	detail::ThreadBuffer const & buffer,
+	uint64_t const epoch_ticks,
+	double const us_per_tick,
+	std::vector<Event> & events)
+{
+	uint64_t const committed = buffer.committed.load(std::memory_order_acquire);
+	uint64_t const first = committed > kEventsPerThread ? committed - kEventsPerThread : 0;
+
+	auto const begin = static_cast<std::ptrdiff_t>(events.size());
+	for (uint64_t idx = first; idx < committed; ++idx)
+	{
+		detail::Slot const & slot = buffer.slots[idx % kEventsPerThread];
+		uint64_t const start = slot.start.load(std::memory_order_relaxed);
+		uint64_t const end = slot.end.load(std::memory_order_relaxed);
+		events.push_back(Event{
+			.name = slot.name.load(std::memory_order_relaxed),
+			.thread_id = buffer.thread_id,
+			// Signed, since a scope may start before the profiler's first use, i.e. the epoch.
+			.start_us =
+				static_cast<double>(static_cast<int64_t>(start - epoch_ticks)) * us_per_tick,
+			.duration_us = static_cast<double>(end - start) * us_per_tick});
+	}
+
+	// Slots whose overwrite began during the copy may be torn, so are dropped.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t const begun = buffer.begun.load(std::memory_order_relaxed);
+	uint64_t const valid_first = begun > kEventsPerThread ? begun - kEventsPerThread : 0;
+	if (valid_first > first)
+		events.erase(
+			std::next(events.begin(), begin),
+			std::next(
+				events.begin(),
+				begin + static_cast<std::ptrdiff_t>(std::min(valid_first, committed) - first)));
+}
+
+/**
+ * Append a string as a JSON string literal.
+ */
+void append_json_string(std::string & out, std::string_view const str)
+{
+	out += '"';
+	for (char const chr : str)
+	{
+		if (chr == '"' || chr == '\\')
+		{
+			out += '\\';
+			out += chr;
+		}
+		else if (static_cast<unsigned char>(chr) < 0x20)
+			out += std::format("\\u{:04x}", static_cast<unsigned>(chr));
+		else
+			out += chr;
+	}
+	out += '"';
+}
+}  // namespace
+
+detail::ThreadBuffer & detail::register_thread()
+{
+	Registry & reg = registry();
+	std::lock_guard const lock{reg.mutex};
+	auto & buffer = reg.buffers.emplace_back(std::make_unique<ThreadBuffer>());
+	buffer->thread_id = static_cast<uint32_t>(reg.buffers.size());
+	thread_buffer = buffer.get();
+	return *buffer;
+}
+
+std::vector<Event> snapshot(std::optional<std::chrono::nanoseconds> const window)
+{
+	Registry & reg = registry();
+	std::lock_guard const lock{reg.mutex};
+
+	// Calibrate ticks against the clock over the whole lifetime of the profiler.
+	uint64_t const now_ticks = detail::now_ticks();
+	Clock::time_point const now_time = Clock::now();
+	std::chrono::duration<double, std::micro> const elapsed = now_time - reg.epoch_time;
+	double const us_per_tick = now_ticks > reg.epoch_ticks
+		? elapsed.count() / static_cast<double>(now_ticks - reg.epoch_ticks)
+		: 0.0;
+
+	std::vector<Event> events;
+	for (std::unique_ptr<detail::ThreadBuffer> const & buffer : reg.buffers)
+		copy_events(*buffer, reg.epoch_ticks, us_per_tick, events);
+
+	if (window)
+	{
+		double const window_start_us =
+			elapsed.count() - std::chrono::duration<double, std::micro>{*window}.count();
+		std::erase_if(
+			events,
+			[&](Event const & event)
+			{ return event.start_us + event.duration_us < window_start_us; });
+	}
+
+	std::ranges::sort(events, {}, &Event::start_us);
+	return events;
+}
+
+std::string to_chrome_trace(std::span<Event const> const events)
+{
+	std::string out = R"({"displayTimeUnit":"ms","traceEvents":[)";
+	for (Event const & event : events)
+	{
+		if (&event != events.data())
+			out += ',';
+		out += R"({"name":)";
+		append_json_string(out, event.name);
+		out += std::format(
+			R"(,"cat":"cpu","ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+			event.thread_id,
+			event.start_us,
+			event.duration_us);
+	}
+	out += "]}\n";
+	return out;
+}
+
+void write_chrome_trace(
+	std::filesystem::path const & path, std::optional<std::chrono::nanoseconds> const window)
+{
+	std::vector<Event> const events = snapshot(window);
+	std::string const json = to_chrome_trace(events);
+	std::ofstream file{path, std::ios::binary};
+	file.write(json.data(), static_cast<std::streamsize>(json.size()));
+	if (!file)
+		throw std::runtime_error{std::format("Failed to write {}", path.string())};
+}
+
+namespace
+{
+/**
+ * Events of the snapshot with the given name.
+ */
+std::vector<Event> named(std::span<Event const> const events, std::string_view const name)
+{
+	std::vector<Event> out;
+	std::ranges::copy_if(
+		events,
+		std::back_inserter(out),
+		[&](Event const & event) { return std::string_view{event.name} == name; });
+	return out;
+}
+}  // namespace
+
+TEST_CASE("Record CPU profiler scopes")
+{
+	SUBCASE("nested scopes")
+	{
+		{
+			Scope const outer{"test outer"};
+			Scope const inner{"test inner"};
+		}
+
+		std::vector<Event> const events = snapshot();
+		std::vector<Event> const outer = named(events, "test outer");
+		std::vector<Event> const inner = named(events, "test inner");
+		REQUIRE(outer.size() == 1);
+		REQUIRE(inner.size() == 1);
+
+		CHECK(outer.front().thread_id == inner.front().thread_id);
+		CHECK(outer.front().start_us <= inner.front().start_us);
+		CHECK(
+			inner.front().start_us + inner.front().duration_us <=
+			outer.front().start_us + outer.front().duration_us);
+		CHECK(std::ranges::is_sorted(events, {}, &Event::start_us));
+	}
+
+	SUBCASE("durations are calibrated")
+	{
+		{
+			Scope const sleep{"test sleep"};
+			std::this_thread::sleep_for(std::chrono::milliseconds{20});
+		}
+		std::vector<Event> const sleeps = named(snapshot(), "test sleep");
+		REQUIRE(sleeps.size() == 1);
+		CHECK(sleeps.front().duration_us >= 15'000);
+		CHECK(sleeps.front().duration_us < 1'000'000);
+	}
+
+	SUBCASE("rolling window")
+	{
+		{
+			Scope const old{"test old"};
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds{50});
+		{
+			Scope const recent{"test recent"};
+		}
+		std::vector<Event> const windowed = snapshot(std::chrono::milliseconds{25});
+		CHECK(named(windowed, "test old").empty());
+		CHECK(named(windowed, "test recent").size() == 1);
+	}
+}
+
+TEST_CASE("Record CPU profiler scopes across threads")
+{
+	constexpr std::size_t thread_count = 4;
+	constexpr std::size_t scope_count = 100;
+
+	SUBCASE("each thread has its own buffer")
+	{
+		std::vector<std::jthread> threads;
+		for (std::size_t thread_idx = 0; thread_idx < thread_count; ++thread_idx)
+			threads.emplace_back(
+				[]
+				{
+					for (std::size_t scope_idx = 0; scope_idx < scope_count; ++scope_idx)
+						Scope const scope{"test thread"};
+				});
+		threads.clear();
+
+		std::vector<Event> const events = named(snapshot(), "test thread");
+		CHECK(events.size() == thread_count * scope_count);
+		std::vector<uint32_t> thread_ids =
+			events | std::views::transform(&Event::thread_id) | ranges::to<std::vector>();
+		std::ranges::sort(thread_ids);
+		thread_ids.erase(std::ranges::unique(thread_ids).begin(), thread_ids.end());
+		CHECK(thread_ids.size() == thread_count);
+	}
+
+	SUBCASE("oldest events are overwritten")
+	{
+		std::jthread{[]
+					 {
+						 {
+							 Scope const first{"test overwritten"};
+						 }
+						 for (std::size_t scope_idx = 0; scope_idx < kEventsPerThread; ++scope_idx)
+							 Scope const scope{"test overwriting"};
+					 }}
+			.join();
+
+		std::vector<Event> const events = snapshot();
+		CHECK(named(events, "test overwritten").empty());
+		CHECK(named(events, "test overwriting").size() == kEventsPerThread);
+	}
+
+	SUBCASE("snapshot while recording")
+	{
+		std::atomic<bool> stop{false};
+		std::barrier started{2};
+		std::jthread writer{[&]
+							{
+								started.arrive_and_wait();
+								while (!stop.load(std::memory_order_relaxed))
+									Scope const scope{"test concurrent"};
+							}};
+		started.arrive_and_wait();
+		for (int snapshot_idx = 0; snapshot_idx < 10; ++snapshot_idx)
+			for (Event const & event : named(snapshot(), "test concurrent"))
+				CHECK(event.duration_us >= 0);
+		stop = true;
+	}
+}
+
+TEST_CASE("Export Chrome trace events")
+{
+	std::array const events{
+		Event{.name = "frame", .thread_id = 1, .start_us = 10, .duration_us = 16.5},
+		Event{.name = R"(quote" backslash\)", .thread_id = 2, .start_us = 12.25, .duration_us = 1}};
+
+	CHECK(
+		to_chrome_trace(events) ==
+		R"({"displayTimeUnit":"ms","traceEvents":[)"
+		R"({"name":"frame","cat":"cpu","ph":"X","pid":1,"tid":1,"ts":10.000,"dur":16.500},)"
+		R"({"name":"quote\" backslash\\","cat":"cpu","ph":"X","pid":1,"tid":2,"ts":12.250,)"
+		R"("dur":1.000}]})"
+		"\n");
+	CHECK(to_chrome_trace({}) == "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[]}\n");
+
+	SUBCASE("to file")
+	{
+		{
+			Scope const scope{"test file"};
+		}
+		std::filesystem::path const path =
+			std::filesystem::temp_directory_path() / "vulkandemo_profiler_test.json";
+		write_chrome_trace(path);
+		std::ifstream file{path};
+		std::string const json{std::istreambuf_iterator<char>{file}, {}};
+		CHECK(json.starts_with(R"({"displayTimeUnit":"ms","traceEvents":[)"));
+		CHECK(json.contains(R"("name":"test file")"));
+		std::filesystem::remove(path);
+
+		CHECK_THROWS_AS(
+			write_chrome_trace(std::filesystem::path{"/nonexistent/dir/trace.json"}),
+			std::runtime_error);
+	}
+}
+
+TEST_CASE("Benchmark CPU profiler scopes" * doctest::test_suite("benchmark") * doctest::skip())
+{
+	vulkandemo::LoggerPtr const logger =
+		vulkandemo::create_logger("Benchmark CPU profiler scopes");
+
+	constexpr std::size_t scope_count = 1'000'000;
+	// Warm up, so the thread's buffer is allocated.
+	{
+		Scope const scope{"benchmark warm up"};
+	}
+
+	double const scoped_ms = bench::mean_ms(
+		10,
+		[]
+		{
+			for (std::size_t scope_idx = 0; scope_idx < scope_count; ++scope_idx)
+				Scope const scope{"benchmark scope"};
+		});
+	double const compiled_out_ms = bench::mean_ms(
+		10,
+		[]
+		{
+			for (std::size_t scope_idx = 0; scope_idx < scope_count; ++scope_idx)
+				PROFILE_SCOPE("benchmark macro");
+		});
+
+	logger->info(
+		"{:.1f} ns per scope; {:.1f} ns per PROFILE_SCOPE (profiler {})",
+		scoped_ms * 1e6 / scope_count,
+		compiled_out_ms * 1e6 / scope_count,
+		kEnabled ? "enabled" : "compiled out");
+
+	double const snapshot_ms = bench::mean_ms(10, [] { static_cast<void>(snapshot()); });
+	logger->info("Snapshot of {} events: {:.3f} ms", snapshot().size(), snapshot_ms);
+}
+}  // namespace vulkandemo::profiler
@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/**
+ * CPU profiling of scopes, exported as Chrome trace events.
+ *
+ * Each thread records into its own ring buffer of the most recent events, so recording takes no
+ * locks and, once the ring is allocated on the thread's first scope, no allocations. Timestamps are
+ * read from the TSC on x86-64, and from the monotonic clock elsewhere, converted to microseconds
+ * only on export.
+ *
+ * Instrument code with PROFILE_SCOPE and PROFILE_FUNCTION, which compile to nothing unless
+ * `VULKANDEMO_ENABLE_PROFILER` is defined, see the `vulkandemo_ENABLE_PROFILER` CMake option.
+ * Export with write_chrome_trace, and view with e.g. chrome://tracing or ui.perfetto.dev.
+ */
+namespace vulkandemo::profiler
+{
+/// Whether the instrumentation macros record anything.
+#if defined(VULKANDEMO_ENABLE_PROFILER)
+inline constexpr bool kEnabled = true;
+#else
+inline constexpr bool kEnabled = false;
+#endif
+
+/// Most recent events kept per thread, beyond which the oldest are overwritten.
+inline constexpr std::size_t kEventsPerThread = std::size_t{1} << 16;
+
+/**
+ * Completed scope, as exported.
+ */
+struct Event
+{
+	/// Static string, e.g. a literal or `__func__`.
+	char const * name;
+	/// Sequential in order of each thread's first scope, starting at 1.
+	uint32_t thread_id;
+	/// Relative to the profiler's first use.
+	double start_us;
+	double duration_us;
+};
+
+namespace detail
+{
+/**
+ * Ring buffer slot, with atomic fields so that exporting may read slots concurrently with the
+ * owning thread overwriting them.
+ */
+struct Slot
+{
+	std::atomic<char const *> name{nullptr};
+	std::atomic<uint64_t> start{0};
+	std::atomic<uint64_t> end{0};
+};
+
+/**
+ * Events of a single thread, written only by that thread.
+ */
+struct ThreadBuffer
+{
+	uint32_t thread_id = 0;
+	/// Number of events whose write has started, i.e. whose slot may be partially written.
+	std::atomic<uint64_t> begun{0};
+	/// Number of events completely written.
+	std::atomic<uint64_t> committed{0};
+	std::array<Slot, kEventsPerThread> slots;
+};
+
+/**
+ * Allocate and register the calling thread's buffer.
+ *
+ * @return
+ */
+ThreadBuffer & register_thread();
+
+inline thread_local ThreadBuffer * thread_buffer = nullptr;
+
+inline uint64_t now_ticks() noexcept
+{
+#if defined(__x86_64__)
+	return __rdtsc();
+#else
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+									 std::chrono::steady_clock::now().time_since_epoch())
+									 .count());
+#endif
+}
+
+inline void record(char const * const name, uint64_t const start, uint64_t const end)
+{
+	ThreadBuffer * buffer = thread_buffer;
+	if (buffer == nullptr)
+		buffer = &register_thread();
+
+	// Only this thread writes, so the counters can be read without synchronisation.
+	uint64_t const idx = buffer->committed.load(std::memory_order_relaxed);
+	// Readers must see the slot as being overwritten before seeing any of the new contents.
+	buffer->begun.store(idx + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	Slot & slot = buffer->slots[idx % kEventsPerThread];
+	slot.name.store(name, std::memory_order_relaxed);
+	slot.start.store(start, std::memory_order_relaxed);
+	slot.end.store(end, std::memory_order_relaxed);
+
+	buffer->committed.store(idx + 1, std::memory_order_release);
+}
+}  // namespace detail
+
+/**
+ * Record the lifetime of this object as an event of the calling thread.
+ */
+class Scope
+{
+public:
+	/**
+	 * @param name Must outlive any export, e.g. a literal or `__func__`.
+	 */
+	explicit Scope(char const * const name) noexcept : name_{name}, start_{detail::now_ticks()} {}
+	~Scope() { detail::record(name_, start_, detail::now_ticks()); }
+
+	Scope(Scope const &) = delete;
+	Scope(Scope &&) = delete;
+	Scope & operator=(Scope const &) = delete;
+	Scope & operator=(Scope &&) = delete;
+
+private:
+	char const * name_;
+	uint64_t start_;
+};
+
+/**
+ * Copy the events currently held by every thread's ring buffer.
+ *
+ * May be called from any thread, concurrently with recording. Events being overwritten while
+ * copied are dropped.
+ *
+ * @param window If set, only events that ended within this long before now.
+ * @return Sorted by start time.
+ */
+std::vector<Event> snapshot(std::optional<std::chrono::nanoseconds> window = std::nullopt);
+
+/**
+ * Format events as Chrome trace event JSON, as complete ("X") events of a single process.
+ *
+ * @param events
+ * @return
+ */
+std::string to_chrome_trace(std::span<Event const> events);
+
+/**
+ * Write a snapshot of recent events as a Chrome trace event JSON file.
+ *
+ * @param path
+ * @param window See snapshot.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void write_chrome_trace(
+	std::filesystem::path const & path,
+	std::optional<std::chrono::nanoseconds> window = std::nullopt);
+}  // namespace vulkandemo::profiler
+
+#define PROFILE_CONCAT_IMPL(lhs, rhs) lhs##rhs
+#define PROFILE_CONCAT(lhs, rhs) PROFILE_CONCAT_IMPL(lhs, rhs)
+
+#if defined(VULKANDEMO_ENABLE_PROFILER)
+/// Record the rest of the enclosing block as a named event. The name is not evaluated if disabled.
+#define PROFILE_SCOPE(name) \
+	::vulkandemo::profiler::Scope const PROFILE_CONCAT(profile_scope_, __LINE__) { name }
+#else
+#define PROFILE_SCOPE(name) static_cast<void>(0)
+#endif
+
+/// Record the rest of the enclosing function as an event named after the function.
+#define PROFILE_FUNCTION() PROFILE_SCOPE(static_cast<char const *>(__func__))
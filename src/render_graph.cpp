@@ -0,0 +1,1383 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "render_graph.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <numeric>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <range/v3/range/conversion.hpp>
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `VK_CHECK`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "barrier.hpp"
+#include "draw.hpp"
+#include "gpu_profiler.hpp"
+#include "macros.hpp"
+#include "setup.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::render_graph
+{
+namespace
+{
+/**
+ * A pass's use of a resource, whether declared as an attachment or otherwise.
+ */
+struct Use
+{
+	ResourceId resource;
+	Access access;
+	/// Whether the pass depends on the contents written by earlier passes.
+	bool reads_contents;
+	/// Whether the pass modifies the contents.
+	bool writes_contents;
+	/// Whether previous contents are discarded on first access, i.e. attachment not loaded.
+	bool discards_contents;
+};
+
+/**
+ * First and last position of a transient resource's uses in the execution order.
+ */
+struct Lifetime
+{
+	std::size_t first;
+	std::size_t last;
+};
+
+/**
+ * Memory requirements and lifetime of a transient resource to be placed in a memory block.
+ */
+struct AliasRequest
+{
+	VkDeviceSize size;
+	uint32_t memory_type_bits;
+	Lifetime lifetime;
+};
+
+/**
+ * Placement of transient resources into memory blocks, at offset 0 of their block.
+ */
+struct AliasAssignment
+{
+	/// Block index of each request.
+	std::vector<std::size_t> blocks;
+	/// Previous request occupying the same block, if any.
+	std::vector<std::optional<std::size_t>> predecessors;
+	std::vector<VkDeviceSize> block_sizes;
+	std::vector<uint32_t> block_memory_type_bits;
+};
+
+/**
+ * Synchronisation state of a resource as passes are walked in execution order.
+ */
+struct TrackedState
+{
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	/// Stages and access of the last write (or layout transition) that later access must wait on.
+	VkPipelineStageFlags2 write_stages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 write_access = VK_ACCESS_2_NONE;
+	/// Stages that have read since the last write, which the next write must wait on.
+	VkPipelineStageFlags2 read_stages = VK_PIPELINE_STAGE_2_NONE;
+	/// Scopes that the last write has already been made visible to.
+	std::vector<std::pair<VkPipelineStageFlags2, VkAccessFlags2>> visible;
+};
+
+/**
+ * Barriers per pass plus final transitions, prior to physical handles being known.
+ */
+struct BarrierPlan
+{
+	std::vector<Barriers> passes;
+	std::vector<std::vector<VkAttachmentStoreOp>> store_ops;
+	Barriers final_barriers;
+};
+
+VkImageAspectFlags aspect_of(VkFormat const format)
+{
+	switch (format)
+	{
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT;
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			// NOLINTNEXTLINE(*-signed-bitwise)
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		default:
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
+VkImageUsageFlags usage_of(Access const access)
+{
+	switch (access)
+	{
+		case Access::kColourAttachmentWrite:
+		case Access::kColourAttachmentReadWrite:
+			return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		case Access::kDepthAttachmentWrite:
+		case Access::kDepthAttachmentRead:
+			return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		case Access::kFragmentShaderSampled:
+		case Access::kComputeShaderSampled:
+			return VK_IMAGE_USAGE_SAMPLED_BIT;
+		case Access::kComputeShaderStorageRead:
+		case Access::kComputeShaderStorageWrite:
+		case Access::kComputeShaderStorageReadWrite:
+			return VK_IMAGE_USAGE_STORAGE_BIT;
+		case Access::kTransferRead:
+			return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		case Access::kTransferWrite:
+			return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		default:
+			return 0;
+	}
+}
+
+/**
+ * Convert a pass's attachments and declared uses into a uniform list, validating them.
+ */
+std::vector<Use> gather_uses(RenderGraph const & graph, Pass const & pass)
+{
+	std::vector<Use> uses;
+
+	auto const add_use = [&](Use const & use)
+	{
+		if (use.resource.value_of() >= graph.resources.size())
+			throw std::out_of_range{std::format(
+				"Pass {} uses unknown resource {}", pass.name, use.resource.value_of())};
+		if (std::ranges::contains(uses, use.resource, &Use::resource))
+			throw std::invalid_argument{std::format(
+				"Pass {} uses resource {} more than once",
+				pass.name,
+				graph.resources[use.resource.value_of()].name)};
+		uses.push_back(use);
+	};
+
+	auto const require_image = [&](ResourceId const resource)
+	{
+		if (resource.value_of() < graph.resources.size() &&
+			!graph.resources[resource.value_of()].image)
+			throw std::invalid_argument{std::format(
+				"Pass {} uses buffer {} as an attachment",
+				pass.name,
+				graph.resources[resource.value_of()].name)};
+	};
+
+	for (ColourAttachment const & attachment : pass.colour_attachments)
+	{
+		require_image(attachment.image);
+		bool const load = attachment.load_op == VK_ATTACHMENT_LOAD_OP_LOAD;
+		add_use(Use{
+			.resource = attachment.image,
+			.access = load ? Access::kColourAttachmentReadWrite : Access::kColourAttachmentWrite,
+			.reads_contents = load,
+			.writes_contents = true,
+			.discards_contents = !load});
+	}
+
+	if (pass.depth_attachment)
+	{
+		DepthAttachment const & attachment = *pass.depth_attachment;
+		require_image(attachment.image);
+		bool const load = attachment.load_op == VK_ATTACHMENT_LOAD_OP_LOAD;
+		add_use(Use{
+			.resource = attachment.image,
+			.access =
+				attachment.write ? Access::kDepthAttachmentWrite : Access::kDepthAttachmentRead,
+			.reads_contents = load,
+			.writes_contents = attachment.write,
+			.discards_contents = !load});
+	}
+
+	for (ResourceUse const & use : pass.uses)
+	{
+		VkAccessFlags2 const access = state_of(use.access).access;
+		add_use(Use{
+			.resource = use.resource,
+			.access = use.access,
+			.reads_contents = (access & ~barrier::kWriteAccess) != 0,
+			.writes_contents = (access & barrier::kWriteAccess) != 0,
+			.discards_contents = false});
+	}
+
+	return uses;
+}
+
+/**
+ * Flag passes to keep, walking backwards from passes with externally visible results.
+ *
+ * A pass is kept if it has side effects, writes an imported resource, or writes contents that a
+ * later kept pass reads.
+ */
+std::vector<bool> cull_passes(RenderGraph const & graph, std::span<std::vector<Use> const> uses)
+{
+	std::vector<bool> kept(graph.passes.size(), false);
+	// Whether the contents of each resource, as of the pass being visited, are read later.
+	std::vector<bool> live(graph.resources.size(), false);
+
+	for (std::size_t pass_idx = graph.passes.size(); pass_idx-- > 0;)
+	{
+		std::vector<Use> const & pass_uses = uses[pass_idx];
+		bool const keep = graph.passes[pass_idx].has_side_effects ||
+			std::ranges::any_of(
+				pass_uses,
+				[&](Use const & use)
+				{
+					return use.writes_contents &&
+						(graph.resources[use.resource.value_of()].imported ||
+						 live[use.resource.value_of()]);
+				});
+		if (!keep)
+			continue;
+
+		kept[pass_idx] = true;
+		// This pass produces the contents read later, so earlier writes are dead unless this pass
+		// itself reads them.
+		for (Use const & use : pass_uses)
+			if (use.writes_contents)
+				live[use.resource.value_of()] = false;
+		for (Use const & use : pass_uses)
+			if (use.reads_contents)
+				live[use.resource.value_of()] = true;
+	}
+
+	return kept;
+}
+
+/**
+ * Greedily place transient resources into memory blocks such that resources sharing a block have
+ * disjoint lifetimes and compatible memory types.
+ *
+ * Largest resources are placed first, so that smaller resources fill the gaps between them.
+ */
+AliasAssignment assign_aliases(std::span<AliasRequest const> const requests)
+{
+	std::vector<std::size_t> order(requests.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::ranges::stable_sort(
+		order, std::greater{}, [&](std::size_t const idx) { return requests[idx].size; });
+
+	AliasAssignment out{
+		.blocks = std::vector<std::size_t>(requests.size()),
+		.predecessors = std::vector<std::optional<std::size_t>>(requests.size()),
+		.block_sizes = {},
+		.block_memory_type_bits = {}};
+	std::vector<std::vector<std::size_t>> block_occupants;
+
+	auto const overlaps = [](Lifetime const & lhs, Lifetime const & rhs)
+	{ return lhs.first <= rhs.last && rhs.first <= lhs.last; };
+
+	for (std::size_t const request_idx : order)
+	{
+		AliasRequest const & request = requests[request_idx];
+
+		std::size_t block_idx = 0;
+		for (; block_idx < block_occupants.size(); ++block_idx)
+		{
+			if ((out.block_memory_type_bits[block_idx] & request.memory_type_bits) == 0)
+				continue;
+			if (std::ranges::none_of(
+					block_occupants[block_idx],
+					[&](std::size_t const occupant)
+					{ return overlaps(requests[occupant].lifetime, request.lifetime); }))
+				break;
+		}
+
+		if (block_idx == block_occupants.size())
+		{
+			block_occupants.emplace_back();
+			out.block_sizes.push_back(0);
+			out.block_memory_type_bits.push_back(request.memory_type_bits);
+		}
+
+		block_occupants[block_idx].push_back(request_idx);
+		out.blocks[request_idx] = block_idx;
+		out.block_sizes[block_idx] = std::max(out.block_sizes[block_idx], request.size);
+		out.block_memory_type_bits[block_idx] &= request.memory_type_bits;
+	}
+
+	// Within a block, each occupant must wait on the previous occupant's accesses.
+	for (std::vector<std::size_t> & occupants : block_occupants)
+	{
+		std::ranges::sort(
+			occupants, {}, [&](std::size_t const idx) { return requests[idx].lifetime.first; });
+		for (std::size_t occupant_idx = 1; occupant_idx < occupants.size(); ++occupant_idx)
+			out.predecessors[occupants[occupant_idx]] = occupants[occupant_idx - 1];
+	}
+
+	return out;
+}
+
+/**
+ * Append a barrier for an image, or merge into the global memory barrier for a buffer.
+ */
+void emit_barrier(
+	Barriers & barriers,
+	Resource const & resource,
+	ResourceId const resource_id,
+	VkPipelineStageFlags2 const src_stages,
+	VkAccessFlags2 const src_access,
+	ResourceState const & dst,
+	VkImageLayout const old_layout)
+{
+	ResourceState const src{.stages = src_stages, .access = src_access, .layout = old_layout};
+	if (resource.image)
+	{
+		barriers.images.push_back(barrier::image_barrier(
+			nullptr,  // Patched once physical images are known.
+			{.aspectMask = aspect_of(resource.image->format),
+			 .baseMipLevel = 0,
+			 .levelCount = VK_REMAINING_MIP_LEVELS,
+			 .baseArrayLayer = 0,
+			 .layerCount = VK_REMAINING_ARRAY_LAYERS},
+			src,
+			dst));
+		barriers.image_resources.push_back(resource_id);
+		return;
+	}
+	barrier::merge_memory_barrier(barriers.memory, src, dst);
+}
+
+/**
+ * Update tracked state for an access, emitting a barrier only if there is a hazard.
+ *
+ * - Layout transitions and writes wait on all prior reads and writes.
+ * - Reads wait on the last write, unless it has already been made visible to their scope.
+ * - Reads following reads in the same layout need no barrier.
+ */
+void apply_access(
+	Barriers & barriers,
+	Resource const & resource,
+	ResourceId const resource_id,
+	TrackedState & tracked,
+	ResourceState const & required,
+	Use const & use)
+{
+	bool const layout_change = resource.image && required.layout != tracked.layout;
+
+	if (layout_change || use.writes_contents)
+	{
+		VkPipelineStageFlags2 const src_stages = tracked.write_stages | tracked.read_stages;
+		if (layout_change || src_stages != VK_PIPELINE_STAGE_2_NONE)
+			emit_barrier(
+				barriers,
+				resource,
+				resource_id,
+				src_stages,
+				tracked.write_access,
+				required,
+				// Transitioning from undefined allows the implementation to discard contents.
+				use.discards_contents ? VK_IMAGE_LAYOUT_UNDEFINED : tracked.layout);
+
+		tracked.layout = required.layout;
+		tracked.write_stages = required.stages;
+		tracked.visible.clear();
+		if (use.writes_contents)
+		{
+			tracked.write_access = required.access & barrier::kWriteAccess;
+			tracked.read_stages = VK_PIPELINE_STAGE_2_NONE;
+		}
+		else
+		{
+			// The layout transition is the last write, already visible to this access.
+			tracked.write_access = VK_ACCESS_2_NONE;
+			tracked.read_stages = required.stages;
+			tracked.visible.emplace_back(required.stages, required.access);
+		}
+		return;
+	}
+
+	bool const is_visible = (required.stages == VK_PIPELINE_STAGE_2_NONE &&
+							 required.access == VK_ACCESS_2_NONE) ||
+		std::ranges::any_of(
+			tracked.visible,
+			[&](auto const & scope)
+			{
+				auto const [stages, access] = scope;
+				return (required.stages & ~stages) == 0 && (required.access & ~access) == 0;
+			});
+
+	if (tracked.write_stages != VK_PIPELINE_STAGE_2_NONE && !is_visible)
+	{
+		emit_barrier(
+			barriers,
+			resource,
+			resource_id,
+			tracked.write_stages,
+			tracked.write_access,
+			required,
+			tracked.layout);
+		tracked.visible.emplace_back(required.stages, required.access);
+	}
+	tracked.read_stages |= required.stages;
+}
+
+/**
+ * Walk kept passes in order, deriving barriers from each resource's tracked state.
+ *
+ * @param graph
+ * @param uses Per pass.
+ * @param execution_order Indices of kept passes.
+ * @param alias_predecessors Per resource, the transient resource previously occupying its memory.
+ * @return
+ */
+BarrierPlan plan_barriers(
+	RenderGraph const & graph,
+	std::span<std::vector<Use> const> const uses,
+	std::span<std::size_t const> const execution_order,
+	std::span<std::optional<ResourceId> const> const alias_predecessors)
+{
+	std::vector<TrackedState> tracked(graph.resources.size());
+	std::vector<bool> seen(graph.resources.size(), false);
+	for (std::size_t resource_idx = 0; resource_idx < graph.resources.size(); ++resource_idx)
+	{
+		Resource const & resource = graph.resources[resource_idx];
+		if (!resource.imported)
+			continue;
+		tracked[resource_idx].layout = resource.initial_state.layout;
+		tracked[resource_idx].write_stages = resource.initial_state.stages;
+		tracked[resource_idx].write_access = resource.initial_state.access;
+	}
+
+	BarrierPlan plan;
+
+	for (std::size_t order_idx = 0; order_idx < execution_order.size(); ++order_idx)
+	{
+		std::size_t const pass_idx = execution_order[order_idx];
+		Barriers & barriers = plan.passes.emplace_back();
+
+		for (Use const & use : uses[pass_idx])
+		{
+			std::size_t const resource_idx = use.resource.value_of();
+			Resource const & resource = graph.resources[resource_idx];
+
+			// Memory previously used by an aliased resource: wait for its accesses to complete.
+			if (!seen[resource_idx] && !resource.imported)
+			{
+				if (std::optional<ResourceId> const predecessor = alias_predecessors[resource_idx])
+				{
+					TrackedState const & previous = tracked[predecessor->value_of()];
+					tracked[resource_idx].write_stages =
+						previous.write_stages | previous.read_stages;
+					tracked[resource_idx].write_access = previous.write_access;
+				}
+			}
+			seen[resource_idx] = true;
+
+			apply_access(
+				barriers, resource, use.resource, tracked[resource_idx], state_of(use.access), use);
+		}
+
+		// Attachment contents need storing only if a later pass reads them before overwriting.
+		std::vector<VkAttachmentStoreOp> & store_ops = plan.store_ops.emplace_back();
+		Pass const & pass = graph.passes[pass_idx];
+		auto const store_op = [&](ResourceId const resource)
+		{
+			if (graph.resources[resource.value_of()].imported)
+				return VK_ATTACHMENT_STORE_OP_STORE;
+			for (std::size_t const later_pass_idx : execution_order.subspan(order_idx + 1))
+			{
+				auto const later_use =
+					std::ranges::find(uses[later_pass_idx], resource, &Use::resource);
+				if (later_use == uses[later_pass_idx].end())
+					continue;
+				return later_use->reads_contents ? VK_ATTACHMENT_STORE_OP_STORE
+												 : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			}
+			return VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		};
+		for (ColourAttachment const & attachment : pass.colour_attachments)
+			store_ops.push_back(store_op(attachment.image));
+		if (pass.depth_attachment)
+			store_ops.push_back(store_op(pass.depth_attachment->image));
+	}
+
+	for (std::size_t resource_idx = 0; resource_idx < graph.resources.size(); ++resource_idx)
+	{
+		Resource const & resource = graph.resources[resource_idx];
+		if (!resource.final_state)
+			continue;
+		apply_access(
+			plan.final_barriers,
+			resource,
+			ResourceId{static_cast<uint32_t>(resource_idx)},
+			tracked[resource_idx],
+			*resource.final_state,
+			Use{
+				.resource = ResourceId{static_cast<uint32_t>(resource_idx)},
+				.access = {},
+				.reads_contents = true,
+				.writes_contents = false,
+				.discards_contents = false});
+	}
+
+	return plan;
+}
+
+/**
+ * Set the physical image handle of all barriers on a resource.
+ */
+void patch_barriers(Barriers & barriers, ResourceId const resource, VkImage image)
+{
+	for (std::size_t barrier_idx = 0; barrier_idx < barriers.images.size(); ++barrier_idx)
+		if (barriers.image_resources[barrier_idx] == resource)
+			barriers.images[barrier_idx].image = image;
+}
+
+void populate_cmd_barriers(VkCommandBuffer command_buffer, Barriers const & barriers)
+{
+	barrier::populate_cmd_barriers(command_buffer, barriers.memory, barriers.images);
+}
+}  // namespace
+
+ResourceState state_of(Access const access)
+{
+	switch (access)
+	{
+		case Access::kColourAttachmentWrite:
+			return {
+				.stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+				.access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+				.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+		case Access::kColourAttachmentReadWrite:
+			return {
+				.stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+				.access =
+					VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+				.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+		case Access::kDepthAttachmentWrite:
+			return {
+				.stages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+					VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+				.access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+					VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+		case Access::kDepthAttachmentRead:
+			return {
+				.stages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+					VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+				.access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+				.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+		case Access::kFragmentShaderSampled:
+			return {
+				.stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+				.access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+				.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+		case Access::kComputeShaderSampled:
+			return {
+				.stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+				.access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+				.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+		case Access::kComputeShaderStorageRead:
+			return {
+				.stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+				.access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+				.layout = VK_IMAGE_LAYOUT_GENERAL};
+		case Access::kComputeShaderStorageWrite:
+			return {
+				.stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+				.access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+				.layout = VK_IMAGE_LAYOUT_GENERAL};
+		case Access::kComputeShaderStorageReadWrite:
+			return {
+				.stages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+				.access =
+					VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+				.layout = VK_IMAGE_LAYOUT_GENERAL};
+		case Access::kTransferRead:
+			return {
+				.stages = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+				.access = VK_ACCESS_2_TRANSFER_READ_BIT,
+				.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+		case Access::kTransferWrite:
+			return {
+				.stages = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+				.access = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+				.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+		case Access::kIndirectCommandRead:
+			return {
+				.stages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+				.access = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+				.layout = VK_IMAGE_LAYOUT_UNDEFINED};
+		case Access::kVertexAttributeRead:
+			return {
+				.stages = VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT,
+				.access = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT,
+				.layout = VK_IMAGE_LAYOUT_UNDEFINED};
+		case Access::kIndexRead:
+			return {
+				.stages = VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT,
+				.access = VK_ACCESS_2_INDEX_READ_BIT,
+				.layout = VK_IMAGE_LAYOUT_UNDEFINED};
+		case Access::kHostRead:
+			return {
+				.stages = VK_PIPELINE_STAGE_2_HOST_BIT,
+				.access = VK_ACCESS_2_HOST_READ_BIT,
+				.layout = VK_IMAGE_LAYOUT_UNDEFINED};
+	}
+	throw std::invalid_argument{"Unknown render graph access"};
+}
+
+ResourceId create_transient_image(RenderGraph & graph, std::string name, ImageDesc const desc)
+{
+	graph.resources.push_back(Resource{
+		.name = std::move(name),
+		.image = desc,
+		.imported = false,
+		.initial_state = {},
+		.final_state = std::nullopt});
+	return ResourceId{static_cast<uint32_t>(graph.resources.size() - 1)};
+}
+
+ResourceId import_image(
+	RenderGraph & graph,
+	std::string name,
+	ImageDesc const desc,
+	ResourceState const initial_state,
+	std::optional<ResourceState> const final_state)
+{
+	graph.resources.push_back(Resource{
+		.name = std::move(name),
+		.image = desc,
+		.imported = true,
+		.initial_state = initial_state,
+		.final_state = final_state});
+	return ResourceId{static_cast<uint32_t>(graph.resources.size() - 1)};
+}
+
+ResourceId import_buffer(
+	RenderGraph & graph,
+	std::string name,
+	ResourceState const initial_state,
+	std::optional<ResourceState> const final_state)
+{
+	graph.resources.push_back(Resource{
+		.name = std::move(name),
+		.image = std::nullopt,
+		.imported = true,
+		.initial_state = initial_state,
+		.final_state = final_state});
+	return ResourceId{static_cast<uint32_t>(graph.resources.size() - 1)};
+}
+
+void add_pass(RenderGraph & graph, Pass pass)
+{
+	graph.passes.push_back(std::move(pass));
+}
+
+CompiledRenderGraph compile_render_graph(
+	types::VulkanDevicePtr const & device, VkPhysicalDevice physical_device, RenderGraph graph)
+{
+	std::vector<std::vector<Use>> const uses =
+		graph.passes |
+		std::views::transform([&](Pass const & pass) { return gather_uses(graph, pass); }) |
+		ranges::to<std::vector>();
+
+	std::vector<bool> const kept = cull_passes(graph, uses);
+	std::vector<std::size_t> const execution_order =
+		std::views::iota(0UZ, graph.passes.size()) |
+		std::views::filter([&](std::size_t const pass_idx) { return kept[pass_idx]; }) |
+		ranges::to<std::vector>();
+
+	// Lifetimes and usage of transient images referenced by kept passes.
+	std::vector<std::optional<Lifetime>> lifetimes(graph.resources.size());
+	std::vector<VkImageUsageFlags> usages(graph.resources.size(), 0);
+	for (std::size_t order_idx = 0; order_idx < execution_order.size(); ++order_idx)
+	{
+		for (Use const & use : uses[execution_order[order_idx]])
+		{
+			std::size_t const resource_idx = use.resource.value_of();
+			if (graph.resources[resource_idx].imported)
+				continue;
+			std::optional<Lifetime> & lifetime = lifetimes[resource_idx];
+			lifetime = Lifetime{
+				.first = lifetime ? lifetime->first : order_idx, .last = order_idx};
+			usages[resource_idx] |= usage_of(use.access);
+		}
+	}
+
+	CompiledRenderGraph compiled{
+		.graph = {},
+		.passes = {},
+		.final_barriers = {},
+		.images = std::vector<VkImage>(graph.resources.size(), nullptr),
+		.image_views = std::vector<VkImageView>(graph.resources.size(), nullptr),
+		.buffers = std::vector<VkBuffer>(graph.resources.size(), nullptr),
+		.transient_memory = {},
+		.transient_images = {},
+		.transient_image_views = {},
+		.culled_pass_count = graph.passes.size() - execution_order.size(),
+		.transient_memory_size = 0,
+		.unaliased_transient_memory_size = 0};
+
+	// Create transient images, then place them in (shared) memory.
+	std::vector<std::size_t> transient_resources;
+	std::vector<AliasRequest> alias_requests;
+	for (std::size_t resource_idx = 0; resource_idx < graph.resources.size(); ++resource_idx)
+	{
+		if (!lifetimes[resource_idx])
+			continue;
+		ImageDesc const & desc = *graph.resources[resource_idx].image;
+
+		VkImageCreateInfo const image_create_info{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = desc.format,
+			.extent = {.width = desc.extent.width, .height = desc.extent.height, .depth = 1},
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = usages[resource_idx],
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.queueFamilyIndexCount = 0,
+			.pQueueFamilyIndices = nullptr,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+		VkImage image = nullptr;
+		VK_CHECK(
+			vkCreateImage(device.get(), &image_create_info, nullptr, &image),
+			std::format("Failed to create transient image {}", graph.resources[resource_idx].name));
+		compiled.transient_images.push_back(types::make_image_ptr(device, image));
+		compiled.images[resource_idx] = image;
+
+		VkMemoryRequirements memory_requirements;
+		vkGetImageMemoryRequirements(device.get(), image, &memory_requirements);
+
+		transient_resources.push_back(resource_idx);
+		alias_requests.push_back(AliasRequest{
+			.size = memory_requirements.size,
+			.memory_type_bits = memory_requirements.memoryTypeBits,
+			.lifetime = *lifetimes[resource_idx]});
+		compiled.unaliased_transient_memory_size += memory_requirements.size;
+	}
+
+	AliasAssignment const aliases = assign_aliases(alias_requests);
+
+	for (std::size_t block_idx = 0; block_idx < aliases.block_sizes.size(); ++block_idx)
+	{
+		VkMemoryAllocateInfo const memory_allocate_info{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.pNext = nullptr,
+			.allocationSize = aliases.block_sizes[block_idx],
+			.memoryTypeIndex = setup::choose_device_local_memory_type(
+				physical_device, aliases.block_memory_type_bits[block_idx])};
+		VkDeviceMemory memory = nullptr;
+		VK_CHECK(
+			vkAllocateMemory(device.get(), &memory_allocate_info, nullptr, &memory),
+			"Failed to allocate transient render graph memory");
+		compiled.transient_memory.push_back(types::make_device_memory_ptr(device, memory));
+		compiled.transient_memory_size += aliases.block_sizes[block_idx];
+	}
+
+	std::vector<std::optional<ResourceId>> alias_predecessors(graph.resources.size());
+	for (std::size_t request_idx = 0; request_idx < alias_requests.size(); ++request_idx)
+	{
+		std::size_t const resource_idx = transient_resources[request_idx];
+		ImageDesc const & desc = *graph.resources[resource_idx].image;
+
+		VK_CHECK(
+			vkBindImageMemory(
+				device.get(),
+				compiled.images[resource_idx],
+				compiled.transient_memory[aliases.blocks[request_idx]].get(),
+				0),
+			"Failed to bind transient image memory");
+
+		VkImageViewCreateInfo const image_view_create_info{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.image = compiled.images[resource_idx],
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = desc.format,
+			.components =
+				{VK_COMPONENT_SWIZZLE_IDENTITY,
+				 VK_COMPONENT_SWIZZLE_IDENTITY,
+				 VK_COMPONENT_SWIZZLE_IDENTITY,
+				 VK_COMPONENT_SWIZZLE_IDENTITY},
+			.subresourceRange = {aspect_of(desc.format), 0, 1, 0, 1}};
+		VkImageView image_view = nullptr;
+		VK_CHECK(
+			vkCreateImageView(device.get(), &image_view_create_info, nullptr, &image_view),
+			"Failed to create transient image view");
+		compiled.transient_image_views.push_back(types::make_image_view_ptr(device, image_view));
+		compiled.image_views[resource_idx] = image_view;
+
+		if (std::optional<std::size_t> const predecessor = aliases.predecessors[request_idx])
+			alias_predecessors[resource_idx] =
+				ResourceId{static_cast<uint32_t>(transient_resources[*predecessor])};
+	}
+
+	BarrierPlan plan = plan_barriers(graph, uses, execution_order, alias_predecessors);
+
+	for (std::size_t order_idx = 0; order_idx < execution_order.size(); ++order_idx)
+		compiled.passes.push_back(CompiledPass{
+			.pass_idx = execution_order[order_idx],
+			.barriers = std::move(plan.passes[order_idx]),
+			.store_ops = std::move(plan.store_ops[order_idx])});
+	compiled.final_barriers = std::move(plan.final_barriers);
+	compiled.graph = std::move(graph);
+
+	for (std::size_t const resource_idx : transient_resources)
+	{
+		ResourceId const resource{static_cast<uint32_t>(resource_idx)};
+		for (CompiledPass & pass : compiled.passes)
+			patch_barriers(pass.barriers, resource, compiled.images[resource_idx]);
+	}
+
+	return compiled;
+}
+
+void bind_imported_image(
+	CompiledRenderGraph & compiled,
+	ResourceId const resource,
+	VkImage image,
+	VkImageView image_view)
+{
+	if (!compiled.graph.resources.at(resource.value_of()).imported)
+		throw std::invalid_argument{"Cannot bind a transient render graph image"};
+
+	compiled.images[resource.value_of()] = image;
+	compiled.image_views[resource.value_of()] = image_view;
+	for (CompiledPass & pass : compiled.passes)
+		patch_barriers(pass.barriers, resource, image);
+	patch_barriers(compiled.final_barriers, resource, image);
+}
+
+void bind_imported_buffer(
+	CompiledRenderGraph & compiled, ResourceId const resource, VkBuffer buffer)
+{
+	if (!compiled.graph.resources.at(resource.value_of()).imported)
+		throw std::invalid_argument{"Cannot bind a transient render graph buffer"};
+	compiled.buffers[resource.value_of()] = buffer;
+}
+
+VkImageView image_view(CompiledRenderGraph const & compiled, ResourceId const resource)
+{
+	return compiled.image_views.at(resource.value_of());
+}
+
+VkBuffer buffer(CompiledRenderGraph const & compiled, ResourceId const resource)
+{
+	return compiled.buffers.at(resource.value_of());
+}
+
+ImageDesc const & image_desc(CompiledRenderGraph const & compiled, ResourceId const resource)
+{
+	return compiled.graph.resources.at(resource.value_of()).image.value();
+}
+
+void populate_cmd_render_graph(
+	VkCommandBuffer command_buffer,
+	CompiledRenderGraph const & compiled,
+	gpu_profiler::GpuProfiler * profiler)
+{
+	constexpr VkCommandBufferBeginInfo command_buffer_begin_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = nullptr};
+	VK_CHECK(
+		vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info),
+		"Failed to begin command buffer");
+
+	std::vector<VkRenderingAttachmentInfo> colour_attachments;
+
+	for (CompiledPass const & compiled_pass : compiled.passes)
+	{
+		populate_cmd_barriers(command_buffer, compiled_pass.barriers);
+
+		Pass const & pass = compiled.graph.passes[compiled_pass.pass_idx];
+		uint32_t const scope = profiler != nullptr
+			? profiler->begin_scope(command_buffer, pass.name)
+			: gpu_profiler::GpuProfiler::kUntimedScope;
+
+		if (pass.colour_attachments.empty() && !pass.depth_attachment)
+		{
+			if (pass.record)
+				pass.record(command_buffer, compiled);
+			if (profiler != nullptr)
+				profiler->end_scope(command_buffer, scope);
+			continue;
+		}
+
+		colour_attachments.clear();
+		for (std::size_t attachment_idx = 0; attachment_idx < pass.colour_attachments.size();
+			 ++attachment_idx)
+		{
+			ColourAttachment const & attachment = pass.colour_attachments[attachment_idx];
+			colour_attachments.push_back(VkRenderingAttachmentInfo{
+				.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+				.pNext = nullptr,
+				.imageView = image_view(compiled, attachment.image),
+				.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				.resolveMode = VK_RESOLVE_MODE_NONE,
+				.resolveImageView = nullptr,
+				.resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.loadOp = attachment.load_op,
+				.storeOp = compiled_pass.store_ops[attachment_idx],
+				.clearValue = {.color = attachment.clear_value}});
+		}
+
+		std::optional<VkRenderingAttachmentInfo> depth_attachment;
+		if (pass.depth_attachment)
+		{
+			DepthAttachment const & attachment = *pass.depth_attachment;
+			depth_attachment = VkRenderingAttachmentInfo{
+				.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+				.pNext = nullptr,
+				.imageView = image_view(compiled, attachment.image),
+				.imageLayout = state_of(
+								   attachment.write ? Access::kDepthAttachmentWrite
+													: Access::kDepthAttachmentRead)
+								   .layout,
+				.resolveMode = VK_RESOLVE_MODE_NONE,
+				.resolveImageView = nullptr,
+				.resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.loadOp = attachment.load_op,
+				.storeOp = compiled_pass.store_ops.back(),
+				.clearValue = {.depthStencil = {.depth = attachment.clear_depth, .stencil = 0}}};
+		}
+
+		VkExtent2D const extent =
+			image_desc(
+				compiled,
+				pass.colour_attachments.empty() ? pass.depth_attachment->image
+												: pass.colour_attachments.front().image)
+				.extent;
+
+		VkRenderingInfo const rendering_info{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.renderArea = {.offset = {.x = 0, .y = 0}, .extent = extent},
+			.layerCount = 1,
+			.viewMask = 0,
+			.colorAttachmentCount = static_cast<uint32_t>(colour_attachments.size()),
+			.pColorAttachments = colour_attachments.data(),
+			.pDepthAttachment = depth_attachment ? &*depth_attachment : nullptr,
+			.pStencilAttachment = nullptr};
+		vkCmdBeginRendering(command_buffer, &rendering_info);
+
+		VkViewport const viewport{
+			.x = 0,
+			.y = 0,
+			.width = static_cast<float>(extent.width),
+			.height = static_cast<float>(extent.height),
+			.minDepth = 0,
+			.maxDepth = 1};
+		vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+		VkRect2D const scissor{.offset = {0, 0}, .extent = extent};
+		vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+		if (pass.record)
+			pass.record(command_buffer, compiled);
+
+		vkCmdEndRendering(command_buffer);
+
+		if (profiler != nullptr)
+			profiler->end_scope(command_buffer, scope);
+	}
+
+	populate_cmd_barriers(command_buffer, compiled.final_barriers);
+
+	VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end command buffer");
+}
+
+namespace
+{
+std::vector<std::vector<Use>> gather_all_uses(RenderGraph const & graph)
+{
+	return graph.passes |
+		std::views::transform([&](Pass const & pass) { return gather_uses(graph, pass); }) |
+		ranges::to<std::vector>();
+}
+
+constexpr ImageDesc kTestImageDesc{.format = VK_FORMAT_R8G8B8A8_UNORM, .extent = {64, 64}};
+}  // namespace
+
+TEST_CASE("Cull render graph passes")
+{
+	RenderGraph graph;
+	ResourceId const swapchain =
+		import_image(graph, "swapchain", kTestImageDesc, kSwapchainAcquired, kPresentable);
+	ResourceId const scene = create_transient_image(graph, "scene", kTestImageDesc);
+	ResourceId const unused = create_transient_image(graph, "unused", kTestImageDesc);
+	ResourceId const overwritten = create_transient_image(graph, "overwritten", kTestImageDesc);
+	ResourceId const readback = import_buffer(graph, "readback");
+
+	// 0: Result never read.
+	add_pass(graph, {.name = "unused", .colour_attachments = {{.image = unused}}});
+	// 1: Result cleared by 2 before being read.
+	add_pass(graph, {.name = "overwritten", .colour_attachments = {{.image = overwritten}}});
+	// 2: Read by 4.
+	add_pass(graph, {.name = "overwrite", .colour_attachments = {{.image = overwritten}}});
+	// 3: Read by 4.
+	add_pass(graph, {.name = "scene", .colour_attachments = {{.image = scene}}});
+	// 4: Writes imported swapchain.
+	add_pass(
+		graph,
+		{.name = "composite",
+		 .colour_attachments = {{.image = swapchain}},
+		 .uses = {
+			 {.resource = scene, .access = Access::kFragmentShaderSampled},
+			 {.resource = overwritten, .access = Access::kFragmentShaderSampled}}});
+	// 5: Writes imported buffer.
+	add_pass(
+		graph,
+		{.name = "readback",
+		 .uses = {{.resource = readback, .access = Access::kTransferWrite}}});
+	// 6: Explicitly kept.
+	add_pass(
+		graph,
+		{.name = "side effects",
+		 .colour_attachments = {{.image = unused}},
+		 .has_side_effects = true});
+
+	std::vector<std::vector<Use>> const uses = gather_all_uses(graph);
+	CHECK(cull_passes(graph, uses) == std::vector{false, false, true, true, true, true, true});
+
+	SUBCASE("blending over loaded contents keeps the previous writer")
+	{
+		graph.passes[2].colour_attachments.front().load_op = VK_ATTACHMENT_LOAD_OP_LOAD;
+		CHECK(
+			cull_passes(graph, gather_all_uses(graph)) ==
+			std::vector{false, true, true, true, true, true, true});
+	}
+
+	SUBCASE("invalid uses")
+	{
+		add_pass(
+			graph,
+			{.name = "duplicate",
+			 .colour_attachments = {{.image = scene}},
+			 .uses = {{.resource = scene, .access = Access::kFragmentShaderSampled}}});
+		CHECK_THROWS_AS(gather_all_uses(graph), std::invalid_argument);
+
+		graph.passes.back() = {
+			.name = "buffer attachment", .colour_attachments = {{.image = readback}}};
+		CHECK_THROWS_AS(gather_all_uses(graph), std::invalid_argument);
+
+		graph.passes.back() = {
+			.name = "unknown", .colour_attachments = {{.image = ResourceId{100}}}};
+		CHECK_THROWS_AS(gather_all_uses(graph), std::out_of_range);
+	}
+}
+
+TEST_CASE("Alias transient render graph memory")
+{
+	constexpr uint32_t any_type = 0b11;
+
+	std::array const requests{
+		AliasRequest{.size = 100, .memory_type_bits = any_type, .lifetime = {0, 2}},
+		AliasRequest{.size = 50, .memory_type_bits = any_type, .lifetime = {1, 1}},
+		AliasRequest{.size = 80, .memory_type_bits = any_type, .lifetime = {2, 3}},
+		AliasRequest{.size = 120, .memory_type_bits = any_type, .lifetime = {3, 4}},
+		// Disjoint from all others, but incompatible memory type.
+		AliasRequest{.size = 10, .memory_type_bits = 0b100, .lifetime = {5, 5}}};
+
+	AliasAssignment const aliases = assign_aliases(requests);
+
+	// Largest placed first: 3 -> block 0; 0 is disjoint with 3 -> block 0; 2 overlaps 3 -> block 1;
+	// 1 overlaps 0 but not 2 -> block 1; 4 -> block 2.
+	CHECK(aliases.blocks == std::vector<std::size_t>{0, 1, 1, 0, 2});
+	CHECK(aliases.block_sizes == std::vector<VkDeviceSize>{120, 80, 10});
+	CHECK(aliases.block_memory_type_bits == std::vector<uint32_t>{any_type, any_type, 0b100});
+
+	CHECK(!aliases.predecessors[0].has_value());
+	CHECK(aliases.predecessors[3] == std::optional<std::size_t>{0});
+	CHECK(!aliases.predecessors[1].has_value());
+	CHECK(aliases.predecessors[2] == std::optional<std::size_t>{1});
+	CHECK(!aliases.predecessors[4].has_value());
+}
+
+TEST_CASE("Derive render graph barriers")
+{
+	RenderGraph graph;
+	ResourceId const swapchain =
+		import_image(graph, "swapchain", kTestImageDesc, kSwapchainAcquired, kPresentable);
+	ResourceId const scene = create_transient_image(graph, "scene", kTestImageDesc);
+	ResourceId const bloom = create_transient_image(graph, "bloom", kTestImageDesc);
+	ResourceId const commands = import_buffer(graph, "commands");
+
+	// 0
+	add_pass(
+		graph,
+		{.name = "cull",
+		 .uses = {{.resource = commands, .access = Access::kComputeShaderStorageWrite}}});
+	// 1
+	add_pass(
+		graph,
+		{.name = "scene",
+		 .colour_attachments = {{.image = scene}},
+		 .uses = {{.resource = commands, .access = Access::kIndirectCommandRead}}});
+	// 2
+	add_pass(
+		graph,
+		{.name = "bloom",
+		 .colour_attachments = {{.image = bloom}},
+		 .uses = {{.resource = scene, .access = Access::kFragmentShaderSampled}}});
+	// 3
+	add_pass(
+		graph,
+		{.name = "composite",
+		 .colour_attachments = {{.image = swapchain}},
+		 .uses = {
+			 {.resource = scene, .access = Access::kFragmentShaderSampled},
+			 {.resource = bloom, .access = Access::kFragmentShaderSampled}}});
+
+	std::vector<std::vector<Use>> const uses = gather_all_uses(graph);
+	std::array<std::size_t, 4> const execution_order{0, 1, 2, 3};
+	std::vector<std::optional<ResourceId>> const no_aliases(graph.resources.size());
+
+	BarrierPlan const plan = plan_barriers(graph, uses, execution_order, no_aliases);
+	REQUIRE(plan.passes.size() == 4);
+
+	// Host-written buffer: no prior device access to wait on.
+	CHECK(plan.passes[0].images.empty());
+	CHECK(!plan.passes[0].memory);
+
+	// Compute write -> indirect read, plus initial scene transition.
+	REQUIRE(plan.passes[1].memory);
+	CHECK(plan.passes[1].memory->srcStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+	CHECK(plan.passes[1].memory->srcAccessMask == VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+	CHECK(plan.passes[1].memory->dstStageMask == VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT);
+	CHECK(plan.passes[1].memory->dstAccessMask == VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+	REQUIRE(plan.passes[1].images.size() == 1);
+	CHECK(plan.passes[1].image_resources.front() == scene);
+	CHECK(plan.passes[1].images.front().oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+	CHECK(plan.passes[1].images.front().newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	CHECK(plan.passes[1].images.front().srcStageMask == VK_PIPELINE_STAGE_2_NONE);
+
+	// Scene attachment -> sampled, plus initial bloom transition.
+	REQUIRE(plan.passes[2].images.size() == 2);
+	CHECK(plan.passes[2].image_resources == std::vector{bloom, scene});
+	VkImageMemoryBarrier2 const & scene_to_sampled = plan.passes[2].images[1];
+	CHECK(scene_to_sampled.srcStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+	CHECK(scene_to_sampled.srcAccessMask == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+	CHECK(scene_to_sampled.dstStageMask == VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+	CHECK(scene_to_sampled.dstAccessMask == VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+	CHECK(scene_to_sampled.oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	CHECK(scene_to_sampled.newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	// Swapchain acquire and bloom attachment -> sampled, but scene already visible to sampling.
+	REQUIRE(plan.passes[3].images.size() == 2);
+	CHECK(plan.passes[3].image_resources == std::vector{swapchain, bloom});
+	VkImageMemoryBarrier2 const & acquire = plan.passes[3].images[0];
+	CHECK(acquire.srcStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+	CHECK(acquire.srcAccessMask == VK_ACCESS_2_NONE);
+	CHECK(acquire.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+	CHECK(acquire.newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+	// Swapchain to presentable.
+	REQUIRE(plan.final_barriers.images.size() == 1);
+	CHECK(plan.final_barriers.image_resources.front() == swapchain);
+	CHECK(plan.final_barriers.images.front().oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	CHECK(plan.final_barriers.images.front().newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	CHECK(!plan.final_barriers.memory);
+
+	// Scene and bloom are read later, swapchain is imported, so all are stored.
+	for (std::vector<VkAttachmentStoreOp> const & store_ops : plan.store_ops)
+		CHECK(std::ranges::all_of(
+			store_ops, [](auto const op) { return op == VK_ATTACHMENT_STORE_OP_STORE; }));
+
+	SUBCASE("aliased memory waits on the previous occupant")
+	{
+		// Bloom reuses the memory of a transient last used by the cull pass.
+		ResourceId const scratch = create_transient_image(graph, "scratch", kTestImageDesc);
+		graph.passes[0].colour_attachments.push_back({.image = scratch});
+		std::vector<std::optional<ResourceId>> aliases(graph.resources.size());
+		aliases[bloom.value_of()] = scratch;
+
+		BarrierPlan const aliased_plan =
+			plan_barriers(graph, gather_all_uses(graph), execution_order, aliases);
+
+		CHECK(aliased_plan.store_ops[0] == std::vector{VK_ATTACHMENT_STORE_OP_DONT_CARE});
+		REQUIRE(aliased_plan.passes[2].images.size() == 2);
+		VkImageMemoryBarrier2 const & bloom_first_use = aliased_plan.passes[2].images[0];
+		CHECK(bloom_first_use.srcStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+		CHECK(bloom_first_use.srcAccessMask == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+		CHECK(bloom_first_use.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+	}
+}
+
+TEST_CASE("Render a graph into a swapchain image")
+{
+	vulkandemo::LoggerPtr const logger =
+		vulkandemo::create_logger("Render a graph into a swapchain image");
+	types::SDLWindowPtr const window = setup::create_window("", 64, 64);
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		window,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+	types::VulkanSurfacePtr const surface = setup::create_surface(window, instance);
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{types::DesiredDeviceExtensionNameView{VK_KHR_SWAPCHAIN_EXTENSION_NAME}},
+		VK_QUEUE_GRAPHICS_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		surface);
+
+	bool const profile = gpu_profiler::supports_gpu_profiling(physical_device, queue_family_idx);
+
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE,
+		.dynamicRendering = VK_TRUE};
+	VkPhysicalDeviceVulkan12Features vulkan12_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = &vulkan13_features,
+		.hostQueryReset = static_cast<VkBool32>(profile)};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan12_features};
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{{types::AvailableDeviceExtensionNameView{VK_KHR_SWAPCHAIN_EXTENSION_NAME}}},
+		&features);
+
+	std::vector<VkSurfaceFormatKHR> const available_formats =
+		setup::filter_available_surface_formats(
+			logger,
+			physical_device,
+			surface,
+			{{VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_B8G8R8A8_UNORM}});
+	auto [swapchain, image_views] = setup::create_exclusive_double_buffer_swapchain_and_image_views(
+		logger, physical_device, device, surface, available_formats.at(0));
+	std::vector<VkImage> const swapchain_images = setup::get_swapchain_images(device, swapchain);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{1});
+	VkCommandBuffer command_buffer = command_buffers->front();
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	ImageDesc const desc{
+		.format = available_formats.at(0).format, .extent = setup::window_drawable_size(window)};
+
+	RenderGraph graph;
+	ResourceId const swapchain_image =
+		import_image(graph, "swapchain", desc, kSwapchainAcquired, kPresentable);
+	// Chain of copies, such that first and last have disjoint lifetimes and can share memory.
+	std::array const chain{
+		create_transient_image(graph, "chain 0", desc),
+		create_transient_image(graph, "chain 1", desc),
+		create_transient_image(graph, "chain 2", desc)};
+	ResourceId const unused = create_transient_image(graph, "unused", desc);
+
+	add_pass(graph, {.name = "unused", .colour_attachments = {{.image = unused}}});
+	add_pass(
+		graph,
+		{.name = "clear",
+		 .colour_attachments = {{.image = chain[0], .clear_value = {.float32 = {0, 1, 0, 1}}}}});
+	for (std::size_t link = 0; link + 1 < chain.size(); ++link)
+	{
+		ResourceId const src = chain[link];
+		ResourceId const dst = chain[link + 1];
+		add_pass(
+			graph,
+			{.name = std::format("copy {}", link),
+			 .uses =
+				 {{.resource = src, .access = Access::kTransferRead},
+				  {.resource = dst, .access = Access::kTransferWrite}},
+			 .record =
+				 [src, dst, desc](VkCommandBuffer cmd, CompiledRenderGraph const & compiled)
+			 {
+				 VkImageCopy const region{
+					 .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+					 .srcOffset = {0, 0, 0},
+					 .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+					 .dstOffset = {0, 0, 0},
+					 .extent = {desc.extent.width, desc.extent.height, 1}};
+				 vkCmdCopyImage(
+					 cmd,
+					 compiled.images[src.value_of()],
+					 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					 compiled.images[dst.value_of()],
+					 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					 1,
+					 &region);
+			 }});
+	}
+	add_pass(
+		graph,
+		{.name = "composite",
+		 .colour_attachments = {{.image = swapchain_image}},
+		 .uses = {{.resource = chain.back(), .access = Access::kFragmentShaderSampled}}});
+
+	CompiledRenderGraph compiled = compile_render_graph(device, physical_device, std::move(graph));
+
+	CHECK(compiled.culled_pass_count == 1);
+	CHECK(compiled.passes.size() == 4);
+	CHECK(compiled.transient_images.size() == 3);
+	CHECK(compiled.transient_memory.size() == 2);
+	CHECK(compiled.transient_memory_size < compiled.unaliased_transient_memory_size);
+
+	auto const image_available_semaphore = setup::create_semaphore(device);
+	auto const maybe_image_idx =
+		draw::acquire_next_swapchain_image(device, swapchain, image_available_semaphore);
+	REQUIRE(maybe_image_idx);
+	auto const image_idx = maybe_image_idx.value();	 // NOLINT(bugprone-unchecked-optional-access)
+
+	bind_imported_image(
+		compiled, swapchain_image, swapchain_images.at(image_idx), image_views.at(image_idx).get());
+	CHECK(compiled.final_barriers.images.front().image == swapchain_images.at(image_idx));
+
+	std::optional<gpu_profiler::GpuProfiler> profiler;
+	if (profile)
+	{
+		profiler.emplace(device, physical_device, queue_family_idx, 1);
+		profiler->begin_frame(0);
+	}
+
+	populate_cmd_render_graph(command_buffer, compiled, profiler ? &*profiler : nullptr);
+	draw::submit_command_buffer(queue, command_buffer, image_available_semaphore, nullptr);
+	VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+
+	if (profiler)
+	{
+		// Collects the frame just rendered.
+		profiler->begin_frame(0);
+		std::vector<std::string> const timed_passes =
+			profiler->stats() |
+			std::views::transform(&gpu_profiler::ScopeStats::name) |
+			ranges::to<std::vector>();
+		CHECK(timed_passes == std::vector<std::string>{"clear", "copy 0", "copy 1", "composite"});
+		CHECK(profiler->last_frame_ms());
+	}
+}
+}  // namespace vulkandemo::render_graph
@@ -0,0 +1,359 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include <strong_type/equality.hpp>
+#include <strong_type/ordered.hpp>
+#include <strong_type/regular.hpp>
+#include <strong_type/type.hpp>
+
+#include "gpu_profiler.hpp"
+#include "types.hpp"
+
+/**
+ * Frame render graph.
+ *
+ * Passes declare the images and buffers they read and write. Compiling the graph culls passes
+ * whose results are never consumed, derives the minimal set of synchronization2 barriers and image
+ * layout transitions between the remaining passes, and allocates transient images such that those
+ * with non-overlapping lifetimes share memory.
+ *
+ * Passes execute in declaration order, which defines the dependencies between them: a pass reads
+ * the contents written by the most recent earlier pass that wrote the resource.
+ *
+ * Graphics passes render with dynamic rendering (VkRenderingInfo), so the device must be created
+ * with the `dynamicRendering` and `synchronization2` features of VkPhysicalDeviceVulkan13Features
+ * enabled, and graphics pipelines created with VkPipelineRenderingCreateInfo.
+ */
+namespace vulkandemo::render_graph
+{
+using ResourceId = strong::
+	type<uint32_t, struct TagForRenderGraphResourceId, strong::regular, strong::strongly_ordered>;
+
+/**
+ * How a pass uses a resource. Determines the pipeline stages, access types and image layout
+ * that barriers must synchronise with.
+ */
+enum class Access : uint8_t
+{
+	/// Colour attachment, with previous contents cleared or discarded.
+	kColourAttachmentWrite,
+	/// Colour attachment, with previous contents loaded, e.g. for blending over.
+	kColourAttachmentReadWrite,
+	/// Depth attachment, tested and written.
+	kDepthAttachmentWrite,
+	/// Depth attachment, tested only.
+	kDepthAttachmentRead,
+	kFragmentShaderSampled,
+	kComputeShaderSampled,
+	kComputeShaderStorageRead,
+	kComputeShaderStorageWrite,
+	kComputeShaderStorageReadWrite,
+	kTransferRead,
+	kTransferWrite,
+	kIndirectCommandRead,
+	kVertexAttributeRead,
+	kIndexRead,
+	kHostRead
+};
+
+/**
+ * Synchronisation scope of a resource at a point in the frame.
+ *
+ * Layout is ignored for buffers.
+ */
+struct ResourceState
+{
+	VkPipelineStageFlags2 stages;
+	VkAccessFlags2 access;
+	VkImageLayout layout;
+};
+
+/// State of a swapchain image once acquired, given the acquire semaphore is waited on at the
+/// colour attachment output stage, see draw::submit_command_buffer.
+inline constexpr ResourceState kSwapchainAcquired{
+	.stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+	.access = VK_ACCESS_2_NONE,
+	.layout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+/// Final state of a swapchain image that is to be presented.
+inline constexpr ResourceState kPresentable{
+	.stages = VK_PIPELINE_STAGE_2_NONE,
+	.access = VK_ACCESS_2_NONE,
+	.layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
+
+/**
+ * Resource state required by an access.
+ *
+ * @param access
+ * @return
+ */
+ResourceState state_of(Access access);
+
+/**
+ * Format and size of a 2D, single mip, single layer image.
+ */
+struct ImageDesc
+{
+	VkFormat format;
+	VkExtent2D extent;
+};
+
+struct ColourAttachment
+{
+	ResourceId image;
+	VkAttachmentLoadOp load_op = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	VkClearColorValue clear_value{};
+};
+
+struct DepthAttachment
+{
+	ResourceId image;
+	VkAttachmentLoadOp load_op = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	float clear_depth = 1.0F;
+	/// Whether depth is written, or only tested.
+	bool write = true;
+};
+
+/**
+ * Use of a resource other than as an attachment.
+ */
+struct ResourceUse
+{
+	ResourceId resource;
+	Access access;
+};
+
+struct CompiledRenderGraph;
+
+/**
+ * Callback to record the commands of a pass.
+ *
+ * For passes with attachments, this is called within a dynamic render pass, with viewport and
+ * scissor set to cover the attachments. The compiled graph is provided so that physical resource
+ * handles can be looked up, see image_view and buffer.
+ */
+using PassRecorder =
+	std::function<void(VkCommandBuffer command_buffer, CompiledRenderGraph const & graph)>;
+
+struct Pass
+{
+	std::string name;
+	std::vector<ColourAttachment> colour_attachments;
+	std::optional<DepthAttachment> depth_attachment;
+	/// Non-attachment uses. Each resource may appear at most once per pass, including attachments.
+	std::vector<ResourceUse> uses;
+	/// Never cull this pass, e.g. if its results are observed outside of the graph.
+	bool has_side_effects = false;
+	PassRecorder record;
+};
+
+/**
+ * Declaration of a resource.
+ */
+struct Resource
+{
+	std::string name;
+	/// Description of an image, or empty for a buffer.
+	std::optional<ImageDesc> image;
+	/// Whether the physical resource is provided by the caller, rather than owned by the graph.
+	bool imported;
+	/// State of an imported resource before the graph executes.
+	ResourceState initial_state;
+	/// State an imported resource must be left in, if any. Passes writing imported resources are
+	/// never culled.
+	std::optional<ResourceState> final_state;
+};
+
+/**
+ * Declared resources and passes, prior to compilation.
+ */
+struct RenderGraph
+{
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+};
+
+/**
+ * Declare an image owned by the graph, whose contents do not persist across executions.
+ *
+ * Usage flags are derived from the image's accesses.
+ *
+ * @param graph
+ * @param name
+ * @param desc
+ * @return
+ */
+ResourceId create_transient_image(RenderGraph & graph, std::string name, ImageDesc desc);
+
+/**
+ * Declare an image provided by the caller, see bind_imported_image.
+ *
+ * @param graph
+ * @param name
+ * @param desc
+ * @param initial_state
+ * @param final_state
+ * @return
+ */
+ResourceId import_image(
+	RenderGraph & graph,
+	std::string name,
+	ImageDesc desc,
+	ResourceState initial_state,
+	std::optional<ResourceState> final_state = std::nullopt);
+
+/**
+ * Declare a buffer provided by the caller, see bind_imported_buffer.
+ *
+ * @param graph
+ * @param name
+ * @param initial_state Defaults to no prior device access, e.g. written by the host before submit.
+ * @param final_state
+ * @return
+ */
+ResourceId import_buffer(
+	RenderGraph & graph,
+	std::string name,
+	ResourceState initial_state = {},
+	std::optional<ResourceState> final_state = std::nullopt);
+
+/**
+ * Append a pass.
+ *
+ * @param graph
+ * @param pass
+ */
+void add_pass(RenderGraph & graph, Pass pass);
+
+/**
+ * Barriers recorded as a single vkCmdPipelineBarrier2.
+ *
+ * Buffer hazards are merged into a single global memory barrier, which is no less efficient than
+ * per-buffer barriers on current drivers.
+ */
+struct Barriers
+{
+	std::vector<VkImageMemoryBarrier2> images;
+	/// Resource of each image barrier, to patch imported image handles.
+	std::vector<ResourceId> image_resources;
+	std::optional<VkMemoryBarrier2> memory;
+};
+
+struct CompiledPass
+{
+	/// Index into RenderGraph::passes.
+	std::size_t pass_idx;
+	Barriers barriers;
+	/// Store op of each colour attachment then depth attachment. Contents not read by later
+	/// passes, nor imported, are discarded.
+	std::vector<VkAttachmentStoreOp> store_ops;
+};
+
+/**
+ * Render graph ready for (repeated) execution.
+ *
+ * Transient resources are owned by the compiled graph. Imported resources must be bound before
+ * each execution.
+ */
+struct CompiledRenderGraph
+{
+	RenderGraph graph;
+	/// Passes that survived culling, in execution order.
+	std::vector<CompiledPass> passes;
+	/// Transitions of imported resources to their final states, after the last pass.
+	Barriers final_barriers;
+
+	/// Physical handles per resource, indexed by ResourceId.
+	std::vector<VkImage> images;
+	std::vector<VkImageView> image_views;
+	std::vector<VkBuffer> buffers;
+
+	std::vector<types::VulkanDeviceMemoryPtr> transient_memory;
+	std::vector<types::VulkanImagePtr> transient_images;
+	std::vector<types::VulkanImageViewPtr> transient_image_views;
+
+	std::size_t culled_pass_count;
+	/// Bytes allocated for transient images.
+	VkDeviceSize transient_memory_size;
+	/// Bytes that would be required for transient images without aliasing.
+	VkDeviceSize unaliased_transient_memory_size;
+};
+
+/**
+ * Compile a graph: cull passes, allocate and alias transient images and derive barriers.
+ *
+ * Compilation allocates device memory, so should be done once, then repeated only when the graph
+ * changes, e.g. on resize.
+ *
+ * @param device
+ * @param physical_device To choose memory types for transient images.
+ * @param graph
+ * @return
+ */
+CompiledRenderGraph compile_render_graph(
+	types::VulkanDevicePtr const & device, VkPhysicalDevice physical_device, RenderGraph graph);
+
+/**
+ * Provide the physical image for an imported image, e.g. the acquired swapchain image.
+ *
+ * @param compiled
+ * @param resource
+ * @param image
+ * @param image_view Required if used as an attachment.
+ */
+void bind_imported_image(
+	CompiledRenderGraph & compiled, ResourceId resource, VkImage image, VkImageView image_view);
+
+/**
+ * Provide the physical buffer for an imported buffer.
+ *
+ * @param compiled
+ * @param resource
+ * @param buffer
+ */
+void bind_imported_buffer(CompiledRenderGraph & compiled, ResourceId resource, VkBuffer buffer);
+
+/**
+ * @param compiled
+ * @param resource
+ * @return View of the whole image.
+ */
+VkImageView image_view(CompiledRenderGraph const & compiled, ResourceId resource);
+
+/**
+ * @param compiled
+ * @param resource
+ * @return
+ */
+VkBuffer buffer(CompiledRenderGraph const & compiled, ResourceId resource);
+
+/**
+ * @param compiled
+ * @param resource
+ * @return
+ */
+ImageDesc const & image_desc(CompiledRenderGraph const & compiled, ResourceId resource);
+
+/**
+ * Populate a command buffer with all passes of a compiled graph, and barriers between them.
+ *
+ * Begins and ends the command buffer, so it must be the only content of the command buffer.
+ *
+ * @param command_buffer
+ * @param compiled
+ * @param profiler Optional profiler to time each pass with, as a scope named after the pass.
+ */
+void populate_cmd_render_graph(
+	VkCommandBuffer command_buffer,
+	CompiledRenderGraph const & compiled,
+	gpu_profiler::GpuProfiler * profiler = nullptr);
+}  // namespace vulkandemo::render_graph
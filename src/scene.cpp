@@ -0,0 +1,543 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#include "scene.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner) for `logger`
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "bench.hpp"
+#include "draw.hpp"
+#include "maths.hpp"
+#include "parallel.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::scene
+{
+namespace
+{
+/**
+ * Update root slots `[begin, end)`.
+ *
+ * @return Number of slots recomputed.
+ */
+std::size_t update_roots(
+	SceneGraph & graph,
+	std::size_t const begin,
+	std::size_t const end,
+	std::span<maths::Mat4> const instances)
+{
+	std::size_t count = 0;
+	for (std::size_t slot = begin; slot < end; ++slot)
+	{
+		if (graph.dirty[slot] == 0)
+			continue;
+		graph.world_transforms[slot] = graph.local_transforms[slot];
+		if (!instances.empty())
+			instances[slot] = graph.world_transforms[slot];
+		++count;
+	}
+	return count;
+}
+
+/**
+ * Update non-root slots `[begin, end)`, all of the same depth, whose parents are up to date.
+ *
+ * Dirty flags are inherited from parents, then dirty slots are compacted without branching so
+ * that matrix products run over a dense list.
+ *
+ * @return Number of slots recomputed.
+ */
+std::size_t update_descendants(
+	SceneGraph & graph,
+	std::size_t const begin,
+	std::size_t const end,
+	std::span<maths::Mat4> const instances)
+{
+	std::array<uint32_t, kChunkSize> dirty_slots;  // NOLINT(*-member-init) written before read
+	std::size_t total = 0;
+	for (std::size_t batch_begin = begin; batch_begin < end; batch_begin += kChunkSize)
+	{
+		std::size_t const batch_end = std::min(end, batch_begin + kChunkSize);
+		std::size_t count = 0;
+		for (std::size_t slot = batch_begin; slot < batch_end; ++slot)
+		{
+			auto const dirty =
+				static_cast<uint8_t>(graph.dirty[slot] | graph.dirty[graph.parent_slots[slot]]);
+			graph.dirty[slot] = dirty;
+			dirty_slots[count] = static_cast<uint32_t>(slot);
+			count += dirty;
+		}
+
+		std::span<uint32_t const> const slots = std::span{dirty_slots}.first(count);
+		for (uint32_t const slot : slots)
+			graph.world_transforms[slot] =
+				graph.world_transforms[graph.parent_slots[slot]] * graph.local_transforms[slot];
+		if (!instances.empty())
+			for (uint32_t const slot : slots)
+				instances[slot] = graph.world_transforms[slot];
+		total += count;
+	}
+	return total;
+}
+
+std::size_t update_world_transforms_impl(
+	SceneGraph & graph, std::span<maths::Mat4> const instances, parallel::ThreadPool * const pool)
+{
+	if (!instances.empty() && instances.size() < graph.parent_slots.size())
+		throw std::invalid_argument{std::format(
+			"Instance buffer of {} transforms is too small for {} nodes",
+			instances.size(),
+			graph.parent_slots.size())};
+
+	std::size_t const level_count = graph.level_offsets.size() - 1;
+	std::size_t updated = 0;
+
+	for (std::size_t level = graph.first_dirty_level; level < level_count; ++level)
+	{
+		std::size_t const level_begin = graph.level_offsets[level];
+		std::size_t const level_end = graph.level_offsets[level + 1];
+		auto const update = [&](std::size_t const begin, std::size_t const end)
+		{
+			return level == 0 ? update_roots(graph, begin, end, instances)
+							  : update_descendants(graph, begin, end, instances);
+		};
+
+		if (pool == nullptr || level_end - level_begin <= kChunkSize)
+		{
+			updated += update(level_begin, level_end);
+			continue;
+		}
+
+		std::atomic<std::size_t> level_updated = 0;
+		parallel::for_each_chunk(
+			*pool,
+			level_end - level_begin,
+			kChunkSize,
+			[&](std::size_t, std::size_t const begin, std::size_t const end)
+			{
+				level_updated.fetch_add(
+					update(level_begin + begin, level_begin + end), std::memory_order_relaxed);
+			});
+		updated += level_updated.load(std::memory_order_relaxed);
+	}
+
+	if (graph.first_dirty_level < level_count)
+		std::fill(
+			graph.dirty.begin() +
+				static_cast<std::ptrdiff_t>(graph.level_offsets[graph.first_dirty_level]),
+			graph.dirty.end(),
+			uint8_t{0});
+	graph.first_dirty_level = level_count;
+
+	return updated;
+}
+}  // namespace
+
+SceneGraph create_scene_graph(
+	std::span<uint32_t const> const parents, std::span<maths::Mat4 const> const local_transforms)
+{
+	if (parents.size() != local_transforms.size())
+		throw std::invalid_argument{"Scene graph parents and local transforms differ in length"};
+
+	std::size_t const node_count = parents.size();
+
+	// Children of each node as a compressed list, in creation order.
+	std::vector<uint32_t> child_offsets(node_count + 1, 0);
+	for (std::size_t node = 0; node < node_count; ++node)
+	{
+		uint32_t const parent = parents[node];
+		if (parent == kNoParent)
+			continue;
+		if (parent >= node)
+			throw std::invalid_argument{
+				std::format("Parent {} of scene graph node {} does not precede it", parent, node)};
+		++child_offsets[parent + 1];
+	}
+	std::partial_sum(child_offsets.begin(), child_offsets.end(), child_offsets.begin());
+	std::vector<uint32_t> children(child_offsets.back());
+	{
+		std::vector<uint32_t> next_child{child_offsets.begin(), child_offsets.end() - 1};
+		for (std::size_t node = 0; node < node_count; ++node)
+			if (parents[node] != kNoParent)
+				children[next_child[parents[node]]++] = static_cast<uint32_t>(node);
+	}
+
+	// Breadth first order, so each level is contiguous and each node's children are adjacent.
+	std::vector<uint32_t> slot_nodes;
+	slot_nodes.reserve(node_count);
+	for (std::size_t node = 0; node < node_count; ++node)
+		if (parents[node] == kNoParent)
+			slot_nodes.push_back(static_cast<uint32_t>(node));
+
+	SceneGraph graph{
+		.parent_slots = std::vector<uint32_t>(node_count),
+		.local_transforms = std::vector<maths::Mat4>(node_count),
+		.world_transforms = std::vector<maths::Mat4>(node_count, maths::kIdentity),
+		.dirty = std::vector<uint8_t>(node_count, 1),
+		.level_offsets = {0},
+		.node_slots = std::vector<uint32_t>(node_count),
+		.first_dirty_level = 0};
+
+	for (std::size_t level_begin = 0; level_begin < slot_nodes.size();)
+	{
+		std::size_t const level_end = slot_nodes.size();
+		graph.level_offsets.push_back(level_end);
+		for (std::size_t slot = level_begin; slot < level_end; ++slot)
+		{
+			uint32_t const node = slot_nodes[slot];
+			slot_nodes.insert(
+				slot_nodes.end(),
+				children.begin() + static_cast<std::ptrdiff_t>(child_offsets[node]),
+				children.begin() + static_cast<std::ptrdiff_t>(child_offsets[node + 1]));
+		}
+		level_begin = level_end;
+	}
+
+	for (std::size_t slot = 0; slot < node_count; ++slot)
+		graph.node_slots[slot_nodes[slot]] = static_cast<uint32_t>(slot);
+
+	for (std::size_t slot = 0; slot < node_count; ++slot)
+	{
+		uint32_t const node = slot_nodes[slot];
+		uint32_t const parent = parents[node];
+		graph.parent_slots[slot] = parent == kNoParent ? kNoParent : graph.node_slots[parent];
+		graph.local_transforms[slot] = local_transforms[node];
+	}
+
+	return graph;
+}
+
+InstanceTransforms create_instance_transforms(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx const memory_type_idx,
+	std::size_t const node_count)
+{
+	auto [buffer, memory, mapped] = draw::create_exclusive_mapped_buffer_and_memory(
+		device,
+		memory_type_idx,
+		std::max(node_count, 1UZ) * sizeof(maths::Mat4),
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+	return InstanceTransforms{
+		.buffer = std::move(buffer),
+		.memory = std::move(memory),
+		.mapped_transforms = std::span{
+			// NOLINTNEXTLINE(*-reinterpret-cast)
+			reinterpret_cast<maths::Mat4 *>(mapped.data()),
+			node_count}};
+}
+
+void set_local_transform(
+	SceneGraph & graph, uint32_t const node, maths::Mat4 const & local_transform)
+{
+	uint32_t const slot = graph.node_slots.at(node);
+	graph.local_transforms[slot] = local_transform;
+	graph.dirty[slot] = 1;
+
+	auto const level = static_cast<std::size_t>(
+		std::ranges::upper_bound(graph.level_offsets, std::size_t{slot}) -
+		graph.level_offsets.begin() - 1);
+	graph.first_dirty_level = std::min(graph.first_dirty_level, level);
+}
+
+maths::Mat4 const & world_transform(SceneGraph const & graph, uint32_t const node)
+{
+	return graph.world_transforms[graph.node_slots.at(node)];
+}
+
+std::size_t update_world_transforms(SceneGraph & graph, std::span<maths::Mat4> const instances)
+{
+	return update_world_transforms_impl(graph, instances, nullptr);
+}
+
+std::size_t update_world_transforms(
+	SceneGraph & graph, std::span<maths::Mat4> const instances, parallel::ThreadPool & pool)
+{
+	return update_world_transforms_impl(graph, instances, &pool);
+}
+
+namespace
+{
+maths::Mat4 translation(float const x, float const y, float const z)
+{
+	return maths::translation({x, y, z});
+}
+
+/**
+ * Rotation about z, uniform scale and translation.
+ */
+maths::Mat4 random_transform(std::mt19937 & rng)
+{
+	std::uniform_real_distribution<float> angle{-3.0F, 3.0F};
+	std::uniform_real_distribution<float> scale{0.9F, 1.1F};
+	std::uniform_real_distribution<float> offset{-1.0F, 1.0F};
+	float const theta = angle(rng);
+	float const factor = scale(rng);
+	maths::Vec3 const translation{offset(rng), offset(rng), offset(rng)};
+	return maths::compose(
+		translation, maths::from_axis_angle({0, 0, 1}, theta), {factor, factor, factor});
+}
+
+/**
+ * Random recursive tree, i.e. each node parented to a uniformly chosen earlier node, giving a
+ * depth logarithmic in node count.
+ */
+std::vector<uint32_t> make_random_parents(
+	std::size_t const node_count, std::size_t const root_count)
+{
+	std::mt19937 rng{42};  // NOLINT(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+	std::vector<uint32_t> parents(node_count, kNoParent);
+	for (std::size_t node = root_count; node < node_count; ++node)
+		parents[node] = std::uniform_int_distribution<uint32_t>{
+			0, static_cast<uint32_t>(node - 1)}(rng);
+	return parents;
+}
+
+std::vector<maths::Mat4> make_random_transforms(std::size_t const node_count)
+{
+	std::mt19937 rng{7};  // NOLINT(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+	std::vector<maths::Mat4> transforms(node_count);
+	for (maths::Mat4 & transform : transforms)
+		transform = random_transform(rng);
+	return transforms;
+}
+
+/**
+ * Pointer based tree, updated recursively from each root, as a baseline for comparison.
+ */
+struct BaselineNode
+{
+	maths::Mat4 local;
+	maths::Mat4 world;
+	std::vector<BaselineNode *> children;
+};
+
+void update_baseline(BaselineNode & node, maths::Mat4 const & parent_world)
+{
+	node.world = parent_world * node.local;
+	for (BaselineNode * child : node.children)
+		update_baseline(*child, node.world);
+}
+}  // namespace
+
+TEST_CASE("Propagate dirty transforms through a scene graph")
+{
+	// 0 -> 2 -> 3 -> 5
+	//        -> 4
+	// 1
+	std::vector<uint32_t> const parents{kNoParent, kNoParent, 0, 2, 2, 3};
+	std::vector<maths::Mat4> const local_transforms{
+		translation(1, 0, 0),
+		translation(0, 5, 0),
+		translation(0, 1, 0),
+		translation(0, 0, 1),
+		translation(2, 0, 0),
+		translation(1, 1, 1)};
+
+	SceneGraph graph = create_scene_graph(parents, local_transforms);
+	CHECK(graph.level_offsets == std::vector<std::size_t>{0, 2, 3, 5, 6});
+
+	std::vector<maths::Mat4> instances(parents.size(), maths::kIdentity);
+	CHECK(update_world_transforms(graph, instances) == parents.size());
+	CHECK(world_transform(graph, 0) == translation(1, 0, 0));
+	CHECK(world_transform(graph, 1) == translation(0, 5, 0));
+	CHECK(world_transform(graph, 3) == translation(1, 1, 1));
+	CHECK(world_transform(graph, 4) == translation(3, 1, 0));
+	CHECK(world_transform(graph, 5) == translation(2, 2, 2));
+	for (uint32_t node = 0; node < parents.size(); ++node)
+		CHECK(instances[graph.node_slots[node]] == world_transform(graph, node));
+
+	SUBCASE("clean graph is not recomputed")
+	{
+		CHECK(update_world_transforms(graph, instances) == 0);
+	}
+
+	SUBCASE("only dirty subtree is recomputed")
+	{
+		set_local_transform(graph, 3, translation(0, 0, 2));
+		// Stale instance, to check only recomputed slots are written.
+		instances[graph.node_slots[1]] = maths::kIdentity;
+
+		CHECK(update_world_transforms(graph, instances) == 2);
+		CHECK(world_transform(graph, 3) == translation(1, 1, 2));
+		CHECK(world_transform(graph, 5) == translation(2, 2, 3));
+		CHECK(world_transform(graph, 4) == translation(3, 1, 0));
+		CHECK(instances[graph.node_slots[5]] == translation(2, 2, 3));
+		CHECK(instances[graph.node_slots[1]] == maths::kIdentity);
+	}
+
+	SUBCASE("invalid hierarchy")
+	{
+		std::span<maths::Mat4 const> const two_transforms = std::span{local_transforms}.first(2);
+		// Parent after child.
+		CHECK_THROWS_AS(
+			create_scene_graph(std::vector<uint32_t>{1, kNoParent}, two_transforms),
+			std::invalid_argument);
+		// Parent is itself.
+		CHECK_THROWS_AS(
+			create_scene_graph(std::vector<uint32_t>{kNoParent, 1}, two_transforms),
+			std::invalid_argument);
+		CHECK_THROWS_AS(
+			create_scene_graph(std::vector<uint32_t>{kNoParent}, two_transforms),
+			std::invalid_argument);
+		CHECK_THROWS_AS(
+			update_world_transforms(graph, std::span{instances}.first(2)), std::invalid_argument);
+	}
+}
+
+TEST_CASE("Update scene graph world transforms across a thread pool")
+{
+	// Wide enough levels to be split across the pool, with a remainder.
+	constexpr std::size_t node_count = 8 * kChunkSize + 3;
+	std::vector<uint32_t> const parents = make_random_parents(node_count, 5);
+	std::vector<maths::Mat4> const local_transforms = make_random_transforms(node_count);
+
+	SceneGraph expected = create_scene_graph(parents, local_transforms);
+	update_world_transforms(expected);
+
+	// Pointer based tree, to check against an independent traversal.
+	std::vector<BaselineNode> baseline_nodes(node_count);
+	for (std::size_t node = 0; node < node_count; ++node)
+	{
+		baseline_nodes[node].local = local_transforms[node];
+		if (parents[node] != kNoParent)
+			baseline_nodes[parents[node]].children.push_back(&baseline_nodes[node]);
+	}
+	for (std::size_t node = 0; node < node_count; ++node)
+		if (parents[node] == kNoParent)
+			update_baseline(baseline_nodes[node], maths::kIdentity);
+	for (uint32_t node = 0; node < node_count; ++node)
+		CHECK(world_transform(expected, node) == baseline_nodes[node].world);
+
+	parallel::ThreadPool pool{3};
+	SceneGraph graph = create_scene_graph(parents, local_transforms);
+	std::vector<maths::Mat4> instances(node_count);
+
+	CHECK(update_world_transforms(graph, instances, pool) == node_count);
+	CHECK(graph.world_transforms == expected.world_transforms);
+	CHECK(instances == expected.world_transforms);
+
+	// Dirty a mid-depth node in both, then compare single-threaded against parallel.
+	uint32_t const node = parents.back();
+	set_local_transform(graph, node, maths::kIdentity);
+	SceneGraph single = graph;
+	std::size_t const single_count = update_world_transforms(single);
+	CHECK(update_world_transforms(graph, instances, pool) == single_count);
+	CHECK(single_count >= 2);
+	CHECK(single_count < node_count);
+	CHECK(graph.world_transforms == single.world_transforms);
+	CHECK(instances == single.world_transforms);
+}
+
+TEST_CASE("Benchmark scene graph update" * doctest::test_suite("benchmark") * doctest::skip())
+{
+	LoggerPtr const logger = create_logger("Benchmark scene graph update");
+	parallel::ThreadPool pool;
+	logger->info("{} threads", pool.thread_count());
+
+	for (std::size_t const node_count : {10'000UZ, 100'000UZ, 1'000'000UZ})
+	{
+		constexpr std::size_t root_count = 16;
+		constexpr std::size_t iterations = 20;
+		std::vector<uint32_t> const parents = make_random_parents(node_count, root_count);
+		std::vector<maths::Mat4> const local_transforms = make_random_transforms(node_count);
+
+		// Baseline nodes allocated individually, as a naive tree would be.
+		std::vector<std::unique_ptr<BaselineNode>> baseline_nodes;
+		baseline_nodes.reserve(node_count);
+		for (std::size_t node = 0; node < node_count; ++node)
+		{
+			baseline_nodes.push_back(std::make_unique<BaselineNode>(BaselineNode{
+				.local = local_transforms[node], .world = maths::kIdentity, .children = {}}));
+			if (parents[node] != kNoParent)
+				baseline_nodes[parents[node]]->children.push_back(baseline_nodes.back().get());
+		}
+		double const baseline_ms = bench::mean_ms(
+			iterations,
+			[&]
+			{
+				for (std::size_t root = 0; root < root_count; ++root)
+					update_baseline(*baseline_nodes[root], maths::kIdentity);
+			});
+
+		SceneGraph graph = create_scene_graph(parents, local_transforms);
+		std::vector<maths::Mat4> instances(node_count);
+		logger->info(
+			"{} nodes over {} levels: pointer tree baseline {:.3f} ms",
+			node_count,
+			graph.level_offsets.size() - 1,
+			baseline_ms);
+
+		// One percent of nodes moved per frame.
+		// NOLINTNEXTLINE(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+		std::mt19937 rng{42};
+		std::uniform_int_distribution<uint32_t> random_node{
+			0, static_cast<uint32_t>(node_count - 1)};
+		std::vector<uint32_t> moved_nodes(node_count / 100);
+		for (uint32_t & node : moved_nodes) node = random_node(rng);
+		auto const dirty_all = [&]
+		{
+			std::ranges::fill(graph.dirty, uint8_t{1});
+			graph.first_dirty_level = 0;
+		};
+		auto const dirty_some = [&]
+		{
+			for (uint32_t const node : moved_nodes)
+				set_local_transform(graph, node, local_transforms[node]);
+		};
+
+		double const full_ms = bench::mean_ms(
+			iterations,
+			[&]
+			{
+				dirty_all();
+				update_world_transforms(graph, instances);
+			});
+		double const full_parallel_ms = bench::mean_ms(
+			iterations,
+			[&]
+			{
+				dirty_all();
+				update_world_transforms(graph, instances, pool);
+			});
+		dirty_some();
+		std::size_t const partial_count = update_world_transforms(graph, instances);
+		double const partial_parallel_ms = bench::mean_ms(
+			iterations,
+			[&]
+			{
+				dirty_some();
+				update_world_transforms(graph, instances, pool);
+			});
+
+		logger->info(
+			"{} nodes: full {:.3f} ms ({:.1f}x), parallel {:.3f} ms ({:.1f}x); "
+			"1% moved ({} recomputed) parallel {:.3f} ms",
+			node_count,
+			full_ms,
+			baseline_ms / full_ms,
+			full_parallel_ms,
+			baseline_ms / full_parallel_ms,
+			partial_count,
+			partial_parallel_ms);
+	}
+}
+}  // namespace vulkandemo::scene
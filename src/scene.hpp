@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "maths.hpp"
+#include "parallel.hpp"
+#include "types.hpp"
+
+/**
+ * Transform hierarchy stored as structure-of-arrays, with dirty-flag world transform propagation.
+ *
+ * Nodes are stored in slots sorted by depth in the hierarchy, breadth first, so that the children
+ * of each node are contiguous and every parent precedes its children. World transforms are then
+ * computed one depth level at a time, with each level split into chunks across a thread pool,
+ * since nodes at the same depth are independent. Each is the product of its parent's world
+ * transform and its local transform, using the SIMD matrix product of maths::Mat4.
+ *
+ * Changing a local transform marks its node dirty. An update recomputes only dirty nodes and their
+ * descendants, skipping entirely any levels above the shallowest dirty node, and optionally writes
+ * each recomputed world transform into a mapped instance buffer indexed by slot.
+ */
+namespace vulkandemo::scene
+{
+/// Parent of a root node.
+inline constexpr uint32_t kNoParent = std::numeric_limits<uint32_t>::max();
+
+/// Number of slots updated per parallel task.
+inline constexpr std::size_t kChunkSize = 4096;
+
+/**
+ * Transform hierarchy with all per-node data indexed by slot.
+ *
+ * Nodes are created in an order where parents precede their children, and are referred to by
+ * that creation index. Slots are a reordering of nodes, see node_slots.
+ */
+struct SceneGraph
+{
+	/// Slot of each node's parent, or kNoParent for roots.
+	std::vector<uint32_t> parent_slots;
+	/// Transform of each node relative to its parent.
+	std::vector<maths::Mat4> local_transforms;
+	/// Transform of each node relative to the world, as of the last update.
+	std::vector<maths::Mat4> world_transforms;
+	/// Whether each node's local transform changed since the last update.
+	std::vector<uint8_t> dirty;
+	/// Slots at depth `d` are `[level_offsets[d], level_offsets[d + 1])`.
+	std::vector<std::size_t> level_offsets;
+	/// Slot of each node, indexed by creation index.
+	std::vector<uint32_t> node_slots;
+	/// Shallowest depth with a dirty node, or the number of levels if none.
+	std::size_t first_dirty_level;
+};
+
+/**
+ * Persistently mapped buffer of world transforms, one per slot.
+ */
+struct InstanceTransforms
+{
+	types::VulkanBufferPtr buffer;
+	types::VulkanDeviceMemoryPtr memory;
+	/// Write only - may be write-combined memory.
+	std::span<maths::Mat4> mapped_transforms;
+};
+
+/**
+ * Create a hierarchy, with every node initially dirty.
+ *
+ * @param parents Creation index of each node's parent, which must be less than that of the node,
+ * or kNoParent for roots.
+ * @param local_transforms Transform of each node relative to its parent.
+ * @return
+ */
+SceneGraph create_scene_graph(
+	std::span<uint32_t const> parents, std::span<maths::Mat4 const> local_transforms);
+
+/**
+ * Create a mapped buffer to receive world transforms, usable as per-instance vertex input or as a
+ * storage buffer.
+ *
+ * @param device
+ * @param memory_type_idx Host visible and host coherent memory type.
+ * @param node_count
+ * @return
+ */
+InstanceTransforms create_instance_transforms(
+	types::VulkanDevicePtr const & device,
+	types::VulkanMemoryTypeIdx memory_type_idx,
+	std::size_t node_count);
+
+/**
+ * Change the local transform of a node, marking it dirty.
+ *
+ * @param graph
+ * @param node Creation index of the node.
+ * @param local_transform
+ */
+void set_local_transform(
+	SceneGraph & graph, uint32_t node, maths::Mat4 const & local_transform);
+
+/**
+ * World transform of a node as of the last update.
+ *
+ * @param graph
+ * @param node Creation index of the node.
+ * @return
+ */
+maths::Mat4 const & world_transform(SceneGraph const & graph, uint32_t node);
+
+/**
+ * Recompute world transforms of dirty nodes and their descendants on the calling thread.
+ *
+ * @param graph
+ * @param instances Written with the world transform of each recomputed slot. Either empty or
+ * at least as long as the number of nodes.
+ * @return Number of nodes recomputed.
+ */
+std::size_t update_world_transforms(SceneGraph & graph, std::span<maths::Mat4> instances = {});
+
+/**
+ * Recompute world transforms of dirty nodes and their descendants, in chunks of kChunkSize per
+ * level across a thread pool.
+ *
+ * @param graph
+ * @param instances See single-threaded update_world_transforms.
+ * @param pool
+ * @return Number of nodes recomputed.
+ */
+std::size_t update_world_transforms(
+	SceneGraph & graph, std::span<maths::Mat4> instances, parallel::ThreadPool & pool);
+}  // namespace vulkandemo::scene
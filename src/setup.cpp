@@ -15,6 +15,7 @@
 #include <iterator>
 #include <limits>
 #include <map>
+#include <optional>
 #include <ranges>
 #include <set>
 #include <span>
@@ -53,6 +54,7 @@
 #include "Logger.hpp"
 #include "hof.hpp"
 #include "macros.hpp"
+#include "profiler.hpp"
 #include "types.hpp"
 
 using namespace std::literals;
@@ -163,8 +165,150 @@ types::VulkanPipelineLayoutPtr create_minimal_pipeline_layout(types::VulkanDevic
 	return types::make_pipeline_layout_ptr(device, out);
 }
 
+types::VulkanPipelineLayoutPtr create_pipeline_layout(
+	types::VulkanDevicePtr const & device,
+	std::span<VkDescriptorSetLayout const> const descriptor_set_layouts,
+	std::span<VkPushConstantRange const> const push_constant_ranges)
+{
+	PROFILE_FUNCTION();
+	VkPipelineLayoutCreateInfo const pipeline_layout_create_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.setLayoutCount = static_cast<uint32_t>(descriptor_set_layouts.size()),
+		.pSetLayouts = descriptor_set_layouts.data(),
+		.pushConstantRangeCount = static_cast<uint32_t>(push_constant_ranges.size()),
+		.pPushConstantRanges = push_constant_ranges.data(),
+	};
+
+	VkPipelineLayout out = nullptr;
+	VK_CHECK(
+		vkCreatePipelineLayout(device.get(), &pipeline_layout_create_info, nullptr, &out),
+		"Failed to create pipeline layout");
+	return types::make_pipeline_layout_ptr(device, out);
+}
+
+types::VulkanShaderModulePtr create_shader_module(
+	types::VulkanDevicePtr const & device, std::span<uint32_t const> const spirv)
+{
+	PROFILE_FUNCTION();
+	VkShaderModuleCreateInfo const shader_module_create_info{
+		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.codeSize = spirv.size_bytes(),
+		.pCode = spirv.data()};
+
+	VkShaderModule out = nullptr;
+	VK_CHECK(
+		vkCreateShaderModule(device.get(), &shader_module_create_info, nullptr, &out),
+		"Failed to create shader module");
+	return types::make_shader_module_ptr(device, out);
+}
+
+types::VulkanPipelinePtr create_compute_pipeline(
+	types::VulkanDevicePtr const & device,
+	types::VulkanPipelineLayoutPtr const & pipeline_layout,
+	std::span<uint32_t const> const spirv)
+{
+	PROFILE_FUNCTION();
+	types::VulkanShaderModulePtr const shader_module = create_shader_module(device, spirv);
+
+	VkComputePipelineCreateInfo const pipeline_create_info{
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.stage =
+			{.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			 .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			 .module = shader_module.get(),
+			 .pName = "main"},
+		.layout = pipeline_layout.get(),
+		.basePipelineHandle = nullptr,
+		.basePipelineIndex = -1};
+
+	VkPipeline out = nullptr;
+	VK_CHECK(
+		vkCreateComputePipelines(device.get(), nullptr, 1, &pipeline_create_info, nullptr, &out),
+		"Failed to create compute pipeline");
+	return types::make_pipeline_ptr(device, out);
+}
+
+types::VulkanDescriptorSetLayoutPtr create_descriptor_set_layout(
+	types::VulkanDevicePtr const & device,
+	std::span<VkDescriptorSetLayoutBinding const> const bindings)
+{
+	PROFILE_FUNCTION();
+	VkDescriptorSetLayoutCreateInfo const create_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.bindingCount = static_cast<uint32_t>(bindings.size()),
+		.pBindings = bindings.data()};
+
+	VkDescriptorSetLayout out = nullptr;
+	VK_CHECK(
+		vkCreateDescriptorSetLayout(device.get(), &create_info, nullptr, &out),
+		"Failed to create descriptor set layout");
+	return types::make_descriptor_set_layout_ptr(device, out);
+}
+
+types::VulkanDescriptorPoolPtr create_descriptor_pool(
+	types::VulkanDevicePtr const & device,
+	uint32_t const max_sets,
+	std::span<VkDescriptorPoolSize const> const pool_sizes)
+{
+	PROFILE_FUNCTION();
+	VkDescriptorPoolCreateInfo const create_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.maxSets = max_sets,
+		.poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
+		.pPoolSizes = pool_sizes.data()};
+
+	VkDescriptorPool out = nullptr;
+	VK_CHECK(
+		vkCreateDescriptorPool(device.get(), &create_info, nullptr, &out),
+		"Failed to create descriptor pool");
+	return types::make_descriptor_pool_ptr(device, out);
+}
+
+VkDescriptorSet allocate_descriptor_set(
+	types::VulkanDevicePtr const & device,
+	types::VulkanDescriptorPoolPtr const & pool,
+	types::VulkanDescriptorSetLayoutPtr const & layout)
+{
+	PROFILE_FUNCTION();
+	VkDescriptorSetLayout layout_handle = layout.get();
+	VkDescriptorSetAllocateInfo const allocate_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.descriptorPool = pool.get(),
+		.descriptorSetCount = 1,
+		.pSetLayouts = &layout_handle};
+
+	VkDescriptorSet out = nullptr;
+	VK_CHECK(
+		vkAllocateDescriptorSets(device.get(), &allocate_info, &out),
+		"Failed to allocate descriptor set");
+	return out;
+}
+
+VkPhysicalDeviceVulkan12Features query_vulkan12_features(VkPhysicalDevice physical_device)
+{
+	VkPhysicalDeviceVulkan12Features out{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES, .pNext = nullptr};
+	VkPhysicalDeviceFeatures2 features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &out};
+	vkGetPhysicalDeviceFeatures2(physical_device, &features);
+	out.pNext = nullptr;
+	return out;
+}
+
 types::VulkanSemaphorePtr create_semaphore(types::VulkanDevicePtr const & device)
 {
+	PROFILE_FUNCTION();
 	constexpr VkSemaphoreCreateInfo semaphore_create_info{
 		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, .pNext = nullptr};
 
@@ -175,11 +319,107 @@ types::VulkanSemaphorePtr create_semaphore(types::VulkanDevicePtr const & device
 	return types::make_semaphore_ptr(device, out);
 }
 
+types::VulkanFencePtr create_fence(types::VulkanDevicePtr const & device, bool const signalled)
+{
+	PROFILE_FUNCTION();
+	VkFenceCreateInfo const fence_create_info{
+		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = signalled ? VK_FENCE_CREATE_SIGNALED_BIT : 0U};
+
+	VkFence out = nullptr;
+	VK_CHECK(
+		vkCreateFence(device.get(), &fence_create_info, nullptr, &out), "Failed to create fence");
+	return types::make_fence_ptr(device, out);
+}
+
+std::tuple<types::VulkanImagePtr, types::VulkanDeviceMemoryPtr> create_image_and_memory(
+	types::VulkanDevicePtr const & device,
+	VkPhysicalDevice physical_device,
+	VkFormat const format,
+	VkExtent2D const extent,
+	VkImageUsageFlags const usage,
+	uint32_t const mip_levels,
+	uint32_t const array_layers)
+{
+	PROFILE_FUNCTION();
+	VkImageCreateInfo const image_create_info{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.imageType = VK_IMAGE_TYPE_2D,
+		.format = format,
+		.extent = {.width = extent.width, .height = extent.height, .depth = 1},
+		.mipLevels = mip_levels,
+		.arrayLayers = array_layers,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = usage,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.queueFamilyIndexCount = 0,
+		.pQueueFamilyIndices = nullptr,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+	VkImage image = nullptr;
+	VK_CHECK(
+		vkCreateImage(device.get(), &image_create_info, nullptr, &image),
+		"Failed to create image");
+	types::VulkanImagePtr image_ptr = types::make_image_ptr(device, image);
+
+	VkMemoryRequirements memory_requirements;
+	vkGetImageMemoryRequirements(device.get(), image, &memory_requirements);
+
+	VkMemoryAllocateInfo const memory_allocate_info{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.allocationSize = memory_requirements.size,
+		.memoryTypeIndex =
+			choose_device_local_memory_type(physical_device, memory_requirements.memoryTypeBits)};
+	VkDeviceMemory memory = nullptr;
+	VK_CHECK(
+		vkAllocateMemory(device.get(), &memory_allocate_info, nullptr, &memory),
+		"Failed to allocate image memory");
+	types::VulkanDeviceMemoryPtr memory_ptr = types::make_device_memory_ptr(device, memory);
+
+	VK_CHECK(vkBindImageMemory(device.get(), image, memory, 0), "Failed to bind image memory");
+
+	return {std::move(image_ptr), std::move(memory_ptr)};
+}
+
+types::VulkanImageViewPtr create_image_view(
+	types::VulkanDevicePtr const & device,
+	VkImage image,
+	VkFormat const format,
+	VkImageViewType const view_type)
+{
+	PROFILE_FUNCTION();
+	VkImageViewCreateInfo const image_view_create_info{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.image = image,
+		.viewType = view_type,
+		.format = format,
+		.components =
+			{VK_COMPONENT_SWIZZLE_IDENTITY,
+			 VK_COMPONENT_SWIZZLE_IDENTITY,
+			 VK_COMPONENT_SWIZZLE_IDENTITY,
+			 VK_COMPONENT_SWIZZLE_IDENTITY},
+		.subresourceRange = {
+			VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS}};
+	VkImageView image_view = nullptr;
+	VK_CHECK(
+		vkCreateImageView(device.get(), &image_view_create_info, nullptr, &image_view),
+		"Failed to create image view");
+	return types::make_image_view_ptr(device, image_view);
+}
+
 types::VulkanCommandBuffersPtr create_primary_command_buffers(
 	types::VulkanDevicePtr device,
 	types::VulkanCommandPoolPtr pool,
 	types::VulkanCommandBufferCount count)
 {
+	PROFILE_FUNCTION();
 	VkCommandBufferAllocateInfo const command_buffer_allocate_info{
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
 		.commandPool = pool.get(),
@@ -197,6 +437,7 @@ types::VulkanCommandBuffersPtr create_primary_command_buffers(
 types::VulkanCommandPoolPtr create_command_pool(
 	types::VulkanDevicePtr device, types::VulkanQueueFamilyIdx const queue_family_idx)
 {
+	PROFILE_FUNCTION();
 	VkCommandPoolCreateInfo const command_pool_create_info{
 		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
 		.pNext = nullptr,
@@ -217,6 +458,7 @@ std::vector<types::VulkanFramebufferPtr> create_per_image_frame_buffers(
 	std::span<types::VulkanImageViewPtr const> const image_views,
 	VkExtent2D const size)
 {
+	PROFILE_FUNCTION();
 	VkFramebufferCreateInfo frame_buffer_create_info{
 		.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
 		.pNext = nullptr,
@@ -248,6 +490,7 @@ std::vector<types::VulkanFramebufferPtr> create_per_image_frame_buffers(
 types::VulkanRenderPassPtr create_single_presentation_subpass_render_pass(
 	VkFormat surface_format, types::VulkanDevicePtr const & device)
 {
+	PROFILE_FUNCTION();
 	// Create color attachment.
 	VkAttachmentDescription const color_attachment{
 		.format = surface_format,
@@ -306,6 +549,7 @@ create_exclusive_double_buffer_swapchain_and_image_views(
 	VkSurfaceFormatKHR const surface_format,
 	types::VulkanSwapchainPtr const & previous_swapchain)
 {
+	PROFILE_FUNCTION();
 	if (logger->should_log(spdlog::level::debug))
 	{
 		VkPhysicalDeviceProperties device_properties;
@@ -327,6 +571,21 @@ create_exclusive_double_buffer_swapchain_and_image_views(
 	return {std::move(swapchain), std::move(image_views)};
 }
 
+std::vector<VkImage> get_swapchain_images(
+	types::VulkanDevicePtr const & device, types::VulkanSwapchainPtr const & swapchain)
+{
+	uint32_t count = 0;
+	VK_CHECK(
+		vkGetSwapchainImagesKHR(device.get(), swapchain.get(), &count, nullptr),
+		"Failed to get swapchain image count");
+
+	std::vector<VkImage> out(count);
+	VK_CHECK(
+		vkGetSwapchainImagesKHR(device.get(), swapchain.get(), &count, out.data()),
+		"Failed to get swapchain images");
+	return out;
+}
+
 namespace
 {
 std::vector<types::VulkanImageViewPtr>
@@ -336,19 +595,7 @@ create_colour_aspect_single_mip_single_layer_swapchain_image_views(
 	types::VulkanSwapchainPtr const & swapchain)
 {
 	// Query raw images associated with swapchain.
-	std::vector<VkImage> const swapchain_images = [&]
-	{
-		uint32_t count = 0;
-		VK_CHECK(
-			vkGetSwapchainImagesKHR(device.get(), swapchain.get(), &count, nullptr),
-			"Failed to get swapchain image count");
-
-		std::vector<VkImage> out(count);
-		VK_CHECK(
-			vkGetSwapchainImagesKHR(device.get(), swapchain.get(), &count, out.data()),
-			"Failed to get swapchain images");
-		return out;
-	}();
+	std::vector<VkImage> const swapchain_images = get_swapchain_images(device, swapchain);
 
 	// Construct image views.
 	VkImageViewCreateInfo image_view_create_info{
@@ -387,6 +634,7 @@ types::VulkanSwapchainPtr create_exclusive_double_buffer_swapchain(
 	VkSurfaceFormatKHR const surface_format,
 	types::VulkanSwapchainPtr const & previous_swapchain)
 {
+	PROFILE_FUNCTION();
 	// Get surface capabilities.
 	VkSurfaceCapabilitiesKHR surface_capabilities{};
 	VK_CHECK(
@@ -495,8 +743,10 @@ create_device_and_queues(
 	VkPhysicalDevice physical_device,
 	std::span<std::pair<types::VulkanQueueFamilyIdx, types::VulkanQueueCount> const>
 		queue_family_and_counts,
-	std::span<types::AvailableDeviceExtensionNameView const> const device_extension_names)
+	std::span<types::AvailableDeviceExtensionNameView const> const device_extension_names,
+	VkPhysicalDeviceFeatures2 const * features)
 {
+	PROFILE_FUNCTION();
 	std::vector<char const *> const device_extension_cstr_names = device_extension_names |
 		hof::views::value_of() | std::views::transform(&std::string_view::data) |
 		ranges::to<std::vector>;
@@ -529,6 +779,8 @@ create_device_and_queues(
 	{
 		VkDeviceCreateInfo const device_create_info{
 			.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+			// Features are enabled via the pNext chain, rather than pEnabledFeatures.
+			.pNext = features,
 			.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size()),
 			.pQueueCreateInfos = queue_create_infos.data(),
 			.enabledExtensionCount = static_cast<uint32_t>(device_extension_cstr_names.size()),
@@ -643,6 +895,7 @@ std::tuple<VkPhysicalDevice, types::VulkanQueueFamilyIdx> select_physical_device
 	VkMemoryPropertyFlags required_memory_type,
 	types::VulkanSurfacePtr const & required_surface_support)
 {
+	PROFILE_FUNCTION();
 	using Score = std::size_t;
 	std::vector<std::tuple<Score, VkPhysicalDevice, types::VulkanQueueFamilyIdx>> candidates;
 
@@ -834,6 +1087,27 @@ std::vector<types::VulkanMemoryTypeIdx> filter_available_memory_types(
 		ranges::to<std::vector<types::VulkanMemoryTypeIdx>>();
 }
 
+types::VulkanMemoryTypeIdx choose_device_local_memory_type(
+	VkPhysicalDevice physical_device, uint32_t const memory_type_bits)
+{
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+	std::optional<uint32_t> fallback;
+	for (uint32_t type_idx = 0; type_idx < memory_properties.memoryTypeCount; ++type_idx)
+	{
+		if ((memory_type_bits & (1U << type_idx)) == 0)
+			continue;
+		if ((memory_properties.memoryTypes[type_idx].propertyFlags &
+			 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0)
+			return types::VulkanMemoryTypeIdx{type_idx};
+		fallback = fallback.value_or(type_idx);
+	}
+	if (!fallback)
+		throw std::runtime_error{"No memory type available"};
+	return types::VulkanMemoryTypeIdx{*fallback};
+}
+
 std::vector<VkPhysicalDevice> enumerate_physical_devices(
 	LoggerPtr const & logger, types::VulkanInstancePtr const & instance)
 {
@@ -1010,10 +1284,13 @@ types::VulkanInstancePtr create_vulkan_instance(
 	std::span<types::AvailableInstanceLayerNameCstr const> layers_to_enable,
 	std::span<types::AvailableInstanceExtensionNameCstr const> extensions_to_enable)
 {
+	PROFILE_FUNCTION();
 	// Get the available extensions from SDL
 	std::vector<char const *> extensions_to_enable_cstr = [&]
 	{
 		std::vector<char const *> out;
+		if (!sdl_window)
+			return out;
 		uint32_t extension_count = 0;
 		SDL_Vulkan_GetInstanceExtensions(sdl_window.get(), &extension_count, nullptr);
 		out.resize(extension_count);
@@ -1028,11 +1305,12 @@ types::VulkanInstancePtr create_vulkan_instance(
 	logger->debug("Enabling instance extensions: {}", fmt::join(extensions_to_enable_cstr, ", "));
 
 	// Application metadata.
+	char const * const app_name = sdl_window ? SDL_GetWindowTitle(sdl_window.get()) : "";
 	VkApplicationInfo const app_info = {
 		.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
-		.pApplicationName = SDL_GetWindowTitle(sdl_window.get()),
+		.pApplicationName = app_name,
 		.applicationVersion = VK_MAKE_VERSION(1, 0, 0),
-		.pEngineName = SDL_GetWindowTitle(sdl_window.get()),
+		.pEngineName = app_name,
 		.engineVersion = VK_MAKE_VERSION(1, 0, 0),
 		.apiVersion = VK_API_VERSION_1_3,
 	};
@@ -1234,6 +1512,7 @@ VkExtent2D window_drawable_size(types::SDLWindowPtr const & window)
 
 types::SDLWindowPtr create_window(char const * title, int const width, int const height)
 {
+	PROFILE_FUNCTION();
 	// Initialize SDL
 	if (int const error_code = SDL_Init(SDL_INIT_VIDEO); error_code != 0)
 		throw std::runtime_error{std::format("Failed to initialize SDL: {}", SDL_GetError())};
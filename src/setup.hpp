@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: MIT
 // Copyright 2024 David Feltell
 #pragma once
+#include <cstdint>
 #include <set>
 #include <tuple>
 #include <utility>
@@ -20,6 +21,89 @@ namespace vulkandemo::setup
 
 types::VulkanPipelineLayoutPtr create_minimal_pipeline_layout(types::VulkanDevicePtr const& device);
 
+/**
+ * Create a pipeline layout from descriptor set layouts and push constant ranges.
+ *
+ * @param device
+ * @param descriptor_set_layouts
+ * @param push_constant_ranges
+ * @return
+ */
+types::VulkanPipelineLayoutPtr create_pipeline_layout(
+	types::VulkanDevicePtr const & device,
+	std::span<VkDescriptorSetLayout const> descriptor_set_layouts,
+	std::span<VkPushConstantRange const> push_constant_ranges);
+
+/**
+ * Create a shader module from SPIR-V words, e.g. as embedded by the build from
+ * `src/shaders/*`.
+ *
+ * @param device
+ * @param spirv
+ * @return
+ */
+types::VulkanShaderModulePtr create_shader_module(
+	types::VulkanDevicePtr const & device, std::span<uint32_t const> spirv);
+
+/**
+ * Create a compute pipeline from SPIR-V words with a `main` entry point.
+ *
+ * @param device
+ * @param pipeline_layout
+ * @param spirv
+ * @return
+ */
+types::VulkanPipelinePtr create_compute_pipeline(
+	types::VulkanDevicePtr const & device,
+	types::VulkanPipelineLayoutPtr const & pipeline_layout,
+	std::span<uint32_t const> spirv);
+
+/**
+ * Create a descriptor set layout from a list of bindings.
+ *
+ * @param device
+ * @param bindings
+ * @return
+ */
+types::VulkanDescriptorSetLayoutPtr create_descriptor_set_layout(
+	types::VulkanDevicePtr const & device, std::span<VkDescriptorSetLayoutBinding const> bindings);
+
+/**
+ * Create a descriptor pool whose sets are freed only when the pool is destroyed.
+ *
+ * @param device
+ * @param max_sets
+ * @param pool_sizes
+ * @return
+ */
+types::VulkanDescriptorPoolPtr create_descriptor_pool(
+	types::VulkanDevicePtr const & device,
+	uint32_t max_sets,
+	std::span<VkDescriptorPoolSize const> pool_sizes);
+
+/**
+ * Allocate a single descriptor set from a pool.
+ *
+ * The set is owned by, and so must not outlive, the pool.
+ *
+ * @param device
+ * @param pool
+ * @param layout
+ * @return
+ */
+VkDescriptorSet allocate_descriptor_set(
+	types::VulkanDevicePtr const & device,
+	types::VulkanDescriptorPoolPtr const & pool,
+	types::VulkanDescriptorSetLayoutPtr const & layout);
+
+/**
+ * Query the Vulkan 1.2 features supported by a physical device.
+ *
+ * @param physical_device
+ * @return
+ */
+VkPhysicalDeviceVulkan12Features query_vulkan12_features(VkPhysicalDevice physical_device);
+
 /**
  * Create a semaphore.
  *
@@ -28,6 +112,52 @@ types::VulkanPipelineLayoutPtr create_minimal_pipeline_layout(types::VulkanDevic
  */
 types::VulkanSemaphorePtr create_semaphore(types::VulkanDevicePtr const & device);
 
+/**
+ * Create a fence.
+ *
+ * @param device
+ * @param signalled Whether to create the fence in the signalled state, e.g. so that the first
+ * wait on a fence guarding a resource's previous use returns immediately.
+ * @return
+ */
+types::VulkanFencePtr create_fence(types::VulkanDevicePtr const & device, bool signalled);
+
+/**
+ * Create a 2D, optimally tiled image bound to its own device local allocation.
+ *
+ * @param device
+ * @param physical_device
+ * @param format
+ * @param extent
+ * @param usage
+ * @param mip_levels
+ * @param array_layers
+ * @return Image handle and memory handle.
+ */
+std::tuple<types::VulkanImagePtr, types::VulkanDeviceMemoryPtr> create_image_and_memory(
+	types::VulkanDevicePtr const & device,
+	VkPhysicalDevice physical_device,
+	VkFormat format,
+	VkExtent2D extent,
+	VkImageUsageFlags usage,
+	uint32_t mip_levels = 1,
+	uint32_t array_layers = 1);
+
+/**
+ * Create a view of all mips and layers of a colour image.
+ *
+ * @param device
+ * @param image
+ * @param format
+ * @param view_type E.g. VK_IMAGE_VIEW_TYPE_2D_ARRAY for a layered image.
+ * @return
+ */
+types::VulkanImageViewPtr create_image_view(
+	types::VulkanDevicePtr const & device,
+	VkImage image,
+	VkFormat format,
+	VkImageViewType view_type = VK_IMAGE_VIEW_TYPE_2D);
+
 /**
  * Create command buffers of primary level from a given pool.
  *
@@ -99,6 +229,16 @@ create_exclusive_double_buffer_swapchain_and_image_views(
 	VkSurfaceFormatKHR surface_format,
 	types::VulkanSwapchainPtr const & previous_swapchain = nullptr);
 
+/**
+ * Get the raw images owned by a swapchain, indexed by VulkanImageIdx.
+ *
+ * @param device
+ * @param swapchain
+ * @return
+ */
+std::vector<VkImage> get_swapchain_images(
+	types::VulkanDevicePtr const & device, types::VulkanSwapchainPtr const & swapchain);
+
 /**
  * Given a physical device, desired queue types, and desired extensions, get a logical
  * device and corresponding queues.
@@ -106,6 +246,8 @@ create_exclusive_double_buffer_swapchain_and_image_views(
  * @param physical_device
  * @param queue_family_and_counts
  * @param device_extension_names
+ * @param features Optional features to enable, including any chained via `pNext`, e.g.
+ * VkPhysicalDeviceVulkan12Features.
  * @return
  */
 std::tuple<types::VulkanDevicePtr, types::MapOfVulkanQueueFamilyIdxToVectorOfQueues>
@@ -113,7 +255,8 @@ create_device_and_queues(
 	VkPhysicalDevice physical_device,
 	std::span<std::pair<types::VulkanQueueFamilyIdx, types::VulkanQueueCount> const>
 		queue_family_and_counts,
-	std::span<types::AvailableDeviceExtensionNameView const> device_extension_names);
+	std::span<types::AvailableDeviceExtensionNameView const> device_extension_names,
+	VkPhysicalDeviceFeatures2 const * features = nullptr);
 
 /**
  * Given some desired image/surface formats (e.g. VK_FORMAT_B8G8R8_UNORM), filter to only those
@@ -191,6 +334,16 @@ std::vector<types::AvailableDeviceExtensionNameView> filter_available_device_ext
 [[nodiscard]] std::vector<types::VulkanMemoryTypeIdx> filter_available_memory_types(
 	LoggerPtr const & logger, VkPhysicalDevice physical_device, VkMemoryPropertyFlags memory_flags);
 
+/**
+ * Choose a memory type for a resource, preferring device local memory.
+ *
+ * @param physical_device
+ * @param memory_type_bits Allowed memory types, e.g. from VkMemoryRequirements.
+ * @return
+ */
+types::VulkanMemoryTypeIdx choose_device_local_memory_type(
+	VkPhysicalDevice physical_device, uint32_t memory_type_bits);
+
 
 /**
  * Get a list of all physical devices.
@@ -225,7 +378,8 @@ types::VulkanDebugMessengerPtr create_debug_messenger(
  * Create VkInstance using given window and layers.
  *
  * @param logger
- * @param sdl_window
+ * @param sdl_window Window whose surface extensions to enable, or null for a headless instance,
+ * in which case SDL is not used at all.
  * @param layers_to_enable
  * @param extensions_to_enable
  * @return
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <cstdint>
+
+/**
+ * SPIR-V of the GLSL sources under `src/shaders`, compiled and embedded at build time.
+ *
+ * Each `.spv.inc` is generated by `glslc -mfmt=c`, i.e. a brace-enclosed list of 32-bit words.
+ */
+namespace vulkandemo::shaders
+{
+// clang-format off
+inline constexpr auto kSpriteVert = std::to_array<uint32_t>(
+#include "sprite.vert.spv.inc"
+);
+inline constexpr auto kSpriteSolidFrag = std::to_array<uint32_t>(
+#include "sprite_solid.frag.spv.inc"
+);
+inline constexpr auto kSpriteTexturedFrag = std::to_array<uint32_t>(
+#include "sprite_textured.frag.spv.inc"
+);
+inline constexpr auto kSpriteTexturedArrayFrag = std::to_array<uint32_t>(
+#include "sprite_textured_array.frag.spv.inc"
+);
+inline constexpr auto kGpuCullComp = std::to_array<uint32_t>(
+#include "gpu_cull.comp.spv.inc"
+);
+inline constexpr auto kLuminanceComp = std::to_array<uint32_t>(
+#include "luminance.comp.spv.inc"
+);
+inline constexpr auto kHizDownsampleComp = std::to_array<uint32_t>(
+#include "hiz_downsample.comp.spv.inc"
+);
+inline constexpr auto kHizCullComp = std::to_array<uint32_t>(
+#include "hiz_cull.comp.spv.inc"
+);
+inline constexpr auto kPackedMeshVert = std::to_array<uint32_t>(
+#include "packed_mesh.vert.spv.inc"
+);
+inline constexpr auto kMeshletCullComp = std::to_array<uint32_t>(
+#include "meshlet_cull.comp.spv.inc"
+);
+inline constexpr auto kMeshletTask = std::to_array<uint32_t>(
+#include "meshlet.task.spv.inc"
+);
+inline constexpr auto kMeshletMesh = std::to_array<uint32_t>(
+#include "meshlet.mesh.spv.inc"
+);
+inline constexpr auto kClusterLightsComp = std::to_array<uint32_t>(
+#include "cluster_lights.comp.spv.inc"
+);
+inline constexpr auto kClusteredForwardFrag = std::to_array<uint32_t>(
+#include "clustered_forward.frag.spv.inc"
+);
+// clang-format on
+}  // namespace vulkandemo::shaders
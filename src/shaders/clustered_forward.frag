@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#version 450
+
+// See cluster::PointLight.
+struct PointLight
+{
+	vec3 position;
+	float radius;
+	vec3 colour;
+	float intensity;
+};
+
+// See cluster::LightRange.
+struct LightRange
+{
+	uint offset;
+	uint count;
+};
+
+// Bindings shared with cluster_lights.comp, which writes ranges and indices.
+layout(std430, set = 0, binding = 1) readonly buffer Lights
+{
+	PointLight lights[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer Ranges
+{
+	LightRange ranges[];
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer Indices
+{
+	uint indices[];
+};
+
+// See cluster::ShadingPushConstants.
+layout(push_constant) uniform PushConstants
+{
+	mat4 view;
+	// Tiles x, y and depth slices.
+	uvec4 grid;
+	// Slice scale and bias, viewport width and height.
+	vec4 params;
+}
+push_constants;
+
+// World space.
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec3 in_normal;
+layout(location = 2) in vec3 in_albedo;
+
+layout(location = 0) out vec4 out_colour;
+
+const vec3 kAmbient = vec3(0.03);
+
+// See cluster::depth_slice.
+uint cluster_index()
+{
+	float depth = -(push_constants.view * vec4(in_position, 1.0)).z;
+	uint slice = uint(max(log2(depth) * push_constants.params.x + push_constants.params.y, 0.0));
+	uvec2 tile = uvec2(gl_FragCoord.xy / push_constants.params.zw * vec2(push_constants.grid.xy));
+	tile = min(tile, push_constants.grid.xy - 1u);
+	slice = min(slice, push_constants.grid.z - 1u);
+	return tile.x + push_constants.grid.x * (tile.y + push_constants.grid.y * slice);
+}
+
+void main()
+{
+	vec3 normal = normalize(in_normal);
+	vec3 radiance = kAmbient;
+
+	LightRange range = ranges[cluster_index()];
+	for (uint slot = 0; slot < range.count; ++slot)
+	{
+		PointLight light = lights[indices[range.offset + slot]];
+		vec3 to_light = light.position - in_position;
+		float distance = length(to_light);
+		// Smooth falloff reaching zero at the light's radius.
+		float falloff = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+		float attenuation = falloff * falloff / (distance * distance + 1.0);
+		float lambert = max(dot(normal, to_light / max(distance, 1e-4)), 0.0);
+		radiance += light.colour * light.intensity * attenuation * lambert;
+	}
+	out_colour = vec4(radiance * in_albedo, 1.0);
+}
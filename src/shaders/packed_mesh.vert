@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#version 450
+
+layout(push_constant) uniform PushConstants
+{
+	// Projection * view * model * vertex::decode_matrix, mapping normalised packed positions to
+	// clip space.
+	mat4 clip_from_packed;
+	// Model matrix, for transforming directions. Assumed to have uniform scale.
+	mat4 world_from_model;
+}
+push_constants;
+
+// Per-vertex attributes, see vertex::PackedVertex. The input assembler has already converted each
+// from its packed format, so positions are in [0, 1] with w = 1.
+layout(location = 0) in vec4 in_position;
+layout(location = 1) in vec2 in_normal;
+layout(location = 2) in vec2 in_uv;
+layout(location = 3) in vec4 in_tangent;
+
+layout(location = 0) out vec3 out_normal;
+layout(location = 1) out vec2 out_uv;
+layout(location = 2) out vec4 out_tangent;
+
+// Unfold the lower half of the octahedron back over the diagonals, see vertex::decode_normal.
+vec3 decode_octahedral(vec2 oct)
+{
+	vec3 normal = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+	float fold = max(-normal.z, 0.0);
+	normal.x += normal.x >= 0.0 ? -fold : fold;
+	normal.y += normal.y >= 0.0 ? -fold : fold;
+	return normalize(normal);
+}
+
+void main()
+{
+	gl_Position = push_constants.clip_from_packed * in_position;
+	mat3 world_from_model = mat3(push_constants.world_from_model);
+	out_normal = normalize(world_from_model * decode_octahedral(in_normal));
+	out_uv = in_uv;
+	// Tangents are not renormalised by the packing, so are here.
+	out_tangent = vec4(normalize(world_from_model * in_tangent.xyz), in_tangent.w);
+}
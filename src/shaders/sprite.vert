@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#version 450
+
+layout(push_constant) uniform PushConstants
+{
+	// 2/width, 2/height of the framebuffer, to map pixels to normalised device coordinates.
+	vec2 inv_half_extent;
+}
+push_constants;
+
+// Per-instance attributes, see batch::Instance.
+layout(location = 0) in vec2 in_basis_x;
+layout(location = 1) in vec2 in_basis_y;
+layout(location = 2) in vec2 in_translation;
+layout(location = 3) in vec4 in_atlas_rect;
+layout(location = 4) in vec4 in_colour;
+layout(location = 5) in uint in_layer;
+
+layout(location = 0) out vec2 out_uv;
+layout(location = 1) out vec4 out_colour;
+layout(location = 2) flat out uint out_layer;
+
+void main()
+{
+	// Unit quad as a 4 vertex triangle strip: (0,0), (1,0), (0,1), (1,1).
+	vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+	vec2 position = in_basis_x * corner.x + in_basis_y * corner.y + in_translation;
+	gl_Position = vec4(position * push_constants.inv_half_extent - 1.0, 0.0, 1.0);
+	out_uv = mix(in_atlas_rect.xy, in_atlas_rect.zw, corner);
+	out_colour = in_colour;
+	out_layer = in_layer;
+}
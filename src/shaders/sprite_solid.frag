@@ -0,0 +1,13 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#version 450
+
+layout(location = 0) in vec2 in_uv;
+layout(location = 1) in vec4 in_colour;
+
+layout(location = 0) out vec4 out_colour;
+
+void main()
+{
+	out_colour = in_colour;
+}
@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#version 450
+
+layout(set = 0, binding = 0) uniform sampler2D atlas;
+
+layout(location = 0) in vec2 in_uv;
+layout(location = 1) in vec4 in_colour;
+
+layout(location = 0) out vec4 out_colour;
+
+void main()
+{
+	out_colour = texture(atlas, in_uv) * in_colour;
+}
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+/**
+ * Runtime selection of SIMD kernels by instruction set, shared by the modules that provide them.
+ *
+ * Kernels other than scalar are compiled only on their architecture. SSE2 and NEON are part of the
+ * x86-64 and AArch64 baselines respectively, whereas AVX2 kernels are compiled with
+ * `__attribute__((target("avx2")))` and so must only be called if the executing CPU supports them.
+ */
+namespace vulkandemo::simd
+{
+/**
+ * Instruction set of a kernel. Ordered from least to most preferred on a given architecture.
+ */
+enum class Kernel : uint8_t
+{
+	kScalar,
+	kSse2,
+	kAvx2,
+	kNeon
+};
+
+/**
+ * Check whether a kernel is compiled in and supported by the executing CPU.
+ *
+ * @param kernel
+ * @return
+ */
+inline bool is_kernel_supported(Kernel const kernel)
+{
+	switch (kernel)
+	{
+		case Kernel::kScalar:
+			return true;
+#if defined(__x86_64__)
+		case Kernel::kSse2:
+			return true;
+		case Kernel::kAvx2:
+			return __builtin_cpu_supports("avx2") != 0;
+#endif
+#if defined(__aarch64__)
+		case Kernel::kNeon:
+			return true;
+#endif
+		default:
+			return false;
+	}
+}
+
+/**
+ * The most preferred kernel supported by the executing CPU, detected once.
+ *
+ * @return
+ */
+inline Kernel best_kernel()
+{
+	static Kernel const kernel = []
+	{
+		for (Kernel const candidate : {Kernel::kNeon, Kernel::kAvx2, Kernel::kSse2})
+			if (is_kernel_supported(candidate))
+				return candidate;
+		return Kernel::kScalar;
+	}();
+	return kernel;
+}
+
+/**
+ * Human readable kernel name, for logging.
+ *
+ * @param kernel
+ * @return
+ */
+inline std::string_view kernel_name(Kernel const kernel)
+{
+	switch (kernel)
+	{
+		case Kernel::kScalar:
+			return "scalar";
+		case Kernel::kSse2:
+			return "SSE2";
+		case Kernel::kAvx2:
+			return "AVX2";
+		case Kernel::kNeon:
+			return "NEON";
+	}
+	return "unknown";
+}
+}  // namespace vulkandemo::simd
@@ -0,0 +1,708 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "streaming.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <range/v3/range/conversion.hpp>
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner)
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vk_enum_string_helper.h>  // NOLINT(misc-include-cleaner) for `VK_CHECK`
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "barrier.hpp"
+#include "draw.hpp"
+#include "ktx2.hpp"
+#include "macros.hpp"
+#include "render_graph.hpp"
+#include "setup.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::streaming
+{
+namespace
+{
+/// Offset alignment of levels in staging buffers, satisfying any texel block size.
+constexpr VkDeviceSize kStagingAlignment = 16;
+
+constexpr VkImageUsageFlags kImageUsage =
+	VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+/// State of an uploaded texture, ready to be sampled by fragment or compute shaders.
+constexpr render_graph::ResourceState kSampleable{
+	.stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+	.access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+	.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+VkImageCreateInfo image_create_info(ktx2::Ktx2Texture const & ktx, uint32_t const first_level)
+{
+	VkExtent2D const extent = ktx2::level_extent(ktx.extent, first_level);
+	return VkImageCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.imageType = VK_IMAGE_TYPE_2D,
+		.format = ktx.format,
+		.extent = {.width = extent.width, .height = extent.height, .depth = 1},
+		.mipLevels = static_cast<uint32_t>(ktx.levels.size()) - first_level,
+		.arrayLayers = 1,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = kImageUsage,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.queueFamilyIndexCount = 0,
+		.pQueueFamilyIndices = nullptr,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+}
+
+/**
+ * First level whose width and height are within the tail size.
+ */
+uint32_t tail_level_of(ktx2::Ktx2Texture const & ktx, uint32_t const mip_tail_size)
+{
+	auto const level_count = static_cast<uint32_t>(ktx.levels.size());
+	for (uint32_t level = 0; level < level_count; ++level)
+	{
+		VkExtent2D const extent = ktx2::level_extent(ktx.extent, level);
+		if (extent.width <= mip_tail_size && extent.height <= mip_tail_size)
+			return level;
+	}
+	return level_count - 1;
+}
+
+/**
+ * Record copies of levels from a staging buffer into a new image, leaving it ready to sample.
+ */
+void populate_cmd_upload(
+	VkCommandBuffer command_buffer,
+	VkImage image,
+	VkBuffer staging_buffer,
+	ktx2::Ktx2Texture const & ktx,
+	uint32_t const first_level,
+	std::span<VkDeviceSize const> const level_offsets)
+{
+	using render_graph::Access;
+	using render_graph::state_of;
+	constexpr VkImageSubresourceRange range{
+		VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+
+	barrier::populate_cmd_barriers(
+		command_buffer,
+		std::nullopt,
+		std::array{barrier::image_barrier(image, range, {}, state_of(Access::kTransferWrite))});
+
+	std::vector<VkBufferImageCopy> regions;
+	for (uint32_t level = first_level; level < ktx.levels.size(); ++level)
+	{
+		VkExtent2D const extent = ktx2::level_extent(ktx.extent, level);
+		regions.push_back(VkBufferImageCopy{
+			.bufferOffset = level_offsets[level - first_level],
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - first_level, 0, 1},
+			.imageOffset = {0, 0, 0},
+			.imageExtent = {extent.width, extent.height, 1}});
+	}
+	vkCmdCopyBufferToImage(
+		command_buffer,
+		staging_buffer,
+		image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()),
+		regions.data());
+
+	barrier::populate_cmd_barriers(
+		command_buffer,
+		std::nullopt,
+		std::array{
+			barrier::image_barrier(image, range, state_of(Access::kTransferWrite), kSampleable)});
+}
+}  // namespace
+
+uint32_t desired_level(
+	VkExtent2D const extent, uint32_t const level_count, float const projected_size)
+{
+	uint32_t const last_level = level_count - 1;
+	if (!(projected_size >= 1.0F))
+		return last_level;
+
+	// Largest level whose texels are no smaller than the projected pixels.
+	float const ratio =
+		static_cast<float>(std::max(extent.width, extent.height)) / projected_size;
+	if (ratio <= 1.0F)
+		return 0;
+	return std::min(static_cast<uint32_t>(std::floor(std::log2(ratio))), last_level);
+}
+
+float stream_priority(float const projected_size, float const distance)
+{
+	// Screen area, attenuated by distance so that nearby textures win ties.
+	return projected_size * projected_size / (1.0F + std::max(distance, 0.0F));
+}
+
+TextureStreamer::TextureStreamer(
+	LoggerPtr logger,
+	types::VulkanDevicePtr device,
+	VkPhysicalDevice physical_device,
+	types::VulkanQueueFamilyIdx const queue_family_idx,
+	StreamingConfig const config)
+	: logger_{std::move(logger)},
+	  device_{std::move(device)},
+	  physical_device_{physical_device},
+	  config_{config},
+	  staging_memory_type_idx_{
+		  setup::filter_available_memory_types(
+			  logger_,
+			  physical_device,
+			  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+			  .at(0)},
+	  command_pool_{setup::create_command_pool(device_, queue_family_idx)}
+{
+	loader_ = std::jthread{[this] { load(); }};
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard const lock{mutex_};
+		stopping_ = true;
+		queued_loads_.clear();
+	}
+	queued_.notify_one();
+	loader_.join();
+
+	// Staging buffers and images may still be in use by submitted uploads.
+	for (Upload const & upload : uploads_)
+	{
+		VkFence fence = upload.fence.get();
+		VK_CHECK(
+			vkWaitForFences(
+				device_.get(), 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max()),
+			"Failed to wait for texture upload fence");
+	}
+}
+
+TextureId TextureStreamer::add_texture(std::filesystem::path const & path)
+{
+	ktx2::MappedFile file = ktx2::map_file(path);
+	ktx2::Ktx2Texture ktx = ktx2::parse_ktx2(file.bytes());
+	uint32_t const tail_level = tail_level_of(ktx, config_.mip_tail_size);
+
+	Image tail = create_image(ktx, tail_level);
+	tail_bytes_ += tail.size;
+
+	TextureId const texture_id{static_cast<uint32_t>(textures_.size())};
+	pending_tails_.emplace_back(texture_id, create_staging(ktx, tail_level));
+
+	textures_.push_back(Texture{
+		.file = std::move(file),
+		.ktx = std::move(ktx),
+		.tail_level = tail_level,
+		.tail = std::move(tail),
+		.streamed = std::nullopt,
+		.streamed_level = tail_level,
+		.loading_level = std::nullopt,
+		.loading_size = 0,
+		.wanted_level = tail_level,
+		.priority = 0,
+		.last_used_frame = std::nullopt,
+		.generation = 0});
+	return texture_id;
+}
+
+void TextureStreamer::request(
+	TextureId const texture_id, float const projected_size, float const distance)
+{
+	Texture & texture = textures_.at(texture_id);
+	uint32_t const level = desired_level(
+		texture.ktx.extent, static_cast<uint32_t>(texture.ktx.levels.size()), projected_size);
+	float const priority = stream_priority(projected_size, distance);
+
+	if (texture.last_used_frame != frame_)
+	{
+		texture.last_used_frame = frame_;
+		texture.wanted_level = level;
+		texture.priority = priority;
+		return;
+	}
+	texture.wanted_level = std::min(texture.wanted_level, level);
+	texture.priority = std::max(texture.priority, priority);
+}
+
+void TextureStreamer::update(VkQueue queue)
+{
+	// Release staging memory of completed uploads.
+	std::erase_if(
+		uploads_,
+		[&](Upload const & upload)
+		{ return vkGetFenceStatus(device_.get(), upload.fence.get()) == VK_SUCCESS; });
+
+	// Destroy replaced images once no frame in flight can reference them.
+	std::erase_if(
+		retired_,
+		[&](Retired const & retired)
+		{ return frame_ >= retired.frame + config_.frames_in_flight; });
+
+	std::vector<Load> finished_loads;
+	{
+		std::lock_guard const lock{mutex_};
+		finished_loads.swap(finished_loads_);
+	}
+
+	if (!finished_loads.empty() || !pending_tails_.empty())
+	{
+		Upload upload{
+			.command_buffers = setup::create_primary_command_buffers(
+				device_, command_pool_, types::VulkanCommandBufferCount{1}),
+			.fence = setup::create_fence(device_, false),
+			.staging = {}};
+		VkCommandBuffer command_buffer = upload.command_buffers->front();
+
+		constexpr VkCommandBufferBeginInfo begin_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.pNext = nullptr,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			.pInheritanceInfo = nullptr};
+		VK_CHECK(
+			vkBeginCommandBuffer(command_buffer, &begin_info),
+			"Failed to begin texture upload command buffer");
+
+		for (auto & [texture_id, staging] : pending_tails_)
+		{
+			Texture const & texture = textures_[texture_id];
+			populate_cmd_upload(
+				command_buffer,
+				texture.tail.image.get(),
+				staging.buffer.get(),
+				texture.ktx,
+				texture.tail_level,
+				staging.level_offsets);
+			upload.staging.push_back(std::move(staging));
+		}
+		pending_tails_.clear();
+
+		for (Load & load : finished_loads)
+		{
+			Texture & texture = textures_[load.texture_id];
+			texture.loading_level.reset();
+			--pending_loads_;
+			if (!load.image || !load.staging)
+			{
+				streamed_bytes_ -= texture.loading_size;
+				continue;
+			}
+
+			populate_cmd_upload(
+				command_buffer,
+				load.image->image.get(),
+				load.staging->buffer.get(),
+				load.ktx,
+				load.first_level,
+				load.staging->level_offsets);
+			upload.staging.push_back(std::move(*load.staging));
+
+			// Submission order guarantees the upload completes before later frames sample it.
+			if (texture.streamed)
+			{
+				streamed_bytes_ -= texture.streamed->size;
+				retire(std::move(*texture.streamed));
+			}
+			texture.streamed = std::move(load.image);
+			texture.streamed_level = load.first_level;
+			++texture.generation;
+			++completed_loads_;
+		}
+
+		VK_CHECK(vkEndCommandBuffer(command_buffer), "Failed to end texture upload command buffer");
+		draw::submit_command_buffer(queue, command_buffer, nullptr, nullptr, upload.fence);
+		uploads_.push_back(std::move(upload));
+	}
+
+	// Start loads for textures used this frame that want more detail, most important first.
+	std::vector<TextureId> wanted;
+	for (uint32_t texture_idx = 0; texture_idx < textures_.size(); ++texture_idx)
+	{
+		Texture const & texture = textures_[texture_idx];
+		if (texture.last_used_frame == frame_ && !texture.loading_level &&
+			texture.wanted_level < texture.streamed_level)
+			wanted.emplace_back(texture_idx);
+	}
+	std::ranges::sort(
+		wanted,
+		std::ranges::greater{},
+		[&](TextureId const texture_id) { return textures_[texture_id].priority; });
+
+	for (TextureId const texture_id : wanted)
+	{
+		if (pending_loads_ >= config_.max_pending_loads)
+			break;
+
+		Texture & texture = textures_[texture_id];
+		// Fall back to less detail if the wanted level does not fit in the budget.
+		for (uint32_t level = texture.wanted_level; level < texture.streamed_level; ++level)
+		{
+			VkDeviceSize const size = image_size(texture.ktx, level);
+			if (!evict_for(size))
+				continue;
+
+			texture.loading_level = level;
+			texture.loading_size = size;
+			streamed_bytes_ += size;
+			++pending_loads_;
+			{
+				std::lock_guard const lock{mutex_};
+				queued_loads_.push_back(Load{
+					.texture_id = texture_id,
+					.first_level = level,
+					.file = texture.file,
+					.ktx = texture.ktx,
+					.image = std::nullopt,
+					.staging = std::nullopt});
+			}
+			queued_.notify_one();
+			break;
+		}
+	}
+
+	++frame_;
+}
+
+VkImageView TextureStreamer::view(TextureId const texture_id) const
+{
+	Texture const & texture = textures_.at(texture_id);
+	return texture.streamed ? texture.streamed->view.get() : texture.tail.view.get();
+}
+
+uint32_t TextureStreamer::resident_level(TextureId const texture_id) const
+{
+	return textures_.at(texture_id).streamed_level;
+}
+
+uint64_t TextureStreamer::generation(TextureId const texture_id) const
+{
+	return textures_.at(texture_id).generation;
+}
+
+StreamingStats TextureStreamer::stats() const
+{
+	return StreamingStats{
+		.tail_bytes = tail_bytes_,
+		.streamed_bytes = streamed_bytes_,
+		.pending_loads = pending_loads_,
+		.completed_loads = completed_loads_,
+		.evictions = evictions_};
+}
+
+TextureStreamer::Image TextureStreamer::create_image(
+	ktx2::Ktx2Texture const & ktx, uint32_t const first_level) const
+{
+	auto [image, memory] = setup::create_image_and_memory(
+		device_,
+		physical_device_,
+		ktx.format,
+		ktx2::level_extent(ktx.extent, first_level),
+		kImageUsage,
+		static_cast<uint32_t>(ktx.levels.size()) - first_level);
+	types::VulkanImageViewPtr view = setup::create_image_view(device_, image.get(), ktx.format);
+	return Image{
+		.image = std::move(image),
+		.memory = std::move(memory),
+		.view = std::move(view),
+		.size = image_size(ktx, first_level)};
+}
+
+TextureStreamer::Staging TextureStreamer::create_staging(
+	ktx2::Ktx2Texture const & ktx, uint32_t const first_level) const
+{
+	std::span<std::span<std::byte const> const> const levels =
+		std::span{ktx.levels}.subspan(first_level);
+
+	std::vector<VkDeviceSize> level_offsets;
+	VkDeviceSize size = 0;
+	for (std::span<std::byte const> const level : levels)
+	{
+		level_offsets.push_back(size);
+		size += level.size();
+		size = (size + kStagingAlignment - 1) / kStagingAlignment * kStagingAlignment;
+	}
+
+	auto [buffer, memory, mapped] = draw::create_exclusive_mapped_buffer_and_memory(
+		device_, staging_memory_type_idx_, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+	// Reads from the memory-mapped container, i.e. pages in from disk on first touch.
+	for (std::size_t level_idx = 0; level_idx < levels.size(); ++level_idx)
+		std::ranges::copy(
+			levels[level_idx],
+			mapped.begin() + static_cast<std::ptrdiff_t>(level_offsets[level_idx]));
+
+	return Staging{
+		.buffer = std::move(buffer),
+		.memory = std::move(memory),
+		.level_offsets = std::move(level_offsets)};
+}
+
+VkDeviceSize TextureStreamer::image_size(
+	ktx2::Ktx2Texture const & ktx, uint32_t const first_level) const
+{
+	VkImageCreateInfo const create_info = image_create_info(ktx, first_level);
+	VkDeviceImageMemoryRequirements const requirements_info{
+		.sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS,
+		.pNext = nullptr,
+		.pCreateInfo = &create_info,
+		.planeAspect = VK_IMAGE_ASPECT_COLOR_BIT};
+	VkMemoryRequirements2 requirements{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+		.pNext = nullptr,
+		.memoryRequirements = {}};
+	vkGetDeviceImageMemoryRequirements(device_.get(), &requirements_info, &requirements);
+	return requirements.memoryRequirements.size;
+}
+
+void TextureStreamer::retire(Image image)
+{
+	retired_.push_back(Retired{.frame = frame_, .image = std::move(image)});
+}
+
+bool TextureStreamer::evict_for(VkDeviceSize const size)
+{
+	if (streamed_bytes_ + size <= config_.budget)
+		return true;
+
+	// Textures not used this frame, least recently used first.
+	std::vector<TextureId> candidates;
+	VkDeviceSize evictable = 0;
+	for (uint32_t texture_idx = 0; texture_idx < textures_.size(); ++texture_idx)
+	{
+		Texture const & texture = textures_[texture_idx];
+		if (texture.streamed && texture.last_used_frame != frame_)
+		{
+			candidates.emplace_back(texture_idx);
+			evictable += texture.streamed->size;
+		}
+	}
+	if (streamed_bytes_ - evictable + size > config_.budget)
+		return false;
+
+	std::ranges::sort(
+		candidates,
+		std::ranges::less{},
+		[&](TextureId const texture_id) { return textures_[texture_id].last_used_frame; });
+
+	for (TextureId const texture_id : candidates)
+	{
+		if (streamed_bytes_ + size <= config_.budget)
+			break;
+		Texture & texture = textures_[texture_id];
+		streamed_bytes_ -= texture.streamed->size;
+		retire(std::move(*texture.streamed));
+		texture.streamed.reset();
+		texture.streamed_level = texture.tail_level;
+		++texture.generation;
+		++evictions_;
+	}
+	return true;
+}
+
+void TextureStreamer::load()
+{
+	while (true)
+	{
+		Load load;
+		{
+			std::unique_lock lock{mutex_};
+			queued_.wait(lock, [this] { return stopping_ || !queued_loads_.empty(); });
+			if (stopping_)
+				return;
+			load = std::move(queued_loads_.front());
+			queued_loads_.pop_front();
+		}
+
+		try
+		{
+			load.image = create_image(load.ktx, load.first_level);
+			load.staging = create_staging(load.ktx, load.first_level);
+		}
+		catch (std::exception const & exc)
+		{
+			logger_->error("Failed to load texture {}: {}", load.texture_id.value_of(), exc.what());
+			load.image.reset();
+			load.staging.reset();
+		}
+
+		std::lock_guard const lock{mutex_};
+		finished_loads_.push_back(std::move(load));
+	}
+}
+
+TEST_CASE("Choose streamed mip levels")
+{
+	constexpr VkExtent2D extent{1024, 512};
+	constexpr uint32_t level_count = 11;
+
+	CHECK(desired_level(extent, level_count, 2048) == 0);
+	CHECK(desired_level(extent, level_count, 1024) == 0);
+	CHECK(desired_level(extent, level_count, 1000) == 0);
+	CHECK(desired_level(extent, level_count, 512) == 1);
+	CHECK(desired_level(extent, level_count, 300) == 1);
+	CHECK(desired_level(extent, level_count, 1) == 10);
+	CHECK(desired_level(extent, level_count, 0) == 10);
+	CHECK(desired_level(extent, 4, 1) == 3);
+
+	CHECK(stream_priority(100, 0) > stream_priority(50, 0));
+	CHECK(stream_priority(100, 1) < stream_priority(100, 0));
+	CHECK(stream_priority(100, 1) > stream_priority(50, 1));
+}
+
+TEST_CASE("Stream textures under a memory budget")
+{
+	vulkandemo::LoggerPtr const logger =
+		vulkandemo::create_logger("Stream textures under a memory budget");
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		nullptr,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan13_features};
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{},
+		&features);
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	// Full mip chains of 256x256 RGBA, with a 32x32 tail.
+	constexpr VkExtent2D extent{256, 256};
+	constexpr uint32_t level_count = 9;
+	constexpr uint32_t tail_level = 3;
+	std::filesystem::path const directory =
+		std::filesystem::temp_directory_path() / "vulkandemo_streaming_test";
+	std::filesystem::create_directories(directory);
+
+	std::vector<std::filesystem::path> paths;
+	for (uint32_t texture_idx = 0; texture_idx < 3; ++texture_idx)
+	{
+		std::vector<std::vector<std::byte>> levels;
+		for (uint32_t level = 0; level < level_count; ++level)
+		{
+			VkExtent2D const size = ktx2::level_extent(extent, level);
+			levels.emplace_back(
+				std::size_t{size.width} * size.height * 4,
+				static_cast<std::byte>(texture_idx * 16 + level));
+		}
+		std::vector<std::byte> const encoded =
+			ktx2::encode_ktx2(VK_FORMAT_R8G8B8A8_UNORM, extent, levels);
+
+		paths.push_back(directory / std::format("texture_{}.ktx2", texture_idx));
+		std::ofstream file{paths.back(), std::ios::binary};
+		file.write(
+			reinterpret_cast<char const *>(encoded.data()),	 // NOLINT(*-reinterpret-cast)
+			static_cast<std::streamsize>(encoded.size()));
+	}
+
+	// Room for one full resolution texture at a time.
+	constexpr VkDeviceSize full_size = VkDeviceSize{256} * 256 * 4 * 4 / 3;
+	TextureStreamer streamer{
+		logger,
+		device,
+		physical_device,
+		queue_family_idx,
+		{.budget = full_size * 3 / 2,
+		 .mip_tail_size = 32,
+		 .frames_in_flight = 2,
+		 .max_pending_loads = 4}};
+
+	std::vector<TextureId> const texture_ids =
+		paths |
+		std::views::transform([&](std::filesystem::path const & path)
+							  { return streamer.add_texture(path); }) |
+		ranges::to<std::vector>();
+
+	streamer.update(queue);
+	VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+
+	for (TextureId const texture_id : texture_ids)
+	{
+		CHECK(streamer.resident_level(texture_id) == tail_level);
+		CHECK(streamer.view(texture_id) != nullptr);
+	}
+	CHECK(streamer.stats().tail_bytes > 0);
+	CHECK(streamer.stats().streamed_bytes == 0);
+
+	// Render frames requesting a texture at full size until it is resident.
+	auto const stream_in = [&](TextureId const texture_id)
+	{
+		for (int frame = 0; frame < 1000 && streamer.resident_level(texture_id) != 0; ++frame)
+		{
+			streamer.request(texture_id, 256, 1);
+			streamer.update(queue);
+			VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+			std::this_thread::sleep_for(std::chrono::milliseconds{1});
+		}
+		return streamer.resident_level(texture_id);
+	};
+
+	uint64_t const generation = streamer.generation(texture_ids[0]);
+	REQUIRE(stream_in(texture_ids[0]) == 0);
+	CHECK(streamer.generation(texture_ids[0]) > generation);
+	CHECK(streamer.stats().completed_loads == 1);
+	CHECK(streamer.stats().evictions == 0);
+	CHECK(streamer.stats().streamed_bytes <= full_size * 3 / 2);
+
+	// Least recently used texture is evicted to make room for the next.
+	REQUIRE(stream_in(texture_ids[1]) == 0);
+	CHECK(streamer.resident_level(texture_ids[0]) == tail_level);
+	CHECK(streamer.stats().evictions == 1);
+	CHECK(streamer.stats().streamed_bytes <= full_size * 3 / 2);
+
+	// Distant small textures only need their tail.
+	streamer.request(texture_ids[2], 8, 100);
+	streamer.update(queue);
+	CHECK(streamer.stats().pending_loads == 0);
+	CHECK(streamer.resident_level(texture_ids[2]) == tail_level);
+
+	VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+	std::filesystem::remove_all(directory);
+}
+}  // namespace vulkandemo::streaming
@@ -0,0 +1,276 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include <strong_type/equality.hpp>
+#include <strong_type/implicitly_convertible_to.hpp>
+#include <strong_type/ordered.hpp>
+#include <strong_type/regular.hpp>
+#include <strong_type/type.hpp>
+
+#include "Logger.hpp"
+#include "ktx2.hpp"
+#include "types.hpp"
+
+/**
+ * Texture streaming from memory-mapped KTX2 containers.
+ *
+ * Only the small mip tail of each texture is uploaded when it is added, so startup cost does not
+ * depend on total texture size. Each frame, the renderer reports which textures it uses and how
+ * large they appear on screen. Higher mips are then loaded by a background thread, most important
+ * first, while device memory for them stays within a budget by evicting the least recently used
+ * textures back to their mip tail.
+ *
+ * A texture's mips above the tail live in a single image that is replaced whenever its resident
+ * level changes, so renderers must rebind a texture's view whenever its generation changes.
+ */
+namespace vulkandemo::streaming
+{
+using TextureId = strong::type<
+	uint32_t,
+	struct TagForStreamedTextureId,
+	strong::regular,
+	strong::implicitly_convertible_to<uint32_t, std::size_t>,
+	strong::equality,
+	strong::strongly_ordered>;
+
+struct StreamingConfig
+{
+	/// Device memory for mip levels above the tails. Tails are always resident.
+	VkDeviceSize budget = VkDeviceSize{256} << 20U;
+	/// Levels whose width and height are at most this many texels form the always resident tail.
+	uint32_t mip_tail_size = 64;
+	/// Frames that may be in flight, after which replaced images are no longer in use.
+	std::size_t frames_in_flight = 2;
+	/// Loads in progress at once. Bounds staging memory and upload cost per frame.
+	std::size_t max_pending_loads = 4;
+};
+
+struct StreamingStats
+{
+	VkDeviceSize tail_bytes;
+	/// Device memory of streamed levels, including loads in progress.
+	VkDeviceSize streamed_bytes;
+	std::size_t pending_loads;
+	std::size_t completed_loads;
+	std::size_t evictions;
+};
+
+/**
+ * Most detailed mip level worth having resident for a texture of a given size on screen.
+ *
+ * @param extent Extent of level 0.
+ * @param level_count
+ * @param projected_size Size of the larger texture dimension on screen, in pixels.
+ * @return
+ */
+uint32_t desired_level(VkExtent2D extent, uint32_t level_count, float projected_size);
+
+/**
+ * Relative importance of streaming a texture in, by screen coverage and distance.
+ *
+ * @param projected_size Size of the larger texture dimension on screen, in pixels.
+ * @param distance Distance from the camera.
+ * @return
+ */
+float stream_priority(float projected_size, float distance);
+
+/**
+ * Streams mip levels of textures in and out, on a single queue.
+ *
+ * All member functions must be called from a single (render) thread.
+ */
+class TextureStreamer
+{
+public:
+	/**
+	 * Start the loader thread.
+	 *
+	 * @param logger
+	 * @param device Must have the synchronization2 feature enabled.
+	 * @param physical_device
+	 * @param queue_family_idx Family of the queue passed to update.
+	 * @param config
+	 */
+	TextureStreamer(
+		LoggerPtr logger,
+		types::VulkanDevicePtr device,
+		VkPhysicalDevice physical_device,
+		types::VulkanQueueFamilyIdx queue_family_idx,
+		StreamingConfig config);
+	/**
+	 * Stop the loader thread and wait for submitted uploads.
+	 *
+	 * Submitted work that samples the textures must have completed.
+	 */
+	~TextureStreamer();
+
+	TextureStreamer(TextureStreamer const &) = delete;
+	TextureStreamer(TextureStreamer &&) = delete;
+	TextureStreamer & operator=(TextureStreamer const &) = delete;
+	TextureStreamer & operator=(TextureStreamer &&) = delete;
+
+	/**
+	 * Map a KTX2 container and create its mip tail image.
+	 *
+	 * The tail is uploaded by the next update, which must be submitted before the texture is
+	 * first sampled.
+	 *
+	 * @param path
+	 * @return
+	 */
+	TextureId add_texture(std::filesystem::path const & path);
+
+	/**
+	 * Report that a texture is used by the current frame.
+	 *
+	 * May be called several times per frame, in which case the largest projection wins.
+	 *
+	 * @param texture_id
+	 * @param projected_size Size of the larger texture dimension on screen, in pixels.
+	 * @param distance Distance from the camera.
+	 */
+	void request(TextureId texture_id, float projected_size, float distance);
+
+	/**
+	 * Submit uploads of completed loads and pending mip tails, evict least recently used textures
+	 * if over budget, and start loads for this frame's requests.
+	 *
+	 * Call once per frame, after requests and before submitting work that samples the textures.
+	 *
+	 * @param queue
+	 */
+	void update(VkQueue queue);
+
+	/**
+	 * @param texture_id
+	 * @return View of all resident mip levels, in shader read only layout.
+	 */
+	[[nodiscard]] VkImageView view(TextureId texture_id) const;
+
+	/**
+	 * @param texture_id
+	 * @return Most detailed resident mip level.
+	 */
+	[[nodiscard]] uint32_t resident_level(TextureId texture_id) const;
+
+	/**
+	 * @param texture_id
+	 * @return Incremented whenever the texture's view changes.
+	 */
+	[[nodiscard]] uint64_t generation(TextureId texture_id) const;
+
+	[[nodiscard]] StreamingStats stats() const;
+
+private:
+	struct Image
+	{
+		types::VulkanImagePtr image;
+		types::VulkanDeviceMemoryPtr memory;
+		types::VulkanImageViewPtr view;
+		VkDeviceSize size;
+	};
+
+	struct Staging
+	{
+		types::VulkanBufferPtr buffer;
+		types::VulkanDeviceMemoryPtr memory;
+		/// Offset within the buffer of each uploaded level.
+		std::vector<VkDeviceSize> level_offsets;
+	};
+
+	struct Texture
+	{
+		ktx2::MappedFile file;
+		ktx2::Ktx2Texture ktx;
+		/// First level of the tail.
+		uint32_t tail_level;
+		Image tail;
+		/// Levels from streamed_level to the last level, if any above the tail are resident.
+		std::optional<Image> streamed;
+		uint32_t streamed_level;
+		std::optional<uint32_t> loading_level;
+		/// Reservation against the budget of the load in progress.
+		VkDeviceSize loading_size;
+		/// Requested level and priority, valid if last used this frame.
+		uint32_t wanted_level;
+		float priority;
+		std::optional<uint64_t> last_used_frame;
+		uint64_t generation;
+	};
+
+	/// Levels loaded into a new image by the loader thread, ready to be uploaded.
+	struct Load
+	{
+		TextureId texture_id;
+		uint32_t first_level;
+		/// Copied, so the loader thread never touches textures_.
+		ktx2::MappedFile file;
+		ktx2::Ktx2Texture ktx;
+		/// Unset if loading failed.
+		std::optional<Image> image;
+		std::optional<Staging> staging;
+	};
+
+	struct Upload
+	{
+		types::VulkanCommandBuffersPtr command_buffers;
+		types::VulkanFencePtr fence;
+		std::vector<Staging> staging;
+	};
+
+	struct Retired
+	{
+		uint64_t frame;
+		Image image;
+	};
+
+	Image create_image(ktx2::Ktx2Texture const & ktx, uint32_t first_level) const;
+	Staging create_staging(ktx2::Ktx2Texture const & ktx, uint32_t first_level) const;
+	VkDeviceSize image_size(ktx2::Ktx2Texture const & ktx, uint32_t first_level) const;
+	void retire(Image image);
+	bool evict_for(VkDeviceSize size);
+	void load();
+
+	LoggerPtr logger_;
+	types::VulkanDevicePtr device_;
+	VkPhysicalDevice physical_device_;
+	StreamingConfig config_;
+	types::VulkanMemoryTypeIdx staging_memory_type_idx_;
+	types::VulkanCommandPoolPtr command_pool_;
+
+	std::vector<Texture> textures_;
+	/// Tails created by add_texture, awaiting upload.
+	std::vector<std::pair<TextureId, Staging>> pending_tails_;
+	std::vector<Upload> uploads_;
+	std::vector<Retired> retired_;
+	uint64_t frame_ = 0;
+	VkDeviceSize tail_bytes_ = 0;
+	VkDeviceSize streamed_bytes_ = 0;
+	std::size_t pending_loads_ = 0;
+	std::size_t completed_loads_ = 0;
+	std::size_t evictions_ = 0;
+
+	std::mutex mutex_;
+	std::condition_variable queued_;
+	/// Loads for the loader thread, most important first.
+	std::deque<Load> queued_loads_;
+	std::vector<Load> finished_loads_;
+	bool stopping_ = false;
+
+	/// Last member, so it is joined before anything it uses is destroyed.
+	std::jthread loader_;
+};
+}  // namespace vulkandemo::streaming
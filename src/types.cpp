@@ -173,6 +173,28 @@ VulkanSemaphorePtr make_semaphore_ptr(VulkanDevicePtr device, VkSemaphore semaph
 		}};
 }
 
+VulkanFencePtr make_fence_ptr(VulkanDevicePtr device, VkFence fence)
+{
+	return VulkanFencePtr{
+		fence,
+		[device = std::move(device)](VkFence ptr)
+		{
+			if (ptr != nullptr)
+				vkDestroyFence(device.get(), ptr, nullptr);
+		}};
+}
+
+VulkanImagePtr make_image_ptr(VulkanDevicePtr device, VkImage image)
+{
+	return VulkanImagePtr{
+		image,
+		[device = std::move(device)](VkImage ptr)
+		{
+			if (ptr != nullptr)
+				vkDestroyImage(device.get(), ptr, nullptr);
+		}};
+}
+
 VulkanBufferPtr make_buffer_ptr(VulkanDevicePtr device, VkBuffer buffer)
 {
 	return VulkanBufferPtr{
@@ -206,4 +228,72 @@ VulkanPipelineLayoutPtr make_pipeline_layout_ptr(
 				vkDestroyPipelineLayout(device.get(), ptr, nullptr);
 		}};
 }
+
+VulkanShaderModulePtr make_shader_module_ptr(VulkanDevicePtr device, VkShaderModule shader_module)
+{
+	return VulkanShaderModulePtr{
+		shader_module,
+		[device = std::move(device)](VkShaderModule ptr)
+		{
+			if (ptr != nullptr)
+				vkDestroyShaderModule(device.get(), ptr, nullptr);
+		}};
+}
+
+VulkanPipelinePtr make_pipeline_ptr(VulkanDevicePtr device, VkPipeline pipeline)
+{
+	return VulkanPipelinePtr{
+		pipeline,
+		[device = std::move(device)](VkPipeline ptr)
+		{
+			if (ptr != nullptr)
+				vkDestroyPipeline(device.get(), ptr, nullptr);
+		}};
+}
+
+VulkanDescriptorSetLayoutPtr make_descriptor_set_layout_ptr(
+	VulkanDevicePtr device, VkDescriptorSetLayout descriptor_set_layout)
+{
+	return VulkanDescriptorSetLayoutPtr{
+		descriptor_set_layout,
+		[device = std::move(device)](VkDescriptorSetLayout ptr)
+		{
+			if (ptr != nullptr)
+				vkDestroyDescriptorSetLayout(device.get(), ptr, nullptr);
+		}};
+}
+
+VulkanDescriptorPoolPtr make_descriptor_pool_ptr(
+	VulkanDevicePtr device, VkDescriptorPool descriptor_pool)
+{
+	return VulkanDescriptorPoolPtr{
+		descriptor_pool,
+		[device = std::move(device)](VkDescriptorPool ptr)
+		{
+			if (ptr != nullptr)
+				vkDestroyDescriptorPool(device.get(), ptr, nullptr);
+		}};
+}
+
+VulkanSamplerPtr make_sampler_ptr(VulkanDevicePtr device, VkSampler sampler)
+{
+	return VulkanSamplerPtr{
+		sampler,
+		[device = std::move(device)](VkSampler ptr)
+		{
+			if (ptr != nullptr)
+				vkDestroySampler(device.get(), ptr, nullptr);
+		}};
+}
+
+VulkanQueryPoolPtr make_query_pool_ptr(VulkanDevicePtr device, VkQueryPool query_pool)
+{
+	return VulkanQueryPoolPtr{
+		query_pool,
+		[device = std::move(device)](VkQueryPool ptr)
+		{
+			if (ptr != nullptr)
+				vkDestroyQueryPool(device.get(), ptr, nullptr);
+		}};
+}
 }  // namespace vulkandemo::types
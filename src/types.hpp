@@ -78,6 +78,12 @@ VulkanCommandBuffersPtr make_command_buffers_ptr(
 using VulkanSemaphorePtr = std::shared_ptr<std::remove_pointer_t<VkSemaphore>>;
 VulkanSemaphorePtr make_semaphore_ptr(VulkanDevicePtr device, VkSemaphore semaphore);
 
+using VulkanFencePtr = std::shared_ptr<std::remove_pointer_t<VkFence>>;
+VulkanFencePtr make_fence_ptr(VulkanDevicePtr device, VkFence fence);
+
+using VulkanImagePtr = std::shared_ptr<std::remove_pointer_t<VkImage>>;
+VulkanImagePtr make_image_ptr(VulkanDevicePtr device, VkImage image);
+
 using VulkanBufferPtr = std::shared_ptr<std::remove_pointer_t<VkBuffer>>;
 VulkanBufferPtr make_buffer_ptr(VulkanDevicePtr device, VkBuffer buffer);
 
@@ -87,6 +93,26 @@ VulkanDeviceMemoryPtr make_device_memory_ptr(VulkanDevicePtr device, VkDeviceMem
 using VulkanPipelineLayoutPtr = std::shared_ptr<std::remove_pointer_t<VkPipelineLayout>>;
 VulkanPipelineLayoutPtr make_pipeline_layout_ptr(VulkanDevicePtr device, VkPipelineLayout pipeline_layout);
 
+using VulkanShaderModulePtr = std::shared_ptr<std::remove_pointer_t<VkShaderModule>>;
+VulkanShaderModulePtr make_shader_module_ptr(VulkanDevicePtr device, VkShaderModule shader_module);
+
+using VulkanPipelinePtr = std::shared_ptr<std::remove_pointer_t<VkPipeline>>;
+VulkanPipelinePtr make_pipeline_ptr(VulkanDevicePtr device, VkPipeline pipeline);
+
+using VulkanDescriptorSetLayoutPtr = std::shared_ptr<std::remove_pointer_t<VkDescriptorSetLayout>>;
+VulkanDescriptorSetLayoutPtr make_descriptor_set_layout_ptr(
+	VulkanDevicePtr device, VkDescriptorSetLayout descriptor_set_layout);
+
+using VulkanDescriptorPoolPtr = std::shared_ptr<std::remove_pointer_t<VkDescriptorPool>>;
+VulkanDescriptorPoolPtr make_descriptor_pool_ptr(
+	VulkanDevicePtr device, VkDescriptorPool descriptor_pool);
+
+using VulkanSamplerPtr = std::shared_ptr<std::remove_pointer_t<VkSampler>>;
+VulkanSamplerPtr make_sampler_ptr(VulkanDevicePtr device, VkSampler sampler);
+
+using VulkanQueryPoolPtr = std::shared_ptr<std::remove_pointer_t<VkQueryPool>>;
+VulkanQueryPoolPtr make_query_pool_ptr(VulkanDevicePtr device, VkQueryPool query_pool);
+
 using VulkanImageIdx = strong::type<
 	uint32_t,
 	struct TagForVulkanImageIdx,
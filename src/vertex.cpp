@@ -0,0 +1,1287 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+
+// Conflicts with clang-tidy wrt vulkan handle typedefs:
+// ReSharper disable CppParameterMayBeConst
+// ReSharper disable CppLocalVariableMayBeConst
+
+#include "vertex.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include <spdlog/logger.h>	// NOLINT(misc-include-cleaner) for `logger`
+
+#include <doctest/doctest.h>
+
+#include <vulkan/vulkan_core.h>
+
+#include "Logger.hpp"
+#include "bench.hpp"
+#include "draw.hpp"
+#include "maths.hpp"
+#include "parallel.hpp"
+#include "setup.hpp"
+#include "shaders.hpp"
+#include "simd.hpp"
+#include "types.hpp"
+
+namespace vulkandemo::vertex
+{
+namespace
+{
+constexpr float kUnorm16Max = UINT16_MAX;
+constexpr float kSnorm16Max = INT16_MAX;
+constexpr float kSnorm10Max = 511;
+constexpr uint32_t kSnorm10Mask = 0x3FF;
+/// Two bit signed normalised plus and minus one, shifted into the alpha of A2B10G10R10.
+constexpr uint32_t kPositiveSign = 1U << 30U;
+constexpr uint32_t kNegativeSign = 3U << 30U;
+
+// Bits of floats and half floats used when converting between them.
+constexpr uint32_t kFloatSign = 0x8000'0000;
+constexpr uint32_t kFloatInfinity = 0x7F80'0000;
+/// Smallest float that rounds to half float infinity, i.e. 2^16.
+constexpr uint32_t kHalfOverflow = 0x4780'0000;
+/// Smallest normal half float, i.e. 2^-14.
+constexpr uint32_t kHalfMinNormal = 0x3880'0000;
+/// Adding 0.5 shifts the mantissa of a float below kHalfMinNormal down to the ten bits of a
+/// subnormal half, rounding to nearest even, as float addition does.
+constexpr float kSubnormalMagic = 0.5F;
+/// Rebias the exponent from float to half, plus just under half a half float ulp.
+constexpr uint32_t kHalfRebiasAndRound = 0xC800'0FFF;
+constexpr uint32_t kHalfInfinity = 0x7C00;
+constexpr uint32_t kHalfNan = 0x7E00;
+constexpr uint32_t kHalfMantissaShift = 13;
+
+/**
+ * Offset and scale mapping positions within the bounds onto [0, kUnorm16Max].
+ */
+struct Quantisation
+{
+	std::array<float, 3> offset;
+	std::array<float, 3> scale;
+};
+
+Quantisation make_quantisation(Bounds const & bounds)
+{
+	auto const scale = [](float const min, float const max)
+	{ return max > min ? kUnorm16Max / (max - min) : 0.0F; };
+	return {
+		.offset = {bounds.min.x, bounds.min.y, bounds.min.z},
+		.scale = {
+			scale(bounds.min.x, bounds.max.x),
+			scale(bounds.min.y, bounds.max.y),
+			scale(bounds.min.z, bounds.max.z)}};
+}
+
+void check_length(std::size_t const expected, std::size_t const actual)
+{
+	if (actual != expected)
+		throw std::invalid_argument{"Vertex streams differ in length"};
+}
+
+void check_lengths(VertexStreams const & streams, std::span<PackedVertex const> const out)
+{
+	std::size_t const count = streams.positions.x.size();
+	check_length(count, streams.positions.y.size());
+	check_length(count, streams.positions.z.size());
+	check_length(count, out.size());
+	for (maths::ConstVec3Span const & optional : {streams.normals, streams.tangents})
+	{
+		if (optional.x.empty())
+			continue;
+		check_length(count, optional.x.size());
+		check_length(count, optional.y.size());
+		check_length(count, optional.z.size());
+	}
+	if (!streams.u.empty())
+	{
+		check_length(count, streams.u.size());
+		check_length(count, streams.v.size());
+	}
+	if (!streams.tangents.x.empty())
+		check_length(count, streams.tangent_signs.size());
+}
+
+/**
+ * Pack vertices `[begin, end)`.
+ */
+using RangeKernel = void (*)(
+	VertexStreams const & streams,
+	Quantisation const & quantisation,
+	std::span<PackedVertex> out,
+	std::size_t begin,
+	std::size_t end);
+
+// All kernels quantise with the same sequence of correctly rounded operations, converting to
+// integers by rounding to nearest even, so results are identical across kernels. Each attribute
+// kernel processes `[begin, end)`, and SIMD kernels finish any remainder with the scalar kernel.
+
+void pack_positions_scalar(
+	maths::ConstVec3Span const & positions,
+	Quantisation const & quantisation,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	auto const quantise = [&](float const value, std::size_t const axis)
+	{
+		float const scaled = (value - quantisation.offset[axis]) * quantisation.scale[axis];
+		return static_cast<uint16_t>(std::lrint(std::clamp(scaled, 0.0F, kUnorm16Max)));
+	};
+	for (std::size_t idx = begin; idx < end; ++idx)
+	{
+		out[idx].position = {
+			quantise(positions.x[idx], 0),
+			quantise(positions.y[idx], 1),
+			quantise(positions.z[idx], 2),
+			UINT16_MAX};
+	}
+}
+
+void pack_normals_scalar(
+	maths::ConstVec3Span const & normals,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	for (std::size_t idx = begin; idx < end; ++idx)
+	{
+		float const x = normals.x[idx];
+		float const y = normals.y[idx];
+		float const z = normals.z[idx];
+		// Project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half outwards over
+		// the diagonals of the upper half.
+		float const norm = std::abs(x) + std::abs(y) + std::abs(z);
+		float oct_x = x / norm;
+		float oct_y = y / norm;
+		if (z < 0)
+		{
+			float const folded_x = (1 - std::abs(oct_y)) * std::copysign(1.0F, oct_x);
+			oct_y = (1 - std::abs(oct_x)) * std::copysign(1.0F, oct_y);
+			oct_x = folded_x;
+		}
+		out[idx].normal = {
+			static_cast<int16_t>(std::lrint(oct_x * kSnorm16Max)),
+			static_cast<int16_t>(std::lrint(oct_y * kSnorm16Max))};
+	}
+}
+
+void pack_uvs_scalar(
+	std::span<float const> const u,
+	std::span<float const> const v,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	for (std::size_t idx = begin; idx < end; ++idx)
+		out[idx].uv = {float_to_half(u[idx]), float_to_half(v[idx])};
+}
+
+void pack_tangents_scalar(
+	maths::ConstVec3Span const & tangents,
+	std::span<float const> const signs,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	auto const quantise = [](float const value)
+	{
+		float const clamped = std::clamp(value, -1.0F, 1.0F);
+		return static_cast<uint32_t>(std::lrint(clamped * kSnorm10Max)) & kSnorm10Mask;
+	};
+	for (std::size_t idx = begin; idx < end; ++idx)
+	{
+		out[idx].tangent = quantise(tangents.x[idx]) | (quantise(tangents.y[idx]) << 10U) |
+			(quantise(tangents.z[idx]) << 20U) |
+			(signs[idx] < 0 ? kNegativeSign : kPositiveSign);
+	}
+}
+
+void pack_range_scalar(
+	VertexStreams const & streams,
+	Quantisation const & quantisation,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	pack_positions_scalar(streams.positions, quantisation, out, begin, end);
+	if (!streams.normals.x.empty())
+		pack_normals_scalar(streams.normals, out, begin, end);
+	if (!streams.u.empty())
+		pack_uvs_scalar(streams.u, streams.v, out, begin, end);
+	if (!streams.tangents.x.empty())
+		pack_tangents_scalar(streams.tangents, streams.tangent_signs, out, begin, end);
+}
+
+#if defined(__x86_64__)
+// SSE2 is part of the x86-64 baseline, so needs no runtime check.
+
+std::array<int32_t, 4> lanes(__m128i const value)
+{
+	std::array<int32_t, 4> out{};
+	// NOLINTNEXTLINE(*-reinterpret-cast)
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(out.data()), value);
+	return out;
+}
+
+/// Select lanes of @p if_true where @p mask is set, else of @p if_false.
+__m128i select(__m128i const mask, __m128i const if_true, __m128i const if_false)
+{
+	return _mm_or_si128(_mm_and_si128(mask, if_true), _mm_andnot_si128(mask, if_false));
+}
+
+__m128 select(__m128 const mask, __m128 const if_true, __m128 const if_false)
+{
+	return _mm_or_ps(_mm_and_ps(mask, if_true), _mm_andnot_ps(mask, if_false));
+}
+
+/// See float_to_half.
+__m128i float_to_half_sse2(__m128 const value)
+{
+	__m128i const bits = _mm_castps_si128(value);
+	__m128i const sign = _mm_and_si128(bits, _mm_set1_epi32(static_cast<int32_t>(kFloatSign)));
+	__m128i const magnitude = _mm_xor_si128(bits, sign);
+
+	// Magnitudes are below 2^31, so signed comparison suffices.
+	__m128i const is_nan = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(kFloatInfinity));
+	__m128i const overflow =
+		select(is_nan, _mm_set1_epi32(kHalfNan), _mm_set1_epi32(kHalfInfinity));
+	__m128i const is_overflow = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(kHalfOverflow - 1));
+
+	__m128 const magic = _mm_set1_ps(kSubnormalMagic);
+	__m128i const subnormal = _mm_sub_epi32(
+		_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(magnitude), magic)), _mm_castps_si128(magic));
+	__m128i const is_subnormal = _mm_cmplt_epi32(magnitude, _mm_set1_epi32(kHalfMinNormal));
+
+	__m128i const odd =
+		_mm_and_si128(_mm_srli_epi32(magnitude, kHalfMantissaShift), _mm_set1_epi32(1));
+	__m128i const normal = _mm_srli_epi32(
+		_mm_add_epi32(
+			_mm_add_epi32(
+				magnitude, _mm_set1_epi32(static_cast<int32_t>(kHalfRebiasAndRound))),
+			odd),
+		kHalfMantissaShift);
+
+	__m128i const half =
+		select(is_overflow, overflow, select(is_subnormal, subnormal, normal));
+	return _mm_or_si128(half, _mm_srli_epi32(sign, 16));
+}
+
+void pack_positions_sse2(
+	maths::ConstVec3Span const & positions,
+	Quantisation const & quantisation,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	constexpr std::size_t lane_count = 4;
+	std::array<float const *, 3> const inputs{
+		positions.x.data(), positions.y.data(), positions.z.data()};
+	__m128 const zero = _mm_setzero_ps();
+	__m128 const max = _mm_set1_ps(kUnorm16Max);
+	std::size_t idx = begin;
+	for (; idx + lane_count <= end; idx += lane_count)
+	{
+		std::array<std::array<int32_t, lane_count>, 3> quantised{};
+		for (std::size_t axis = 0; axis < 3; ++axis)
+		{
+			__m128 const scaled = _mm_mul_ps(
+				_mm_sub_ps(
+					_mm_loadu_ps(&inputs[axis][idx]), _mm_set1_ps(quantisation.offset[axis])),
+				_mm_set1_ps(quantisation.scale[axis]));
+			quantised[axis] = lanes(_mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(scaled, zero), max)));
+		}
+		for (std::size_t lane = 0; lane < lane_count; ++lane)
+		{
+			out[idx + lane].position = {
+				static_cast<uint16_t>(quantised[0][lane]),
+				static_cast<uint16_t>(quantised[1][lane]),
+				static_cast<uint16_t>(quantised[2][lane]),
+				UINT16_MAX};
+		}
+	}
+	pack_positions_scalar(positions, quantisation, out, idx, end);
+}
+
+void pack_normals_sse2(
+	maths::ConstVec3Span const & normals,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	constexpr std::size_t lane_count = 4;
+	__m128 const sign_mask = _mm_set1_ps(-0.0F);
+	__m128 const one = _mm_set1_ps(1.0F);
+	__m128 const snorm_max = _mm_set1_ps(kSnorm16Max);
+	std::size_t idx = begin;
+	for (; idx + lane_count <= end; idx += lane_count)
+	{
+		__m128 const x = _mm_loadu_ps(&normals.x[idx]);
+		__m128 const y = _mm_loadu_ps(&normals.y[idx]);
+		__m128 const z = _mm_loadu_ps(&normals.z[idx]);
+		__m128 const norm = _mm_add_ps(
+			_mm_add_ps(_mm_andnot_ps(sign_mask, x), _mm_andnot_ps(sign_mask, y)),
+			_mm_andnot_ps(sign_mask, z));
+		__m128 const oct_x = _mm_div_ps(x, norm);
+		__m128 const oct_y = _mm_div_ps(y, norm);
+		__m128 const folded_x = _mm_mul_ps(
+			_mm_sub_ps(one, _mm_andnot_ps(sign_mask, oct_y)),
+			_mm_or_ps(_mm_and_ps(sign_mask, oct_x), one));
+		__m128 const folded_y = _mm_mul_ps(
+			_mm_sub_ps(one, _mm_andnot_ps(sign_mask, oct_x)),
+			_mm_or_ps(_mm_and_ps(sign_mask, oct_y), one));
+		__m128 const is_lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+		std::array const quantised_x = lanes(
+			_mm_cvtps_epi32(_mm_mul_ps(select(is_lower, folded_x, oct_x), snorm_max)));
+		std::array const quantised_y = lanes(
+			_mm_cvtps_epi32(_mm_mul_ps(select(is_lower, folded_y, oct_y), snorm_max)));
+		for (std::size_t lane = 0; lane < lane_count; ++lane)
+		{
+			out[idx + lane].normal = {
+				static_cast<int16_t>(quantised_x[lane]), static_cast<int16_t>(quantised_y[lane])};
+		}
+	}
+	pack_normals_scalar(normals, out, idx, end);
+}
+
+void pack_uvs_sse2(
+	std::span<float const> const u,
+	std::span<float const> const v,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	constexpr std::size_t lane_count = 4;
+	std::size_t idx = begin;
+	for (; idx + lane_count <= end; idx += lane_count)
+	{
+		std::array const half_u = lanes(float_to_half_sse2(_mm_loadu_ps(&u[idx])));
+		std::array const half_v = lanes(float_to_half_sse2(_mm_loadu_ps(&v[idx])));
+		for (std::size_t lane = 0; lane < lane_count; ++lane)
+		{
+			out[idx + lane].uv = {
+				static_cast<uint16_t>(half_u[lane]), static_cast<uint16_t>(half_v[lane])};
+		}
+	}
+	pack_uvs_scalar(u, v, out, idx, end);
+}
+
+void pack_tangents_sse2(
+	maths::ConstVec3Span const & tangents,
+	std::span<float const> const signs,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	constexpr std::size_t lane_count = 4;
+	__m128 const minus_one = _mm_set1_ps(-1.0F);
+	__m128 const one = _mm_set1_ps(1.0F);
+	__m128 const snorm_max = _mm_set1_ps(kSnorm10Max);
+	__m128i const mask = _mm_set1_epi32(kSnorm10Mask);
+	auto const quantise = [&](float const * const values)
+	{
+		__m128 const clamped = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(values), minus_one), one);
+		return _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(clamped, snorm_max)), mask);
+	};
+	std::size_t idx = begin;
+	for (; idx + lane_count <= end; idx += lane_count)
+	{
+		__m128i const is_negative =
+			_mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(&signs[idx]), _mm_setzero_ps()));
+		__m128i const sign = select(
+			is_negative,
+			_mm_set1_epi32(static_cast<int32_t>(kNegativeSign)),
+			_mm_set1_epi32(static_cast<int32_t>(kPositiveSign)));
+		__m128i const packed = _mm_or_si128(
+			_mm_or_si128(
+				_mm_or_si128(
+					quantise(&tangents.x[idx]), _mm_slli_epi32(quantise(&tangents.y[idx]), 10)),
+				_mm_slli_epi32(quantise(&tangents.z[idx]), 20)),
+			sign);
+		std::array const packed_lanes = lanes(packed);
+		for (std::size_t lane = 0; lane < lane_count; ++lane)
+			out[idx + lane].tangent = static_cast<uint32_t>(packed_lanes[lane]);
+	}
+	pack_tangents_scalar(tangents, signs, out, idx, end);
+}
+
+void pack_range_sse2(
+	VertexStreams const & streams,
+	Quantisation const & quantisation,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	pack_positions_sse2(streams.positions, quantisation, out, begin, end);
+	if (!streams.normals.x.empty())
+		pack_normals_sse2(streams.normals, out, begin, end);
+	if (!streams.u.empty())
+		pack_uvs_sse2(streams.u, streams.v, out, begin, end);
+	if (!streams.tangents.x.empty())
+		pack_tangents_sse2(streams.tangents, streams.tangent_signs, out, begin, end);
+}
+
+__attribute__((target("avx2"))) std::array<int32_t, 8> lanes_avx2(__m256i const value)
+{
+	std::array<int32_t, 8> out{};
+	// NOLINTNEXTLINE(*-reinterpret-cast)
+	_mm256_storeu_si256(reinterpret_cast<__m256i *>(out.data()), value);
+	return out;
+}
+
+__attribute__((target("avx2"))) __m256i float_to_half_avx2(__m256 const value)
+{
+	__m256i const bits = _mm256_castps_si256(value);
+	__m256i const sign =
+		_mm256_and_si256(bits, _mm256_set1_epi32(static_cast<int32_t>(kFloatSign)));
+	__m256i const magnitude = _mm256_xor_si256(bits, sign);
+
+	__m256i const is_nan = _mm256_cmpgt_epi32(magnitude, _mm256_set1_epi32(kFloatInfinity));
+	__m256i const overflow =
+		_mm256_blendv_epi8(_mm256_set1_epi32(kHalfInfinity), _mm256_set1_epi32(kHalfNan), is_nan);
+	__m256i const is_overflow =
+		_mm256_cmpgt_epi32(magnitude, _mm256_set1_epi32(kHalfOverflow - 1));
+
+	__m256 const magic = _mm256_set1_ps(kSubnormalMagic);
+	__m256i const subnormal = _mm256_sub_epi32(
+		_mm256_castps_si256(_mm256_add_ps(_mm256_castsi256_ps(magnitude), magic)),
+		_mm256_castps_si256(magic));
+	__m256i const is_subnormal =
+		_mm256_cmpgt_epi32(_mm256_set1_epi32(kHalfMinNormal), magnitude);
+
+	__m256i const odd =
+		_mm256_and_si256(_mm256_srli_epi32(magnitude, kHalfMantissaShift), _mm256_set1_epi32(1));
+	__m256i const normal = _mm256_srli_epi32(
+		_mm256_add_epi32(
+			_mm256_add_epi32(
+				magnitude, _mm256_set1_epi32(static_cast<int32_t>(kHalfRebiasAndRound))),
+			odd),
+		kHalfMantissaShift);
+
+	__m256i const half = _mm256_blendv_epi8(
+		_mm256_blendv_epi8(normal, subnormal, is_subnormal), overflow, is_overflow);
+	return _mm256_or_si256(half, _mm256_srli_epi32(sign, 16));
+}
+
+__attribute__((target("avx2"))) void pack_positions_avx2(
+	maths::ConstVec3Span const & positions,
+	Quantisation const & quantisation,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	constexpr std::size_t lane_count = 8;
+	std::array<float const *, 3> const inputs{
+		positions.x.data(), positions.y.data(), positions.z.data()};
+	__m256 const zero = _mm256_setzero_ps();
+	__m256 const max = _mm256_set1_ps(kUnorm16Max);
+	std::size_t idx = begin;
+	for (; idx + lane_count <= end; idx += lane_count)
+	{
+		std::array<std::array<int32_t, lane_count>, 3> quantised{};
+		for (std::size_t axis = 0; axis < 3; ++axis)
+		{
+			__m256 const scaled = _mm256_mul_ps(
+				_mm256_sub_ps(
+					_mm256_loadu_ps(&inputs[axis][idx]),
+					_mm256_set1_ps(quantisation.offset[axis])),
+				_mm256_set1_ps(quantisation.scale[axis]));
+			quantised[axis] =
+				lanes_avx2(_mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(scaled, zero), max)));
+		}
+		for (std::size_t lane = 0; lane < lane_count; ++lane)
+		{
+			out[idx + lane].position = {
+				static_cast<uint16_t>(quantised[0][lane]),
+				static_cast<uint16_t>(quantised[1][lane]),
+				static_cast<uint16_t>(quantised[2][lane]),
+				UINT16_MAX};
+		}
+	}
+	pack_positions_scalar(positions, quantisation, out, idx, end);
+}
+
+__attribute__((target("avx2"))) void pack_normals_avx2(
+	maths::ConstVec3Span const & normals,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	constexpr std::size_t lane_count = 8;
+	__m256 const sign_mask = _mm256_set1_ps(-0.0F);
+	__m256 const one = _mm256_set1_ps(1.0F);
+	__m256 const snorm_max = _mm256_set1_ps(kSnorm16Max);
+	std::size_t idx = begin;
+	for (; idx + lane_count <= end; idx += lane_count)
+	{
+		__m256 const x = _mm256_loadu_ps(&normals.x[idx]);
+		__m256 const y = _mm256_loadu_ps(&normals.y[idx]);
+		__m256 const z = _mm256_loadu_ps(&normals.z[idx]);
+		__m256 const norm = _mm256_add_ps(
+			_mm256_add_ps(_mm256_andnot_ps(sign_mask, x), _mm256_andnot_ps(sign_mask, y)),
+			_mm256_andnot_ps(sign_mask, z));
+		__m256 const oct_x = _mm256_div_ps(x, norm);
+		__m256 const oct_y = _mm256_div_ps(y, norm);
+		__m256 const folded_x = _mm256_mul_ps(
+			_mm256_sub_ps(one, _mm256_andnot_ps(sign_mask, oct_y)),
+			_mm256_or_ps(_mm256_and_ps(sign_mask, oct_x), one));
+		__m256 const folded_y = _mm256_mul_ps(
+			_mm256_sub_ps(one, _mm256_andnot_ps(sign_mask, oct_x)),
+			_mm256_or_ps(_mm256_and_ps(sign_mask, oct_y), one));
+		__m256 const is_lower = _mm256_cmp_ps(z, _mm256_setzero_ps(), _CMP_LT_OQ);
+		std::array const quantised_x = lanes_avx2(_mm256_cvtps_epi32(
+			_mm256_mul_ps(_mm256_blendv_ps(oct_x, folded_x, is_lower), snorm_max)));
+		std::array const quantised_y = lanes_avx2(_mm256_cvtps_epi32(
+			_mm256_mul_ps(_mm256_blendv_ps(oct_y, folded_y, is_lower), snorm_max)));
+		for (std::size_t lane = 0; lane < lane_count; ++lane)
+		{
+			out[idx + lane].normal = {
+				static_cast<int16_t>(quantised_x[lane]), static_cast<int16_t>(quantised_y[lane])};
+		}
+	}
+	pack_normals_scalar(normals, out, idx, end);
+}
+
+__attribute__((target("avx2"))) void pack_uvs_avx2(
+	std::span<float const> const u,
+	std::span<float const> const v,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	constexpr std::size_t lane_count = 8;
+	std::size_t idx = begin;
+	for (; idx + lane_count <= end; idx += lane_count)
+	{
+		std::array const half_u = lanes_avx2(float_to_half_avx2(_mm256_loadu_ps(&u[idx])));
+		std::array const half_v = lanes_avx2(float_to_half_avx2(_mm256_loadu_ps(&v[idx])));
+		for (std::size_t lane = 0; lane < lane_count; ++lane)
+		{
+			out[idx + lane].uv = {
+				static_cast<uint16_t>(half_u[lane]), static_cast<uint16_t>(half_v[lane])};
+		}
+	}
+	pack_uvs_scalar(u, v, out, idx, end);
+}
+
+__attribute__((target("avx2"))) __m256i quantise_tangent_avx2(float const * const values)
+{
+	__m256 const clamped = _mm256_min_ps(
+		_mm256_max_ps(_mm256_loadu_ps(values), _mm256_set1_ps(-1.0F)), _mm256_set1_ps(1.0F));
+	return _mm256_and_si256(
+		_mm256_cvtps_epi32(_mm256_mul_ps(clamped, _mm256_set1_ps(kSnorm10Max))),
+		_mm256_set1_epi32(kSnorm10Mask));
+}
+
+__attribute__((target("avx2"))) void pack_tangents_avx2(
+	maths::ConstVec3Span const & tangents,
+	std::span<float const> const signs,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	constexpr std::size_t lane_count = 8;
+	std::size_t idx = begin;
+	for (; idx + lane_count <= end; idx += lane_count)
+	{
+		__m256i const is_negative = _mm256_castps_si256(
+			_mm256_cmp_ps(_mm256_loadu_ps(&signs[idx]), _mm256_setzero_ps(), _CMP_LT_OQ));
+		__m256i const sign = _mm256_blendv_epi8(
+			_mm256_set1_epi32(static_cast<int32_t>(kPositiveSign)),
+			_mm256_set1_epi32(static_cast<int32_t>(kNegativeSign)),
+			is_negative);
+		__m256i const packed = _mm256_or_si256(
+			_mm256_or_si256(
+				_mm256_or_si256(
+					quantise_tangent_avx2(&tangents.x[idx]),
+					_mm256_slli_epi32(quantise_tangent_avx2(&tangents.y[idx]), 10)),
+				_mm256_slli_epi32(quantise_tangent_avx2(&tangents.z[idx]), 20)),
+			sign);
+		std::array const packed_lanes = lanes_avx2(packed);
+		for (std::size_t lane = 0; lane < lane_count; ++lane)
+			out[idx + lane].tangent = static_cast<uint32_t>(packed_lanes[lane]);
+	}
+	pack_tangents_scalar(tangents, signs, out, idx, end);
+}
+
+__attribute__((target("avx2"))) void pack_range_avx2(
+	VertexStreams const & streams,
+	Quantisation const & quantisation,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	pack_positions_avx2(streams.positions, quantisation, out, begin, end);
+	if (!streams.normals.x.empty())
+		pack_normals_avx2(streams.normals, out, begin, end);
+	if (!streams.u.empty())
+		pack_uvs_avx2(streams.u, streams.v, out, begin, end);
+	if (!streams.tangents.x.empty())
+		pack_tangents_avx2(streams.tangents, streams.tangent_signs, out, begin, end);
+}
+#endif
+
+#if defined(__aarch64__)
+// NEON is mandatory on AArch64, so needs no runtime check.
+
+std::array<int32_t, 4> lanes(int32x4_t const value)
+{
+	std::array<int32_t, 4> out{};
+	vst1q_s32(out.data(), value);
+	return out;
+}
+
+uint32x4_t float_to_half_neon(float32x4_t const value)
+{
+	uint32x4_t const bits = vreinterpretq_u32_f32(value);
+	uint32x4_t const sign = vandq_u32(bits, vdupq_n_u32(kFloatSign));
+	uint32x4_t const magnitude = veorq_u32(bits, sign);
+
+	uint32x4_t const overflow = vbslq_u32(
+		vcgtq_u32(magnitude, vdupq_n_u32(kFloatInfinity)),
+		vdupq_n_u32(kHalfNan),
+		vdupq_n_u32(kHalfInfinity));
+
+	float32x4_t const magic = vdupq_n_f32(kSubnormalMagic);
+	uint32x4_t const subnormal = vsubq_u32(
+		vreinterpretq_u32_f32(vaddq_f32(vreinterpretq_f32_u32(magnitude), magic)),
+		vreinterpretq_u32_f32(magic));
+
+	uint32x4_t const odd = vandq_u32(vshrq_n_u32(magnitude, kHalfMantissaShift), vdupq_n_u32(1));
+	uint32x4_t const normal = vshrq_n_u32(
+		vaddq_u32(vaddq_u32(magnitude, vdupq_n_u32(kHalfRebiasAndRound)), odd),
+		kHalfMantissaShift);
+
+	uint32x4_t const half = vbslq_u32(
+		vcgeq_u32(magnitude, vdupq_n_u32(kHalfOverflow)),
+		overflow,
+		vbslq_u32(vcltq_u32(magnitude, vdupq_n_u32(kHalfMinNormal)), subnormal, normal));
+	return vorrq_u32(half, vshrq_n_u32(sign, 16));
+}
+
+void pack_positions_neon(
+	maths::ConstVec3Span const & positions,
+	Quantisation const & quantisation,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	constexpr std::size_t lane_count = 4;
+	std::array<float const *, 3> const inputs{
+		positions.x.data(), positions.y.data(), positions.z.data()};
+	float32x4_t const zero = vdupq_n_f32(0.0F);
+	float32x4_t const max = vdupq_n_f32(kUnorm16Max);
+	std::size_t idx = begin;
+	for (; idx + lane_count <= end; idx += lane_count)
+	{
+		std::array<std::array<int32_t, lane_count>, 3> quantised{};
+		for (std::size_t axis = 0; axis < 3; ++axis)
+		{
+			float32x4_t const scaled = vmulq_n_f32(
+				vsubq_f32(vld1q_f32(&inputs[axis][idx]), vdupq_n_f32(quantisation.offset[axis])),
+				quantisation.scale[axis]);
+			quantised[axis] = lanes(vcvtnq_s32_f32(vminq_f32(vmaxq_f32(scaled, zero), max)));
+		}
+		for (std::size_t lane = 0; lane < lane_count; ++lane)
+		{
+			out[idx + lane].position = {
+				static_cast<uint16_t>(quantised[0][lane]),
+				static_cast<uint16_t>(quantised[1][lane]),
+				static_cast<uint16_t>(quantised[2][lane]),
+				UINT16_MAX};
+		}
+	}
+	pack_positions_scalar(positions, quantisation, out, idx, end);
+}
+
+void pack_normals_neon(
+	maths::ConstVec3Span const & normals,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	constexpr std::size_t lane_count = 4;
+	uint32x4_t const sign_mask = vdupq_n_u32(kFloatSign);
+	float32x4_t const one = vdupq_n_f32(1.0F);
+	std::size_t idx = begin;
+	for (; idx + lane_count <= end; idx += lane_count)
+	{
+		float32x4_t const x = vld1q_f32(&normals.x[idx]);
+		float32x4_t const y = vld1q_f32(&normals.y[idx]);
+		float32x4_t const z = vld1q_f32(&normals.z[idx]);
+		float32x4_t const norm = vaddq_f32(vaddq_f32(vabsq_f32(x), vabsq_f32(y)), vabsq_f32(z));
+		float32x4_t const oct_x = vdivq_f32(x, norm);
+		float32x4_t const oct_y = vdivq_f32(y, norm);
+		float32x4_t const folded_x =
+			vmulq_f32(vsubq_f32(one, vabsq_f32(oct_y)), vbslq_f32(sign_mask, oct_x, one));
+		float32x4_t const folded_y =
+			vmulq_f32(vsubq_f32(one, vabsq_f32(oct_x)), vbslq_f32(sign_mask, oct_y, one));
+		uint32x4_t const is_lower = vcltq_f32(z, vdupq_n_f32(0.0F));
+		std::array const quantised_x =
+			lanes(vcvtnq_s32_f32(vmulq_n_f32(vbslq_f32(is_lower, folded_x, oct_x), kSnorm16Max)));
+		std::array const quantised_y =
+			lanes(vcvtnq_s32_f32(vmulq_n_f32(vbslq_f32(is_lower, folded_y, oct_y), kSnorm16Max)));
+		for (std::size_t lane = 0; lane < lane_count; ++lane)
+		{
+			out[idx + lane].normal = {
+				static_cast<int16_t>(quantised_x[lane]), static_cast<int16_t>(quantised_y[lane])};
+		}
+	}
+	pack_normals_scalar(normals, out, idx, end);
+}
+
+void pack_uvs_neon(
+	std::span<float const> const u,
+	std::span<float const> const v,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	constexpr std::size_t lane_count = 4;
+	std::size_t idx = begin;
+	for (; idx + lane_count <= end; idx += lane_count)
+	{
+		std::array const half_u =
+			lanes(vreinterpretq_s32_u32(float_to_half_neon(vld1q_f32(&u[idx]))));
+		std::array const half_v =
+			lanes(vreinterpretq_s32_u32(float_to_half_neon(vld1q_f32(&v[idx]))));
+		for (std::size_t lane = 0; lane < lane_count; ++lane)
+		{
+			out[idx + lane].uv = {
+				static_cast<uint16_t>(half_u[lane]), static_cast<uint16_t>(half_v[lane])};
+		}
+	}
+	pack_uvs_scalar(u, v, out, idx, end);
+}
+
+void pack_tangents_neon(
+	maths::ConstVec3Span const & tangents,
+	std::span<float const> const signs,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	constexpr std::size_t lane_count = 4;
+	float32x4_t const minus_one = vdupq_n_f32(-1.0F);
+	float32x4_t const one = vdupq_n_f32(1.0F);
+	auto const quantise = [&](float const * const values)
+	{
+		float32x4_t const clamped = vminq_f32(vmaxq_f32(vld1q_f32(values), minus_one), one);
+		return vandq_u32(
+			vreinterpretq_u32_s32(vcvtnq_s32_f32(vmulq_n_f32(clamped, kSnorm10Max))),
+			vdupq_n_u32(kSnorm10Mask));
+	};
+	std::size_t idx = begin;
+	for (; idx + lane_count <= end; idx += lane_count)
+	{
+		uint32x4_t const sign = vbslq_u32(
+			vcltq_f32(vld1q_f32(&signs[idx]), vdupq_n_f32(0.0F)),
+			vdupq_n_u32(kNegativeSign),
+			vdupq_n_u32(kPositiveSign));
+		uint32x4_t const packed = vorrq_u32(
+			vorrq_u32(
+				vorrq_u32(quantise(&tangents.x[idx]), vshlq_n_u32(quantise(&tangents.y[idx]), 10)),
+				vshlq_n_u32(quantise(&tangents.z[idx]), 20)),
+			sign);
+		std::array const packed_lanes = lanes(vreinterpretq_s32_u32(packed));
+		for (std::size_t lane = 0; lane < lane_count; ++lane)
+			out[idx + lane].tangent = static_cast<uint32_t>(packed_lanes[lane]);
+	}
+	pack_tangents_scalar(tangents, signs, out, idx, end);
+}
+
+void pack_range_neon(
+	VertexStreams const & streams,
+	Quantisation const & quantisation,
+	std::span<PackedVertex> const out,
+	std::size_t const begin,
+	std::size_t const end)
+{
+	pack_positions_neon(streams.positions, quantisation, out, begin, end);
+	if (!streams.normals.x.empty())
+		pack_normals_neon(streams.normals, out, begin, end);
+	if (!streams.u.empty())
+		pack_uvs_neon(streams.u, streams.v, out, begin, end);
+	if (!streams.tangents.x.empty())
+		pack_tangents_neon(streams.tangents, streams.tangent_signs, out, begin, end);
+}
+#endif
+
+RangeKernel range_kernel(simd::Kernel const kernel)
+{
+	if (!simd::is_kernel_supported(kernel))
+		throw std::runtime_error{
+			std::string{"Vertex kernel not supported: "} + std::string{simd::kernel_name(kernel)}};
+
+	switch (kernel)
+	{
+#if defined(__x86_64__)
+		case simd::Kernel::kSse2:
+			return &pack_range_sse2;
+		case simd::Kernel::kAvx2:
+			return &pack_range_avx2;
+#endif
+#if defined(__aarch64__)
+		case simd::Kernel::kNeon:
+			return &pack_range_neon;
+#endif
+		default:
+			return &pack_range_scalar;
+	}
+}
+
+/// Decode a signed normalised integer as the input assembler does.
+float snorm_to_float(int32_t const value, float const max)
+{
+	return std::max(static_cast<float>(value) / max, -1.0F);
+}
+}  // namespace
+
+Bounds compute_bounds(maths::ConstVec3Span const & positions)
+{
+	if (positions.x.empty())
+		return {};
+	auto const [min_x, max_x] = std::ranges::minmax(positions.x);
+	auto const [min_y, max_y] = std::ranges::minmax(positions.y);
+	auto const [min_z, max_z] = std::ranges::minmax(positions.z);
+	return {.min = {min_x, min_y, min_z}, .max = {max_x, max_y, max_z}};
+}
+
+void pack_vertices(
+	VertexStreams const & streams,
+	Bounds const & bounds,
+	std::span<PackedVertex> const out,
+	simd::Kernel const kernel)
+{
+	check_lengths(streams, out);
+	RangeKernel const pack_range = range_kernel(kernel);
+	pack_range(streams, make_quantisation(bounds), out, 0, out.size());
+}
+
+void pack_vertices(
+	VertexStreams const & streams,
+	Bounds const & bounds,
+	std::span<PackedVertex> const out,
+	parallel::ThreadPool & pool,
+	simd::Kernel const kernel)
+{
+	check_lengths(streams, out);
+	RangeKernel const pack_range = range_kernel(kernel);
+	Quantisation const quantisation = make_quantisation(bounds);
+	parallel::for_each_chunk(
+		pool,
+		out.size(),
+		kChunkSize,
+		[&](std::size_t, std::size_t const begin, std::size_t const end)
+		{ pack_range(streams, quantisation, out, begin, end); });
+}
+
+uint16_t float_to_half(float const value)
+{
+	auto const bits = std::bit_cast<uint32_t>(value);
+	uint32_t const sign = bits & kFloatSign;
+	uint32_t const magnitude = bits ^ sign;
+	uint32_t half = 0;
+	if (magnitude >= kHalfOverflow)
+	{
+		half = magnitude > kFloatInfinity ? kHalfNan : kHalfInfinity;
+	}
+	else if (magnitude < kHalfMinNormal)
+	{
+		half = std::bit_cast<uint32_t>(std::bit_cast<float>(magnitude) + kSubnormalMagic) -
+			std::bit_cast<uint32_t>(kSubnormalMagic);
+	}
+	else
+	{
+		// Round to nearest, ties to even by rounding up by one more if the result would be odd.
+		uint32_t const odd = (magnitude >> kHalfMantissaShift) & 1U;
+		half = (magnitude + kHalfRebiasAndRound + odd) >> kHalfMantissaShift;
+	}
+	return static_cast<uint16_t>(half | (sign >> 16U));
+}
+
+float half_to_float(uint16_t const half)
+{
+	uint32_t const sign = static_cast<uint32_t>(half & 0x8000U) << 16U;
+	uint32_t const exponent = (half >> 10U) & 0x1FU;
+	uint32_t const mantissa = half & 0x3FFU;
+	if (exponent == 0)
+	{
+		// Zero or subnormal, exactly representable as a float.
+		float const magnitude = static_cast<float>(mantissa) * 0x1p-24F;
+		return std::bit_cast<float>(std::bit_cast<uint32_t>(magnitude) | sign);
+	}
+	if (exponent == 0x1F)
+		return std::bit_cast<float>(sign | kFloatInfinity | (mantissa << kHalfMantissaShift));
+	// Rebias the exponent from 15 to 127.
+	return std::bit_cast<float>(
+		sign | ((exponent + 112U) << 23U) | (mantissa << kHalfMantissaShift));
+}
+
+maths::Vec3 decode_position(PackedVertex const & vertex, Bounds const & bounds)
+{
+	maths::Vec3 const normalised{
+		static_cast<float>(vertex.position[0]) / kUnorm16Max,
+		static_cast<float>(vertex.position[1]) / kUnorm16Max,
+		static_cast<float>(vertex.position[2]) / kUnorm16Max};
+	return maths::transform_point(decode_matrix(bounds), normalised);
+}
+
+maths::Vec3 decode_normal(PackedVertex const & vertex)
+{
+	float const oct_x = snorm_to_float(vertex.normal[0], kSnorm16Max);
+	float const oct_y = snorm_to_float(vertex.normal[1], kSnorm16Max);
+	// Unfold the lower half of the octahedron back over the diagonals.
+	maths::Vec3 normal{oct_x, oct_y, 1 - std::abs(oct_x) - std::abs(oct_y)};
+	float const fold = std::max(-normal.z, 0.0F);
+	normal.x += normal.x >= 0 ? -fold : fold;
+	normal.y += normal.y >= 0 ? -fold : fold;
+	return maths::normalise(normal);
+}
+
+std::array<float, 2> decode_uv(PackedVertex const & vertex)
+{
+	return {half_to_float(vertex.uv[0]), half_to_float(vertex.uv[1])};
+}
+
+maths::Vec4 decode_tangent(PackedVertex const & vertex)
+{
+	// Sign extend each component by shifting it to the top of a signed integer and back.
+	auto const component = [&](uint32_t const shift, uint32_t const bits)
+	{
+		auto const shifted = static_cast<int32_t>(vertex.tangent << (32U - shift - bits));
+		auto const max = static_cast<float>((1U << (bits - 1U)) - 1U);
+		return snorm_to_float(shifted >> (32U - bits), max);
+	};
+	return {component(0, 10), component(10, 10), component(20, 10), component(30, 2)};
+}
+
+bool is_supported(VkPhysicalDevice physical_device)
+{
+	return std::ranges::all_of(
+		std::array{kPositionFormat, kNormalFormat, kUvFormat, kTangentFormat},
+		[&](VkFormat const format)
+		{
+			VkFormatProperties properties{};
+			vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+			return (properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) != 0;
+		});
+}
+
+namespace
+{
+/**
+ * Full precision attributes, owning the storage that VertexStreams views.
+ */
+struct MeshAttributes
+{
+	std::array<std::vector<float>, 3> positions;
+	std::array<std::vector<float>, 3> normals;
+	std::array<std::vector<float>, 2> uvs;
+	std::array<std::vector<float>, 3> tangents;
+	std::vector<float> tangent_signs;
+
+	[[nodiscard]] VertexStreams streams() const
+	{
+		return {
+			.positions = {positions[0], positions[1], positions[2]},
+			.normals = {normals[0], normals[1], normals[2]},
+			.u = uvs[0],
+			.v = uvs[1],
+			.tangents = {tangents[0], tangents[1], tangents[2]},
+			.tangent_signs = tangent_signs};
+	}
+};
+
+maths::Vec3 random_unit_vector(std::mt19937 & rng)
+{
+	std::normal_distribution<float> dist;
+	return maths::normalise(maths::Vec3{dist(rng), dist(rng), dist(rng)});
+}
+
+MeshAttributes make_random_attributes(std::size_t const count)
+{
+	std::mt19937 rng{42};  // NOLINT(cert-msc32-c,cert-msc51-cpp) deterministic for reproducibility
+	std::uniform_real_distribution<float> position{-50.0F, 50.0F};
+	std::uniform_real_distribution<float> uv{-2.0F, 2.0F};
+	MeshAttributes attributes;
+	for (std::size_t idx = 0; idx < count; ++idx)
+	{
+		maths::Vec3 const normal = random_unit_vector(rng);
+		// Any unit vector perpendicular to the normal.
+		maths::Vec3 const tangent =
+			maths::normalise(maths::cross(normal, random_unit_vector(rng)));
+		for (std::size_t axis = 0; axis < 3; ++axis)
+			attributes.positions[axis].push_back(position(rng));
+		attributes.normals[0].push_back(normal.x);
+		attributes.normals[1].push_back(normal.y);
+		attributes.normals[2].push_back(normal.z);
+		attributes.uvs[0].push_back(uv(rng));
+		attributes.uvs[1].push_back(uv(rng));
+		attributes.tangents[0].push_back(tangent.x);
+		attributes.tangents[1].push_back(tangent.y);
+		attributes.tangents[2].push_back(tangent.z);
+		attributes.tangent_signs.push_back(idx % 3 == 0 ? -1.0F : 1.0F);
+	}
+	return attributes;
+}
+}  // namespace
+
+TEST_CASE("Convert between floats and half floats")
+{
+	CHECK(float_to_half(0.0F) == 0x0000);
+	CHECK(float_to_half(-0.0F) == 0x8000);
+	CHECK(float_to_half(1.0F) == 0x3C00);
+	CHECK(float_to_half(-2.0F) == 0xC000);
+	CHECK(float_to_half(65504.0F) == 0x7BFF);
+	// Halfway between the largest half and 2^16 rounds up to infinity.
+	CHECK(float_to_half(65520.0F) == 0x7C00);
+	CHECK(float_to_half(1e10F) == 0x7C00);
+	CHECK(float_to_half(-std::numeric_limits<float>::infinity()) == 0xFC00);
+	CHECK(float_to_half(std::numeric_limits<float>::quiet_NaN()) == 0x7E00);
+	// Smallest subnormal, and half of it rounding to even, i.e. zero.
+	CHECK(float_to_half(0x1p-24F) == 0x0001);
+	CHECK(float_to_half(0x1p-25F) == 0x0000);
+	CHECK(float_to_half(0x1.8p-24F) == 0x0002);
+	// Ties between normals round to even.
+	CHECK(float_to_half(1.0F + 0x1p-11F) == 0x3C00);
+	CHECK(float_to_half(1.0F + 0x3p-11F) == 0x3C02);
+
+	for (uint32_t half = 0; half <= UINT16_MAX; ++half)
+	{
+		CAPTURE(half);
+		float const value = half_to_float(static_cast<uint16_t>(half));
+		if (std::isnan(value))
+			continue;
+		CHECK(float_to_half(value) == half);
+	}
+}
+
+TEST_CASE("Quantise and decode vertex attributes")
+{
+	constexpr std::size_t count = 1001;
+	MeshAttributes const attributes = make_random_attributes(count);
+	VertexStreams const streams = attributes.streams();
+	Bounds const bounds = compute_bounds(streams.positions);
+	std::vector<PackedVertex> packed(count);
+	pack_vertices(streams, bounds, packed, simd::Kernel::kScalar);
+
+	maths::Vec3 const extent = bounds.max - bounds.min;
+	for (std::size_t idx = 0; idx < count; ++idx)
+	{
+		CAPTURE(idx);
+		PackedVertex const & vertex = packed[idx];
+
+		maths::Vec3 const position_error =
+			decode_position(vertex, bounds) -
+			maths::Vec3{
+				attributes.positions[0][idx],
+				attributes.positions[1][idx],
+				attributes.positions[2][idx]};
+		// Half a quantisation step, plus float rounding.
+		CHECK(std::abs(position_error.x) <= extent.x / kUnorm16Max);
+		CHECK(std::abs(position_error.y) <= extent.y / kUnorm16Max);
+		CHECK(std::abs(position_error.z) <= extent.z / kUnorm16Max);
+
+		maths::Vec3 const normal{
+			attributes.normals[0][idx], attributes.normals[1][idx], attributes.normals[2][idx]};
+		// Within about a hundredth of a degree.
+		CHECK(maths::dot(decode_normal(vertex), normal) > 0.99999F);
+
+		std::array const uv = decode_uv(vertex);
+		CHECK(uv[0] == doctest::Approx(attributes.uvs[0][idx]).epsilon(1e-3));
+		CHECK(uv[1] == doctest::Approx(attributes.uvs[1][idx]).epsilon(1e-3));
+
+		maths::Vec4 const tangent = decode_tangent(vertex);
+		maths::Vec3 const expected_tangent{
+			attributes.tangents[0][idx], attributes.tangents[1][idx], attributes.tangents[2][idx]};
+		CHECK(maths::dot(maths::normalise(maths::to_vec3(tangent)), expected_tangent) > 0.9999F);
+		CHECK(tangent.w == attributes.tangent_signs[idx]);
+	}
+
+	SUBCASE("decode matrix maps the unit cube onto the bounds")
+	{
+		maths::Mat4 const decode = decode_matrix(bounds);
+		CHECK(maths::transform_point(decode, {0, 0, 0}) == bounds.min);
+		maths::Vec3 const max = maths::transform_point(decode, {1, 1, 1});
+		CHECK(max.x == doctest::Approx(bounds.max.x));
+		CHECK(max.y == doctest::Approx(bounds.max.y));
+		CHECK(max.z == doctest::Approx(bounds.max.z));
+	}
+
+	SUBCASE("poles and axes of the octahedron")
+	{
+		std::array<float, 6> const x{1, -1, 0, 0, 0, 0};
+		std::array<float, 6> const y{0, 0, 1, -1, 0, 0};
+		std::array<float, 6> const z{0, 0, 0, 0, 1, -1};
+		std::vector<PackedVertex> axes(x.size());
+		pack_vertices(
+			{.positions = {x, y, z}, .normals = {x, y, z}}, compute_bounds({x, y, z}), axes);
+		for (std::size_t idx = 0; idx < axes.size(); ++idx)
+			CHECK(decode_normal(axes[idx]) == maths::Vec3{x[idx], y[idx], z[idx]});
+	}
+
+	SUBCASE("absent attributes and flat bounds")
+	{
+		std::array<float, 3> const zero{};
+		std::array<float, 3> const ramp{0, 1, 2};
+		std::vector<PackedVertex> flat(zero.size());
+		pack_vertices({.positions = {ramp, zero, zero}}, compute_bounds({ramp, zero, zero}), flat);
+		for (std::size_t idx = 0; idx < flat.size(); ++idx)
+		{
+			maths::Vec3 const position =
+				decode_position(flat[idx], compute_bounds({ramp, zero, zero}));
+			CHECK(position.x == doctest::Approx(ramp[idx]).epsilon(1e-4));
+			CHECK(position.y == 0);
+			CHECK(position.z == 0);
+			CHECK(flat[idx].normal == std::array<int16_t, 2>{});
+			CHECK(flat[idx].uv == std::array<uint16_t, 2>{});
+			CHECK(flat[idx].tangent == 0);
+		}
+	}
+}
+
+TEST_CASE("Pack vertices with SIMD kernels")
+{
+	// Not a multiple of any kernel's width or the chunk size, to exercise the remainders.
+	constexpr std::size_t count = 2 * kChunkSize + 5;
+	MeshAttributes const attributes = make_random_attributes(count);
+	VertexStreams const streams = attributes.streams();
+	Bounds const bounds = compute_bounds(streams.positions);
+
+	std::vector<PackedVertex> expected(count);
+	pack_vertices(streams, bounds, expected, simd::Kernel::kScalar);
+
+	parallel::ThreadPool pool{3};
+
+	for (simd::Kernel const kernel :
+		 {simd::Kernel::kScalar, simd::Kernel::kSse2, simd::Kernel::kAvx2, simd::Kernel::kNeon})
+	{
+		CAPTURE(simd::kernel_name(kernel));
+		std::vector<PackedVertex> packed(count);
+
+		if (!simd::is_kernel_supported(kernel))
+		{
+			CHECK_THROWS_AS(pack_vertices(streams, bounds, packed, kernel), std::runtime_error);
+			continue;
+		}
+
+		pack_vertices(streams, bounds, packed, kernel);
+		CHECK(packed == expected);
+		std::ranges::fill(packed, PackedVertex{});
+		pack_vertices(streams, bounds, packed, pool, kernel);
+		CHECK(packed == expected);
+	}
+
+	std::vector<PackedVertex> short_out(count - 1);
+	CHECK_THROWS_AS(pack_vertices(streams, bounds, short_out), std::invalid_argument);
+	VertexStreams missing_signs = streams;
+	missing_signs.tangent_signs = {};
+	CHECK_THROWS_AS(pack_vertices(missing_signs, bounds, expected), std::invalid_argument);
+}
+
+TEST_CASE("Create a packed vertex buffer")
+{
+	vulkandemo::LoggerPtr const logger = vulkandemo::create_logger("Create a packed vertex buffer");
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger,
+		nullptr,
+		{{types::AvailableInstanceLayerNameCstr{"VK_LAYER_KHRONOS_validation"}}},
+		{{types::AvailableInstanceExtensionNameCstr{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+	types::VulkanDebugMessengerPtr const messenger =
+		setup::create_debug_messenger(logger, instance);
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device, {{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}}, {});
+
+	// Supported by common desktop drivers and lavapipe, though not guaranteed.
+	REQUIRE(is_supported(physical_device));
+
+	std::vector<types::VulkanMemoryTypeIdx> const available_memory_types =
+		setup::filter_available_memory_types(
+			logger, physical_device, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+	MeshAttributes const attributes = make_random_attributes(64);
+	VertexStreams const streams = attributes.streams();
+	std::vector<PackedVertex> vertices(attributes.tangent_signs.size());
+	pack_vertices(streams, compute_bounds(streams.positions), vertices);
+
+	auto const [buffer, memory] = draw::create_exclusive_vertex_buffer_and_memory(
+		device, available_memory_types.at(0), vertices);
+	CHECK(buffer);
+
+	types::VulkanShaderModulePtr const vert_module =
+		setup::create_shader_module(device, shaders::kPackedMeshVert);
+	CHECK(vert_module);
+}
+
+TEST_CASE("Benchmark vertex packing" * doctest::test_suite("benchmark") * doctest::skip())
+{
+	LoggerPtr const logger = create_logger("Benchmark vertex packing");
+	parallel::ThreadPool pool;
+	logger->info(
+		"Best kernel {} with {} threads; {} bytes per vertex, down from {}",
+		simd::kernel_name(simd::best_kernel()),
+		pool.thread_count(),
+		sizeof(PackedVertex),
+		12 * sizeof(float));
+
+	for (std::size_t const count : {10'000UZ, 100'000UZ, 1'000'000UZ})
+	{
+		constexpr std::size_t iterations = 20;
+		MeshAttributes const attributes = make_random_attributes(count);
+		VertexStreams const streams = attributes.streams();
+		Bounds const bounds = compute_bounds(streams.positions);
+		std::vector<PackedVertex> packed(count);
+
+		double scalar_ms = 0;
+		for (simd::Kernel const kernel :
+			 {simd::Kernel::kScalar, simd::Kernel::kSse2, simd::Kernel::kAvx2, simd::Kernel::kNeon})
+		{
+			if (!simd::is_kernel_supported(kernel))
+				continue;
+
+			double const single_ms =
+				bench::mean_ms(iterations, [&] { pack_vertices(streams, bounds, packed, kernel); });
+			double const parallel_ms = bench::mean_ms(
+				iterations, [&] { pack_vertices(streams, bounds, packed, pool, kernel); });
+			if (kernel == simd::Kernel::kScalar)
+				scalar_ms = single_ms;
+
+			logger->info(
+				"{} vertices: {} {:.3f} ms ({:.1f}x), parallel {:.3f} ms ({:.1f}x)",
+				count,
+				simd::kernel_name(kernel),
+				single_ms,
+				scalar_ms / single_ms,
+				parallel_ms,
+				scalar_ms / parallel_ms);
+		}
+	}
+}
+}  // namespace vulkandemo::vertex
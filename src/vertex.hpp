@@ -0,0 +1,236 @@
+// SPDX-License-Identifier: MIT
+// Copyright 2024 David Feltell
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <vulkan/vulkan_core.h>
+
+#include "maths.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+/**
+ * Vertex attribute quantisation, packing full precision mesh attributes into a compact interleaved
+ * vertex that the input assembler decodes for free.
+ *
+ * - Positions are 16-bit normalised within the mesh's bounding box. The box is restored by
+ *   folding decode_matrix into the model matrix, so the vertex shader needs no extra work.
+ * - Normals are octahedral encoded, i.e. projected onto an octahedron then unfolded onto a square,
+ *   as two 16-bit signed normalised values.
+ * - Texture coordinates are half floats.
+ * - Tangents are 10-bit signed normalised, with the bitangent sign in the 2-bit alpha.
+ *
+ * This is 20 bytes per vertex, rather than 48 for the same attributes as 32-bit floats.
+ *
+ * Attributes are read as structure-of-arrays, so SIMD kernels, chosen at runtime as per
+ * simd::Kernel, quantise 4 or 8 vertices at once. All kernels round identically, so the packed
+ * output does not depend on the kernel.
+ */
+namespace vulkandemo::vertex
+{
+/// Number of vertices packed per parallel task. A multiple of the widest kernel.
+inline constexpr std::size_t kChunkSize = 16384;
+
+inline constexpr VkFormat kPositionFormat = VK_FORMAT_R16G16B16A16_UNORM;
+inline constexpr VkFormat kNormalFormat = VK_FORMAT_R16G16_SNORM;
+inline constexpr VkFormat kUvFormat = VK_FORMAT_R16G16_SFLOAT;
+inline constexpr VkFormat kTangentFormat = VK_FORMAT_A2B10G10R10_SNORM_PACK32;
+
+/**
+ * Interleaved vertex, laid out to match the vertex input of `packed_mesh.vert`.
+ */
+struct PackedVertex
+{
+	/// Position within the mesh bounds, see decode_matrix. The fourth component is always one.
+	std::array<uint16_t, 4> position;
+	/// Octahedral encoded unit normal.
+	std::array<int16_t, 2> normal;
+	/// Half float texture coordinates.
+	std::array<uint16_t, 2> uv;
+	/// Unit tangent in the low 30 bits, and bitangent sign in the top 2 bits.
+	uint32_t tangent;
+
+	bool operator==(PackedVertex const &) const = default;
+};
+static_assert(sizeof(PackedVertex) == 20);
+
+/**
+ * Axis aligned box that positions are quantised within.
+ */
+struct Bounds
+{
+	maths::Vec3 min;
+	maths::Vec3 max;
+};
+
+/**
+ * Full precision attributes of a mesh's vertices, as structure-of-arrays. Every present attribute
+ * has the same number of vertices as the positions.
+ */
+struct VertexStreams
+{
+	maths::ConstVec3Span positions;
+	/// Unit length. Empty if absent, leaving packed normals zero.
+	maths::ConstVec3Span normals{};
+	/// Empty if absent, leaving packed texture coordinates zero.
+	std::span<float const> u{};
+	std::span<float const> v{};
+	/// Unit length. Empty if absent, leaving packed tangents zero.
+	maths::ConstVec3Span tangents{};
+	/// Handedness of the bitangent, i.e. negative if mirrored. Empty if and only if tangents are.
+	std::span<float const> tangent_signs{};
+};
+
+/**
+ * Smallest box enclosing a set of positions.
+ *
+ * @param positions
+ * @return Zero sized box at the origin if there are no positions.
+ */
+Bounds compute_bounds(maths::ConstVec3Span const & positions);
+
+/**
+ * Quantise and interleave vertex attributes on the calling thread.
+ *
+ * @param streams All values must be finite.
+ * @param bounds Box enclosing all positions, e.g. from compute_bounds.
+ * @param out Same length as @p streams positions.
+ * @param kernel Must be supported, see simd::is_kernel_supported.
+ */
+void pack_vertices(
+	VertexStreams const & streams,
+	Bounds const & bounds,
+	std::span<PackedVertex> out,
+	simd::Kernel kernel = simd::best_kernel());
+
+/**
+ * Quantise and interleave vertex attributes in chunks of kChunkSize across a thread pool.
+ *
+ * @param streams All values must be finite.
+ * @param bounds Box enclosing all positions, e.g. from compute_bounds.
+ * @param out Same length as @p streams positions.
+ * @param pool
+ * @param kernel Must be supported, see simd::is_kernel_supported.
+ */
+void pack_vertices(
+	VertexStreams const & streams,
+	Bounds const & bounds,
+	std::span<PackedVertex> out,
+	parallel::ThreadPool & pool,
+	simd::Kernel kernel = simd::best_kernel());
+
+/**
+ * Transform from normalised packed positions to mesh space, to be applied before the model
+ * matrix.
+ *
+ * @param bounds As passed to pack_vertices.
+ * @return
+ */
+constexpr maths::Mat4 decode_matrix(Bounds const & bounds)
+{
+	return maths::translation(bounds.min) * maths::scaling(bounds.max - bounds.min);
+}
+
+/**
+ * Round to the nearest half float, ties to even.
+ *
+ * @param value
+ * @return Bits of the half float.
+ */
+uint16_t float_to_half(float value);
+
+/**
+ * @param half Bits of a half float.
+ * @return
+ */
+float half_to_float(uint16_t half);
+
+/**
+ * Decode a packed position on the host, as the vertex shader would.
+ *
+ * @param vertex
+ * @param bounds As passed to pack_vertices.
+ * @return
+ */
+maths::Vec3 decode_position(PackedVertex const & vertex, Bounds const & bounds);
+
+/**
+ * Decode a packed normal on the host, as the vertex shader would.
+ *
+ * @param vertex
+ * @return Unit length.
+ */
+maths::Vec3 decode_normal(PackedVertex const & vertex);
+
+/**
+ * Decode packed texture coordinates on the host.
+ *
+ * @param vertex
+ * @return
+ */
+std::array<float, 2> decode_uv(PackedVertex const & vertex);
+
+/**
+ * Decode a packed tangent on the host.
+ *
+ * @param vertex
+ * @return Tangent in xyz, not renormalised, with the bitangent sign, plus or minus one, in w.
+ */
+maths::Vec4 decode_tangent(PackedVertex const & vertex);
+
+/**
+ * Single binding of PackedVertex, stepped per vertex.
+ *
+ * @param binding
+ * @return
+ */
+constexpr VkVertexInputBindingDescription binding_description(uint32_t const binding)
+{
+	return {
+		.binding = binding,
+		.stride = sizeof(PackedVertex),
+		.inputRate = VK_VERTEX_INPUT_RATE_VERTEX};
+}
+
+/**
+ * Attributes of PackedVertex, at locations 0 to 3 as per `packed_mesh.vert`.
+ *
+ * @param binding
+ * @return
+ */
+constexpr std::array<VkVertexInputAttributeDescription, 4> attribute_descriptions(
+	uint32_t const binding)
+{
+	return {{
+		{.location = 0,
+		 .binding = binding,
+		 .format = kPositionFormat,
+		 .offset = offsetof(PackedVertex, position)},
+		{.location = 1,
+		 .binding = binding,
+		 .format = kNormalFormat,
+		 .offset = offsetof(PackedVertex, normal)},
+		{.location = 2,
+		 .binding = binding,
+		 .format = kUvFormat,
+		 .offset = offsetof(PackedVertex, uv)},
+		{.location = 3,
+		 .binding = binding,
+		 .format = kTangentFormat,
+		 .offset = offsetof(PackedVertex, tangent)},
+	}};
+}
+
+/**
+ * Check that a device can read every PackedVertex attribute format from a vertex buffer.
+ *
+ * Only the 16-bit formats are guaranteed by the specification.
+ *
+ * @param physical_device
+ * @return
+ */
+bool is_supported(VkPhysicalDevice physical_device);
+}  // namespace vulkandemo::vertex
@@ -7,8 +7,13 @@
 #include "vulkandemo.hpp"
 
 #include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
 #include <string_view>
-#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -23,8 +28,16 @@
 #include <vulkan/vulkan_core.h>
 
 #include "Logger.hpp"
+#include "batch.hpp"
+#include "capture.hpp"
 #include "draw.hpp"
+#include "gpu_profiler.hpp"
+#include "headless.hpp"
+#include "hud.hpp"
 #include "macros.hpp"
+#include "multi_window.hpp"
+#include "profiler.hpp"
+#include "render_graph.hpp"
 #include "setup.hpp"
 #include "types.hpp"
 
@@ -32,9 +45,171 @@ namespace vulkandemo
 {
 using namespace std::literals;
 
-void vulkandemo(LoggerPtr const & logger)  // NOLINT(readability-function-cognitive-complexity)
+namespace
 {
-	types::SDLWindowPtr const window = setup::create_window("", 100, 100);
+constexpr uint32_t kSpriteGridSize = 32;
+
+// Memory for persistently mapped per-frame buffers, e.g. sprite instances.
+constexpr VkMemoryPropertyFlags kMappedMemoryFlags =
+	VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+/**
+ * Fill a sprite batch with a grid of translucent tiles covering the target.
+ */
+void push_sprite_grid(
+	batch::SpriteBatch & sprite_batch,
+	batch::SpritePipelines const & sprite_pipelines,
+	VkExtent2D const extent,
+	float const blue)
+{
+	batch::clear_sprite_batch(sprite_batch);
+
+	float const tile_width = static_cast<float>(extent.width) / static_cast<float>(kSpriteGridSize);
+	float const tile_height =
+		static_cast<float>(extent.height) / static_cast<float>(kSpriteGridSize);
+	std::array<batch::Instance, kSpriteGridSize> row{};
+	for (uint32_t tile_y = 0; tile_y < kSpriteGridSize; ++tile_y)
+	{
+		for (uint32_t tile_x = 0; tile_x < kSpriteGridSize; ++tile_x)
+			row[tile_x] = batch::make_rect_instance(
+				static_cast<float>(tile_x) * tile_width,
+				static_cast<float>(tile_y) * tile_height,
+				tile_width * 0.9F,
+				tile_height * 0.9F,
+				batch::pack_colour(
+					static_cast<float>(tile_x) / kSpriteGridSize,
+					static_cast<float>(tile_y) / kSpriteGridSize,
+					blue,
+					0.5F));
+		batch::push_sprite_instances(
+			sprite_batch, {.pipeline = sprite_pipelines.solid.get(), .texture = nullptr}, row);
+	}
+
+	batch::finalise_sprite_batch(sprite_batch);
+}
+
+/**
+ * Compiled frame graph, plus the imported image it renders into.
+ */
+struct FrameGraph
+{
+	render_graph::CompiledRenderGraph compiled;
+	render_graph::ResourceId target;
+};
+
+/**
+ * Compile a graph that clears an imported target then draws a sprite batch over it, followed by
+ * the performance overlay, if any.
+ */
+FrameGraph compile_frame_graph(
+	types::VulkanDevicePtr const & device,
+	VkPhysicalDevice physical_device,
+	render_graph::ImageDesc const target_desc,
+	render_graph::ResourceState const target_initial_state,
+	std::optional<render_graph::ResourceState> const target_final_state,
+	types::VulkanClearColour const & clear_colour,
+	batch::SpriteBatch const & sprite_batch,
+	batch::SpritePipelines const & sprite_pipelines,
+	hud::Hud const * hud = nullptr)
+{
+	render_graph::RenderGraph graph;
+	render_graph::ResourceId const target = render_graph::import_image(
+		graph, "target", target_desc, target_initial_state, target_final_state);
+
+	render_graph::add_pass(
+		graph,
+		{.name = "sprites",
+		 .colour_attachments =
+			 {{.image = target,
+			   .clear_value =
+				   {.float32 =
+						{clear_colour[0], clear_colour[1], clear_colour[2], clear_colour[3]}}}},
+		 .record =
+			 [&sprite_batch, &sprite_pipelines, target](
+				 VkCommandBuffer command_buffer, render_graph::CompiledRenderGraph const & compiled)
+		 {
+			 batch::populate_cmd_sprite_batch(
+				 command_buffer,
+				 sprite_batch,
+				 sprite_pipelines.layout,
+				 render_graph::image_desc(compiled, target).extent);
+		 }});
+
+	if (hud != nullptr)
+		render_graph::add_pass(
+			graph,
+			{.name = "hud",
+			 .colour_attachments = {{.image = target, .load_op = VK_ATTACHMENT_LOAD_OP_LOAD}},
+			 .record =
+				 [hud, &sprite_pipelines, target](
+					 VkCommandBuffer command_buffer,
+					 render_graph::CompiledRenderGraph const & compiled)
+			 {
+				 hud::populate_cmd_hud(
+					 command_buffer,
+					 *hud,
+					 sprite_pipelines,
+					 render_graph::image_desc(compiled, target).extent);
+			 }});
+
+	return FrameGraph{
+		.compiled = render_graph::compile_render_graph(device, physical_device, std::move(graph)),
+		.target = target};
+}
+
+/**
+ * Contents drawn to a window, see vulkandemo.
+ */
+struct WindowScene
+{
+	batch::SpriteBatch sprite_batch;
+	/// Indexed by the window's VulkanImageIdx.
+	types::VulkanCommandBuffersPtr command_buffers;
+	types::VulkanClearColour clear_colour;
+	/// Empty only until first compiled.
+	std::optional<FrameGraph> frame_graph;
+};
+
+/**
+ * Log the rolling GPU timings of each pass.
+ */
+void log_gpu_stats(
+	LoggerPtr const & logger,
+	gpu_profiler::GpuProfiler const & profiler,
+	spdlog::level::level_enum const level)
+{
+	for (gpu_profiler::ScopeStats const & stats : profiler.stats())
+		logger->log(
+			level,
+			"GPU {}: min {:.3f} ms, avg {:.3f} ms, p99 {:.3f} ms over {} frames",
+			stats.name,
+			stats.min_ms,
+			stats.avg_ms,
+			stats.p99_ms,
+			stats.sample_count);
+}
+
+/**
+ * Features required by the render graph, see render_graph.hpp.
+ */
+VkPhysicalDeviceVulkan13Features render_graph_features()
+{
+	return VkPhysicalDeviceVulkan13Features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE,
+		.dynamicRendering = VK_TRUE};
+}
+}  // namespace
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+void vulkandemo(LoggerPtr const & logger, bool const show_hud, std::size_t const window_count)
+{
+	if (window_count == 0)
+		throw std::invalid_argument{"At least one window is required"};
+
+	std::vector<types::SDLWindowPtr> sdl_windows;
+	for (std::size_t window_idx = 0; window_idx < window_count; ++window_idx)
+		sdl_windows.push_back(setup::create_window("", 100, 100));
 
 	std::vector<types::AvailableInstanceLayerNameCstr> const optional_layers =
 		setup::filter_available_layers(
@@ -46,116 +221,454 @@ void vulkandemo(LoggerPtr const & logger)  // NOLINT(readability-function-cognit
 			{types::DesiredInstanceExtensionNameView{
 				std::string_view{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
 
+	// Surface extensions are the same for every window, so any window will do.
 	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
-		logger, window, optional_layers, optional_instance_extensions);
+		logger, sdl_windows.front(), optional_layers, optional_instance_extensions);
 
 	types::VulkanDebugMessengerPtr const messenger = optional_instance_extensions.empty()
 		? nullptr
 		: setup::create_debug_messenger(logger, instance);
 
-	types::VulkanSurfacePtr const surface = setup::create_surface(window, instance);
+	std::vector<types::VulkanSurfacePtr> surfaces;
+	for (types::SDLWindowPtr const & sdl_window : sdl_windows)
+		surfaces.push_back(setup::create_surface(sdl_window, instance));
 
+	// Selected against the first window's surface, then checked against the others when creating
+	// their swapchains.
 	auto [physical_device, queue_family_idx] = setup::select_physical_device(
 		logger,
 		setup::enumerate_physical_devices(logger, instance),
 		{types::DesiredDeviceExtensionNameView{VK_KHR_SWAPCHAIN_EXTENSION_NAME}},
 		VK_QUEUE_GRAPHICS_BIT,
-		0,
-		surface);
+		kMappedMemoryFlags,
+		surfaces.front());
+
+	// GPU frame time shown by the overlay, if available.
+	bool const profile = gpu_profiler::supports_gpu_profiling(physical_device, queue_family_idx);
+
+	VkPhysicalDeviceVulkan13Features vulkan13_features = render_graph_features();
+	VkPhysicalDeviceVulkan12Features vulkan12_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = &vulkan13_features,
+		.hostQueryReset = static_cast<VkBool32>(profile)};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan12_features};
+
+	// Memory usage shown by the overlay, if available.
+	bool const memory_budget_enabled =
+		!setup::filter_available_device_extensions(
+			 logger,
+			 physical_device,
+			 {types::DesiredDeviceExtensionNameView{VK_EXT_MEMORY_BUDGET_EXTENSION_NAME}})
+			 .empty();
+	std::vector<types::AvailableDeviceExtensionNameView> device_extensions{
+		types::AvailableDeviceExtensionNameView{VK_KHR_SWAPCHAIN_EXTENSION_NAME}};
+	if (memory_budget_enabled)
+		device_extensions.push_back(
+			types::AvailableDeviceExtensionNameView{VK_EXT_MEMORY_BUDGET_EXTENSION_NAME});
 
 	auto [device, queues] = setup::create_device_and_queues(
 		physical_device,
 		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
-		{{types::AvailableDeviceExtensionNameView{VK_KHR_SWAPCHAIN_EXTENSION_NAME}}});
+		device_extensions,
+		&features);
 
-	auto const image_available_semaphore = setup::create_semaphore(device);
+	// Signalled once every window's rendering has finished, and waited on by a single present.
 	auto const rendering_finished_semaphore = setup::create_semaphore(device);
 
 	std::vector<VkSurfaceFormatKHR> const available_formats =
 		setup::filter_available_surface_formats(
 			logger,
 			physical_device,
-			surface,
+			surfaces.front(),
 			{{VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_B8G8R8A8_UNORM}});
+	// Shared by all windows, so that they can share pipelines.
+	VkSurfaceFormatKHR const surface_format = available_formats.at(0);
 
-	auto [swapchain, image_views] = setup::create_exclusive_double_buffer_swapchain_and_image_views(
-		logger, physical_device, device, surface, available_formats.at(0));
-
-	auto const render_pass = setup::create_single_presentation_subpass_render_pass(
-		available_formats.at(0).format, device);
-
-	VkExtent2D drawable_size = setup::window_drawable_size(window);
-
-	std::vector<types::VulkanFramebufferPtr> frame_buffers =
-		setup::create_per_image_frame_buffers(device, render_pass, image_views, drawable_size);
+	std::vector<multi_window::WindowSurface> windows;
+	for (std::size_t window_idx = 0; window_idx < window_count; ++window_idx)
+		windows.push_back(multi_window::create_window_surface(
+			logger,
+			physical_device,
+			queue_family_idx,
+			device,
+			std::move(sdl_windows[window_idx]),
+			std::move(surfaces[window_idx]),
+			surface_format));
 
 	types::VulkanCommandPoolPtr const command_pool =
 		setup::create_command_pool(device, queue_family_idx);
 
-	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
-		device, command_pool, types::VulkanCommandBufferCount{frame_buffers.size()});
-
 	VkQueue queue = queues.at(queue_family_idx).front();
 
-	types::VulkanClearColour clear_colour{std::array{1.0F, .0F, .0F, 1.0F}};
+	batch::SpritePipelines const sprite_pipelines =
+		batch::create_sprite_pipelines(device, surface_format.format);
+
+	types::VulkanMemoryTypeIdx const memory_type_idx =
+		setup::filter_available_memory_types(logger, physical_device, kMappedMemoryFlags).at(0);
+
+	// Drawn over the first window only.
+	std::optional<hud::Hud> hud;
+	if (show_hud)
+		hud = hud::create_hud(
+			device, physical_device, queue_family_idx, queue, memory_type_idx, sprite_pipelines);
+
+	// Timings of each pass, across all windows. One query pool per frame in flight, matching the
+	// double-buffered swapchains.
+	constexpr std::size_t profiled_frame_count = 2;
+	std::optional<gpu_profiler::GpuProfiler> profiler;
+	if (profile)
+		profiler.emplace(device, physical_device, queue_family_idx, profiled_frame_count);
+
+	// Per window contents. Frame graphs reference their window's sprite batch, so scenes must not
+	// move once their graph is compiled.
+	std::vector<WindowScene> scenes;
+	scenes.reserve(window_count);
+	for (multi_window::WindowSurface const & window : windows)
+		scenes.push_back(WindowScene{
+			.sprite_batch = batch::create_sprite_batch(
+				device, memory_type_idx, batch::InstanceCount{kSpriteGridSize * kSpriteGridSize}),
+			.command_buffers = setup::create_primary_command_buffers(
+				device,
+				command_pool,
+				types::VulkanCommandBufferCount{window.image_views.size()}),
+			.clear_colour = types::VulkanClearColour{std::array{1.0F, .0F, .0F, 1.0F}},
+			.frame_graph = std::nullopt});
+
+	// Frame graph of a window, rebuilt whenever its swapchain is.
+	auto const compile_window_frame_graph = [&](std::size_t const window_idx)
+	{
+		return compile_frame_graph(
+			device,
+			physical_device,
+			{.format = surface_format.format, .extent = windows[window_idx].drawable_size},
+			render_graph::kSwapchainAcquired,
+			render_graph::kPresentable,
+			scenes[window_idx].clear_colour,
+			scenes[window_idx].sprite_batch,
+			sprite_pipelines,
+			window_idx == 0 && hud ? &*hud : nullptr);
+	};
+	for (std::size_t window_idx = 0; window_idx < window_count; ++window_idx)
+		scenes[window_idx].frame_graph = compile_window_frame_graph(window_idx);
+
+	// Measurements of the previous frame, shown by the overlay.
+	using Clock = std::chrono::steady_clock;
+	hud::FrameStats frame_stats{
+		.cpu_frame_ms = 0.0,
+		.gpu_frame_ms = std::nullopt,
+		.present_to_idle_ms = std::nullopt,
+		.draw_count = 0,
+		.instance_count = 0,
+		.memory = std::nullopt};
 
 	// Application loop.
-	while (true)
+	for (std::size_t frame_idx = 0;; ++frame_idx)
 	{
+		PROFILE_SCOPE("frame");
+
 		// SDL event loop.
 		SDL_Event event;
 		while (SDL_PollEvent(&event) != 0)
 		{
 			if (event.type == SDL_QUIT)
 				return;
-			if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_RESIZED)
-			{
-				VK_CHECK(vkDeviceWaitIdle(device.get()), "Failed to wait for device to be idle");
+			if (event.type != SDL_WINDOWEVENT)
+				continue;
 
-				drawable_size = setup::window_drawable_size(window);
-				logger->debug(
-					"New drawable size ({}, {})", drawable_size.width, drawable_size.height);
+			std::size_t const window_idx =
+				multi_window::find_window(windows, event.window.windowID);
+			if (window_idx == windows.size())
+				continue;
+
+			// Windows share the device and pipelines, so closing any ends the demo.
+			if (event.window.event == SDL_WINDOWEVENT_CLOSE)
+				return;
+
+			if (event.window.event == SDL_WINDOWEVENT_RESIZED)
+			{
+				windows[window_idx].out_of_date = true;
 
+				types::VulkanClearColour & clear_colour = scenes[window_idx].clear_colour;
 				clear_colour[0] = 1.0F - clear_colour[0];
 				clear_colour[2] = 1.0F - clear_colour[2];
-				logger->debug("Changing clear colour to ({})", fmt::join(clear_colour, ","));
-
-				// Recreate swapchain and dependent resources
-				std::tie(swapchain, image_views) =
-					setup::create_exclusive_double_buffer_swapchain_and_image_views(
-						logger,
-						physical_device,
-						device,
-						surface,
-						available_formats.at(0),
-						swapchain);
-
-				frame_buffers = setup::create_per_image_frame_buffers(
-					device, render_pass, image_views, drawable_size);
+				logger->debug(
+					"Changing clear colour of window {} to ({})",
+					window_idx,
+					fmt::join(clear_colour, ","));
 			}
 		}
 
-		auto const image_idx =
-			draw::acquire_next_swapchain_image(device, swapchain, image_available_semaphore);
+		// Recreate swapchains and dependent resources of windows found out of date, e.g. by a
+		// resize, acquire or present. Windows that cannot be drawn to, e.g. minimised, are left
+		// until they can.
+		bool device_idle = false;
+		for (std::size_t window_idx = 0; window_idx < windows.size(); ++window_idx)
+		{
+			multi_window::WindowSurface & window = windows[window_idx];
+			if (!window.out_of_date || !multi_window::is_drawable(window))
+				continue;
+			if (!device_idle)
+			{
+				VK_CHECK(vkDeviceWaitIdle(device.get()), "Failed to wait for device to be idle");
+				device_idle = true;
+			}
+			multi_window::recreate_swapchain(logger, physical_device, device, window);
+			scenes[window_idx].frame_graph = compile_window_frame_graph(window_idx);
+		}
+
+		// Acquire from all windows before recording any, so that a single submission and present
+		// covers them all.
+		std::vector<multi_window::AcquiredImage> const acquired =
+			multi_window::acquire_window_images(device, windows);
 
-		if (!image_idx.has_value())
+		if (acquired.empty())
 		{
-			logger->debug("Swapchain out of date");
+			logger->debug("No window to draw to");
 			continue;
 		}
 
-		VkCommandBuffer command_buffer = command_buffers->at(*image_idx);
-		types::VulkanFramebufferPtr const & frame_buffer = frame_buffers.at(*image_idx);
+		Clock::time_point const frame_start = Clock::now();
 
-		draw::populate_cmd_render_pass(
-			command_buffer, render_pass, frame_buffer, drawable_size, clear_colour);
+		// Previous work in this slot has completed, see vkQueueWaitIdle below, so collecting its
+		// timings does not stall.
+		if (profiler)
+		{
+			profiler->begin_frame(frame_idx);
+			frame_stats.gpu_frame_ms = profiler->last_frame_ms();
+			if (frame_idx % gpu_profiler::kWindowLength == 0)
+				log_gpu_stats(logger, *profiler, spdlog::level::debug);
+		}
 
-		draw::submit_command_buffer(
-			queue, command_buffer, image_available_semaphore, rendering_finished_semaphore);
+		if (hud)
+		{
+			if (memory_budget_enabled)
+				frame_stats.memory = hud::query_memory_usage(physical_device);
+			hud::update_hud(*hud, sprite_pipelines, frame_stats);
+		}
+
+		std::vector<VkCommandBuffer> command_buffers;
+		frame_stats.draw_count = hud ? 1U : 0U;
+		frame_stats.instance_count = hud ? static_cast<uint32_t>(hud->instances.size()) : 0U;
+		for (multi_window::AcquiredImage const & image : acquired)
+		{
+			multi_window::WindowSurface const & window = windows[image.window_idx];
+			WindowScene & scene = scenes[image.window_idx];
+
+			// Safe to overwrite the instance buffers, since the previous frame has completed, see
+			// vkQueueWaitIdle below.
+			push_sprite_grid(
+				scene.sprite_batch,
+				sprite_pipelines,
+				window.drawable_size,
+				scene.clear_colour[2]);
+
+			VkCommandBuffer command_buffer = scene.command_buffers->at(image.image_idx);
+
+			// NOLINTBEGIN(bugprone-unchecked-optional-access) compiled on creation
+			render_graph::bind_imported_image(
+				scene.frame_graph->compiled,
+				scene.frame_graph->target,
+				window.images.at(image.image_idx),
+				window.image_views.at(image.image_idx).get());
+			render_graph::populate_cmd_render_graph(
+				command_buffer, scene.frame_graph->compiled, profiler ? &*profiler : nullptr);
+			// NOLINTEND(bugprone-unchecked-optional-access)
+			command_buffers.push_back(command_buffer);
+
+			frame_stats.draw_count += static_cast<uint32_t>(scene.sprite_batch.runs.size());
+			frame_stats.instance_count +=
+				static_cast<uint32_t>(scene.sprite_batch.pending_instances.size());
+		}
 
-		draw::submit_present_image_cmd(queue, swapchain, *image_idx, rendering_finished_semaphore);
+		draw::submit_command_buffers(
+			queue,
+			command_buffers,
+			multi_window::image_available_semaphores(windows, acquired),
+			rendering_finished_semaphore);
+
+		Clock::time_point const present_start = Clock::now();
+		multi_window::present_window_images(
+			queue, windows, acquired, rendering_finished_semaphore);
 
 		VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+
+		std::chrono::duration<double, std::milli> const cpu_frame_time =
+			present_start - frame_start;
+		std::chrono::duration<double, std::milli> const present_to_idle =
+			Clock::now() - present_start;
+		frame_stats.cpu_frame_ms = cpu_frame_time.count();
+		frame_stats.present_to_idle_ms = present_to_idle.count();
+	}
+}
+
+void vulkandemo_headless(
+	LoggerPtr const & logger,
+	std::size_t const frame_count,
+	std::optional<std::filesystem::path> const & capture_directory)
+{
+	std::vector<types::AvailableInstanceLayerNameCstr> const optional_layers =
+		setup::filter_available_layers(
+			logger, {types::DesiredInstanceLayerNameView{"VK_LAYER_KHRONOS_validation"}});
+
+	std::vector<types::AvailableInstanceExtensionNameCstr> const optional_instance_extensions =
+		setup::filter_available_instance_extensions(
+			logger,
+			{types::DesiredInstanceExtensionNameView{
+				std::string_view{VK_EXT_DEBUG_UTILS_EXTENSION_NAME}}});
+
+	// No window, so no SDL and no surface extensions.
+	types::VulkanInstancePtr const instance = setup::create_vulkan_instance(
+		logger, nullptr, optional_layers, optional_instance_extensions);
+
+	types::VulkanDebugMessengerPtr const messenger = optional_instance_extensions.empty()
+		? nullptr
+		: setup::create_debug_messenger(logger, instance);
+
+	auto [physical_device, queue_family_idx] = setup::select_physical_device(
+		logger,
+		setup::enumerate_physical_devices(logger, instance),
+		{},
+		VK_QUEUE_GRAPHICS_BIT,
+		kMappedMemoryFlags);
+
+	bool const profile = gpu_profiler::supports_gpu_profiling(physical_device, queue_family_idx);
+
+	VkPhysicalDeviceVulkan13Features vulkan13_features = render_graph_features();
+	VkPhysicalDeviceVulkan12Features vulkan12_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = &vulkan13_features,
+		.hostQueryReset = static_cast<VkBool32>(profile)};
+	VkPhysicalDeviceFeatures2 const features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &vulkan12_features};
+
+	auto [device, queues] = setup::create_device_and_queues(
+		physical_device,
+		{{std::pair{queue_family_idx, types::VulkanQueueCount{1}}}},
+		{},
+		&features);
+
+	VkQueue queue = queues.at(queue_family_idx).front();
+
+	// Same number of frames in flight as the double-buffered swapchain.
+	constexpr std::size_t ring_size = 2;
+	headless::OffscreenRing ring = headless::create_offscreen_ring(
+		device,
+		physical_device,
+		VK_FORMAT_R8G8B8A8_UNORM,
+		{1920, 1080},
+		ring_size,
+		capture_directory ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+
+	types::VulkanCommandPoolPtr const command_pool =
+		setup::create_command_pool(device, queue_family_idx);
+
+	types::VulkanCommandBuffersPtr const command_buffers = setup::create_primary_command_buffers(
+		device, command_pool, types::VulkanCommandBufferCount{ring_size});
+
+	types::VulkanClearColour const clear_colour{std::array{1.0F, .0F, .0F, 1.0F}};
+
+	batch::SpritePipelines const sprite_pipelines =
+		batch::create_sprite_pipelines(device, ring.format);
+
+	// Instances are written once up front, since frames in flight share the instance buffer.
+	batch::SpriteBatch sprite_batch = batch::create_sprite_batch(
+		device,
+		setup::filter_available_memory_types(logger, physical_device, kMappedMemoryFlags).at(0),
+		batch::InstanceCount{kSpriteGridSize * kSpriteGridSize});
+	push_sprite_grid(sprite_batch, sprite_pipelines, ring.extent, clear_colour[2]);
+
+	FrameGraph frame_graph = compile_frame_graph(
+		device,
+		physical_device,
+		{.format = ring.format, .extent = ring.extent},
+		headless::kOffscreenAcquired,
+		std::nullopt,
+		clear_colour,
+		sprite_batch,
+		sprite_pipelines);
+
+	// One query pool per offscreen image, recycled once the image's fence signals.
+	std::optional<gpu_profiler::GpuProfiler> profiler;
+	if (profile)
+		profiler.emplace(device, physical_device, queue_family_idx, ring_size);
+
+	// Captures are dropped rather than throttling rendering if the encoder falls behind.
+	std::optional<capture::FrameCapture> frame_capture;
+	if (capture_directory)
+	{
+		std::filesystem::create_directories(*capture_directory);
+		frame_capture.emplace(
+			logger,
+			device,
+			physical_device,
+			queue_family_idx,
+			ring.format,
+			ring.extent,
+			capture::CaptureConfig{.directory = *capture_directory});
+	}
+
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point const start = Clock::now();
+
+	for (std::size_t frame = 0; frame < frame_count; ++frame)
+	{
+		PROFILE_SCOPE("frame");
+		types::VulkanImageIdx const image_idx = headless::acquire_offscreen_image(device, ring);
+
+		VkCommandBuffer command_buffer = command_buffers->at(image_idx);
+
+		render_graph::bind_imported_image(
+			frame_graph.compiled,
+			frame_graph.target,
+			ring.images.at(image_idx).get(),
+			ring.image_views.at(image_idx).get());
+		if (profiler)
+			profiler->begin_frame(image_idx);
+
+		render_graph::populate_cmd_render_graph(
+			command_buffer, frame_graph.compiled, profiler ? &*profiler : nullptr);
+
+		draw::submit_command_buffer(
+			queue, command_buffer, nullptr, nullptr, ring.fences.at(image_idx));
+
+		// Final state of the frame graph's target is left as rendered.
+		if (frame_capture)
+			frame_capture->capture(
+				queue,
+				ring.images.at(image_idx).get(),
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				frame);
+	}
+
+	VK_CHECK(vkQueueWaitIdle(queue), "Failed to wait for queue to be idle");
+
+	std::chrono::duration<double> const elapsed = Clock::now() - start;
+	logger->info(
+		"Rendered {} headless frames of {}x{} in {:.3f}s ({:.1f} frames/s)",
+		frame_count,
+		ring.extent.width,
+		ring.extent.height,
+		elapsed.count(),
+		static_cast<double>(frame_count) / elapsed.count());
+
+	if (profiler)
+	{
+		// Collect the frames still in flight when the loop ended.
+		for (std::size_t image_idx = 0; image_idx < ring_size; ++image_idx)
+			profiler->begin_frame(image_idx);
+		log_gpu_stats(logger, *profiler, spdlog::level::info);
+	}
+
+	if (frame_capture)
+	{
+		frame_capture->flush();
+		logger->info(
+			"Captured {} frames to {}, dropped {}, failed {}",
+			frame_capture->written_count(),
+			capture_directory->string(),
+			frame_capture->dropped_count(),
+			frame_capture->failed_count());
 	}
 }
-}  // namespace vulkandemo
\ No newline at end of file
+}  // namespace vulkandemo
@@ -1,10 +1,34 @@
 // SPDX-License-Identifier: MIT
 // Copyright 2024 David Feltell
 #pragma once
+#include <cstddef>
+#include <filesystem>
+#include <optional>
 
 #include "Logger.hpp"
 
 namespace vulkandemo
 {
-void vulkandemo(LoggerPtr const & logger);
+/**
+ * Render to one or more windows, sharing a device and queue, until any is closed.
+ *
+ * @param logger
+ * @param show_hud Draw the performance overlay over each frame of the first window.
+ * @param window_count Number of windows, each with its own swapchain.
+ */
+void vulkandemo(LoggerPtr const & logger, bool show_hud = false, std::size_t window_count = 1);
+
+/**
+ * Render a fixed number of frames into offscreen images, without a window or surface, then log
+ * the throughput.
+ *
+ * @param logger
+ * @param frame_count
+ * @param capture_directory If set, asynchronously capture frames to PNG files in this directory,
+ * dropping captures whenever the encoder falls behind.
+ */
+void vulkandemo_headless(
+	LoggerPtr const & logger,
+	std::size_t frame_count,
+	std::optional<std::filesystem::path> const & capture_directory = std::nullopt);
 }  // namespace vulkandemo
\ No newline at end of file